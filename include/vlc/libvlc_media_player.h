@@ -358,6 +358,76 @@ void libvlc_video_set_format_callbacks( libvlc_media_player_t *mp,
                                         libvlc_video_format_cb setup,
                                         libvlc_video_cleanup_cb cleanup );
 
+/**
+ * Opaque handle of a decoded video frame, as handed by
+ * @ref libvlc_video_frame_cb.
+ */
+typedef struct libvlc_video_frame_t libvlc_video_frame_t;
+
+/**
+ * Callback prototype to receive a decoded video frame.
+ *
+ * When a video frame needs to be shown, as determined by the media playback
+ * clock, the frame callback is invoked with the picture buffer that the video
+ * decoder rendered into. The pixels are not copied: the frame belongs to the
+ * application until it is released with libvlc_video_frame_release(), and
+ * cannot be reused by the decoder meanwhile.
+ *
+ * \param opaque private pointer as passed to
+ *               libvlc_video_set_frame_callback() [IN]
+ * \param frame handle of the frame, to release [IN]
+ * \param planes start address of the pixel planes, NULL after the last
+ *               plane of the chroma [IN]
+ * \param pitches table of scanline pitches in bytes for each plane [IN]
+ * \param lines table of scanlines count for each plane [IN]
+ * \param date presentation date, in microseconds on the libvlc_clock()
+ *             time base [IN]
+ *
+ * \note The tables have as many entries as the chroma with the most planes.
+ */
+typedef void (*libvlc_video_frame_cb)(void *opaque,
+                                      libvlc_video_frame_t *frame,
+                                      void *const *planes,
+                                      const unsigned *pitches,
+                                      const unsigned *lines,
+                                      int64_t date);
+
+/**
+ * Set a callback and private data to receive the decoded video frames,
+ * without copying them.
+ * This is mutually exclusive with libvlc_video_set_callbacks().
+ *
+ * The frames are in the chroma and dimensions of the video decoder, unless
+ * libvlc_video_set_format_callbacks() changes them, in which case LibVLC
+ * converts the video first. The pitches and lines returned by the format
+ * callback are then ignored, and its return value is the number of frames
+ * that the application holds at any time: when the application holds more
+ * frames than that, the decoding waits for their release.
+ *
+ * Subtitles and on-screen messages are not blended into the frames.
+ *
+ * \param mp the media player
+ * \param frame callback to receive the frames (must not be NULL)
+ * \param opaque private pointer for the callback (as first parameter)
+ * \version LibVLC 2.1.0 or later
+ */
+LIBVLC_API
+void libvlc_video_set_frame_callback( libvlc_media_player_t *mp,
+                                      libvlc_video_frame_cb frame,
+                                      void *opaque );
+
+/**
+ * Release a video frame handed by @ref libvlc_video_frame_cb, so that the
+ * video decoder can reuse its buffer. This can be called from any thread,
+ * and after the media player is stopped, but before the LibVLC instance is
+ * released.
+ *
+ * \param frame the frame to release
+ * \version LibVLC 2.1.0 or later
+ */
+LIBVLC_API
+void libvlc_video_frame_release( libvlc_video_frame_t *frame );
+
 /**
  * Set the NSView handler where the media player should render its video output.
  *
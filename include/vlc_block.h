@@ -117,6 +117,8 @@ struct block_t
     mtime_t     i_dts;
     mtime_t     i_length;
 
+    mtime_t     i_trace_date; /* entry in the pipeline, when it is traced */
+
     /* Rudimentary support for overloading block (de)allocation. */
     block_free_t pf_release;
 };
@@ -155,6 +157,7 @@ static inline block_t *block_Duplicate( block_t *p_block )
     p_dup->i_dts     = p_block->i_dts;
     p_dup->i_pts     = p_block->i_pts;
     p_dup->i_length  = p_block->i_length;
+    p_dup->i_trace_date = p_block->i_trace_date;
     memcpy( p_dup->p_buffer, p_block->p_buffer, p_block->i_buffer );
 
     return p_dup;
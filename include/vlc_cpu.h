@@ -37,6 +37,8 @@
 #  define CPU_CAPABILITY_SSE4_1  (1<<10)
 #  define CPU_CAPABILITY_SSE4_2  (1<<11)
 #  define CPU_CAPABILITY_SSE4A   (1<<12)
+#  define CPU_CAPABILITY_AVX     (1<<13)
+#  define CPU_CAPABILITY_AVX2    (1<<14)
 
 # if defined (__MMX__)
 #  define VLC_MMX
@@ -54,6 +56,30 @@
 #  define VLC_SSE VLC_SSE_is_not_implemented_on_this_compiler
 # endif
 
+# if defined (__SSE2__)
+#  define VLC_SSE2
+# elif VLC_GCC_VERSION(4, 4)
+#  define VLC_SSE2 __attribute__ ((__target__ ("sse2")))
+# else
+#  define VLC_SSE2 VLC_SSE2_is_not_implemented_on_this_compiler
+# endif
+
+# if defined (__AVX__)
+#  define VLC_AVX
+# elif VLC_GCC_VERSION(4, 4)
+#  define VLC_AVX __attribute__ ((__target__ ("avx")))
+# else
+#  define VLC_AVX VLC_AVX_is_not_implemented_on_this_compiler
+# endif
+
+# if defined (__AVX2__)
+#  define VLC_AVX2
+# elif VLC_GCC_VERSION(4, 7)
+#  define VLC_AVX2 __attribute__ ((__target__ ("avx2")))
+# else
+#  define VLC_AVX2 VLC_AVX2_is_not_implemented_on_this_compiler
+# endif
+
 # else
 #  define CPU_CAPABILITY_MMX     (0)
 #  define CPU_CAPABILITY_3DNOW   (0)
@@ -65,6 +91,8 @@
 #  define CPU_CAPABILITY_SSE4_1  (0)
 #  define CPU_CAPABILITY_SSE4_2  (0)
 #  define CPU_CAPABILITY_SSE4A   (0)
+#  define CPU_CAPABILITY_AVX     (0)
+#  define CPU_CAPABILITY_AVX2    (0)
 # endif
 
 # if defined (__ppc__) || defined (__ppc64__) || defined (__powerpc__)
@@ -191,6 +191,12 @@ VLC_API void stats_TimersCleanAll(vlc_object_t * );
 VLC_API void stats_TimerClean(vlc_object_t *, unsigned int );
 #define stats_TimerClean(a,b) stats_TimerClean( VLC_OBJECT(a), b )
 
+/*********
+ * Metrics
+ ********/
+VLC_API char *stats_Export(vlc_object_t *) VLC_USED VLC_MALLOC;
+#define stats_Export(a) stats_Export( VLC_OBJECT(a) )
+
 /**
  * @}
  */
@@ -82,6 +82,7 @@ struct picture_t
     unsigned        i_refcount;                  /**< link reference counter */
     mtime_t         date;                                  /**< display date */
     bool            b_force;
+    mtime_t         trace_date;  /**< entry in the pipeline, when traced */
     /**@}*/
 
     /** \name Picture dynamic properties
@@ -211,6 +212,7 @@ static inline void picture_CopyProperties( picture_t *p_dst, const picture_t *p_
 {
     p_dst->date = p_src->date;
     p_dst->b_force = p_src->b_force;
+    p_dst->trace_date = p_src->trace_date;
 
     p_dst->b_progressive = p_src->b_progressive;
     p_dst->i_nb_fields = p_src->i_nb_fields;
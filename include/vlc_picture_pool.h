@@ -121,6 +121,27 @@ VLC_API picture_pool_t * picture_pool_Reserve(picture_pool_t *, int picture_coun
  */
 VLC_API int picture_pool_GetSize(picture_pool_t *);
 
+/**
+ * It returns the number of pictures of the given pool that are in use,
+ * the reserved ones excepted.
+ */
+VLC_API int picture_pool_GetUsed(picture_pool_t *);
+
+/**
+ * It adds up to count pictures to a pool created by
+ * picture_pool_NewFromFormat, and returns how many were added.
+ *
+ * The other pools cannot grow. As displays may create their own pool with
+ * picture_pool_NewFromFormat, only the owner of a pool should grow it.
+ */
+VLC_API int picture_pool_Grow(picture_pool_t *, int count);
+
+/**
+ * It removes up to count unused pictures among those added by
+ * picture_pool_Grow, and returns how many were removed.
+ */
+VLC_API int picture_pool_Shrink(picture_pool_t *, int count);
+
 
 #endif /* VLC_PICTURE_POOL_H */
 
@@ -111,8 +111,28 @@ enum stream_query_e
 
     /* XXX only data read through stream_Read/Block will be recorded */
     STREAM_SET_RECORD_STATE,     /**< arg1=bool, arg2=const char *psz_ext (if arg1 is true)  res=can fail */
+
+    /* Statistics of the access read cache */
+    STREAM_GET_CACHE_STATS,      /**< arg1= stream_cache_stats_t *  res=can fail */
 };
 
+/**
+ * Read cache statistics of a stream, see STREAM_GET_CACHE_STATS.
+ */
+typedef struct
+{
+    uint64_t i_hit;         /**< Reads and peeks served from the cache */
+    uint64_t i_miss;        /**< Reads and peeks that waited for the access */
+    mtime_t  i_stall;       /**< Total time spent waiting for the access */
+
+    uint64_t i_bytes;       /**< Bytes read from the access */
+    uint64_t i_read_count;  /**< Access reads */
+    unsigned i_seek_count;  /**< Access seeks */
+
+    unsigned i_read_size;   /**< Current size of an access read */
+    unsigned i_depth;       /**< Current read-ahead, in bytes */
+} stream_cache_stats_t;
+
 VLC_API int stream_Read( stream_t *s, void *p_read, int i_read );
 VLC_API int stream_Peek( stream_t *s, const uint8_t **pp_peek, int i_peek );
 VLC_API int stream_vaControl( stream_t *s, int i_query, va_list args );
@@ -173,6 +173,22 @@ VLC_API int var_Command( vlc_object_t *, const char *, const char *, const char
 
 VLC_API void var_FreeList( vlc_value_t *, vlc_value_t * );
 
+/*****************************************************************************
+ * Variable handles
+ *****************************************************************************
+ * A handle is a variable resolved once, for frequent accesses without any
+ * name lookup. Scalar values are read without locking. The handle holds a
+ * reference to the variable, as var_Create() does: it must be released
+ * before the object is destroyed.
+ *****************************************************************************/
+typedef struct vlc_var_handle vlc_var_handle_t;
+
+VLC_API vlc_var_handle_t *var_Resolve( vlc_object_t *, const char *, int ) VLC_USED;
+#define var_Resolve(o,n,t) var_Resolve(VLC_OBJECT(o),n,t)
+VLC_API void var_HandleRelease( vlc_var_handle_t * );
+VLC_API void var_HandleGetChecked( vlc_var_handle_t *, int, vlc_value_t * );
+VLC_API int var_HandleSetChecked( vlc_var_handle_t *, int, vlc_value_t );
+
 
 /*****************************************************************************
  * Variable callbacks
@@ -667,6 +683,74 @@ static inline bool var_ToggleBool( vlc_object_t *p_obj, const char *psz_name )
 }
 #define var_ToggleBool(a,b) var_ToggleBool( VLC_OBJECT(a),b )
 
+VLC_USED
+static inline int64_t var_HandleGetInteger( vlc_var_handle_t *h )
+{
+    vlc_value_t val;
+    var_HandleGetChecked( h, VLC_VAR_INTEGER, &val );
+    return val.i_int;
+}
+
+VLC_USED
+static inline bool var_HandleGetBool( vlc_var_handle_t *h )
+{
+    vlc_value_t val;
+    var_HandleGetChecked( h, VLC_VAR_BOOL, &val );
+    return val.b_bool;
+}
+
+VLC_USED
+static inline float var_HandleGetFloat( vlc_var_handle_t *h )
+{
+    vlc_value_t val;
+    var_HandleGetChecked( h, VLC_VAR_FLOAT, &val );
+    return val.f_float;
+}
+
+VLC_USED
+static inline int64_t var_HandleGetTime( vlc_var_handle_t *h )
+{
+    vlc_value_t val;
+    var_HandleGetChecked( h, VLC_VAR_TIME, &val );
+    return val.i_time;
+}
+
+VLC_USED
+static inline void *var_HandleGetAddress( vlc_var_handle_t *h )
+{
+    vlc_value_t val;
+    var_HandleGetChecked( h, VLC_VAR_ADDRESS, &val );
+    return val.p_address;
+}
+
+static inline int var_HandleSetInteger( vlc_var_handle_t *h, int64_t i )
+{
+    vlc_value_t val;
+    val.i_int = i;
+    return var_HandleSetChecked( h, VLC_VAR_INTEGER, val );
+}
+
+static inline int var_HandleSetBool( vlc_var_handle_t *h, bool b )
+{
+    vlc_value_t val;
+    val.b_bool = b;
+    return var_HandleSetChecked( h, VLC_VAR_BOOL, val );
+}
+
+static inline int var_HandleSetFloat( vlc_var_handle_t *h, float f )
+{
+    vlc_value_t val;
+    val.f_float = f;
+    return var_HandleSetChecked( h, VLC_VAR_FLOAT, val );
+}
+
+static inline int var_HandleSetTime( vlc_var_handle_t *h, int64_t i )
+{
+    vlc_value_t val;
+    val.i_time = i;
+    return var_HandleSetChecked( h, VLC_VAR_TIME, val );
+}
+
 
 VLC_USED
 static inline bool var_InheritBool( vlc_object_t *obj, const char *name )
@@ -0,0 +1,36 @@
+/*****************************************************************************
+ * vlc_vmem.h: video frames handed to LibVLC applications
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_VMEM_H
+#define VLC_VMEM_H 1
+
+/* XXX Only for LibVLC and the vmem plugin XXX */
+
+/**
+ * Handle of a video frame that the vmem plugin hands to the application.
+ * The plugin embeds it at the start of its own frame structure.
+ */
+struct libvlc_video_frame_t
+{
+    /** Gives the frame back to the plugin, from any thread */
+    void (*release)(struct libvlc_video_frame_t *);
+};
+
+#endif
@@ -34,6 +34,7 @@
 #include <vlc_input.h>
 #include <vlc_vout.h>
 #include <vlc_keys.h>
+#include <vlc_vmem.h>
 
 #include "libvlc_internal.h"
 #include "media_internal.h" // libvlc_media_set_state()
@@ -242,7 +243,7 @@ input_event_changed( vlc_object_t * p_this, char const * psz_cmd,
     {
         libvlc_state_t libvlc_state;
 
-        switch ( var_GetInteger( p_input, "state" ) )
+        switch ( input_GetState( p_input ) )
         {
             case INIT_S:
                 libvlc_state = libvlc_NothingSpecial;
@@ -286,26 +287,31 @@ input_event_changed( vlc_object_t * p_this, char const * psz_cmd,
     }
     else if( newval.i_int == INPUT_EVENT_POSITION )
     {
-        if( var_GetInteger( p_input, "state" ) != PLAYING_S )
+        double f_position;
+        int64_t i_time;
+
+        if( input_GetState( p_input ) != PLAYING_S )
             return VLC_SUCCESS; /* Don't send the position while stopped */
 
         /* */
+        input_Control( p_input, INPUT_GET_POSITION, &f_position );
         event.type = libvlc_MediaPlayerPositionChanged;
-        event.u.media_player_position_changed.new_position =
-                                          var_GetFloat( p_input, "position" );
+        event.u.media_player_position_changed.new_position = f_position;
         libvlc_event_send( p_mi->p_event_manager, &event );
 
         /* */
+        input_Control( p_input, INPUT_GET_TIME, &i_time );
         event.type = libvlc_MediaPlayerTimeChanged;
-        event.u.media_player_time_changed.new_time =
-           from_mtime(var_GetTime( p_input, "time" ));
+        event.u.media_player_time_changed.new_time = from_mtime(i_time);
         libvlc_event_send( p_mi->p_event_manager, &event );
     }
     else if( newval.i_int == INPUT_EVENT_LENGTH )
     {
+        int64_t i_length;
+
+        input_Control( p_input, INPUT_GET_LENGTH, &i_length );
         event.type = libvlc_MediaPlayerLengthChanged;
-        event.u.media_player_length_changed.new_length =
-           from_mtime(var_GetTime( p_input, "length" ));
+        event.u.media_player_length_changed.new_length = from_mtime(i_length);
         libvlc_event_send( p_mi->p_event_manager, &event );
     }
     else if( newval.i_int == INPUT_EVENT_CACHE )
@@ -408,6 +414,7 @@ libvlc_media_player_new( libvlc_instance_t *instance )
     var_Create (mp, "vmem-data", VLC_VAR_ADDRESS);
     var_Create (mp, "vmem-setup", VLC_VAR_ADDRESS);
     var_Create (mp, "vmem-cleanup", VLC_VAR_ADDRESS);
+    var_Create (mp, "vmem-frame", VLC_VAR_ADDRESS);
     var_Create (mp, "vmem-chroma", VLC_VAR_STRING | VLC_VAR_DOINHERIT);
     var_Create (mp, "vmem-width", VLC_VAR_INTEGER | VLC_VAR_DOINHERIT);
     var_Create (mp, "vmem-height", VLC_VAR_INTEGER | VLC_VAR_DOINHERIT);
@@ -833,10 +840,26 @@ void libvlc_video_set_callbacks( libvlc_media_player_t *mp,
     var_SetAddress( mp, "vmem-lock", lock_cb );
     var_SetAddress( mp, "vmem-unlock", unlock_cb );
     var_SetAddress( mp, "vmem-display", display_cb );
+    var_SetAddress( mp, "vmem-frame", NULL );
+    var_SetAddress( mp, "vmem-data", opaque );
+    var_SetString( mp, "vout", "vmem" );
+}
+
+void libvlc_video_set_frame_callback( libvlc_media_player_t *mp,
+                                      libvlc_video_frame_cb frame_cb,
+                                      void *opaque )
+{
+    var_SetAddress( mp, "vmem-lock", NULL );
+    var_SetAddress( mp, "vmem-frame", frame_cb );
     var_SetAddress( mp, "vmem-data", opaque );
     var_SetString( mp, "vout", "vmem" );
 }
 
+void libvlc_video_frame_release( libvlc_video_frame_t *frame )
+{
+    frame->release( frame );
+}
+
 void libvlc_video_set_format_callbacks( libvlc_media_player_t *mp,
                                         libvlc_video_format_cb setup,
                                         libvlc_video_cleanup_cb cleanup )
@@ -1004,30 +1027,30 @@ libvlc_time_t libvlc_media_player_get_length(
                              libvlc_media_player_t *p_mi )
 {
     input_thread_t *p_input_thread;
-    libvlc_time_t i_time;
+    int64_t i_time;
 
     p_input_thread = libvlc_get_input_thread ( p_mi );
     if( !p_input_thread )
         return -1;
 
-    i_time = from_mtime(var_GetTime( p_input_thread, "length" ));
+    input_Control( p_input_thread, INPUT_GET_LENGTH, &i_time );
     vlc_object_release( p_input_thread );
 
-    return i_time;
+    return from_mtime(i_time);
 }
 
 libvlc_time_t libvlc_media_player_get_time( libvlc_media_player_t *p_mi )
 {
     input_thread_t *p_input_thread;
-    libvlc_time_t i_time;
+    int64_t i_time;
 
     p_input_thread = libvlc_get_input_thread ( p_mi );
     if( !p_input_thread )
         return -1;
 
-    i_time = from_mtime(var_GetTime( p_input_thread , "time" ));
+    input_Control( p_input_thread, INPUT_GET_TIME, &i_time );
     vlc_object_release( p_input_thread );
-    return i_time;
+    return from_mtime(i_time);
 }
 
 void libvlc_media_player_set_time( libvlc_media_player_t *p_mi,
@@ -1059,13 +1082,13 @@ void libvlc_media_player_set_position( libvlc_media_player_t *p_mi,
 float libvlc_media_player_get_position( libvlc_media_player_t *p_mi )
 {
     input_thread_t *p_input_thread;
-    float f_position;
+    double f_position;
 
     p_input_thread = libvlc_get_input_thread ( p_mi );
     if( !p_input_thread )
         return -1.0;
 
-    f_position = var_GetFloat( p_input_thread, "position" );
+    input_Control( p_input_thread, INPUT_GET_POSITION, &f_position );
     vlc_object_release( p_input_thread );
 
     return f_position;
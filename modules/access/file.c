@@ -53,6 +53,9 @@
 #   include <sys/vfs.h>
 #   include <linux/magic.h>
 #endif
+#ifdef HAVE_MMAP
+#   include <sys/mman.h>
+#endif
 
 #if defined( WIN32 )
 #   include <io.h>
@@ -82,8 +85,14 @@ struct access_sys_t
 
     /* */
     bool b_pace_control;
+
+    /* Memory mapping */
+    size_t page_mask;
 };
 
+/* Length of the file views handed to the stream */
+#define FILE_MMAP_SIZE (1 << 20)
+
 #if !defined (WIN32) && !defined (__OS2__)
 static bool IsRemote (int fd)
 {
@@ -139,6 +148,9 @@ static bool IsRemote (const char *path)
 #ifndef HAVE_POSIX_FADVISE
 # define posix_fadvise(fd, off, len, adv)
 #endif
+#ifndef HAVE_POSIX_MADVISE
+# define posix_madvise(addr, len, adv)
+#endif
 
 /*****************************************************************************
  * FileOpen: open the file
@@ -257,6 +269,19 @@ int FileOpen( vlc_object_t *p_this )
 # endif
 #endif
     }
+
+#ifdef HAVE_MMAP
+    /* Hand out views of the page cache rather than copies */
+    if (S_ISREG (st.st_mode) && var_InheritBool (p_access, "file-mmap")
+     && !IsRemote (fd, p_access->psz_filepath))
+    {
+        p_access->pf_read = NULL;
+        p_access->pf_block = FileBlock;
+        p_sys->page_mask = sysconf (_SC_PAGE_SIZE) - 1;
+        posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        msg_Dbg (p_access, "using memory mapping");
+    }
+#endif
     return VLC_SUCCESS;
 
 error:
@@ -271,7 +296,7 @@ void FileClose (vlc_object_t * p_this)
 {
     access_t     *p_access = (access_t*)p_this;
 
-    if (p_access->pf_read == NULL)
+    if (p_access->pf_block == DirBlock)
     {
         DirClose (p_this);
         return;
@@ -343,6 +368,69 @@ ssize_t FileRead( access_t *p_access, uint8_t *p_buffer, size_t i_len )
 }
 
 
+#ifdef HAVE_MMAP
+/*****************************************************************************
+ * Block: map the next part of a regular file
+ *****************************************************************************/
+block_t *FileBlock (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint64_t i_pos = p_access->info.i_pos;
+
+    /* The file may be growing */
+    if (i_pos >= p_access->info.i_size
+     || !(++p_sys->i_nb_reads % INPUT_FSTAT_NB_READS))
+    {
+        struct stat st;
+
+        if (fstat (p_sys->fd, &st) == 0
+         && p_access->info.i_size != (uint64_t)st.st_size)
+        {
+            p_access->info.i_size = st.st_size;
+            p_access->info.i_update |= INPUT_UPDATE_SIZE;
+        }
+    }
+    if (i_pos >= p_access->info.i_size)
+    {
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+
+    /* Mappings start on a page boundary */
+    uint64_t offset = i_pos & ~(uint64_t)p_sys->page_mask;
+    size_t inner = i_pos - offset;
+    size_t length = FILE_MMAP_SIZE;
+    if (offset + length > p_access->info.i_size)
+        length = p_access->info.i_size - offset;
+
+    /* Writable copy-on-write pages, as other blocks are writable */
+    void *addr = mmap (NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+                       p_sys->fd, offset);
+    if (addr == MAP_FAILED)
+    {
+        msg_Err (p_access, "memory mapping failed (%m)");
+        dialog_Fatal (p_access, _("File reading failed"),
+                      _("VLC could not read the file (%m)."));
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+    posix_madvise (addr, length, POSIX_MADV_SEQUENTIAL);
+    posix_madvise (addr, length, POSIX_MADV_WILLNEED);
+    /* Start reading the next view while this one is being consumed */
+    posix_fadvise (p_sys->fd, offset + length, FILE_MMAP_SIZE,
+                   POSIX_FADV_WILLNEED);
+
+    block_t *block = block_mmap_Alloc (addr, length);
+    if (unlikely(block == NULL))
+        return NULL;
+
+    block->p_buffer += inner;
+    block->i_buffer -= inner;
+    p_access->info.i_pos += block->i_buffer;
+    return block;
+}
+#endif
+
 /*****************************************************************************
  * Seek: seek to a specific location in a file
  *****************************************************************************/
@@ -48,12 +48,22 @@ static const char *const psz_recursive_list_text[] = {
         "This is useful if you add directories that contain playlist files " \
         "for instance. Use a comma-separated list of extensions." )
 
+#define MMAP_TEXT N_("Use file memory mapping")
+#define MMAP_LONGTEXT N_( \
+        "Read regular local files through memory mapping instead of " \
+        "copying their content. This saves CPU time and memory when many " \
+        "files are played at once, but VLC may crash if a file is " \
+        "truncated while it is being played." )
+
 vlc_module_begin ()
     set_description( N_("File input") )
     set_shortname( N_("File") )
     set_category( CAT_INPUT )
     set_subcategory( SUBCAT_INPUT_ACCESS )
     add_obsolete_string( "file-cat" )
+#ifdef HAVE_MMAP
+    add_bool( "file-mmap", false, MMAP_TEXT, MMAP_LONGTEXT, true )
+#endif
     set_capability( "access", 50 )
     add_shortcut( "file", "fd", "stream" )
     set_callbacks( FileOpen, FileClose )
@@ -54,6 +54,9 @@
 
 #include <assert.h>
 #include <limits.h>
+#ifdef HAVE_POLL
+#   include <poll.h>
+#endif
 
 #ifdef HAVE_LIBPROXY
 #    include <proxy.h>
@@ -99,6 +102,11 @@ static void Close( vlc_object_t * );
 #define UA_TEXT N_("User Agent")
 #define UA_LONGTEXT N_("You can use a custom User agent or use a known one")
 
+#define PIPELINE_TEXT N_("Pipeline range requests")
+#define PIPELINE_LONGTEXT N_("Request the next part of the file before " \
+    "the current one has been received. This hides the network latency " \
+    "between requests, but some servers and proxies do not support it.")
+
 vlc_module_begin ()
     set_description( N_("HTTP input") )
     set_capability( "access", 0 )
@@ -123,6 +131,8 @@ vlc_module_begin ()
         change_safe()
     add_bool( "http-forward-cookies", true, FORWARD_COOKIES_TEXT,
               FORWARD_COOKIES_LONGTEXT, true )
+    add_bool( "http-pipeline", false, PIPELINE_TEXT,
+              PIPELINE_LONGTEXT, true )
     /* 'itpc' = iTunes Podcast */
     add_shortcut( "http", "https", "unsv", "itpc", "icyx" )
     set_callbacks( Open, Close )
@@ -181,6 +191,8 @@ struct access_sys_t
     char       *psz_icy_title;
 
     uint64_t i_remaining;
+    uint64_t i_range;       /* length of the next range request */
+    uint64_t i_pipelined;   /* start of the range requested ahead */
 
     bool b_seekable;
     bool b_reconnect;
@@ -188,6 +200,9 @@ struct access_sys_t
     bool b_pace_control;
     bool b_persist;
     bool b_has_size;
+    bool b_range;           /* the response is a part of the file */
+    bool b_pipeline;
+    bool b_pipelined;       /* a request is waiting for its answer */
 
     vlc_array_t * cookies;
 };
@@ -205,6 +220,8 @@ static int Control( access_t *, int, va_list );
 /* */
 static int Connect( access_t *, uint64_t );
 static int Request( access_t *p_access, uint64_t i_tell );
+static int SendRequest( access_t *p_access, uint64_t i_tell );
+static int ReadAnswer( access_t *p_access, uint64_t i_tell );
 static void Disconnect( access_t * );
 
 /* Small Cookie utilities. Cookies support is partial. */
@@ -219,13 +236,136 @@ static void AuthReply( access_t *p_acces, const char *psz_prefix,
 static int AuthCheckReply( access_t *p_access, const char *psz_header,
                            vlc_url_t *p_url, http_auth_t *p_auth );
 
+/*****************************************************************************
+ * Persistent connections
+ *****************************************************************************
+ * Once an answer has shown that the server keeps the connection open, the
+ * file is requested in ranges of growing length, so that every response
+ * ends at a known position and the connection stays usable for the next
+ * request. Until then, a single open-ended range is requested. Idle
+ * connections are kept in a pool shared by all the HTTP
+ * accesses of the process: a seek, the next HLS or DASH segment or the next
+ * item of the playlist skip the TCP handshake when they go to the same
+ * server. TLS sessions belong to their access, so they are only reused
+ * within it.
+ *****************************************************************************/
+#define HTTP_RANGE_MIN  (128 << 10)
+#define HTTP_RANGE_MAX  (16 << 20)
+/* Seeking forward by less than this reads through the current response */
+#define HTTP_SKIP_MAX   (64 << 10)
+/* Finishing a response shorter than this is cheaper than a new connection */
+#define HTTP_DRAIN_MAX  (32 << 10)
+
+#define HTTP_POOL_SIZE  8
+#define HTTP_POOL_IDLE  (30 * CLOCK_FREQ)
+
+static vlc_mutex_t pool_lock = VLC_STATIC_MUTEX;
+static struct
+{
+    char   *psz_host;
+    int     i_port;
+    int     fd;
+    mtime_t i_date;
+} pool[HTTP_POOL_SIZE];
+static unsigned pool_count = 0;
+static unsigned pool_users = 0;
+
+static void PoolRemove( unsigned i )
+{
+    free( pool[i].psz_host );
+    memmove( &pool[i], &pool[i + 1], (pool_count - i - 1) * sizeof (pool[0]) );
+    pool_count--;
+}
+
+/* Takes an idle connection to the given server out of the pool */
+static int PoolGet( const char *psz_host, int i_port )
+{
+    const mtime_t now = mdate();
+    int fd = -1;
+
+    vlc_mutex_lock( &pool_lock );
+    for( unsigned i = pool_count; i-- > 0; )
+    {
+        if( now - pool[i].i_date > HTTP_POOL_IDLE )
+        {
+            net_Close( pool[i].fd );
+            PoolRemove( i );
+            continue;
+        }
+        if( fd != -1 || pool[i].i_port != i_port
+         || strcasecmp( pool[i].psz_host, psz_host ) )
+            continue;
+
+        /* An idle connection has nothing to read, unless the server closed
+         * it in the meantime */
+        struct pollfd ufd = { .fd = pool[i].fd, .events = POLLIN, };
+        if( poll( &ufd, 1, 0 ) == 0 )
+            fd = pool[i].fd;
+        else
+            net_Close( pool[i].fd );
+        PoolRemove( i );
+    }
+    vlc_mutex_unlock( &pool_lock );
+    return fd;
+}
+
+/* Gives an idle connection to the pool, closing the oldest one if full */
+static void PoolPut( const char *psz_host, int i_port, int fd )
+{
+    char *psz_dup = strdup( psz_host );
+    if( unlikely(psz_dup == NULL) )
+    {
+        net_Close( fd );
+        return;
+    }
+
+    vlc_mutex_lock( &pool_lock );
+    if( pool_count == HTTP_POOL_SIZE )
+    {
+        net_Close( pool[0].fd );
+        PoolRemove( 0 );
+    }
+    pool[pool_count].psz_host = psz_dup;
+    pool[pool_count].i_port = i_port;
+    pool[pool_count].fd = fd;
+    pool[pool_count].i_date = mdate();
+    pool_count++;
+    vlc_mutex_unlock( &pool_lock );
+}
+
+static void PoolHold( void )
+{
+    vlc_mutex_lock( &pool_lock );
+    pool_users++;
+    vlc_mutex_unlock( &pool_lock );
+}
+
+/* Closes the idle connections when the last HTTP access goes away */
+static void PoolRelease( void )
+{
+    vlc_mutex_lock( &pool_lock );
+    assert( pool_users > 0 );
+    if( --pool_users == 0 )
+        while( pool_count > 0 )
+        {
+            net_Close( pool[pool_count - 1].fd );
+            PoolRemove( pool_count - 1 );
+        }
+    vlc_mutex_unlock( &pool_lock );
+}
+
 /*****************************************************************************
  * Open:
  *****************************************************************************/
 static int Open( vlc_object_t *p_this )
 {
     access_t *p_access = (access_t*)p_this;
-    return OpenWithCookies( p_this, p_access->psz_access, 5, NULL );
+
+    PoolHold();
+    int ret = OpenWithCookies( p_this, p_access->psz_access, 5, NULL );
+    if( ret != VLC_SUCCESS )
+        PoolRelease();
+    return ret;
 }
 
 /**
@@ -285,8 +425,11 @@ static int OpenWithCookies( vlc_object_t *p_this, const char *psz_access,
     p_sys->psz_icy_genre = NULL;
     p_sys->psz_icy_title = NULL;
     p_sys->i_remaining = 0;
+    p_sys->i_range = HTTP_RANGE_MIN;
     p_sys->b_persist = false;
     p_sys->b_has_size = false;
+    p_sys->b_range = false;
+    p_sys->b_pipelined = false;
     p_access->info.i_size = 0;
     p_access->info.i_pos  = 0;
     p_access->info.b_eof  = false;
@@ -500,6 +643,7 @@ static int OpenWithCookies( vlc_object_t *p_this, const char *psz_access,
 
     p_sys->b_reconnect = var_InheritBool( p_access, "http-reconnect" );
     p_sys->b_continuous = var_InheritBool( p_access, "http-continuous" );
+    p_sys->b_pipeline = var_InheritBool( p_access, "http-pipeline" );
 
 connect:
     /* Connect */
@@ -584,6 +728,7 @@ connect:
         p_access->psz_location = strdup( p_sys->psz_location
                                        + strlen( psz_protocol ) + 3 );
         /* Clean up current Open() run */
+        Disconnect( p_access );
         vlc_UrlClean( &p_sys->url );
         http_auth_Reset( &p_sys->auth );
         vlc_UrlClean( &p_sys->proxy );
@@ -595,7 +740,6 @@ connect:
         free( p_sys->psz_user_agent );
         free( p_sys->psz_referrer );
 
-        Disconnect( p_access );
         cookies = p_sys->cookies;
 #ifdef HAVE_ZLIB_H
         inflateEnd( &p_sys->inflate.stream );
@@ -678,6 +822,8 @@ connect:
     return VLC_SUCCESS;
 
 error:
+    Disconnect( p_access );
+
     vlc_UrlClean( &p_sys->url );
     vlc_UrlClean( &p_sys->proxy );
     free( p_sys->psz_proxy_passbuf );
@@ -687,8 +833,6 @@ error:
     free( p_sys->psz_user_agent );
     free( p_sys->psz_referrer );
 
-    Disconnect( p_access );
-
     if( p_sys->cookies )
     {
         int i;
@@ -712,6 +856,9 @@ static void Close( vlc_object_t *p_this )
     access_t     *p_access = (access_t*)p_this;
     access_sys_t *p_sys = p_access->p_sys;
 
+    Disconnect( p_access );
+    PoolRelease();
+
     vlc_UrlClean( &p_sys->url );
     http_auth_Reset( &p_sys->auth );
     vlc_UrlClean( &p_sys->proxy );
@@ -728,8 +875,6 @@ static void Close( vlc_object_t *p_this )
     free( p_sys->psz_user_agent );
     free( p_sys->psz_referrer );
 
-    Disconnect( p_access );
-
     if( p_sys->cookies )
     {
         int i;
@@ -796,6 +941,82 @@ static int ReadData( access_t *p_access, int *pi_read,
     return VLC_SUCCESS;
 }
 
+/* Discards the next i_skip bytes of the current response */
+static int Skip( access_t *p_access, uint64_t i_skip )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint8_t p_buffer[4096];
+
+    assert( p_sys->b_has_size && i_skip <= p_sys->i_remaining );
+    while( i_skip > 0 )
+    {
+        int i_read;
+
+        if( ReadData( p_access, &i_read, p_buffer,
+                      __MIN( i_skip, sizeof (p_buffer) ) ) || i_read <= 0 )
+            return VLC_EGENERIC;
+        p_access->info.i_pos += i_read;
+        p_sys->i_remaining -= i_read;
+        i_skip -= i_read;
+    }
+    return VLC_SUCCESS;
+}
+
+/* Whether the current response is a range that is followed by more data */
+static bool HasNextRange( access_t *p_access )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint64_t i_end = p_access->info.i_pos + p_sys->i_remaining;
+
+    return p_sys->b_range && p_sys->b_has_size
+        && ( p_access->info.i_size == 0 || i_end < p_access->info.i_size );
+}
+
+/* Requests the range following the current response, ahead of time */
+static void PipelineRange( access_t *p_access )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    if( !p_sys->b_pipeline || p_sys->b_pipelined || !p_sys->b_persist
+     || p_sys->b_chunked || p_sys->i_icy_meta > 0
+     || p_sys->i_remaining > p_sys->i_range / 4 || !HasNextRange( p_access ) )
+        return;
+
+    p_sys->i_pipelined = p_access->info.i_pos + p_sys->i_remaining;
+    if( p_sys->i_range < HTTP_RANGE_MAX )
+        p_sys->i_range *= 2;
+    if( SendRequest( p_access, p_sys->i_pipelined ) == VLC_SUCCESS )
+        p_sys->b_pipelined = true;
+    else /* the rest of the current response may still be readable */
+        p_sys->b_persist = false;
+}
+
+/* Gets the range following the complete current response */
+static int NextRange( access_t *p_access )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint64_t i_pos = p_access->info.i_pos;
+
+    if( p_sys->b_pipelined )
+    {
+        assert( p_sys->i_pipelined == i_pos );
+        p_sys->b_pipelined = false;
+        if( ReadAnswer( p_access, i_pos ) == VLC_SUCCESS )
+            return VLC_SUCCESS;
+    }
+    else if( p_sys->b_persist )
+    {
+        if( p_sys->i_range < HTTP_RANGE_MAX )
+            p_sys->i_range *= 2;
+        if( Request( p_access, i_pos ) == VLC_SUCCESS )
+            return VLC_SUCCESS;
+    }
+
+    msg_Dbg( p_access, "requesting the next range on a new connection" );
+    Disconnect( p_access );
+    return Connect( p_access, i_pos ) ? VLC_EGENERIC : VLC_SUCCESS;
+}
+
 /*****************************************************************************
  * Read: Read up to i_len bytes from the http connection and place in
  * p_buffer. Return the actual number of bytes read
@@ -809,12 +1030,19 @@ static ssize_t Read( access_t *p_access, uint8_t *p_buffer, size_t i_len )
     if( p_sys->fd == -1 )
         goto fatal;
 
+    if( p_sys->b_has_size && p_sys->i_remaining == 0
+     && HasNextRange( p_access ) && NextRange( p_access ) )
+        goto fatal;
+
     if( p_sys->b_has_size )
     {
         /* Remaining bytes in the file */
-        uint64_t remainder = p_access->info.i_size - p_access->info.i_pos;
-        if( remainder < i_len )
-            i_len = remainder;
+        if( p_access->info.i_size > 0 )
+        {
+            uint64_t remainder = p_access->info.i_size - p_access->info.i_pos;
+            if( remainder < i_len )
+                i_len = remainder;
+        }
 
         /* Remaining bytes in the response */
         if( p_sys->i_remaining < i_len )
@@ -885,9 +1113,11 @@ static ssize_t Read( access_t *p_access, uint8_t *p_buffer, size_t i_len )
     p_access->info.i_pos += i_read;
     if( p_sys->b_has_size )
     {
-        assert( p_access->info.i_pos <= p_access->info.i_size );
+        assert( p_access->info.i_size == 0
+             || p_access->info.i_pos <= p_access->info.i_size );
         assert( (unsigned)i_read <= p_sys->i_remaining );
         p_sys->i_remaining -= i_read;
+        PipelineRange( p_access );
     }
 
     return i_read;
@@ -1004,13 +1234,51 @@ static ssize_t ReadCompressed( access_t *p_access, uint8_t *p_buffer,
 #endif
 
 /*****************************************************************************
- * Seek: close and re-open a connection at the right place
+ * SeekPersistent: move within the current connection if it is cheap enough
+ *****************************************************************************/
+static int SeekPersistent( access_t *p_access, uint64_t i_pos )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->fd == -1 || !p_sys->b_persist || !p_sys->b_has_size
+     || p_sys->b_chunked || p_sys->i_icy_meta > 0 )
+        return VLC_EGENERIC;
+#ifdef HAVE_ZLIB_H
+    if( p_sys->b_compressed )
+        return VLC_EGENERIC;
+#endif
+
+    /* Forward, within the current response: read through */
+    if( i_pos >= p_access->info.i_pos
+     && i_pos - p_access->info.i_pos <= p_sys->i_remaining
+     && i_pos - p_access->info.i_pos <= HTTP_SKIP_MAX )
+        return Skip( p_access, i_pos - p_access->info.i_pos );
+
+    /* Otherwise finish the response and send a new request */
+    if( p_sys->i_remaining > HTTP_DRAIN_MAX
+     || Skip( p_access, p_sys->i_remaining ) )
+        return VLC_EGENERIC;
+
+    if( p_sys->b_pipelined )
+    {
+        p_sys->b_pipelined = false;
+        if( ReadAnswer( p_access, p_sys->i_pipelined ) )
+            return VLC_EGENERIC;
+        return SeekPersistent( p_access, i_pos );
+    }
+
+    p_sys->i_range = HTTP_RANGE_MIN;
+    return Request( p_access, i_pos );
+}
+
+/*****************************************************************************
+ * Seek: reuse the connection or re-open one at the right place
  *****************************************************************************/
 static int Seek( access_t *p_access, uint64_t i_pos )
 {
-    msg_Dbg( p_access, "trying to seek to %"PRId64, i_pos );
+    access_sys_t *p_sys = p_access->p_sys;
 
-    Disconnect( p_access );
+    msg_Dbg( p_access, "trying to seek to %"PRId64, i_pos );
 
     if( p_access->info.i_size
      && i_pos >= p_access->info.i_size ) {
@@ -1023,6 +1291,15 @@ static int Seek( access_t *p_access, uint64_t i_pos )
         }
         return retval;
     }
+
+    if( SeekPersistent( p_access, i_pos ) == VLC_SUCCESS )
+    {
+        p_access->info.b_eof = false;
+        return VLC_SUCCESS;
+    }
+
+    Disconnect( p_access );
+    p_sys->i_range = HTTP_RANGE_MIN;
     if( Connect( p_access, i_pos ) )
     {
         msg_Err( p_access, "seek failed" );
@@ -1137,12 +1414,33 @@ static int Connect( access_t *p_access, uint64_t i_tell )
     p_sys->i_remaining = 0;
     p_sys->b_persist = false;
     p_sys->b_has_size = false;
+    p_sys->b_range = false;
     p_access->info.i_size = 0;
     p_access->info.i_pos  = i_tell;
     p_access->info.b_eof  = false;
 
-    /* Open connection */
+    /* Reuse an idle connection */
     assert( p_sys->fd == -1 ); /* No open sockets (leaking fds is BAD) */
+    if( !p_sys->b_ssl )
+    {
+        p_sys->fd = PoolGet( srv.psz_host, srv.i_port );
+        if( p_sys->fd != -1 )
+        {
+            msg_Dbg( p_access, "reusing connection to %s:%d",
+                     srv.psz_host, srv.i_port );
+            p_sys->i_code = 0;
+            p_sys->b_persist = true; /* it was left open by a former answer */
+            if( Request( p_access, i_tell ) == VLC_SUCCESS )
+                return 0;
+            /* Retry on a new connection only if the server did not answer */
+            if( p_sys->i_code != 0 || !vlc_object_alive (p_access)
+             || p_sys->b_error )
+                return -2;
+            p_sys->b_persist = false;
+        }
+    }
+
+    /* Open connection */
     p_sys->fd = net_ConnectTCP( p_access, srv.psz_host, srv.i_port );
     if( p_sys->fd == -1 )
     {
@@ -1232,13 +1530,19 @@ static int Connect( access_t *p_access, uint64_t i_tell )
 
 
 static int Request( access_t *p_access, uint64_t i_tell )
+{
+    if( SendRequest( p_access, i_tell ) )
+    {
+        Disconnect( p_access );
+        return VLC_EGENERIC;
+    }
+    return ReadAnswer( p_access, i_tell );
+}
+
+static int SendRequest( access_t *p_access, uint64_t i_tell )
 {
     access_sys_t   *p_sys = p_access->p_sys;
-    char           *psz ;
     v_socket_t     *pvs = p_sys->p_vs;
-    p_sys->b_persist = false;
-
-    p_sys->i_remaining = 0;
 
     const char *psz_path = p_sys->url.psz_path;
     if( !psz_path || !*psz_path )
@@ -1266,13 +1570,17 @@ static int Request( access_t *p_access, uint64_t i_tell )
         net_Printf( p_access, p_sys->fd, pvs, "Referer: %s\r\n",
                     p_sys->psz_referrer);
     }
-    /* Offset */
+    /* Offset, bounded only if the connection is known to stay open after
+     * the range, as a new connection per range would be much slower */
     if( p_sys->i_version == 1 && ! p_sys->b_continuous )
     {
-        p_sys->b_persist = true;
-        net_Printf( p_access, p_sys->fd, pvs,
-                    "Range: bytes=%"PRIu64"-\r\n", i_tell );
-        net_Printf( p_access, p_sys->fd, pvs, "Connection: close\r\n" );
+        if( p_sys->b_persist )
+            net_Printf( p_access, p_sys->fd, pvs,
+                        "Range: bytes=%"PRIu64"-%"PRIu64"\r\n",
+                        i_tell, i_tell + p_sys->i_range - 1 );
+        else
+            net_Printf( p_access, p_sys->fd, pvs,
+                        "Range: bytes=%"PRIu64"-\r\n", i_tell );
     }
 
     /* Cookies */
@@ -1316,9 +1624,29 @@ static int Request( access_t *p_access, uint64_t i_tell )
     if( net_Printf( p_access, p_sys->fd, pvs, "\r\n" ) < 0 )
     {
         msg_Err( p_access, "failed to send request" );
-        Disconnect( p_access );
         return VLC_EGENERIC;
     }
+    return VLC_SUCCESS;
+}
+
+static int ReadAnswer( access_t *p_access, uint64_t i_tell )
+{
+    access_sys_t   *p_sys = p_access->p_sys;
+    char           *psz ;
+    v_socket_t     *pvs = p_sys->p_vs;
+    int64_t         i_length = -1;
+    uint64_t        i_range_start = 0, i_range_end = 0, i_range_size = 0;
+    bool            b_range = false;
+
+    p_sys->b_persist = false;
+    p_sys->b_has_size = false;
+    p_sys->b_range = false;
+    p_sys->b_chunked = false;
+    p_sys->i_chunk = 0;
+    p_sys->i_remaining = 0;
+    p_sys->i_icy_offset = i_tell;
+    p_access->info.i_pos = i_tell;
+    p_access->info.b_eof = false;
 
     /* Read Answer */
     if( ( psz = net_Gets( p_access, p_sys->fd, pvs ) ) == NULL )
@@ -1330,6 +1658,8 @@ static int Request( access_t *p_access, uint64_t i_tell )
     {
         p_sys->psz_protocol = "HTTP";
         p_sys->i_code = atoi( &psz[9] );
+        /* HTTP/1.1 connections are persistent unless told otherwise */
+        p_sys->b_persist = psz[7] == '1' && p_sys->i_version == 1;
     }
     else if( !strncmp( psz, "ICY", 3 ) )
     {
@@ -1415,29 +1745,23 @@ static int Request( access_t *p_access, uint64_t i_tell )
 
         if( !strcasecmp( psz, "Content-Length" ) )
         {
-            uint64_t i_size = i_tell + (p_sys->i_remaining = (uint64_t)atoll( p ));
-            if(i_size > p_access->info.i_size) {
-                p_sys->b_has_size = true;
-                p_access->info.i_size = i_size;
-            }
-            msg_Dbg( p_access, "this frame size=%"PRIu64, p_sys->i_remaining );
+            i_length = atoll( p );
+            msg_Dbg( p_access, "this frame size=%"PRId64, i_length );
         }
         else if( !strcasecmp( psz, "Content-Range" ) ) {
-            uint64_t i_ntell = i_tell;
-            uint64_t i_nend = (p_access->info.i_size > 0)?(p_access->info.i_size - 1):i_tell;
-            uint64_t i_nsize = p_access->info.i_size;
-            sscanf(p,"bytes %"SCNu64"-%"SCNu64"/%"SCNu64,&i_ntell,&i_nend,&i_nsize);
-            if(i_nend > i_ntell ) {
-                p_access->info.i_pos = i_ntell;
-                p_sys->i_icy_offset  = i_ntell;
-                p_sys->i_remaining = i_nend+1-i_ntell;
-                uint64_t i_size = (i_nsize > i_nend) ? i_nsize : (i_nend + 1);
-                if(i_size > p_access->info.i_size) {
-                    p_sys->b_has_size = true;
-                    p_access->info.i_size = i_size;
-                }
-                msg_Dbg( p_access, "stream size=%"PRIu64",pos=%"PRIu64",remaining=%"PRIu64,
-                         i_nsize, i_ntell, p_sys->i_remaining);
+            int i_total = 0;
+            if( sscanf( p, "bytes %"SCNu64"-%"SCNu64"/%n", &i_range_start,
+                        &i_range_end, &i_total ) == 2
+             && i_range_end >= i_range_start )
+            {
+                b_range = true;
+                /* The total size may be unknown ("*") */
+                i_range_size = 0;
+                if( i_total > 0 )
+                    sscanf( p + i_total, "%"SCNu64, &i_range_size );
+                msg_Dbg( p_access, "stream size=%"PRIu64",pos=%"PRIu64
+                         ",remaining=%"PRIu64, i_range_size, i_range_start,
+                         i_range_end + 1 - i_range_start );
             }
         }
         else if( !strcasecmp( psz, "Connection" ) ) {
@@ -1616,10 +1940,36 @@ static int Request( access_t *p_access, uint64_t i_tell )
 
         free( psz );
     }
+
+    if( b_range && p_sys->i_code == 206 && !p_sys->b_chunked )
+    {
+        /* A part of the file */
+        p_access->info.i_pos = i_range_start;
+        p_sys->i_icy_offset  = i_range_start;
+        p_sys->i_remaining = i_range_end + 1 - i_range_start;
+        p_sys->b_has_size = true;
+        p_sys->b_range = true;
+        if( i_range_size > 0 )
+            p_access->info.i_size = __MAX( i_range_size, i_range_end + 1 );
+        else if( p_access->info.i_size <= i_range_end )
+            p_access->info.i_size = 0; /* unknown */
+    }
+    else if( i_length >= 0 && !p_sys->b_chunked )
+    {
+        p_sys->i_remaining = i_length;
+        p_sys->b_has_size = true;
+        if( i_tell + i_length > p_access->info.i_size )
+            p_access->info.i_size = i_tell + i_length;
+    }
+    else
+        /* The end of the response is not known in advance */
+        p_sys->b_persist = false;
+
     /* We close the stream for zero length data, unless of course the
      * server has already promised to do this for us.
      */
-    if( p_sys->b_has_size && p_sys->i_remaining == 0 && p_sys->b_persist ) {
+    if( p_sys->b_has_size && p_sys->i_remaining == 0 && p_sys->b_persist
+     && !HasNextRange( p_access ) ) {
         Disconnect( p_access );
     }
     return VLC_SUCCESS;
@@ -1641,13 +1991,24 @@ static void Disconnect( access_t *p_access )
         vlc_tls_ClientDelete( p_sys->p_tls );
         p_sys->p_tls = NULL;
         p_sys->p_vs = NULL;
+        net_Close( p_sys->fd );
+        p_sys->fd = -1;
     }
     if( p_sys->fd != -1)
     {
-        net_Close(p_sys->fd);
+        /* Keep the connection if it is back to its idle state */
+        if( p_sys->b_persist && p_sys->b_has_size && p_sys->i_remaining == 0
+         && !p_sys->b_pipelined && !p_sys->b_error )
+        {
+            const vlc_url_t *srv = p_sys->b_proxy ? &p_sys->proxy
+                                                  : &p_sys->url;
+            PoolPut( srv->psz_host, srv->i_port, p_sys->fd );
+        }
+        else
+            net_Close(p_sys->fd);
         p_sys->fd = -1;
     }
-
+    p_sys->b_pipelined = false;
 }
 
 /*****************************************************************************
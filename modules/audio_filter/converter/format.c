@@ -38,6 +38,7 @@
 #include <vlc_aout.h>
 #include <vlc_block.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 
 /*****************************************************************************
  * Module descriptor
@@ -344,6 +345,58 @@ static block_t *Fl32toS16(filter_t *filter, block_t *b)
     b->i_buffer /= 2;
     return b;
 }
+#if defined (CAN_COMPILE_SSE2)
+VLC_SSE2
+static block_t *Fl32toS16SSE2(filter_t *filter, block_t *b)
+{
+    VLC_UNUSED(filter);
+    static const float bounds[3][4] = {
+        { 32768.f, 32768.f, 32768.f, 32768.f },
+        { 32767.f, 32767.f, 32767.f, 32767.f },
+        { -32768.f, -32768.f, -32768.f, -32768.f },
+    };
+    float   *src = (float *)b->p_buffer;
+    int16_t *dst = (int16_t *)src;
+    size_t   i = b->i_buffer / 4;
+
+    /* Scale, clip, round and pack eight samples at a time. The output is
+     * written behind the input, so converting in place is safe. */
+    for (; i >= 8; i -= 8, src += 8, dst += 8)
+        __asm__ volatile (
+            "movups     (%2), %%xmm2\n" /* bounds[] may not be aligned */
+            "movups   16(%2), %%xmm3\n"
+            "movups   32(%2), %%xmm4\n"
+            "movups     (%1), %%xmm0\n"
+            "movups   16(%1), %%xmm1\n"
+            "mulps    %%xmm2, %%xmm0\n"
+            "mulps    %%xmm2, %%xmm1\n"
+            "minps    %%xmm3, %%xmm0\n"
+            "minps    %%xmm3, %%xmm1\n"
+            "maxps    %%xmm4, %%xmm0\n"
+            "maxps    %%xmm4, %%xmm1\n"
+            "cvtps2dq %%xmm0, %%xmm0\n"
+            "cvtps2dq %%xmm1, %%xmm1\n"
+            "packssdw %%xmm1, %%xmm0\n"
+            "movdqu   %%xmm0, (%0)\n"
+            :
+            : "r" (dst), "r" (src), "r" (bounds)
+            : "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4");
+
+    for (; i > 0; i--) {
+        union { float f; int32_t i; } u;
+        u.f = *src++ + 384.0;
+        if (u.i > 0x43c07fff)
+            *dst++ = 32767;
+        else if (u.i < 0x43bf8000)
+            *dst++ = -32768;
+        else
+            *dst++ = u.i - 0x43c00000;
+    }
+
+    b->i_buffer /= 2;
+    return b;
+}
+#endif
 static block_t *Fl64toS16(filter_t *filter, block_t *b)
 {
     VLC_UNUSED(filter);
@@ -579,6 +632,11 @@ static const struct {
 
 static cvt_direct_t FindDirect(vlc_fourcc_t src, vlc_fourcc_t dst)
 {
+#if defined (CAN_COMPILE_SSE2)
+    if (src == VLC_CODEC_FL32 && dst == VLC_CODEC_S16N
+     && (vlc_CPU() & CPU_CAPABILITY_SSE2))
+        return Fl32toS16SSE2;
+#endif
     for (int i = 0; cvt_directs[i].convert; i++) {
         if (cvt_directs[i].src == src &&
             cvt_directs[i].dst == dst)
@@ -34,6 +34,8 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_charset.h>
+#include <vlc_atomic.h>
+#include <vlc_cpu.h>
 
 #include <vlc_aout.h>
 #include <vlc_filter.h>
@@ -41,7 +43,6 @@
 #include "equalizer_presets.h"
 /* TODO:
  *  - add tables for other rates ( 22500, 11250, ...)
- *  - optimize a bit (you can hardly do slower ;)
  *  - add tables for more bands (15 and 32 would be cool), maybe with auto coeffs
  *  computation (not too hard once the Q is found).
  *  - support for external preset
@@ -94,32 +95,55 @@ vlc_module_end ()
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
+/* Channels are processed in groups of up to EQZ_WIDTH_MAX lanes */
+#define EQZ_WIDTH_MAX 4
+#define EQZ_LANES_MAX ((AOUT_CHAN_MAX + EQZ_WIDTH_MAX - 1) & ~(EQZ_WIDTH_MAX - 1))
+/* Number of frames filtered at once */
+#define EQZ_CHUNK 128
+
+/* The block function must be specialized for each processing width */
+#ifdef __GNUC__
+# define EQZ_INLINE inline __attribute__ ((always_inline))
+#else
+# define EQZ_INLINE inline
+#endif
+
+typedef struct
+{
+    double x[2][EQZ_LANES_MAX];
+    double y[EQZ_BANDS_MAX][2][EQZ_LANES_MAX];
+} eqz_state_t;
+
 struct filter_sys_t
 {
     /* Filter static config */
     int i_band;
-    float *f_alpha;
-    float *f_beta;
-    float *f_gamma;
+    double f_alpha[EQZ_BANDS_MAX];
+    double f_beta[EQZ_BANDS_MAX];
+    double f_gamma[EQZ_BANDS_MAX];
+    unsigned i_lanes;   /* Channels rounded up to the processing width */
+    void (*pf_block)( const filter_sys_t *, eqz_state_t *, double *,
+                      unsigned );
 
     float f_newpreamp;
     char *psz_newbands;
     bool b_first;
 
-    /* Filter dyn config */
-    float *f_amp;   /* Per band amp */
+    /* Filter dyn config, written by the callbacks */
+    float f_amp[EQZ_BANDS_MAX];   /* Per band amp */
     float f_gamp;   /* Global preamp */
     bool b_2eqz;
 
-    /* Filter state */
-    float x[32][2];
-    float y[32][128][2];
+    vlc_mutex_t lock;
+    vlc_atomic_t changed; /* The dyn config was modified */
 
-    /* Second filter state */
-    float x2[32][2];
-    float y2[32][128][2];
+    /* Dyn config in use by the audio thread */
+    double amp[EQZ_BANDS_MAX];
+    double gamp;
+    bool twopass;
 
-    vlc_mutex_t lock;
+    /* Filter state, then second filter state */
+    eqz_state_t state[2];
 };
 
 static block_t *DoWork( filter_t *, block_t * );
@@ -276,14 +300,109 @@ static inline float EqzConvertdB( float db )
     return EQZ_IN_FACTOR * ( pow( 10, db / 20.0 ) - 1.0 );
 }
 
+/**
+ * Runs the band pass filters bank over a block of frames, in place.
+ *
+ * Each frame holds i_lanes channels, processed i_width at a time with all
+ * the bands, so that the state of a group of channels stays in registers
+ * (or at least in the L1 cache) for the whole block. The output is the
+ * scaled down input plus the weighted sum of the bands, as the input of the
+ * next pass or before the preamp.
+ */
+static EQZ_INLINE void EqzBlock( const filter_sys_t *p_sys, eqz_state_t *s,
+                                 double *buf, unsigned i_count,
+                                 const unsigned i_width )
+{
+    const unsigned i_lanes = p_sys->i_lanes;
+    const int i_band = p_sys->i_band;
+
+    for( unsigned g = 0; g < i_lanes; g += i_width )
+    {
+        double x[2][EQZ_WIDTH_MAX];
+        double y[EQZ_BANDS_MAX][2][EQZ_WIDTH_MAX];
+
+        for( unsigned l = 0; l < i_width; l++ )
+        {
+            x[0][l] = s->x[0][g + l];
+            x[1][l] = s->x[1][g + l];
+            for( int j = 0; j < i_band; j++ )
+            {
+                y[j][0][l] = s->y[j][0][g + l];
+                y[j][1][l] = s->y[j][1][g + l];
+            }
+        }
+
+        for( unsigned i = 0; i < i_count; i++ )
+        {
+            double *v = buf + i * i_lanes + g;
+            double d[EQZ_WIDTH_MAX], o[EQZ_WIDTH_MAX];
+
+            for( unsigned l = 0; l < i_width; l++ )
+            {
+                d[l] = v[l] - x[1][l];
+                x[1][l] = x[0][l];
+                x[0][l] = v[l];
+                o[l] = EQZ_IN_FACTOR * v[l];
+            }
+
+            for( int j = 0; j < i_band; j++ )
+            {
+                const double alpha = p_sys->f_alpha[j];
+                const double beta  = p_sys->f_beta[j];
+                const double gamma = p_sys->f_gamma[j];
+                const double amp   = p_sys->amp[j];
+
+                for( unsigned l = 0; l < i_width; l++ )
+                {
+                    double r = alpha * d[l] + gamma * y[j][0][l]
+                                            - beta  * y[j][1][l];
+
+                    y[j][1][l] = y[j][0][l];
+                    y[j][0][l] = r;
+                    o[l] += amp * r;
+                }
+            }
+
+            for( unsigned l = 0; l < i_width; l++ )
+                v[l] = o[l];
+        }
+
+        for( unsigned l = 0; l < i_width; l++ )
+        {
+            s->x[0][g + l] = x[0][l];
+            s->x[1][g + l] = x[1][l];
+            for( int j = 0; j < i_band; j++ )
+            {
+                s->y[j][0][g + l] = y[j][0][l];
+                s->y[j][1][g + l] = y[j][1][l];
+            }
+        }
+    }
+}
+
+/* Two lanes fit the SSE2 registers that every x86-64 CPU has */
+static void EqzBlock2( const filter_sys_t *p_sys, eqz_state_t *s,
+                       double *buf, unsigned i_count )
+{
+    EqzBlock( p_sys, s, buf, i_count, 2 );
+}
+
+#if defined (CAN_COMPILE_AVX)
+VLC_AVX
+static void EqzBlock4( const filter_sys_t *p_sys, eqz_state_t *s,
+                       double *buf, unsigned i_count )
+{
+    EqzBlock( p_sys, s, buf, i_count, 4 );
+}
+#endif
+
 static int EqzInit( filter_t *p_filter, int i_rate )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
     const eqz_config_t *p_cfg;
-    int i, ch;
+    int i;
     vlc_value_t val1, val2, val3;
     vlc_object_t *p_aout = p_filter->p_parent;
-    int i_ret = VLC_ENOMEM;
 
     /* Select the config */
     if( i_rate == 48000 )
@@ -303,12 +422,6 @@ static int EqzInit( filter_t *p_filter, int i_rate )
 
     /* Create the static filter config */
     p_sys->i_band = p_cfg->i_band;
-    p_sys->f_alpha = malloc( p_sys->i_band * sizeof(float) );
-    p_sys->f_beta  = malloc( p_sys->i_band * sizeof(float) );
-    p_sys->f_gamma = malloc( p_sys->i_band * sizeof(float) );
-    if( !p_sys->f_alpha || !p_sys->f_beta || !p_sys->f_gamma )
-        goto error;
-
     for( i = 0; i < p_sys->i_band; i++ )
     {
         p_sys->f_alpha[i] = p_cfg->band[i].f_alpha;
@@ -316,34 +429,36 @@ static int EqzInit( filter_t *p_filter, int i_rate )
         p_sys->f_gamma[i] = p_cfg->band[i].f_gamma;
     }
 
+    /* Pick the widest processing lanes available for the channels */
+    unsigned i_width = 2;
+#if defined (CAN_COMPILE_AVX)
+    if( vlc_CPU() & CPU_CAPABILITY_AVX )
+        i_width = 4;
+#endif
+    p_sys->i_lanes = ( aout_FormatNbChannels( &p_filter->fmt_in.audio )
+                       + i_width - 1 ) & ~( i_width - 1 );
+    if( p_sys->i_lanes > EQZ_LANES_MAX )
+    {
+        msg_Err( p_filter, "too many channels" );
+        return VLC_EGENERIC;
+    }
+    p_sys->pf_block = EqzBlock2;
+#if defined (CAN_COMPILE_AVX)
+    if( i_width == 4 )
+        p_sys->pf_block = EqzBlock4;
+#endif
+
     /* Filter dyn config */
     p_sys->b_2eqz = false;
     p_sys->f_gamp = 1.0;
-    p_sys->f_amp  = malloc( p_sys->i_band * sizeof(float) );
-    if( !p_sys->f_amp )
-        goto error;
-
     for( i = 0; i < p_sys->i_band; i++ )
     {
         p_sys->f_amp[i] = 0.0;
     }
+    vlc_atomic_set( &p_sys->changed, 1 );
 
     /* Filter state */
-    for( ch = 0; ch < 32; ch++ )
-    {
-        p_sys->x[ch][0]  =
-        p_sys->x[ch][1]  =
-        p_sys->x2[ch][0] =
-        p_sys->x2[ch][1] = 0.0;
-
-        for( i = 0; i < p_sys->i_band; i++ )
-        {
-            p_sys->y[ch][i][0]  =
-            p_sys->y[ch][i][1]  =
-            p_sys->y2[ch][i][0] =
-            p_sys->y2[ch][i][1] = 0.0;
-        }
-    }
+    memset( p_sys->state, 0, sizeof( p_sys->state ) );
 
     var_Create( p_aout, "equalizer-bands", VLC_VAR_STRING | VLC_VAR_DOINHERIT );
     var_Create( p_aout, "equalizer-preset", VLC_VAR_STRING | VLC_VAR_DOINHERIT );
@@ -372,9 +487,7 @@ static int EqzInit( filter_t *p_filter, int i_rate )
     {
         msg_Err(p_filter, "No preset selected");
         free( val2.psz_string );
-        free( p_sys->f_amp );
-        i_ret = VLC_EGENERIC;
-        goto error;
+        return VLC_EGENERIC;
     }
     if( ( *(val2.psz_string) &&
         strstr( p_sys->psz_newbands, val2.psz_string ) ) || !*val2.psz_string )
@@ -385,6 +498,13 @@ static int EqzInit( filter_t *p_filter, int i_rate )
     }
     free( val2.psz_string );
 
+    /* Settings of the audio thread, until the callbacks change them */
+    for( i = 0; i < p_sys->i_band; i++ )
+        p_sys->amp[i] = p_sys->f_amp[i];
+    p_sys->gamp = p_sys->f_gamp;
+    p_sys->twopass = p_sys->b_2eqz;
+    vlc_atomic_set( &p_sys->changed, 0 );
+
     /* Add our own callbacks */
     var_AddCallback( p_aout, "equalizer-preset", PresetCallback, p_sys );
     var_AddCallback( p_aout, "equalizer-bands", BandsCallback, p_sys );
@@ -400,75 +520,60 @@ static int EqzInit( filter_t *p_filter, int i_rate )
                  p_sys->f_alpha[i], p_sys->f_beta[i], p_sys->f_gamma[i]);
     }
     return VLC_SUCCESS;
-
-error:
-    free( p_sys->f_alpha );
-    free( p_sys->f_beta );
-    free( p_sys->f_gamma );
-    return i_ret;
 }
 
 static void EqzFilter( filter_t *p_filter, float *out, float *in,
                        int i_samples, int i_channels )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
-    int i, ch, j;
+    const unsigned i_lanes = p_sys->i_lanes;
+    double buf[EQZ_CHUNK * EQZ_LANES_MAX];
 
-    vlc_mutex_lock( &p_sys->lock );
-    for( i = 0; i < i_samples; i++ )
+    /* Pick up the new settings, unless a callback is busy changing them:
+     * the audio thread never waits for the interface. */
+    if( vlc_atomic_get( &p_sys->changed )
+     && vlc_mutex_trylock( &p_sys->lock ) == 0 )
     {
-        for( ch = 0; ch < i_channels; ch++ )
-        {
-            const float x = in[ch];
-            float o = 0.0;
-
-            for( j = 0; j < p_sys->i_band; j++ )
-            {
-                float y = p_sys->f_alpha[j] * ( x - p_sys->x[ch][1] ) +
-                          p_sys->f_gamma[j] * p_sys->y[ch][j][0] -
-                          p_sys->f_beta[j]  * p_sys->y[ch][j][1];
-
-                p_sys->y[ch][j][1] = p_sys->y[ch][j][0];
-                p_sys->y[ch][j][0] = y;
+        vlc_atomic_set( &p_sys->changed, 0 );
+        for( int j = 0; j < p_sys->i_band; j++ )
+            p_sys->amp[j] = p_sys->f_amp[j];
+        p_sys->gamp = p_sys->f_gamp;
+        p_sys->twopass = p_sys->b_2eqz;
+        vlc_mutex_unlock( &p_sys->lock );
+    }
 
-                o += y * p_sys->f_amp[j];
-            }
-            p_sys->x[ch][1] = p_sys->x[ch][0];
-            p_sys->x[ch][0] = x;
+    while( i_samples > 0 )
+    {
+        const unsigned i_count = __MIN( i_samples, EQZ_CHUNK );
 
-            /* Second filter */
-            if( p_sys->b_2eqz )
-            {
-                const float x2 = EQZ_IN_FACTOR * x + o;
-                o = 0.0;
-                for( j = 0; j < p_sys->i_band; j++ )
-                {
-                    float y = p_sys->f_alpha[j] * ( x2 - p_sys->x2[ch][1] ) +
-                              p_sys->f_gamma[j] * p_sys->y2[ch][j][0] -
-                              p_sys->f_beta[j]  * p_sys->y2[ch][j][1];
+        /* Deinterleave into double precision lanes, padded with silence */
+        for( unsigned i = 0; i < i_count; i++ )
+        {
+            double *v = buf + i * i_lanes;
+            unsigned ch;
+
+            for( ch = 0; ch < (unsigned)i_channels; ch++ )
+                v[ch] = in[ch];
+            for( ; ch < i_lanes; ch++ )
+                v[ch] = 0.;
+            in += i_channels;
+        }
 
-                    p_sys->y2[ch][j][1] = p_sys->y2[ch][j][0];
-                    p_sys->y2[ch][j][0] = y;
+        p_sys->pf_block( p_sys, &p_sys->state[0], buf, i_count );
+        /* Second filter */
+        if( p_sys->twopass )
+            p_sys->pf_block( p_sys, &p_sys->state[1], buf, i_count );
 
-                    o += y * p_sys->f_amp[j];
-                }
-                p_sys->x2[ch][1] = p_sys->x2[ch][0];
-                p_sys->x2[ch][0] = x2;
+        for( unsigned i = 0; i < i_count; i++ )
+        {
+            const double *v = buf + i * i_lanes;
 
-                /* We add source PCM + filtered PCM */
-                out[ch] = p_sys->f_gamp *( EQZ_IN_FACTOR * x2 + o );
-            }
-            else
-            {
-                /* We add source PCM + filtered PCM */
-                out[ch] = p_sys->f_gamp *( EQZ_IN_FACTOR * x + o );
-            }
+            for( int ch = 0; ch < i_channels; ch++ )
+                out[ch] = p_sys->gamp * v[ch];
+            out += i_channels;
         }
-
-        in  += i_channels;
-        out += i_channels;
+        i_samples -= i_count;
     }
-    vlc_mutex_unlock( &p_sys->lock );
 }
 
 static void EqzClean( filter_t *p_filter )
@@ -481,11 +586,6 @@ static void EqzClean( filter_t *p_filter )
     var_DelCallback( p_aout, "equalizer-preamp", PreampCallback, p_sys );
     var_DelCallback( p_aout, "equalizer-2pass", TwoPassCallback, p_sys );
 
-    free( p_sys->f_alpha );
-    free( p_sys->f_beta );
-    free( p_sys->f_gamma );
-
-    free( p_sys->f_amp );
     free( p_sys->psz_newbands );
 }
 
@@ -530,6 +630,7 @@ static int PresetCallback( vlc_object_t *p_aout, char const *psz_cmd,
                 free( psz_newbands );
                 psz_newbands = psz;
             }
+            vlc_atomic_set( &p_sys->changed, 1 );
             if( !p_sys->b_first )
             {
                 vlc_mutex_unlock( &p_sys->lock );
@@ -568,6 +669,7 @@ static int PreampCallback( vlc_object_t *p_this, char const *psz_cmd,
 
     vlc_mutex_lock( &p_sys->lock );
     p_sys->f_gamp = pow( 10, newval.f_float /20.0);
+    vlc_atomic_set( &p_sys->changed, 1 );
     vlc_mutex_unlock( &p_sys->lock );
 
     return VLC_SUCCESS;
@@ -603,6 +705,7 @@ static int BandsCallback( vlc_object_t *p_this, char const *psz_cmd,
             break; /* end of line */
         p = &psz_next[1];
     }
+    vlc_atomic_set( &p_sys->changed, 1 );
     vlc_mutex_unlock( &p_sys->lock );
     return VLC_SUCCESS;
 }
@@ -614,6 +717,7 @@ static int TwoPassCallback( vlc_object_t *p_this, char const *psz_cmd,
 
     vlc_mutex_lock( &p_sys->lock );
     p_sys->b_2eqz = newval.b_bool;
+    vlc_atomic_set( &p_sys->changed, 1 );
     vlc_mutex_unlock( &p_sys->lock );
     return VLC_SUCCESS;
 }
@@ -0,0 +1,424 @@
+/*****************************************************************************
+ * polyphase.c : polyphase FIR audio resampler
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble:
+ *
+ * The input is filtered through a Kaiser-windowed sinc low-pass filter. The
+ * filter is tabulated for PHASES fractional positions between two input
+ * samples, and the coefficients for the actual position are linearly
+ * interpolated from the two nearest phases. The table only depends on the
+ * cutoff frequency, so small rate changes (such as drift compensation) do
+ * not require recomputing it, and the filter state carries over seamlessly.
+ *
+ * Input samples are kept de-interleaved, so that each output sample is a
+ * plain dot product between the interpolated coefficients and a contiguous
+ * run of input samples.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+#include <vlc_block.h>
+#include <vlc_cpu.h>
+
+#define QUALITY_TEXT N_("Resampling quality")
+#define QUALITY_LONGTEXT N_( \
+    "Length of the interpolation filter (0 = 8 taps, fastest; " \
+    "3 = 64 taps, best).")
+
+static int  Open (vlc_object_t *);
+static void Close (vlc_object_t *);
+
+vlc_module_begin ()
+    set_shortname (N_("Polyphase resampler"))
+    set_description (N_("Polyphase FIR audio resampler"))
+    set_category (CAT_AUDIO)
+    set_subcategory (SUBCAT_AUDIO_MISC)
+    add_integer ("polyphase-resampler-quality", 2,
+                 QUALITY_TEXT, QUALITY_LONGTEXT, true)
+        change_integer_range (0, 3)
+    set_capability ("audio filter", 30)
+    set_callbacks (Open, Close)
+vlc_module_end ()
+
+/* Number of tabulated fractional positions */
+#define PHASES 64
+/* Kaiser window shape parameter */
+#define KAISER_BETA 8.
+/* Cutoff frequency relative to the lowest Nyquist frequency */
+#define ROLLOFF .95f
+
+typedef float (*dot_t) (const float *, const float *, size_t);
+
+struct filter_sys_t
+{
+    float   *hist[AOUT_CHAN_MAX]; /**< De-interleaved input history */
+    size_t   hist_size;           /**< Allocated frames per channel */
+    size_t   hist_len;            /**< Buffered frames */
+    double   pos;                 /**< Next output time in history frames */
+    bool     resampling;          /**< False while passing through at 1:1 */
+
+    unsigned channels;
+    unsigned taps;
+    float   *coeffs;              /**< (PHASES + 1) rows of taps */
+    float   *row;                 /**< Interpolated coefficients */
+    float    cutoff;              /**< Cutoff the table was computed for */
+    dot_t    dot;
+};
+
+static block_t *Resample (filter_t *, block_t *);
+
+static float Dot (const float *a, const float *b, size_t n)
+{
+    float sum = 0.f;
+
+    for (size_t i = 0; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+#if defined (CAN_COMPILE_SSE)
+/* n must be a non-zero multiple of 8 */
+VLC_SSE
+static float DotSSE (const float *a, const float *b, size_t n)
+{
+    float sum;
+
+    __asm__ volatile (
+        "xorps    %%xmm0, %%xmm0\n"
+        "xorps    %%xmm1, %%xmm1\n"
+        "1:\n"
+        "movups     (%[a]), %%xmm2\n"
+        "movups   16(%[a]), %%xmm3\n"
+        "movups     (%[b]), %%xmm4\n"
+        "movups   16(%[b]), %%xmm5\n"
+        "mulps    %%xmm4, %%xmm2\n"
+        "mulps    %%xmm5, %%xmm3\n"
+        "addps    %%xmm2, %%xmm0\n"
+        "addps    %%xmm3, %%xmm1\n"
+        "add      $32, %[a]\n"
+        "add      $32, %[b]\n"
+        "sub      $8, %[n]\n"
+        "jnz      1b\n"
+        "addps    %%xmm1, %%xmm0\n"
+        "movhlps  %%xmm0, %%xmm1\n"
+        "addps    %%xmm1, %%xmm0\n"
+        "movaps   %%xmm0, %%xmm1\n"
+        "shufps   $0x55, %%xmm1, %%xmm1\n"
+        "addss    %%xmm1, %%xmm0\n"
+        "movss    %%xmm0, %[sum]\n"
+        : [a] "+r" (a), [b] "+r" (b), [n] "+r" (n), [sum] "=m" (sum)
+        :
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5");
+    return sum;
+}
+#endif
+
+/** Zeroth order modified Bessel function of the first kind */
+static double BesselI0 (double x)
+{
+    double sum = 1., term = 1.;
+
+    for (unsigned k = 1; k < 50 && term > sum * 1e-12; k++)
+    {
+        double f = x / (2. * k);
+        term *= f * f;
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * Tabulates the low-pass filter for a given cutoff, expressed as a fraction
+ * of the input Nyquist frequency.
+ */
+static void BuildTable (filter_sys_t *sys, float cutoff)
+{
+    const unsigned taps = sys->taps, half = taps / 2;
+    const double norm = BesselI0 (KAISER_BETA);
+
+    for (unsigned p = 0; p <= PHASES; p++)
+    {
+        float *row = sys->coeffs + p * taps;
+        double sum = 0.;
+
+        for (unsigned k = 0; k < taps; k++)
+        {
+            /* Distance from the output position to input tap k */
+            double x = (double)p / PHASES + half - 1. - k;
+            double r = x / half;
+            double v = cutoff;
+
+            if (x != 0.)
+                v = sin (M_PI * cutoff * x) / (M_PI * x);
+            v *= (r * r < 1.) ? BesselI0 (KAISER_BETA * sqrt (1. - r * r))
+                                / norm : 0.;
+            row[k] = v;
+            sum += v;
+        }
+        /* Unity gain at DC for every phase */
+        for (unsigned k = 0; k < taps; k++)
+            row[k] /= sum;
+    }
+    sys->cutoff = cutoff;
+}
+
+static void Reset (filter_sys_t *sys)
+{
+    /* Start with a window of silence, so that the filter always has
+     * enough past samples. */
+    for (unsigned c = 0; c < sys->channels; c++)
+        memset (sys->hist[c], 0, sys->taps * sizeof (float));
+    sys->hist_len = sys->taps;
+    sys->pos = 0.;
+    sys->resampling = false;
+}
+
+static int Open (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+
+    if (filter->fmt_in.audio.i_rate == filter->fmt_out.audio.i_rate
+     || filter->fmt_in.audio.i_format != filter->fmt_out.audio.i_format
+     || filter->fmt_in.audio.i_physical_channels
+                                  != filter->fmt_out.audio.i_physical_channels
+     || filter->fmt_in.audio.i_original_channels
+                                  != filter->fmt_out.audio.i_original_channels
+     || filter->fmt_in.audio.i_format != VLC_CODEC_FL32)
+        return VLC_EGENERIC;
+
+    unsigned q = var_InheritInteger (obj, "polyphase-resampler-quality");
+    if (unlikely(q > 3))
+        q = 2;
+
+    filter_sys_t *sys = malloc (sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return VLC_ENOMEM;
+
+    sys->channels = aout_FormatNbChannels (&filter->fmt_in.audio);
+    sys->taps = 8 << q;
+    sys->hist_size = 4 * sys->taps;
+    sys->coeffs = malloc ((PHASES + 1) * sys->taps * sizeof (float));
+    sys->row = malloc (sys->taps * sizeof (float));
+    for (unsigned c = 0; c < sys->channels; c++)
+        sys->hist[c] = malloc (sys->hist_size * sizeof (float));
+    filter->p_sys = sys;
+
+    for (unsigned c = 0; c < sys->channels; c++)
+        if (unlikely(sys->hist[c] == NULL))
+            goto error;
+    if (unlikely(sys->coeffs == NULL || sys->row == NULL))
+        goto error;
+
+    sys->dot = Dot;
+#if defined (CAN_COMPILE_SSE)
+    if (vlc_CPU() & CPU_CAPABILITY_SSE)
+        sys->dot = DotSSE;
+#endif
+
+    /* The table is computed when resampling actually starts, since the
+     * audio output changes the input rate right after opening. */
+    sys->cutoff = 0.f;
+    Reset (sys);
+
+    filter->pf_audio_filter = Resample;
+    return VLC_SUCCESS;
+error:
+    Close (obj);
+    return VLC_ENOMEM;
+}
+
+static void Close (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+    filter_sys_t *sys = filter->p_sys;
+
+    for (unsigned c = 0; c < sys->channels; c++)
+        free (sys->hist[c]);
+    free (sys->row);
+    free (sys->coeffs);
+    free (sys);
+}
+
+/**
+ * Appends the last frames of an input buffer to the history.
+ */
+static int Append (filter_sys_t *sys, const block_t *in, size_t frames)
+{
+    const unsigned channels = sys->channels;
+    const float *src = (const float *)in->p_buffer
+                     + (in->i_nb_samples - frames) * channels;
+
+    if (sys->hist_len + frames > sys->hist_size)
+    {
+        size_t size = sys->hist_len + frames + sys->taps;
+
+        for (unsigned c = 0; c < channels; c++)
+        {
+            float *hist = realloc (sys->hist[c], size * sizeof (float));
+            if (unlikely(hist == NULL))
+                return -1;
+            sys->hist[c] = hist;
+        }
+        sys->hist_size = size;
+    }
+
+    for (unsigned c = 0; c < channels; c++)
+    {
+        float *dst = sys->hist[c] + sys->hist_len;
+
+        for (size_t i = 0; i < frames; i++)
+            dst[i] = src[i * channels + c];
+    }
+    sys->hist_len += frames;
+    return 0;
+}
+
+/**
+ * Drops the oldest frames of the history.
+ */
+static void Discard (filter_sys_t *sys, size_t frames)
+{
+    if (frames == 0)
+        return;
+
+    sys->hist_len -= frames;
+    for (unsigned c = 0; c < sys->channels; c++)
+        memmove (sys->hist[c], sys->hist[c] + frames,
+                 sys->hist_len * sizeof (float));
+    sys->pos -= frames;
+}
+
+static block_t *Resample (filter_t *filter, block_t *in)
+{
+    filter_sys_t *sys = filter->p_sys;
+    const unsigned channels = sys->channels;
+    const unsigned taps = sys->taps, half = taps / 2;
+    const unsigned irate = filter->fmt_in.audio.i_rate;
+    const unsigned orate = filter->fmt_out.audio.i_rate;
+    block_t *out = NULL;
+
+    if (in->i_flags & BLOCK_FLAG_DISCONTINUITY)
+        Reset (sys);
+
+    if (irate == orate && !sys->resampling)
+    {   /* Pass through, but remember enough samples to start resampling
+         * without discontinuity later on. */
+        size_t frames = __MIN(in->i_nb_samples, taps);
+
+        if (Append (sys, in, frames))
+            Reset (sys);
+        Discard (sys, sys->hist_len - taps);
+        return in;
+    }
+
+    const size_t base = sys->hist_len;
+    if (Append (sys, in, in->i_nb_samples))
+        goto out;
+
+    if (!sys->resampling)
+    {   /* Start with the first new sample */
+        sys->pos = base;
+        sys->resampling = true;
+    }
+
+    if (irate == orate)
+    {   /* Stop resampling: snap to the nearest input sample and flush the
+         * samples that were held back by the filter delay. */
+        size_t start = lround (sys->pos);
+        size_t frames = sys->hist_len - start;
+
+        out = block_Alloc (frames * channels * sizeof (float));
+        if (unlikely(out == NULL))
+            goto out;
+
+        float *dst = (float *)out->p_buffer;
+        for (size_t i = 0; i < frames; i++)
+            for (unsigned c = 0; c < channels; c++)
+                *(dst++) = sys->hist[c][start + i];
+
+        out->i_nb_samples = frames;
+        out->i_pts = in->i_pts
+                   + ((mtime_t)start - (mtime_t)base) * CLOCK_FREQ / irate;
+        sys->resampling = false;
+        Discard (sys, sys->hist_len - taps);
+        goto out;
+    }
+
+    /* Recompute the filter only if the cutoff moved significantly,
+     * e.g. not for drift compensation. */
+    float cutoff = ROLLOFF * ((irate > orate) ? (float)orate / irate : 1.f);
+    if (fabsf (cutoff - sys->cutoff) > .02f)
+        BuildTable (sys, cutoff);
+
+    const double step = (double)irate / orate;
+    const double end = sys->hist_len - half - 1; /* last usable position */
+    size_t frames = (sys->pos <= end) ? (end - sys->pos) / step + 1 : 0;
+
+    out = block_Alloc (frames * channels * sizeof (float));
+    if (unlikely(out == NULL))
+        goto out;
+
+    out->i_pts = in->i_pts
+               + (mtime_t)((sys->pos - base) * CLOCK_FREQ / irate);
+
+    float *dst = (float *)out->p_buffer;
+    size_t n = 0;
+    for (; n < frames && sys->pos < end + 1.; n++)
+    {
+        size_t ip = sys->pos;
+        float frac = (sys->pos - ip) * PHASES;
+        unsigned phase = frac;
+        float a = frac - phase;
+        const float *c0 = sys->coeffs + phase * taps;
+        const float *c1 = c0 + taps;
+
+        for (unsigned k = 0; k < taps; k++)
+            sys->row[k] = c0[k] + a * (c1[k] - c0[k]);
+
+        for (unsigned c = 0; c < channels; c++)
+            *(dst++) = sys->dot (sys->hist[c] + ip + 1 - half, sys->row,
+                                 taps);
+        sys->pos += step;
+    }
+    out->i_nb_samples = n;
+
+    /* Keep the samples needed by the next output */
+    size_t keep = (size_t)sys->pos + 1 - half;
+    Discard (sys, __MIN(keep, sys->hist_len));
+
+out:
+    if (out != NULL)
+    {
+        out->i_buffer = out->i_nb_samples * channels * sizeof (float);
+        out->i_dts = out->i_pts;
+        out->i_length = out->i_nb_samples * CLOCK_FREQ / orate;
+    }
+    block_Release (in);
+    return out;
+}
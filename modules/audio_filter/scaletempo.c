@@ -32,7 +32,9 @@
 #include <vlc_plugin.h>
 #include <vlc_aout.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 
+#include <math.h>
 #include <string.h> /* for memset */
 #include <limits.h> /* form INT_MIN */
 
@@ -111,8 +113,98 @@ struct filter_sys_t
     void     *buf_pre_corr;
     void     *table_window;
     unsigned(*best_overlap_offset)( filter_t *p_filter );
+    float   (*dot)( const float *, const float *, unsigned );
+    /* FFT cross correlation */
+    unsigned  fft_size;
+    unsigned *fft_bitrev;
+    float    *fft_twiddle;
+    float    *fft_buf;
 };
 
+/*****************************************************************************
+ * dot: correlation kernels
+ *****************************************************************************/
+static float dot_float( const float *a, const float *b, unsigned n )
+{
+    float sum = 0;
+    for( unsigned i = 0; i < n; i++ )
+        sum += a[i] * b[i];
+    return sum;
+}
+
+#if defined(CAN_COMPILE_SSE)
+VLC_SSE
+static float dot_sse( const float *a, const float *b, unsigned n )
+{
+    float sum = 0;
+    size_t blocks = n & ~7u;
+
+    if( blocks > 0 )
+        __asm__ volatile (
+            "xorps    %%xmm0, %%xmm0\n"
+            "xorps    %%xmm1, %%xmm1\n"
+            "1:\n"
+            "movups     (%[a]), %%xmm2\n"
+            "movups   16(%[a]), %%xmm3\n"
+            "movups     (%[b]), %%xmm4\n"
+            "movups   16(%[b]), %%xmm5\n"
+            "mulps    %%xmm4, %%xmm2\n"
+            "mulps    %%xmm5, %%xmm3\n"
+            "addps    %%xmm2, %%xmm0\n"
+            "addps    %%xmm3, %%xmm1\n"
+            "add      $32, %[a]\n"
+            "add      $32, %[b]\n"
+            "sub      $8, %[n]\n"
+            "jnz      1b\n"
+            "addps    %%xmm1, %%xmm0\n"
+            "movhlps  %%xmm0, %%xmm1\n"
+            "addps    %%xmm1, %%xmm0\n"
+            "movaps   %%xmm0, %%xmm1\n"
+            "shufps   $0x55, %%xmm1, %%xmm1\n"
+            "addss    %%xmm1, %%xmm0\n"
+            "movss    %%xmm0, %[sum]\n"
+            : [a] "+r" (a), [b] "+r" (b), [n] "+r" (blocks), [sum] "=m" (sum)
+            :
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5");
+
+    for( unsigned i = 0; i < (n & 7); i++ )
+        sum += a[i] * b[i];
+    return sum;
+}
+#endif
+
+/*****************************************************************************
+ * fft: in-place radix-2 complex FFT (forward, unscaled)
+ *****************************************************************************/
+static void fft( filter_sys_t *p, float *re, float *im )
+{
+    const unsigned n = p->fft_size;
+    const float *tw = p->fft_twiddle;
+
+    for( unsigned i = 0; i < n; i++ ) {
+        unsigned j = p->fft_bitrev[i];
+        if( j > i ) {
+            float t;
+            t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for( unsigned len = 2; len <= n; len <<= 1 ) {
+        unsigned half = len / 2, step = n / len;
+        for( unsigned i = 0; i < n; i += len ) {
+            for( unsigned k = 0; k < half; k++ ) {
+                float wr = tw[2 * k * step], wi = tw[2 * k * step + 1];
+                unsigned a = i + k, b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr; im[b] = im[a] - ti;
+                re[a] += tr;        im[a] += ti;
+            }
+        }
+    }
+}
+
 /*****************************************************************************
  * best_overlap_offset: calculate best offset for overlap
  *****************************************************************************/
@@ -134,12 +226,8 @@ static unsigned best_overlap_offset_float( filter_t *p_filter )
 
     search_start = (float *)p->buf_queue + p->samples_per_frame;
     for( off = 0; off < p->frames_search; off++ ) {
-      float corr = 0;
-      float *ps = search_start;
-      ppc = p->buf_pre_corr;
-      for( i = p->samples_per_frame; i < p->samples_overlap; i++ ) {
-        corr += *ppc++ * *ps++;
-      }
+      float corr = p->dot( p->buf_pre_corr, search_start,
+                           p->samples_overlap - p->samples_per_frame );
       if( corr > best_corr ) {
         best_corr = corr;
         best_off  = off;
@@ -150,6 +238,111 @@ static unsigned best_overlap_offset_float( filter_t *p_filter )
     return best_off * p->bytes_per_frame;
 }
 
+/*****************************************************************************
+ * best_overlap_offset_fft: same as above, computing all correlations at once
+ *****************************************************************************
+ * The search region and the windowed overlap are transformed together as
+ * the real and imaginary parts of a single complex FFT. Their cross
+ * correlation is the inverse transform of the product of their spectra.
+ *****************************************************************************/
+static unsigned best_overlap_offset_fft( filter_t *p_filter )
+{
+    filter_sys_t *p = p_filter->p_sys;
+    const unsigned n = p->fft_size;
+    const unsigned spf = p->samples_per_frame;
+    const unsigned samples_corr = p->samples_overlap - spf;
+    const unsigned samples_search = ( p->frames_search - 1 ) * spf
+                                  + samples_corr;
+    float *zr = p->fft_buf, *zi = zr + n, *xr = zi + n, *xi = xr + n;
+    const float *pw = p->table_window;
+    const float *po = (float *)p->buf_overlap + spf;
+    const float *ps = (float *)p->buf_queue + spf;
+    unsigned i;
+
+    for( i = 0; i < samples_search; i++ )
+        zr[i] = ps[i];
+    for( ; i < n; i++ )
+        zr[i] = 0;
+    for( i = 0; i < samples_corr; i++ )
+        zi[i] = pw[i] * po[i];
+    for( ; i < n; i++ )
+        zi[i] = 0;
+
+    fft( p, zr, zi );
+
+    for( unsigned k = 0; k < n; k++ ) {
+        unsigned m = ( n - k ) & ( n - 1 );
+        /* Split the spectra of the search region (s) and overlap (o) */
+        float sr = zr[k] + zr[m], si = zi[k] - zi[m];
+        float ovr = zi[k] + zi[m], ovi = zr[m] - zr[k];
+        /* conj(O) * S, conjugated for the inverse transform */
+        xr[k] = ovr * sr + ovi * si;
+        xi[k] = ovi * sr - ovr * si;
+    }
+
+    fft( p, xr, xi );
+
+    float best_corr = -HUGE_VALF;
+    unsigned best_off = 0;
+    for( unsigned off = 0; off < p->frames_search; off++ ) {
+        float corr = xr[off * spf];
+        if( corr > best_corr ) {
+            best_corr = corr;
+            best_off  = off;
+        }
+    }
+
+    return best_off * p->bytes_per_frame;
+}
+
+/*****************************************************************************
+ * init_fft: prepare the FFT correlation if it beats the direct one
+ *****************************************************************************/
+static int init_fft( filter_t *p_filter )
+{
+    filter_sys_t *p = p_filter->p_sys;
+    const unsigned spf = p->samples_per_frame;
+    const unsigned samples_corr = p->samples_overlap - spf;
+    const unsigned samples_search = ( p->frames_search - 1 ) * spf
+                                  + samples_corr;
+    unsigned n = 2, log2n = 1;
+
+    while( n < samples_search ) {
+        n <<= 1;
+        log2n++;
+    }
+
+    /* Rough cost model: two FFTs of about 5 N log2 N operations each,
+     * against one multiply-accumulate per sample and offset, the latter
+     * being much cheaper with vector instructions. */
+    unsigned mac_per_op = ( p->dot == dot_float ) ? 1 : 8;
+    if( (uint64_t)p->frames_search * samples_corr / mac_per_op
+        <= (uint64_t)10 * n * log2n )
+        return VLC_SUCCESS;
+
+    p->fft_bitrev  = malloc( n * sizeof( *p->fft_bitrev ) );
+    p->fft_twiddle = malloc( n * sizeof( *p->fft_twiddle ) );
+    p->fft_buf     = malloc( 4 * n * sizeof( *p->fft_buf ) );
+    if( !p->fft_bitrev || !p->fft_twiddle || !p->fft_buf )
+        return VLC_ENOMEM;
+
+    for( unsigned i = 0; i < n; i++ ) {
+        unsigned r = 0;
+        for( unsigned b = 0; b < log2n; b++ )
+            r |= ( ( i >> b ) & 1 ) << ( log2n - 1 - b );
+        p->fft_bitrev[i] = r;
+    }
+    for( unsigned k = 0; k < n / 2; k++ ) {
+        p->fft_twiddle[2 * k]     =  cos( 2. * M_PI * k / n );
+        p->fft_twiddle[2 * k + 1] = -sin( 2. * M_PI * k / n );
+    }
+    p->fft_size = n;
+    p->best_overlap_offset = best_overlap_offset_fft;
+
+    msg_Dbg( p_filter, "using %u-point FFT correlation", n );
+    return VLC_SUCCESS;
+}
+
 /*****************************************************************************
  * output_overlap: blend end of previous stride with beginning of current stride
  *****************************************************************************/
@@ -338,6 +531,8 @@ static int reinit_buffers( filter_t *p_filter )
                 *pw++ = v;
         }
         p->best_overlap_offset = best_overlap_offset_float;
+        if( init_fft( p_filter ) != VLC_SUCCESS )
+            return VLC_ENOMEM;
     }
 
     unsigned new_size = ( p->frames_search + frames_stride + frames_overlap ) * p->bytes_per_frame;
@@ -437,11 +632,21 @@ static int Open( vlc_object_t *p_this )
     p_sys->table_blend    = NULL;
     p_sys->buf_pre_corr   = NULL;
     p_sys->table_window   = NULL;
+    p_sys->fft_size       = 0;
+    p_sys->fft_bitrev     = NULL;
+    p_sys->fft_twiddle    = NULL;
+    p_sys->fft_buf        = NULL;
     p_sys->bytes_overlap  = 0;
     p_sys->bytes_queued   = 0;
     p_sys->bytes_to_slide = 0;
     p_sys->frames_stride_error = 0;
 
+    p_sys->dot = dot_float;
+#if defined(CAN_COMPILE_SSE)
+    if( vlc_CPU() & CPU_CAPABILITY_SSE )
+        p_sys->dot = dot_sse;
+#endif
+
     if( reinit_buffers( p_filter ) != VLC_SUCCESS )
     {
         Close( p_this );
@@ -459,6 +664,9 @@ static void Close( vlc_object_t *p_this )
     free( p_sys->table_blend );
     free( p_sys->buf_pre_corr );
     free( p_sys->table_window );
+    free( p_sys->fft_bitrev );
+    free( p_sys->fft_twiddle );
+    free( p_sys->fft_buf );
     free( p_sys );
 }
 
@@ -34,12 +34,19 @@
 #include <vlc_plugin.h>
 #include <vlc_aout.h>
 #include <vlc_aout_mixer.h>
+#include <vlc_cpu.h>
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 static int Create( vlc_object_t * );
 static void DoWork( audio_mixer_t *, aout_buffer_t *, float );
+#if defined (CAN_COMPILE_SSE)
+static void DoWorkSSE( audio_mixer_t *, aout_buffer_t *, float );
+#endif
+#if defined (CAN_COMPILE_AVX)
+static void DoWorkAVX( audio_mixer_t *, aout_buffer_t *, float );
+#endif
 
 /*****************************************************************************
  * Module descriptor
@@ -63,6 +70,14 @@ static int Create( vlc_object_t *p_this )
         return -1;
 
     p_mixer->mix = DoWork;
+#if defined (CAN_COMPILE_SSE)
+    if (vlc_CPU() & CPU_CAPABILITY_SSE)
+        p_mixer->mix = DoWorkSSE;
+#endif
+#if defined (CAN_COMPILE_AVX)
+    if (vlc_CPU() & CPU_CAPABILITY_AVX)
+        p_mixer->mix = DoWorkAVX;
+#endif
     return 0;
 }
 
@@ -81,3 +96,72 @@ static void DoWork( audio_mixer_t * p_mixer, aout_buffer_t *p_buffer,
 
     (void) p_mixer;
 }
+
+#if defined (CAN_COMPILE_SSE)
+/**
+ * Mixes a new output buffer, four samples at a time
+ */
+VLC_SSE
+static void DoWorkSSE( audio_mixer_t * p_mixer, aout_buffer_t *p_buffer,
+                       float f_multiplier )
+{
+    if( f_multiplier == 1.0 )
+        return; /* nothing to do */
+
+    const float mult[4] = {
+        f_multiplier, f_multiplier, f_multiplier, f_multiplier };
+    float *p = (float *)p_buffer->p_buffer;
+    size_t i = p_buffer->i_buffer / sizeof(float);
+
+    for( ; i >= 8; i -= 8, p += 8 )
+        __asm__ volatile (
+            "movups   (%1), %%xmm2\n" /* mult[] is not 16-bytes aligned */
+            "movups   (%0), %%xmm0\n"
+            "movups 16(%0), %%xmm1\n"
+            "mulps  %%xmm2, %%xmm0\n"
+            "mulps  %%xmm2, %%xmm1\n"
+            "movups %%xmm0,   (%0)\n"
+            "movups %%xmm1, 16(%0)\n"
+            :
+            : "r" (p), "r" (mult)
+            : "memory", "xmm0", "xmm1", "xmm2");
+
+    for( ; i > 0; i-- )
+        *(p++) *= f_multiplier;
+
+    (void) p_mixer;
+}
+#endif
+
+#if defined (CAN_COMPILE_AVX)
+/**
+ * Mixes a new output buffer, eight samples at a time
+ */
+VLC_AVX
+static void DoWorkAVX( audio_mixer_t * p_mixer, aout_buffer_t *p_buffer,
+                       float f_multiplier )
+{
+    if( f_multiplier == 1.0 )
+        return; /* nothing to do */
+
+    float *p = (float *)p_buffer->p_buffer;
+    size_t i = p_buffer->i_buffer / sizeof(float);
+
+    for( ; i >= 16; i -= 16, p += 16 )
+        __asm__ volatile (
+            "vbroadcastss (%1), %%ymm2\n"
+            "vmulps   (%0), %%ymm2, %%ymm0\n"
+            "vmulps 32(%0), %%ymm2, %%ymm1\n"
+            "vmovups %%ymm0,   (%0)\n"
+            "vmovups %%ymm1, 32(%0)\n"
+            :
+            : "r" (p), "r" (&f_multiplier)
+            : "memory", "xmm0", "xmm1", "xmm2");
+    __asm__ volatile ("vzeroupper\n");
+
+    for( ; i > 0; i-- )
+        *(p++) *= f_multiplier;
+
+    (void) p_mixer;
+}
+#endif
@@ -55,7 +55,7 @@
 
 #include "avcodec.h"
 #include "va.h"
-#include "copy.h"
+#include "../../video_chroma/copy.h"
 
 #ifdef HAVE_AVCODEC_DXVA2
 
@@ -37,7 +37,7 @@
 
 #include "avcodec.h"
 #include "va.h"
-#include "copy.h"
+#include "../../video_chroma/copy.h"
 
 #ifdef HAVE_AVCODEC_VAAPI
 
@@ -52,6 +52,16 @@ typedef struct
     bool      b_displayed;
 } picture_dpb_t;
 
+#define SLICE_THREADS_MAX 8
+
+typedef struct
+{
+    decoder_t       *p_dec;
+    mpeg2dec_t      *p_mpeg2dec;
+    vlc_thread_t    thread;
+    mpeg2_state_t   state;
+} slice_worker_t;
+
 struct decoder_sys_t
 {
     /*
@@ -61,6 +71,21 @@ struct decoder_sys_t
     const mpeg2_info_t  *p_info;
     bool                b_skip;
 
+    /*
+     * Slice workers: each one parses the same stream as p_mpeg2dec, in
+     * lockstep with it, but only decodes its own band of slices, into the
+     * same pictures. The references are thus complete before the next
+     * picture is decoded.
+     */
+    int             i_workers;
+    slice_worker_t  p_workers[SLICE_THREADS_MAX - 1];
+    vlc_mutex_t     lock;
+    vlc_cond_t      wait_work;
+    vlc_cond_t      wait_done;
+    unsigned        i_step;     /* parsing steps started */
+    int             i_pending;  /* workers still parsing the step */
+    bool            b_exit;
+
     /*
      * Input properties
      */
@@ -114,6 +139,12 @@ static void GetAR( decoder_t *p_dec );
 
 static void Reset( decoder_t *p_dec );
 
+static void StartWorkers( decoder_t * );
+static void StopWorkers( decoder_t * );
+static mpeg2_state_t Parse( decoder_t * );
+static void SetRegion( decoder_t *, const mpeg2_picture_t * );
+static void Skip( decoder_t *, int );
+
 /* */
 static void DpbInit( decoder_t * );
 static void DpbClean( decoder_t * );
@@ -124,6 +155,11 @@ static int DpbDisplayPicture( decoder_t *, picture_t * );
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
+#define THREADS_TEXT N_("Threads")
+#define THREADS_LONGTEXT N_( \
+    "Number of threads decoding the slices of each picture, " \
+    "0 meaning one per CPU, up to 4" )
+
 vlc_module_begin ()
     set_description( N_("MPEG I/II video decoder (using libmpeg2)") )
     set_capability( "decoder", 50 )
@@ -131,6 +167,8 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_VCODEC )
     set_callbacks( OpenDecoder, CloseDecoder )
     add_shortcut( "libmpeg2" )
+    add_integer_with_range( "libmpeg2-threads", 1, 0, SLICE_THREADS_MAX,
+                            THREADS_TEXT, THREADS_LONGTEXT, true )
 vlc_module_end ()
 
 /*****************************************************************************
@@ -240,6 +278,7 @@ static int OpenDecoder( vlc_object_t *p_this )
     }
 
     p_sys->p_info = mpeg2_info( p_sys->p_mpeg2dec );
+    StartWorkers( p_dec );
 
     p_dec->pf_decode_video = DecodeBlock;
     p_dec->fmt_out.i_cat = VIDEO_ES;
@@ -268,7 +307,7 @@ static picture_t *DecodeBlock( decoder_t *p_dec, block_t **pp_block )
 
     while( 1 )
     {
-        state = mpeg2_parse( p_sys->p_mpeg2dec );
+        state = Parse( p_dec );
 
         switch( state )
         {
@@ -279,6 +318,8 @@ static picture_t *DecodeBlock( decoder_t *p_dec, block_t **pp_block )
 
             /* */
             mpeg2_custom_fbuf( p_sys->p_mpeg2dec, 1 );
+            for( int i = 0; i < p_sys->i_workers; i++ )
+                mpeg2_custom_fbuf( p_sys->p_workers[i].p_mpeg2dec, 1 );
 
             /* Set the first 2 reference frames */
             p_sys->i_sar_num = 0;
@@ -414,15 +455,18 @@ static picture_t *DecodeBlock( decoder_t *p_dec, block_t **pp_block )
                     if( !p_pic )
                     {
                         mpeg2_reset( p_sys->p_mpeg2dec, 1 );
+                        for( int i = 0; i < p_sys->i_workers; i++ )
+                            mpeg2_reset( p_sys->p_workers[i].p_mpeg2dec, 1 );
                         block_Release( p_block );
                         return NULL;
                     }
                 }
             }
+            SetRegion( p_dec, p_current );
 
             if( b_skip || !p_pic )
             {
-                mpeg2_skip( p_sys->p_mpeg2dec, 1 );
+                Skip( p_dec, 1 );
                 p_sys->b_skip = true;
                 decoder_SynchroTrash( p_sys->p_synchro );
 
@@ -436,7 +480,7 @@ static picture_t *DecodeBlock( decoder_t *p_dec, block_t **pp_block )
             }
             else
             {
-                mpeg2_skip( p_sys->p_mpeg2dec, 0 );
+                Skip( p_dec, 0 );
                 p_sys->b_skip = false;
                 decoder_SynchroDecode( p_sys->p_synchro );
 
@@ -534,6 +578,9 @@ static picture_t *DecodeBlock( decoder_t *p_dec, block_t **pp_block )
 
             mpeg2_buffer( p_sys->p_mpeg2dec, p_block->p_buffer,
                           p_block->p_buffer + p_block->i_buffer );
+            for( int i = 0; i < p_sys->i_workers; i++ )
+                mpeg2_buffer( p_sys->p_workers[i].p_mpeg2dec, p_block->p_buffer,
+                              p_block->p_buffer + p_block->i_buffer );
 
             p_block->i_buffer = 0;
             break;
@@ -619,6 +666,7 @@ static void CloseDecoder( vlc_object_t *p_this )
     decoder_t *p_dec = (decoder_t *)p_this;
     decoder_sys_t *p_sys = p_dec->p_sys;
 
+    StopWorkers( p_dec );
     DpbClean( p_dec );
 
     free( p_sys->p_gop_user_data );
@@ -639,9 +687,187 @@ static void Reset( decoder_t *p_dec )
 
     cc_Flush( &p_sys->cc );
     mpeg2_reset( p_sys->p_mpeg2dec, 0 );
+    for( int i = 0; i < p_sys->i_workers; i++ )
+        mpeg2_reset( p_sys->p_workers[i].p_mpeg2dec, 0 );
     DpbClean( p_dec );
 }
 
+/*****************************************************************************
+ * Slice workers
+ *****************************************************************************/
+static void *SliceThread( void *data )
+{
+    slice_worker_t *p_worker = data;
+    decoder_sys_t *p_sys = p_worker->p_dec->p_sys;
+    unsigned i_step = 0;
+
+    vlc_mutex_lock( &p_sys->lock );
+    for( ;; )
+    {
+        while( !p_sys->b_exit && p_sys->i_step == i_step )
+            vlc_cond_wait( &p_sys->wait_work, &p_sys->lock );
+        if( p_sys->b_exit )
+            break;
+        i_step = p_sys->i_step;
+        vlc_mutex_unlock( &p_sys->lock );
+
+        p_worker->state = mpeg2_parse( p_worker->p_mpeg2dec );
+
+        vlc_mutex_lock( &p_sys->lock );
+        if( --p_sys->i_pending == 0 )
+            vlc_cond_signal( &p_sys->wait_done );
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return NULL;
+}
+
+static void StartWorkers( decoder_t *p_dec )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+
+    p_sys->i_workers = 0;
+
+    int i_threads = var_InheritInteger( p_dec, "libmpeg2-threads" );
+    if( i_threads <= 0 )
+        i_threads = __MIN( vlc_GetCPUCount(), 4 );
+    i_threads = __MIN( i_threads, SLICE_THREADS_MAX );
+    if( i_threads <= 1 )
+        return;
+
+    vlc_mutex_init( &p_sys->lock );
+    vlc_cond_init( &p_sys->wait_work );
+    vlc_cond_init( &p_sys->wait_done );
+    p_sys->i_step = 0;
+    p_sys->i_pending = 0;
+    p_sys->b_exit = false;
+
+    while( p_sys->i_workers < i_threads - 1 )
+    {
+        slice_worker_t *p_worker = &p_sys->p_workers[p_sys->i_workers];
+
+        p_worker->p_dec = p_dec;
+        p_worker->p_mpeg2dec = mpeg2_init();
+        if( p_worker->p_mpeg2dec == NULL )
+            break;
+        if( vlc_clone( &p_worker->thread, SliceThread, p_worker,
+                       VLC_THREAD_PRIORITY_VIDEO ) )
+        {
+            mpeg2_close( p_worker->p_mpeg2dec );
+            break;
+        }
+        p_sys->i_workers++;
+    }
+
+    if( p_sys->i_workers == 0 )
+    {
+        vlc_cond_destroy( &p_sys->wait_done );
+        vlc_cond_destroy( &p_sys->wait_work );
+        vlc_mutex_destroy( &p_sys->lock );
+        return;
+    }
+    msg_Dbg( p_dec, "decoding the slices with %d threads",
+             p_sys->i_workers + 1 );
+}
+
+static void StopWorkers( decoder_t *p_dec )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+
+    if( p_sys->i_workers == 0 )
+        return;
+
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->b_exit = true;
+    vlc_cond_broadcast( &p_sys->wait_work );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    for( int i = 0; i < p_sys->i_workers; i++ )
+    {
+        vlc_join( p_sys->p_workers[i].thread, NULL );
+        mpeg2_close( p_sys->p_workers[i].p_mpeg2dec );
+    }
+    p_sys->i_workers = 0;
+
+    vlc_cond_destroy( &p_sys->wait_done );
+    vlc_cond_destroy( &p_sys->wait_work );
+    vlc_mutex_destroy( &p_sys->lock );
+}
+
+/**
+ * Parses the stream one step further, with all the slice workers.
+ */
+static mpeg2_state_t Parse( decoder_t *p_dec )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+
+    if( p_sys->i_workers == 0 )
+        return mpeg2_parse( p_sys->p_mpeg2dec );
+
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->i_step++;
+    p_sys->i_pending = p_sys->i_workers;
+    vlc_cond_broadcast( &p_sys->wait_work );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    mpeg2_state_t state = mpeg2_parse( p_sys->p_mpeg2dec );
+
+    vlc_mutex_lock( &p_sys->lock );
+    while( p_sys->i_pending > 0 )
+        vlc_cond_wait( &p_sys->wait_done, &p_sys->lock );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    /* The same input and the same buffers give the same states */
+    for( int i = 0; i < p_sys->i_workers; i++ )
+    {
+        if( p_sys->p_workers[i].state == state )
+            continue;
+
+        msg_Err( p_dec, "slice threads out of step, decoding serially" );
+        StopWorkers( p_dec );
+        mpeg2_slice_region( p_sys->p_mpeg2dec, 0, 0xb0 );
+        break;
+    }
+    return state;
+}
+
+/**
+ * Shares out the slices of the current picture between the threads.
+ */
+static void SetRegion( decoder_t *p_dec, const mpeg2_picture_t *p_current )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+    const int i_threads = p_sys->i_workers + 1;
+
+    if( i_threads == 1 )
+        return;
+
+    /* Slices are numbered after their macroblock row, in the field for
+     * field pictures */
+    int i_rows = p_current->nb_fields == 1
+               ? ( p_sys->p_info->sequence->height + 31 ) / 32
+               : ( p_sys->p_info->sequence->height + 15 ) / 16;
+
+    for( int i = 0; i < i_threads; i++ )
+    {
+        mpeg2dec_t *p_mpeg2dec = i == 0 ? p_sys->p_mpeg2dec
+                                        : p_sys->p_workers[i - 1].p_mpeg2dec;
+        int i_start = 1 + i_rows * i / i_threads;
+        int i_end = i == i_threads - 1 ? 0xb0
+                                       : 1 + i_rows * (i + 1) / i_threads;
+
+        mpeg2_slice_region( p_mpeg2dec, i_start, i_end );
+    }
+}
+
+static void Skip( decoder_t *p_dec, int b_skip )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+
+    mpeg2_skip( p_sys->p_mpeg2dec, b_skip );
+    for( int i = 0; i < p_sys->i_workers; i++ )
+        mpeg2_skip( p_sys->p_workers[i].p_mpeg2dec, b_skip );
+}
+
 /*****************************************************************************
  * GetNewPicture: Get a new picture from the vout and set the buf struct
  *****************************************************************************/
@@ -783,11 +1009,18 @@ static void PutPicture( decoder_t *p_dec, picture_t *p_picture )
     for( int j = 0; j < 3; j++ )
         pp_buf[j] = p_picture ? p_picture->p[j].p_pixels : NULL;
     mpeg2_set_buf( p_sys->p_mpeg2dec, pp_buf, p_picture );
+    for( int i = 0; i < p_sys->i_workers; i++ )
+        mpeg2_set_buf( p_sys->p_workers[i].p_mpeg2dec, pp_buf, p_picture );
 
     /* Completly broken API, why the hell does it suppose
      * the stride of the chroma planes ! */
     if( p_picture )
+    {
         mpeg2_stride( p_sys->p_mpeg2dec, p_picture->p[Y_PLANE].i_pitch );
+        for( int i = 0; i < p_sys->i_workers; i++ )
+            mpeg2_stride( p_sys->p_workers[i].p_mpeg2dec,
+                          p_picture->p[Y_PLANE].i_pitch );
+    }
 }
 
 
@@ -0,0 +1,134 @@
+/*****************************************************************************
+ * metrics.c: statistics exporter over HTTP
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_interface.h>
+#include <vlc_httpd.h>
+
+#define PATH_TEXT N_("Metrics path")
+#define PATH_LONGTEXT N_( \
+    "Path of the metrics page, on the HTTP server defined by the " \
+    "http-host and http-port options." )
+
+static int  Open ( vlc_object_t * );
+static void Close( vlc_object_t * );
+
+vlc_module_begin ()
+    set_shortname( N_("Metrics") )
+    set_description( N_("Statistics exporter over HTTP") )
+    set_category( CAT_INTERFACE )
+    set_subcategory( SUBCAT_INTERFACE_CONTROL )
+    set_capability( "interface", 0 )
+    set_callbacks( Open, Close )
+    add_string( "metrics-path", "/metrics", PATH_TEXT, PATH_LONGTEXT, true )
+vlc_module_end ()
+
+struct intf_sys_t
+{
+    httpd_host_t *p_host;
+    httpd_file_t *p_file;
+};
+
+/*****************************************************************************
+ * Fill: the metrics are gathered only when requested
+ *****************************************************************************/
+static int Fill( httpd_file_sys_t *p_data, httpd_file_t *p_file,
+                 uint8_t *p_request, uint8_t **pp_body, int *pi_body )
+{
+    intf_thread_t *p_intf = (intf_thread_t *)p_data;
+    VLC_UNUSED(p_file); VLC_UNUSED(p_request);
+
+    char *psz_metrics = stats_Export( p_intf );
+    if( psz_metrics == NULL )
+    {
+        *pp_body = NULL;
+        *pi_body = 0;
+        return VLC_ENOMEM;
+    }
+
+    *pp_body = (uint8_t *)psz_metrics;
+    *pi_body = strlen( psz_metrics );
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Open: serves the metrics page
+ *****************************************************************************/
+static int Open( vlc_object_t *p_this )
+{
+    intf_thread_t *p_intf = (intf_thread_t *)p_this;
+
+    if( !var_InheritBool( p_intf, "stats" ) )
+    {
+        msg_Err( p_intf, "statistics are disabled" );
+        return VLC_EGENERIC;
+    }
+
+    intf_sys_t *p_sys = malloc( sizeof( *p_sys ) );
+    if( unlikely(p_sys == NULL) )
+        return VLC_ENOMEM;
+
+    p_sys->p_host = vlc_http_HostNew( p_this );
+    if( p_sys->p_host == NULL )
+    {
+        free( p_sys );
+        return VLC_EGENERIC;
+    }
+
+    char *psz_path = var_InheritString( p_intf, "metrics-path" );
+    p_sys->p_file = httpd_FileNew( p_sys->p_host,
+                                   psz_path ? psz_path : "/metrics",
+                                   "text/plain; version=0.0.4",
+                                   NULL, NULL, NULL, Fill,
+                                   (httpd_file_sys_t *)p_intf );
+    free( psz_path );
+    if( p_sys->p_file == NULL )
+    {
+        httpd_HostDelete( p_sys->p_host );
+        free( p_sys );
+        return VLC_EGENERIC;
+    }
+
+    p_intf->p_sys = p_sys;
+    p_intf->pf_run = NULL;
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Close:
+ *****************************************************************************/
+static void Close( vlc_object_t *p_this )
+{
+    intf_thread_t *p_intf = (intf_thread_t *)p_this;
+    intf_sys_t *p_sys = p_intf->p_sys;
+
+    httpd_FileDelete( p_sys->p_file );
+    httpd_HostDelete( p_sys->p_host );
+    free( p_sys );
+}
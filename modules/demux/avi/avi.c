@@ -29,18 +29,20 @@
 #endif
 #include <assert.h>
 #include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_demux.h>
 #include <vlc_input.h>
 
-#include <vlc_dialog.h>
-
 #include <vlc_meta.h>
 #include <vlc_codecs.h>
 #include <vlc_charset.h>
 #include <vlc_memory.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
 
 #include "libavi.h"
 
@@ -56,12 +58,17 @@
     "Recreate a index for the AVI file. Use this if your AVI file is damaged "\
     "or incomplete (not seekable)." )
 
+#define INDEX_CACHE_TEXT N_("Cache created indexes")
+#define INDEX_CACHE_LONGTEXT N_( \
+    "Save the indexes created for damaged or incomplete AVI files, " \
+    "so that they open seekable right away the next time." )
+
 static int  Open ( vlc_object_t * );
 static void Close( vlc_object_t * );
 
 static const int pi_index[] = {0,1,2};
 
-static const char *const ppsz_indexes[] = { N_("Ask for action"),
+static const char *const ppsz_indexes[] = { N_("Fix when needed"),
                                             N_("Always fix"),
                                             N_("Never fix") };
 
@@ -77,6 +84,8 @@ vlc_module_begin ()
     add_integer( "avi-index", 0,
               INDEX_TEXT, INDEX_LONGTEXT, false )
         change_integer_list( pi_index, ppsz_indexes )
+    add_bool( "avi-index-cache", true,
+              INDEX_CACHE_TEXT, INDEX_CACHE_LONGTEXT, true )
 
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -184,6 +193,18 @@ struct demux_sys_t
 
     unsigned int       i_attachment;
     input_attachment_t **attachment;
+
+    /* Background index creation */
+    vlc_thread_t index_thread;
+    vlc_mutex_t  index_lock;
+    bool         b_indexing;
+    bool         b_index_abort;
+    bool         b_index_done;
+    bool         b_index_ok;
+    avi_index_t  *index_new;    /* per track, until it is complete */
+    off_t        i_index_lastchunk_pos;
+    int64_t      i_index_size;
+    char         *psz_index_cache;
 };
 
 static inline off_t __EVEN( off_t i )
@@ -206,17 +227,21 @@ static int AVI_StreamBytesSet ( demux_t *,
 vlc_fourcc_t AVI_FourccGetCodec( unsigned int i_cat, vlc_fourcc_t );
 static int   AVI_GetKeyFlag    ( vlc_fourcc_t , uint8_t * );
 
-static int AVI_PacketGetHeader( demux_t *, avi_packet_t *p_pk );
-static int AVI_PacketNext     ( demux_t * );
+static int AVI_PacketGetHeader( stream_t *, avi_packet_t *p_pk );
+static int AVI_PacketNext     ( stream_t * );
 static int AVI_PacketRead     ( demux_t *, avi_packet_t *, block_t **);
-static int AVI_PacketSearch   ( demux_t * );
+static int AVI_PacketSearch   ( demux_t *, stream_t * );
 
 static void AVI_IndexLoad    ( demux_t * );
-static void AVI_IndexCreate  ( demux_t * );
+static int  AVI_IndexStart   ( demux_t * );
+static void AVI_IndexStop    ( demux_t * );
+static bool AVI_IndexSwitch  ( demux_t * );
+static bool AVI_IndexSeekable( demux_t * );
 
 static void AVI_ExtractSubtitle( demux_t *, unsigned int i_stream, avi_chunk_list_t *, avi_chunk_STRING_t * );
 
 static mtime_t  AVI_MovieGetLength( demux_t * );
+static void     AVI_TrackFixBeOS( demux_t * );
 
 static void AVI_MetaLoad( demux_t *, avi_chunk_list_t *p_riff, avi_chunk_avih_t *p_avih );
 
@@ -283,6 +308,7 @@ static int Open( vlc_object_t * p_this )
     p_sys->track    = NULL;
     p_sys->meta     = NULL;
     TAB_INIT(p_sys->i_attachment, p_sys->attachment);
+    vlc_mutex_init( &p_sys->index_lock );
 
     stream_Control( p_demux->s, STREAM_CAN_FASTSEEK, &p_sys->b_seekable );
 
@@ -304,6 +330,7 @@ static int Open( vlc_object_t * p_this )
     if( AVI_ChunkReadRoot( p_demux->s, &p_sys->ck_root ) )
     {
         msg_Err( p_demux, "avi module discarded (invalid file)" );
+        vlc_mutex_destroy( &p_sys->index_lock );
         free(p_sys);
         return VLC_EGENERIC;
     }
@@ -631,7 +658,12 @@ static int Open( vlc_object_t * p_this )
 aviindex:
         if( p_sys->b_seekable )
         {
-            AVI_IndexCreate( p_demux );
+            /* Play right away, seek once the index is ready. An index
+             * from the cache is used at once. */
+            if( AVI_IndexStart( p_demux ) )
+                AVI_IndexLoad( p_demux );
+            else
+                AVI_IndexSwitch( p_demux );
         }
         else
         {
@@ -656,7 +688,8 @@ aviindex:
             i_idx_totalframes = __MAX(i_idx_totalframes, tk->idx.i_size);
             continue;
     }
-    if( i_idx_totalframes != p_avih->i_totalframes &&
+    if( p_sys->index_new == NULL &&
+        i_idx_totalframes != p_avih->i_totalframes &&
         p_sys->i_length < (mtime_t)p_avih->i_totalframes *
                           (mtime_t)p_avih->i_microsecperframe /
                           (mtime_t)1000000 )
@@ -668,72 +701,12 @@ aviindex:
                            "approximative or will exhibit strange behavior" );
         if( i_do_index == 0 && !b_index )
         {
-            if( !p_sys->b_seekable ) {
-                b_index = true;
-                goto aviindex;
-            }
-            switch( dialog_Question( p_demux, _("Broken or missing AVI Index") ,
-               _( "Because this AVI file index is broken or missing, "
-                  "seeking will not work correctly.\n"
-                  "VLC won't repair your file but can temporary fix this "
-                  "problem by building an index in memory.\n"
-                  "This step might take a long time on a large file.\n"
-                  "What do you want to do ?" ),
-                  _( "Build index then play" ), _( "Play as is" ), _( "Do not play") ) )
-            {
-                case 1:
-                    b_index = true;
-                    msg_Dbg( p_demux, "Fixing AVI index" );
-                    goto aviindex;
-                case 3:
-                    /* Kill input */
-                    vlc_object_kill( p_demux->p_parent );
-                    goto error;
-            }
+            b_index = true;
+            goto aviindex;
         }
     }
 
-    /* fix some BeOS MediaKit generated file */
-    for( i = 0 ; i < p_sys->i_track; i++ )
-    {
-        avi_track_t         *tk = p_sys->track[i];
-        avi_chunk_list_t    *p_strl;
-        avi_chunk_strh_t    *p_strh;
-        avi_chunk_strf_auds_t    *p_auds;
-
-        if( tk->i_cat != AUDIO_ES )
-        {
-            continue;
-        }
-        if( tk->idx.i_size < 1 ||
-            tk->i_scale != 1 ||
-            tk->i_samplesize != 0 )
-        {
-            continue;
-        }
-        p_strl = AVI_ChunkFind( p_hdrl, AVIFOURCC_strl, i );
-        p_strh = AVI_ChunkFind( p_strl, AVIFOURCC_strh, 0 );
-        p_auds = AVI_ChunkFind( p_strl, AVIFOURCC_strf, 0 );
-
-        if( p_auds->p_wf->wFormatTag != WAVE_FORMAT_PCM &&
-            (unsigned int)tk->i_rate == p_auds->p_wf->nSamplesPerSec )
-        {
-            int64_t i_track_length =
-                tk->idx.p_entry[tk->idx.i_size-1].i_length +
-                tk->idx.p_entry[tk->idx.i_size-1].i_lengthtotal;
-            mtime_t i_length = (mtime_t)p_avih->i_totalframes *
-                               (mtime_t)p_avih->i_microsecperframe;
-
-            if( i_length == 0 )
-            {
-                msg_Warn( p_demux, "track[%d] cannot be fixed (BeOS MediaKit generated)", i );
-                continue;
-            }
-            tk->i_samplesize = 1;
-            tk->i_rate       = i_track_length  * (int64_t)1000000/ i_length;
-            msg_Warn( p_demux, "track[%d] fixed with rate=%d scale=%d (BeOS MediaKit generated)", i, tk->i_rate, tk->i_scale );
-        }
-    }
+    AVI_TrackFixBeOS( p_demux );
 
     if( p_sys->b_seekable )
     {
@@ -747,6 +720,10 @@ aviindex:
     return VLC_SUCCESS;
 
 error:
+    AVI_IndexStop( p_demux );
+    free( p_sys->psz_index_cache );
+    vlc_mutex_destroy( &p_sys->index_lock );
+
     for( unsigned i = 0; i < p_sys->i_attachment; i++)
         vlc_input_attachment_Delete(p_sys->attachment[i]);
     free(p_sys->attachment);
@@ -768,6 +745,10 @@ static void Close ( vlc_object_t * p_this )
     unsigned int i;
     demux_sys_t *p_sys = p_demux->p_sys  ;
 
+    AVI_IndexStop( p_demux );
+    free( p_sys->psz_index_cache );
+    vlc_mutex_destroy( &p_sys->index_lock );
+
     for( i = 0; i < p_sys->i_track; i++ )
     {
         if( p_sys->track[i] )
@@ -957,7 +938,7 @@ static int Demux_Seekable( demux_t *p_demux )
             if( p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
             {
                 stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
-                if( AVI_PacketNext( p_demux ) )
+                if( AVI_PacketNext( p_demux->s ) )
                 {
                     return( AVI_TrackStopFinishedStreams( p_demux ) ? 0 : 1 );
                 }
@@ -971,7 +952,7 @@ static int Demux_Seekable( demux_t *p_demux )
             {
                 avi_packet_t avi_pk;
 
-                if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+                if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
                 {
                     msg_Warn( p_demux,
                              "cannot get packet header, track disabled" );
@@ -980,7 +961,7 @@ static int Demux_Seekable( demux_t *p_demux )
                 if( avi_pk.i_stream >= p_sys->i_track ||
                     ( avi_pk.i_cat != AUDIO_ES && avi_pk.i_cat != VIDEO_ES ) )
                 {
-                    if( AVI_PacketNext( p_demux ) )
+                    if( AVI_PacketNext( p_demux->s ) )
                     {
                         msg_Warn( p_demux,
                                   "cannot skip packet, track disabled" );
@@ -1021,7 +1002,7 @@ static int Demux_Seekable( demux_t *p_demux )
                     }
                     else
                     {
-                        if( AVI_PacketNext( p_demux ) )
+                        if( AVI_PacketNext( p_demux->s ) )
                         {
                             msg_Warn( p_demux,
                                       "cannot skip packet, track disabled" );
@@ -1170,6 +1151,10 @@ static int Demux_UnSeekable( demux_t *p_demux )
     unsigned int i_stream;
     unsigned int i_packet;
 
+    /* The index is being created in the background */
+    if( AVI_IndexSwitch( p_demux ) )
+        return Demux_Seekable( p_demux );
+
     if( p_sys->b_muxed )
     {
         msg_Err( p_demux, "Can not yet process muxed avi substreams without seeking" );
@@ -1211,7 +1196,7 @@ static int Demux_UnSeekable( demux_t *p_demux )
 
         avi_packet_t    avi_pk;
 
-        if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+        if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
         {
             return( 0 );
         }
@@ -1228,17 +1213,17 @@ static int Demux_UnSeekable( demux_t *p_demux )
                 case AVIFOURCC_JUNK:
                 case AVIFOURCC_LIST:
                 case AVIFOURCC_RIFF:
-                    return( !AVI_PacketNext( p_demux ) ? 1 : 0 );
+                    return( !AVI_PacketNext( p_demux->s ) ? 1 : 0 );
                 case AVIFOURCC_idx1:
                     if( p_sys->b_odml )
                     {
-                        return( !AVI_PacketNext( p_demux ) ? 1 : 0 );
+                        return( !AVI_PacketNext( p_demux->s ) ? 1 : 0 );
                     }
                     return( 0 );    /* eof */
                 default:
                     msg_Warn( p_demux,
                               "seems to have lost position, resync" );
-                    if( AVI_PacketSearch( p_demux ) )
+                    if( AVI_PacketSearch( p_demux, p_demux->s ) )
                     {
                         msg_Err( p_demux, "resync failed" );
                         return( -1 );
@@ -1272,7 +1257,7 @@ static int Demux_UnSeekable( demux_t *p_demux )
             }
             else
             {
-                if( AVI_PacketNext( p_demux ) )
+                if( AVI_PacketNext( p_demux->s ) )
                 {
                     return( 0 );
                 }
@@ -1447,6 +1432,8 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             return VLC_SUCCESS;
         case DEMUX_SET_POSITION:
             f = (double)va_arg( args, double );
+            if( !AVI_IndexSeekable( p_demux ) )
+                return VLC_EGENERIC;
             if( p_sys->b_seekable )
             {
                 i64 = (mtime_t)(1000000.0 * p_sys->i_length * f );
@@ -1468,6 +1455,8 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             int i_percent = 0;
 
             i64 = (int64_t)va_arg( args, int64_t );
+            if( !AVI_IndexSeekable( p_demux ) )
+                return VLC_EGENERIC;
             if( p_sys->i_length > 0 )
             {
                 i_percent = 100 * i64 / (p_sys->i_length*1000000);
@@ -1614,7 +1603,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
     if( p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
     {
         stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
-        if( AVI_PacketNext( p_demux ) )
+        if( AVI_PacketNext( p_demux->s ) )
         {
             return VLC_EGENERIC;
         }
@@ -1628,7 +1617,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
     {
         if( !vlc_object_alive (p_demux) ) return VLC_EGENERIC;
 
-        if( AVI_PacketGetHeader( p_demux, &avi_pk ) )
+        if( AVI_PacketGetHeader( p_demux->s, &avi_pk ) )
         {
             msg_Warn( p_demux, "cannot get packet header" );
             return VLC_EGENERIC;
@@ -1636,7 +1625,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
         if( avi_pk.i_stream >= p_sys->i_track ||
             ( avi_pk.i_cat != AUDIO_ES && avi_pk.i_cat != VIDEO_ES ) )
         {
-            if( AVI_PacketNext( p_demux ) )
+            if( AVI_PacketNext( p_demux->s ) )
             {
                 return VLC_EGENERIC;
             }
@@ -1670,7 +1659,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
                 return VLC_SUCCESS;
             }
 
-            if( AVI_PacketNext( p_demux ) )
+            if( AVI_PacketNext( p_demux->s ) )
             {
                 return VLC_EGENERIC;
             }
@@ -1968,17 +1957,17 @@ static void AVI_ParseStreamHeader( vlc_fourcc_t i_id,
 /****************************************************************************
  *
  ****************************************************************************/
-static int AVI_PacketGetHeader( demux_t *p_demux, avi_packet_t *p_pk )
+static int AVI_PacketGetHeader( stream_t *s, avi_packet_t *p_pk )
 {
     const uint8_t *p_peek;
 
-    if( stream_Peek( p_demux->s, &p_peek, 16 ) < 16 )
+    if( stream_Peek( s, &p_peek, 16 ) < 16 )
     {
         return VLC_EGENERIC;
     }
     p_pk->i_fourcc  = VLC_FOURCC( p_peek[0], p_peek[1], p_peek[2], p_peek[3] );
     p_pk->i_size    = GetDWLE( p_peek + 4 );
-    p_pk->i_pos     = stream_Tell( p_demux->s );
+    p_pk->i_pos     = stream_Tell( s );
     if( p_pk->i_fourcc == AVIFOURCC_LIST || p_pk->i_fourcc == AVIFOURCC_RIFF )
     {
         p_pk->i_type = VLC_FOURCC( p_peek[8],  p_peek[9],
@@ -1995,12 +1984,12 @@ static int AVI_PacketGetHeader( demux_t *p_demux, avi_packet_t *p_pk )
     return VLC_SUCCESS;
 }
 
-static int AVI_PacketNext( demux_t *p_demux )
+static int AVI_PacketNext( stream_t *s )
 {
     avi_packet_t    avi_ck;
     int             i_skip = 0;
 
-    if( AVI_PacketGetHeader( p_demux, &avi_ck ) )
+    if( AVI_PacketGetHeader( s, &avi_ck ) )
     {
         return VLC_EGENERIC;
     }
@@ -2020,7 +2009,7 @@ static int AVI_PacketNext( demux_t *p_demux )
         i_skip = __EVEN( avi_ck.i_size ) + 8;
     }
 
-    if( stream_Read( p_demux->s, NULL, i_skip ) != i_skip )
+    if( stream_Read( s, NULL, i_skip ) != i_skip )
     {
         return VLC_EGENERIC;
     }
@@ -2050,7 +2039,7 @@ static int AVI_PacketRead( demux_t   *p_demux,
     return VLC_SUCCESS;
 }
 
-static int AVI_PacketSearch( demux_t *p_demux )
+static int AVI_PacketSearch( demux_t *p_demux, stream_t *s )
 {
     demux_sys_t     *p_sys = p_demux->p_sys;
     avi_packet_t    avi_pk;
@@ -2058,11 +2047,11 @@ static int AVI_PacketSearch( demux_t *p_demux )
 
     for( ;; )
     {
-        if( stream_Read( p_demux->s, NULL, 1 ) != 1 )
+        if( stream_Read( s, NULL, 1 ) != 1 )
         {
             return VLC_EGENERIC;
         }
-        AVI_PacketGetHeader( p_demux, &avi_pk );
+        AVI_PacketGetHeader( s, &avi_pk );
         if( avi_pk.i_stream < p_sys->i_track &&
             ( avi_pk.i_cat == AUDIO_ES || avi_pk.i_cat == VIDEO_ES ) )
         {
@@ -2332,6 +2321,7 @@ static void AVI_IndexLoad( demux_t *p_demux )
     /* Select the longest index */
     for( unsigned i = 0; i < p_sys->i_track; i++ )
     {
+        avi_index_Clean( &p_sys->track[i]->idx );
         if( p_idx_indx[i].i_size > p_idx_idx1[i].i_size )
         {
             msg_Dbg( p_demux, "selected ODML index for stream[%u]", i );
@@ -2368,7 +2358,10 @@ static void AVI_IndexLoad( demux_t *p_demux )
     }
 }
 
-static void AVI_IndexCreate( demux_t *p_demux )
+/* Rebuilds the index from LIST-movi, reading through the given stream.
+ * Returns VLC_EGENERIC if it was interrupted. */
+static int AVI_IndexCreate( demux_t *p_demux, stream_t *s,
+                            avi_index_t p_index[], off_t *pi_last_pos )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
@@ -2377,9 +2370,7 @@ static void AVI_IndexCreate( demux_t *p_demux )
 
     unsigned int i_stream;
     off_t i_movi_end;
-
-    mtime_t i_dialog_update;
-    dialog_progress_bar_t *p_dialog = NULL;
+    int i_ret = VLC_SUCCESS;
 
     p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0);
     p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0);
@@ -2387,47 +2378,32 @@ static void AVI_IndexCreate( demux_t *p_demux )
     if( !p_movi )
     {
         msg_Err( p_demux, "cannot find p_movi" );
-        return;
+        return VLC_EGENERIC;
     }
 
-    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
-        avi_index_Init( &p_sys->track[i_stream]->idx );
-
     i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
-                        stream_Size( p_demux->s ) );
-
-    stream_Seek( p_demux->s, p_movi->i_chunk_pos + 12 );
-    msg_Warn( p_demux, "creating index from LIST-movi, will take time !" );
+                        stream_Size( s ) );
 
+    stream_Seek( s, p_movi->i_chunk_pos + 12 );
+    msg_Dbg( p_demux, "creating index from LIST-movi" );
 
-    /* Only show dialog if AVI is > 10MB */
-    i_dialog_update = mdate();
-    if( stream_Size( p_demux->s ) > 10000000 )
-        p_dialog = dialog_ProgressCreate( p_demux, _("Fixing AVI Index..."),
-                                       NULL, _("Cancel") );
-
-    for( ;; )
+    for( unsigned i_count = 0;; i_count++ )
     {
         avi_packet_t pk;
 
-        if( !vlc_object_alive (p_demux) )
-            break;
-
-        /* Don't update/check dialog too often */
-        if( p_dialog && mdate() - i_dialog_update > 100000 )
+        if( !(i_count % 1024) )
         {
-            if( dialog_ProgressCancelled( p_dialog ) )
-                break;
-
-            double f_current = stream_Tell( p_demux->s );
-            double f_size    = stream_Size( p_demux->s );
-            double f_pos     = f_current / f_size;
-            dialog_ProgressSet( p_dialog, NULL, f_pos );
-
-            i_dialog_update = mdate();
+            vlc_mutex_lock( &p_sys->index_lock );
+            bool b_abort = p_sys->b_index_abort;
+            vlc_mutex_unlock( &p_sys->index_lock );
+            if( b_abort )
+            {
+                i_ret = VLC_EGENERIC;
+                goto print_stat;
+            }
         }
 
-        if( AVI_PacketGetHeader( p_demux, &pk ) )
+        if( AVI_PacketGetHeader( s, &pk ) )
             break;
 
         if( pk.i_stream < p_sys->i_track &&
@@ -2440,7 +2416,7 @@ static void AVI_IndexCreate( demux_t *p_demux )
             index.i_flags   = AVI_GetKeyFlag(tk->i_codec, pk.i_peek);
             index.i_pos     = pk.i_pos;
             index.i_length  = pk.i_size;
-            avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos, &index );
+            avi_index_Append( &p_index[pk.i_stream], pi_last_pos, &index );
         }
         else
         {
@@ -2454,7 +2430,7 @@ static void AVI_IndexCreate( demux_t *p_demux )
                                             AVIFOURCC_RIFF, 1 );
 
                     msg_Dbg( p_demux, "looking for new RIFF chunk" );
-                    if( stream_Seek( p_demux->s, p_sysx->i_chunk_pos + 24 ) )
+                    if( stream_Seek( s, p_sysx->i_chunk_pos + 24 ) )
                         goto print_stat;
                     break;
                 }
@@ -2470,7 +2446,7 @@ static void AVI_IndexCreate( demux_t *p_demux )
 
             default:
                 msg_Warn( p_demux, "need resync, probably broken avi" );
-                if( AVI_PacketSearch( p_demux ) )
+                if( AVI_PacketSearch( p_demux, s ) )
                 {
                     msg_Warn( p_demux, "lost sync, abord index creation" );
                     goto print_stat;
@@ -2479,20 +2455,408 @@ static void AVI_IndexCreate( demux_t *p_demux )
         }
 
         if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end ) ||
-            AVI_PacketNext( p_demux ) )
+            AVI_PacketNext( s ) )
         {
             break;
         }
     }
 
 print_stat:
-    if( p_dialog != NULL )
-        dialog_ProgressDestroy( p_dialog );
-
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
     {
         msg_Dbg( p_demux, "stream[%d] creating %d index entries",
-                i_stream, p_sys->track[i_stream]->idx.i_size );
+                i_stream, p_index[i_stream].i_size );
+    }
+    return i_ret;
+}
+
+/*****************************************************************************
+ * Background index creation: the movie plays with Demux_UnSeekable while a
+ * thread rebuilds the index through another stream, then switches to
+ * Demux_Seekable. The rebuilt index is cached for the next time.
+ *****************************************************************************/
+static char *AVI_IndexCachePath( demux_t *p_demux )
+{
+    struct md5_s md5;
+    char psz_size[32];
+    struct stat st;
+
+    InitMD5( &md5 );
+    AddMD5( &md5, p_demux->psz_access, strlen( p_demux->psz_access ) );
+    AddMD5( &md5, p_demux->psz_location, strlen( p_demux->psz_location ) );
+    snprintf( psz_size, sizeof( psz_size ), "%"PRIu64,
+              stream_Size( p_demux->s ) );
+    AddMD5( &md5, psz_size, strlen( psz_size ) );
+    /* A rewritten file of the same size gets another index */
+    if( p_demux->psz_file != NULL && !vlc_stat( p_demux->psz_file, &st ) )
+        AddMD5( &md5, &st.st_mtime, sizeof( st.st_mtime ) );
+    EndMD5( &md5 );
+
+    char *psz_hash = psz_md5_hash( &md5 );
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    char *psz_path = NULL;
+
+    if( psz_hash != NULL && psz_dir != NULL
+     && asprintf( &psz_path, "%s"DIR_SEP"avi-index"DIR_SEP"%s.idx",
+                  psz_dir, psz_hash ) == -1 )
+        psz_path = NULL;
+    free( psz_dir );
+    free( psz_hash );
+    return psz_path;
+}
+
+/* Cache layout, little endian: "AVIINDEX", the file size, the number of
+ * tracks, then for each track the number of entries and the entries. */
+#define AVI_INDEX_ENTRY_SIZE 20
+
+static int AVI_IndexCacheLoad( demux_t *p_demux, const char *psz_path,
+                               avi_index_t p_index[], off_t *pi_last_pos )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint8_t header[20];
+
+    FILE *file = vlc_fopen( psz_path, "rb" );
+    if( file == NULL )
+        return VLC_EGENERIC;
+
+    if( fread( header, sizeof( header ), 1, file ) != 1
+     || memcmp( header, "AVIINDEX", 8 )
+     || GetQWLE( header + 8 ) != (uint64_t)stream_Size( p_demux->s )
+     || GetDWLE( header + 16 ) != p_sys->i_track )
+        goto error;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        uint8_t entry[AVI_INDEX_ENTRY_SIZE];
+        uint32_t i_count;
+
+        if( fread( entry, 4, 1, file ) != 1 )
+            goto error;
+        i_count = GetDWLE( entry );
+        for( uint32_t j = 0; j < i_count; j++ )
+        {
+            avi_entry_t index;
+
+            if( fread( entry, sizeof( entry ), 1, file ) != 1 )
+                goto error;
+            index.i_id     = GetDWLE( entry );
+            index.i_flags  = GetDWLE( entry + 4 );
+            index.i_pos    = GetQWLE( entry + 8 );
+            index.i_length = GetDWLE( entry + 16 );
+            if( index.i_pos < 0 || index.i_pos >= stream_Size( p_demux->s ) )
+                goto error;
+            avi_index_Append( &p_index[i], pi_last_pos, &index );
+        }
+    }
+    fclose( file );
+    return VLC_SUCCESS;
+
+error:
+    msg_Warn( p_demux, "ignoring invalid index cache %s", psz_path );
+    fclose( file );
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_index_Clean( &p_index[i] );
+        avi_index_Init( &p_index[i] );
+    }
+    return VLC_EGENERIC;
+}
+
+static void AVI_IndexCacheSave( demux_t *p_demux, const char *psz_path,
+                                const avi_index_t p_index[] )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint8_t header[20];
+
+    char *psz_dir = strdup( psz_path );
+    if( psz_dir == NULL )
+        return;
+    *strrchr( psz_dir, DIR_SEP_CHAR ) = '\0';
+    char *psz_parent = strrchr( psz_dir, DIR_SEP_CHAR );
+    if( psz_parent != NULL )
+    {
+        *psz_parent = '\0';
+        vlc_mkdir( psz_dir, 0700 );
+        *psz_parent = DIR_SEP_CHAR;
+    }
+    vlc_mkdir( psz_dir, 0700 );
+    free( psz_dir );
+
+    FILE *file = vlc_fopen( psz_path, "wb" );
+    if( file == NULL )
+    {
+        msg_Warn( p_demux, "cannot write index cache %s", psz_path );
+        return;
+    }
+
+    memcpy( header, "AVIINDEX", 8 );
+    SetQWLE( header + 8, stream_Size( p_demux->s ) );
+    SetDWLE( header + 16, p_sys->i_track );
+    bool b_ok = fwrite( header, sizeof( header ), 1, file ) == 1;
+
+    for( unsigned i = 0; b_ok && i < p_sys->i_track; i++ )
+    {
+        uint8_t entry[AVI_INDEX_ENTRY_SIZE];
+
+        SetDWLE( entry, p_index[i].i_size );
+        b_ok = fwrite( entry, 4, 1, file ) == 1;
+        for( unsigned j = 0; b_ok && j < p_index[i].i_size; j++ )
+        {
+            const avi_entry_t *p_entry = &p_index[i].p_entry[j];
+
+            SetDWLE( entry, p_entry->i_id );
+            SetDWLE( entry + 4, p_entry->i_flags );
+            SetQWLE( entry + 8, p_entry->i_pos );
+            SetDWLE( entry + 16, p_entry->i_length );
+            b_ok = fwrite( entry, sizeof( entry ), 1, file ) == 1;
+        }
+    }
+    if( fclose( file ) || !b_ok )
+    {
+        msg_Warn( p_demux, "cannot write index cache %s", psz_path );
+        vlc_unlink( psz_path );
+    }
+}
+
+static void *AVI_IndexThread( void *data )
+{
+    demux_t     *p_demux = data;
+    demux_sys_t *p_sys = p_demux->p_sys;
+    char        *psz_url;
+    int          i_ret = VLC_EGENERIC;
+
+    if( asprintf( &psz_url, "%s://%s", p_demux->psz_access,
+                  p_demux->psz_location ) != -1 )
+    {
+        stream_t *s = stream_UrlNew( p_demux, psz_url );
+        free( psz_url );
+
+        if( s != NULL )
+        {
+            if( stream_Size( s ) == p_sys->i_index_size )
+                i_ret = AVI_IndexCreate( p_demux, s, p_sys->index_new,
+                                         &p_sys->i_index_lastchunk_pos );
+            stream_Delete( s );
+        }
+    }
+
+    if( i_ret == VLC_SUCCESS && p_sys->psz_index_cache != NULL )
+        AVI_IndexCacheSave( p_demux, p_sys->psz_index_cache,
+                            p_sys->index_new );
+
+    vlc_mutex_lock( &p_sys->index_lock );
+    p_sys->b_index_done = true;
+    p_sys->b_index_ok = i_ret == VLC_SUCCESS;
+    vlc_mutex_unlock( &p_sys->index_lock );
+    return NULL;
+}
+
+/* Starts playing without index. Returns VLC_SUCCESS if the index will be
+ * rebuilt, or has been loaded from the cache. */
+static int AVI_IndexStart( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* The interleaved method does not use the index */
+    if( p_demux->pf_demux == Demux_UnSeekable )
+        return VLC_EGENERIC;
+
+    p_sys->index_new = calloc( p_sys->i_track, sizeof( avi_index_t ) );
+    if( p_sys->index_new == NULL )
+        return VLC_EGENERIC;
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        avi_index_Init( &p_sys->index_new[i] );
+    p_sys->i_index_lastchunk_pos = 0;
+    p_sys->i_index_size = stream_Size( p_demux->s );
+
+    if( var_InheritBool( p_demux, "avi-index-cache" ) )
+        p_sys->psz_index_cache = AVI_IndexCachePath( p_demux );
+
+    if( p_sys->psz_index_cache != NULL
+     && !AVI_IndexCacheLoad( p_demux, p_sys->psz_index_cache,
+                             p_sys->index_new,
+                             &p_sys->i_index_lastchunk_pos ) )
+    {
+        msg_Dbg( p_demux, "index loaded from %s", p_sys->psz_index_cache );
+        p_sys->b_index_done = p_sys->b_index_ok = true;
+    }
+    else
+    {
+        p_sys->b_index_done = p_sys->b_index_ok = false;
+        p_sys->b_index_abort = false;
+        if( vlc_clone( &p_sys->index_thread, AVI_IndexThread, p_demux,
+                       VLC_THREAD_PRIORITY_LOW ) )
+        {
+            free( p_sys->index_new );
+            p_sys->index_new = NULL;
+            return VLC_EGENERIC;
+        }
+        p_sys->b_indexing = true;
+        msg_Dbg( p_demux, "creating index in the background" );
+    }
+
+    /* The movie plays from the start, without any index meanwhile */
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_index_Clean( &p_sys->track[i]->idx );
+        avi_index_Init( &p_sys->track[i]->idx );
+    }
+    p_sys->i_movi_lastchunk_pos = 0;
+    p_demux->pf_demux = Demux_UnSeekable;
+    return VLC_SUCCESS;
+}
+
+static void AVI_IndexStop( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->b_indexing )
+    {
+        vlc_mutex_lock( &p_sys->index_lock );
+        p_sys->b_index_abort = true;
+        vlc_mutex_unlock( &p_sys->index_lock );
+        vlc_join( p_sys->index_thread, NULL );
+        p_sys->b_indexing = false;
+    }
+    if( p_sys->index_new != NULL )
+    {
+        for( unsigned i = 0; i < p_sys->i_track; i++ )
+            avi_index_Clean( &p_sys->index_new[i] );
+        free( p_sys->index_new );
+        p_sys->index_new = NULL;
+    }
+}
+
+/* Switches to Demux_Seekable once the index is ready.
+ * Returns true if the index is in use. */
+static bool AVI_IndexSwitch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->index_new == NULL )
+        return false;
+
+    vlc_mutex_lock( &p_sys->index_lock );
+    bool b_done = p_sys->b_index_done;
+    bool b_ok = p_sys->b_index_ok;
+    vlc_mutex_unlock( &p_sys->index_lock );
+
+    if( !b_done )
+        return false;
+    if( p_sys->b_indexing )
+    {
+        vlc_join( p_sys->index_thread, NULL );
+        p_sys->b_indexing = false;
+    }
+    if( !b_ok )
+    {
+        msg_Warn( p_demux, "cannot create index, seeking disabled" );
+        AVI_IndexStop( p_demux );
+        p_sys->b_seekable = false;
+        return false;
+    }
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_track_t *tk = p_sys->track[i];
+
+        avi_index_Clean( &tk->idx );
+        tk->idx = p_sys->index_new[i];
+
+        /* Without index, the byte count is kept in i_idxposb:
+         * find the chunk where the playback stands */
+        if( tk->i_samplesize )
+        {
+            int64_t i_bytes = tk->i_idxposb;
+
+            tk->i_idxposc = 0;
+            while( tk->i_idxposc < tk->idx.i_size &&
+                   tk->idx.p_entry[tk->i_idxposc].i_lengthtotal +
+                   tk->idx.p_entry[tk->i_idxposc].i_length <= i_bytes )
+                tk->i_idxposc++;
+            if( tk->i_idxposc < tk->idx.i_size )
+                tk->i_idxposb = i_bytes -
+                                tk->idx.p_entry[tk->i_idxposc].i_lengthtotal;
+            else
+                tk->i_idxposb = 0;
+        }
+    }
+    free( p_sys->index_new );
+    p_sys->index_new = NULL;
+    p_sys->i_movi_lastchunk_pos = p_sys->i_index_lastchunk_pos;
+
+    p_sys->i_length = AVI_MovieGetLength( p_demux );
+    msg_Dbg( p_demux, "index ready, length %"PRId64" s", p_sys->i_length );
+
+    p_demux->pf_demux = Demux_Seekable;
+    return true;
+}
+
+/* Seeking needs the complete index. It is not waited for: the seek fails
+ * meanwhile, and playback goes on. */
+static bool AVI_IndexSeekable( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    AVI_IndexSwitch( p_demux );
+    if( p_sys->index_new != NULL )
+    {
+        msg_Warn( p_demux, "index not ready yet, cannot seek" );
+        return false;
+    }
+    return true;
+}
+
+/* Fixes some BeOS MediaKit generated files, once the index is known.
+ * Only done while opening: the rate of a playing track must not change. */
+static void AVI_TrackFixBeOS( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    unsigned int i;
+
+    avi_chunk_list_t *p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0 );
+    avi_chunk_list_t *p_hdrl = AVI_ChunkFind( p_riff, AVIFOURCC_hdrl, 0 );
+    avi_chunk_avih_t *p_avih = AVI_ChunkFind( p_hdrl, AVIFOURCC_avih, 0 );
+
+    for( i = 0 ; i < p_sys->i_track; i++ )
+    {
+        avi_track_t         *tk = p_sys->track[i];
+        avi_chunk_list_t    *p_strl;
+        avi_chunk_strh_t    *p_strh;
+        avi_chunk_strf_auds_t    *p_auds;
+
+        if( tk->i_cat != AUDIO_ES )
+        {
+            continue;
+        }
+        if( tk->idx.i_size < 1 ||
+            tk->i_scale != 1 ||
+            tk->i_samplesize != 0 )
+        {
+            continue;
+        }
+        p_strl = AVI_ChunkFind( p_hdrl, AVIFOURCC_strl, i );
+        p_strh = AVI_ChunkFind( p_strl, AVIFOURCC_strh, 0 );
+        p_auds = AVI_ChunkFind( p_strl, AVIFOURCC_strf, 0 );
+
+        if( p_auds->p_wf->wFormatTag != WAVE_FORMAT_PCM &&
+            (unsigned int)tk->i_rate == p_auds->p_wf->nSamplesPerSec )
+        {
+            int64_t i_track_length =
+                tk->idx.p_entry[tk->idx.i_size-1].i_length +
+                tk->idx.p_entry[tk->idx.i_size-1].i_lengthtotal;
+            mtime_t i_length = (mtime_t)p_avih->i_totalframes *
+                               (mtime_t)p_avih->i_microsecperframe;
+
+            if( i_length == 0 )
+            {
+                msg_Warn( p_demux, "track[%d] cannot be fixed (BeOS MediaKit generated)", i );
+                continue;
+            }
+            tk->i_samplesize = 1;
+            tk->i_rate       = i_track_length  * (int64_t)1000000/ i_length;
+            msg_Warn( p_demux, "track[%d] fixed with rate=%d scale=%d (BeOS MediaKit generated)", i, tk->i_rate, tk->i_scale );
+        }
     }
 }
 
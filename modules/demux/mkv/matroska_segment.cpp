@@ -29,12 +29,15 @@
 #include "demux.hpp"
 
 #include "Ebml_parser.hpp"
+#include "stream_io_callback.hpp"
 
 extern "C" {
 #include "../vobsub.h"
 }
 
 #include <vlc_codecs.h>
+#include <vlc_fs.h>
+#include <vlc_configuration.h>
 
 /* GetFourCC helper */
 #define GetFOURCC( p )  __GetFOURCC( (uint8_t*)p )
@@ -77,12 +80,19 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,ep(NULL)
     ,b_preloaded(false)
     ,b_ref_external_segments(false)
+    ,b_indexer(false)
+    ,b_indexer_abort(false)
+    ,i_indexer_size(0)
 {
     p_indexes = (mkv_index_t*)malloc( sizeof( mkv_index_t ) * i_index_max );
+    vlc_mutex_init( &index_lock );
+    b_index_complete = false;
 }
 
 matroska_segment_c::~matroska_segment_c()
 {
+    StopIndexer();
+
     for( size_t i_track = 0; i_track < tracks.size(); i_track++ )
     {
         delete tracks[i_track]->p_compression_data;
@@ -98,6 +108,7 @@ matroska_segment_c::~matroska_segment_c()
     free( psz_title );
     free( psz_date_utc );
     free( p_indexes );
+    vlc_mutex_destroy( &index_lock );
 
     delete ep;
     delete segment;
@@ -425,12 +436,55 @@ void matroska_segment_c::InformationCreate( )
 
 void matroska_segment_c::IndexAppendCluster( KaxCluster *cluster )
 {
-#define idx p_indexes[i_index]
+    /* With cues, only extend the index past its end (no indexer runs) */
+    if( b_cues && i_index > 0 && p_indexes[i_index - 1].i_position >=
+                                 (int64_t)cluster->GetElementPosition() )
+        return;
+
+    IndexInsert( cluster->GetElementPosition(),
+                 cluster->GlobalTimecode() / (mtime_t) 1000 );
+}
+
+/* Returns the first index entry at or after the given position.
+ * The index lock must be held. */
+int matroska_segment_c::IndexFind( int64_t i_position ) const
+{
+    int i_low = 0, i_high = i_index;
+
+    while( i_low < i_high )
+    {
+        int i_mid = ( i_low + i_high ) / 2;
+
+        if( p_indexes[i_mid].i_position < i_position )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+/* Both the playback and the indexer add clusters: keep the index sorted by
+ * position and skip the clusters that are already known. */
+void matroska_segment_c::IndexInsert( int64_t i_position, mtime_t i_time )
+{
+    vlc_mutex_lock( &index_lock );
+
+    int i_idx = IndexFind( i_position );
+    if( i_idx < i_index && p_indexes[i_idx].i_position == i_position )
+    {
+        vlc_mutex_unlock( &index_lock );
+        return;
+    }
+
+    memmove( &p_indexes[i_idx + 1], &p_indexes[i_idx],
+             ( i_index - i_idx ) * sizeof( mkv_index_t ) );
+#define idx p_indexes[i_idx]
     idx.i_track       = -1;
     idx.i_block_number= -1;
-    idx.i_position    = cluster->GetElementPosition();
-    idx.i_time        = cluster->GlobalTimecode()/ (mtime_t) 1000;
+    idx.i_position    = i_position;
+    idx.i_time        = i_time;
     idx.b_key         = true;
+#undef idx
 
     i_index++;
     if( i_index >= i_index_max )
@@ -439,7 +493,259 @@ void matroska_segment_c::IndexAppendCluster( KaxCluster *cluster )
         p_indexes = (mkv_index_t*)xrealloc( p_indexes,
                                         sizeof( mkv_index_t ) * i_index_max );
     }
-#undef idx
+    vlc_mutex_unlock( &index_lock );
+}
+
+/*****************************************************************************
+ * Cluster indexer: files without cues are indexed in the background, so that
+ * seeks do not have to walk the clusters. Only the cluster headers are read,
+ * through a separate stream, and only when the access can seek fast.
+ *****************************************************************************/
+void matroska_segment_c::StartIndexer()
+{
+    bool b_fastseek;
+
+    if( b_indexer || b_cues || b_index_complete || segment == NULL )
+        return;
+    /* The cluster positions must match those of another reader */
+    if( sys.streams.empty() || &es != sys.streams[0]->p_estream )
+        return;
+    if( !var_InheritBool( &sys.demuxer, "mkv-index" ) )
+        return;
+    if( stream_Control( sys.demuxer.s, STREAM_CAN_FASTSEEK, &b_fastseek )
+     || !b_fastseek )
+        return;
+
+    i_indexer_size = stream_Size( sys.demuxer.s );
+    b_indexer_abort = false;
+    b_indexer = !vlc_clone( &indexer, IndexerThread, this,
+                            VLC_THREAD_PRIORITY_LOW );
+}
+
+void matroska_segment_c::StopIndexer()
+{
+    if( !b_indexer )
+        return;
+
+    vlc_mutex_lock( &index_lock );
+    b_indexer_abort = true;
+    vlc_mutex_unlock( &index_lock );
+
+    vlc_join( indexer, NULL );
+    b_indexer = false;
+}
+
+void *matroska_segment_c::IndexerThread( void *data )
+{
+    static_cast<matroska_segment_c *>( data )->IndexerThread();
+    return NULL;
+}
+
+void matroska_segment_c::IndexerThread()
+{
+    demux_t *p_demux = &sys.demuxer;
+    std::string cache;
+    char *psz_url;
+
+    if( var_InheritBool( p_demux, "mkv-index-cache" ) )
+    {
+        cache = IndexCachePath();
+        if( !cache.empty() && IndexLoad( cache ) )
+        {
+            msg_Dbg( p_demux, "cluster index loaded from %s", cache.c_str() );
+            return;
+        }
+    }
+
+    if( asprintf( &psz_url, "%s://%s", p_demux->psz_access,
+                  p_demux->psz_location ) == -1 )
+        return;
+    stream_t *s = stream_UrlNew( p_demux, psz_url );
+    free( psz_url );
+    if( s == NULL )
+        return;
+    if( (uint64_t)stream_Size( s ) != i_indexer_size )
+    {
+        stream_Delete( s );
+        return;
+    }
+
+    vlc_stream_io_callback io( s, true );
+    EbmlStream estream( io );
+    int64_t i_next = i_start_pos;
+    bool b_complete = false;
+    unsigned i_count = 0;
+
+    for( ;; )
+    {
+        vlc_mutex_lock( &index_lock );
+        bool b_abort = b_indexer_abort;
+        vlc_mutex_unlock( &index_lock );
+        if( b_abort )
+            break;
+
+        io.setFilePointer( i_next, seek_beginning );
+
+        EbmlParser parser( &estream, segment, p_demux );
+        EbmlElement *el = parser.Get();
+        if( el == NULL )
+        {   /* end of the segment */
+            b_complete = true;
+            break;
+        }
+        /* Clusters of unknown size cannot be skipped over */
+        if( !el->IsFiniteSize() )
+            break;
+        i_next = el->GetElementPosition() + el->HeadSize() + el->GetSize();
+
+        if( MKV_IS_ID( el, KaxCluster ) )
+        {
+            int64_t i_position = el->GetElementPosition();
+
+            parser.Down();
+            while( ( el = parser.Get() ) != NULL )
+            {
+                if( MKV_IS_ID( el, KaxClusterTimecode ) )
+                {
+                    KaxClusterTimecode &ctc = *(KaxClusterTimecode*)el;
+
+                    ctc.ReadData( estream.I_O(), SCOPE_ALL_DATA );
+                    IndexInsert( i_position, uint64( ctc ) * i_timescale
+                                             / (mtime_t) 1000 );
+                    i_count++;
+                    break;
+                }
+            }
+        }
+    }
+
+    msg_Dbg( p_demux, "cluster indexer %s: %u clusters",
+             b_complete ? "done" : "stopped", i_count );
+    if( !b_complete )
+        return;
+
+    vlc_mutex_lock( &index_lock );
+    b_index_complete = true;
+    vlc_mutex_unlock( &index_lock );
+
+    if( !cache.empty() )
+        IndexSave( cache );
+}
+
+/* The cached index of a segment is named after its UID */
+std::string matroska_segment_c::IndexCachePath() const
+{
+    std::string path;
+
+    if( p_segment_uid == NULL || p_segment_uid->GetSize() == 0 )
+        return path;
+
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_dir == NULL )
+        return path;
+    path = psz_dir;
+    free( psz_dir );
+
+    vlc_mkdir( path.c_str(), 0700 );
+    path += DIR_SEP "mkv-index";
+    vlc_mkdir( path.c_str(), 0700 );
+    path += DIR_SEP;
+
+    const binary *p_uid = p_segment_uid->GetBuffer();
+    for( size_t i = 0; i < p_segment_uid->GetSize(); i++ )
+    {
+        char hex[3];
+
+        snprintf( hex, sizeof( hex ), "%02x", p_uid[i] );
+        path += hex;
+    }
+    path += ".idx";
+    return path;
+}
+
+/* Cache layout (host byte order): "MKVINDEX", the file size, the number of
+ * clusters, then the position and the time of each cluster. */
+static const char index_magic[8] = { 'M','K','V','I','N','D','E','X' };
+
+bool matroska_segment_c::IndexLoad( const std::string & path )
+{
+    FILE *file = vlc_fopen( path.c_str(), "rb" );
+    if( file == NULL )
+        return false;
+
+    char magic[8];
+    uint64_t i_size, i_count;
+    std::vector<int64_t> entries;
+    bool b_ok = fread( magic, sizeof( magic ), 1, file ) == 1
+             && !memcmp( magic, index_magic, sizeof( magic ) )
+             && fread( &i_size, sizeof( i_size ), 1, file ) == 1
+             && fread( &i_count, sizeof( i_count ), 1, file ) == 1
+             && i_size == i_indexer_size && i_count > 0
+             && i_count < i_size / 8;
+    if( b_ok )
+    {
+        entries.resize( 2 * i_count );
+        b_ok = fread( &entries[0], sizeof( int64_t ), 2 * i_count,
+                      file ) == 2 * i_count;
+    }
+    fclose( file );
+
+    /* Only take increasing positions within the file */
+    for( uint64_t i = 0; b_ok && i < i_count; i++ )
+        b_ok = entries[2 * i] >= i_start_pos
+            && (uint64_t)entries[2 * i] < i_size
+            && ( i == 0 || entries[2 * i] > entries[2 * i - 2] );
+    if( !b_ok )
+    {
+        msg_Warn( &sys.demuxer, "ignoring invalid index cache %s",
+                  path.c_str() );
+        return false;
+    }
+
+    for( uint64_t i = 0; i < i_count; i++ )
+        IndexInsert( entries[2 * i], entries[2 * i + 1] );
+
+    vlc_mutex_lock( &index_lock );
+    b_index_complete = true;
+    vlc_mutex_unlock( &index_lock );
+    return true;
+}
+
+void matroska_segment_c::IndexSave( const std::string & path )
+{
+    std::vector<int64_t> entries;
+
+    vlc_mutex_lock( &index_lock );
+    entries.reserve( 2 * i_index );
+    for( int i = 0; i < i_index; i++ )
+    {
+        entries.push_back( p_indexes[i].i_position );
+        entries.push_back( p_indexes[i].i_time );
+    }
+    vlc_mutex_unlock( &index_lock );
+
+    uint64_t i_count = entries.size() / 2;
+    if( i_count == 0 )
+        return;
+
+    FILE *file = vlc_fopen( path.c_str(), "wb" );
+    if( file == NULL )
+    {
+        msg_Warn( &sys.demuxer, "cannot write index cache %s", path.c_str() );
+        return;
+    }
+    if( fwrite( index_magic, sizeof( index_magic ), 1, file ) != 1
+     || fwrite( &i_indexer_size, sizeof( i_indexer_size ), 1, file ) != 1
+     || fwrite( &i_count, sizeof( i_count ), 1, file ) != 1
+     || fwrite( &entries[0], sizeof( int64_t ), entries.size(), file )
+            != entries.size() )
+    {
+        msg_Warn( &sys.demuxer, "cannot write index cache %s", path.c_str() );
+        fclose( file );
+        vlc_unlink( path.c_str() );
+        return;
+    }
+    fclose( file );
 }
 
 bool matroska_segment_c::PreloadFamily( const matroska_segment_c & of_segment )
@@ -694,17 +1000,20 @@ void matroska_segment_c::Seek( mtime_t i_date, mtime_t i_time_offset, int64_t i_
     int i_cat;
     bool b_has_key = false;
 
-    if( i_global_position >= 0 )
+    int64_t i_last_position = i_start_pos;
+    vlc_mutex_lock( &index_lock );
+    if( i_index > 0 )
+        i_last_position = p_indexes[i_index - 1].i_position;
+    vlc_mutex_unlock( &index_lock );
+
+    /* The cluster indexer may already have gone past the position */
+    if( i_global_position >= 0 && i_last_position < i_global_position )
     {
         /* Special case for seeking in files with no cues */
         EbmlElement *el = NULL;
 
         /* Start from the last known index instead of the beginning eachtime */
-        if( i_index == 0)
-            es.I_O().setFilePointer( i_start_pos, seek_beginning );
-        else
-            es.I_O().setFilePointer( p_indexes[ i_index - 1 ].i_position,
-                                     seek_beginning );
+        es.I_O().setFilePointer( i_last_position, seek_beginning );
         delete ep;
         ep = new EbmlParser( &es, segment, &sys.demuxer );
         cluster = NULL;
@@ -715,9 +1024,7 @@ void matroska_segment_c::Seek( mtime_t i_date, mtime_t i_time_offset, int64_t i_
             {
                 cluster = (KaxCluster *)el;
                 i_cluster_pos = cluster->GetElementPosition();
-                if( i_index == 0 ||
-                    ( i_index > 0 &&
-                      p_indexes[i_index - 1].i_position < (int64_t)cluster->GetElementPosition() ) )
+                if( (int64_t)i_cluster_pos > i_last_position )
                 {
                     ParseCluster(false);
                     IndexAppendCluster( cluster );
@@ -745,20 +1052,28 @@ void matroska_segment_c::Seek( mtime_t i_date, mtime_t i_time_offset, int64_t i_
         return;       
     }
 
-    int i_idx = 0;
+    vlc_mutex_lock( &index_lock );
     if ( i_index > 0 )
     {
+        /* Bisect for the last cluster starting before the date */
+        int i_low = 0, i_high = i_index;
 
-        for( ; i_idx < i_index; i_idx++ )
-            if( p_indexes[i_idx].i_time + i_time_offset > i_date )
-                break;
+        while( i_low < i_high )
+        {
+            int i_mid = ( i_low + i_high ) / 2;
 
-        if( i_idx > 0 )
-            i_idx--;
+            if( p_indexes[i_mid].i_time + i_time_offset > i_date )
+                i_high = i_mid;
+            else
+                i_low = i_mid + 1;
+        }
+
+        int i_idx = i_low > 0 ? i_low - 1 : 0;
 
         i_seek_position = p_indexes[i_idx].i_position;
         i_seek_time = p_indexes[i_idx].i_time;
     }
+    vlc_mutex_unlock( &index_lock );
 
     msg_Dbg( &sys.demuxer, "seek got %"PRId64" (%d%%)",
                 i_seek_time, (int)( 100 * i_seek_position / stream_Size( sys.demuxer.s ) ) );
@@ -858,14 +1173,25 @@ void matroska_segment_c::Seek( mtime_t i_date, mtime_t i_time_offset, int64_t i_
 
             delete block;
         }
-        if( b_has_key || !i_idx )
+        if( b_has_key )
+            break;
+
+        /* No key picture was found in the cluster seek to previous seekpoint.
+         * The indexer may have added clusters meanwhile: look it up again. */
+        vlc_mutex_lock( &index_lock );
+        int i_idx = IndexFind( i_seek_position );
+        if( i_idx > 0 )
+        {
+            i_date = i_time_offset + i_seek_time;
+            i_seek_position = p_indexes[i_idx - 1].i_position;
+            i_seek_time = p_indexes[i_idx - 1].i_time;
+        }
+        vlc_mutex_unlock( &index_lock );
+        if( i_idx == 0 )
             break;
 
-        /* No key picture was found in the cluster seek to previous seekpoint */
-        i_date = i_time_offset + p_indexes[i_idx].i_time;
-        i_idx--;
         i_pts = 0;
-        es.I_O().setFilePointer( p_indexes[i_idx].i_position );
+        es.I_O().setFilePointer( i_seek_position );
         delete ep;
         ep = new EbmlParser( &es, segment, &sys.demuxer );
         cluster = NULL;
@@ -1409,11 +1735,13 @@ bool matroska_segment_c::Select( mtime_t i_start_time )
     delete ep;
     ep = new EbmlParser( &es, segment, &sys.demuxer );
 
+    StartIndexer();
     return true;
 }
 
 void matroska_segment_c::UnSelect( )
 {
+    StopIndexer();
     sys.p_ev->ResetPci();
     for( size_t i_track = 0; i_track < tracks.size(); i_track++ )
     {
@@ -1461,6 +1789,7 @@ int matroska_segment_c::BlockGet( KaxBlock * & pp_block, KaxSimpleBlock * & pp_s
             }
 
             /* update the index */
+            vlc_mutex_lock( &index_lock );
 #define idx p_indexes[i_index - 1]
             if( i_index > 0 && idx.i_time == -1 )
             {
@@ -1471,6 +1800,7 @@ int matroska_segment_c::BlockGet( KaxBlock * & pp_block, KaxSimpleBlock * & pp_s
                 idx.b_key         = *pb_key_picture;
             }
 #undef idx
+            vlc_mutex_unlock( &index_lock );
             return VLC_SUCCESS;
         }
 
@@ -1537,10 +1867,7 @@ int matroska_segment_c::BlockGet( KaxBlock * & pp_block, KaxSimpleBlock * & pp_s
                 cluster->InitTimecode( uint64( ctc ), i_timescale );
  
                 /* add it to the index */
-                if( i_index == 0 ||
-                    ( i_index > 0 &&
-                      p_indexes[i_index - 1].i_position < (int64_t)cluster->GetElementPosition() ) )
-                    IndexAppendCluster( cluster );
+                IndexAppendCluster( cluster );
             }
             else if( MKV_IS_ID( el, KaxClusterSilentTracks ) )
             {
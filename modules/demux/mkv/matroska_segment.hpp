@@ -77,6 +77,9 @@ public:
     int                     i_index;
     int                     i_index_max;
     mkv_index_t             *p_indexes;
+    /* protects the index, also filled by the cluster indexer thread */
+    vlc_mutex_t             index_lock;
+    bool                    b_index_complete;
 
     /* info */
     char                    *psz_muxing_application;
@@ -113,7 +116,16 @@ public:
 
     static bool CompareSegmentUIDs( const matroska_segment_c * item_a, const matroska_segment_c * item_b );
 
+    int  IndexFind( int64_t i_position ) const;
+
 private:
+    /* background cluster indexer, for segments without cues */
+    vlc_thread_t            indexer;
+    bool                    b_indexer;
+    bool                    b_indexer_abort;
+    uint64_t                i_indexer_size;
+
+
     void LoadCues( KaxCues *cues );
     void LoadTags( KaxTags *tags );
     bool LoadSeekHeadItem( const EbmlCallbacks & ClassInfos, int64_t i_element_position );
@@ -127,6 +139,14 @@ private:
     void ParseCluster( bool b_update_start_time = true );
     void ParseSimpleTags( KaxTagSimple *tag );
     void IndexAppendCluster( KaxCluster *cluster );
+    void IndexInsert( int64_t i_position, mtime_t i_time );
+    std::string IndexCachePath() const;
+    bool IndexLoad( const std::string & path );
+    void IndexSave( const std::string & path );
+    void StartIndexer();
+    void StopIndexer();
+    void IndexerThread();
+    static void *IndexerThread( void * );
 };
 
 
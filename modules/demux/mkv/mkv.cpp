@@ -66,6 +66,16 @@ vlc_module_begin ()
             N_("Seek based on percent not time"),
             N_("Seek based on percent not time."), true );
 
+    add_bool( "mkv-index", true,
+            N_("Index clusters in the background"),
+            N_("Find the clusters of files without cues in the background, "
+               "so that seeking is faster and more accurate."), true );
+
+    add_bool( "mkv-index-cache", false,
+            N_("Cache the cluster index"),
+            N_("Save the cluster index of files without cues, "
+               "and reuse it the next time the file is played."), true );
+
     add_bool( "mkv-use-dummy", false,
             N_("Dummy Elements"),
             N_("Read and discard unknown EBML elements (not good for broken files)."), true );
@@ -440,29 +450,33 @@ static void Seek( demux_t *p_demux, mtime_t i_date, double f_percent, virtual_ch
         return;
     }
 
+    /* the background indexer may have found all the clusters */
+    vlc_mutex_lock( &p_segment->index_lock );
+    bool b_index = p_segment->b_cues || p_segment->b_index_complete;
+    vlc_mutex_unlock( &p_segment->index_lock );
+
     /* seek without index or without date */
-    if( f_percent >= 0 && (var_InheritBool( p_demux, "mkv-seek-percent" ) || !p_segment->b_cues || i_date < 0 ))
+    if( f_percent >= 0 && (var_InheritBool( p_demux, "mkv-seek-percent" ) || !b_index || i_date < 0 ))
     {
         i_date = int64_t( f_percent * p_sys->f_duration * 1000.0 );
-        if( !p_segment->b_cues )
+        if( !b_index )
         {
             int64_t i_pos = int64_t( f_percent * stream_Size( p_demux->s ) );
 
             msg_Dbg( p_demux, "lengthy way of seeking for pos:%"PRId64, i_pos );
-            for( i_index = 0; i_index < p_segment->i_index; i_index++ )
+            vlc_mutex_lock( &p_segment->index_lock );
+            for( i_index = p_segment->IndexFind( i_pos );
+                 i_index < p_segment->i_index; i_index++ )
             {
-                if( p_segment->p_indexes[i_index].i_position >= i_pos &&
-                    p_segment->p_indexes[i_index].i_time > 0 )
+                if( p_segment->p_indexes[i_index].i_time > 0 )
                     break;
             }
             if( i_index == p_segment->i_index )
-                i_index--;
-
-            if( p_segment->p_indexes[i_index].i_position < i_pos )
             {
                 msg_Dbg( p_demux, "no cues, seek request to global pos: %"PRId64, i_pos );
                 i_global_position = i_pos;
             }
+            vlc_mutex_unlock( &p_segment->index_lock );
         }
     }
     p_vsegment->Seek( *p_demux, i_date, i_time_offset, p_chapter, i_global_position );
@@ -597,6 +597,152 @@ static void MP4_FreeBox_trun( MP4_Box_t *p_box )
     FREENULL( p_box->data.p_trun->p_samples );
 }
 
+static int MP4_ReadBox_tfdt( stream_t *p_stream, MP4_Box_t *p_box )
+{
+    MP4_READBOX_ENTER( MP4_Box_data_tfdt_t );
+
+    MP4_GETVERSIONFLAGS( p_box->data.p_tfdt );
+    if( p_box->data.p_tfdt->i_version == 1 )
+        MP4_GET8BYTES( p_box->data.p_tfdt->i_base_media_decode_time );
+    else
+        MP4_GET4BYTES( p_box->data.p_tfdt->i_base_media_decode_time );
+
+#ifdef MP4_VERBOSE
+    msg_Dbg( p_stream, "read box: \"tfdt\" base media decode time %"PRIu64,
+             p_box->data.p_tfdt->i_base_media_decode_time );
+#endif
+
+    MP4_READBOX_EXIT( 1 );
+}
+
+static int MP4_ReadBox_sidx( stream_t *p_stream, MP4_Box_t *p_box )
+{
+    MP4_READBOX_ENTER( MP4_Box_data_sidx_t );
+    MP4_Box_data_sidx_t *p_sidx = p_box->data.p_sidx;
+
+    MP4_GETVERSIONFLAGS( p_sidx );
+    MP4_GET4BYTES( p_sidx->i_reference_ID );
+    MP4_GET4BYTES( p_sidx->i_timescale );
+    if( p_sidx->i_version == 0 )
+    {
+        MP4_GET4BYTES( p_sidx->i_earliest_presentation_time );
+        MP4_GET4BYTES( p_sidx->i_first_offset );
+    }
+    else
+    {
+        MP4_GET8BYTES( p_sidx->i_earliest_presentation_time );
+        MP4_GET8BYTES( p_sidx->i_first_offset );
+    }
+    p_peek += 2; i_read -= 2; /* reserved */
+    MP4_GET2BYTES( p_sidx->i_reference_count );
+
+    if( i_read < 12 * (int64_t)p_sidx->i_reference_count )
+        MP4_READBOX_EXIT( 0 );
+
+    p_sidx->p_items = calloc( p_sidx->i_reference_count,
+                              sizeof( MP4_descriptor_sidx_reference_t ) );
+    if( p_sidx->p_items == NULL )
+        MP4_READBOX_EXIT( 0 );
+
+    for( unsigned i = 0; i < p_sidx->i_reference_count; i++ )
+    {
+        MP4_descriptor_sidx_reference_t *p_item = &p_sidx->p_items[i];
+        uint32_t i_tmp;
+
+        MP4_GET4BYTES( i_tmp );
+        p_item->b_reference_type = i_tmp >> 31;
+        p_item->i_referenced_size = i_tmp & 0x7fffffff;
+        MP4_GET4BYTES( p_item->i_subsegment_duration );
+        MP4_GET4BYTES( i_tmp );
+        p_item->b_starts_with_SAP = i_tmp >> 31;
+        p_item->i_SAP_type = ( i_tmp >> 28 ) & 0x07;
+        p_item->i_SAP_delta_time = i_tmp & 0x0fffffff;
+    }
+
+#ifdef MP4_VERBOSE
+    msg_Dbg( p_stream, "read box: \"sidx\" timescale %"PRIu32" %"PRIu16
+             " references", p_sidx->i_timescale, p_sidx->i_reference_count );
+#endif
+
+    MP4_READBOX_EXIT( 1 );
+}
+
+static void MP4_FreeBox_sidx( MP4_Box_t *p_box )
+{
+    FREENULL( p_box->data.p_sidx->p_items );
+}
+
+static int MP4_ReadBox_tfra( stream_t *p_stream, MP4_Box_t *p_box )
+{
+    MP4_READBOX_ENTER( MP4_Box_data_tfra_t );
+    MP4_Box_data_tfra_t *p_tfra = p_box->data.p_tfra;
+    uint32_t i_lengths;
+
+    MP4_GETVERSIONFLAGS( p_tfra );
+    MP4_GET4BYTES( p_tfra->i_track_ID );
+    MP4_GET4BYTES( i_lengths );
+    MP4_GET4BYTES( p_tfra->i_number_of_entries );
+
+    /* traf, trun and sample numbers are coded on 1 to 4 bytes each */
+    const unsigned i_numbers = ( ( i_lengths >> 4 ) & 3 ) +
+                               ( ( i_lengths >> 2 ) & 3 ) +
+                               ( i_lengths & 3 ) + 3;
+    const unsigned i_entry = ( p_tfra->i_version == 1 ? 16 : 8 ) + i_numbers;
+
+    if( i_read < (int64_t)i_entry * p_tfra->i_number_of_entries )
+        MP4_READBOX_EXIT( 0 );
+
+    p_tfra->p_time = calloc( p_tfra->i_number_of_entries, sizeof( uint64_t ) );
+    p_tfra->p_moof_offset = calloc( p_tfra->i_number_of_entries,
+                                    sizeof( uint64_t ) );
+    if( p_tfra->p_time == NULL || p_tfra->p_moof_offset == NULL )
+        MP4_READBOX_EXIT( 0 );
+
+    for( uint32_t i = 0; i < p_tfra->i_number_of_entries; i++ )
+    {
+        if( p_tfra->i_version == 1 )
+        {
+            MP4_GET8BYTES( p_tfra->p_time[i] );
+            MP4_GET8BYTES( p_tfra->p_moof_offset[i] );
+        }
+        else
+        {
+            MP4_GET4BYTES( p_tfra->p_time[i] );
+            MP4_GET4BYTES( p_tfra->p_moof_offset[i] );
+        }
+        p_peek += i_numbers;
+        i_read -= i_numbers;
+    }
+
+#ifdef MP4_VERBOSE
+    msg_Dbg( p_stream, "read box: \"tfra\" track ID %"PRIu32" %"PRIu32
+             " entries", p_tfra->i_track_ID, p_tfra->i_number_of_entries );
+#endif
+
+    MP4_READBOX_EXIT( 1 );
+}
+
+static void MP4_FreeBox_tfra( MP4_Box_t *p_box )
+{
+    FREENULL( p_box->data.p_tfra->p_time );
+    FREENULL( p_box->data.p_tfra->p_moof_offset );
+}
+
+static int MP4_ReadBox_mfro( stream_t *p_stream, MP4_Box_t *p_box )
+{
+    MP4_READBOX_ENTER( MP4_Box_data_mfro_t );
+
+    MP4_GETVERSIONFLAGS( p_box->data.p_mfro );
+    MP4_GET4BYTES( p_box->data.p_mfro->i_size );
+
+#ifdef MP4_VERBOSE
+    msg_Dbg( p_stream, "read box: \"mfro\" size %"PRIu32,
+             p_box->data.p_mfro->i_size );
+#endif
+
+    MP4_READBOX_EXIT( 1 );
+}
+
 
 
 static int MP4_ReadBox_tkhd(  stream_t *p_stream, MP4_Box_t *p_box )
@@ -3097,6 +3243,11 @@ static const struct
     { ATOM_mfhd,    MP4_ReadBox_mfhd,         MP4_FreeBox_Common },
     { ATOM_tfhd,    MP4_ReadBox_tfhd,         MP4_FreeBox_Common },
     { ATOM_trun,    MP4_ReadBox_trun,         MP4_FreeBox_trun },
+    { ATOM_tfdt,    MP4_ReadBox_tfdt,         MP4_FreeBox_Common },
+    { ATOM_sidx,    MP4_ReadBox_sidx,         MP4_FreeBox_sidx },
+    { ATOM_mfra,    MP4_ReadBoxContainer,     MP4_FreeBox_Common },
+    { ATOM_tfra,    MP4_ReadBox_tfra,         MP4_FreeBox_tfra },
+    { ATOM_mfro,    MP4_ReadBox_mfro,         MP4_FreeBox_Common },
     { ATOM_trex,    MP4_ReadBox_trex,         MP4_FreeBox_Common },
     { ATOM_mehd,    MP4_ReadBox_mehd,         MP4_FreeBox_Common },
     { ATOM_sdtp,    MP4_ReadBox_sdtp,         MP4_FreeBox_sdtp },
@@ -3151,6 +3302,32 @@ static MP4_Box_t *MP4_ReadBox( stream_t *p_stream, MP4_Box_t *p_father )
     return p_box;
 }
 
+/*****************************************************************************
+ * MP4_BoxReadNext : parse the box at the current position, and skip to its end
+ *****************************************************************************/
+MP4_Box_t *MP4_BoxReadNext( stream_t *s, MP4_Box_t *p_father )
+{
+    MP4_Box_t *p_box = MP4_ReadBox( s, p_father );
+
+    if( p_box == NULL )
+        return NULL;
+
+    if( stream_Tell( s ) != (int64_t)( p_box->i_pos + p_box->i_size ) &&
+        stream_Seek( s, p_box->i_pos + p_box->i_size ) )
+    {
+        MP4_BoxFree( s, p_box );
+        return NULL;
+    }
+
+    if( p_father )
+    {
+        if( !p_father->p_first ) p_father->p_first = p_box;
+        else p_father->p_last->p_next = p_box;
+        p_father->p_last = p_box;
+    }
+    return p_box;
+}
+
 /*****************************************************************************
  * MP4_FreeBox : free memory after read with MP4_ReadBox and all
  * the children
@@ -80,6 +80,12 @@
 #define ATOM_traf VLC_FOURCC( 't', 'r', 'a', 'f' )
 #define ATOM_tfhd VLC_FOURCC( 't', 'f', 'h', 'd' )
 #define ATOM_trun VLC_FOURCC( 't', 'r', 'u', 'n' )
+#define ATOM_tfdt VLC_FOURCC( 't', 'f', 'd', 't' )
+#define ATOM_styp VLC_FOURCC( 's', 't', 'y', 'p' )
+#define ATOM_sidx VLC_FOURCC( 's', 'i', 'd', 'x' )
+#define ATOM_mfra VLC_FOURCC( 'm', 'f', 'r', 'a' )
+#define ATOM_tfra VLC_FOURCC( 't', 'f', 'r', 'a' )
+#define ATOM_mfro VLC_FOURCC( 'm', 'f', 'r', 'o' )
 #define ATOM_cprt VLC_FOURCC( 'c', 'p', 'r', 't' )
 #define ATOM_iods VLC_FOURCC( 'i', 'o', 'd', 's' )
 #define ATOM_pasp VLC_FOURCC( 'p', 'a', 's', 'p' )
@@ -841,6 +847,8 @@ typedef struct MP4_Box_data_mfhd_s
 #define MP4_TFHD_DFLT_SAMPLE_DURATION (1LL<<3)
 #define MP4_TFHD_DFLT_SAMPLE_SIZE     (1LL<<4)
 #define MP4_TFHD_DFLT_SAMPLE_FLAGS    (1LL<<5)
+#define MP4_TFHD_DURATION_IS_EMPTY    (1LL<<16)
+#define MP4_TFHD_DEFAULT_BASE_IS_MOOF (1LL<<17)
 typedef struct MP4_Box_data_tfhd_s
 {
     uint8_t  i_version;
@@ -884,6 +892,62 @@ typedef struct MP4_Box_data_trun_s
 
 } MP4_Box_data_trun_t;
 
+typedef struct MP4_Box_data_tfdt_s
+{
+    uint8_t  i_version;
+    uint32_t i_flags;
+
+    uint64_t i_base_media_decode_time;
+
+} MP4_Box_data_tfdt_t;
+
+typedef struct
+{
+    uint8_t  b_reference_type;  /* 1 if it points to another sidx */
+    uint32_t i_referenced_size;
+    uint32_t i_subsegment_duration;
+    uint8_t  b_starts_with_SAP;
+    uint8_t  i_SAP_type;
+    uint32_t i_SAP_delta_time;
+} MP4_descriptor_sidx_reference_t;
+
+typedef struct MP4_Box_data_sidx_s
+{
+    uint8_t  i_version;
+    uint32_t i_flags;
+
+    uint32_t i_reference_ID;
+    uint32_t i_timescale;
+    uint64_t i_earliest_presentation_time;
+    uint64_t i_first_offset;
+    uint16_t i_reference_count;
+
+    MP4_descriptor_sidx_reference_t *p_items;
+
+} MP4_Box_data_sidx_t;
+
+typedef struct MP4_Box_data_tfra_s
+{
+    uint8_t  i_version;
+    uint32_t i_flags;
+
+    uint32_t i_track_ID;
+    uint32_t i_number_of_entries;
+
+    uint64_t *p_time;        /* in the track timescale */
+    uint64_t *p_moof_offset; /* absolute position of the moof */
+
+} MP4_Box_data_tfra_t;
+
+typedef struct MP4_Box_data_mfro_s
+{
+    uint8_t  i_version;
+    uint32_t i_flags;
+
+    uint32_t i_size;        /* of the enclosing mfra */
+
+} MP4_Box_data_mfro_t;
+
 
 typedef struct
 {
@@ -1046,6 +1110,10 @@ typedef union MP4_Box_data_s
     MP4_Box_data_mfhd_t *p_mfhd;
     MP4_Box_data_tfhd_t *p_tfhd;
     MP4_Box_data_trun_t *p_trun;
+    MP4_Box_data_tfdt_t *p_tfdt;
+    MP4_Box_data_sidx_t *p_sidx;
+    MP4_Box_data_tfra_t *p_tfra;
+    MP4_Box_data_mfro_t *p_mfro;
     MP4_Box_data_tkhd_t *p_tkhd;
     MP4_Box_data_mdhd_t *p_mdhd;
     MP4_Box_data_hdlr_t *p_hdlr;
@@ -1145,6 +1213,15 @@ typedef struct MP4_Box_s
  *****************************************************************************/
 MP4_Box_t *MP4_BoxGetRoot( stream_t * );
 
+/*****************************************************************************
+ * MP4_BoxReadNext : Parse the box at the current position and its children
+ *****************************************************************************
+ *  The box is appended to p_father children if p_father is not NULL, and
+ *  the stream is left at the end of the box. Used to load fragmented files
+ *  one top level box at a time.
+ *****************************************************************************/
+MP4_Box_t *MP4_BoxReadNext( stream_t *, MP4_Box_t *p_father );
+
 /*****************************************************************************
  * MP4_FreeBox : free memory allocated after read with MP4_ReadBox
  *               or MP4_BoxGetRoot, this means also children boxes
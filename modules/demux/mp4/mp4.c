@@ -59,6 +59,7 @@ vlc_module_end ()
  * Local prototypes
  *****************************************************************************/
 static int   Demux   ( demux_t * );
+static int   DemuxFrag( demux_t * );
 static int   DemuxRef( demux_t *p_demux ){ (void)p_demux; return 0;}
 static int   Seek    ( demux_t *, mtime_t );
 static int   Control ( demux_t *, int, va_list );
@@ -74,20 +75,27 @@ typedef struct
     /* now provide way to calculate pts, dts, and offset without too
         much memory and with fast access */
 
-    /* with this we can calculate dts/pts without waste memory */
+    /* with this we can calculate dts/pts without waste memory: the stts
+       and ctts tables are kept in their run-length form, and each chunk
+       only remembers where its first sample falls in them */
     uint64_t     i_first_dts;   /* DTS of the first sample */
     uint64_t     i_last_dts;    /* DTS of the last sample */
-    uint32_t     *p_sample_count_dts;
-    uint32_t     *p_sample_delta_dts;   /* dts delta */
-
-    uint32_t     *p_sample_count_pts;
-    int32_t      *p_sample_offset_pts;  /* pts-dts */
-
-    /* TODO if needed add pts
-        but quickly *add* support for edts and seeking */
+    uint32_t     i_dts_index;   /* stts entry of the first sample */
+    uint32_t     i_dts_used;    /* samples of this entry in previous chunks */
+    uint32_t     i_pts_index;   /* same for ctts */
+    uint32_t     i_pts_used;
 
 } mp4_chunk_t;
 
+/* Position of a sample in a run-length (stts or ctts) table */
+typedef struct
+{
+    uint32_t     i_sample;      /* sample number */
+    uint32_t     i_index;       /* table entry of this sample */
+    uint32_t     i_used;        /* samples of this entry before it */
+    uint64_t     i_dts;         /* DTS of the sample (stts only) */
+} mp4_cursor_t;
+
  /* Contain all needed information for read all track with vlc */
 typedef struct
 {
@@ -125,10 +133,18 @@ typedef struct
 
     mp4_chunk_t    *chunk; /* always defined  for each chunk */
 
+    /* timing tables, owned by the stbl boxes (p_ctts may be NULL), and
+       the last sample looked up in each of them */
+    const MP4_Box_data_stts_t *p_stts;
+    const MP4_Box_data_ctts_t *p_ctts;
+    mp4_cursor_t     dts_cursor;
+    mp4_cursor_t     pts_cursor;
+
     /* sample size, p_sample_size defined only if i_sample_size == 0
-        else i_sample_size is size for all sample */
+        else i_sample_size is size for all sample. p_sample_size is the
+        stsz table itself */
     uint32_t         i_sample_size;
-    uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
+    const uint32_t   *p_sample_size; /* XXX perhaps add file offset if take
                                     too much time to do sumations each time*/
 
     MP4_Box_t *p_stbl;  /* will contain all timing information */
@@ -139,8 +155,46 @@ typedef struct
     void      *p_drms;
     MP4_Box_t *p_skcr;
 
+    /* fragmented file */
+    MP4_Box_t *p_trex;        /* fragment defaults (could be NULL) */
+    uint64_t  i_frag_dts;     /* dts following the last read fragment */
+
 } mp4_track_t;
 
+/* A sample of the current movie fragment */
+typedef struct
+{
+    uint64_t     i_offset;      /* absolute position in the file */
+    uint32_t     i_size;
+    unsigned     i_track;
+    mtime_t      i_dts;
+    mtime_t      i_pts;
+    mtime_t      i_pcr;         /* lowest dts from this sample on */
+} mp4_frag_sample_t;
+
+/* A random access point in a fragmented file */
+typedef struct
+{
+    mtime_t      i_time;
+    uint64_t     i_offset;
+} mp4_frag_point_t;
+
+typedef struct
+{
+    /* samples of the current fragment, in file order. Only one fragment
+     * is kept in memory, whatever the length of the file */
+    mp4_frag_sample_t *p_samples;
+    unsigned     i_count;
+    unsigned     i_alloc;
+    unsigned     i_current;
+    uint64_t     i_next;        /* position of the box after the fragment */
+
+    /* seek index, from mfra or sidx, else from the fragments read so far */
+    mp4_frag_point_t *p_points;
+    unsigned     i_points;
+    bool         b_indexed;
+} mp4_frag_t;
+
 
 struct demux_sys_t
 {
@@ -161,6 +215,11 @@ struct demux_sys_t
 
     /* */
     input_title_t *p_title;
+
+    /* fragmented file (moov/mvex), read one moof at a time */
+    bool         b_fragmented;
+    bool         b_seekable;
+    mp4_frag_t   frag;
 };
 
 /*****************************************************************************
@@ -182,32 +241,73 @@ static void     MP4_TrackSetELST( demux_t *, mp4_track_t *, int64_t );
 static void     MP4_UpdateSeekpoint( demux_t * );
 static const char *MP4_ConvertMacCode( uint16_t );
 
-/* Return time in s of a track */
-static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
-{
-#define chunk p_track->chunk[p_track->i_chunk]
-
-    unsigned int i_index = 0;
-    unsigned int i_sample = p_track->i_sample - chunk.i_sample_first;
-    int64_t i_dts = chunk.i_first_dts;
+static bool FragProbe( demux_t * );
+static int  FragLoadInit( demux_t * );
+static bool FragHasSamples( MP4_Box_t * );
+static void FragLoadIndex( demux_t * );
+static int  FragSeek( demux_t *, mtime_t );
 
-    while( i_sample > 0 )
+/* Moves a cursor forward to the given sample of a stts table */
+static void MP4_CursorStts( const MP4_Box_data_stts_t *stts,
+                            mp4_cursor_t *p_cur, uint32_t i_sample )
+{
+    while( p_cur->i_sample < i_sample && p_cur->i_index < stts->i_entry_count )
     {
-        if( i_sample > chunk.p_sample_count_dts[i_index] )
+        const uint32_t i_count = stts->i_sample_count[p_cur->i_index];
+        const uint32_t i_step = __MIN( i_count - p_cur->i_used,
+                                       i_sample - p_cur->i_sample );
+
+        p_cur->i_dts += (uint64_t)i_step *
+                        (uint32_t)stts->i_sample_delta[p_cur->i_index];
+        p_cur->i_sample += i_step;
+        p_cur->i_used += i_step;
+        if( p_cur->i_used >= i_count )
         {
-            i_dts += chunk.p_sample_count_dts[i_index] *
-                chunk.p_sample_delta_dts[i_index];
-            i_sample -= chunk.p_sample_count_dts[i_index];
-            i_index++;
+            p_cur->i_index++;
+            p_cur->i_used = 0;
         }
-        else
+    }
+}
+
+/* Same for a ctts table */
+static void MP4_CursorCtts( const MP4_Box_data_ctts_t *ctts,
+                            mp4_cursor_t *p_cur, uint32_t i_sample )
+{
+    while( p_cur->i_sample < i_sample && p_cur->i_index < ctts->i_entry_count )
+    {
+        const uint32_t i_count = ctts->i_sample_count[p_cur->i_index];
+        const uint32_t i_step = __MIN( i_count - p_cur->i_used,
+                                       i_sample - p_cur->i_sample );
+
+        p_cur->i_sample += i_step;
+        p_cur->i_used += i_step;
+        if( p_cur->i_used >= i_count )
         {
-            i_dts += i_sample * chunk.p_sample_delta_dts[i_index];
-            break;
+            p_cur->i_index++;
+            p_cur->i_used = 0;
         }
     }
+}
+
+/* Return time in s of a track */
+static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
+{
+    const mp4_chunk_t *ck = &p_track->chunk[p_track->i_chunk];
+    mp4_cursor_t *p_cur = &p_track->dts_cursor;
+
+    /* Samples are mostly read in order: only restart from the chunk when
+     * going backward or jumping over chunks */
+    if( p_cur->i_sample > p_track->i_sample ||
+        p_cur->i_sample < ck->i_sample_first )
+    {
+        p_cur->i_sample = ck->i_sample_first;
+        p_cur->i_index  = ck->i_dts_index;
+        p_cur->i_used   = ck->i_dts_used;
+        p_cur->i_dts    = ck->i_first_dts;
+    }
+    MP4_CursorStts( p_track->p_stts, p_cur, p_track->i_sample );
 
-#undef chunk
+    int64_t i_dts = p_cur->i_dts;
 
     /* now handle elst */
     if( p_track->p_elst )
@@ -235,21 +335,26 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
 
 static inline int64_t MP4_TrackGetPTSDelta( mp4_track_t *p_track )
 {
-    mp4_chunk_t *ck = &p_track->chunk[p_track->i_chunk];
-    unsigned int i_index = 0;
-    unsigned int i_sample = p_track->i_sample - ck->i_sample_first;
+    const MP4_Box_data_ctts_t *ctts = p_track->p_ctts;
+    const mp4_chunk_t *ck = &p_track->chunk[p_track->i_chunk];
+    mp4_cursor_t *p_cur = &p_track->pts_cursor;
 
-    if( ck->p_sample_count_pts == NULL || ck->p_sample_offset_pts == NULL )
+    if( ctts == NULL )
         return -1;
 
-    for( i_index = 0;; i_index++ )
+    if( p_cur->i_sample > p_track->i_sample ||
+        p_cur->i_sample < ck->i_sample_first )
     {
-        if( i_sample < ck->p_sample_count_pts[i_index] )
-            return ck->p_sample_offset_pts[i_index] * INT64_C(1000000) /
-                   (int64_t)p_track->i_timescale;
-
-        i_sample -= ck->p_sample_count_pts[i_index];
+        p_cur->i_sample = ck->i_sample_first;
+        p_cur->i_index  = ck->i_pts_index;
+        p_cur->i_used   = ck->i_pts_used;
     }
+    MP4_CursorCtts( ctts, p_cur, p_track->i_sample );
+
+    if( p_cur->i_index >= ctts->i_entry_count )
+        return -1;
+    return ctts->i_sample_offset[p_cur->i_index] * INT64_C(1000000) /
+           (int64_t)p_track->i_timescale;
 }
 
 static inline int64_t MP4_GetMoviePTS(demux_sys_t *p_sys )
@@ -276,6 +381,7 @@ static int Open( vlc_object_t * p_this )
 
     unsigned int    i;
     bool      b_seekable;
+    bool      b_fragmented;
     bool      b_enabled_es;
 
     /* A little test to see if it could be a mp4 */
@@ -302,23 +408,56 @@ static int Open( vlc_object_t * p_this )
             return VLC_EGENERIC;
     }
 
-    /* I need to seek */
+    /* I need to seek, unless the file is fragmented */
+    const int64_t i_start = stream_Tell( p_demux->s );
     stream_Control( p_demux->s, STREAM_CAN_FASTSEEK, &b_seekable );
-    if( !b_seekable )
+    b_fragmented = FragProbe( p_demux );
+    if( !b_seekable && !b_fragmented )
     {
         msg_Warn( p_demux, "MP4 plugin discarded (not fastseekable)" );
         return VLC_EGENERIC;
     }
 
     /*Set exported functions */
-    p_demux->pf_demux = Demux;
+    p_demux->pf_demux = b_fragmented ? DemuxFrag : Demux;
     p_demux->pf_control = Control;
 
     /* create our structure that will contains all data */
     p_demux->p_sys = p_sys = calloc( 1, sizeof( demux_sys_t ) );
+    if( p_sys == NULL )
+        return VLC_ENOMEM;
+    stream_Control( p_demux->s, STREAM_CAN_SEEK, &p_sys->b_seekable );
 
-    /* Now load all boxes ( except raw data ) */
-    if( ( p_sys->p_root = MP4_BoxGetRoot( p_demux->s ) ) == NULL )
+    /* Now load all boxes ( except raw data ), or only the header boxes
+     * of a fragmented file, the fragments are loaded while playing */
+    if( b_fragmented )
+    {
+        p_sys->b_fragmented = true;
+        if( FragLoadInit( p_demux ) )
+        {
+            msg_Warn( p_demux, "MP4 plugin discarded (not a valid file)" );
+            goto error;
+        }
+        if( FragHasSamples( p_sys->p_root ) )
+        {
+            /* Samples are also in the moov, use the regular sample tables.
+             * A non-seekable stream may still go back within its buffer,
+             * otherwise only the fragments can be played. */
+            if( stream_Seek( p_demux->s, i_start ) == VLC_SUCCESS )
+            {
+                p_sys->b_fragmented = false;
+                MP4_BoxFree( p_demux->s, p_sys->p_root );
+                p_sys->p_root = NULL;
+                p_demux->pf_demux = Demux;
+            }
+            else if( b_seekable )
+                goto error;
+            else
+                msg_Warn( p_demux, "cannot go back to the moov samples" );
+        }
+    }
+    if( !p_sys->b_fragmented &&
+        ( p_sys->p_root = MP4_BoxGetRoot( p_demux->s ) ) == NULL )
     {
         msg_Warn( p_demux, "MP4 plugin discarded (not a valid file)" );
         goto error;
@@ -484,6 +623,12 @@ static int Open( vlc_object_t * p_this )
             goto error;
         }
         p_sys->i_duration = p_mvhd->data.p_mvhd->i_duration;
+        if( p_sys->b_fragmented && !p_sys->i_duration )
+        {
+            MP4_Box_t *p_mehd = MP4_BoxGet( p_sys->p_root, "/moov/mvex/mehd" );
+            if( p_mehd )
+                p_sys->i_duration = p_mehd->data.p_mehd->i_fragment_duration;
+        }
     }
 
     if( !( p_sys->i_tracks = MP4_BoxCount( p_sys->p_root, "/moov/trak" ) ) )
@@ -568,6 +713,9 @@ static int Open( vlc_object_t * p_this )
     /* */
     LoadChapter( p_demux );
 
+    if( p_sys->b_fragmented )
+        FragLoadIndex( p_demux );
+
     return VLC_SUCCESS;
 
 error:
@@ -792,6 +940,9 @@ static int Seek( demux_t *p_demux, mtime_t i_date )
     demux_sys_t *p_sys = p_demux->p_sys;
     unsigned int i_track;
 
+    if( p_sys->b_fragmented )
+        return FragSeek( p_demux, i_date );
+
     /* First update update global time */
     p_sys->i_time = i_date * p_sys->i_timescale / 1000000;
     p_sys->i_pcr  = i_date;
@@ -827,6 +978,11 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             {
                 *pf = (double)p_sys->i_time / (double)p_sys->i_duration;
             }
+            else if( p_sys->b_fragmented && stream_Size( p_demux->s ) > 0 )
+            {
+                i64 = stream_Tell( p_demux->s );
+                *pf = (double)i64 / stream_Size( p_demux->s );
+            }
             else
             {
                 *pf = 0.0;
@@ -1074,6 +1230,8 @@ static void Close ( vlc_object_t * p_this )
     if( p_sys->p_title )
         vlc_input_title_Delete( p_sys->p_title );
 
+    free( p_sys->frag.p_samples );
+    free( p_sys->frag.p_points );
     free( p_sys );
 }
 
@@ -1212,10 +1370,6 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
         ck->i_offset = p_co64->data.p_co64->i_chunk_offset[i_chunk];
 
         ck->i_first_dts = 0;
-        ck->p_sample_count_dts = NULL;
-        ck->p_sample_delta_dts = NULL;
-        ck->p_sample_count_pts = NULL;
-        ck->p_sample_offset_pts = NULL;
     }
 
     /* now we read index for SampleEntry( soun vide mp4a mp4v ...)
@@ -1270,13 +1424,8 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     MP4_Box_data_stts_t *stts;
     /* TODO use also stss and stsh table for seeking */
     /* FIXME use edit table */
-    int64_t i_sample;
-    int64_t i_chunk;
-
-    int64_t i_index;
-    int64_t i_index_sample_used;
-
-    int64_t i_next_dts;
+    uint32_t i_chunk;
+    uint64_t i_next_dts;
 
     /* Find stsz
      *  Gives the sample size for each samples. There is also a stz2 table
@@ -1301,11 +1450,11 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     }
     stts = p_box->data.p_stts;
 
-    /* Use stsz table to create a sample number -> sample size table */
+    /* The stsz table gives the sample number -> sample size mapping */
     p_demux_track->i_sample_count = stsz->i_sample_count;
     if( stsz->i_sample_size )
     {
-        /* 1: all sample have the same size, so no need to construct a table */
+        /* 1: all sample have the same size, so no need of a table */
         p_demux_track->i_sample_size = stsz->i_sample_size;
         p_demux_track->p_sample_size = NULL;
     }
@@ -1313,84 +1462,35 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     {
         /* 2: each sample can have a different size */
         p_demux_track->i_sample_size = 0;
-        p_demux_track->p_sample_size =
-            calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
-        if( p_demux_track->p_sample_size == NULL )
-            return VLC_ENOMEM;
-
-        for( i_sample = 0; i_sample < p_demux_track->i_sample_count; i_sample++ )
-        {
-            p_demux_track->p_sample_size[i_sample] =
-                    stsz->i_entry_size[i_sample];
-        }
+        p_demux_track->p_sample_size = stsz->i_entry_size;
     }
 
-    /* Use stts table to create a sample number -> dts table.
-     * XXX: if we don't want to waste too much memory, we can't expand
-     *  the box! so each chunk will contain an "extract" of this table
-     *  for fast research (problem with raw stream where a sample is sometime
-     *  just channels*bits_per_sample/8 */
+    /* The stts table gives the sample number -> dts mapping.
+     * XXX: it is not expanded, as it would waste too much memory with
+     *  long files (and raw streams where a sample is sometime just
+     *  channels*bits_per_sample/8). Each chunk only saves its position
+     *  in the table, which is then walked on demand. */
+    mp4_cursor_t cur = { 0, 0, 0, 0 };
 
-    i_next_dts = 0;
-    i_index = 0; i_index_sample_used = 0;
+    p_demux_track->p_stts = stts;
     for( i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
     {
         mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-        int64_t i_entry, i_sample_count, i;
-
-        /* save first dts */
-        ck->i_first_dts = i_next_dts;
-        ck->i_last_dts  = i_next_dts;
 
-        /* count how many entries are needed for this chunk
-         * for p_sample_delta_dts and p_sample_count_dts */
-        i_sample_count = ck->i_sample_count;
-
-        i_entry = 0;
-        while( i_sample_count > 0 )
+        ck->i_dts_index = cur.i_index;
+        ck->i_dts_used  = cur.i_used;
+        ck->i_first_dts = cur.i_dts;
+        ck->i_last_dts  = cur.i_dts;
+        if( ck->i_sample_count > 0 )
         {
-            i_sample_count -= stts->i_sample_count[i_index+i_entry];
-            /* don't count already used sample in this entry */
-            if( i_entry == 0 )
-                i_sample_count += i_index_sample_used;
-
-            i_entry++;
-        }
-
-        /* allocate them */
-        ck->p_sample_count_dts = calloc( i_entry, sizeof( uint32_t ) );
-        ck->p_sample_delta_dts = calloc( i_entry, sizeof( uint32_t ) );
-
-        if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
-            return VLC_ENOMEM;
-
-        /* now copy */
-        i_sample_count = ck->i_sample_count;
-        for( i = 0; i < i_entry; i++ )
-        {
-            int64_t i_used;
-            int64_t i_rest;
-
-            i_rest = stts->i_sample_count[i_index] - i_index_sample_used;
-
-            i_used = __MIN( i_rest, i_sample_count );
-
-            i_index_sample_used += i_used;
-            i_sample_count -= i_used;
-            i_next_dts += i_used * stts->i_sample_delta[i_index];
-
-            ck->p_sample_count_dts[i] = i_used;
-            ck->p_sample_delta_dts[i] = stts->i_sample_delta[i_index];
-            if( i_used > 0 )
-                ck->i_last_dts = i_next_dts - ck->p_sample_delta_dts[i];
-
-            if( i_index_sample_used >= stts->i_sample_count[i_index] )
-            {
-                i_index++;
-                i_index_sample_used = 0;
-            }
+            MP4_CursorStts( stts, &cur, ck->i_sample_first +
+                                        ck->i_sample_count - 1 );
+            ck->i_last_dts = cur.i_dts;
+            MP4_CursorStts( stts, &cur, ck->i_sample_first +
+                                        ck->i_sample_count );
         }
     }
+    i_next_dts = cur.i_dts;
 
     /* Find ctts
      *  Gives the delta between decoding time (dts) and composition table (pts)
@@ -1398,67 +1498,25 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     p_box = MP4_BoxGet( p_demux_track->p_stbl, "ctts" );
     if( p_box )
     {
-        MP4_Box_data_ctts_t *ctts = p_box->data.p_ctts;
+        const MP4_Box_data_ctts_t *ctts = p_box->data.p_ctts;
 
         msg_Warn( p_demux, "CTTS table" );
 
-        /* Create pts-dts table per chunk */
-        i_index = 0; i_index_sample_used = 0;
+        /* Save the position of each chunk in the pts-dts table */
+        memset( &cur, 0, sizeof( cur ) );
         for( i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            int64_t i_entry, i_sample_count, i;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_delta_dts and p_sample_count_dts */
-            i_sample_count = ck->i_sample_count;
-
-            i_entry = 0;
-            while( i_sample_count > 0 )
-            {
-                i_sample_count -= ctts->i_sample_count[i_index+i_entry];
-
-                /* don't count already used sample in this entry */
-                if( i_entry == 0 )
-                    i_sample_count += i_index_sample_used;
-
-                i_entry++;
-            }
-
-            /* allocate them */
-            ck->p_sample_count_pts = calloc( i_entry, sizeof( uint32_t ) );
-            ck->p_sample_offset_pts = calloc( i_entry, sizeof( int32_t ) );
-            if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
-                return VLC_ENOMEM;
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-            for( i = 0; i < i_entry; i++ )
-            {
-                int64_t i_used;
-                int64_t i_rest;
-
-                i_rest = ctts->i_sample_count[i_index] -
-                    i_index_sample_used;
-
-                i_used = __MIN( i_rest, i_sample_count );
-
-                i_index_sample_used += i_used;
-                i_sample_count -= i_used;
-
-                ck->p_sample_count_pts[i] = i_used;
-                ck->p_sample_offset_pts[i] = ctts->i_sample_offset[i_index];
-
-                if( i_index_sample_used >= ctts->i_sample_count[i_index] )
-                {
-                    i_index++;
-                    i_index_sample_used = 0;
-                }
-            }
+            ck->i_pts_index = cur.i_index;
+            ck->i_pts_used  = cur.i_used;
+            MP4_CursorCtts( ctts, &cur, ck->i_sample_first +
+                                        ck->i_sample_count );
         }
+        p_demux_track->p_ctts = ctts;
     }
 
-    msg_Dbg( p_demux, "track[Id 0x%x] read %d samples length:%"PRId64"s",
+    msg_Dbg( p_demux, "track[Id 0x%x] read %d samples length:%"PRIu64"s",
              p_demux_track->i_track_ID, p_demux_track->i_sample_count,
              i_next_dts / p_demux_track->i_timescale );
 
@@ -1507,6 +1565,40 @@ static void TrackGetESSampleRate( unsigned *pi_num, unsigned *pi_den,
                      UINT16_MAX);
 }
 
+/* A single chunk gives the sample description of a fragmented track */
+static int TrackCreateFragmented( demux_t *p_demux, mp4_track_t *p_track )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    MP4_Box_t *p_mvex = MP4_BoxGet( p_sys->p_root, "/moov/mvex" );
+    uint32_t i_sample_description_index = 1;
+
+    p_track->p_trex = NULL;
+    for( MP4_Box_t *p_trex = p_mvex ? p_mvex->p_first : NULL;
+         p_trex != NULL; p_trex = p_trex->p_next )
+    {
+        if( p_trex->i_type == ATOM_trex && p_trex->data.p_trex &&
+            p_trex->data.p_trex->i_track_ID == p_track->i_track_ID )
+        {
+            p_track->p_trex = p_trex;
+            if( p_trex->data.p_trex->i_default_sample_description_index )
+                i_sample_description_index =
+                    p_trex->data.p_trex->i_default_sample_description_index;
+            break;
+        }
+    }
+
+    p_track->chunk = calloc( 1, sizeof( mp4_chunk_t ) );
+    if( p_track->chunk == NULL )
+        return VLC_ENOMEM;
+    p_track->chunk[0].i_sample_description_index = i_sample_description_index;
+    p_track->i_chunk_count = 1;
+    p_track->i_sample_count = 0;
+    p_track->i_frag_dts = 0;
+
+    msg_Dbg( p_demux, "track[Id 0x%x] is fragmented", p_track->i_track_ID );
+    return VLC_SUCCESS;
+}
+
 /*
  * TrackCreateES:
  * Create ES and PES to init decoder if needed, for a track starting at i_chunk
@@ -2107,7 +2199,6 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
     uint64_t     i_dts;
     unsigned int i_sample;
     unsigned int i_chunk;
-    int          i_index;
 
     /* FIXME see if it's needed to check p_track->i_chunk_count */
     if( p_track->i_chunk_count == 0 )
@@ -2151,49 +2242,42 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         i_start = i_start * p_track->i_timescale / (int64_t)1000000;
     }
 
-    /* we start from sample 0/chunk 0, hope it won't take too much time */
     /* *** find good chunk *** */
-    for( i_chunk = 0; ; i_chunk++ )
+    /* chunks are sorted by dts: the last one starting before i_start */
+    unsigned int i_low = 0, i_high = p_track->i_chunk_count;
+    while( i_high - i_low > 1 )
     {
-        if( i_chunk + 1 >= p_track->i_chunk_count )
-        {
-            /* at the end and can't check if i_start in this chunk,
-               it will be check while searching i_sample */
-            i_chunk = p_track->i_chunk_count - 1;
-            break;
-        }
+        unsigned int i_mid = ( i_low + i_high ) / 2;
 
-        if( (uint64_t)i_start >= p_track->chunk[i_chunk].i_first_dts &&
-            (uint64_t)i_start <  p_track->chunk[i_chunk + 1].i_first_dts )
-        {
-            break;
-        }
+        if( (uint64_t)i_start < p_track->chunk[i_mid].i_first_dts )
+            i_high = i_mid;
+        else
+            i_low = i_mid;
     }
+    i_chunk = i_low;
 
     /* *** find sample in the chunk *** */
-    i_sample = p_track->chunk[i_chunk].i_sample_first;
-    i_dts    = p_track->chunk[i_chunk].i_first_dts;
-    for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count; )
+    const MP4_Box_data_stts_t *stts = p_track->p_stts;
+    const mp4_chunk_t *ck = &p_track->chunk[i_chunk];
+    uint32_t i_used = ck->i_dts_used;
+
+    i_sample = ck->i_sample_first;
+    i_dts    = ck->i_first_dts;
+    for( uint32_t i_index = ck->i_dts_index;
+         i_index < stts->i_entry_count; i_index++, i_used = 0 )
     {
-        if( i_dts +
-            p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-            p_track->chunk[i_chunk].p_sample_delta_dts[i_index] < (uint64_t)i_start )
-        {
-            i_dts    +=
-                p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
+        const uint32_t i_count = stts->i_sample_count[i_index] - i_used;
+        const uint32_t i_delta = stts->i_sample_delta[i_index];
 
-            i_sample += p_track->chunk[i_chunk].p_sample_count_dts[i_index];
-            i_index++;
+        if( i_dts + (uint64_t)i_count * i_delta < (uint64_t)i_start )
+        {
+            i_dts    += (uint64_t)i_count * i_delta;
+            i_sample += i_count;
         }
         else
         {
-            if( p_track->chunk[i_chunk].p_sample_delta_dts[i_index] <= 0 )
-            {
-                break;
-            }
-            i_sample += ( i_start - i_dts ) /
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
+            if( i_delta > 0 )
+                i_sample += ( i_start - i_dts ) / i_delta;
             break;
         }
     }
@@ -2484,9 +2568,15 @@ static void MP4_TrackCreate( demux_t *p_demux, mp4_track_t *p_track,
         }
     }
 
-    /* Create chunk index table and sample index table */
-    if( TrackCreateChunksIndex( p_demux,p_track  ) ||
-        TrackCreateSamplesIndex( p_demux, p_track ) )
+    /* Create chunk index table and sample index table, the samples of
+     * a fragmented file are described by each fragment */
+    if( p_sys->b_fragmented )
+    {
+        if( TrackCreateFragmented( p_demux, p_track ) )
+            return;
+    }
+    else if( TrackCreateChunksIndex( p_demux,p_track  ) ||
+             TrackCreateSamplesIndex( p_demux, p_track ) )
     {
         return; /* cannot create chunks index */
     }
@@ -2552,31 +2642,17 @@ static void MP4_TrackCreate( demux_t *p_demux, mp4_track_t *p_track,
  ****************************************************************************/
 static void MP4_TrackDestroy( mp4_track_t *p_track )
 {
-    unsigned int i_chunk;
-
     p_track->b_ok = false;
     p_track->b_enable   = false;
     p_track->b_selected = false;
 
     es_format_Clean( &p_track->fmt );
 
-    for( i_chunk = 0; i_chunk < p_track->i_chunk_count; i_chunk++ )
-    {
-        if( p_track->chunk )
-        {
-           FREENULL(p_track->chunk[i_chunk].p_sample_count_dts);
-           FREENULL(p_track->chunk[i_chunk].p_sample_delta_dts );
-
-           FREENULL(p_track->chunk[i_chunk].p_sample_count_pts);
-           FREENULL(p_track->chunk[i_chunk].p_sample_offset_pts );
-        }
-    }
     FREENULL( p_track->chunk );
-
-    if( !p_track->i_sample_size )
-    {
-        FREENULL( p_track->p_sample_size );
-    }
+    /* the sample tables belong to the boxes */
+    p_track->p_sample_size = NULL;
+    p_track->p_stts = NULL;
+    p_track->p_ctts = NULL;
 }
 
 static int MP4_TrackSelect( demux_t *p_demux, mp4_track_t *p_track,
@@ -2859,6 +2935,585 @@ static void MP4_TrackSetELST( demux_t *p_demux, mp4_track_t *tk,
     }
 }
 
+/*****************************************************************************
+ * Fragmented files
+ *****************************************************************************
+ * The moov only describes the tracks, and each moof gives the samples of
+ * the following data. The fragments are loaded one at a time as they come,
+ * so that the file can be played while it is being received (DASH, live
+ * recordings) and whatever its length.
+ *****************************************************************************/
+#define FRAG_PROBE_SIZE (1 << 20) /* maximum size peeked to find the moov */
+
+/* Peeks i_size bytes, returns whether they are all available */
+static bool FragPeek( demux_t *p_demux, const uint8_t **pp_peek,
+                      uint64_t i_size )
+{
+    const int i_peek = stream_Peek( p_demux->s, pp_peek, i_size );
+    return i_peek >= 0 && (uint64_t)i_peek >= i_size;
+}
+
+/* Checks for a moov with a mvex box, without moving in the stream */
+static bool FragProbe( demux_t *p_demux )
+{
+    const uint8_t *p_peek;
+    uint64_t i_pos = 0; /* always below FRAG_PROBE_SIZE */
+    uint64_t i_size;
+    unsigned i_header;
+
+    for( ;; )
+    {
+        if( !FragPeek( p_demux, &p_peek, i_pos + 8 ) )
+            return false;
+
+        const vlc_fourcc_t i_type = VLC_FOURCC( p_peek[i_pos + 4],
+                                                p_peek[i_pos + 5],
+                                                p_peek[i_pos + 6],
+                                                p_peek[i_pos + 7] );
+        i_size = GetDWBE( &p_peek[i_pos] );
+        i_header = 8;
+        if( i_size == 1 )
+        {
+            if( !FragPeek( p_demux, &p_peek, i_pos + 16 ) )
+                return false;
+            i_size = GetQWBE( &p_peek[i_pos + 8] );
+            i_header = 16;
+        }
+        if( i_size < i_header || i_type == ATOM_mdat || i_type == ATOM_moof )
+            return false;
+        if( i_type == ATOM_moov )
+            break;
+
+        /* 64-bits sizes could overflow the position */
+        if( i_size >= FRAG_PROBE_SIZE - i_pos )
+            return false;
+        i_pos += i_size;
+    }
+
+    if( i_size > FRAG_PROBE_SIZE - i_pos ||
+        !FragPeek( p_demux, &p_peek, i_pos + i_size ) )
+        return false;
+
+    /* Look for mvex in the moov children */
+    const uint64_t i_end = i_pos + i_size;
+    for( i_pos += i_header; i_pos + 8 <= i_end; )
+    {
+        const uint32_t i_child = GetDWBE( &p_peek[i_pos] );
+
+        if( VLC_FOURCC( p_peek[i_pos + 4], p_peek[i_pos + 5],
+                        p_peek[i_pos + 6], p_peek[i_pos + 7] ) == ATOM_mvex )
+            return true;
+        if( i_child < 8 )
+            break;
+        i_pos += i_child;
+    }
+    return false;
+}
+
+/* Loads the boxes up to the first fragment */
+static int FragLoadInit( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    MP4_Box_t   *p_root;
+
+    p_sys->p_root = p_root = calloc( 1, sizeof( MP4_Box_t ) );
+    if( p_root == NULL )
+        return VLC_ENOMEM;
+
+    p_root->i_pos = 0;
+    p_root->i_type = ATOM_root;
+    p_root->i_shortsize = 1;
+    p_root->i_size = stream_Size( p_demux->s );
+
+    for( ;; )
+    {
+        MP4_Box_t box;
+
+        if( !MP4_ReadBoxCommon( p_demux->s, &box ) ||
+            box.i_size == 0 )
+            break;
+        if( box.i_type == ATOM_moof || box.i_type == ATOM_mdat )
+            break;
+        if( MP4_BoxReadNext( p_demux->s, p_root ) == NULL )
+            return VLC_EGENERIC;
+    }
+    p_sys->frag.i_next = stream_Tell( p_demux->s );
+
+    return MP4_BoxGet( p_root, "/moov" ) ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+/* Whether the moov also has samples, which fragments only extend */
+static bool FragHasSamples( MP4_Box_t *p_root )
+{
+    MP4_Box_t *p_stsz;
+
+    for( int i = 0; i < MP4_BoxCount( p_root, "/moov/trak" ); i++ )
+    {
+        p_stsz = MP4_BoxGet( p_root, "/moov/trak[%d]/mdia/minf/stbl/stsz", i );
+        if( p_stsz && p_stsz->data.p_stsz &&
+            p_stsz->data.p_stsz->i_sample_count > 0 )
+            return true;
+    }
+    return false;
+}
+
+static mp4_track_t *FragGetTrack( demux_sys_t *p_sys, uint32_t i_track_ID )
+{
+    for( unsigned i = 0; i < p_sys->i_tracks; i++ )
+    {
+        if( p_sys->track[i].i_track_ID == i_track_ID )
+            return &p_sys->track[i];
+    }
+    return NULL;
+}
+
+/* Converts a fragment time in the track timescale into a presentation time,
+ * with the initial edit (empty edit and/or media time) */
+static mtime_t FragGetTime( demux_sys_t *p_sys, const mp4_track_t *tk,
+                            int64_t i_time )
+{
+    if( tk->p_elst && tk->p_elst->data.p_elst->i_entry_count > 0 )
+    {
+        const MP4_Box_data_elst_t *elst = tk->p_elst->data.p_elst;
+        unsigned i = 0;
+
+        if( elst->i_media_time[0] < 0 && elst->i_entry_count > 1 )
+        {
+            i_time += elst->i_segment_duration[0] * tk->i_timescale /
+                      p_sys->i_timescale;
+            i = 1;
+        }
+        if( elst->i_media_time[i] > 0 )
+            i_time -= elst->i_media_time[i];
+    }
+    if( i_time < 0 )
+        i_time = 0;
+    return INT64_C(1000000) * i_time / (int64_t)tk->i_timescale;
+}
+
+/* Remembers the fragments read, when the file has no index */
+static void FragIndexAdd( mp4_frag_t *p_frag, mtime_t i_time,
+                          uint64_t i_offset )
+{
+    const unsigned i_points = p_frag->i_points;
+
+    if( p_frag->b_indexed ||
+        ( i_points > 0 && p_frag->p_points[i_points - 1].i_offset >= i_offset ) )
+        return;
+
+    if( ( i_points & ( i_points - 1 ) ) == 0 )
+    {
+        mp4_frag_point_t *p_points =
+            realloc( p_frag->p_points,
+                     ( i_points ? 2 * i_points : 1 ) * sizeof( *p_points ) );
+        if( p_points == NULL )
+            return;
+        p_frag->p_points = p_points;
+    }
+    p_frag->p_points[i_points].i_time = i_time;
+    p_frag->p_points[i_points].i_offset = i_offset;
+    p_frag->i_points++;
+}
+
+static void FragIndexMfra( demux_t *p_demux, MP4_Box_t *p_mfra )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mp4_frag_t  *p_frag = &p_sys->frag;
+    MP4_Box_t   *p_tfra = NULL;
+    mp4_track_t *tk = NULL;
+
+    /* Prefer the random access points of a video track */
+    for( MP4_Box_t *p_box = p_mfra->p_first; p_box; p_box = p_box->p_next )
+    {
+        if( p_box->i_type != ATOM_tfra || !p_box->data.p_tfra )
+            continue;
+
+        mp4_track_t *p_track = FragGetTrack( p_sys,
+                                             p_box->data.p_tfra->i_track_ID );
+        if( p_track == NULL || !p_track->b_ok ||
+            p_box->data.p_tfra->i_number_of_entries == 0 )
+            continue;
+        if( tk == NULL ||
+            ( p_track->fmt.i_cat == VIDEO_ES && tk->fmt.i_cat != VIDEO_ES ) )
+        {
+            p_tfra = p_box;
+            tk = p_track;
+        }
+    }
+    if( p_tfra == NULL )
+        return;
+
+    const MP4_Box_data_tfra_t *tfra = p_tfra->data.p_tfra;
+    mp4_frag_point_t *p_points = malloc( tfra->i_number_of_entries *
+                                         sizeof( *p_points ) );
+    if( p_points == NULL )
+        return;
+
+    for( uint32_t i = 0; i < tfra->i_number_of_entries; i++ )
+    {
+        p_points[i].i_time = FragGetTime( p_sys, tk, tfra->p_time[i] );
+        p_points[i].i_offset = tfra->p_moof_offset[i];
+    }
+    free( p_frag->p_points );
+    p_frag->p_points = p_points;
+    p_frag->i_points = tfra->i_number_of_entries;
+    p_frag->b_indexed = true;
+    msg_Dbg( p_demux, "using %u random access points of track[Id 0x%x]",
+             p_frag->i_points, tk->i_track_ID );
+}
+
+static void FragIndexSidx( demux_t *p_demux, MP4_Box_t *p_sidx )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mp4_frag_t  *p_frag = &p_sys->frag;
+    const MP4_Box_data_sidx_t *sidx = p_sidx->data.p_sidx;
+
+    if( !sidx || !sidx->i_timescale || !sidx->i_reference_count )
+        return;
+
+    mp4_frag_point_t *p_points = malloc( sidx->i_reference_count *
+                                         sizeof( *p_points ) );
+    if( p_points == NULL )
+        return;
+
+    /* Offsets are relative to the first byte after the sidx */
+    uint64_t i_offset = p_sidx->i_pos + p_sidx->i_size + sidx->i_first_offset;
+    uint64_t i_time = sidx->i_earliest_presentation_time;
+
+    for( unsigned i = 0; i < sidx->i_reference_count; i++ )
+    {
+        p_points[i].i_time = INT64_C(1000000) * i_time / sidx->i_timescale;
+        p_points[i].i_offset = i_offset;
+        i_offset += sidx->p_items[i].i_referenced_size;
+        i_time += sidx->p_items[i].i_subsegment_duration;
+    }
+    free( p_frag->p_points );
+    p_frag->p_points = p_points;
+    p_frag->i_points = sidx->i_reference_count;
+    p_frag->b_indexed = true;
+
+    if( !p_sys->i_duration )
+        p_sys->i_duration = i_time * p_sys->i_timescale / sidx->i_timescale;
+    msg_Dbg( p_demux, "using %u segments of the segment index",
+             p_frag->i_points );
+}
+
+/* Loads the seek index, from the mfra at the end of the file or the sidx */
+static void FragLoadIndex( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const int64_t i_size = stream_Size( p_demux->s );
+
+    if( p_sys->b_seekable && i_size > 16 )
+    {
+        const int64_t i_pos = stream_Tell( p_demux->s );
+        const uint8_t *p_peek;
+
+        if( !stream_Seek( p_demux->s, i_size - 16 ) &&
+            stream_Peek( p_demux->s, &p_peek, 16 ) == 16 &&
+            GetDWBE( p_peek ) == 16 &&
+            VLC_FOURCC( p_peek[4], p_peek[5], p_peek[6], p_peek[7] ) == ATOM_mfro )
+        {
+            const uint32_t i_mfra = GetDWBE( &p_peek[12] );
+
+            if( i_mfra >= 16 && i_mfra <= i_size &&
+                !stream_Seek( p_demux->s, i_size - i_mfra ) )
+            {
+                MP4_Box_t *p_mfra = MP4_BoxReadNext( p_demux->s, NULL );
+
+                if( p_mfra && p_mfra->i_type == ATOM_mfra )
+                    FragIndexMfra( p_demux, p_mfra );
+                MP4_BoxFree( p_demux->s, p_mfra );
+            }
+        }
+        stream_Seek( p_demux->s, i_pos );
+    }
+
+    MP4_Box_t *p_sidx = MP4_BoxGet( p_sys->p_root, "/sidx" );
+    if( !p_sys->frag.b_indexed && p_sidx )
+        FragIndexSidx( p_demux, p_sidx );
+}
+
+static int FragSampleCmp( const void *p_a, const void *p_b )
+{
+    const mp4_frag_sample_t *a = p_a, *b = p_b;
+
+    if( a->i_offset == b->i_offset )
+        return 0;
+    return a->i_offset < b->i_offset ? -1 : 1;
+}
+
+static int FragAddSample( mp4_frag_t *p_frag, const mp4_frag_sample_t *p_sample )
+{
+    if( p_frag->i_count >= p_frag->i_alloc )
+    {
+        const unsigned i_alloc = __MAX( 2 * p_frag->i_alloc, 64 );
+        mp4_frag_sample_t *p_samples =
+            realloc( p_frag->p_samples, i_alloc * sizeof( *p_samples ) );
+
+        if( p_samples == NULL )
+            return VLC_ENOMEM;
+        p_frag->p_samples = p_samples;
+        p_frag->i_alloc = i_alloc;
+    }
+    p_frag->p_samples[p_frag->i_count++] = *p_sample;
+    return VLC_SUCCESS;
+}
+
+/* Adds the samples of a track fragment, returns the end of its data */
+static uint64_t FragAddTraf( demux_t *p_demux, MP4_Box_t *p_traf,
+                             uint64_t i_moof, uint64_t i_data )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    MP4_Box_t   *p_tfhd = MP4_BoxGet( p_traf, "tfhd" );
+    MP4_Box_t   *p_tfdt = MP4_BoxGet( p_traf, "tfdt" );
+
+    if( p_tfhd == NULL || p_tfhd->data.p_tfhd == NULL )
+        return i_data;
+
+    const MP4_Box_data_tfhd_t *tfhd = p_tfhd->data.p_tfhd;
+    mp4_track_t *tk = FragGetTrack( p_sys, tfhd->i_track_ID );
+    if( tk == NULL )
+    {
+        msg_Warn( p_demux, "fragment of unknown track[Id 0x%x]",
+                  tfhd->i_track_ID );
+        return i_data;
+    }
+    const MP4_Box_data_trex_t *trex = tk->p_trex ? tk->p_trex->data.p_trex
+                                                 : NULL;
+    const bool b_usable = tk->b_ok && !tk->b_chapter;
+
+    /* Defaults from the tfhd, else from the trex */
+    uint32_t i_default_duration = trex ? trex->i_default_sample_duration : 0;
+    uint32_t i_default_size = trex ? trex->i_default_sample_size : 0;
+    if( tfhd->i_flags & MP4_TFHD_DFLT_SAMPLE_DURATION )
+        i_default_duration = tfhd->i_default_sample_duration;
+    if( tfhd->i_flags & MP4_TFHD_DFLT_SAMPLE_SIZE )
+        i_default_size = tfhd->i_default_sample_size;
+
+    uint64_t i_base;
+    if( tfhd->i_flags & MP4_TFHD_BASE_DATA_OFFSET )
+        i_base = tfhd->i_base_data_offset;
+    else if( tfhd->i_flags & MP4_TFHD_DEFAULT_BASE_IS_MOOF )
+        i_base = i_moof;
+    else
+        i_base = i_data;
+
+    uint64_t i_dts = tk->i_frag_dts;
+    if( p_tfdt && p_tfdt->data.p_tfdt )
+        i_dts = p_tfdt->data.p_tfdt->i_base_media_decode_time;
+
+    uint64_t i_offset = i_base;
+    for( MP4_Box_t *p_trun = p_traf->p_first; p_trun; p_trun = p_trun->p_next )
+    {
+        if( p_trun->i_type != ATOM_trun || !p_trun->data.p_trun )
+            continue;
+
+        const MP4_Box_data_trun_t *trun = p_trun->data.p_trun;
+        if( trun->i_flags & MP4_TRUN_DATA_OFFSET )
+            i_offset = i_base + (int32_t)trun->i_data_offset;
+
+        for( uint32_t i = 0; i < trun->i_sample_count; i++ )
+        {
+            const MP4_descriptor_trun_sample_t *p_entry = &trun->p_samples[i];
+            const uint32_t i_duration =
+                ( trun->i_flags & MP4_TRUN_SAMPLE_DURATION ) ?
+                p_entry->i_duration : i_default_duration;
+            const uint32_t i_size =
+                ( trun->i_flags & MP4_TRUN_SAMPLE_SIZE ) ?
+                p_entry->i_size : i_default_size;
+
+            if( b_usable && i_size > 0 )
+            {
+                mp4_frag_sample_t sample = {
+                    .i_offset = i_offset,
+                    .i_size = i_size,
+                    .i_track = tk - p_sys->track,
+                    .i_dts = VLC_TS_0 + FragGetTime( p_sys, tk, i_dts ),
+                };
+
+                if( trun->i_flags & MP4_TRUN_SAMPLE_TIME_OFFSET )
+                {
+                    const int64_t i_cts = trun->i_version == 0 ?
+                        (int64_t)p_entry->i_composition_time_offset :
+                        (int32_t)p_entry->i_composition_time_offset;
+                    sample.i_pts = VLC_TS_0 +
+                                   FragGetTime( p_sys, tk, i_dts + i_cts );
+                }
+                else if( tk->fmt.i_cat != VIDEO_ES )
+                    sample.i_pts = sample.i_dts;
+                else
+                    sample.i_pts = VLC_TS_INVALID;
+
+                if( FragAddSample( &p_sys->frag, &sample ) )
+                    break;
+            }
+            i_offset += i_size;
+            i_dts += i_duration;
+        }
+    }
+    tk->i_frag_dts = i_dts;
+    return i_offset;
+}
+
+/* Reads the next moof and prepares its samples */
+static int FragLoadNext( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mp4_frag_t  *p_frag = &p_sys->frag;
+    MP4_Box_t   *p_moof = NULL;
+    MP4_Box_t   box;
+
+    p_frag->i_count = 0;
+    p_frag->i_current = 0;
+
+    if( p_frag->i_next == UINT64_MAX ||
+        ( stream_Tell( p_demux->s ) != (int64_t)p_frag->i_next &&
+          stream_Seek( p_demux->s, p_frag->i_next ) ) )
+        return VLC_EGENERIC;
+
+    while( p_moof == NULL )
+    {
+        if( !MP4_ReadBoxCommon( p_demux->s, &box ) || box.i_size < 8 )
+            return VLC_EGENERIC; /* end of stream */
+
+        if( box.i_type == ATOM_moof )
+        {
+            p_moof = MP4_BoxReadNext( p_demux->s, NULL );
+            if( p_moof == NULL )
+                return VLC_EGENERIC;
+        }
+        else if( stream_Seek( p_demux->s, box.i_pos + box.i_size ) )
+            return VLC_EGENERIC;
+    }
+
+    const uint64_t i_moof = p_moof->i_pos;
+    uint64_t i_end = i_moof + p_moof->i_size;
+    uint64_t i_data = i_moof;
+
+    for( MP4_Box_t *p_traf = p_moof->p_first; p_traf; p_traf = p_traf->p_next )
+    {
+        if( p_traf->i_type == ATOM_traf )
+        {
+            i_data = FragAddTraf( p_demux, p_traf, i_moof, i_data );
+            i_end = __MAX( i_end, i_data );
+        }
+    }
+    MP4_BoxFree( p_demux->s, p_moof );
+
+    /* The next fragment starts after the mdat following the moof */
+    if( MP4_ReadBoxCommon( p_demux->s, &box ) && box.i_type == ATOM_mdat )
+        p_frag->i_next = box.i_size ? box.i_pos + box.i_size : UINT64_MAX;
+    else
+        p_frag->i_next = i_end;
+
+    if( p_frag->i_count == 0 )
+        return VLC_SUCCESS;
+
+    /* Read the samples in file order, each with the lowest dts to come */
+    qsort( p_frag->p_samples, p_frag->i_count, sizeof( mp4_frag_sample_t ),
+           FragSampleCmp );
+    mtime_t i_pcr = INT64_MAX;
+    for( unsigned i = p_frag->i_count; i-- > 0; )
+    {
+        i_pcr = __MIN( i_pcr, p_frag->p_samples[i].i_dts );
+        p_frag->p_samples[i].i_pcr = i_pcr;
+    }
+    FragIndexAdd( p_frag, i_pcr - VLC_TS_0, i_moof );
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * DemuxFrag: read the samples of a fragmented file, in file order
+ *****************************************************************************/
+static int DemuxFrag( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mp4_frag_t  *p_frag = &p_sys->frag;
+
+    if( p_frag->i_current >= p_frag->i_count )
+        return FragLoadNext( p_demux ) ? 0 : 1;
+
+    const mp4_frag_sample_t *p_sample = &p_frag->p_samples[p_frag->i_current++];
+    mp4_track_t *tk = &p_sys->track[p_sample->i_track];
+
+    if( p_sample->i_pcr != p_sys->i_pcr )
+    {
+        p_sys->i_pcr = p_sample->i_pcr;
+        p_sys->i_time = ( p_sys->i_pcr - VLC_TS_0 ) * p_sys->i_timescale /
+                        INT64_C(1000000);
+        es_out_Control( p_demux->out, ES_OUT_SET_PCR, p_sys->i_pcr );
+        MP4_UpdateSeekpoint( p_demux );
+    }
+
+    es_out_Control( p_demux->out, ES_OUT_GET_ES_STATE, tk->p_es,
+                    &tk->b_selected );
+    if( !tk->b_selected )
+        return 1;
+
+    if( stream_Tell( p_demux->s ) != (int64_t)p_sample->i_offset &&
+        stream_Seek( p_demux->s, p_sample->i_offset ) )
+    {
+        msg_Warn( p_demux, "track[0x%x] sample out of reach",
+                  tk->i_track_ID );
+        return 1;
+    }
+
+    block_t *p_block = stream_Block( p_demux->s, p_sample->i_size );
+    if( p_block == NULL )
+    {
+        msg_Warn( p_demux, "track[0x%x] truncated fragment (eof?)",
+                  tk->i_track_ID );
+        return 0;
+    }
+    p_block->i_dts = p_sample->i_dts;
+    p_block->i_pts = p_sample->i_pts;
+    es_out_Send( p_demux->out, tk->p_es, p_block );
+    return 1;
+}
+
+/* Seeks to the fragment including i_date, with the index */
+static int FragSeek( demux_t *p_demux, mtime_t i_date )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mp4_frag_t  *p_frag = &p_sys->frag;
+    unsigned i;
+
+    if( !p_sys->b_seekable || p_frag->i_points == 0 )
+        return VLC_EGENERIC;
+
+    for( i = 1; i < p_frag->i_points; i++ )
+    {
+        if( p_frag->p_points[i].i_time > i_date )
+            break;
+    }
+    const mp4_frag_point_t *p_point = &p_frag->p_points[i - 1];
+
+    if( stream_Seek( p_demux->s, p_point->i_offset ) )
+        return VLC_EGENERIC;
+
+    msg_Dbg( p_demux, "seeking to fragment at %"PRIu64" (%"PRId64" ms)",
+             p_point->i_offset, p_point->i_time / 1000 );
+    p_frag->i_count = 0;
+    p_frag->i_current = 0;
+    p_frag->i_next = p_point->i_offset;
+
+    /* Only used by fragments without tfdt */
+    for( unsigned i_track = 0; i_track < p_sys->i_tracks; i_track++ )
+    {
+        mp4_track_t *tk = &p_sys->track[i_track];
+        tk->i_frag_dts = p_point->i_time * tk->i_timescale / INT64_C(1000000);
+    }
+
+    p_sys->i_time = i_date * p_sys->i_timescale / INT64_C(1000000);
+    p_sys->i_pcr  = VLC_TS_INVALID;
+    MP4_UpdateSeekpoint( p_demux );
+
+    es_out_Control( p_demux->out, ES_OUT_SET_NEXT_DISPLAY_TIME, i_date );
+    return VLC_SUCCESS;
+}
+
 /* */
 static const char *MP4_ConvertMacCode( uint16_t i_code )
 {
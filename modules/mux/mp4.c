@@ -48,6 +48,16 @@
     "Create \"Fast Start\" files. " \
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
+#define FRAGDUR_TEXT N_("Fragment duration (ms)")
+#define FRAGDUR_LONGTEXT N_( \
+    "Create fragmented files, with a movie fragment every given duration " \
+    "(at the next video key frame). Fragmented files can be played while " \
+    "they are written, and need no rewriting when closed. " \
+    "0 disables fragmentation.")
+#define MFRA_TEXT N_("Fragment random access index")
+#define MFRA_LONGTEXT N_( \
+    "Append an index of the movie fragments at the end of fragmented " \
+    "files, for faster seeking.")
 
 static int  Open   ( vlc_object_t * );
 static void Close  ( vlc_object_t * );
@@ -63,6 +73,10 @@ vlc_module_begin ()
     add_bool( SOUT_CFG_PREFIX "faststart", true,
               FASTSTART_TEXT, FASTSTART_LONGTEXT,
               true )
+    add_integer( SOUT_CFG_PREFIX "frag-duration", 0,
+                 FRAGDUR_TEXT, FRAGDUR_LONGTEXT, true )
+    add_bool( SOUT_CFG_PREFIX "mfra", true,
+              MFRA_TEXT, MFRA_LONGTEXT, true )
     set_capability( "sout mux", 5 )
     add_shortcut( "mp4", "mov", "3gp" )
     set_callbacks( Open, Close )
@@ -72,7 +86,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "frag-duration", "mfra", NULL
 };
 
 static int Control( sout_mux_t *, int, va_list );
@@ -94,6 +108,15 @@ typedef struct
 
 } mp4_entry_t;
 
+/* Random access point of a fragmented track */
+typedef struct
+{
+    uint64_t i_time;        /* decode time, in track timescale */
+    uint64_t i_moof_pos;
+    uint8_t  i_traf;        /* traf number in the moof */
+
+} mp4_tfra_entry_t;
+
 typedef struct
 {
     es_format_t   fmt;
@@ -116,6 +139,17 @@ typedef struct
     /* for spu */
     int64_t i_last_dts;
 
+    /* fragmented files: data of the current fragment, decode time at its
+     * end, and random access points */
+    uint32_t     i_timescale;
+    block_t      *p_frag;
+    block_t      **pp_frag_last;
+    int64_t      i_frag_time;   /* in us since the start of the file */
+    uint64_t     i_frag_dts;    /* same, in track timescale */
+    bool         b_frag_started;
+    unsigned int i_tfra_count;
+    mp4_tfra_entry_t *tfra;
+
 } mp4_stream_t;
 
 struct sout_mux_sys_t
@@ -130,6 +164,13 @@ struct sout_mux_sys_t
 
     int64_t  i_dts_start;
 
+    /* fragmented files */
+    mtime_t  i_frag_duration;   /* 0 when not fragmented */
+    bool     b_mfra;
+    bool     b_moov_sent;
+    uint32_t i_frag_seq;
+    int64_t  i_frag_start;      /* dts of the current fragment */
+
     int          i_nb_streams;
     mp4_stream_t **pp_streams;
 };
@@ -169,6 +210,10 @@ static block_t *bo_to_sout( sout_instance_t *p_sout,  bo_t *box );
 
 static bo_t *GetMoovBox( sout_mux_t *p_mux );
 
+static bool FragmentIsDue( sout_mux_t *, mp4_stream_t *, block_t * );
+static void WriteFragment( sout_mux_t *p_mux );
+static void WriteMfra( sout_mux_t *p_mux );
+
 static block_t *ConvertSUBT( block_t *);
 static block_t *ConvertAVC1( block_t * );
 
@@ -198,6 +243,12 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_mov        = p_mux->psz_mux && !strcmp( p_mux->psz_mux, "mov" );
     p_sys->b_3gp        = p_mux->psz_mux && !strcmp( p_mux->psz_mux, "3gp" );
     p_sys->i_dts_start  = 0;
+    p_sys->i_frag_duration =
+        var_GetInteger( p_mux, SOUT_CFG_PREFIX "frag-duration" ) * 1000;
+    p_sys->b_mfra       = var_GetBool( p_mux, SOUT_CFG_PREFIX "mfra" );
+    p_sys->b_moov_sent  = false;
+    p_sys->i_frag_seq   = 0;
+    p_sys->i_frag_start = 0;
 
 
     if( !p_sys->b_mov )
@@ -211,6 +262,8 @@ static int Open( vlc_object_t *p_this )
         else bo_add_fourcc( box, "mp41" );
         bo_add_fourcc( box, "avc1" );
         bo_add_fourcc( box, "qt  " );
+        if( p_sys->i_frag_duration > 0 )
+            bo_add_fourcc( box, "iso6" );
         box_fix( box );
 
         p_sys->i_pos += box->i_buffer;
@@ -223,6 +276,14 @@ static int Open( vlc_object_t *p_this )
      * Quicktime actually doesn't like the 64 bits extensions !!! */
     p_sys->b_64_ext = false;
 
+    /* Fragmented files get the moov first, and a mdat per fragment */
+    if( p_sys->i_frag_duration > 0 )
+    {
+        msg_Dbg( p_mux, "fragments of %"PRId64" ms",
+                 p_sys->i_frag_duration / 1000 );
+        return VLC_SUCCESS;
+    }
+
     /* Now add mdat header */
     box = box_new( "mdat" );
     bo_add_64be  ( box, 0 ); // enough to store an extended size
@@ -250,6 +311,21 @@ static void Close( vlc_object_t * p_this )
 
     msg_Dbg( p_mux, "Close" );
 
+    if( p_sys->i_frag_duration > 0 )
+    {
+        /* Nothing to rewrite: flush the last fragment and the index */
+        if( !p_sys->b_moov_sent )
+        {
+            moov = GetMoovBox( p_mux );
+            p_sys->i_pos += moov->i_buffer;
+            box_send( p_mux, moov );
+        }
+        WriteFragment( p_mux );
+        if( p_sys->b_mfra )
+            WriteMfra( p_mux );
+        goto clean;
+    }
+
     /* Update mdat size */
     bo_init( &bo, 0, NULL, true );
     if( p_sys->i_pos - p_sys->i_mdat_pos >= (((uint64_t)1)<<32) )
@@ -348,13 +424,16 @@ static void Close( vlc_object_t * p_this )
     sout_AccessOutSeek( p_mux->p_access, i_moov_pos );
     box_send( p_mux, moov );
 
+clean:
     /* Clean-up */
     for( i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
     {
         mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
 
         es_format_Clean( &p_stream->fmt );
+        block_ChainRelease( p_stream->p_frag );
         free( p_stream->entry );
+        free( p_stream->tfra );
         free( p_stream );
     }
     if( p_sys->i_nb_streams ) free( p_sys->pp_streams );
@@ -366,8 +445,8 @@ static void Close( vlc_object_t * p_this )
  *****************************************************************************/
 static int Control( sout_mux_t *p_mux, int i_query, va_list args )
 {
-    VLC_UNUSED(p_mux);
     bool *pb_bool;
+    char **ppsz;
 
     switch( i_query )
     {
@@ -381,7 +460,13 @@ static int Control( sout_mux_t *p_mux, int i_query, va_list args )
             *pb_bool = true;
             return VLC_SUCCESS;
 
-        case MUX_GET_MIME:   /* Not needed, as not streamable */
+        case MUX_GET_MIME:   /* Only fragmented files are streamable */
+            if( p_mux->p_sys->i_frag_duration <= 0 )
+                return VLC_EGENERIC;
+            ppsz = (char**)va_arg( args, char ** );
+            *ppsz = strdup( "video/mp4" );
+            return VLC_SUCCESS;
+
         default:
             return VLC_EGENERIC;
     }
@@ -413,6 +498,11 @@ static int AddStream( sout_mux_t *p_mux, sout_input_t *p_input )
         case VLC_CODEC_YUYV:
             break;
         case VLC_CODEC_SUBT:
+            if( p_sys->i_frag_duration > 0 )
+            {
+                msg_Err( p_mux, "subtitles are not supported in fragments" );
+                return VLC_EGENERIC;
+            }
             msg_Warn( p_mux, "subtitle track added like in .mov (even when creating .mp4)" );
             break;
         default:
@@ -433,6 +523,17 @@ static int AddStream( sout_mux_t *p_mux, sout_input_t *p_input )
         calloc( p_stream->i_entry_max, sizeof( mp4_entry_t ) );
     p_stream->i_dts_start   = 0;
     p_stream->i_duration    = 0;
+    if( p_stream->fmt.i_cat == AUDIO_ES )
+        p_stream->i_timescale = p_stream->fmt.audio.i_rate;
+    else
+        p_stream->i_timescale = 1001;
+    p_stream->p_frag        = NULL;
+    p_stream->pp_frag_last  = &p_stream->p_frag;
+    p_stream->i_frag_time   = 0;
+    p_stream->i_frag_dts    = 0;
+    p_stream->b_frag_started = false;
+    p_stream->i_tfra_count  = 0;
+    p_stream->tfra          = NULL;
 
     p_input->p_sys          = p_stream;
 
@@ -515,6 +616,26 @@ again:
             }
         }
 
+        /* Fragmented files: the moov goes first, and the samples are
+         * kept until the end of their fragment */
+        if( p_sys->i_frag_duration > 0 )
+        {
+            if( !p_sys->b_moov_sent )
+            {
+                bo_t *moov = GetMoovBox( p_mux );
+
+                p_sys->i_pos += moov->i_buffer;
+                box_send( p_mux, moov );
+                p_sys->b_moov_sent = true;
+                p_sys->i_frag_start = p_data->i_dts;
+            }
+            else if( FragmentIsDue( p_mux, p_stream, p_data ) )
+            {
+                WriteFragment( p_mux );
+                p_sys->i_frag_start = p_data->i_dts;
+            }
+        }
+
         /* Save starting time */
         if( p_stream->i_entry_count == 0 )
         {
@@ -546,6 +667,15 @@ again:
         }
 
 
+        if( p_sys->i_frag_duration > 0 && !p_stream->b_frag_started )
+        {
+            /* A track starting after the others begins with a gap */
+            p_stream->i_frag_time = __MAX( p_data->i_dts - p_sys->i_dts_start, 0 );
+            p_stream->i_frag_dts  = p_stream->i_frag_time *
+                                    p_stream->i_timescale / CLOCK_FREQ;
+            p_stream->b_frag_started = true;
+        }
+
         /* add index entry */
         p_stream->entry[p_stream->i_entry_count].i_pos    = p_sys->i_pos;
         p_stream->entry[p_stream->i_entry_count].i_size   = p_data->i_buffer;
@@ -565,12 +695,18 @@ again:
 
         /* update */
         p_stream->i_duration = p_stream->i_last_dts - p_stream->i_dts_start + p_data->i_length;
-        p_sys->i_pos += p_data->i_buffer;
 
         /* Save the DTS */
         p_stream->i_last_dts = p_data->i_dts;
 
+        if( p_sys->i_frag_duration > 0 )
+        {
+            block_ChainLastAppend( &p_stream->pp_frag_last, p_data );
+            continue;
+        }
+
         /* write data */
+        p_sys->i_pos += p_data->i_buffer;
         sout_AccessOutWrite( p_mux->p_access, p_data );
 
         if( p_stream->fmt.i_cat == SPU_ES )
@@ -1659,50 +1795,54 @@ static bo_t *GetMoovBox( sout_mux_t *p_mux )
         box_gather( trak, tkhd );
 
         /* *** add /moov/trak/edts and elst */
-        edts = box_new( "edts" );
-        elst = box_full_new( "elst", p_sys->b_64_ext ? 1 : 0, 0 );
-        if( p_stream->i_dts_start > p_sys->i_dts_start )
+        /* (fragments give their decode time themselves) */
+        if( p_sys->i_frag_duration <= 0 )
         {
-            bo_add_32be( elst, 2 );
+            edts = box_new( "edts" );
+            elst = box_full_new( "elst", p_sys->b_64_ext ? 1 : 0, 0 );
+            if( p_stream->i_dts_start > p_sys->i_dts_start )
+            {
+                bo_add_32be( elst, 2 );
 
+                if( p_sys->b_64_ext )
+                {
+                    bo_add_64be( elst, (p_stream->i_dts_start-p_sys->i_dts_start) *
+                                 i_movie_timescale / INT64_C(1000000) );
+                    bo_add_64be( elst, -1 );
+                }
+                else
+                {
+                    bo_add_32be( elst, (p_stream->i_dts_start-p_sys->i_dts_start) *
+                                 i_movie_timescale / INT64_C(1000000) );
+                    bo_add_32be( elst, -1 );
+                }
+                bo_add_16be( elst, 1 );
+                bo_add_16be( elst, 0 );
+            }
+            else
+            {
+                bo_add_32be( elst, 1 );
+            }
             if( p_sys->b_64_ext )
             {
-                bo_add_64be( elst, (p_stream->i_dts_start-p_sys->i_dts_start) *
+                bo_add_64be( elst, p_stream->i_duration *
                              i_movie_timescale / INT64_C(1000000) );
-                bo_add_64be( elst, -1 );
+                bo_add_64be( elst, 0 );
             }
             else
             {
-                bo_add_32be( elst, (p_stream->i_dts_start-p_sys->i_dts_start) *
+                bo_add_32be( elst, p_stream->i_duration *
                              i_movie_timescale / INT64_C(1000000) );
-                bo_add_32be( elst, -1 );
+                bo_add_32be( elst, 0 );
             }
             bo_add_16be( elst, 1 );
             bo_add_16be( elst, 0 );
-        }
-        else
-        {
-            bo_add_32be( elst, 1 );
-        }
-        if( p_sys->b_64_ext )
-        {
-            bo_add_64be( elst, p_stream->i_duration *
-                         i_movie_timescale / INT64_C(1000000) );
-            bo_add_64be( elst, 0 );
-        }
-        else
-        {
-            bo_add_32be( elst, p_stream->i_duration *
-                         i_movie_timescale / INT64_C(1000000) );
-            bo_add_32be( elst, 0 );
-        }
-        bo_add_16be( elst, 1 );
-        bo_add_16be( elst, 0 );
 
-        box_fix( elst );
-        box_gather( edts, elst );
-        box_fix( edts );
-        box_gather( trak, edts );
+            box_fix( elst );
+            box_gather( edts, elst );
+            box_fix( edts );
+            box_gather( trak, edts );
+        }
 
         /* *** add /moov/trak/mdia *** */
         mdia = box_new( "mdia" );
@@ -1882,6 +2022,27 @@ static bo_t *GetMoovBox( sout_mux_t *p_mux )
         box_gather( moov, trak );
     }
 
+    /* *** add /moov/mvex for fragmented files *** */
+    if( p_sys->i_frag_duration > 0 )
+    {
+        bo_t *mvex = box_new( "mvex" );
+
+        for( i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+        {
+            bo_t *trex = box_full_new( "trex", 0, 0 );
+
+            bo_add_32be( trex, p_sys->pp_streams[i_trak]->i_track_id );
+            bo_add_32be( trex, 1 );     // sample-description-index
+            bo_add_32be( trex, 0 );     // default sample duration
+            bo_add_32be( trex, 0 );     // default sample size
+            bo_add_32be( trex, 0 );     // default sample flags
+            box_fix( trex );
+            box_gather( mvex, trex );
+        }
+        box_fix( mvex );
+        box_gather( moov, mvex );
+    }
+
     /* Add user data tags */
     box_gather( moov, GetUdtaTag( p_mux ) );
 
@@ -1889,6 +2050,235 @@ static bo_t *GetMoovBox( sout_mux_t *p_mux )
     return moov;
 }
 
+/*****************************************************************************
+ * Fragmented files
+ *****************************************************************************/
+
+/* A fragment ends after its duration, at a video key frame if there is
+ * any video (but does not grow forever without key frames) */
+static bool FragmentIsDue( sout_mux_t *p_mux, mp4_stream_t *p_stream,
+                           block_t *p_data )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    const mtime_t i_elapsed = p_data->i_dts - p_sys->i_frag_start;
+    bool b_video = false;
+
+    if( i_elapsed < p_sys->i_frag_duration )
+        return false;
+
+    for( int i = 0; i < p_sys->i_nb_streams; i++ )
+        if( p_sys->pp_streams[i]->fmt.i_cat == VIDEO_ES )
+            b_video = true;
+    if( !b_video )
+        return true;
+
+    if( p_stream->fmt.i_cat == VIDEO_ES &&
+        ( p_data->i_flags & BLOCK_FLAG_TYPE_I ) )
+        return true;
+    return i_elapsed >= 4 * p_sys->i_frag_duration;
+}
+
+static void WriteFragment( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    int      pi_offset_pos[p_sys->i_nb_streams];
+    uint64_t pi_size[p_sys->i_nb_streams];
+    uint64_t i_data = 0;
+    uint8_t  i_traf = 0;
+    bo_t     *moof, *mfhd, bo;
+    block_t  *p_hdr;
+
+    for( int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+        i_data += p_sys->pp_streams[i_trak]->i_entry_count;
+    if( i_data == 0 )
+        return;
+
+    moof = box_new( "moof" );
+    mfhd = box_full_new( "mfhd", 0, 0 );
+    bo_add_32be( mfhd, ++p_sys->i_frag_seq );   // sequence-number
+    box_fix( mfhd );
+    box_gather( moof, mfhd );
+
+    for( int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+    {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+        bo_t *traf, *tfhd, *tfdt, *trun;
+        bool b_cto = false;
+
+        pi_offset_pos[i_trak] = -1;
+        pi_size[i_trak] = 0;
+        if( p_stream->i_entry_count == 0 )
+            continue;
+
+        for( unsigned int i = 0; i < p_stream->i_entry_count; i++ )
+        {
+            pi_size[i_trak] += p_stream->entry[i].i_size;
+            if( p_stream->entry[i].i_pts_dts > 0 )
+                b_cto = true;
+        }
+
+        /* Random access point */
+        i_traf++;
+        if( p_sys->b_mfra )
+        {
+            mp4_tfra_entry_t *p_tfra =
+                realloc( p_stream->tfra, ( p_stream->i_tfra_count + 1 ) *
+                                         sizeof( mp4_tfra_entry_t ) );
+            if( p_tfra )
+            {
+                p_stream->tfra = p_tfra;
+                p_tfra += p_stream->i_tfra_count++;
+                p_tfra->i_time     = p_stream->i_frag_dts;
+                p_tfra->i_moof_pos = p_sys->i_pos;
+                p_tfra->i_traf     = i_traf;
+            }
+        }
+
+        traf = box_new( "traf" );
+
+        /* the data offsets are relative to the moof */
+        tfhd = box_full_new( "tfhd", 0, 0x020000 );
+        bo_add_32be( tfhd, p_stream->i_track_id );
+        box_fix( tfhd );
+        box_gather( traf, tfhd );
+
+        tfdt = box_full_new( "tfdt", 1, 0 );
+        bo_add_64be( tfdt, p_stream->i_frag_dts );  // base-media-decode-time
+        box_fix( tfdt );
+        box_gather( traf, tfdt );
+
+        /* data offset, sample durations, sizes, flags and maybe
+         * composition time offsets */
+        trun = box_full_new( "trun", 0, b_cto ? 0x000f01 : 0x000701 );
+        bo_add_32be( trun, p_stream->i_entry_count );
+        bo_add_32be( trun, 0 );     // data-offset (fixed later)
+        for( unsigned int i = 0; i < p_stream->i_entry_count; i++ )
+        {
+            const mp4_entry_t *p_entry = &p_stream->entry[i];
+            /* quantify from the start to avoid drifting */
+            int64_t  i_time = p_stream->i_frag_time + p_entry->i_length;
+            uint64_t i_dts  = i_time * p_stream->i_timescale / CLOCK_FREQ;
+
+            bo_add_32be( trun, i_dts - p_stream->i_frag_dts );
+            bo_add_32be( trun, p_entry->i_size );
+            if( p_stream->fmt.i_cat != VIDEO_ES ||
+                ( p_entry->i_flags & BLOCK_FLAG_TYPE_I ) )
+                bo_add_32be( trun, 0x02000000 );    // sync sample
+            else
+                bo_add_32be( trun, 0x01010000 );    // non sync sample
+            if( b_cto )
+                bo_add_32be( trun, p_entry->i_pts_dts *
+                                   p_stream->i_timescale / CLOCK_FREQ );
+
+            p_stream->i_frag_time = i_time;
+            p_stream->i_frag_dts  = i_dts;
+        }
+        box_fix( trun );
+        pi_offset_pos[i_trak] = moof->i_buffer + traf->i_buffer + 16;
+        box_gather( traf, trun );
+
+        box_fix( traf );
+        box_gather( moof, traf );
+    }
+    box_fix( moof );
+
+    /* The data follow the mdat header, in the order of the trafs */
+    i_data = 0;
+    for( int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+        i_data += pi_size[i_trak];
+
+    bo_init( &bo, 0, NULL, true );
+    if( i_data + 8 >= (((uint64_t)1)<<32) )
+    {
+        /* Extended size */
+        bo_add_32be  ( &bo, 1 );
+        bo_add_fourcc( &bo, "mdat" );
+        bo_add_64be  ( &bo, i_data + 16 );
+    }
+    else
+    {
+        bo_add_32be  ( &bo, i_data + 8 );
+        bo_add_fourcc( &bo, "mdat" );
+    }
+
+    uint64_t i_offset = moof->i_buffer + bo.i_buffer;
+    for( int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+    {
+        if( pi_offset_pos[i_trak] < 0 )
+            continue;
+        bo_fix_32be( moof, pi_offset_pos[i_trak], i_offset );
+        i_offset += pi_size[i_trak];
+    }
+
+    p_sys->i_pos += moof->i_buffer;
+    box_send( p_mux, moof );
+
+    p_hdr = bo_to_sout( p_mux->p_sout, &bo );
+    free( bo.p_buffer );
+    p_sys->i_pos += p_hdr->i_buffer;
+    sout_AccessOutWrite( p_mux->p_access, p_hdr );
+
+    for( int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+    {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+        block_t *p_data = p_stream->p_frag;
+
+        while( p_data )
+        {
+            block_t *p_next = p_data->p_next;
+
+            p_data->p_next = NULL;
+            p_sys->i_pos += p_data->i_buffer;
+            sout_AccessOutWrite( p_mux->p_access, p_data );
+            p_data = p_next;
+        }
+        p_stream->p_frag = NULL;
+        p_stream->pp_frag_last = &p_stream->p_frag;
+        p_stream->i_entry_count = 0;
+    }
+}
+
+/* Index of the fragments, found from the end of the file */
+static void WriteMfra( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    bo_t *mfra, *mfro;
+
+    mfra = box_new( "mfra" );
+    for( int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+    {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+        bo_t *tfra;
+
+        if( p_stream->i_tfra_count == 0 )
+            continue;
+
+        tfra = box_full_new( "tfra", 1, 0 );
+        bo_add_32be( tfra, p_stream->i_track_id );
+        bo_add_32be( tfra, 0 );     // 1 byte traf, trun and sample numbers
+        bo_add_32be( tfra, p_stream->i_tfra_count );
+        for( unsigned int i = 0; i < p_stream->i_tfra_count; i++ )
+        {
+            bo_add_64be( tfra, p_stream->tfra[i].i_time );
+            bo_add_64be( tfra, p_stream->tfra[i].i_moof_pos );
+            bo_add_8   ( tfra, p_stream->tfra[i].i_traf );
+            bo_add_8   ( tfra, 1 );     // trun-number
+            bo_add_8   ( tfra, 1 );     // sample-number
+        }
+        box_fix( tfra );
+        box_gather( mfra, tfra );
+    }
+
+    mfro = box_full_new( "mfro", 0, 0 );
+    bo_add_32be( mfro, mfra->i_buffer + 16 );   // size of the whole mfra
+    box_fix( mfro );
+    box_gather( mfra, mfro );
+    box_fix( mfra );
+
+    p_sys->i_pos += mfra->i_buffer;
+    box_send( p_mux, mfra );
+}
+
 /****************************************************************************/
 
 static void bo_init( bo_t *p_bo, int i_size, uint8_t *p_buffer,
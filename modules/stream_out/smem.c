@@ -37,6 +37,12 @@
  *
  * the video-data and audio-data pointers will be passed to lock/unlock function
  *
+ * Alternatively, the frame callbacks get the buffers themselves, without any
+ * copy. Each buffer belongs to the application until it calls the release
+ * function it was given with it, on the frame pointer, from any thread.
+ * The video frame callback gets tables of 4 planes, with their pitches and
+ * lines, as laid out in the buffer. The unused planes are NULL.
+ *
  ******************************************************************************/
 
 /*****************************************************************************
@@ -52,6 +58,7 @@
 #include <vlc_sout.h>
 #include <vlc_block.h>
 #include <vlc_codec.h>
+#include <vlc_fourcc.h>
 
 /*****************************************************************************
  * Module descriptor
@@ -73,6 +80,16 @@
 #define LT_AUDIO_POSTRENDER_CALLBACK N_( "Address of the audio postrender callback function. " \
                                         "This function will be called when the render is into the buffer." )
 
+#define T_VIDEO_FRAME_CALLBACK N_( "Video frame callback" )
+#define LT_VIDEO_FRAME_CALLBACK N_( "Address of the video frame callback function. " \
+                                    "This function will get the buffers without copy, " \
+                                    "instead of the render callbacks." )
+
+#define T_AUDIO_FRAME_CALLBACK N_( "Audio frame callback" )
+#define LT_AUDIO_FRAME_CALLBACK N_( "Address of the audio frame callback function. " \
+                                    "This function will get the buffers without copy, " \
+                                    "instead of the render callbacks." )
+
 #define T_VIDEO_DATA N_( "Video Callback data" )
 #define LT_VIDEO_DATA N_( "Data for the video callback function." )
 
@@ -106,6 +123,10 @@ vlc_module_begin ()
         change_volatile()
     add_string( SOUT_PREFIX_AUDIO "postrender-callback", "0", T_AUDIO_POSTRENDER_CALLBACK, LT_AUDIO_POSTRENDER_CALLBACK, true )
         change_volatile()
+    add_string( SOUT_PREFIX_VIDEO "frame-callback", "0", T_VIDEO_FRAME_CALLBACK, LT_VIDEO_FRAME_CALLBACK, true )
+        change_volatile()
+    add_string( SOUT_PREFIX_AUDIO "frame-callback", "0", T_AUDIO_FRAME_CALLBACK, LT_AUDIO_FRAME_CALLBACK, true )
+        change_volatile()
     add_string( SOUT_PREFIX_VIDEO "data", "0", T_VIDEO_DATA, LT_VIDEO_DATA, true )
         change_volatile()
     add_string( SOUT_PREFIX_AUDIO "data", "0", T_AUDIO_DATA, LT_VIDEO_DATA, true )
@@ -121,7 +142,8 @@ vlc_module_end ()
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
     "video-prerender-callback", "audio-prerender-callback",
-    "video-postrender-callback", "audio-postrender-callback", "video-data", "audio-data", "time-sync", NULL
+    "video-postrender-callback", "audio-postrender-callback",
+    "video-frame-callback", "audio-frame-callback", "video-data", "audio-data", "time-sync", NULL
 };
 
 static sout_stream_id_t *Add ( sout_stream_t *, es_format_t * );
@@ -149,6 +171,8 @@ struct sout_stream_sys_t
     void ( *pf_audio_prerender_callback ) ( void* p_audio_data, uint8_t** pp_pcm_buffer , unsigned int size );
     void ( *pf_video_postrender_callback ) ( void* p_video_data, uint8_t* p_pixel_buffer, int width, int height, int pixel_pitch, int size, mtime_t pts );
     void ( *pf_audio_postrender_callback ) ( void* p_audio_data, uint8_t* p_pcm_buffer, unsigned int channels, unsigned int rate, unsigned int nb_samples, unsigned int bits_per_sample, unsigned int size, mtime_t pts );
+    void ( *pf_video_frame_callback ) ( void* p_video_data, void* p_frame, uint8_t* const* pp_planes, const unsigned* pitches, const unsigned* lines, int width, int height, mtime_t pts, void ( *pf_release ) ( void* p_frame ) );
+    void ( *pf_audio_frame_callback ) ( void* p_audio_data, void* p_frame, uint8_t* p_pcm_buffer, unsigned int channels, unsigned int rate, unsigned int nb_samples, unsigned int bits_per_sample, unsigned int size, mtime_t pts, void ( *pf_release ) ( void* p_frame ) );
     bool time_sync;
 };
 
@@ -187,6 +211,14 @@ static int Open( vlc_object_t *p_this )
     p_sys->pf_audio_postrender_callback = (void (*) (void*, uint8_t*, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, mtime_t))(intptr_t)atoll( psz_tmp );
     free( psz_tmp );
 
+    psz_tmp = var_GetString( p_stream, SOUT_PREFIX_VIDEO "frame-callback" );
+    p_sys->pf_video_frame_callback = (void (*) (void*, void*, uint8_t* const*, const unsigned*, const unsigned*, int, int, mtime_t, void (*) (void*)))(intptr_t)atoll( psz_tmp );
+    free( psz_tmp );
+
+    psz_tmp = var_GetString( p_stream, SOUT_PREFIX_AUDIO "frame-callback" );
+    p_sys->pf_audio_frame_callback = (void (*) (void*, void*, uint8_t*, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, mtime_t, void (*) (void*)))(intptr_t)atoll( psz_tmp );
+    free( psz_tmp );
+
     /* Setting stream out module callbacks */
     p_stream->pf_add    = Add;
     p_stream->pf_del    = Del;
@@ -337,6 +369,55 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_t *id,
     return VLC_SUCCESS;
 }
 
+/* Given to the application with the frames */
+static void ReleaseFrame( void *p_frame )
+{
+    block_Release( (block_t *)p_frame );
+}
+
+/* Locates the planes of a raw video buffer, one after the other */
+static void VideoPlanes( const es_format_t *p_fmt, block_t *p_buffer,
+                         uint8_t **pp_planes, unsigned *pi_pitches,
+                         unsigned *pi_lines )
+{
+    const vlc_chroma_description_t *p_dsc =
+        vlc_fourcc_GetChromaDescription( p_fmt->i_codec );
+    const unsigned i_width = p_fmt->video.i_width;
+    const unsigned i_height = p_fmt->video.i_height;
+    uint8_t *p = p_buffer->p_buffer;
+    size_t i_size = 0;
+
+    for( unsigned i = 0; i < 4; i++ )
+    {
+        pp_planes[i] = NULL;
+        pi_pitches[i] = pi_lines[i] = 0;
+    }
+
+    if( p_dsc != NULL )
+    {
+        for( unsigned i = 0; i < p_dsc->plane_count; i++ )
+        {
+            pi_pitches[i] = i_width * p_dsc->p[i].w.num / p_dsc->p[i].w.den
+                          * p_dsc->pixel_size;
+            pi_lines[i] = i_height * p_dsc->p[i].h.num / p_dsc->p[i].h.den;
+            pp_planes[i] = p + i_size;
+            i_size += pi_pitches[i] * pi_lines[i];
+        }
+    }
+    if( p_dsc == NULL || i_size > p_buffer->i_buffer )
+    {   /* Unknown layout: a single plane */
+        for( unsigned i = 1; i < 4; i++ )
+        {
+            pp_planes[i] = NULL;
+            pi_pitches[i] = pi_lines[i] = 0;
+        }
+        pp_planes[0] = p;
+        pi_lines[0] = i_height;
+        pi_pitches[0] = i_height > 0 ? p_buffer->i_buffer / i_height
+                                     : p_buffer->i_buffer;
+    }
+}
+
 static int SendVideo( sout_stream_t *p_stream, sout_stream_id_t *id,
                       block_t *p_buffer )
 {
@@ -355,6 +436,27 @@ static int SendVideo( sout_stream_t *p_stream, sout_stream_id_t *id,
     {
         i_size = p_buffer->i_buffer;
     }
+
+    if( p_sys->pf_video_frame_callback != NULL )
+    {
+        /* Handing the buffers over, one at a time */
+        while( p_buffer != NULL )
+        {
+            block_t *p_next = p_buffer->p_next;
+            uint8_t *pp_planes[4];
+            unsigned pi_pitches[4], pi_lines[4];
+
+            p_buffer->p_next = NULL;
+            VideoPlanes( id->format, p_buffer, pp_planes, pi_pitches, pi_lines );
+            p_sys->pf_video_frame_callback( id->p_data, p_buffer, pp_planes,
+                                            pi_pitches, pi_lines,
+                                            id->format->video.i_width, id->format->video.i_height,
+                                            p_buffer->i_pts, ReleaseFrame );
+            p_buffer = p_next;
+        }
+        return VLC_SUCCESS;
+    }
+
     /* Calling the prerender callback to get user buffer */
     p_sys->pf_video_prerender_callback( id->p_data, &p_pixels , i_size );
 
@@ -400,6 +502,26 @@ static int SendAudio( sout_stream_t *p_stream, sout_stream_id_t *id,
     }
 
     i_samples = i_size / ( ( id->format->audio.i_bitspersample / 8 ) * id->format->audio.i_channels );
+
+    if( p_sys->pf_audio_frame_callback != NULL )
+    {
+        /* Handing the buffers over, one at a time */
+        while( p_buffer != NULL )
+        {
+            block_t *p_next = p_buffer->p_next;
+
+            p_buffer->p_next = NULL;
+            i_size = p_buffer->i_buffer;
+            i_samples = i_size / ( ( id->format->audio.i_bitspersample / 8 ) * id->format->audio.i_channels );
+            p_sys->pf_audio_frame_callback( id->p_data, p_buffer, p_buffer->p_buffer,
+                                            id->format->audio.i_channels, id->format->audio.i_rate, i_samples,
+                                            id->format->audio.i_bitspersample, i_size, p_buffer->i_pts,
+                                            ReleaseFrame );
+            p_buffer = p_next;
+        }
+        return VLC_SUCCESS;
+    }
+
     /* Calling the prerender callback to get user buffer */
     p_sys->pf_audio_prerender_callback( id->p_data, &p_pcm_buffer, i_size );
     if (!p_pcm_buffer)
@@ -1,5 +1,5 @@
 /*****************************************************************************
- * copy.c: Fast YV12/NV12 copy
+ * copy.c: Fast YV12/NV12 copy and chroma (de)interleaving
  *****************************************************************************
  * Copyright (C) 2010 Laurent Aimar
  * $Id$
@@ -396,5 +396,343 @@ void CopyFromYv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
      CopyPlane(dst->p[1].p_pixels, dst->p[1].i_pitch,
                src[1], src_pitch[1], width / 2, height / 2);
      CopyPlane(dst->p[2].p_pixels, dst->p[2].i_pitch,
-               src[1], src_pitch[2], width / 2, height / 2);
+               src[2], src_pitch[2], width / 2, height / 2);
+}
+
+/*****************************************************************************
+ * Chroma planes (de)interleaving, for pictures in regular memory
+ *****************************************************************************/
+static void MergePlanes(uint8_t *dst, size_t dst_pitch,
+                        const uint8_t *srcu, size_t srcu_pitch,
+                        const uint8_t *srcv, size_t srcv_pitch,
+                        unsigned width, unsigned height)
+{
+    for (unsigned y = 0; y < height; y++) {
+        for (unsigned x = 0; x < width; x++) {
+            dst[2*x+0] = srcu[x];
+            dst[2*x+1] = srcv[x];
+        }
+        srcu += srcu_pitch;
+        srcv += srcv_pitch;
+        dst  += dst_pitch;
+    }
+}
+
+#ifdef CAN_COMPILE_SSE2
+VLC_SSE2
+static void SSE2_SplitUV(uint8_t *dstu, size_t dstu_pitch,
+                         uint8_t *dstv, size_t dstv_pitch,
+                         const uint8_t *src, size_t src_pitch,
+                         unsigned width, unsigned height)
+{
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x;
+
+        for (x = 0; x < (width & ~31); x += 32) {
+            asm volatile (
+                "pcmpeqw  %%xmm7, %%xmm7\n"
+                "psrlw    $8,     %%xmm7\n"
+                "movdqu   0(%[src]), %%xmm0\n"
+                "movdqu  16(%[src]), %%xmm1\n"
+                "movdqu  32(%[src]), %%xmm2\n"
+                "movdqu  48(%[src]), %%xmm3\n"
+                "movdqa   %%xmm0, %%xmm4\n"
+                "movdqa   %%xmm1, %%xmm5\n"
+                "pand     %%xmm7, %%xmm4\n"
+                "pand     %%xmm7, %%xmm5\n"
+                "packuswb %%xmm5, %%xmm4\n"
+                "psrlw    $8,     %%xmm0\n"
+                "psrlw    $8,     %%xmm1\n"
+                "packuswb %%xmm1, %%xmm0\n"
+                "movdqa   %%xmm2, %%xmm5\n"
+                "movdqa   %%xmm3, %%xmm6\n"
+                "pand     %%xmm7, %%xmm5\n"
+                "pand     %%xmm7, %%xmm6\n"
+                "packuswb %%xmm6, %%xmm5\n"
+                "psrlw    $8,     %%xmm2\n"
+                "psrlw    $8,     %%xmm3\n"
+                "packuswb %%xmm3, %%xmm2\n"
+                "movdqu   %%xmm4,  0(%[dstu])\n"
+                "movdqu   %%xmm5, 16(%[dstu])\n"
+                "movdqu   %%xmm0,  0(%[dstv])\n"
+                "movdqu   %%xmm2, 16(%[dstv])\n"
+                : : [dstu]"r"(&dstu[x]), [dstv]"r"(&dstv[x]), [src]"r"(&src[2*x])
+                : "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7");
+        }
+        for (; x < width; x++) {
+            dstu[x] = src[2*x+0];
+            dstv[x] = src[2*x+1];
+        }
+        src  += src_pitch;
+        dstu += dstu_pitch;
+        dstv += dstv_pitch;
+    }
+}
+
+VLC_SSE2
+static void SSE2_MergeUV(uint8_t *dst, size_t dst_pitch,
+                         const uint8_t *srcu, size_t srcu_pitch,
+                         const uint8_t *srcv, size_t srcv_pitch,
+                         unsigned width, unsigned height)
+{
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x;
+
+        for (x = 0; x < (width & ~31); x += 32) {
+            asm volatile (
+                "movdqu    0(%[srcu]), %%xmm0\n"
+                "movdqu   16(%[srcu]), %%xmm1\n"
+                "movdqu    0(%[srcv]), %%xmm2\n"
+                "movdqu   16(%[srcv]), %%xmm3\n"
+                "movdqa    %%xmm0, %%xmm4\n"
+                "movdqa    %%xmm1, %%xmm5\n"
+                "punpcklbw %%xmm2, %%xmm0\n"
+                "punpckhbw %%xmm2, %%xmm4\n"
+                "punpcklbw %%xmm3, %%xmm1\n"
+                "punpckhbw %%xmm3, %%xmm5\n"
+                "movdqu    %%xmm0,  0(%[dst])\n"
+                "movdqu    %%xmm4, 16(%[dst])\n"
+                "movdqu    %%xmm1, 32(%[dst])\n"
+                "movdqu    %%xmm5, 48(%[dst])\n"
+                : : [dst]"r"(&dst[2*x]), [srcu]"r"(&srcu[x]), [srcv]"r"(&srcv[x])
+                : "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5");
+        }
+        for (; x < width; x++) {
+            dst[2*x+0] = srcu[x];
+            dst[2*x+1] = srcv[x];
+        }
+        srcu += srcu_pitch;
+        srcv += srcv_pitch;
+        dst  += dst_pitch;
+    }
+}
+#endif /* CAN_COMPILE_SSE2 */
+
+#ifdef CAN_COMPILE_SSSE3
+VLC_SSE
+static void SSSE3_SplitUV(uint8_t *dstu, size_t dstu_pitch,
+                          uint8_t *dstv, size_t dstv_pitch,
+                          const uint8_t *src, size_t src_pitch,
+                          unsigned width, unsigned height)
+{
+    static const uint8_t shuffle[16] = { 0, 2, 4, 6, 8, 10, 12, 14,
+                                         1, 3, 5, 7, 9, 11, 13, 15 };
+
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x;
+
+        for (x = 0; x < (width & ~31); x += 32) {
+            asm volatile (
+                "movdqu     (%[shuffle]), %%xmm7\n"
+                "movdqu    0(%[src]), %%xmm0\n"
+                "movdqu   16(%[src]), %%xmm1\n"
+                "movdqu   32(%[src]), %%xmm2\n"
+                "movdqu   48(%[src]), %%xmm3\n"
+                "pshufb     %%xmm7, %%xmm0\n"
+                "pshufb     %%xmm7, %%xmm1\n"
+                "pshufb     %%xmm7, %%xmm2\n"
+                "pshufb     %%xmm7, %%xmm3\n"
+                "movdqa     %%xmm0, %%xmm4\n"
+                "punpcklqdq %%xmm1, %%xmm4\n"
+                "punpckhqdq %%xmm1, %%xmm0\n"
+                "movdqa     %%xmm2, %%xmm5\n"
+                "punpcklqdq %%xmm3, %%xmm5\n"
+                "punpckhqdq %%xmm3, %%xmm2\n"
+                "movdqu     %%xmm4,  0(%[dstu])\n"
+                "movdqu     %%xmm5, 16(%[dstu])\n"
+                "movdqu     %%xmm0,  0(%[dstv])\n"
+                "movdqu     %%xmm2, 16(%[dstv])\n"
+                : : [dstu]"r"(&dstu[x]), [dstv]"r"(&dstv[x]), [src]"r"(&src[2*x]),
+                    [shuffle]"r"(shuffle)
+                : "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm7");
+        }
+        for (; x < width; x++) {
+            dstu[x] = src[2*x+0];
+            dstv[x] = src[2*x+1];
+        }
+        src  += src_pitch;
+        dstu += dstu_pitch;
+        dstv += dstv_pitch;
+    }
+}
+#endif /* CAN_COMPILE_SSSE3 */
+
+#ifdef CAN_COMPILE_AVX2
+/* The AVX2 byte shuffles and unpacks work within 128-bits lanes: the
+ * quadwords are put back in order with vpermq/vperm2i128. */
+VLC_AVX2
+static void AVX2_SplitUV(uint8_t *dstu, size_t dstu_pitch,
+                         uint8_t *dstv, size_t dstv_pitch,
+                         const uint8_t *src, size_t src_pitch,
+                         unsigned width, unsigned height)
+{
+    static const uint8_t shuffle[16] = { 0, 2, 4, 6, 8, 10, 12, 14,
+                                         1, 3, 5, 7, 9, 11, 13, 15 };
+
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x;
+
+        for (x = 0; x < (width & ~63); x += 64) {
+            asm volatile (
+                "vbroadcasti128   (%[shuffle]), %%ymm7\n"
+                "vmovdqu     0(%[src]), %%ymm0\n"
+                "vmovdqu    32(%[src]), %%ymm1\n"
+                "vmovdqu    64(%[src]), %%ymm2\n"
+                "vmovdqu    96(%[src]), %%ymm3\n"
+                "vpshufb    %%ymm7, %%ymm0, %%ymm0\n"
+                "vpshufb    %%ymm7, %%ymm1, %%ymm1\n"
+                "vpshufb    %%ymm7, %%ymm2, %%ymm2\n"
+                "vpshufb    %%ymm7, %%ymm3, %%ymm3\n"
+                "vpermq     $0xd8, %%ymm0, %%ymm0\n"
+                "vpermq     $0xd8, %%ymm1, %%ymm1\n"
+                "vpermq     $0xd8, %%ymm2, %%ymm2\n"
+                "vpermq     $0xd8, %%ymm3, %%ymm3\n"
+                "vperm2i128 $0x20, %%ymm1, %%ymm0, %%ymm4\n"
+                "vperm2i128 $0x31, %%ymm1, %%ymm0, %%ymm5\n"
+                "vperm2i128 $0x20, %%ymm3, %%ymm2, %%ymm6\n"
+                "vperm2i128 $0x31, %%ymm3, %%ymm2, %%ymm7\n"
+                "vmovdqu    %%ymm4,  0(%[dstu])\n"
+                "vmovdqu    %%ymm6, 32(%[dstu])\n"
+                "vmovdqu    %%ymm5,  0(%[dstv])\n"
+                "vmovdqu    %%ymm7, 32(%[dstv])\n"
+                : : [dstu]"r"(&dstu[x]), [dstv]"r"(&dstv[x]), [src]"r"(&src[2*x]),
+                    [shuffle]"r"(shuffle)
+                : "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7");
+        }
+        for (; x < width; x++) {
+            dstu[x] = src[2*x+0];
+            dstv[x] = src[2*x+1];
+        }
+        src  += src_pitch;
+        dstu += dstu_pitch;
+        dstv += dstv_pitch;
+    }
+    asm volatile ("vzeroupper");
+}
+
+VLC_AVX2
+static void AVX2_MergeUV(uint8_t *dst, size_t dst_pitch,
+                         const uint8_t *srcu, size_t srcu_pitch,
+                         const uint8_t *srcv, size_t srcv_pitch,
+                         unsigned width, unsigned height)
+{
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x;
+
+        for (x = 0; x < (width & ~63); x += 64) {
+            asm volatile (
+                "vmovdqu     0(%[srcu]), %%ymm0\n"
+                "vmovdqu    32(%[srcu]), %%ymm1\n"
+                "vmovdqu     0(%[srcv]), %%ymm2\n"
+                "vmovdqu    32(%[srcv]), %%ymm3\n"
+                "vpunpcklbw %%ymm2, %%ymm0, %%ymm4\n"
+                "vpunpckhbw %%ymm2, %%ymm0, %%ymm5\n"
+                "vpunpcklbw %%ymm3, %%ymm1, %%ymm6\n"
+                "vpunpckhbw %%ymm3, %%ymm1, %%ymm7\n"
+                "vperm2i128 $0x20, %%ymm5, %%ymm4, %%ymm0\n"
+                "vperm2i128 $0x31, %%ymm5, %%ymm4, %%ymm1\n"
+                "vperm2i128 $0x20, %%ymm7, %%ymm6, %%ymm2\n"
+                "vperm2i128 $0x31, %%ymm7, %%ymm6, %%ymm3\n"
+                "vmovdqu    %%ymm0,  0(%[dst])\n"
+                "vmovdqu    %%ymm1, 32(%[dst])\n"
+                "vmovdqu    %%ymm2, 64(%[dst])\n"
+                "vmovdqu    %%ymm3, 96(%[dst])\n"
+                : : [dst]"r"(&dst[2*x]), [srcu]"r"(&srcu[x]), [srcv]"r"(&srcv[x])
+                : "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7");
+        }
+        for (; x < width; x++) {
+            dst[2*x+0] = srcu[x];
+            dst[2*x+1] = srcv[x];
+        }
+        srcu += srcu_pitch;
+        srcv += srcv_pitch;
+        dst  += dst_pitch;
+    }
+    asm volatile ("vzeroupper");
+}
+#endif /* CAN_COMPILE_AVX2 */
+
+typedef void (*split_uv_t)(uint8_t *, size_t, uint8_t *, size_t,
+                           const uint8_t *, size_t, unsigned, unsigned);
+
+static split_uv_t GetSplitUV(void)
+{
+    unsigned cpu = vlc_CPU();
+
+#ifdef CAN_COMPILE_AVX2
+    if (cpu & CPU_CAPABILITY_AVX2)
+        return AVX2_SplitUV;
+#endif
+#ifdef CAN_COMPILE_SSSE3
+    if (cpu & CPU_CAPABILITY_SSSE3)
+        return SSSE3_SplitUV;
+#endif
+#ifdef CAN_COMPILE_SSE2
+    if (cpu & CPU_CAPABILITY_SSE2)
+        return SSE2_SplitUV;
+#endif
+    (void) cpu;
+    return SplitPlanes;
+}
+
+void CopySplitUV(uint8_t *dstu, size_t dstu_pitch,
+                 uint8_t *dstv, size_t dstv_pitch,
+                 const uint8_t *src, size_t src_pitch,
+                 unsigned width, unsigned height)
+{
+    GetSplitUV()(dstu, dstu_pitch, dstv, dstv_pitch,
+                 src, src_pitch, width, height);
+}
+
+/* A packed 4:2:2 line is split in two passes of the semi-planar kernel:
+ * luma and interleaved chroma, then U and V. The chroma goes through a
+ * small buffer, one part of the line at a time, so it stays in cache. */
+void CopyFromPacked422(uint8_t *dst[3], size_t dst_pitch[3],
+                       const uint8_t *src, size_t src_pitch,
+                       unsigned width, unsigned height,
+                       unsigned vsub, bool luma_first)
+{
+    split_uv_t split = GetSplitUV();
+    uint8_t chroma[1024];
+
+    assert(!(width & 1));
+    for (unsigned y = 0; y < height; y++) {
+        uint8_t *dsty = dst[0] + y * dst_pitch[0];
+        uint8_t *dstu = dst[1] + y / vsub * dst_pitch[1];
+        uint8_t *dstv = dst[2] + y / vsub * dst_pitch[2];
+
+        for (unsigned x = 0; x < width; x += sizeof(chroma)) {
+            unsigned n = __MIN(width - x, sizeof(chroma));
+
+            if (luma_first)
+                split(&dsty[x], 0, chroma, 0, &src[2*x], 0, n, 1);
+            else
+                split(chroma, 0, &dsty[x], 0, &src[2*x], 0, n, 1);
+            if (y % vsub == 0)
+                split(&dstu[x/2], 0, &dstv[x/2], 0, chroma, 0, n / 2, 1);
+        }
+        src += src_pitch;
+    }
+}
+
+void CopyMergeUV(uint8_t *dst, size_t dst_pitch,
+                 const uint8_t *srcu, size_t srcu_pitch,
+                 const uint8_t *srcv, size_t srcv_pitch,
+                 unsigned width, unsigned height)
+{
+    unsigned cpu = vlc_CPU();
+
+#ifdef CAN_COMPILE_AVX2
+    if (cpu & CPU_CAPABILITY_AVX2)
+        return AVX2_MergeUV(dst, dst_pitch, srcu, srcu_pitch,
+                            srcv, srcv_pitch, width, height);
+#endif
+#ifdef CAN_COMPILE_SSE2
+    if (cpu & CPU_CAPABILITY_SSE2)
+        return SSE2_MergeUV(dst, dst_pitch, srcu, srcu_pitch,
+                            srcv, srcv_pitch, width, height);
+#endif
+    (void) cpu;
+    MergePlanes(dst, dst_pitch, srcu, srcu_pitch, srcv, srcv_pitch,
+                width, height);
 }
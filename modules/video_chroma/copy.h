@@ -1,5 +1,5 @@
 /*****************************************************************************
- * copy.h: Fast YV12/NV12 copy
+ * copy.h: Fast YV12/NV12 copy and chroma (de)interleaving
  *****************************************************************************
  * Copyright (C) 2009 Laurent Aimar
  * $Id$
@@ -21,8 +21,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
  *****************************************************************************/
 
-#ifndef _VLC_AVCODEC_COPY_H
-#define _VLC_AVCODEC_COPY_H 1
+#ifndef _VLC_VIDEOCHROMA_COPY_H
+#define _VLC_VIDEOCHROMA_COPY_H 1
 
 typedef struct {
 # ifdef CAN_COMPILE_SSE2
@@ -41,5 +41,24 @@ void CopyFromYv12(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
                   unsigned width, unsigned height,
                   copy_cache_t *cache);
 
+/* Deinterleaves a semi-planar chroma plane (as in NV12) into two planes,
+ * width being the number of chroma samples per line. */
+void CopySplitUV(uint8_t *dstu, size_t dstu_pitch,
+                 uint8_t *dstv, size_t dstv_pitch,
+                 const uint8_t *src, size_t src_pitch,
+                 unsigned width, unsigned height);
+/* Interleaves two chroma planes into a semi-planar one. */
+void CopyMergeUV(uint8_t *dst, size_t dst_pitch,
+                 const uint8_t *srcu, size_t srcu_pitch,
+                 const uint8_t *srcv, size_t srcv_pitch,
+                 unsigned width, unsigned height);
+/* Splits a packed 4:2:2 picture (YUYV or UYVY, YVYU and VYUY with the
+ * chroma planes swapped) into planes, keeping the chroma of one line out of
+ * vsub: 1 for 4:2:2, 2 for 4:2:0. width is in pixels, and even. */
+void CopyFromPacked422(uint8_t *dst[3], size_t dst_pitch[3],
+                       const uint8_t *src, size_t src_pitch,
+                       unsigned width, unsigned height,
+                       unsigned vsub, bool luma_first);
+
 #endif
 
@@ -0,0 +1,185 @@
+/*****************************************************************************
+ * i420_nv12.c : Semi-planar to planar YUV 4:2:0 conversions and back
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_filter.h>
+
+#include "copy.h"
+
+/*****************************************************************************
+ * Local and extern prototypes.
+ *****************************************************************************/
+static int  Activate ( vlc_object_t * );
+
+static void NV12_I420( filter_t *, picture_t *, picture_t * );
+static void NV12_YV12( filter_t *, picture_t *, picture_t * );
+static void I420_NV12( filter_t *, picture_t *, picture_t * );
+static void YV12_NV12( filter_t *, picture_t *, picture_t * );
+static picture_t *NV12_I420_Filter( filter_t *, picture_t * );
+static picture_t *NV12_YV12_Filter( filter_t *, picture_t * );
+static picture_t *I420_NV12_Filter( filter_t *, picture_t * );
+static picture_t *YV12_NV12_Filter( filter_t *, picture_t * );
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+vlc_module_begin ()
+    set_description( N_("Conversions between NV12 and I420/YV12") )
+    set_capability( "video filter2", 160 )
+    set_callbacks( Activate, NULL )
+vlc_module_end ()
+
+/*****************************************************************************
+ * Activate: allocate a chroma function
+ *****************************************************************************
+ * This function allocates and initializes a chroma function
+ *****************************************************************************/
+static int Activate( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+
+    if( p_filter->fmt_in.video.i_width & 1
+     || p_filter->fmt_in.video.i_height & 1 )
+    {
+        return -1;
+    }
+
+    if( p_filter->fmt_in.video.i_width != p_filter->fmt_out.video.i_width
+     || p_filter->fmt_in.video.i_height != p_filter->fmt_out.video.i_height )
+        return -1;
+
+    switch( p_filter->fmt_in.video.i_chroma )
+    {
+        case VLC_CODEC_NV12:
+            switch( p_filter->fmt_out.video.i_chroma )
+            {
+                case VLC_CODEC_I420:
+                case VLC_CODEC_J420:
+                    p_filter->pf_video_filter = NV12_I420_Filter;
+                    break;
+
+                case VLC_CODEC_YV12:
+                    p_filter->pf_video_filter = NV12_YV12_Filter;
+                    break;
+
+                default:
+                    return -1;
+            }
+            break;
+
+        case VLC_CODEC_I420:
+        case VLC_CODEC_J420:
+            if( p_filter->fmt_out.video.i_chroma != VLC_CODEC_NV12 )
+                return -1;
+            p_filter->pf_video_filter = I420_NV12_Filter;
+            break;
+
+        case VLC_CODEC_YV12:
+            if( p_filter->fmt_out.video.i_chroma != VLC_CODEC_NV12 )
+                return -1;
+            p_filter->pf_video_filter = YV12_NV12_Filter;
+            break;
+
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+/* Following functions are local */
+VIDEO_FILTER_WRAPPER( NV12_I420 )
+VIDEO_FILTER_WRAPPER( NV12_YV12 )
+VIDEO_FILTER_WRAPPER( I420_NV12 )
+VIDEO_FILTER_WRAPPER( YV12_NV12 )
+
+/*****************************************************************************
+ * NV12_I420: semi-planar Y:UV to planar Y:U:V
+ *****************************************************************************/
+static void NV12_I420( filter_t *p_filter, picture_t *p_source,
+                                           picture_t *p_dest )
+{
+    const unsigned i_width = p_filter->fmt_in.video.i_width;
+    const unsigned i_height = p_filter->fmt_in.video.i_height;
+
+    plane_CopyPixels( &p_dest->p[Y_PLANE], &p_source->p[Y_PLANE] );
+    CopySplitUV( p_dest->U_PIXELS, p_dest->p[U_PLANE].i_pitch,
+                 p_dest->V_PIXELS, p_dest->p[V_PLANE].i_pitch,
+                 p_source->p[1].p_pixels, p_source->p[1].i_pitch,
+                 i_width / 2, i_height / 2 );
+}
+
+/*****************************************************************************
+ * NV12_YV12: semi-planar Y:UV to planar Y:V:U
+ *****************************************************************************/
+static void NV12_YV12( filter_t *p_filter, picture_t *p_source,
+                                           picture_t *p_dest )
+{
+    const unsigned i_width = p_filter->fmt_in.video.i_width;
+    const unsigned i_height = p_filter->fmt_in.video.i_height;
+
+    plane_CopyPixels( &p_dest->p[Y_PLANE], &p_source->p[Y_PLANE] );
+    /* U and V are swapped */
+    CopySplitUV( p_dest->V_PIXELS, p_dest->p[V_PLANE].i_pitch,
+                 p_dest->U_PIXELS, p_dest->p[U_PLANE].i_pitch,
+                 p_source->p[1].p_pixels, p_source->p[1].i_pitch,
+                 i_width / 2, i_height / 2 );
+}
+
+/*****************************************************************************
+ * I420_NV12: planar Y:U:V to semi-planar Y:UV
+ *****************************************************************************/
+static void I420_NV12( filter_t *p_filter, picture_t *p_source,
+                                           picture_t *p_dest )
+{
+    const unsigned i_width = p_filter->fmt_in.video.i_width;
+    const unsigned i_height = p_filter->fmt_in.video.i_height;
+
+    plane_CopyPixels( &p_dest->p[Y_PLANE], &p_source->p[Y_PLANE] );
+    CopyMergeUV( p_dest->p[1].p_pixels, p_dest->p[1].i_pitch,
+                 p_source->U_PIXELS, p_source->p[U_PLANE].i_pitch,
+                 p_source->V_PIXELS, p_source->p[V_PLANE].i_pitch,
+                 i_width / 2, i_height / 2 );
+}
+
+/*****************************************************************************
+ * YV12_NV12: planar Y:V:U to semi-planar Y:UV
+ *****************************************************************************/
+static void YV12_NV12( filter_t *p_filter, picture_t *p_source,
+                                           picture_t *p_dest )
+{
+    const unsigned i_width = p_filter->fmt_in.video.i_width;
+    const unsigned i_height = p_filter->fmt_in.video.i_height;
+
+    plane_CopyPixels( &p_dest->p[Y_PLANE], &p_source->p[Y_PLANE] );
+    /* U and V are swapped */
+    CopyMergeUV( p_dest->p[1].p_pixels, p_dest->p[1].i_pitch,
+                 p_source->V_PIXELS, p_source->p[V_PLANE].i_pitch,
+                 p_source->U_PIXELS, p_source->p[U_PLANE].i_pitch,
+                 i_width / 2, i_height / 2 );
+}
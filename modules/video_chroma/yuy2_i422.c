@@ -33,6 +33,8 @@
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 
+#include "copy.h"
+
 #define SRC_FOURCC "YUY2,YUNV,YVYU,UYVY,UYNV,Y422,cyuv"
 #define DEST_FOURCC  "I422"
 
@@ -118,135 +120,41 @@ VIDEO_FILTER_WRAPPER( UYVY_I422 )
 VIDEO_FILTER_WRAPPER( cyuv_I422 )
 
 /*****************************************************************************
- * YUY2_I422: packed YUY2 4:2:2 to planar YUV 4:2:2
+ * Unpack: packed YUY2, YVYU or UYVY 4:2:2 to planar YUV 4:2:2
  *****************************************************************************/
+static void Unpack( filter_t *p_filter, picture_t *p_source,
+                    picture_t *p_dest, bool b_swap_uv, bool b_luma_first )
+{
+    const int i_u = b_swap_uv ? V_PLANE : U_PLANE;
+    const int i_v = b_swap_uv ? U_PLANE : V_PLANE;
+    uint8_t *pp_dst[3] = { p_dest->Y_PIXELS, p_dest->p[i_u].p_pixels,
+                           p_dest->p[i_v].p_pixels };
+    size_t pi_dst_pitch[3] = { p_dest->p[Y_PLANE].i_pitch,
+                               p_dest->p[i_u].i_pitch,
+                               p_dest->p[i_v].i_pitch };
+
+    CopyFromPacked422( pp_dst, pi_dst_pitch,
+                       p_source->p->p_pixels, p_source->p->i_pitch,
+                       p_filter->fmt_out.video.i_width,
+                       p_filter->fmt_out.video.i_height, 1, b_luma_first );
+}
+
 static void YUY2_I422( filter_t *p_filter, picture_t *p_source,
                                            picture_t *p_dest )
 {
-    uint8_t *p_line = p_source->p->p_pixels;
-
-    uint8_t *p_y = p_dest->Y_PIXELS;
-    uint8_t *p_u = p_dest->U_PIXELS;
-    uint8_t *p_v = p_dest->V_PIXELS;
-
-    int i_x, i_y;
-
-    const int i_dest_margin = p_dest->p[0].i_pitch
-                                 - p_dest->p[0].i_visible_pitch;
-    const int i_dest_margin_c = p_dest->p[1].i_pitch
-                                 - p_dest->p[1].i_visible_pitch;
-    const int i_source_margin = p_source->p->i_pitch
-                               - p_source->p->i_visible_pitch;
-
-    for( i_y = p_filter->fmt_out.video.i_height ; i_y-- ; )
-    {
-        for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
-        {
-#define C_YUYV_YUV422( p_line, p_y, p_u, p_v )      \
-            *p_y++ = *p_line++; *p_u++ = *p_line++; \
-            *p_y++ = *p_line++; *p_v++ = *p_line++
-            C_YUYV_YUV422( p_line, p_y, p_u, p_v );
-            C_YUYV_YUV422( p_line, p_y, p_u, p_v );
-            C_YUYV_YUV422( p_line, p_y, p_u, p_v );
-            C_YUYV_YUV422( p_line, p_y, p_u, p_v );
-        }
-        for( i_x = ( p_filter->fmt_out.video.i_width % 8 ) / 2; i_x-- ; )
-        {
-            C_YUYV_YUV422( p_line, p_y, p_u, p_v );
-        }
-        p_line += i_source_margin;
-        p_y += i_dest_margin;
-        p_u += i_dest_margin_c;
-        p_v += i_dest_margin_c;
-    }
+    Unpack( p_filter, p_source, p_dest, false, true );
 }
 
-/*****************************************************************************
- * YVYU_I422: packed YVYU 4:2:2 to planar YUV 4:2:2
- *****************************************************************************/
 static void YVYU_I422( filter_t *p_filter, picture_t *p_source,
                                            picture_t *p_dest )
 {
-    uint8_t *p_line = p_source->p->p_pixels;
-
-    uint8_t *p_y = p_dest->Y_PIXELS;
-    uint8_t *p_u = p_dest->U_PIXELS;
-    uint8_t *p_v = p_dest->V_PIXELS;
-
-    int i_x, i_y;
-
-    const int i_dest_margin = p_dest->p[0].i_pitch
-                                 - p_dest->p[0].i_visible_pitch;
-    const int i_dest_margin_c = p_dest->p[1].i_pitch
-                                 - p_dest->p[1].i_visible_pitch;
-    const int i_source_margin = p_source->p->i_pitch
-                               - p_source->p->i_visible_pitch;
-
-    for( i_y = p_filter->fmt_out.video.i_height ; i_y-- ; )
-    {
-        for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
-        {
-#define C_YVYU_YUV422( p_line, p_y, p_u, p_v )      \
-            *p_y++ = *p_line++; *p_v++ = *p_line++; \
-            *p_y++ = *p_line++; *p_u++ = *p_line++
-            C_YVYU_YUV422( p_line, p_y, p_u, p_v );
-            C_YVYU_YUV422( p_line, p_y, p_u, p_v );
-            C_YVYU_YUV422( p_line, p_y, p_u, p_v );
-            C_YVYU_YUV422( p_line, p_y, p_u, p_v );
-        }
-        for( i_x = ( p_filter->fmt_out.video.i_width % 8 ) / 2; i_x-- ; )
-        {
-            C_YVYU_YUV422( p_line, p_y, p_u, p_v );
-        }
-        p_line += i_source_margin;
-        p_y += i_dest_margin;
-        p_u += i_dest_margin_c;
-        p_v += i_dest_margin_c;
-    }
+    Unpack( p_filter, p_source, p_dest, true, true );
 }
 
-/*****************************************************************************
- * UYVY_I422: packed UYVY 4:2:2 to planar YUV 4:2:2
- *****************************************************************************/
 static void UYVY_I422( filter_t *p_filter, picture_t *p_source,
                                            picture_t *p_dest )
 {
-    uint8_t *p_line = p_source->p->p_pixels;
-
-    uint8_t *p_y = p_dest->Y_PIXELS;
-    uint8_t *p_u = p_dest->U_PIXELS;
-    uint8_t *p_v = p_dest->V_PIXELS;
-
-    int i_x, i_y;
-
-    const int i_dest_margin = p_dest->p[0].i_pitch
-                                 - p_dest->p[0].i_visible_pitch;
-    const int i_dest_margin_c = p_dest->p[1].i_pitch
-                                 - p_dest->p[1].i_visible_pitch;
-    const int i_source_margin = p_source->p->i_pitch
-                               - p_source->p->i_visible_pitch;
-
-    for( i_y = p_filter->fmt_out.video.i_height ; i_y-- ; )
-    {
-        for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
-        {
-#define C_UYVY_YUV422( p_line, p_y, p_u, p_v )      \
-            *p_u++ = *p_line++; *p_y++ = *p_line++; \
-            *p_v++ = *p_line++; *p_y++ = *p_line++
-            C_UYVY_YUV422( p_line, p_y, p_u, p_v );
-            C_UYVY_YUV422( p_line, p_y, p_u, p_v );
-            C_UYVY_YUV422( p_line, p_y, p_u, p_v );
-            C_UYVY_YUV422( p_line, p_y, p_u, p_v );
-        }
-        for( i_x = ( p_filter->fmt_out.video.i_width % 8 ) / 2; i_x-- ; )
-        {
-            C_UYVY_YUV422( p_line, p_y, p_u, p_v );
-        }
-        p_line += i_source_margin;
-        p_y += i_dest_margin;
-        p_u += i_dest_margin_c;
-        p_v += i_dest_margin_c;
-    }
+    Unpack( p_filter, p_source, p_dest, false, false );
 }
 
 /*****************************************************************************
@@ -35,6 +35,7 @@
 #include <vlc_plugin.h>
 #include <vlc_vout_display.h>
 #include <vlc_picture_pool.h>
+#include <vlc_vmem.h>
 
 /*****************************************************************************
  * Module descriptor
@@ -82,8 +83,14 @@ vlc_module_end()
  * Local prototypes
  *****************************************************************************/
 struct picture_sys_t {
+    struct libvlc_video_frame_t frame; /* must come first */
     vout_display_sys_t *sys;
     void *id;
+
+    /* Frames handed to the application */
+    picture_t *picture;
+    unsigned   held;
+    bool       orphan; /* the pool is gone, delete once released */
 };
 
 /* NOTE: the callback prototypes must match those of LibVLC */
@@ -96,9 +103,21 @@ struct vout_display_sys_t {
     void (*unlock)(void *sys, void *id, void *const *plane);
     void (*display)(void *sys, void *id);
     void (*cleanup)(void *sys);
+    void (*frame)(void *sys, struct libvlc_video_frame_t *frame,
+                  void *const *plane,
+                  const unsigned *pitches, const unsigned *lines,
+                  int64_t date);
 
     unsigned pitches[PICTURE_PLANE_MAX];
     unsigned lines[PICTURE_PLANE_MAX];
+
+    /* The frames held by the application keep this alive */
+    vlc_mutex_t lock_frames;
+    unsigned    refs;
+
+    /* Last frame handed, not to hand it again on refresh */
+    picture_sys_t *last;
+    mtime_t        last_date;
 };
 
 typedef unsigned (*vlc_format_cb)(void **, char *, unsigned *, unsigned *,
@@ -111,6 +130,10 @@ static int            Control(vout_display_t *, int, va_list);
 static int            Lock(picture_t *);
 static void           Unlock(picture_t *);
 
+static int            FrameLock(picture_t *);
+static void           FrameRelease(struct libvlc_video_frame_t *);
+static void           FrameDestroy(picture_t *);
+
 /*****************************************************************************
  * Open: allocates video thread
  *****************************************************************************
@@ -126,8 +149,9 @@ static int Open(vlc_object_t *object)
     /* Get the callbacks */
     vlc_format_cb setup = var_InheritAddress(vd, "vmem-setup");
 
+    sys->frame = var_InheritAddress(vd, "vmem-frame");
     sys->lock = var_InheritAddress(vd, "vmem-lock");
-    if (sys->lock == NULL) {
+    if (sys->lock == NULL && sys->frame == NULL) {
         msg_Err(vd, "missing lock callback");
         free(sys);
         return VLC_EGENERIC;
@@ -151,13 +175,16 @@ static int Open(vlc_object_t *object)
 
         sys->count = setup(&sys->opaque, chroma, &fmt.i_width, &fmt.i_height,
                            sys->pitches, sys->lines);
-        if (sys->count == 0) {
+        if (sys->count == 0 && sys->frame == NULL) {
             msg_Err(vd, "video format setup failure (no pictures)");
             free(sys);
             return VLC_EGENERIC;
         }
         fmt.i_chroma = vlc_fourcc_GetCodecFromString(VIDEO_ES, chroma);
 
+    } else if (sys->frame != NULL) {
+        /* Frames are handed as decoded, without conversion */
+        sys->count = 0;
     } else {
         char *chroma = var_InheritString(vd, "vmem-chroma");
         fmt.i_chroma = vlc_fourcc_GetCodecFromString(VIDEO_ES, chroma);
@@ -183,7 +210,8 @@ static int Open(vlc_object_t *object)
     }
 
     /* Define the bitmasks */
-    switch (fmt.i_chroma)
+    switch ((sys->frame == NULL || fmt.i_chroma != vd->fmt.i_chroma)
+            ? fmt.i_chroma : 0)
     {
     case VLC_CODEC_RGB15:
         fmt.i_rmask = 0x001f;
@@ -208,9 +236,22 @@ static int Open(vlc_object_t *object)
         break;
     }
 
+    vlc_mutex_init(&sys->lock_frames);
+    sys->refs = 1;
+    sys->last = NULL;
+    sys->last_date = VLC_TS_INVALID;
+
     /* */
     vout_display_info_t info = vd->info;
     info.has_hide_mouse = true;
+    if (sys->frame != NULL) {
+        /* Take the subpictures, so that they are not blended into a copy
+         * of the frames, and drop them */
+        static const vlc_fourcc_t subpicture_chromas[] = {
+            VLC_CODEC_RGBA, 0
+        };
+        info.subpicture_chromas = subpicture_chromas;
+    }
 
     /* */
     vd->sys     = sys;
@@ -236,7 +277,57 @@ static void Close(vlc_object_t *object)
     if (sys->cleanup)
         sys->cleanup(sys->opaque);
     picture_pool_Delete(sys->pool);
-    free(sys);
+
+    vlc_mutex_lock(&sys->lock_frames);
+    bool last = --sys->refs == 0;
+    vlc_mutex_unlock(&sys->lock_frames);
+    if (last) {
+        vlc_mutex_destroy(&sys->lock_frames);
+        free(sys);
+    }
+}
+
+/* Allocates the pictures that the decoder renders into and that are then
+ * handed to the application: the pool only gets them back once released. */
+static picture_pool_t *PoolFrames(vout_display_t *vd, unsigned count)
+{
+    vout_display_sys_t *sys = vd->sys;
+    picture_t *pictures[count];
+
+    for (unsigned i = 0; i < count; i++) {
+        picture_sys_t *picsys = malloc(sizeof(*picsys));
+        picture_t *picture = NULL;
+
+        if (likely(picsys != NULL))
+            picture = picture_NewFromFormat(&vd->fmt);
+        if (unlikely(picture == NULL)) {
+            free(picsys);
+            count = i;
+            break;
+        }
+
+        picsys->frame.release = FrameRelease;
+        picsys->sys     = sys;
+        picsys->id      = NULL;
+        picsys->picture = picture;
+        picsys->held    = 0;
+        picsys->orphan  = false;
+        picture->p_sys      = picsys;
+        picture->pf_release = FrameDestroy;
+        pictures[i] = picture;
+    }
+
+    picture_pool_configuration_t pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.picture_count = count;
+    pool.picture       = pictures;
+    pool.lock          = FrameLock;
+    sys->pool = picture_pool_NewExtended(&pool);
+    if (!sys->pool) {
+        for (unsigned i = 0; i < count; i++)
+            picture_Release(pictures[i]);
+    }
+    return sys->pool;
 }
 
 /* */
@@ -247,6 +338,9 @@ static picture_pool_t *Pool(vout_display_t *vd, unsigned count)
     if (sys->pool)
         return sys->pool;
 
+    if (sys->frame != NULL)
+        return PoolFrames(vd, count + sys->count);
+
     if (count > sys->count)
         count = sys->count;
 
@@ -261,6 +355,7 @@ static picture_pool_t *Pool(vout_display_t *vd, unsigned count)
             break;
         }
 
+        rsc.p_sys->frame.release = NULL;
         rsc.p_sys->sys = sys;
         rsc.p_sys->id = NULL;
 
@@ -299,6 +394,42 @@ static void Display(vout_display_t *vd, picture_t *picture, subpicture_t *subpic
 {
     vout_display_sys_t *sys = vd->sys;
 
+    if (sys->frame != NULL) {
+        picture_sys_t *picsys = picture->p_sys;
+        void *planes[PICTURE_PLANE_MAX];
+
+        /* The video output shows the last picture again periodically */
+        if (picsys == sys->last && picture->date == sys->last_date) {
+            picture_Release(picture);
+            if (subpicture != NULL)
+                subpicture_Delete(subpicture);
+            return;
+        }
+        sys->last = picsys;
+        sys->last_date = picture->date;
+
+        unsigned pitches[PICTURE_PLANE_MAX], lines[PICTURE_PLANE_MAX];
+
+        for (int i = 0; i < PICTURE_PLANE_MAX; i++) {
+            bool used = i < picture->i_planes;
+
+            planes[i]  = used ? picture->p[i].p_pixels : NULL;
+            pitches[i] = used ? picture->p[i].i_pitch : 0;
+            lines[i]   = used ? picture->p[i].i_lines : 0;
+        }
+
+        vlc_mutex_lock(&sys->lock_frames);
+        picsys->held++;
+        sys->refs++;
+        vlc_mutex_unlock(&sys->lock_frames);
+        sys->frame(sys->opaque, &picsys->frame, planes, pitches, lines,
+                   picture->date);
+        picture_Release(picture);
+        if (subpicture != NULL)
+            subpicture_Delete(subpicture);
+        return;
+    }
+
     assert(!picture_IsReferenced(picture));
     if (sys->display != NULL)
         sys->display(sys->opaque, picture->p_sys->id);
@@ -352,3 +483,53 @@ static void Unlock(picture_t *picture)
     if (sys->unlock != NULL)
         sys->unlock(sys->opaque, picsys->id, planes);
 }
+
+/* Pictures held by the application are not available to the decoder */
+static int FrameLock(picture_t *picture)
+{
+    picture_sys_t *picsys = picture->p_sys;
+    vout_display_sys_t *sys = picsys->sys;
+
+    vlc_mutex_lock(&sys->lock_frames);
+    bool held = picsys->held > 0;
+    vlc_mutex_unlock(&sys->lock_frames);
+    return held ? VLC_EGENERIC : VLC_SUCCESS;
+}
+
+/* Called by the application, from any thread */
+static void FrameRelease(struct libvlc_video_frame_t *frame)
+{
+    picture_sys_t *picsys = (picture_sys_t *)frame;
+    vout_display_sys_t *sys = picsys->sys;
+
+    vlc_mutex_lock(&sys->lock_frames);
+    assert(picsys->held > 0);
+    bool orphan = --picsys->held == 0 && picsys->orphan;
+    bool last = --sys->refs == 0;
+    vlc_mutex_unlock(&sys->lock_frames);
+
+    if (orphan)
+        picture_Delete(picsys->picture);
+    if (last) {
+        vlc_mutex_destroy(&sys->lock_frames);
+        free(sys);
+    }
+}
+
+/* Called when the pool is deleted */
+static void FrameDestroy(picture_t *picture)
+{
+    picture_sys_t *picsys = picture->p_sys;
+    vout_display_sys_t *sys = picsys->sys;
+
+    if (--picture->i_refcount > 0)
+        return;
+
+    vlc_mutex_lock(&sys->lock_frames);
+    picsys->orphan = picsys->held > 0;
+    bool orphan = picsys->orphan;
+    vlc_mutex_unlock(&sys->lock_frames);
+
+    if (!orphan)
+        picture_Delete(picture);
+}
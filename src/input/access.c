@@ -46,6 +46,17 @@ static char *get_path(const char *location)
     return path;
 }
 
+typedef struct
+{
+    access_t    access;
+    vlc_mutex_t lock;
+} access_priv_t;
+
+static inline access_priv_t *access_priv( access_t *p_access )
+{
+    return (access_priv_t *)p_access;
+}
+
 #undef access_New
 /*****************************************************************************
  * access_New:
@@ -54,12 +65,15 @@ access_t *access_New( vlc_object_t *p_obj, input_thread_t *p_parent_input,
                       const char *psz_access, const char *psz_demux,
                       const char *psz_location )
 {
-    access_t *p_access = vlc_custom_create( p_obj, sizeof (*p_access),
-                                            "access" );
+    access_priv_t *p_priv = vlc_custom_create( p_obj, sizeof (*p_priv),
+                                               "access" );
 
-    if( p_access == NULL )
+    if( p_priv == NULL )
         return NULL;
 
+    access_t *p_access = &p_priv->access;
+    vlc_mutex_init( &p_priv->lock );
+
     /* */
 
     p_access->p_input = p_parent_input;
@@ -95,6 +109,7 @@ error:
     free( p_access->psz_location );
     free( p_access->psz_filepath );
     free( p_access->psz_demux );
+    vlc_mutex_destroy( &p_priv->lock );
     vlc_object_release( p_access );
     return NULL;
 }
@@ -111,9 +126,32 @@ void access_Delete( access_t *p_access )
     free( p_access->psz_filepath );
     free( p_access->psz_demux );
 
+    vlc_mutex_destroy( &access_priv( p_access )->lock );
     vlc_object_release( p_access );
 }
 
+/*****************************************************************************
+ * access_Lock/access_Unlock:
+ *****************************************************************************
+ * The stream prefetcher reads from the access in its own thread. Any other
+ * call into the access (seek, control) must be made with this lock held.
+ *****************************************************************************/
+void access_Lock( access_t *p_access )
+{
+    vlc_mutex_lock( &access_priv( p_access )->lock );
+}
+
+/* Returns 0 if the lock was taken */
+int access_TryLock( access_t *p_access )
+{
+    return vlc_mutex_trylock( &access_priv( p_access )->lock );
+}
+
+void access_Unlock( access_t *p_access )
+{
+    vlc_mutex_unlock( &access_priv( p_access )->lock );
+}
+
 
 /*****************************************************************************
  * access_GetParentInput:
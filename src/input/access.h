@@ -34,5 +34,13 @@ access_t *access_New( vlc_object_t *p_obj, input_thread_t *p_input,
 #define access_New( a, b, c, d, e ) access_New(VLC_OBJECT(a), b, c, d, e )
 void access_Delete( access_t * );
 
+/**
+ * Serializes the calls into an access between the input thread and the
+ * stream prefetch thread.
+ */
+void access_Lock( access_t * );
+int  access_TryLock( access_t * );
+void access_Unlock( access_t * );
+
 #endif
 
@@ -78,7 +78,7 @@ int input_vaControl( input_thread_t *p_input, int i_query, va_list args )
     {
         case INPUT_GET_POSITION:
             pf = (double*)va_arg( args, double * );
-            *pf = var_GetFloat( p_input, "position" );
+            *pf = var_HandleGetFloat( p_input->p->var.position );
             return VLC_SUCCESS;
 
         case INPUT_SET_POSITION:
@@ -87,12 +87,12 @@ int input_vaControl( input_thread_t *p_input, int i_query, va_list args )
 
         case INPUT_GET_LENGTH:
             pi_64 = (int64_t*)va_arg( args, int64_t * );
-            *pi_64 = var_GetTime( p_input, "length" );
+            *pi_64 = var_HandleGetTime( p_input->p->var.length );
             return VLC_SUCCESS;
 
         case INPUT_GET_TIME:
             pi_64 = (int64_t*)va_arg( args, int64_t * );
-            *pi_64 = var_GetTime( p_input, "time" );
+            *pi_64 = var_HandleGetTime( p_input->p->var.time );
             return VLC_SUCCESS;
 
         case INPUT_SET_TIME:
@@ -101,7 +101,8 @@ int input_vaControl( input_thread_t *p_input, int i_query, va_list args )
 
         case INPUT_GET_RATE:
             pi_int = (int*)va_arg( args, int * );
-            *pi_int = INPUT_RATE_DEFAULT / var_GetFloat( p_input, "rate" );
+            *pi_int = INPUT_RATE_DEFAULT /
+                      var_HandleGetFloat( p_input->p->var.rate );
             return VLC_SUCCESS;
 
         case INPUT_SET_RATE:
@@ -111,7 +112,7 @@ int input_vaControl( input_thread_t *p_input, int i_query, va_list args )
 
         case INPUT_GET_STATE:
             pi_int = (int*)va_arg( args, int * );
-            *pi_int = var_GetInteger( p_input, "state" );
+            *pi_int = var_HandleGetInteger( p_input->p->var.state );
             return VLC_SUCCESS;
 
         case INPUT_SET_STATE:
@@ -120,12 +121,12 @@ int input_vaControl( input_thread_t *p_input, int i_query, va_list args )
 
         case INPUT_GET_AUDIO_DELAY:
             pi_64 = (int64_t*)va_arg( args, int64_t * );
-            *pi_64 = var_GetTime( p_input, "audio-delay" );
+            *pi_64 = var_HandleGetTime( p_input->p->var.audio_delay );
             return VLC_SUCCESS;
 
         case INPUT_GET_SPU_DELAY:
             pi_64 = (int64_t*)va_arg( args, int64_t * );
-            *pi_64 = var_GetTime( p_input, "spu-delay" );
+            *pi_64 = var_HandleGetTime( p_input->p->var.spu_delay );
             return VLC_SUCCESS;
 
         case INPUT_SET_AUDIO_DELAY:
@@ -59,6 +59,10 @@ static decoder_t *CreateDecoder( vlc_object_t *, input_thread_t *,
 static void       DeleteDecoder( decoder_t * );
 
 static void      *DecoderThread( void * );
+static void       DecoderHandle( decoder_t *, block_t * );
+#ifdef ENABLE_SOUT
+static void       DecoderSendSout( decoder_t * );
+#endif
 static void       DecoderProcess( decoder_t *, block_t * );
 static void       DecoderError( decoder_t *p_dec, block_t *p_block );
 static void       DecoderOutputChangePause( decoder_t *, bool b_paused, mtime_t i_date );
@@ -96,6 +100,8 @@ struct decoder_owner_sys_t
     sout_packetizer_input_t *p_sout_input;
 
     vlc_thread_t     thread;
+    /* Remux: no thread, the input packetizes and sends the blocks itself */
+    bool             b_direct;
 
     /* Some decoders require already packetized data (ie. not truncated) */
     decoder_t *p_packetizer;
@@ -169,6 +175,9 @@ struct decoder_owner_sys_t
 
     /* Delay */
     mtime_t i_ts_delay;
+
+    /* Entry date of the block being decoded, when tracing */
+    mtime_t i_trace_date;
 };
 
 #define DECODER_MAX_BUFFERING_COUNT (4)
@@ -290,6 +299,18 @@ static decoder_t *decoder_New( vlc_object_t *p_parent, input_thread_t *p_input,
     p_dec->p_owner->p_clock = p_clock;
     assert( p_dec->fmt_out.i_cat != UNKNOWN_ES );
 
+#ifdef ENABLE_SOUT
+    /* Stream copy only: no need for a thread per elementary stream */
+    if( p_sout != NULL && p_input != NULL && p_clock != NULL &&
+        var_InheritBool( p_dec, "sout-remux-direct" ) &&
+        sout_IsRemux( p_sout ) )
+    {
+        msg_Dbg( p_dec, "remuxing from the input thread" );
+        p_dec->p_owner->b_direct = true;
+        return p_dec;
+    }
+#endif
+
     if( p_dec->fmt_out.i_cat == AUDIO_ES )
         i_priority = VLC_THREAD_PRIORITY_AUDIO;
     else
@@ -344,7 +365,8 @@ void input_DecoderDelete( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    vlc_cancel( p_owner->thread );
+    if( !p_owner->b_direct )
+        vlc_cancel( p_owner->thread );
 
     /* Make sure we aren't paused/buffering/waiting/decoding anymore */
     vlc_mutex_lock( &p_owner->lock );
@@ -356,7 +378,8 @@ void input_DecoderDelete( decoder_t *p_dec )
     vlc_cond_signal( &p_owner->wait_request );
     vlc_mutex_unlock( &p_owner->lock );
 
-    vlc_join( p_owner->thread, NULL );
+    if( !p_owner->b_direct )
+        vlc_join( p_owner->thread, NULL );
     p_owner->b_paused = b_was_paused;
 
     module_unneed( p_dec, p_dec->p_module );
@@ -384,6 +407,14 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
+    if( p_owner->b_direct )
+    {
+        if( vlc_trace_Enabled( p_dec ) )
+            p_block->i_trace_date = mdate();
+        DecoderHandle( p_dec, p_block );
+        return;
+    }
+
     if( b_do_pace )
     {
         /* The fifo is not consummed when buffering and so will
@@ -406,6 +437,8 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
         block_FifoEmpty( p_owner->p_fifo );
     }
 
+    if( vlc_trace_Enabled( p_dec ) )
+        p_block->i_trace_date = mdate();
     block_FifoPut( p_owner->p_fifo, p_block );
 }
 
@@ -584,6 +617,12 @@ void input_DecoderStopBuffering( decoder_t *p_dec )
     vlc_cond_signal( &p_owner->wait_request );
 
     vlc_mutex_unlock( &p_owner->lock );
+
+#ifdef ENABLE_SOUT
+    /* Nobody else would send what was buffered */
+    if( p_owner->b_direct )
+        DecoderSendSout( p_dec );
+#endif
 }
 
 void input_DecoderWaitBuffering( decoder_t *p_dec )
@@ -592,7 +631,9 @@ void input_DecoderWaitBuffering( decoder_t *p_dec )
 
     vlc_mutex_lock( &p_owner->lock );
 
-    while( p_owner->b_buffering && !p_owner->buffer.b_full )
+    /* The input itself has already processed all its blocks */
+    while( !p_owner->b_direct &&
+           p_owner->b_buffering && !p_owner->buffer.b_full )
     {
         block_FifoWake( p_owner->p_fifo );
         vlc_cond_wait( &p_owner->wait_acknowledge, &p_owner->lock );
@@ -771,6 +812,7 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
         return NULL;
     }
     p_owner->i_preroll_end = VLC_TS_INVALID;
+    p_owner->i_trace_date = VLC_TS_INVALID;
     p_owner->i_last_rate = INPUT_RATE_DEFAULT;
     p_owner->p_input = p_input;
     p_owner->p_resource = p_resource;
@@ -783,6 +825,7 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     p_owner->p_sout_input = NULL;
     p_owner->p_packetizer = NULL;
     p_owner->b_packetizer = b_packetizer;
+    p_owner->b_direct = false;
 
     /* decoder fifo */
     p_owner->p_fifo = block_FifoNew();
@@ -879,6 +922,7 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     p_owner->buffer.p_subpic = NULL;
     p_owner->buffer.p_audio = NULL;
     p_owner->buffer.p_block = NULL;
+    p_owner->buffer.pp_block_next = &p_owner->buffer.p_block;
 
     p_owner->b_flushing = false;
 
@@ -923,26 +967,62 @@ static void *DecoderThread( void *p_data )
         if( p_block )
         {
             int canc = vlc_savecancel();
-
-            if( !p_dec->b_need_eos && (p_block->i_flags & BLOCK_FLAG_END_OF_STREAM) )
-            {
-                /* calling DecoderProcess() with NULL block will make
-                 * decoders/packetizers flush their buffers */
-                block_Release( p_block );
-                p_block = NULL;
-            }
-
-            if( p_dec->b_error )
-                DecoderError( p_dec, p_block );
-            else
-                DecoderProcess( p_dec, p_block );
-
+            DecoderHandle( p_dec, p_block );
             vlc_restorecancel( canc );
         }
     }
     return NULL;
 }
 
+/**
+ * Processes one block, out of the fifo or directly from the input
+ */
+static void DecoderHandle( decoder_t *p_dec, block_t *p_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    input_thread_t *p_input = p_owner->p_input;
+    const bool b_stats = p_input != NULL
+                      && p_input->p->counters.p_decoder_time != NULL;
+    const bool b_trace = vlc_trace_Enabled( p_dec );
+    mtime_t i_start = VLC_TS_INVALID;
+
+    if( b_stats )
+        stats_MetricRecord( p_input->p->counters.p_decoder_queue,
+                            block_FifoCount( p_owner->p_fifo ) );
+    if( b_stats || b_trace )
+        i_start = mdate();
+    if( b_trace )
+    {
+        vlc_trace_Span( p_dec, VLC_TRACE_DECODER_QUEUE,
+                        p_block->i_trace_date, i_start );
+        p_owner->i_trace_date = p_block->i_trace_date;
+    }
+
+    if( !p_dec->b_need_eos && (p_block->i_flags & BLOCK_FLAG_END_OF_STREAM) )
+    {
+        /* calling DecoderProcess() with NULL block will make
+         * decoders/packetizers flush their buffers */
+        block_Release( p_block );
+        p_block = NULL;
+    }
+
+    if( p_dec->b_error )
+        DecoderError( p_dec, p_block );
+    else
+        DecoderProcess( p_dec, p_block );
+
+    if( i_start != VLC_TS_INVALID )
+    {
+        const mtime_t i_end = mdate();
+
+        if( b_stats )
+            stats_MetricRecord( p_input->p->counters.p_decoder_time,
+                                i_end - i_start );
+        if( b_trace )
+            vlc_trace_Span( p_dec, VLC_TRACE_DECODE, i_start, i_end );
+    }
+}
+
 static block_t *DecoderBlockFlushNew()
 {
     block_t *p_null = block_Alloc( 128 );
@@ -974,6 +1054,14 @@ static void DecoderFlush( decoder_t *p_dec )
     block_t *p_null = DecoderBlockFlushNew();
     if( !p_null )
         return;
+    if( p_owner->b_direct )
+    {
+        /* Processed right away, acknowledged on the way */
+        vlc_mutex_unlock( &p_owner->lock );
+        DecoderHandle( p_dec, p_null );
+        vlc_mutex_lock( &p_owner->lock );
+        return;
+    }
     input_DecoderDecode( p_dec, p_null, false );
 
     /* */
@@ -1253,9 +1341,22 @@ static void DecoderPlayAudio( decoder_t *p_dec, aout_buffer_t *p_audio,
 
         if( !b_reject )
         {
+            const mtime_t i_trace_date = p_audio->i_trace_date;
+            const mtime_t i_start = i_trace_date > VLC_TS_INVALID
+                                  ? mdate() : VLC_TS_INVALID;
+
             if( !aout_DecPlay( p_aout, p_audio, i_rate ) )
                 *pi_played_sum += 1;
             *pi_lost_sum += aout_DecGetResetLost( p_aout );
+
+            if( i_start != VLC_TS_INVALID )
+            {
+                const mtime_t i_end = mdate();
+
+                vlc_trace_Span( p_dec, VLC_TRACE_AUDIO_PLAY, i_start, i_end );
+                vlc_trace_Span( p_dec, VLC_TRACE_AUDIO_LATENCY,
+                                i_trace_date, i_end );
+            }
         }
         else
         {
@@ -1301,6 +1402,7 @@ static void DecoderDecodeAudio( decoder_t *p_dec, block_t *p_block )
             break;
         }
         i_decoded++;
+        p_aout_buf->i_trace_date = p_owner->i_trace_date;
 
         if( p_owner->i_preroll_end > VLC_TS_INVALID &&
             p_aout_buf->i_pts < p_owner->i_preroll_end )
@@ -1326,16 +1428,9 @@ static void DecoderDecodeAudio( decoder_t *p_dec, block_t *p_block )
 
     if( p_input != NULL && (i_decoded > 0 || i_lost > 0 || i_played > 0) )
     {
-        vlc_mutex_lock( &p_input->p->counters.counters_lock);
-
-        stats_UpdateInteger( p_dec, p_input->p->counters.p_lost_abuffers,
-                             i_lost, NULL );
-        stats_UpdateInteger( p_dec, p_input->p->counters.p_played_abuffers,
-                             i_played, NULL );
-        stats_UpdateInteger( p_dec, p_input->p->counters.p_decoded_audio,
-                             i_decoded, NULL );
-
-        vlc_mutex_unlock( &p_input->p->counters.counters_lock);
+        stats_MetricAdd( p_input->p->counters.p_lost_abuffers, i_lost );
+        stats_MetricAdd( p_input->p->counters.p_played_abuffers, i_played );
+        stats_MetricAdd( p_input->p->counters.p_decoded_audio, i_decoded );
     }
 }
 static void DecoderGetCc( decoder_t *p_dec, decoder_t *p_dec_cc )
@@ -1527,6 +1622,7 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
         }
 
         i_decoded++;
+        p_pic->trace_date = p_owner->i_trace_date;
 
         if( p_owner->i_preroll_end > VLC_TS_INVALID && p_pic->date < p_owner->i_preroll_end )
         {
@@ -1555,17 +1651,10 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
 
     if( p_input != NULL && (i_decoded > 0 || i_lost > 0 || i_displayed > 0) )
     {
-        vlc_mutex_lock( &p_input->p->counters.counters_lock );
-
-        stats_UpdateInteger( p_dec, p_input->p->counters.p_decoded_video,
-                             i_decoded, NULL );
-        stats_UpdateInteger( p_dec, p_input->p->counters.p_lost_pictures,
-                             i_lost , NULL);
-
-        stats_UpdateInteger( p_dec, p_input->p->counters.p_displayed_pictures,
-                             i_displayed, NULL);
-
-        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+        stats_MetricAdd( p_input->p->counters.p_decoded_video, i_decoded );
+        stats_MetricAdd( p_input->p->counters.p_lost_pictures, i_lost );
+        stats_MetricAdd( p_input->p->counters.p_displayed_pictures,
+                         i_displayed );
     }
 }
 
@@ -1828,6 +1917,20 @@ static void DecoderProcessSout( decoder_t *p_dec, block_t *p_block )
             }
         }
 
+        if( p_owner->b_direct )
+        {
+            /* Queued as a whole, sent once the packetizer is done */
+            vlc_mutex_lock( &p_owner->lock );
+            for( block_t *p = p_sout_block; p != NULL; p = p->p_next )
+                p_owner->buffer.i_count++;
+            block_ChainLastAppend( &p_owner->buffer.pp_block_next,
+                                   p_sout_block );
+            if( p_owner->b_buffering )
+                p_owner->buffer.b_full = true;
+            vlc_mutex_unlock( &p_owner->lock );
+            continue;
+        }
+
         while( p_sout_block )
         {
             block_t *p_next = p_sout_block->p_next;
@@ -1839,6 +1942,49 @@ static void DecoderProcessSout( decoder_t *p_dec, block_t *p_block )
             p_sout_block = p_next;
         }
     }
+
+    if( p_owner->b_direct )
+        DecoderSendSout( p_dec );
+}
+
+/**
+ * Sends the queued blocks of a remuxing decoder, unless buffering.
+ * It never waits: the input thread is the caller.
+ */
+static void DecoderSendSout( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    const bool b_telx = p_dec->fmt_in.i_codec == VLC_CODEC_TELETEXT;
+
+    vlc_mutex_lock( &p_owner->lock );
+    if( p_owner->b_buffering || p_owner->buffer.p_block == NULL )
+    {
+        vlc_mutex_unlock( &p_owner->lock );
+        return;
+    }
+
+    block_t *p_chain = p_owner->buffer.p_block;
+    const bool b_reject = p_owner->b_flushing;
+
+    p_owner->buffer.p_block = NULL;
+    p_owner->buffer.pp_block_next = &p_owner->buffer.p_block;
+    p_owner->buffer.i_count = 0;
+    for( block_t *p = p_chain; p != NULL; p = p->p_next )
+        DecoderFixTs( p_dec, &p->i_dts, &p->i_pts, &p->i_length, NULL,
+                      INT64_MAX, b_telx );
+    vlc_mutex_unlock( &p_owner->lock );
+
+    while( p_chain != NULL )
+    {
+        block_t *p_next = p_chain->p_next;
+
+        p_chain->p_next = NULL;
+        if( !b_reject )
+            sout_InputSendBuffer( p_owner->p_sout_input, p_chain );
+        else
+            block_Release( p_chain );
+        p_chain = p_next;
+    }
 }
 #endif
 
@@ -1962,12 +2108,7 @@ static void DecoderProcessSpu( decoder_t *p_dec, block_t *p_block, bool b_flush
     while( (p_spu = p_dec->pf_decode_sub( p_dec, p_block ? &p_block : NULL ) ) )
     {
         if( p_input != NULL )
-        {
-            vlc_mutex_lock( &p_input->p->counters.counters_lock );
-            stats_UpdateInteger( p_dec, p_input->p->counters.p_decoded_sub, 1,
-                                 NULL );
-            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
-        }
+            stats_MetricAdd( p_input->p->counters.p_decoded_sub, 1 );
 
         p_vout = input_resource_HoldVout( p_owner->p_resource );
         if( p_vout && p_owner->p_spu_vout == p_vout )
@@ -54,6 +54,7 @@
 #include <vlc_fs.h>
 #include <vlc_strings.h>
 #include <vlc_modules.h>
+#include <vlc_atomic.h>
 
 #ifdef HAVE_SYS_STAT_H
 #   include <sys/stat.h>
@@ -79,8 +80,8 @@ static void       ControlRelease( int i_type, vlc_value_t val );
 static bool       ControlIsSeekRequest( int i_type );
 static bool       Control( input_thread_t *, int, vlc_value_t );
 
-static int  UpdateTitleSeekpointFromAccess( input_thread_t * );
-static void UpdateGenericFromAccess( input_thread_t * );
+static int  UpdateTitleSeekpointFromAccess( input_thread_t *, int, int, int );
+static void UpdateGenericFromAccess( input_thread_t *, int );
 
 static int  UpdateTitleSeekpointFromDemux( input_thread_t * );
 static void UpdateGenericFromDemux( input_thread_t * );
@@ -489,7 +490,12 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
 
     /* */
     memset( &p_input->p->counters, 0, sizeof( p_input->p->counters ) );
-    vlc_mutex_init( &p_input->p->counters.counters_lock );
+    /* Labels the metrics, as the same item can be played more than once at
+     * a time */
+    static vlc_atomic_t count = VLC_ATOMIC_INIT(0);
+    snprintf( p_input->p->counters.psz_id,
+              sizeof( p_input->p->counters.psz_id ), "%u",
+              (unsigned)vlc_atomic_inc( &count ) );
 
     p_input->p->p_es_out_display = input_EsOutNew( p_input, p_input->p->i_rate );
     p_input->p->p_es_out = NULL;
@@ -524,7 +530,14 @@ static void Destructor( input_thread_t * p_input )
 
     vlc_gc_decref( p_input->p->p_item );
 
-    vlc_mutex_destroy( &p_input->p->counters.counters_lock );
+    var_HandleRelease( p_input->p->var.state );
+    var_HandleRelease( p_input->p->var.rate );
+    var_HandleRelease( p_input->p->var.position );
+    var_HandleRelease( p_input->p->var.time );
+    var_HandleRelease( p_input->p->var.length );
+    var_HandleRelease( p_input->p->var.audio_delay );
+    var_HandleRelease( p_input->p->var.spu_delay );
+
 
     for( int i = 0; i < p_input->p->i_control; i++ )
     {
@@ -587,6 +600,13 @@ static void MainLoopDemux( input_thread_t *p_input, bool *pb_changed, bool *pb_d
     if( ( p_input->p->i_stop > 0 && p_input->p->i_time >= p_input->p->i_stop ) ||
         ( p_input->p->i_run > 0 && i_start_mdate+p_input->p->i_run < mdate() ) )
         i_ret = 0; /* EOF */
+    else if( vlc_trace_Enabled( p_input ) )
+    {
+        mtime_t i_start = mdate();
+
+        i_ret = demux_Demux( p_input->p->input.p_demux );
+        vlc_trace_Span( p_input, VLC_TRACE_DEMUX, i_start, mdate() );
+    }
     else
         i_ret = demux_Demux( p_input->p->input.p_demux );
 
@@ -601,15 +621,33 @@ static void MainLoopDemux( input_thread_t *p_input, bool *pb_changed, bool *pb_d
             }
             UpdateGenericFromDemux( p_input );
         }
-        else if( p_input->p->input.p_access &&
-                 p_input->p->input.p_access->info.i_update )
+        else if( p_input->p->input.p_access )
         {
-            if( !p_input->p->input.b_title_demux )
+            access_t *p_access = p_input->p->input.p_access;
+            int i_update = 0, i_title = 0, i_seekpoint = 0;
+
+            /* The stream prefetcher updates the access with its lock held.
+             * If it is busy reading, the updates are taken next time. */
+            if( !access_TryLock( p_access ) )
             {
-                i_ret = UpdateTitleSeekpointFromAccess( p_input );
-                *pb_changed = true;
+                i_update = p_access->info.i_update;
+                i_title = p_access->info.i_title;
+                i_seekpoint = p_access->info.i_seekpoint;
+                p_access->info.i_update = 0;
+                access_Unlock( p_access );
+            }
+
+            if( i_update )
+            {
+                if( !p_input->p->input.b_title_demux )
+                {
+                    i_ret = UpdateTitleSeekpointFromAccess( p_input, i_update,
+                                                            i_title,
+                                                            i_seekpoint );
+                    *pb_changed = true;
+                }
+                UpdateGenericFromAccess( p_input, i_update );
             }
-            UpdateGenericFromAccess( p_input );
         }
     }
 
@@ -861,35 +899,59 @@ static void InitStatistics( input_thread_t * p_input )
 {
     if( p_input->b_preparsing ) return;
 
-    /* Prepare statistics */
-#define INIT_COUNTER( c, type, compute ) p_input->p->counters.p_##c = \
- stats_CounterCreate( p_input, VLC_VAR_##type, STATS_##compute);
+    /* Prepare statistics, labelled after the item and the input */
+#define INIT_COUNTER( c, type, name ) p_input->p->counters.p_##c = \
+ stats_MetricNew( p_input, STATS_METRIC_##type, name, "input", psz_name, \
+                  "id", p_input->p->counters.psz_id, NULL );
     if( libvlc_stats( p_input ) )
     {
-        INIT_COUNTER( read_bytes, INTEGER, COUNTER );
-        INIT_COUNTER( read_packets, INTEGER, COUNTER );
-        INIT_COUNTER( demux_read, INTEGER, COUNTER );
-        INIT_COUNTER( input_bitrate, FLOAT, DERIVATIVE );
-        INIT_COUNTER( demux_bitrate, FLOAT, DERIVATIVE );
-        INIT_COUNTER( demux_corrupted, INTEGER, COUNTER );
-        INIT_COUNTER( demux_discontinuity, INTEGER, COUNTER );
-        INIT_COUNTER( played_abuffers, INTEGER, COUNTER );
-        INIT_COUNTER( lost_abuffers, INTEGER, COUNTER );
-        INIT_COUNTER( displayed_pictures, INTEGER, COUNTER );
-        INIT_COUNTER( lost_pictures, INTEGER, COUNTER );
-        INIT_COUNTER( decoded_audio, INTEGER, COUNTER );
-        INIT_COUNTER( decoded_video, INTEGER, COUNTER );
-        INIT_COUNTER( decoded_sub, INTEGER, COUNTER );
-        p_input->p->counters.p_sout_send_bitrate = NULL;
-        p_input->p->counters.p_sout_sent_packets = NULL;
-        p_input->p->counters.p_sout_sent_bytes = NULL;
-        if( p_input->p->counters.p_demux_bitrate )
-            p_input->p->counters.p_demux_bitrate->update_interval = 1000000;
-        if( p_input->p->counters.p_input_bitrate )
-            p_input->p->counters.p_input_bitrate->update_interval = 1000000;
+        char *psz_name = input_item_GetName( p_input->p->p_item );
+        if( psz_name == NULL )
+            return;
+
+        INIT_COUNTER( read_bytes, COUNTER, "input_read_bytes" );
+        INIT_COUNTER( read_packets, COUNTER, "input_read_packets" );
+        INIT_COUNTER( demux_read, COUNTER, "demux_read_bytes" );
+        INIT_COUNTER( demux_corrupted, COUNTER, "demux_corrupted_blocks" );
+        INIT_COUNTER( demux_discontinuity, COUNTER,
+                      "demux_discontinuities" );
+        INIT_COUNTER( played_abuffers, COUNTER, "audio_played_buffers" );
+        INIT_COUNTER( lost_abuffers, COUNTER, "audio_lost_buffers" );
+        INIT_COUNTER( displayed_pictures, COUNTER,
+                      "video_displayed_pictures" );
+        INIT_COUNTER( lost_pictures, COUNTER, "video_lost_pictures" );
+        INIT_COUNTER( decoded_audio, COUNTER, "decoded_audio_blocks" );
+        INIT_COUNTER( decoded_video, COUNTER, "decoded_video_blocks" );
+        INIT_COUNTER( decoded_sub, COUNTER, "decoded_subtitles" );
+        INIT_COUNTER( decoder_time, HISTOGRAM, "decoder_block_microseconds" );
+        INIT_COUNTER( decoder_queue, HISTOGRAM, "decoder_queue_blocks" );
+        free( psz_name );
     }
 }
 
+static void DeleteStatistics( input_thread_t * p_input )
+{
+#define CL_CO( c ) stats_MetricDelete( p_input->p->counters.p_##c ); \
+                   p_input->p->counters.p_##c = NULL;
+    CL_CO( read_bytes );
+    CL_CO( read_packets );
+    CL_CO( demux_read );
+    CL_CO( demux_corrupted );
+    CL_CO( demux_discontinuity );
+    CL_CO( played_abuffers );
+    CL_CO( lost_abuffers );
+    CL_CO( displayed_pictures );
+    CL_CO( lost_pictures );
+    CL_CO( decoded_audio );
+    CL_CO( decoded_video );
+    CL_CO( decoded_sub );
+    CL_CO( decoder_time );
+    CL_CO( decoder_queue );
+    CL_CO( sout_sent_packets );
+    CL_CO( sout_sent_bytes );
+#undef CL_CO
+}
+
 #ifdef ENABLE_SOUT
 static int InitSout( input_thread_t * p_input )
 {
@@ -911,12 +973,14 @@ static int InitSout( input_thread_t * p_input )
         }
         if( libvlc_stats( p_input ) )
         {
-            INIT_COUNTER( sout_sent_packets, INTEGER, COUNTER );
-            INIT_COUNTER( sout_sent_bytes, INTEGER, COUNTER );
-            INIT_COUNTER( sout_send_bitrate, FLOAT, DERIVATIVE );
-            if( p_input->p->counters.p_sout_send_bitrate )
-                 p_input->p->counters.p_sout_send_bitrate->update_interval =
-                         1000000;
+            char *psz_name = input_item_GetName( p_input->p->p_item );
+            if( psz_name != NULL )
+            {
+                INIT_COUNTER( sout_sent_packets, COUNTER,
+                              "sout_sent_packets" );
+                INIT_COUNTER( sout_sent_bytes, COUNTER, "sout_sent_bytes" );
+                free( psz_name );
+            }
         }
     }
     else
@@ -1346,34 +1410,8 @@ error:
             input_resource_Terminate( p_input->p->p_resource_private );
     }
 
-    if( !p_input->b_preparsing && libvlc_stats( p_input ) )
-    {
-#define EXIT_COUNTER( c ) do { if( p_input->p->counters.p_##c ) \
-                                   stats_CounterClean( p_input->p->counters.p_##c );\
-                               p_input->p->counters.p_##c = NULL; } while(0)
-        EXIT_COUNTER( read_bytes );
-        EXIT_COUNTER( read_packets );
-        EXIT_COUNTER( demux_read );
-        EXIT_COUNTER( input_bitrate );
-        EXIT_COUNTER( demux_bitrate );
-        EXIT_COUNTER( demux_corrupted );
-        EXIT_COUNTER( demux_discontinuity );
-        EXIT_COUNTER( played_abuffers );
-        EXIT_COUNTER( lost_abuffers );
-        EXIT_COUNTER( displayed_pictures );
-        EXIT_COUNTER( lost_pictures );
-        EXIT_COUNTER( decoded_audio );
-        EXIT_COUNTER( decoded_video );
-        EXIT_COUNTER( decoded_sub );
-
-        if( p_input->p->p_sout )
-        {
-            EXIT_COUNTER( sout_sent_packets );
-            EXIT_COUNTER( sout_sent_bytes );
-            EXIT_COUNTER( sout_send_bitrate );
-        }
-#undef EXIT_COUNTER
-    }
+    if( !p_input->b_preparsing )
+        DeleteStatistics( p_input );
 
     /* Mark them deleted */
     p_input->p->input.p_demux = NULL;
@@ -1419,35 +1457,9 @@ static void End( input_thread_t * p_input )
 
     if( !p_input->b_preparsing )
     {
-#define CL_CO( c ) stats_CounterClean( p_input->p->counters.p_##c ); p_input->p->counters.p_##c = NULL;
-        if( libvlc_stats( p_input ) )
-        {
-            /* make sure we are up to date */
-            stats_ComputeInputStats( p_input, p_input->p->p_item->p_stats );
-            CL_CO( read_bytes );
-            CL_CO( read_packets );
-            CL_CO( demux_read );
-            CL_CO( input_bitrate );
-            CL_CO( demux_bitrate );
-            CL_CO( demux_corrupted );
-            CL_CO( demux_discontinuity );
-            CL_CO( played_abuffers );
-            CL_CO( lost_abuffers );
-            CL_CO( displayed_pictures );
-            CL_CO( lost_pictures );
-            CL_CO( decoded_audio) ;
-            CL_CO( decoded_video );
-            CL_CO( decoded_sub) ;
-        }
-
-        /* Close optional stream output instance */
-        if( p_input->p->p_sout )
-        {
-            CL_CO( sout_sent_packets );
-            CL_CO( sout_sent_bytes );
-            CL_CO( sout_send_bitrate );
-        }
-#undef CL_CO
+        /* make sure we are up to date */
+        stats_ComputeInputStats( p_input, p_input->p->p_item->p_stats );
+        DeleteStatistics( p_input );
     }
 
     vlc_mutex_lock( &p_input->p->p_item->lock );
@@ -1623,8 +1635,12 @@ static void ControlPause( input_thread_t *p_input, mtime_t i_control_date )
     if( p_input->p->b_can_pause )
     {
         if( p_input->p->input.p_access )
+        {
+            access_Lock( p_input->p->input.p_access );
             i_ret = access_Control( p_input->p->input.p_access,
                                      ACCESS_SET_PAUSE_STATE, true );
+            access_Unlock( p_input->p->input.p_access );
+        }
         else
             i_ret = demux_Control( p_input->p->input.p_demux,
                                     DEMUX_SET_PAUSE_STATE, true );
@@ -1657,8 +1673,12 @@ static void ControlUnpause( input_thread_t *p_input, mtime_t i_control_date )
     if( p_input->p->b_can_pause )
     {
         if( p_input->p->input.p_access )
+        {
+            access_Lock( p_input->p->input.p_access );
             i_ret = access_Control( p_input->p->input.p_access,
                                      ACCESS_SET_PAUSE_STATE, false );
+            access_Unlock( p_input->p->input.p_access );
+        }
         else
             i_ret = demux_Control( p_input->p->input.p_demux,
                                     DEMUX_SET_PAUSE_STATE, false );
@@ -1955,10 +1975,15 @@ static bool Control( input_thread_t *p_input,
                 access_t *p_access = p_input->p->input.p_access;
                 int i_title;
 
+                /* The access updates its info while reading */
+                access_Lock( p_access );
+                const int i_current = p_access->info.i_title;
+                access_Unlock( p_access );
+
                 if( i_type == INPUT_CONTROL_SET_TITLE_PREV )
-                    i_title = p_access->info.i_title - 1;
+                    i_title = i_current - 1;
                 else if( i_type == INPUT_CONTROL_SET_TITLE_NEXT )
-                    i_title = p_access->info.i_title + 1;
+                    i_title = i_current + 1;
                 else
                     i_title = val.i_int;
 
@@ -2024,10 +2049,16 @@ static bool Control( input_thread_t *p_input,
                 int64_t i_input_time;
                 int64_t i_seekpoint_time;
 
+                /* The access updates its info while reading */
+                access_Lock( p_access );
+                const int i_title = p_access->info.i_title;
+                const int i_current = p_access->info.i_seekpoint;
+                access_Unlock( p_access );
+
                 if( i_type == INPUT_CONTROL_SET_SEEKPOINT_PREV )
                 {
-                    i_seekpoint = p_access->info.i_seekpoint;
-                    i_seekpoint_time = p_input->p->input.title[p_access->info.i_title]->seekpoint[i_seekpoint]->i_time_offset;
+                    i_seekpoint = i_current;
+                    i_seekpoint_time = p_input->p->input.title[i_title]->seekpoint[i_seekpoint]->i_time_offset;
                     i_input_time = var_GetTime( p_input, "time" );
                     if( i_seekpoint_time >= 0 && i_input_time >= 0 )
                     {
@@ -2038,18 +2069,18 @@ static bool Control( input_thread_t *p_input,
                         i_seekpoint--;
                 }
                 else if( i_type == INPUT_CONTROL_SET_SEEKPOINT_NEXT )
-                    i_seekpoint = p_access->info.i_seekpoint + 1;
+                    i_seekpoint = i_current + 1;
                 else
                     i_seekpoint = val.i_int;
 
                 if( i_seekpoint >= 0 && i_seekpoint <
-                    p_input->p->input.title[p_access->info.i_title]->i_seekpoint )
+                    p_input->p->input.title[i_title]->i_seekpoint )
                 {
                     es_out_SetTime( p_input->p->p_es_out, -1 );
 
                     stream_Control( p_input->p->input.p_stream, STREAM_CONTROL_ACCESS,
                                     ACCESS_SET_SEEKPOINT, i_seekpoint );
-                    input_SendEventSeekpoint( p_input, p_access->info.i_title, i_seekpoint );
+                    input_SendEventSeekpoint( p_input, i_title, i_seekpoint );
                 }
             }
             break;
@@ -2098,7 +2129,9 @@ static bool Control( input_thread_t *p_input,
                     p_meta = vlc_meta_New();
                     if( p_meta )
                     {
+                        access_Lock( slave->p_access );
                         access_Control( slave->p_access, ACCESS_GET_META, p_meta );
+                        access_Unlock( slave->p_access );
                         demux_Control( slave->p_demux, DEMUX_GET_META, p_meta );
                         InputUpdateMeta( p_input, p_meta );
                     }
@@ -2282,61 +2315,54 @@ static void UpdateGenericFromDemux( input_thread_t *p_input )
 /*****************************************************************************
  * Update*FromAccess:
  *****************************************************************************/
-static int UpdateTitleSeekpointFromAccess( input_thread_t *p_input )
+static int UpdateTitleSeekpointFromAccess( input_thread_t *p_input,
+                                           int i_update, int i_title,
+                                           int i_seekpoint )
 {
     access_t *p_access = p_input->p->input.p_access;
 
-    if( p_access->info.i_update & INPUT_UPDATE_TITLE )
+    if( i_update & INPUT_UPDATE_TITLE )
     {
-        input_SendEventTitle( p_input, p_access->info.i_title );
+        input_SendEventTitle( p_input, i_title );
 
         stream_Control( p_input->p->input.p_stream, STREAM_UPDATE_SIZE );
-
-        p_access->info.i_update &= ~INPUT_UPDATE_TITLE;
     }
-    if( p_access->info.i_update & INPUT_UPDATE_SEEKPOINT )
-    {
-        input_SendEventSeekpoint( p_input,
-                                  p_access->info.i_title, p_access->info.i_seekpoint );
+    if( i_update & INPUT_UPDATE_SEEKPOINT )
+        input_SendEventSeekpoint( p_input, i_title, i_seekpoint );
 
-        p_access->info.i_update &= ~INPUT_UPDATE_SEEKPOINT;
-    }
     /* Hmmm only works with master input */
     if( p_input->p->input.p_access == p_access )
-        return UpdateTitleSeekpoint( p_input,
-                                     p_access->info.i_title,
-                                     p_access->info.i_seekpoint );
+        return UpdateTitleSeekpoint( p_input, i_title, i_seekpoint );
     return 1;
 }
-static void UpdateGenericFromAccess( input_thread_t *p_input )
+static void UpdateGenericFromAccess( input_thread_t *p_input, int i_update )
 {
     access_t *p_access = p_input->p->input.p_access;
 
-    if( p_access->info.i_update & INPUT_UPDATE_META )
+    if( i_update & INPUT_UPDATE_META )
     {
         /* TODO maybe multi - access ? */
         vlc_meta_t *p_meta = vlc_meta_New();
         if( p_meta )
         {
-            access_Control( p_input->p->input.p_access, ACCESS_GET_META, p_meta );
+            access_Lock( p_access );
+            access_Control( p_access, ACCESS_GET_META, p_meta );
+            access_Unlock( p_access );
             InputUpdateMeta( p_input, p_meta );
         }
-        p_access->info.i_update &= ~INPUT_UPDATE_META;
     }
-    if( p_access->info.i_update & INPUT_UPDATE_SIGNAL )
+    if( i_update & INPUT_UPDATE_SIGNAL )
     {
         double f_quality;
         double f_strength;
 
+        access_Lock( p_access );
         if( access_Control( p_access, ACCESS_GET_SIGNAL, &f_quality, &f_strength ) )
             f_quality = f_strength = -1;
+        access_Unlock( p_access );
 
         input_SendEventSignal( p_input, f_quality, f_strength );
-
-        p_access->info.i_update &= ~INPUT_UPDATE_SIGNAL;
     }
-
-    p_access->info.i_update &= ~INPUT_UPDATE_SIZE;
 }
 
 /*****************************************************************************
@@ -2641,8 +2667,10 @@ static int InputSourceInit( input_thread_t *p_input,
         {
             /* GET_PTS_DELAY is mandatory for access_demux */
             assert( in->p_access );
+            access_Lock( in->p_access );
             access_Control( in->p_access,
                             ACCESS_GET_PTS_DELAY, &in->i_pts_delay );
+            access_Unlock( in->p_access );
         }
         if( in->i_pts_delay > INPUT_PTS_DELAY_MAX )
             in->i_pts_delay = INPUT_PTS_DELAY_MAX;
@@ -2717,7 +2745,14 @@ static void InputSourceMeta( input_thread_t *p_input,
     bool has_meta;
 
     /* Read access meta */
-    has_meta = p_access && !access_Control( p_access, ACCESS_GET_META, p_meta );
+    if( p_access )
+    {
+        access_Lock( p_access );
+        has_meta = !access_Control( p_access, ACCESS_GET_META, p_meta );
+        access_Unlock( p_access );
+    }
+    else
+        has_meta = false;
 
     /* Read demux meta */
     has_meta |= !demux_Control( p_demux, DEMUX_GET_META, p_meta );
@@ -3206,10 +3241,9 @@ void input_UpdateStatistic( input_thread_t *p_input,
 {
     assert( p_input->p->i_state != INIT_S );
 
-    vlc_mutex_lock( &p_input->p->counters.counters_lock);
     switch( i_type )
     {
-#define I(c) stats_UpdateInteger( p_input, p_input->p->counters.c, i_delta, NULL )
+#define I(c) stats_MetricAdd( p_input->p->counters.c, i_delta )
     case INPUT_STATISTIC_DECODED_VIDEO:
         I(p_decoded_video);
         break;
@@ -3222,20 +3256,14 @@ void input_UpdateStatistic( input_thread_t *p_input,
     case INPUT_STATISTIC_SENT_PACKET:
         I(p_sout_sent_packets);
         break;
-#undef I
     case INPUT_STATISTIC_SENT_BYTE:
-    {
-        int i_bytes; /* That's pretty stupid to define it as an integer, it will overflow
-                        really fast ... */
-        if( !stats_UpdateInteger( p_input, p_input->p->counters.p_sout_sent_bytes, i_delta, &i_bytes ) )
-            stats_UpdateFloat( p_input, p_input->p->counters.p_sout_send_bitrate, i_bytes, NULL );
+        I(p_sout_sent_bytes);
         break;
-    }
+#undef I
     default:
         msg_Err( p_input, "Invalid statistic type %d (internal error)", i_type );
         break;
     }
-    vlc_mutex_unlock( &p_input->p->counters.counters_lock);
 }
 
 /**/
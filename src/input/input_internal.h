@@ -77,6 +77,13 @@ typedef struct
     vlc_value_t val;
 } input_control_t;
 
+/* Byte count at the last bit rate computation */
+typedef struct
+{
+    int64_t i_bytes;
+    mtime_t i_date;
+} stats_rate_t;
+
 /** Private input fields */
 struct input_thread_private_t
 {
@@ -135,26 +142,41 @@ struct input_thread_private_t
     input_resource_t *p_resource;
     input_resource_t *p_resource_private;
 
-    /* Stats counters */
+    /* Variables resolved once, for the frequent reads */
+    struct {
+        vlc_var_handle_t *state;
+        vlc_var_handle_t *rate;
+        vlc_var_handle_t *position;
+        vlc_var_handle_t *time;
+        vlc_var_handle_t *length;
+        vlc_var_handle_t *audio_delay;
+        vlc_var_handle_t *spu_delay;
+    } var;
+
+    /* Stats counters, updated without locking */
     struct {
-        counter_t *p_read_packets;
-        counter_t *p_read_bytes;
-        counter_t *p_input_bitrate;
-        counter_t *p_demux_read;
-        counter_t *p_demux_bitrate;
-        counter_t *p_demux_corrupted;
-        counter_t *p_demux_discontinuity;
-        counter_t *p_decoded_audio;
-        counter_t *p_decoded_video;
-        counter_t *p_decoded_sub;
-        counter_t *p_sout_sent_packets;
-        counter_t *p_sout_sent_bytes;
-        counter_t *p_sout_send_bitrate;
-        counter_t *p_played_abuffers;
-        counter_t *p_lost_abuffers;
-        counter_t *p_displayed_pictures;
-        counter_t *p_lost_pictures;
-        vlc_mutex_t counters_lock;
+        stats_metric_t *p_read_packets;
+        stats_metric_t *p_read_bytes;
+        stats_metric_t *p_demux_read;
+        stats_metric_t *p_demux_corrupted;
+        stats_metric_t *p_demux_discontinuity;
+        stats_metric_t *p_decoded_audio;
+        stats_metric_t *p_decoded_video;
+        stats_metric_t *p_decoded_sub;
+        stats_metric_t *p_sout_sent_packets;
+        stats_metric_t *p_sout_sent_bytes;
+        stats_metric_t *p_played_abuffers;
+        stats_metric_t *p_lost_abuffers;
+        stats_metric_t *p_displayed_pictures;
+        stats_metric_t *p_lost_pictures;
+        stats_metric_t *p_decoder_time;  /* histogram, in microseconds */
+        stats_metric_t *p_decoder_queue; /* histogram, in blocks */
+        char psz_id[12]; /* label of this input in the metrics */
+
+        /* For the bit rates, computed by the input thread */
+        stats_rate_t input_rate;
+        stats_rate_t demux_rate;
+        stats_rate_t send_rate;
     } counters;
 
     /* Buffer of pending actions */
@@ -216,7 +216,7 @@ void input_ExtractAttachmentAndCacheArt( input_thread_t *p_input )
         /* XXX Weird, we should not have end up with attachment:// art url unless there is a race
          * condition */
         msg_Warn( p_input, "internal input error with input_ExtractAttachmentAndCacheArt" );
-        playlist_FindArtInCache( p_item );
+        playlist_FindArtInCache( p_playlist, p_item );
         goto exit;
     }
 
@@ -86,15 +86,30 @@
  *      no: search the ring with i_end the closer to i_pos,
  *          if close enough, read data and use this ring
  *          else use the oldest ring, seek and use it.
+ *  - A prefetch thread fills the current ring ahead of the reader, the
+ *    reader only waits when it catches up with it.
+ *  - The size of the access reads follows the access throughput, and the
+ *    amount of data read ahead follows the bitrate at which the reader
+ *    consumes the data, the access latency, and the stalls.
  *
  *  TODO: - with access non seekable: use all space available for only one ring, but
  *          we have to support seekable/non-seekable switch on the fly.
- *        - compute a good value for i_read_size
  *        - ?
  */
-#define STREAM_READ_ATONCE 1024
 #define STREAM_CACHE_TRACK_SIZE (STREAM_CACHE_SIZE/STREAM_CACHE_TRACK)
 
+/* Bounds of a single access read. Within them, a read is sized to take
+ * about STREAM_READ_DURATION at the measured access throughput */
+#define STREAM_READ_MIN 1024
+#define STREAM_READ_MAX (STREAM_CACHE_TRACK_SIZE/16)
+#define STREAM_READ_DURATION (CLOCK_FREQ/100)
+
+/* How much data the prefetcher keeps ahead of the reader, in time at the
+ * reader bitrate. It is doubled after each stall, up to
+ * 2^STREAM_PREFETCH_BOOST_MAX times. */
+#define STREAM_PREFETCH_DURATION (CLOCK_FREQ)
+#define STREAM_PREFETCH_BOOST_MAX 3
+
 typedef struct
 {
     int64_t i_date;
@@ -140,19 +155,41 @@ struct stream_sys_t
 
     } block;
 
-    /* Method 2: for pf_read */
+    /* Method 2: for pf_read
+     * The tracks, i_tk, i_pos and the stat are protected by lock */
     struct
     {
-        unsigned i_offset;   /* Buffer offset in the current track */
         int      i_tk;       /* Current track */
         stream_track_t tk[STREAM_CACHE_TRACK];
 
         /* Global buffer */
         uint8_t *p_buffer;
 
-        /* */
-        unsigned i_used; /* Used since last read */
-        unsigned i_read_size;
+        /* Read-ahead */
+        unsigned i_read_size;   /* Size of one access read */
+        unsigned i_depth;       /* Data to keep buffered after i_pos */
+        unsigned i_boost;       /* Depth doubling after stalls */
+        uint64_t i_want;        /* End of the data a reader waits for */
+        bool     b_eof;         /* Access returned no more data */
+        bool     b_can_seek;    /* From access */
+        bool     b_can_fastseek;
+
+        /* Measurements */
+        uint64_t i_byterate;    /* Access throughput (byte/s) */
+        uint64_t i_bitrate;     /* Reader consumption (byte/s) */
+        mtime_t  i_latency;     /* Duration of an access read */
+        mtime_t  i_rate_date;
+        uint64_t i_rate_pos;
+
+        /* Prefetch thread */
+        vlc_thread_t thread;
+        vlc_mutex_t  lock;
+        vlc_cond_t   wait;      /* Signals the prefetch thread */
+        vlc_cond_t   done;      /* Signals the reader */
+        bool         b_thread;  /* The thread is running */
+        bool         b_paused;  /* No access read until resumed */
+        bool         b_reading; /* An access read is in progress */
+        bool         b_exit;
 
     } stream;
 
@@ -174,6 +211,11 @@ struct stream_sys_t
         unsigned i_seek_count;
         uint64_t i_seek_time;
 
+        /* Stat about the reader */
+        uint64_t i_hit_count;   /* Served from the cache */
+        uint64_t i_miss_count;  /* Had to wait for the access */
+        uint64_t i_stall_time;
+
     } stat;
 
     /* Streams list */
@@ -195,8 +237,13 @@ static int  AStreamReadStream( stream_t *s, void *p_read, unsigned int i_read );
 static int  AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int i_read );
 static int  AStreamSeekStream( stream_t *s, uint64_t i_pos );
 static void AStreamPrebufferStream( stream_t *s );
+static void AStreamStartStream( stream_t *s );
+static void AStreamStopStream( stream_t *s );
 static int  AReadStream( stream_t *s, void *p_read, unsigned int i_read );
 
+static void AStreamPauseStream( stream_t *s );
+static void AStreamResumeStream( stream_t *s );
+
 /* Common */
 static int AStreamControl( stream_t *s, int i_query, va_list );
 static void AStreamDestroy( stream_t *s );
@@ -307,6 +354,7 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         p_sys->method = STREAM_METHOD_STREAM;
 
     p_sys->i_pos = p_access->info.i_pos;
+    p_sys->stream.p_buffer = NULL;
 
     /* Stats */
     access_Control( p_access, ACCESS_CAN_FASTSEEK, &p_sys->stat.b_fastseek );
@@ -315,6 +363,9 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
     p_sys->stat.i_read_count = 0;
     p_sys->stat.i_seek_count = 0;
     p_sys->stat.i_seek_time = 0;
+    p_sys->stat.i_hit_count = 0;
+    p_sys->stat.i_miss_count = 0;
+    p_sys->stat.i_stall_time = 0;
 
     TAB_INIT( p_sys->i_list, p_sys->list );
     p_sys->i_list_index = 0;
@@ -404,16 +455,33 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         s->pf_peek = AStreamPeekStream;
 
         /* Allocate/Setup our tracks */
-        p_sys->stream.i_offset = 0;
         p_sys->stream.i_tk     = 0;
         p_sys->stream.p_buffer = malloc( STREAM_CACHE_SIZE );
         if( p_sys->stream.p_buffer == NULL )
             goto error;
-        p_sys->stream.i_used   = 0;
-        p_sys->stream.i_read_size = STREAM_READ_ATONCE;
-#if STREAM_READ_ATONCE < 256
-#   error "Invalid STREAM_READ_ATONCE value"
+        p_sys->stream.i_read_size = STREAM_READ_MIN;
+        p_sys->stream.i_depth  = 4 * STREAM_READ_MIN;
+        p_sys->stream.i_boost  = 0;
+        p_sys->stream.i_want   = 0;
+        p_sys->stream.b_eof    = false;
+        access_Control( p_access, ACCESS_CAN_SEEK,
+                        &p_sys->stream.b_can_seek );
+        p_sys->stream.b_can_fastseek = p_sys->stat.b_fastseek;
+        p_sys->stream.i_byterate = 0;
+        p_sys->stream.i_bitrate = 0;
+        p_sys->stream.i_latency = 0;
+        p_sys->stream.i_rate_date = 0;
+        p_sys->stream.i_rate_pos = p_sys->i_pos;
+#if STREAM_READ_MAX < 4 * STREAM_READ_MIN
+#   error "Invalid STREAM_READ_MIN value"
 #endif
+        vlc_mutex_init( &p_sys->stream.lock );
+        vlc_cond_init( &p_sys->stream.wait );
+        vlc_cond_init( &p_sys->stream.done );
+        p_sys->stream.b_thread = false;
+        p_sys->stream.b_paused = false;
+        p_sys->stream.b_reading = false;
+        p_sys->stream.b_exit = false;
 
         for( i = 0; i < STREAM_CACHE_TRACK; i++ )
         {
@@ -432,6 +500,8 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
             msg_Err( s, "cannot pre fill buffer" );
             goto error;
         }
+
+        AStreamStartStream( s );
     }
 
     return s;
@@ -441,8 +511,11 @@ error:
     {
         /* Nothing yet */
     }
-    else
+    else if( p_sys->stream.p_buffer != NULL )
     {
+        vlc_cond_destroy( &p_sys->stream.done );
+        vlc_cond_destroy( &p_sys->stream.wait );
+        vlc_mutex_destroy( &p_sys->stream.lock );
         free( p_sys->stream.p_buffer );
     }
     while( p_sys->i_list > 0 )
@@ -463,7 +536,19 @@ static void AStreamDestroy( stream_t *s )
     if( p_sys->method == STREAM_METHOD_BLOCK )
         block_ChainRelease( p_sys->block.p_first );
     else
+    {
+        AStreamStopStream( s );
+        vlc_cond_destroy( &p_sys->stream.done );
+        vlc_cond_destroy( &p_sys->stream.wait );
+        vlc_mutex_destroy( &p_sys->stream.lock );
         free( p_sys->stream.p_buffer );
+    }
+
+    msg_Dbg( s, "cache: %"PRIu64" hits, %"PRIu64" misses, stalled %"PRId64
+             " ms, %"PRIu64" bytes in %"PRIu64" reads, %u seeks",
+             p_sys->stat.i_hit_count, p_sys->stat.i_miss_count,
+             p_sys->stat.i_stall_time / 1000, p_sys->stat.i_bytes,
+             p_sys->stat.i_read_count, p_sys->stat.i_seek_count );
 
     free( p_sys->p_peek );
 
@@ -519,10 +604,11 @@ static void AStreamControlReset( stream_t *s )
 
         assert( p_sys->method == STREAM_METHOD_STREAM );
 
-        /* Setup our tracks */
-        p_sys->stream.i_offset = 0;
+        /* Setup our tracks (the prefetcher is paused) */
+        vlc_mutex_lock( &p_sys->stream.lock );
         p_sys->stream.i_tk     = 0;
-        p_sys->stream.i_used   = 0;
+        p_sys->stream.b_eof    = false;
+        p_sys->stream.i_rate_date = 0;
 
         for( i = 0; i < STREAM_CACHE_TRACK; i++ )
         {
@@ -530,6 +616,7 @@ static void AStreamControlReset( stream_t *s )
             p_sys->stream.tk[i].i_start = p_sys->i_pos;
             p_sys->stream.tk[i].i_end   = p_sys->i_pos;
         }
+        vlc_mutex_unlock( &p_sys->stream.lock );
 
         /* Do the prebuffering */
         AStreamPrebufferStream( s );
@@ -542,17 +629,36 @@ static void AStreamControlReset( stream_t *s )
 static void AStreamControlUpdate( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
+    uint64_t i_pos;
 
-    p_sys->i_pos = p_sys->p_access->info.i_pos;
+    access_Lock( p_sys->p_access );
+    i_pos = p_sys->p_access->info.i_pos;
+    access_Unlock( p_sys->p_access );
 
     if( p_sys->i_list )
     {
         int i;
         for( i = 0; i < p_sys->i_list_index; i++ )
         {
-            p_sys->i_pos += p_sys->list[i]->i_size;
+            i_pos += p_sys->list[i]->i_size;
         }
     }
+
+    if( p_sys->method == STREAM_METHOD_STREAM )
+    {
+        /* The buffered data do not match the new position anymore */
+        stream_track_t *tk;
+
+        vlc_mutex_lock( &p_sys->stream.lock );
+        AStreamPauseStream( s );
+        tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+        tk->i_start = tk->i_end = p_sys->i_pos = i_pos;
+        p_sys->stream.b_eof = false;
+        AStreamResumeStream( s );
+        vlc_mutex_unlock( &p_sys->stream.lock );
+    }
+    else
+        p_sys->i_pos = i_pos;
 }
 
 /****************************************************************************
@@ -584,11 +690,25 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
 
         case STREAM_CAN_SEEK:
             p_bool = (bool*)va_arg( args, bool * );
+            if( p_sys->method == STREAM_METHOD_STREAM )
+            {
+                vlc_mutex_lock( &p_sys->stream.lock );
+                *p_bool = p_sys->stream.b_can_seek;
+                vlc_mutex_unlock( &p_sys->stream.lock );
+                break;
+            }
             access_Control( p_access, ACCESS_CAN_SEEK, p_bool );
             break;
 
         case STREAM_CAN_FASTSEEK:
             p_bool = (bool*)va_arg( args, bool * );
+            if( p_sys->method == STREAM_METHOD_STREAM )
+            {
+                vlc_mutex_lock( &p_sys->stream.lock );
+                *p_bool = p_sys->stream.b_can_fastseek;
+                vlc_mutex_unlock( &p_sys->stream.lock );
+                break;
+            }
             access_Control( p_access, ACCESS_CAN_FASTSEEK, p_bool );
             break;
 
@@ -623,9 +743,25 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
                             "DON'T USE STREAM_CONTROL_ACCESS !!!" );
                 return VLC_EGENERIC;
             }
+            if( p_sys->method == STREAM_METHOD_STREAM )
+            {
+                vlc_mutex_lock( &p_sys->stream.lock );
+                AStreamPauseStream( s );
+                vlc_mutex_unlock( &p_sys->stream.lock );
+            }
+
+            access_Lock( p_access );
             int i_ret = access_vaControl( p_access, i_int, args );
+            access_Unlock( p_access );
             if( i_int == ACCESS_SET_TITLE || i_int == ACCESS_SET_SEEKPOINT )
                 AStreamControlReset( s );
+
+            if( p_sys->method == STREAM_METHOD_STREAM )
+            {
+                vlc_mutex_lock( &p_sys->stream.lock );
+                AStreamResumeStream( s );
+                vlc_mutex_unlock( &p_sys->stream.lock );
+            }
             return i_ret;
         }
 
@@ -634,8 +770,41 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
             return VLC_SUCCESS;
 
         case STREAM_GET_CONTENT_TYPE:
-            return access_Control( p_access, ACCESS_GET_CONTENT_TYPE,
-                                    va_arg( args, char ** ) );
+        {
+            access_Lock( p_access );
+            int i_ret = access_Control( p_access, ACCESS_GET_CONTENT_TYPE,
+                                        va_arg( args, char ** ) );
+            access_Unlock( p_access );
+            return i_ret;
+        }
+
+        case STREAM_GET_CACHE_STATS:
+        {
+            stream_cache_stats_t *p_stats =
+                va_arg( args, stream_cache_stats_t * );
+
+            if( p_sys->method == STREAM_METHOD_STREAM )
+                vlc_mutex_lock( &p_sys->stream.lock );
+            p_stats->i_hit = p_sys->stat.i_hit_count;
+            p_stats->i_miss = p_sys->stat.i_miss_count;
+            p_stats->i_stall = p_sys->stat.i_stall_time;
+            p_stats->i_bytes = p_sys->stat.i_bytes;
+            p_stats->i_read_count = p_sys->stat.i_read_count;
+            p_stats->i_seek_count = p_sys->stat.i_seek_count;
+            if( p_sys->method == STREAM_METHOD_STREAM )
+            {
+                p_stats->i_read_size = p_sys->stream.i_read_size;
+                p_stats->i_depth = p_sys->stream.i_depth;
+                vlc_mutex_unlock( &p_sys->stream.lock );
+            }
+            else
+            {
+                p_stats->i_read_size = 0;
+                p_stats->i_depth = STREAM_CACHE_SIZE;
+            }
+            break;
+        }
+
         case STREAM_SET_RECORD_STATE:
         default:
             msg_Err( s, "invalid stream_vaControl query=0x%x", i_query );
@@ -718,6 +887,7 @@ static int AStreamReadBlock( stream_t *s, void *p_read, unsigned int i_read )
 
     uint8_t *p_data = p_read;
     unsigned int i_data = 0;
+    bool b_miss = false;
 
     /* It means EOF */
     if( p_sys->block.p_current == NULL )
@@ -760,13 +930,24 @@ static int AStreamReadBlock( stream_t *s, void *p_read, unsigned int i_read )
                 p_sys->block.p_current = p_sys->block.p_current->p_next;
             }
             /*Get a new block if needed */
-            if( !p_sys->block.p_current && AStreamRefillBlock( s ) )
+            if( !p_sys->block.p_current )
             {
-                break;
+                const mtime_t i_start = mdate();
+                const int i_ret = AStreamRefillBlock( s );
+
+                p_sys->stat.i_stall_time += mdate() - i_start;
+                b_miss = true;
+                if( i_ret )
+                    break;
             }
         }
     }
 
+    if( b_miss )
+        p_sys->stat.i_miss_count++;
+    else
+        p_sys->stat.i_hit_count++;
+
     p_sys->i_pos += i_data;
     return i_data;
 }
@@ -785,6 +966,7 @@ static int AStreamPeekBlock( stream_t *s, const uint8_t **pp_peek, unsigned int
     if( i_read <= p_sys->block.p_current->i_buffer - p_sys->block.i_offset )
     {
         *pp_peek = &p_sys->block.p_current->p_buffer[p_sys->block.i_offset];
+        p_sys->stat.i_hit_count++;
         return i_read;
     }
 
@@ -801,16 +983,27 @@ static int AStreamPeekBlock( stream_t *s, const uint8_t **pp_peek, unsigned int
     }
 
     /* Fill enough data */
-    while( p_sys->block.i_size - (p_sys->i_pos - p_sys->block.i_start)
-           < i_read )
+    if( p_sys->block.i_size - (p_sys->i_pos - p_sys->block.i_start) < i_read )
     {
-        block_t **pp_last = p_sys->block.pp_last;
+        const mtime_t i_start = mdate();
 
-        if( AStreamRefillBlock( s ) ) break;
+        do
+        {
+            block_t **pp_last = p_sys->block.pp_last;
+
+            if( AStreamRefillBlock( s ) ) break;
+
+            /* Our buffer are probably filled enough, don't try anymore */
+            if( pp_last == p_sys->block.pp_last ) break;
+        }
+        while( p_sys->block.i_size - (p_sys->i_pos - p_sys->block.i_start)
+               < i_read );
 
-        /* Our buffer are probably filled enough, don't try anymore */
-        if( pp_last == p_sys->block.pp_last ) break;
+        p_sys->stat.i_stall_time += mdate() - i_start;
+        p_sys->stat.i_miss_count++;
     }
+    else
+        p_sys->stat.i_hit_count++;
 
     /* Copy what we have */
     b = p_sys->block.p_current;
@@ -1035,8 +1228,9 @@ static int AStreamRefillBlock( stream_t *s )
 /****************************************************************************
  * Method 2:
  ****************************************************************************/
-static int AStreamRefillStream( stream_t *s );
-static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_read );
+static int  AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_read );
+static int  AStreamFillStream( stream_t *s );
+static bool AStreamWaitStream( stream_t *s, unsigned int i_size );
 
 static int AStreamReadStream( stream_t *s, void *p_read, unsigned int i_read )
 {
@@ -1059,40 +1253,37 @@ static int AStreamReadStream( stream_t *s, void *p_read, unsigned int i_read )
 static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int i_read )
 {
     stream_sys_t *p_sys = s->p_sys;
-    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
-    uint64_t i_off;
+    stream_track_t *tk;
+    unsigned i_off;
 
-    if( tk->i_start >= tk->i_end ) return 0; /* EOF */
+    /* Avoid problem, but that should *never* happen */
+    if( i_read > STREAM_CACHE_TRACK_SIZE / 2 )
+        i_read = STREAM_CACHE_TRACK_SIZE / 2;
+
+    vlc_mutex_lock( &p_sys->stream.lock );
+    tk = &p_sys->stream.tk[p_sys->stream.i_tk];
 
 #ifdef STREAM_DEBUG
     msg_Dbg( s, "AStreamPeekStream: %d pos=%"PRId64" tk=%d "
-             "start=%"PRId64" offset=%d end=%"PRId64,
+             "start=%"PRId64" end=%"PRId64,
              i_read, p_sys->i_pos, p_sys->stream.i_tk,
-             tk->i_start, p_sys->stream.i_offset, tk->i_end );
+             tk->i_start, tk->i_end );
 #endif
 
-    /* Avoid problem, but that should *never* happen */
-    if( i_read > STREAM_CACHE_TRACK_SIZE / 2 )
-        i_read = STREAM_CACHE_TRACK_SIZE / 2;
-
-    while( tk->i_end < tk->i_start + p_sys->stream.i_offset + i_read )
-    {
-        if( p_sys->stream.i_used <= 1 )
-        {
-            /* Be sure we will read something */
-            p_sys->stream.i_used += tk->i_start + p_sys->stream.i_offset + i_read - tk->i_end;
-        }
-        if( AStreamRefillStream( s ) ) break;
-    }
+    if( AStreamWaitStream( s, i_read ) )
+        p_sys->stat.i_miss_count++;
+    else
+        p_sys->stat.i_hit_count++;
 
-    if( tk->i_end < tk->i_start + p_sys->stream.i_offset + i_read )
-    {
-        i_read = tk->i_end - tk->i_start - p_sys->stream.i_offset;
-    }
+    if( tk->i_end < p_sys->i_pos + i_read )
+        i_read = tk->i_end - p_sys->i_pos;
+    i_off = p_sys->i_pos % STREAM_CACHE_TRACK_SIZE;
+    vlc_mutex_unlock( &p_sys->stream.lock );
 
+    /* The prefetcher does not write between i_pos and i_end, so the data
+     * stays valid until the next call */
 
     /* Now, direct pointer or a copy ? */
-    i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
     if( i_off + i_read <= STREAM_CACHE_TRACK_SIZE )
     {
         *pp_peek = &tk->p_buffer[i_off];
@@ -1123,36 +1314,52 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
 {
     stream_sys_t *p_sys = s->p_sys;
 
+    vlc_mutex_lock( &p_sys->stream.lock );
+
     stream_track_t *p_current = &p_sys->stream.tk[p_sys->stream.i_tk];
-    access_t *p_access = p_sys->p_access;
 
-    if( p_current->i_start >= p_current->i_end  && i_pos >= p_current->i_end )
+    if( p_sys->stream.b_eof && p_current->i_start >= p_current->i_end &&
+        i_pos >= p_current->i_end )
+    {
+        vlc_mutex_unlock( &p_sys->stream.lock );
         return 0; /* EOF */
+    }
 
 #ifdef STREAM_DEBUG
     msg_Dbg( s, "AStreamSeekStream: to %"PRId64" pos=%"PRId64
-             " tk=%d start=%"PRId64" offset=%d end=%"PRId64,
+             " tk=%d start=%"PRId64" end=%"PRId64,
              i_pos, p_sys->i_pos, p_sys->stream.i_tk,
-             p_current->i_start,
-             p_sys->stream.i_offset,
-             p_current->i_end );
+             p_current->i_start, p_current->i_end );
 #endif
 
-    bool   b_aseek;
-    access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
+    const bool b_aseek = p_sys->stream.b_can_seek;
     if( !b_aseek && i_pos < p_current->i_start )
     {
+        vlc_mutex_unlock( &p_sys->stream.lock );
         msg_Warn( s, "AStreamSeekStream: can't seek" );
         return VLC_EGENERIC;
     }
 
-    bool   b_afastseek;
-    access_Control( p_access, ACCESS_CAN_FASTSEEK, &b_afastseek );
+    /* The tracks do not change until the prefetcher is resumed */
+    AStreamPauseStream( s );
 
-    /* FIXME compute seek cost (instead of static 'stupid' value) */
+    /* Skip rather than seek when the data would be read before a seek
+     * completes, from the measured seek duration and access throughput */
     uint64_t i_skip_threshold;
     if( b_aseek )
-        i_skip_threshold = b_afastseek ? 128 : 3*p_sys->stream.i_read_size;
+    {
+        i_skip_threshold = p_sys->stream.b_can_fastseek ?
+                           128 : 3 * p_sys->stream.i_read_size;
+        if( p_sys->stat.i_seek_count > 0 )
+        {
+            uint64_t i_cost = p_sys->stream.i_byterate *
+                ( p_sys->stat.i_seek_time / p_sys->stat.i_seek_count ) /
+                CLOCK_FREQ;
+
+            i_cost = __MIN( i_cost, STREAM_CACHE_TRACK_SIZE / 2 );
+            i_skip_threshold = __MAX( i_skip_threshold, i_cost );
+        }
+    }
     else
         i_skip_threshold = INT64_MAX;
 
@@ -1202,202 +1409,399 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     }
     assert( i_tk_idx >= 0 && i_tk_idx < STREAM_CACHE_TRACK );
 
-    if( tk != p_current )
-        i_skip_threshold = 0;
-    if( tk->i_start <= i_pos && i_pos <= tk->i_end + i_skip_threshold )
+    if( tk == p_current && tk->i_start <= i_pos && i_pos <= tk->i_end )
     {
 #ifdef STREAM_DEBUG
-        msg_Err( s, "AStreamSeekStream: reusing %d start=%"PRId64
-                 " end=%"PRId64"(%s)",
-                 i_tk_idx, tk->i_start, tk->i_end,
-                 tk != p_current ? "seek" : i_pos > tk->i_end ? "skip" : "noseek" );
+        msg_Err( s, "AStreamSeekStream: noseek" );
 #endif
-        if( tk != p_current )
-        {
-            assert( b_aseek );
+        p_sys->i_pos = i_pos;
+        AStreamResumeStream( s );
+        vlc_mutex_unlock( &p_sys->stream.lock );
+        return VLC_SUCCESS;
+    }
 
-            /* Seek at the end of the buffer
-             * TODO it is stupid to seek now, it would be better to delay it
-             */
-            if( ASeek( s, tk->i_end ) )
-                return VLC_EGENERIC;
-        }
-        else if( i_pos > tk->i_end )
+    if( tk == p_current && i_pos <= tk->i_end + i_skip_threshold )
+    {
+        /* Read the data up to the new position */
+        uint64_t i_skip = i_pos - p_sys->i_pos;
+
+#ifdef STREAM_DEBUG
+        msg_Err( s, "AStreamSeekStream: skip %"PRIu64, i_skip );
+#endif
+        AStreamResumeStream( s );
+        vlc_mutex_unlock( &p_sys->stream.lock );
+        while( i_skip > 0 )
         {
-            uint64_t i_skip = i_pos - tk->i_end;
-            while( i_skip > 0 )
-            {
-                const int i_read_max = __MIN( 10 * STREAM_READ_ATONCE, i_skip );
-                if( AStreamReadNoSeekStream( s, NULL, i_read_max ) != i_read_max )
-                    return VLC_EGENERIC;
-                i_skip -= i_read_max;
-            }
+            const unsigned i_read_max =
+                __MIN( i_skip, STREAM_CACHE_TRACK_SIZE / 2 );
+            if( AStreamReadNoSeekStream( s, NULL, i_read_max ) != (int)i_read_max )
+                return VLC_EGENERIC;
+            i_skip -= i_read_max;
         }
+        return VLC_SUCCESS;
     }
-    else
-    {
+
+    /* Reuse the data of another track and seek the access at its end,
+     * else seek and start filling the oldest track.
+     * TODO it is stupid to seek now, it would be better to delay it */
+    const bool b_reuse = tk->i_start <= i_pos && i_pos <= tk->i_end;
+    const uint64_t i_seek = b_reuse ? tk->i_end : i_pos;
+
 #ifdef STREAM_DEBUG
-        msg_Err( s, "AStreamSeekStream: hard seek" );
+    msg_Err( s, "AStreamSeekStream: %s %d start=%"PRId64" end=%"PRId64,
+             b_reuse ? "reusing" : "hard seek", i_tk_idx,
+             tk->i_start, tk->i_end );
 #endif
-        /* Nothing good, seek and choose oldest segment */
-        if( ASeek( s, i_pos ) )
-            return VLC_EGENERIC;
+    assert( b_aseek || !b_reuse );
 
-        tk->i_start = i_pos;
-        tk->i_end   = i_pos;
-    }
-    p_sys->stream.i_offset = i_pos - tk->i_start;
-    p_sys->stream.i_tk = i_tk_idx;
-    p_sys->i_pos = i_pos;
+    vlc_mutex_unlock( &p_sys->stream.lock );
+
+    access_Lock( p_sys->p_access );
+    const mtime_t i_start = mdate();
+    int i_ret = ASeek( s, i_seek );
+    const mtime_t i_end = mdate();
+    access_Unlock( p_sys->p_access );
 
-    /* If there is not enough data left in the track, refill  */
-    /* TODO How to get a correct value for
-     *    - refilling threshold
-     *    - how much to refill
-     */
-    if( tk->i_end < tk->i_start + p_sys->stream.i_offset + p_sys->stream.i_read_size )
+    vlc_mutex_lock( &p_sys->stream.lock );
+    if( i_ret == VLC_SUCCESS )
     {
-        if( p_sys->stream.i_used < STREAM_READ_ATONCE / 2 )
-            p_sys->stream.i_used = STREAM_READ_ATONCE / 2;
+        if( !b_reuse )
+            tk->i_start = tk->i_end = i_pos;
+        p_sys->stream.i_tk = i_tk_idx;
+        p_sys->stream.b_eof = false;
+        p_sys->stream.i_rate_date = 0;
+        p_sys->i_pos = i_pos;
 
-        if( AStreamRefillStream( s ) && i_pos == tk->i_end )
-            return VLC_EGENERIC;
+        p_sys->stat.i_seek_time += i_end - i_start;
+        p_sys->stat.i_seek_count++;
     }
-    return VLC_SUCCESS;
+    AStreamResumeStream( s );
+
+    /* Seeking where no data can be read fails */
+    if( i_ret == VLC_SUCCESS && tk->i_end <= i_pos )
+    {
+        AStreamWaitStream( s, 1 );
+        if( tk->i_end <= i_pos )
+            i_ret = VLC_EGENERIC;
+    }
+    vlc_mutex_unlock( &p_sys->stream.lock );
+
+    return i_ret ? VLC_EGENERIC : VLC_SUCCESS;
 }
 
 static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_read )
 {
     stream_sys_t *p_sys = s->p_sys;
-    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+    stream_track_t *tk;
 
     uint8_t *p_data = (uint8_t *)p_read;
     unsigned int i_data = 0;
+    bool b_miss = false;
 
-    if( tk->i_start >= tk->i_end )
-        return 0; /* EOF */
+    vlc_mutex_lock( &p_sys->stream.lock );
+    tk = &p_sys->stream.tk[p_sys->stream.i_tk];
 
 #ifdef STREAM_DEBUG
     msg_Dbg( s, "AStreamReadStream: %d pos=%"PRId64" tk=%d start=%"PRId64
-             " offset=%d end=%"PRId64,
+             " end=%"PRId64,
              i_read, p_sys->i_pos, p_sys->stream.i_tk,
-             tk->i_start, p_sys->stream.i_offset, tk->i_end );
+             tk->i_start, tk->i_end );
 #endif
 
     while( i_data < i_read )
     {
-        unsigned i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
-        unsigned int i_current =
-            __MIN( tk->i_end - tk->i_start - p_sys->stream.i_offset,
-                   STREAM_CACHE_TRACK_SIZE - i_off );
-        int i_copy = __MIN( i_current, i_read - i_data );
+        if( tk->i_end <= p_sys->i_pos )
+        {
+            const unsigned i_wanted = __MIN( i_read - i_data,
+                                             STREAM_CACHE_TRACK_SIZE / 2 );
 
-        if( i_copy <= 0 ) break; /* EOF */
+            if( AStreamWaitStream( s, i_wanted ) )
+                b_miss = true;
+            if( tk->i_end <= p_sys->i_pos )
+                break; /* EOF */
+        }
 
-        /* Copy data */
-        /* msg_Dbg( s, "AStreamReadStream: copy %d", i_copy ); */
+        const unsigned i_off = p_sys->i_pos % STREAM_CACHE_TRACK_SIZE;
+        unsigned int i_copy =
+            __MIN( tk->i_end - p_sys->i_pos, STREAM_CACHE_TRACK_SIZE - i_off );
+        i_copy = __MIN( i_copy, i_read - i_data );
+
+        /* Copy data, the prefetcher does not write between i_pos and i_end */
         if( p_data )
         {
+            vlc_mutex_unlock( &p_sys->stream.lock );
             memcpy( p_data, &tk->p_buffer[i_off], i_copy );
+            vlc_mutex_lock( &p_sys->stream.lock );
             p_data += i_copy;
         }
         i_data += i_copy;
-        p_sys->stream.i_offset += i_copy;
 
         /* Update pos now */
         p_sys->i_pos += i_copy;
 
-        /* */
-        p_sys->stream.i_used += i_copy;
+        /* Wake up the prefetcher once half of the read-ahead is consumed */
+        if( tk->i_end < p_sys->i_pos + p_sys->stream.i_depth / 2 )
+            vlc_cond_signal( &p_sys->stream.wait );
+    }
 
-        if( tk->i_end + i_data <= tk->i_start + p_sys->stream.i_offset + i_read )
-        {
-            const unsigned i_read_requested = VLC_CLIP( i_read - i_data,
-                                                    STREAM_READ_ATONCE / 2,
-                                                    STREAM_READ_ATONCE * 10 );
+    if( b_miss )
+        p_sys->stat.i_miss_count++;
+    else
+        p_sys->stat.i_hit_count++;
+    vlc_mutex_unlock( &p_sys->stream.lock );
 
-            if( p_sys->stream.i_used < i_read_requested )
-                p_sys->stream.i_used = i_read_requested;
+    return i_data;
+}
 
-            if( AStreamRefillStream( s ) )
-            {
-                /* EOF */
-                if( tk->i_start >= tk->i_end ) break;
-            }
-        }
+/**
+ * Updates the access read size and the read-ahead depth after an access
+ * read of i_read bytes that took i_duration.
+ * The stream lock must be held.
+ */
+static void AStreamAdaptStream( stream_t *s, unsigned int i_read,
+                                mtime_t i_duration )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    const mtime_t i_now = mdate();
+
+    /* Access throughput and latency, smoothed over a few reads */
+    if( i_duration <= 0 )
+        i_duration = 1;
+    const uint64_t i_byterate = (uint64_t)i_read * CLOCK_FREQ / i_duration;
+    if( p_sys->stream.i_byterate == 0 )
+    {
+        p_sys->stream.i_byterate = i_byterate;
+        p_sys->stream.i_latency = i_duration;
+    }
+    else
+    {
+        p_sys->stream.i_byterate = ( 7 * p_sys->stream.i_byterate + i_byterate ) / 8;
+        p_sys->stream.i_latency = ( 7 * p_sys->stream.i_latency + i_duration ) / 8;
     }
 
-    return i_data;
-}
+    /* Reader bitrate, measured over periods of at least 250 ms */
+    if( p_sys->stream.i_rate_date == 0 || p_sys->i_pos < p_sys->stream.i_rate_pos )
+    {
+        p_sys->stream.i_rate_date = i_now;
+        p_sys->stream.i_rate_pos = p_sys->i_pos;
+    }
+    else if( i_now - p_sys->stream.i_rate_date >= CLOCK_FREQ / 4 )
+    {
+        const uint64_t i_bitrate =
+            ( p_sys->i_pos - p_sys->stream.i_rate_pos ) * CLOCK_FREQ /
+            ( i_now - p_sys->stream.i_rate_date );
 
+        if( p_sys->stream.i_bitrate == 0 )
+            p_sys->stream.i_bitrate = i_bitrate;
+        else
+            p_sys->stream.i_bitrate = ( 3 * p_sys->stream.i_bitrate + i_bitrate ) / 4;
+        p_sys->stream.i_rate_date = i_now;
+        p_sys->stream.i_rate_pos = p_sys->i_pos;
+    }
+
+    /* A read should not keep the access busy for long */
+    const uint64_t i_read_size =
+        p_sys->stream.i_byterate * STREAM_READ_DURATION / CLOCK_FREQ;
+    p_sys->stream.i_read_size = VLC_CLIP( i_read_size, STREAM_READ_MIN,
+                                          STREAM_READ_MAX );
+
+    /* Keep enough data to cover STREAM_PREFETCH_DURATION and a few access
+     * reads, more if the reader stalled before */
+    uint64_t i_depth = p_sys->stream.i_bitrate *
+        ( STREAM_PREFETCH_DURATION + 4 * p_sys->stream.i_latency ) / CLOCK_FREQ;
+    i_depth = ( i_depth + 2 * p_sys->stream.i_read_size ) << p_sys->stream.i_boost;
+    p_sys->stream.i_depth = __MIN( i_depth, STREAM_CACHE_TRACK_SIZE -
+                                            p_sys->stream.i_read_size );
+}
 
-static int AStreamRefillStream( stream_t *s )
+/**
+ * Reads once from the access at the end of the current track.
+ * The stream lock must be held, it is released during the access read.
+ * \return VLC_EGENERIC at the end of the stream, VLC_SUCCESS otherwise.
+ */
+static int AStreamFillStream( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
+    access_t *p_access = p_sys->p_access;
     stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
 
-    /* We read but won't increase i_start after initial start + offset */
-    int i_toread =
-        __MIN( p_sys->stream.i_used, STREAM_CACHE_TRACK_SIZE -
-               (tk->i_end - tk->i_start - p_sys->stream.i_offset) );
-    bool b_read = false;
-    int64_t i_start, i_stop;
+    if( s->b_die )
+        p_sys->stream.b_eof = true;
+    if( p_sys->stream.b_eof )
+        return VLC_EGENERIC;
+
+    /* We read but never overwrite the data after i_pos */
+    const unsigned i_off = tk->i_end % STREAM_CACHE_TRACK_SIZE;
+    unsigned i_toread = STREAM_CACHE_TRACK_SIZE - ( tk->i_end - p_sys->i_pos );
+    i_toread = __MIN( i_toread, STREAM_CACHE_TRACK_SIZE - i_off );
+    i_toread = __MIN( i_toread, p_sys->stream.i_read_size );
+    if( i_toread == 0 )
+        return VLC_SUCCESS;
 
-    if( i_toread <= 0 ) return VLC_EGENERIC; /* EOF */
+    /* The data about to be overwritten leaves the track before the lock is
+     * released, so that no seek goes back into it during the read */
+    if( tk->i_start + STREAM_CACHE_TRACK_SIZE < tk->i_end + i_toread )
+        tk->i_start = tk->i_end + i_toread - STREAM_CACHE_TRACK_SIZE;
 
 #ifdef STREAM_DEBUG
-    msg_Dbg( s, "AStreamRefillStream: used=%d toread=%d",
-                 p_sys->stream.i_used, i_toread );
+    msg_Dbg( s, "AStreamFillStream: pos=%"PRId64" end=%"PRId64" toread=%u",
+             p_sys->i_pos, tk->i_end, i_toread );
 #endif
 
-    i_start = mdate();
-    while( i_toread > 0 )
-    {
-        int i_off = tk->i_end % STREAM_CACHE_TRACK_SIZE;
-        int i_read;
+    p_sys->stream.b_reading = true;
+    vlc_mutex_unlock( &p_sys->stream.lock );
 
-        if( s->b_die )
-            return VLC_EGENERIC;
+    bool b_can_seek, b_can_fastseek;
 
-        i_read = __MIN( i_toread, STREAM_CACHE_TRACK_SIZE - i_off );
-        i_read = AReadStream( s, &tk->p_buffer[i_off], i_read );
+    access_Lock( p_access );
+    const mtime_t i_start = mdate();
+    const int i_read = AReadStream( s, &tk->p_buffer[i_off], i_toread );
+    const mtime_t i_stop = mdate();
+    access_Control( p_access, ACCESS_CAN_SEEK, &b_can_seek );
+    access_Control( p_access, ACCESS_CAN_FASTSEEK, &b_can_fastseek );
+    access_Unlock( p_access );
 
-        /* msg_Dbg( s, "AStreamRefillStream: read=%d", i_read ); */
-        if( i_read <  0 )
-        {
-            continue;
-        }
-        else if( i_read == 0 )
-        {
-            if( !b_read )
-                return VLC_EGENERIC;
-            return VLC_SUCCESS;
-        }
-        b_read = true;
+    vlc_mutex_lock( &p_sys->stream.lock );
+    p_sys->stream.b_reading = false;
+    p_sys->stream.b_can_seek = b_can_seek;
+    p_sys->stream.b_can_fastseek = b_can_fastseek;
 
+    if( i_read > 0 )
+    {
         /* Update end */
         tk->i_end += i_read;
 
-        /* Windows of STREAM_CACHE_TRACK_SIZE */
-        if( tk->i_start + STREAM_CACHE_TRACK_SIZE < tk->i_end )
+        p_sys->stat.i_bytes += i_read;
+        p_sys->stat.i_read_count++;
+        p_sys->stat.i_read_time += i_stop - i_start;
+
+        AStreamAdaptStream( s, i_read, i_stop - i_start );
+    }
+    else if( i_read == 0 || s->b_die )
+        p_sys->stream.b_eof = true;
+
+    vlc_cond_broadcast( &p_sys->stream.done );
+    return p_sys->stream.b_eof ? VLC_EGENERIC : VLC_SUCCESS;
+}
+
+/**
+ * Waits until i_size bytes are buffered after the reading position, or the
+ * end of the stream. Without prefetch thread, the access is read directly.
+ * The stream lock must be held.
+ * \return true if the reader had to wait for the access.
+ */
+static bool AStreamWaitStream( stream_t *s, unsigned int i_size )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+    const uint64_t i_want = p_sys->i_pos + i_size;
+
+    if( tk->i_end >= i_want || p_sys->stream.b_eof )
+        return false;
+
+    /* The reader caught up with the prefetcher, read further ahead.
+     * Waiting at the start of a track (after a seek) is expected. */
+    if( p_sys->i_pos > tk->i_start &&
+        p_sys->stream.i_boost < STREAM_PREFETCH_BOOST_MAX )
+        p_sys->stream.i_boost++;
+
+    const mtime_t i_start = mdate();
+
+    p_sys->stream.i_want = i_want;
+    while( tk->i_end < i_want && !p_sys->stream.b_eof )
+    {
+        if( p_sys->stream.b_thread && !p_sys->stream.b_paused )
         {
-            unsigned i_invalid = tk->i_end - tk->i_start - STREAM_CACHE_TRACK_SIZE;
+            vlc_cond_signal( &p_sys->stream.wait );
+            vlc_cond_wait( &p_sys->stream.done, &p_sys->stream.lock );
+        }
+        else
+            AStreamFillStream( s );
+    }
+    p_sys->stream.i_want = 0;
 
-            tk->i_start += i_invalid;
-            p_sys->stream.i_offset -= i_invalid;
+    p_sys->stat.i_stall_time += mdate() - i_start;
+    return true;
+}
+
+/**
+ * Prevents the prefetcher from using the access, waiting for its current
+ * read to complete. The stream lock must be held.
+ */
+static void AStreamPauseStream( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    p_sys->stream.b_paused = true;
+    while( p_sys->stream.b_reading )
+        vlc_cond_wait( &p_sys->stream.done, &p_sys->stream.lock );
+}
+
+static void AStreamResumeStream( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    p_sys->stream.b_paused = false;
+    vlc_cond_signal( &p_sys->stream.wait );
+}
+
+static void *AStreamPrefetchThread( void *data )
+{
+    stream_t *s = data;
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->stream.lock );
+    while( !p_sys->stream.b_exit )
+    {
+        const stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+        const uint64_t i_target = __MAX( p_sys->i_pos + p_sys->stream.i_depth,
+                                         p_sys->stream.i_want );
+
+        if( p_sys->stream.b_paused || p_sys->stream.b_eof ||
+            tk->i_end >= i_target )
+        {
+            vlc_cond_wait( &p_sys->stream.wait, &p_sys->stream.lock );
+            continue;
         }
+        AStreamFillStream( s );
+    }
+    vlc_mutex_unlock( &p_sys->stream.lock );
+    return NULL;
+}
 
-        i_toread -= i_read;
-        p_sys->stream.i_used -= i_read;
+static void AStreamStartStream( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
 
-        p_sys->stat.i_bytes += i_read;
-        p_sys->stat.i_read_count++;
+    if( vlc_clone( &p_sys->stream.thread, AStreamPrefetchThread, s,
+                   VLC_THREAD_PRIORITY_INPUT ) )
+    {
+        msg_Warn( s, "cannot start the prefetch thread" );
+        return;
     }
-    i_stop = mdate();
+    p_sys->stream.b_thread = true;
+}
 
-    p_sys->stat.i_read_time += i_stop - i_start;
+static void AStreamStopStream( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
 
-    return VLC_SUCCESS;
+    if( !p_sys->stream.b_thread )
+        return;
+
+    vlc_mutex_lock( &p_sys->stream.lock );
+    p_sys->stream.b_exit = true;
+    vlc_cond_signal( &p_sys->stream.wait );
+    vlc_mutex_unlock( &p_sys->stream.lock );
+
+    /* Interrupts an access read blocking the thread */
+    vlc_object_kill( s );
+    vlc_object_kill( p_sys->p_access );
+    if( p_sys->p_list_access != NULL )
+        vlc_object_kill( p_sys->p_list_access );
+
+    vlc_join( p_sys->stream.thread, NULL );
+    p_sys->stream.b_thread = false;
 }
 
 static void AStreamPrebufferStream( stream_t *s )
@@ -1409,52 +1813,40 @@ static void AStreamPrebufferStream( stream_t *s )
 
     msg_Dbg( s, "starting pre-buffering" );
     i_start = mdate();
+    vlc_mutex_lock( &p_sys->stream.lock );
     for( ;; )
     {
         stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
 
         int64_t i_date = mdate();
-        int i_read;
         int i_buffered = tk->i_end - tk->i_start;
 
         if( s->b_die || i_buffered >= STREAM_CACHE_PREBUFFER_SIZE )
         {
             int64_t i_byterate;
 
-            /* Update stat */
-            p_sys->stat.i_bytes = i_buffered;
-            p_sys->stat.i_read_time = i_date - i_start;
-            i_byterate = ( INT64_C(1000000) * p_sys->stat.i_bytes ) /
-                         (p_sys->stat.i_read_time+1);
+            i_byterate = ( INT64_C(1000000) * i_buffered ) /
+                         ( i_date - i_start + 1 );
 
-            msg_Dbg( s, "pre-buffering done %"PRId64" bytes in %"PRId64"s - "
+            msg_Dbg( s, "pre-buffering done %d bytes in %"PRId64"s - "
                      "%"PRId64" KiB/s",
-                     p_sys->stat.i_bytes,
-                     p_sys->stat.i_read_time / INT64_C(1000000),
+                     i_buffered, ( i_date - i_start ) / INT64_C(1000000),
                      i_byterate / 1024 );
             break;
         }
 
         /* */
-        i_read = STREAM_CACHE_TRACK_SIZE - i_buffered;
-        i_read = __MIN( (int)p_sys->stream.i_read_size, i_read );
-        i_read = AReadStream( s, &tk->p_buffer[i_buffered], i_read );
-        if( i_read <  0 )
-            continue;
-        else if( i_read == 0 )
+        if( AStreamFillStream( s ) )
             break;  /* EOF */
 
-        if( i_first == 0 )
+        if( i_first == 0 && tk->i_end > tk->i_start )
         {
             i_first = mdate();
             msg_Dbg( s, "received first data after %d ms",
                      (int)((i_first-i_start)/1000) );
         }
-
-        tk->i_end += i_read;
-
-        p_sys->stat.i_read_count++;
     }
+    vlc_mutex_unlock( &p_sys->stream.lock );
 }
 
 /****************************************************************************
@@ -1684,7 +2076,6 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
     access_t *p_access = p_sys->p_access;
     input_thread_t *p_input = s->p_input;
     int i_read_orig = i_read;
-    int i_total = 0;
 
     if( !p_sys->i_list )
     {
@@ -1693,13 +2084,8 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
             vlc_object_kill( s );
         if( p_input )
         {
-            vlc_mutex_lock( &p_input->p->counters.counters_lock );
-            stats_UpdateInteger( s, p_input->p->counters.p_read_bytes, i_read,
-                             &i_total );
-            stats_UpdateFloat( s, p_input->p->counters.p_input_bitrate,
-                           (float)i_total, NULL );
-            stats_UpdateInteger( s, p_input->p->counters.p_read_packets, 1, NULL );
-            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+            stats_MetricAdd( p_input->p->counters.p_read_bytes, i_read );
+            stats_MetricAdd( p_input->p->counters.p_read_packets, 1 );
         }
         return i_read;
     }
@@ -1733,12 +2119,8 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
     /* Update read bytes in input */
     if( p_input )
     {
-        vlc_mutex_lock( &p_input->p->counters.counters_lock );
-        stats_UpdateInteger( s, p_input->p->counters.p_read_bytes, i_read, &i_total );
-        stats_UpdateFloat( s, p_input->p->counters.p_input_bitrate,
-                       (float)i_total, NULL );
-        stats_UpdateInteger( s, p_input->p->counters.p_read_packets, 1, NULL );
-        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+        stats_MetricAdd( p_input->p->counters.p_read_bytes, i_read );
+        stats_MetricAdd( p_input->p->counters.p_read_packets, 1 );
     }
     return i_read;
 }
@@ -1750,7 +2132,6 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
     input_thread_t *p_input = s->p_input;
     block_t *p_block;
     bool b_eof;
-    int i_total = 0;
 
     if( !p_sys->i_list )
     {
@@ -1760,13 +2141,9 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
         if( pb_eof ) *pb_eof = p_access->info.b_eof;
         if( p_input && p_block && libvlc_stats (p_access) )
         {
-            vlc_mutex_lock( &p_input->p->counters.counters_lock );
-            stats_UpdateInteger( s, p_input->p->counters.p_read_bytes,
-                                 p_block->i_buffer, &i_total );
-            stats_UpdateFloat( s, p_input->p->counters.p_input_bitrate,
-                              (float)i_total, NULL );
-            stats_UpdateInteger( s, p_input->p->counters.p_read_packets, 1, NULL );
-            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+            stats_MetricAdd( p_input->p->counters.p_read_bytes,
+                             p_block->i_buffer );
+            stats_MetricAdd( p_input->p->counters.p_read_packets, 1 );
         }
         return p_block;
     }
@@ -1797,19 +2174,11 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
         /* We have to read some data */
         return AReadBlock( s, pb_eof );
     }
-    if( p_block )
+    if( p_block && p_input )
     {
-        if( p_input )
-        {
-            vlc_mutex_lock( &p_input->p->counters.counters_lock );
-            stats_UpdateInteger( s, p_input->p->counters.p_read_bytes,
-                                 p_block->i_buffer, &i_total );
-            stats_UpdateFloat( s, p_input->p->counters.p_input_bitrate,
-                              (float)i_total, NULL );
-            stats_UpdateInteger( s, p_input->p->counters.p_read_packets,
-                                 1 , NULL);
-            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
-        }
+        stats_MetricAdd( p_input->p->counters.p_read_bytes,
+                         p_block->i_buffer );
+        stats_MetricAdd( p_input->p->counters.p_read_packets, 1 );
     }
     return p_block;
 }
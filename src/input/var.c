@@ -220,6 +220,18 @@ void input_ControlVarInit ( input_thread_t *p_input )
     var_Create( p_input, "bit-rate", VLC_VAR_INTEGER );
     var_Create( p_input, "sample-rate", VLC_VAR_INTEGER );
 
+    /* Handles for the frequent reads, released by the destructor */
+    p_input->p->var.state = var_Resolve( p_input, "state", VLC_VAR_INTEGER );
+    p_input->p->var.rate = var_Resolve( p_input, "rate", VLC_VAR_FLOAT );
+    p_input->p->var.position = var_Resolve( p_input, "position",
+                                            VLC_VAR_FLOAT );
+    p_input->p->var.time = var_Resolve( p_input, "time", VLC_VAR_TIME );
+    p_input->p->var.length = var_Resolve( p_input, "length", VLC_VAR_TIME );
+    p_input->p->var.audio_delay = var_Resolve( p_input, "audio-delay",
+                                               VLC_VAR_TIME );
+    p_input->p->var.spu_delay = var_Resolve( p_input, "spu-delay",
+                                             VLC_VAR_TIME );
+
     if( !p_input->b_preparsing )
     {
         /* Special "intf-event" variable. */
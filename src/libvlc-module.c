@@ -236,6 +236,12 @@ static const char *const ppsz_snap_formats[] =
     "over rules applying to object types. Note that you still need to " \
     "use -vvv to actually display debug message.")
 
+#define LOG_QUEUE_TEXT N_("Queued log messages per thread")
+#define LOG_QUEUE_LONGTEXT N_( \
+    "This is how many log messages each thread can queue for the logger " \
+    "thread. Beyond that, the thread formats its messages itself, which " \
+    "may show them out of order. This is rounded down to a power of two.")
+
 #define QUIET_TEXT N_("Be quiet")
 #define QUIET_LONGTEXT N_( \
     "Turn off all warning and information messages.")
@@ -970,6 +976,11 @@ static const char *const ppsz_prefres[] = {
     "However allocation of port numbers below 1025 is usually restricted " \
     "by the operating system." )
 
+#define HTTP_MAX_CLIENTS_TEXT N_( "Maximum number of clients" )
+#define HTTP_MAX_CLIENTS_LONGTEXT N_( \
+    "Connections beyond this number of clients are rejected, " \
+    "per HTTP, HTTPS or RTSP server port (0 = unlimited)." )
+
 #define RTSP_PORT_TEXT N_( "RTSP server port" )
 #define RTSP_PORT_LONGTEXT N_( \
     "The RTSP server will listen on this TCP port. " \
@@ -1107,6 +1118,12 @@ static const char *const ppsz_prefres[] = {
     "This allow you to configure the initial caching amount for stream output " \
     " muxer. This value should be set in milliseconds." )
 
+#define SOUT_REMUX_DIRECT_TEXT N_("Remux from the input thread")
+#define SOUT_REMUX_DIRECT_LONGTEXT N_( \
+    "When the stream output only copies the streams (no transcoding), " \
+    "the input packetizes and sends them itself, instead of one thread " \
+    "per elementary stream." )
+
 #define PACKETIZER_TEXT N_("Preferred packetizer list")
 #define PACKETIZER_LONGTEXT N_( \
     "This allows you to select the order in which VLC will choose its " \
@@ -1212,6 +1229,17 @@ static const char *const ppsz_prefres[] = {
 #define STATS_LONGTEXT N_( \
      "Collect miscellaneous local statistics about the playing media.")
 
+#define TRACE_TEXT N_("Trace the playback pipeline")
+#define TRACE_LONGTEXT N_( \
+     "Time each stage of the pipeline, from the demuxer to the display, " \
+     "the audio output or the stream output. With statistics enabled, " \
+     "the latency of each stage is collected.")
+
+#define TRACE_FILE_TEXT N_("Trace file")
+#define TRACE_FILE_LONGTEXT N_( \
+     "Write the timeline of the pipeline stages to this file when exiting, " \
+     "in the Chrome trace format. This enables tracing.")
+
 #define DAEMON_TEXT N_("Run as daemon process")
 #define DAEMON_LONGTEXT N_( \
      "Runs VLC as a background daemon process.")
@@ -1297,6 +1325,17 @@ static const char *const ppsz_albumart_descriptions[] =
       N_("When track starts playing"),
       N_("As soon as track is added") };
 
+#define ART_CACHE_SIZE_TEXT N_( "Album art cache size (MiB)" )
+#define ART_CACHE_SIZE_LONGTEXT N_( \
+    "The least recently used album art is removed from the cache " \
+    "beyond this size (0 means no limit)." )
+
+#define ART_THUMBNAILS_TEXT N_( "Album art thumbnail sizes" )
+#define ART_THUMBNAILS_LONGTEXT N_( \
+    "Comma-separated list of the sizes in pixels of the thumbnails " \
+    "generated along with the album art in the cache. They are stored " \
+    "next to the art, as <art>-<size>.png." )
+
 #define SD_TEXT N_( "Services discovery modules")
 #define SD_LONGTEXT N_( \
      "Specifies the services discovery modules to preload, separated by " \
@@ -1911,6 +1950,9 @@ vlc_module_begin ()
         change_integer_range( 1, 65535 )
     add_integer( "https-port", 8443, HTTPS_PORT_TEXT, HTTPS_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
+    add_integer( "http-max-clients", 0, HTTP_MAX_CLIENTS_TEXT,
+                 HTTP_MAX_CLIENTS_LONGTEXT, true )
+        change_integer_range( 0, 1000000 )
     add_string( "rtsp-host", NULL, RTSP_HOST_TEXT, RTSP_HOST_LONGTEXT, true )
     add_integer( "rtsp-port", 554, RTSP_PORT_TEXT, RTSP_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
@@ -2074,6 +2116,8 @@ vlc_module_begin ()
                                 SOUT_SPU_LONGTEXT, true )
     add_integer( "sout-mux-caching", 1500, SOUT_MUX_CACHING_TEXT,
                                 SOUT_MUX_CACHING_LONGTEXT, true )
+    add_bool( "sout-remux-direct", true, SOUT_REMUX_DIRECT_TEXT,
+                                SOUT_REMUX_DIRECT_LONGTEXT, true )
 
     set_section( N_("VLM"), NULL )
     add_loadfile( "vlm-conf", NULL, VLM_CONF_TEXT,
@@ -2207,6 +2251,11 @@ vlc_module_begin ()
                  ALBUM_ART_LONGTEXT, false )
         change_integer_list( pi_albumart_values,
                              ppsz_albumart_descriptions )
+    add_integer( "album-art-cache-size", 64, ART_CACHE_SIZE_TEXT,
+                 ART_CACHE_SIZE_LONGTEXT, true )
+        change_integer_range( 0, 1 << 20 )
+    add_string( "album-art-thumbnails", "64,256", ART_THUMBNAILS_TEXT,
+                ART_THUMBNAILS_LONGTEXT, true )
 
     set_subcategory( SUBCAT_PLAYLIST_SD )
     add_string( "services-discovery", "", SD_TEXT, SD_LONGTEXT, true )
@@ -2220,6 +2269,9 @@ vlc_module_begin ()
         change_short('v')
     add_string( "verbose-objects", 0, VERBOSE_OBJECTS_TEXT, VERBOSE_OBJECTS_LONGTEXT,
                  false )
+    add_integer( "log-queue", 128, LOG_QUEUE_TEXT, LOG_QUEUE_LONGTEXT,
+                 true )
+        change_integer_range( 16, 65536 )
     add_bool( "quiet", 0, QUIET_TEXT, QUIET_LONGTEXT, false )
         change_short('q')
 
@@ -2251,6 +2303,9 @@ vlc_module_begin ()
               INTERACTION_LONGTEXT, false )
 
     add_bool ( "stats", true, STATS_TEXT, STATS_LONGTEXT, true )
+    add_bool ( "trace", false, TRACE_TEXT, TRACE_LONGTEXT, true )
+    add_savefile( "trace-file", NULL, TRACE_FILE_TEXT, TRACE_FILE_LONGTEXT,
+                  true )
 
     set_subcategory( SUBCAT_INTERFACE_MAIN )
     add_module_cat( "intf", SUBCAT_INTERFACE_MAIN, NULL, INTF_TEXT,
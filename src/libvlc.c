@@ -194,7 +194,11 @@ libvlc_int_t * libvlc_InternalCreate( void )
     /* Initialize mutexes */
     vlc_mutex_init( &priv->ml_lock );
     vlc_mutex_init( &priv->timer_lock );
+    vlc_mutex_init( &priv->metrics_lock );
+    priv->p_metrics = NULL;
+    priv->p_trace = NULL;
     vlc_ExitInit( &priv->exit );
+    vlc_LogInit( );
 
     return p_libvlc;
 }
@@ -272,6 +276,7 @@ int libvlc_InternalInit( libvlc_int_t *p_libvlc, int i_argc,
         return VLC_EGENERIC;
     }
     priv->i_verbose = var_InheritInteger( p_libvlc, "verbose" );
+    vlc_LogResize( var_InheritInteger( p_libvlc, "log-queue" ) );
 
     /*
      * Support for gettext
@@ -525,6 +530,7 @@ int libvlc_InternalInit( libvlc_int_t *p_libvlc, int i_argc,
     priv->b_stats = var_InheritBool( p_libvlc, "stats" );
     priv->i_timers = 0;
     priv->pp_timers = NULL;
+    vlc_trace_Init( p_libvlc );
 
     /*
      * Initialize hotkey handling
@@ -832,8 +838,12 @@ void libvlc_InternalDestroy( libvlc_int_t *p_libvlc )
 
     /* Destroy mutexes */
     vlc_ExitDestroy( &priv->exit );
+    vlc_trace_Deinit( p_libvlc );
+    assert( priv->p_metrics == NULL );
+    vlc_mutex_destroy( &priv->metrics_lock );
     vlc_mutex_destroy( &priv->timer_lock );
     vlc_mutex_destroy( &priv->ml_lock );
+    vlc_LogDeinit( );
 
 #ifndef NDEBUG /* Hack to dump leaked objects tree */
     if( vlc_internals( p_libvlc )->i_refcount > 1 )
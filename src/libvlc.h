@@ -46,6 +46,13 @@ void system_End       ( void );
 void vlc_CPU_init(void);
 void vlc_CPU_dump(vlc_object_t *);
 
+/*
+ * Messages
+ */
+void vlc_LogInit (void);
+void vlc_LogResize (unsigned);
+void vlc_LogDeinit (void);
+
 /*
  * Threads subsystem
  */
@@ -161,6 +168,8 @@ struct vlc_object_internals
 #define vlc_externals( priv ) ((vlc_object_t *)((priv) + 1))
 
 typedef struct sap_handler_t sap_handler_t;
+typedef struct stats_metric_t stats_metric_t;
+typedef struct vlc_trace_t vlc_trace_t;
 
 /**
  * Private LibVLC instance data.
@@ -180,6 +189,9 @@ typedef struct libvlc_priv_t
     vlc_mutex_t        timer_lock;  ///< Lock to protect timers
     counter_t        **pp_timers;   ///< Array of all timers
     int                i_timers;    ///< Number of timers
+    vlc_mutex_t        metrics_lock; ///< Lock to protect the metrics list
+    stats_metric_t    *p_metrics;    ///< Metrics, for stats_Export()
+    vlc_trace_t       *p_trace;      ///< Pipeline tracer (or NULL)
 
     /* Singleton objects */
     module_t          *p_memcpy_module;  ///< Fast memcpy plugin used
@@ -227,70 +239,62 @@ void var_OptionParse (vlc_object_t *, const char *, bool trusted);
 /*
  * Stats stuff
  */
-int stats_Update (vlc_object_t*, counter_t *, vlc_value_t, vlc_value_t *);
 counter_t * stats_CounterCreate (vlc_object_t*, int, int);
 #define stats_CounterCreate(a,b,c) stats_CounterCreate( VLC_OBJECT(a), b, c )
-int stats_Get (vlc_object_t*, counter_t *, vlc_value_t*);
-#define stats_Get(a,b,c) stats_Get( VLC_OBJECT(a), b, c)
 
 void stats_CounterClean (counter_t * );
 
-static inline int stats_GetInteger( vlc_object_t *p_obj, counter_t *p_counter,
-                                    int64_t *value )
-{
-    int i_ret;
-    vlc_value_t val; val.i_int = 0;
-    if( !p_counter ) return VLC_EGENERIC;
-    i_ret = stats_Get( p_obj, p_counter, &val );
-    *value = val.i_int;
-    return i_ret;
-}
-#define stats_GetInteger(a,b,c) stats_GetInteger( VLC_OBJECT(a), b, c )
-
-static inline int stats_GetFloat( vlc_object_t *p_obj, counter_t *p_counter,
-                                    float *value )
-{
-    int i_ret;
-    vlc_value_t val; val.f_float = 0.0;
-    if( !p_counter ) return VLC_EGENERIC;
-    i_ret = stats_Get( p_obj, p_counter, &val );
-    *value = val.f_float;
-    return i_ret;
-}
-#define stats_GetFloat(a,b,c) stats_GetFloat( VLC_OBJECT(a), b, c )
-
-static inline int stats_UpdateInteger( vlc_object_t *p_obj,counter_t *p_co,
-                                         int i, int *pi_new )
+/**
+ * Lock-free statistics: updates go to one of several shards, chosen after
+ * the calling thread, and the shards are only summed when read.
+ */
+enum
 {
-    int i_ret;
-    vlc_value_t val;
-    vlc_value_t new_val; new_val.i_int = 0;
-    if( !p_co ) return VLC_EGENERIC;
-    val.i_int = i;
-    i_ret = stats_Update( p_obj, p_co, val, &new_val );
-    if( pi_new )
-        *pi_new = new_val.i_int;
-    return i_ret;
-}
-#define stats_UpdateInteger(a,b,c,d) stats_UpdateInteger( VLC_OBJECT(a),b,c,d )
+    STATS_METRIC_COUNTER,   ///< Only goes up
+    STATS_METRIC_GAUGE,     ///< Goes up and down
+    STATS_METRIC_HISTOGRAM, ///< Distribution of values, in powers of two
+};
 
-static inline int stats_UpdateFloat( vlc_object_t *p_obj, counter_t *p_co,
-                                       float f, float *pf_new )
-{
-    vlc_value_t val;
-    int i_ret;
-    vlc_value_t new_val;new_val.f_float = 0.0;
-    if( !p_co ) return VLC_EGENERIC;
-    val.f_float = f;
-    i_ret =  stats_Update( p_obj, p_co, val, &new_val );
-    if( pf_new )
-        *pf_new = new_val.f_float;
-    return i_ret;
-}
-#define stats_UpdateFloat(a,b,c,d) stats_UpdateFloat( VLC_OBJECT(a),b,c,d )
+stats_metric_t *stats_MetricNew (vlc_object_t *, int type, const char *name,
+                                 ...);
+#define stats_MetricNew(o, ...) stats_MetricNew(VLC_OBJECT(o), __VA_ARGS__)
+void stats_MetricDelete (stats_metric_t *);
+void stats_MetricAdd (stats_metric_t *, int64_t);
+void stats_MetricRecord (stats_metric_t *, int64_t);
+int64_t stats_MetricGet (const stats_metric_t *);
 
 void stats_ComputeInputStats(input_thread_t*, input_stats_t*);
 void stats_ReinitInputStats(input_stats_t *);
 void stats_DumpInputStats(input_stats_t *);
 
+/*
+ * Pipeline tracing
+ */
+enum
+{
+    VLC_TRACE_DEMUX,         ///< demux_Demux() call
+    VLC_TRACE_DECODER_QUEUE, ///< Wait of a block in the decoder FIFO
+    VLC_TRACE_DECODE,        ///< Processing of a block by the decoder
+    VLC_TRACE_AUDIO_PLAY,    ///< aout_DecPlay() call
+    VLC_TRACE_AUDIO_LATENCY, ///< From the decoder FIFO to the audio output
+    VLC_TRACE_VIDEO_RENDER,  ///< Filtering and blending of a picture
+    VLC_TRACE_VIDEO_DISPLAY, ///< vout_display_Display() call
+    VLC_TRACE_VIDEO_LATENCY, ///< From the decoder FIFO to the display
+    VLC_TRACE_SOUT_MUX,      ///< Muxing after a buffer was sent
+    VLC_TRACE_SOUT_WRITE,    ///< sout_AccessOutWrite() call
+    VLC_TRACE_STAGES
+};
+
+void vlc_trace_Init (libvlc_int_t *);
+void vlc_trace_Deinit (libvlc_int_t *);
+void vlc_trace_Span (vlc_object_t *, int stage, mtime_t start, mtime_t end);
+#define vlc_trace_Span(o,s,a,b) vlc_trace_Span(VLC_OBJECT(o),s,a,b)
+
+/**
+ * Whether the pipeline is traced, so that the trace points cost one test
+ * otherwise.
+ */
+#define vlc_trace_Enabled(o) \
+    (libvlc_priv((VLC_OBJECT(o))->p_libvlc)->p_trace != NULL)
+
 #endif
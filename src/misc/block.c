@@ -71,6 +71,7 @@ void block_Init( block_t *restrict b, void *buf, size_t size )
     b->i_pts =
     b->i_dts = VLC_TS_INVALID;
     b->i_length = 0;
+    b->i_trace_date = VLC_TS_INVALID;
 #ifndef NDEBUG
     b->pf_release = BlockNoRelease;
 #endif
@@ -89,6 +90,7 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
     out->i_pts     = in->i_pts;
     out->i_flags   = in->i_flags;
     out->i_length  = in->i_length;
+    out->i_trace_date = in->i_trace_date;
 }
 
 /* Memory alignment (must be a multiple of sizeof(void*) and a power of two) */
@@ -125,6 +125,18 @@ VLC_SSE static void SSE4_2_test (void)
     asm volatile ("pcmpgtq %%xmm1, %%xmm0\n" : : : "xmm0", "xmm1");
 }
 #endif
+#if defined (CAN_COMPILE_AVX) && !defined (__AVX__)
+VLC_AVX static void AVX_test (void)
+{
+    asm volatile ("vxorps %%ymm1, %%ymm1, %%ymm0\n" : : : "xmm0", "xmm1");
+}
+#endif
+#if defined (CAN_COMPILE_AVX2) && !defined (__AVX2__)
+VLC_AVX2 static void AVX2_test (void)
+{
+    asm volatile ("vpxor %%ymm1, %%ymm1, %%ymm0\n" : : : "xmm0", "xmm1");
+}
+#endif
 #if defined (CAN_COMPILE_3DNOW) && !defined (__3dNOW__)
 VLC_MMX static void ThreeD_Now_test (void)
 {
@@ -153,7 +165,7 @@ void vlc_CPU_init (void)
     uint32_t i_capabilities = 0;
 
 #if defined( __i386__ ) || defined( __x86_64__ )
-     unsigned int i_eax, i_ebx, i_ecx, i_edx;
+     unsigned int i_eax, i_ebx, i_ecx, i_edx, i_level;
      bool b_amd;
 
     /* Needed for x86 CPU capabilities detection */
@@ -163,13 +175,13 @@ void vlc_CPU_init (void)
                    "cpuid\n\t" \
                    "xchgl %%ebx,%1\n\t" \
                    : "=a" (i_eax), "=r" (i_ebx), "=c" (i_ecx), "=d" (i_edx) \
-                   : "a" (reg) \
+                   : "a" (reg), "c" (0) \
                    : "cc");
 # else
 #  define cpuid(reg) \
      asm volatile ("cpuid\n\t" \
                    : "=a" (i_eax), "=b" (i_ebx), "=c" (i_ecx), "=d" (i_edx) \
-                   : "a" (reg) \
+                   : "a" (reg), "c" (0) \
                    : "cc");
 # endif
      /* Check if the OS really supports the requested instructions */
@@ -199,6 +211,7 @@ void vlc_CPU_init (void)
 
     /* the CPU supports the CPUID instruction - get its level */
     cpuid( 0x00000000 );
+    i_level = i_eax;
 
 # if defined (__i386__) && !defined (__i586__) \
   && !defined (__i686__) && !defined (__pentium4__) \
@@ -268,6 +281,35 @@ void vlc_CPU_init (void)
         i_capabilities |= CPU_CAPABILITY_SSE4_2;
 # endif
 
+# if defined (__AVX__)
+    i_capabilities |= CPU_CAPABILITY_AVX;
+# elif defined (CAN_COMPILE_AVX)
+    /* AVX needs both the CPU (bit 28) and the OS (OSXSAVE, bit 27) to
+     * support it, and the OS must save the YMM registers (XCR0 bits 1-2). */
+    if ((i_ecx & 0x18000000) == 0x18000000)
+    {
+        unsigned int i_xcr0;
+
+        asm volatile (".byte 0x0f, 0x01, 0xd0\n" /* xgetbv */
+                      : "=a" (i_xcr0) : "c" (0) : "edx");
+        if ((i_xcr0 & 0x6) == 0x6 && vlc_CPU_check ("AVX", AVX_test))
+            i_capabilities |= CPU_CAPABILITY_AVX;
+    }
+# endif
+
+# if defined (__AVX2__)
+    i_capabilities |= CPU_CAPABILITY_AVX2;
+# elif defined (CAN_COMPILE_AVX2)
+    /* AVX2 is in the structured extended features (leaf 7, EBX bit 5),
+     * and has the same operating system requirements as AVX. */
+    if ((i_capabilities & CPU_CAPABILITY_AVX) && i_level >= 7)
+    {
+        cpuid( 0x00000007 );
+        if ((i_ebx & 0x00000020) && vlc_CPU_check ("AVX2", AVX2_test))
+            i_capabilities |= CPU_CAPABILITY_AVX2;
+    }
+# endif
+
     /* test for additional capabilities */
     cpuid( 0x80000000 );
 
@@ -390,6 +432,8 @@ void vlc_CPU_dump (vlc_object_t *obj)
     PRINT_CAPABILITY(CPU_CAPABILITY_SSE4_1, "SSE4.1");
     PRINT_CAPABILITY(CPU_CAPABILITY_SSE4_2, "SSE4.2");
     PRINT_CAPABILITY(CPU_CAPABILITY_SSE4A,  "SSE4A");
+    PRINT_CAPABILITY(CPU_CAPABILITY_AVX,    "AVX");
+    PRINT_CAPABILITY(CPU_CAPABILITY_AVX2,   "AVX2");
 
 #elif defined (__powerpc__) || defined (__ppc__) || defined (__ppc64__)
     PRINT_CAPABILITY(CPU_CAPABILITY_ALTIVEC, "AltiVec");
@@ -49,6 +49,7 @@
 #include <assert.h>
 
 #include <vlc_charset.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
 /**
@@ -64,10 +65,118 @@ struct msg_subscription_t
     void           *opaque;
 };
 
+/*
+ * Messages are recorded by the emitting thread in a ring of its own, without
+ * formatting them nor taking any lock: the arguments are copied along with
+ * the strings they point to. A single logger thread merges the rings in
+ * timestamp order, formats the messages and passes them to the subscribers.
+ * A thread whose ring is full formats its message itself (see "log-queue").
+ */
+#define LOG_ARGS        16   /* arguments per message */
+#define LOG_INLINE      256  /* bytes of strings per message, before malloc */
+#define LOG_SPEC        32   /* bytes of flags, width and precision */
+#define LOG_SITES       64   /* rate limited call sites per thread */
+#define LOG_SITES_PROBE 4    /* slots looked at per call site */
+#define LOG_RATE_BURST  100  /* messages per call site per period */
+#define LOG_RATE_PERIOD CLOCK_FREQ
+
+typedef union
+{
+    intmax_t    i;
+    uintmax_t   u;
+    double      d;
+    const void *p;
+    size_t      off; /* string offset in the record data, 0 for NULL */
+} log_arg_t;
+
+typedef struct
+{
+    mtime_t     date;
+    uintptr_t   object_id;
+    int         type;
+    int         verbose;
+    bool        color;
+    bool        preformatted; /* the format string is the final text */
+    int         errnum;
+#ifdef WIN32
+    int         sockerr;
+#endif
+    unsigned    dropped; /* messages dropped just before this one */
+    size_t      module, object_type, header; /* offsets in data, 0 if none */
+    log_arg_t   argv[LOG_ARGS];
+    char       *data; /* format string first, then the other strings */
+    char        buf[LOG_INLINE];
+} log_record_t;
+
+typedef struct log_ring
+{
+    vlc_atomic_t     head; /* records published by the thread */
+    vlc_atomic_t     tail; /* records consumed by the logger thread */
+    vlc_atomic_t     dead; /* the thread has exited */
+    struct log_ring *next;
+
+    /* Owned by the emitting thread */
+    uintptr_t   produced;
+    uintptr_t   tail_seen;
+    unsigned    dropped;
+    struct
+    {
+        const char *format;
+        mtime_t     start;
+        unsigned    count;
+    } sites[LOG_SITES];
+
+    /* Owned by the logger thread */
+    uintptr_t   head_seen;
+    bool        logger;
+
+    bool        output; /* the thread is calling the subscribers */
+
+    unsigned     size; /* messages per thread */
+    log_record_t slots[];
+} log_ring_t;
+
+static struct
+{
+    vlc_mutex_t     setup; /* serializes vlc_LogInit() and vlc_LogDeinit() */
+    vlc_mutex_t     lock;
+    vlc_mutex_t     output; /* serializes the calls to the subscribers */
+    vlc_cond_t      wait; /* the logger thread waits for messages */
+    vlc_cond_t      idle; /* flushers wait for the logger thread, and
+                           * vlc_LogDeinit() for the producers */
+    vlc_thread_t    thread;
+    vlc_threadvar_t key;
+    log_ring_t     *rings;
+    unsigned        refs;
+    unsigned        generation; /* incremented whenever all rings are empty */
+    unsigned        lost; /* dropped by exited threads, not reported yet */
+    unsigned        slots; /* size of the rings created from now on */
+    bool            initialized;
+    bool            exit;
+    vlc_atomic_t    running;
+    vlc_atomic_t    producers; /* threads recording a message */
+    vlc_atomic_t    sleeping;
+    vlc_atomic_t    subscribers;
+} logger = {
+    .setup = VLC_STATIC_MUTEX,
+    .lock = VLC_STATIC_MUTEX,
+    .output = VLC_STATIC_MUTEX,
+    .wait = VLC_STATIC_COND,
+    .idle = VLC_STATIC_COND,
+    .slots = 128,
+    .running = VLC_ATOMIC_INIT(0),
+    .producers = VLC_ATOMIC_INIT(0),
+    .sleeping = VLC_ATOMIC_INIT(0),
+    .subscribers = VLC_ATOMIC_INIT(0),
+};
+
+static void LogFlush (void);
+
 /**
  * Subscribe to the message queue.
  * Whenever a message is emitted, a callback will be called.
- * Callback invocation are serialized within a subscription.
+ * Callback invocation are serialized within a subscription, and happen on
+ * the logger thread rather than on the thread emitting the message.
  *
  * @param cb callback function
  * @param opaque data for the callback function
@@ -87,16 +196,20 @@ msg_subscription_t *vlc_Subscribe (msg_callback_t cb, void *opaque)
     sub->next = msg_head;
     msg_head = sub;
     vlc_rwlock_unlock (&msg_lock);
+    vlc_atomic_inc (&logger.subscribers);
 
     return sub;
 }
 
 /**
  * Unsubscribe from the message queue.
- * This function waits for the message callback to return if needed.
+ * The messages emitted so far are delivered first. Then this function waits
+ * for the message callback to return if needed.
  */
 void vlc_Unsubscribe (msg_subscription_t *sub)
 {
+    LogFlush ();
+
     vlc_rwlock_wrlock (&msg_lock);
     if (sub->next != NULL)
         sub->next->prev = sub->prev;
@@ -108,6 +221,7 @@ void vlc_Unsubscribe (msg_subscription_t *sub)
         msg_head = sub->next;
     }
     vlc_rwlock_unlock (&msg_lock);
+    vlc_atomic_dec (&logger.subscribers);
     free (sub);
 }
 
@@ -133,114 +247,913 @@ static void PrintColorMsg (void *, int, const msg_item_t *,
                            const char *, va_list);
 static void PrintMsg (void *, int, const msg_item_t *, const char *, va_list);
 
+/*** Recording ***/
+
+/** Conversion specification */
+typedef struct
+{
+    const char *flags; /* flags, width and precision, after the '%' */
+    size_t      flags_len;
+    char        length; /* length modifier, 'H' for hh and 'q' for ll */
+    char        conv;
+    unsigned    stars; /* int arguments for the width and the precision */
+    bool        star_precision; /* the last star is the precision */
+    int         precision; /* -1 if none */
+} log_spec_t;
+
 /**
- * Emit a log message. This function is the variable argument list equivalent
- * to vlc_Log().
+ * Parses a conversion specification, after its '%'.
+ * @return the end of the specification, or NULL if it cannot be recorded
+ * (positional or wide character arguments, long double, %n...)
  */
-void vlc_vaLog (vlc_object_t *obj, int type, const char *module,
-                const char *format, va_list args)
+static const char *LogParseSpec (const char *p, log_spec_t *spec)
 {
-    if (obj != NULL && obj->i_flags & OBJECT_FLAGS_QUIET)
-        return;
+    spec->flags = p;
+    spec->stars = 0;
+    spec->star_precision = false;
+    spec->precision = -1;
 
-    /* C locale to get error messages in English in the logs */
-    locale_t c = newlocale (LC_MESSAGES_MASK, "C", (locale_t)0);
-    locale_t locale = uselocale (c);
+    p += strspn (p, "-+ #0'");
+    if (*p == '*')
+    {
+        spec->stars++;
+        p++;
+    }
+    p += strspn (p, "0123456789");
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            spec->stars++;
+            spec->star_precision = true;
+            p++;
+        }
+        else
+            spec->precision = strtol (p, NULL, 10);
+        p += strspn (p, "0123456789");
+    }
+    if (*p == '$')
+        return NULL;
+    spec->flags_len = p - spec->flags;
+    if (spec->flags_len > LOG_SPEC)
+        return NULL;
 
-#ifndef __GLIBC__
-    /* Expand %m to strerror(errno) - only once */
-    char buf[strlen(format) + 2001], *ptr;
-    strcpy (buf, format);
-    ptr = (char*)buf;
-    format = (const char*) buf;
+    spec->length = 0;
+    switch (*p)
+    {
+        case 'h':
+        case 'l':
+            if (p[1] == p[0])
+            {
+                spec->length = (*p == 'h') ? 'H' : 'q';
+                p += 2;
+                break;
+            }
+            /* fall through */
+        case 'q':
+        case 'j':
+        case 'z':
+        case 't':
+        case 'L':
+            spec->length = *(p++);
+            break;
+    }
 
-    for( ;; )
+    spec->conv = *p;
+    switch (spec->conv)
     {
-        ptr = strchr( ptr, '%' );
-        if( ptr == NULL )
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+            if (spec->length == 'L')
+                return NULL;
+            break;
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G': case 'a': case 'A':
+            if (spec->length != 0 && spec->length != 'l')
+                return NULL;
+            break;
+        case 'c': case 's': case 'p':
+            if (spec->length != 0)
+                return NULL;
+            break;
+        case 'm': case '%':
             break;
+        default:
+            return NULL;
+    }
+    return p + 1;
+}
+
+/**
+ * Copies the arguments of a message.
+ * @param strings bit mask of the string arguments [OUT]
+ * @param lenv sizes of the string arguments [OUT]
+ * @return the total size of the strings, or (size_t)-1 if the message
+ * cannot be recorded this way
+ */
+static size_t LogCapture (log_record_t *rec, const char *format, va_list args,
+                          unsigned *strings, size_t *lenv)
+{
+    unsigned argc = 0;
+    size_t size = 0;
+    va_list ap;
+
+    *strings = 0;
+    va_copy (ap, args);
+    for (const char *p = strchr (format, '%'); p != NULL; p = strchr (p, '%'))
+    {
+        log_spec_t spec;
 
-        if( ptr[1] == 'm' )
+        p = LogParseSpec (p + 1, &spec);
+        if (p == NULL || argc + spec.stars + 1 > LOG_ARGS)
         {
-            char errbuf[2001];
-            size_t errlen;
+            size = (size_t)-1;
+            break;
+        }
+        for (unsigned i = 0; i < spec.stars; i++)
+            rec->argv[argc++].i = va_arg (ap, int);
 
-#ifndef WIN32
-            strerror_r( errno, errbuf, 1001 );
-#else
-            int sockerr = WSAGetLastError( );
-            if( sockerr )
+        log_arg_t *arg = &rec->argv[argc];
+        switch (spec.conv)
+        {
+            case 'd': case 'i':
+                switch (spec.length)
+                {
+                    case 'H': arg->i = (signed char)va_arg (ap, int); break;
+                    case 'h': arg->i = (short)va_arg (ap, int); break;
+                    case 'l': arg->i = va_arg (ap, long); break;
+                    case 'q': arg->i = va_arg (ap, long long); break;
+                    case 'j': arg->i = va_arg (ap, intmax_t); break;
+                    case 'z': arg->i = va_arg (ap, ssize_t); break;
+                    case 't': arg->i = va_arg (ap, ptrdiff_t); break;
+                    default:  arg->i = va_arg (ap, int); break;
+                }
+                break;
+            case 'o': case 'u': case 'x': case 'X':
+                switch (spec.length)
+                {
+                    case 'H':
+                        arg->u = (unsigned char)va_arg (ap, unsigned);
+                        break;
+                    case 'h':
+                        arg->u = (unsigned short)va_arg (ap, unsigned);
+                        break;
+                    case 'l': arg->u = va_arg (ap, unsigned long); break;
+                    case 'q': arg->u = va_arg (ap, unsigned long long); break;
+                    case 'j': arg->u = va_arg (ap, uintmax_t); break;
+                    case 'z': arg->u = va_arg (ap, size_t); break;
+                    case 't': arg->u = (size_t)va_arg (ap, ptrdiff_t); break;
+                    default:  arg->u = va_arg (ap, unsigned); break;
+                }
+                break;
+            case 'c':
+                arg->i = va_arg (ap, int);
+                break;
+            case 's':
             {
-                strncpy( errbuf, net_strerror( sockerr ), 1001 );
-                WSASetLastError( sockerr );
-            }
-            if ((sockerr == 0)
-             || (strcmp ("Unknown network stack error", errbuf) == 0))
-                strncpy( errbuf, strerror( errno ), 1001 );
-#endif
-            errbuf[1000] = 0;
+                /* With a precision, the string needs not be terminated */
+                int precision = spec.precision;
+                if (spec.star_precision)
+                    precision = rec->argv[argc - 1].i;
 
-            /* Escape '%' from the error string */
-            for( char *percent = strchr( errbuf, '%' );
-                 percent != NULL;
-                 percent = strchr( percent + 2, '%' ) )
-            {
-                memmove( percent + 1, percent, strlen( percent ) + 1 );
+                arg->p = va_arg (ap, const char *);
+                if (arg->p == NULL)
+                    lenv[argc] = 0;
+                else if (precision >= 0)
+                    lenv[argc] = strnlen (arg->p, precision) + 1;
+                else
+                    lenv[argc] = strlen (arg->p) + 1;
+                size += lenv[argc];
+                *strings |= 1u << argc;
+                break;
             }
-
-            errlen = strlen( errbuf );
-            memmove( ptr + errlen, ptr + 2, strlen( ptr + 2 ) + 1 );
-            memcpy( ptr, errbuf, errlen );
-            break; /* Only once, so we don't overflow */
+            case 'p':
+                arg->p = va_arg (ap, void *);
+                break;
+            case 'm':
+            case '%':
+                continue;
+            default:
+                arg->d = va_arg (ap, double);
+                break;
         }
-
-        /* Looks for conversion specifier... */
-        do
-            ptr++;
-        while( *ptr && ( strchr( "diouxXeEfFgGaAcspn%", *ptr ) == NULL ) );
-        if( *ptr )
-            ptr++; /* ...and skip it */
+        argc++;
     }
+    va_end (ap);
+    return size;
+}
+
+/**
+ * Records a message, along with all the strings it refers to, and the errno
+ * value of the caller for %m.
+ * Messages which cannot be recorded as such are formatted right away.
+ */
+static bool LogRecord (log_record_t *rec, mtime_t date, int errnum,
+                       vlc_object_t *obj, int type, const char *module,
+                       const char *format, va_list args)
+{
+    libvlc_priv_t *priv = libvlc_priv (obj->p_libvlc);
+    size_t lenv[LOG_ARGS];
+    unsigned strings;
+    char *text = NULL;
+
+    rec->errnum = errnum;
+#ifdef WIN32
+    rec->sockerr = WSAGetLastError ();
 #endif
 
-    /* Fill message information fields */
-    msg_item_t msg;
+    size_t size = LogCapture (rec, format, args, &strings, lenv);
+    rec->preformatted = size == (size_t)-1;
+    if (rec->preformatted)
+    {
+        va_list ap;
 
-    msg.i_object_id = (uintptr_t)obj;
-    msg.psz_object_type = (obj != NULL) ? obj->psz_object_type : "generic";
-    msg.psz_module = module;
-    msg.psz_header = NULL;
+        va_copy (ap, args);
+        if (vasprintf (&text, format, ap) == -1)
+            text = NULL;
+        va_end (ap);
+        if (text == NULL)
+            return false;
+        format = text;
+        strings = 0;
+        size = 0;
+    }
 
+    const char *object_type = (obj != NULL) ? obj->psz_object_type
+                                            : "generic";
+    const char *header = NULL;
     for (vlc_object_t *o = obj; o != NULL; o = o->p_parent)
         if (o->psz_header != NULL)
         {
-            msg.psz_header = o->psz_header;
+            header = o->psz_header;
             break;
         }
 
-    /* Pass message to subscribers */
-    libvlc_priv_t *priv = libvlc_priv (obj->p_libvlc);
+    size_t format_len = strlen (format) + 1;
+    size_t module_len = strlen (module) + 1;
+    size_t type_len = strlen (object_type) + 1;
+    size_t header_len = (header != NULL) ? (strlen (header) + 1) : 0;
+
+    size += format_len + module_len + type_len + header_len;
+    rec->data = rec->buf;
+    if (size > sizeof (rec->buf))
+    {
+        rec->data = malloc (size);
+        if (unlikely(rec->data == NULL))
+        {
+            free (text);
+            return false;
+        }
+    }
+
+    char *p = rec->data;
+    memcpy (p, format, format_len);
+    p += format_len;
+    rec->module = p - rec->data;
+    memcpy (p, module, module_len);
+    p += module_len;
+    rec->object_type = p - rec->data;
+    memcpy (p, object_type, type_len);
+    p += type_len;
+    rec->header = 0;
+    if (header != NULL)
+    {
+        rec->header = p - rec->data;
+        memcpy (p, header, header_len);
+        p += header_len;
+    }
+    for (unsigned i = 0; strings != 0; i++, strings >>= 1)
+    {
+        if (!(strings & 1))
+            continue;
+        if (rec->argv[i].p == NULL)
+        {
+            rec->argv[i].off = 0;
+            continue;
+        }
+        memcpy (p, rec->argv[i].p, lenv[i] - 1);
+        p[lenv[i] - 1] = '\0';
+        rec->argv[i].off = p - rec->data;
+        p += lenv[i];
+    }
+    free (text);
+
+    rec->date = date;
+    rec->object_id = (uintptr_t)obj;
+    rec->type = type;
+    rec->verbose = priv->i_verbose;
+    rec->color = priv->b_color;
+    rec->dropped = 0;
+    return true;
+}
 
+static void LogRelease (log_record_t *rec)
+{
+    if (rec->data != rec->buf)
+        free (rec->data);
+}
+
+/*** Formatting and dispatching ***/
+
+typedef struct
+{
+    char  *buf;
+    size_t len;
+    size_t size;
+} log_text_t;
+
+static void LogAppend (log_text_t *text, const char *format, ...)
+{
     va_list ap;
 
+    for (;;)
+    {
+        size_t room = text->size - text->len;
+
+        va_start (ap, format);
+        int len = vsnprintf ((room > 0) ? (text->buf + text->len) : NULL,
+                             room, format, ap);
+        va_end (ap);
+        if (len < 0)
+            return;
+        if ((size_t)len < room)
+        {
+            text->len += len;
+            return;
+        }
+
+        size_t size = text->len + len + 1;
+        if (size < 2 * text->size)
+            size = 2 * text->size;
+        char *buf = realloc (text->buf, size);
+        if (unlikely(buf == NULL))
+            return;
+        text->buf = buf;
+        text->size = size;
+    }
+}
+
+static void LogAppendError (log_text_t *text, const log_record_t *rec)
+{
+#ifdef WIN32
+    if (rec->sockerr != 0)
+    {
+        const char *msg = net_strerror (rec->sockerr);
+        if (strcmp ("Unknown network stack error", msg))
+        {
+            LogAppend (text, "%s", msg);
+            return;
+        }
+    }
+    LogAppend (text, "%s", strerror (rec->errnum));
+#else
+    char buf[1001];
+# if defined (__GLIBC__) && defined (_GNU_SOURCE)
+    LogAppend (text, "%s", strerror_r (rec->errnum, buf, sizeof (buf)));
+# else
+    if (strerror_r (rec->errnum, buf, sizeof (buf)))
+        snprintf (buf, sizeof (buf), "error %d", rec->errnum);
+    LogAppend (text, "%s", buf);
+# endif
+#endif
+}
+
+/**
+ * Formats a recorded message, one conversion at a time.
+ */
+static void LogFormat (log_text_t *text, const log_record_t *rec)
+{
+    const char *format = rec->data;
+    const log_arg_t *arg = rec->argv;
+
+    text->len = 0;
+    if (rec->preformatted)
+    {
+        LogAppend (text, "%s", format);
+        return;
+    }
+
+    for (;;)
+    {
+        const char *p = strchr (format, '%');
+        if (p == NULL)
+        {
+            LogAppend (text, "%s", format);
+            break;
+        }
+        LogAppend (text, "%.*s", (int)(p - format), format);
+
+        log_spec_t spec;
+        int star[2];
+
+        format = LogParseSpec (p + 1, &spec);
+        assert (format != NULL); /* it was parsed when recorded */
+        for (unsigned i = 0; i < spec.stars; i++)
+            star[i] = (arg++)->i;
+
+        switch (spec.conv)
+        {
+            case '%':
+                LogAppend (text, "%%");
+                continue;
+            case 'm':
+                LogAppendError (text, rec);
+                continue;
+        }
+
+        /* Integers were promoted to intmax_t or uintmax_t when recorded */
+        char fmt[1 + LOG_SPEC + 3];
+        size_t len = 0;
+
+        fmt[len++] = '%';
+        memcpy (fmt + len, spec.flags, spec.flags_len);
+        len += spec.flags_len;
+        if (strchr ("diouxX", spec.conv) != NULL)
+            fmt[len++] = 'j';
+        fmt[len++] = spec.conv;
+        fmt[len] = '\0';
+
+#define APPEND(val) \
+        switch (spec.stars) \
+        { \
+            case 0: LogAppend (text, fmt, val); break; \
+            case 1: LogAppend (text, fmt, star[0], val); break; \
+            default: LogAppend (text, fmt, star[0], star[1], val); break; \
+        }
+        switch (spec.conv)
+        {
+            case 'd': case 'i':
+                APPEND(arg->i);
+                break;
+            case 'o': case 'u': case 'x': case 'X':
+                APPEND(arg->u);
+                break;
+            case 'c':
+                APPEND((int)arg->i);
+                break;
+            case 's':
+                APPEND((arg->off != 0) ? (rec->data + arg->off) : NULL);
+                break;
+            case 'p':
+                APPEND(arg->p);
+                break;
+            default:
+                APPEND(arg->d);
+                break;
+        }
+#undef APPEND
+        arg++;
+    }
+}
+
+static void LogDispatch (int verbose, bool color, int type,
+                         const msg_item_t *item, const char *format, ...)
+{
+    va_list args, ap;
+
+    va_start (args, format);
     va_copy (ap, args);
-    if (priv->b_color)
-        PrintColorMsg (&priv->i_verbose, type, &msg, format, ap);
+    if (color)
+        PrintColorMsg (&verbose, type, item, format, ap);
     else
-        PrintMsg (&priv->i_verbose, type, &msg, format, ap);
+        PrintMsg (&verbose, type, item, format, ap);
     va_end (ap);
 
     vlc_rwlock_rdlock (&msg_lock);
     for (msg_subscription_t *sub = msg_head; sub != NULL; sub = sub->next)
     {
         va_copy (ap, args);
-        sub->func (sub->opaque, type, &msg, format, ap);
+        sub->func (sub->opaque, type, item, format, ap);
         va_end (ap);
     }
     vlc_rwlock_unlock (&msg_lock);
+    va_end (args);
+}
+
+/**
+ * Passes a recorded message to the subscribers, after a notice of the
+ * messages dropped before it if any.
+ */
+static void LogOutput (log_text_t *text, const log_record_t *rec,
+                       unsigned lost)
+{
+    unsigned dropped = rec->dropped + lost;
+
+    if (dropped > 0)
+    {
+        static const msg_item_t notice = {
+            .i_object_id = 0,
+            .psz_object_type = "generic",
+            .psz_module = "main",
+            .psz_header = NULL,
+        };
+        LogDispatch (rec->verbose, rec->color, VLC_MSG_WARN, &notice,
+                     "%u log messages dropped", dropped);
+    }
+
+    msg_item_t item = {
+        .i_object_id = rec->object_id,
+        .psz_object_type = rec->data + rec->object_type,
+        .psz_module = rec->data + rec->module,
+        .psz_header = (rec->header != 0) ? (rec->data + rec->header) : NULL,
+    };
+
+    LogFormat (text, rec);
+    LogDispatch (rec->verbose, rec->color, rec->type, &item, "%s",
+                 (text->len > 0) ? text->buf : "");
+}
+
+/*** Logger thread ***/
+
+static void LogWake (void)
+{
+    if (vlc_atomic_get (&logger.sleeping))
+    {
+        vlc_mutex_lock (&logger.lock);
+        vlc_atomic_set (&logger.sleeping, 0);
+        vlc_cond_signal (&logger.wait);
+        vlc_mutex_unlock (&logger.lock);
+    }
+}
+
+static void LogRingDead (void *data)
+{
+    log_ring_t *ring = data;
+
+    vlc_atomic_set (&ring->dead, 1);
+    LogWake ();
+}
+
+/**
+ * Gets the ring of the calling thread, creates it the first time.
+ */
+static log_ring_t *LogRing (void)
+{
+    log_ring_t *ring = vlc_threadvar_get (logger.key);
+    if (likely(ring != NULL))
+        return ring;
+
+    vlc_mutex_lock (&logger.lock);
+    unsigned size = logger.slots;
+    vlc_mutex_unlock (&logger.lock);
+
+    ring = calloc (1, sizeof (*ring) + size * sizeof (ring->slots[0]));
+    if (unlikely(ring == NULL))
+        return NULL;
+    ring->size = size;
+    if (vlc_threadvar_set (logger.key, ring))
+    {
+        free (ring);
+        return NULL;
+    }
+
+    vlc_mutex_lock (&logger.lock);
+    ring->next = logger.rings;
+    logger.rings = ring;
+    vlc_mutex_unlock (&logger.lock);
+    return ring;
+}
+
+/**
+ * Limits the rate of the messages from each call site (format string).
+ * A call site is looked up in a few consecutive slots; if it is not there,
+ * it takes the place of the one with the oldest period.
+ */
+static bool LogRate (log_ring_t *ring, const char *format, mtime_t now)
+{
+    /* Fibonacci hashing of the format string address */
+    unsigned first = (((uint32_t)(uintptr_t)format * UINT32_C(2654435769))
+                      >> 16) % LOG_SITES;
+    unsigned i = first % LOG_SITES, oldest = i;
+
+    for (unsigned n = 0; n < LOG_SITES_PROBE; n++)
+    {
+        unsigned j = (first + n) % LOG_SITES;
+
+        if (ring->sites[j].format == format)
+        {
+            i = j;
+            goto found;
+        }
+        if (ring->sites[j].start < ring->sites[oldest].start)
+            oldest = j;
+    }
+    i = oldest;
+    ring->sites[i].format = format;
+    ring->sites[i].start = now;
+    ring->sites[i].count = 0;
+found:
+    if (now - ring->sites[i].start >= LOG_RATE_PERIOD)
+    {
+        ring->sites[i].start = now;
+        ring->sites[i].count = 0;
+    }
+    return ring->sites[i].count++ < LOG_RATE_BURST;
+}
+
+/**
+ * Queues a message for the logger thread.
+ * @return false if the ring is full
+ */
+static bool LogPush (log_ring_t *ring, mtime_t date, int errnum,
+                     vlc_object_t *obj, int type, const char *module,
+                     const char *format, va_list args)
+{
+    uintptr_t head = ring->produced;
+
+    if (!LogRate (ring, format, date))
+        goto drop;
+    if (head - ring->tail_seen >= ring->size)
+    {
+        ring->tail_seen = vlc_atomic_get (&ring->tail);
+        if (head - ring->tail_seen >= ring->size)
+            return false;
+    }
+
+    log_record_t *rec = &ring->slots[head % ring->size];
+    if (!LogRecord (rec, date, errnum, obj, type, module, format, args))
+        goto drop;
+    rec->dropped = ring->dropped;
+    ring->dropped = 0;
+
+    /* Full barrier: the record is complete before it is published */
+    ring->produced = head + 1;
+    vlc_atomic_add (&ring->head, 1);
+    LogWake ();
+    return true;
+drop:
+    ring->dropped++;
+    return true;
+}
+
+/**
+ * Finds the ring with the oldest pending message, and frees the empty rings
+ * of the exited threads. Called with the lock held.
+ */
+static log_ring_t *LogNext (void)
+{
+    log_ring_t *next = NULL;
+    mtime_t date = 0;
+
+    for (log_ring_t **pp = &logger.rings, *ring; (ring = *pp) != NULL;)
+    {
+        uintptr_t tail = vlc_atomic_get (&ring->tail);
+
+        if (ring->head_seen == tail)
+        {
+            bool dead = vlc_atomic_get (&ring->dead);
+
+            /* Full barrier: the records are read after the head */
+            ring->head_seen = vlc_atomic_add (&ring->head, 0);
+            if (ring->head_seen == tail)
+            {
+                if (dead)
+                {
+                    logger.lost += ring->dropped;
+                    *pp = ring->next;
+                    free (ring);
+                }
+                else
+                    pp = &ring->next;
+                continue;
+            }
+        }
+
+        const log_record_t *rec = &ring->slots[tail % ring->size];
+        if (next == NULL || rec->date < date)
+        {
+            next = ring;
+            date = rec->date;
+        }
+        pp = &ring->next;
+    }
+    return next;
+}
+
+static void *LogThread (void *data)
+{
+    log_text_t text = { NULL, 0, 0 };
+    (void) data;
+
+    /* C locale to get error messages in English in the logs */
+    locale_t c = newlocale (LC_MESSAGES_MASK, "C", (locale_t)0);
+    locale_t locale = uselocale (c);
+
+    log_ring_t *self = LogRing ();
+    if (self != NULL)
+        self->logger = true;
+
+    vlc_mutex_lock (&logger.lock);
+    for (;;)
+    {
+        log_ring_t *ring = LogNext ();
+        if (ring == NULL)
+        {
+            vlc_atomic_set (&logger.sleeping, 1);
+            ring = LogNext ();
+            if (ring == NULL)
+            {
+                logger.generation++;
+                vlc_cond_broadcast (&logger.idle);
+                if (logger.exit)
+                    break;
+                vlc_cond_wait (&logger.wait, &logger.lock);
+                vlc_atomic_set (&logger.sleeping, 0);
+                continue;
+            }
+            vlc_atomic_set (&logger.sleeping, 0);
+        }
+
+        unsigned lost = logger.lost;
+        logger.lost = 0;
+        vlc_mutex_unlock (&logger.lock);
+
+        uintptr_t tail = vlc_atomic_get (&ring->tail);
+        log_record_t *rec = &ring->slots[tail % ring->size];
+
+        vlc_mutex_lock (&logger.output);
+        if (self != NULL)
+            self->output = true;
+        LogOutput (&text, rec, lost);
+        if (self != NULL)
+            self->output = false;
+        vlc_mutex_unlock (&logger.output);
+        LogRelease (rec);
+        /* Full barrier: the record is released before its slot */
+        vlc_atomic_add (&ring->tail, 1);
+
+        vlc_mutex_lock (&logger.lock);
+    }
+    vlc_mutex_unlock (&logger.lock);
 
     uselocale (locale);
     freelocale (c);
+    free (text.buf);
+    return NULL;
+}
+
+/**
+ * Waits for the messages recorded so far to be passed to the subscribers.
+ */
+static void LogFlush (void)
+{
+    vlc_mutex_lock (&logger.lock);
+    if (vlc_atomic_get (&logger.running) && !logger.exit)
+    {
+        log_ring_t *self = vlc_threadvar_get (logger.key);
+
+        if (self == NULL || !self->logger)
+        {
+            unsigned generation = logger.generation;
+
+            vlc_atomic_set (&logger.sleeping, 0);
+            vlc_cond_signal (&logger.wait);
+            while (logger.generation == generation)
+                vlc_cond_wait (&logger.idle, &logger.lock);
+        }
+    }
+    vlc_mutex_unlock (&logger.lock);
+}
+
+/**
+ * Starts the logger thread, for the first LibVLC instance.
+ * Until then, messages are formatted and passed on the emitting thread.
+ */
+void vlc_LogInit (void)
+{
+    vlc_mutex_lock (&logger.setup);
+    if (logger.refs++ == 0)
+    {
+        if (!logger.initialized)
+            logger.initialized = !vlc_threadvar_create (&logger.key,
+                                                        LogRingDead);
+        logger.exit = false;
+        vlc_atomic_set (&logger.sleeping, 0);
+        if (logger.initialized
+         && !vlc_clone (&logger.thread, LogThread, NULL,
+                        VLC_THREAD_PRIORITY_LOW))
+            vlc_atomic_set (&logger.running, 1);
+    }
+    vlc_mutex_unlock (&logger.setup);
+}
+
+/**
+ * Sets how many messages each thread can queue for the logger thread before
+ * it formats them itself. Applies to the threads yet to log a message.
+ */
+void vlc_LogResize (unsigned slots)
+{
+    /* A power of two, for the record counters to wrap around cleanly */
+    while (slots & (slots - 1))
+        slots &= slots - 1;
+    if (slots == 0)
+        slots = 1;
+
+    vlc_mutex_lock (&logger.lock);
+    logger.slots = slots;
+    vlc_mutex_unlock (&logger.lock);
+}
+
+/**
+ * Stops the logger thread, with the last LibVLC instance, once it has
+ * passed all the pending messages.
+ */
+void vlc_LogDeinit (void)
+{
+    vlc_mutex_lock (&logger.setup);
+    assert (logger.refs > 0);
+    if (--logger.refs == 0 && vlc_atomic_get (&logger.running))
+    {
+        /* Full barrier: a thread recording a message either has seen the
+         * logger stopped, or is counted as a producer */
+        vlc_atomic_set (&logger.running, 0);
+
+        vlc_mutex_lock (&logger.lock);
+        while (vlc_atomic_get (&logger.producers) > 0)
+            vlc_cond_wait (&logger.idle, &logger.lock);
+        logger.exit = true;
+        vlc_cond_signal (&logger.wait);
+        vlc_mutex_unlock (&logger.lock);
+        vlc_join (logger.thread, NULL);
+
+        /* Frees the ring of the logger thread, among others */
+        vlc_mutex_lock (&logger.lock);
+        LogNext ();
+        vlc_mutex_unlock (&logger.lock);
+    }
+    vlc_mutex_unlock (&logger.setup);
+}
+
+/**
+ * Emit a log message. This function is the variable argument list equivalent
+ * to vlc_Log().
+ */
+void vlc_vaLog (vlc_object_t *obj, int type, const char *module,
+                const char *format, va_list args)
+{
+    if (obj != NULL && obj->i_flags & OBJECT_FLAGS_QUIET)
+        return;
+
+    /* Nobody would see the message */
+    int verbose = libvlc_priv (obj->p_libvlc)->i_verbose;
+    if ((verbose < 0 || verbose < (type - VLC_MSG_ERR))
+     && vlc_atomic_get (&logger.subscribers) == 0)
+        return;
+
+    int errnum = errno;
+    mtime_t now = mdate ();
+    log_ring_t *ring = NULL;
+    bool queued = false;
+
+    /* Full barrier: vlc_LogDeinit() waits for the producers */
+    vlc_atomic_inc (&logger.producers);
+    if (vlc_atomic_get (&logger.running))
+        ring = LogRing ();
+    if (likely(ring != NULL))
+        queued = LogPush (ring, now, errnum, obj, type, module, format,
+                          args);
+    if (vlc_atomic_dec (&logger.producers) == 0
+     && unlikely(!vlc_atomic_get (&logger.running)))
+    {   /* vlc_LogDeinit() may be waiting */
+        vlc_mutex_lock (&logger.lock);
+        vlc_cond_broadcast (&logger.idle);
+        vlc_mutex_unlock (&logger.lock);
+    }
+
+    if (!queued)
+    {   /* No logger thread, or a full ring: format the message right away.
+         * It may then overtake the queued messages of the thread. */
+        log_record_t rec;
+
+        if (LogRecord (&rec, now, errnum, obj, type, module, format, args))
+        {
+            log_text_t text = { NULL, 0, 0 };
+            /* Unless from a subscriber, wait for the logger thread to be
+             * done with the subscribers */
+            bool serialize = ring != NULL && !ring->output;
+
+            /* C locale to get error messages in English in the logs */
+            locale_t c = newlocale (LC_MESSAGES_MASK, "C", (locale_t)0);
+            locale_t locale = uselocale (c);
+
+            if (serialize)
+            {
+                vlc_mutex_lock (&logger.output);
+                ring->output = true;
+            }
+            LogOutput (&text, &rec, 0);
+            if (serialize)
+            {
+                ring->output = false;
+                vlc_mutex_unlock (&logger.output);
+            }
+            uselocale (locale);
+            freelocale (c);
+            LogRelease (&rec);
+            free (text.buf);
+        }
+    }
+    errno = errnum;
 }
 
 static const char msg_type[4][9] = { "", " error", " warning", " debug" };
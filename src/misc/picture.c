@@ -107,6 +107,7 @@ void picture_Reset( picture_t *p_picture )
     /* */
     p_picture->date = VLC_TS_INVALID;
     p_picture->b_force = false;
+    p_picture->trace_date = VLC_TS_INVALID;
     p_picture->b_progressive = false;
     p_picture->i_nb_fields = 2;
     p_picture->b_top_field_first = false;
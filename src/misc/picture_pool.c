@@ -58,12 +58,55 @@ struct picture_pool_t {
     int            picture_count;
     picture_t      **picture;
     bool           *picture_reserved;
+
+    /* Only the pools created from a format can grow */
+    bool           can_grow;
+    video_format_t fmt;
+    int            initial_count;
 };
 
 static void Release(picture_t *);
 static int  Lock(picture_t *);
 static void Unlock(picture_t *);
 
+static void Install(picture_t *picture,
+                    int (*lock)(picture_t *), void (*unlock)(picture_t *))
+{
+    /* The pool must be the only owner of the picture */
+    assert(picture->i_refcount == 1);
+
+    /* Install the new release callback */
+    picture_release_sys_t *release_sys = malloc(sizeof(*release_sys));
+    if (!release_sys)
+        abort();
+    release_sys->release     = picture->pf_release;
+    release_sys->release_sys = picture->p_release_sys;
+    release_sys->lock        = lock;
+    release_sys->unlock      = unlock;
+    release_sys->tick        = 0;
+
+    /* */
+    picture->i_refcount    = 0;
+    picture->pf_release    = Release;
+    picture->p_release_sys = release_sys;
+}
+
+static void Uninstall(picture_t *picture)
+{
+    picture_release_sys_t *release_sys = picture->p_release_sys;
+
+    assert(picture->i_refcount == 0);
+
+    /* Restore old release callback */
+    picture->i_refcount    = 1;
+    picture->pf_release    = release_sys->release;
+    picture->p_release_sys = release_sys->release_sys;
+
+    picture_Release(picture);
+
+    free(release_sys);
+}
+
 static picture_pool_t *Create(picture_pool_t *master, int picture_count)
 {
     picture_pool_t *pool = calloc(1, sizeof(*pool));
@@ -72,6 +115,8 @@ static picture_pool_t *Create(picture_pool_t *master, int picture_count)
 
     pool->master = master;
     pool->tick = master ? master->tick : 1;
+    pool->can_grow = false;
+    pool->initial_count = picture_count;
     pool->picture_count = picture_count;
     pool->picture = calloc(pool->picture_count, sizeof(*pool->picture));
     pool->picture_reserved = calloc(pool->picture_count, sizeof(*pool->picture_reserved));
@@ -91,28 +136,10 @@ picture_pool_t *picture_pool_NewExtended(const picture_pool_configuration_t *cfg
         return NULL;
 
     for (int i = 0; i < cfg->picture_count; i++) {
-        picture_t *picture = cfg->picture[i];
-
-        /* The pool must be the only owner of the picture */
-        assert(picture->i_refcount == 1);
-
-        /* Install the new release callback */
-        picture_release_sys_t *release_sys = malloc(sizeof(*release_sys));
-        if (!release_sys)
-            abort();
-        release_sys->release     = picture->pf_release;
-        release_sys->release_sys = picture->p_release_sys;
-        release_sys->lock        = cfg->lock;
-        release_sys->unlock      = cfg->unlock;
-        release_sys->tick        = 0;
+        Install(cfg->picture[i], cfg->lock, cfg->unlock);
 
         /* */
-        picture->i_refcount    = 0;
-        picture->pf_release    = Release;
-        picture->p_release_sys = release_sys;
-
-        /* */
-        pool->picture[i] = picture;
+        pool->picture[i] = cfg->picture[i];
         pool->picture_reserved[i] = false;
     }
     return pool;
@@ -143,6 +170,8 @@ picture_pool_t *picture_pool_NewFromFormat(const video_format_t *fmt, int pictur
     if (!pool)
         goto error;
 
+    pool->can_grow = true;
+    pool->fmt      = *fmt;
     return pool;
 
 error:
@@ -189,19 +218,8 @@ void picture_pool_Delete(picture_pool_t *pool)
                     pool->master->picture_reserved[j] = false;
             }
         } else {
-            picture_release_sys_t *release_sys = picture->p_release_sys;
-
-            assert(picture->i_refcount == 0);
             assert(!pool->picture_reserved[i]);
-
-            /* Restore old release callback */
-            picture->i_refcount    = 1;
-            picture->pf_release    = release_sys->release;
-            picture->p_release_sys = release_sys->release_sys;
-
-            picture_Release(picture);
-
-            free(release_sys);
+            Uninstall(picture);
         }
     }
     free(pool->picture_reserved);
@@ -261,6 +279,69 @@ int picture_pool_GetSize(picture_pool_t *pool)
     return pool->picture_count;
 }
 
+int picture_pool_GetUsed(picture_pool_t *pool)
+{
+    int used = 0;
+
+    for (int i = 0; i < pool->picture_count; i++)
+        if (!pool->picture_reserved[i] && pool->picture[i]->i_refcount > 0)
+            used++;
+    return used;
+}
+
+int picture_pool_Grow(picture_pool_t *pool, int count)
+{
+    if (!pool->can_grow || count <= 0)
+        return 0;
+
+    const int total = pool->picture_count + count;
+    picture_t **pictures = realloc(pool->picture, total * sizeof(*pictures));
+    if (!pictures)
+        return 0;
+    pool->picture = pictures;
+    bool *reserved = realloc(pool->picture_reserved, total * sizeof(*reserved));
+    if (!reserved)
+        return 0;
+    pool->picture_reserved = reserved;
+
+    int added = 0;
+    while (added < count) {
+        picture_t *picture = picture_NewFromFormat(&pool->fmt);
+        if (!picture)
+            break;
+        Install(picture, NULL, NULL);
+
+        pool->picture[pool->picture_count] = picture;
+        pool->picture_reserved[pool->picture_count] = false;
+        pool->picture_count++;
+        added++;
+    }
+    return added;
+}
+
+int picture_pool_Shrink(picture_pool_t *pool, int count)
+{
+    int removed = 0;
+
+    /* The last pictures are the added ones */
+    for (int i = pool->picture_count - 1;
+         i >= pool->initial_count && removed < count; i--) {
+        picture_t *picture = pool->picture[i];
+
+        if (pool->picture_reserved[i] || picture->i_refcount > 0)
+            continue;
+
+        Uninstall(picture);
+        memmove(&pool->picture[i], &pool->picture[i + 1],
+                (pool->picture_count - i - 1) * sizeof(*pool->picture));
+        memmove(&pool->picture_reserved[i], &pool->picture_reserved[i + 1],
+                (pool->picture_count - i - 1) * sizeof(*pool->picture_reserved));
+        pool->picture_count--;
+        removed++;
+    }
+    return removed;
+}
+
 static void Release(picture_t *picture)
 {
     assert(picture->i_refcount > 0);
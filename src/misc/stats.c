@@ -30,16 +30,16 @@
 #endif
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 #include <stdio.h>                                               /* required */
+#include <stdarg.h>
+#include <assert.h>
 
 #include "input/input_internal.h"
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
-static int CounterUpdate( vlc_object_t *p_this,
-                          counter_t *p_counter,
-                          vlc_value_t val, vlc_value_t * );
 static void TimerDump( vlc_object_t *p_this, counter_t *p_counter, bool);
 
 /*****************************************************************************
@@ -76,70 +76,407 @@ counter_t * stats_CounterCreate( vlc_object_t *p_this,
     return p_counter;
 }
 
-/** Update a counter element with new values
+/*****************************************************************************
+ * Metrics
+ *****************************************************************************/
+#define STATS_SHARDS  8
+#define STATS_BUCKETS 32 /* the last one has no upper bound */
+
+/* Per shard: value (or sum), count, then the histogram buckets */
+#define SHARD_VALUE  0
+#define SHARD_COUNT  1
+#define SHARD_BUCKET 2
+
+struct stats_metric_t
+{
+    libvlc_priv_t  *priv;
+    stats_metric_t *p_prev;
+    stats_metric_t *p_next;
+
+    int             i_type;
+    char           *psz_name;
+    char           *psz_label;  /* formatted label pairs, or NULL */
+    size_t          i_stride;   /* values per shard, whole cache lines */
+    int64_t        *p_shards;
+};
+
+/* Threads are given shards in turn, once */
+static vlc_mutex_t shard_lock = VLC_STATIC_MUTEX;
+static vlc_threadvar_t shard_key;
+static bool shard_key_ok = false;
+static vlc_atomic_t shard_next = VLC_ATOMIC_INIT(0);
+
+static int64_t *Shard( stats_metric_t *p_metric )
+{
+    uintptr_t i = 0;
+
+    if( shard_key_ok )
+    {
+        void *p_value = vlc_threadvar_get( shard_key );
+
+        i = (uintptr_t)p_value;
+        if( i == 0 )
+        {
+            i = vlc_atomic_inc( &shard_next );
+            vlc_threadvar_set( shard_key, (void *)i );
+        }
+    }
+    return p_metric->p_shards + (i % STATS_SHARDS) * p_metric->i_stride;
+}
+
+static void ShardAdd( int64_t *p, int64_t i )
+{
+#if defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+    __sync_fetch_and_add( p, i );
+#else
+    vlc_mutex_lock( &shard_lock );
+    *p += i;
+    vlc_mutex_unlock( &shard_lock );
+#endif
+}
+
+/* Sums a value over all the shards */
+static int64_t ShardSum( const stats_metric_t *p_metric, unsigned i_index )
+{
+    int64_t i_sum = 0;
+
+#if !defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+    vlc_mutex_lock( &shard_lock );
+#endif
+    for( unsigned i = 0; i < STATS_SHARDS; i++ )
+    {
+        int64_t *p = p_metric->p_shards + i * p_metric->i_stride + i_index;
+#if defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+        i_sum += __sync_fetch_and_add( p, 0 );
+#else
+        i_sum += *p;
+#endif
+    }
+#if !defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+    vlc_mutex_unlock( &shard_lock );
+#endif
+    return i_sum;
+}
+
+/* Bucket i holds the values from 2^(i-1) to 2^i - 1, bucket 0 the others */
+static unsigned Bucket( int64_t i_value )
+{
+    unsigned i = 0;
+
+    while( i_value > 0 && i < STATS_BUCKETS - 1 )
+    {
+        i_value >>= 1;
+        i++;
+    }
+    return i;
+}
+
+/* Appends a label pair to the formatted ones, escaping the value */
+static char *LabelAppend( char *psz_labels, const char *psz_label,
+                          const char *psz_value )
+{
+    char *psz_escaped = malloc( 2 * strlen( psz_value ) + 1 ), *p, *psz;
+    if( psz_escaped == NULL )
+    {
+        free( psz_labels );
+        return NULL;
+    }
+
+    p = psz_escaped;
+    for( const char *q = psz_value; *q; q++ )
+    {
+        if( *q == '\\' || *q == '"' )
+            *(p++) = '\\';
+        else if( *q == '\n' )
+        {
+            *(p++) = '\\';
+            *(p++) = 'n';
+            continue;
+        }
+        *(p++) = *q;
+    }
+    *p = '\0';
+    if( asprintf( &psz, "%s%s%s=\"%s\"", psz_labels ? psz_labels : "",
+                  psz_labels ? "," : "", psz_label, psz_escaped ) == -1 )
+        psz = NULL;
+    free( psz_escaped );
+    free( psz_labels );
+    return psz;
+}
+
+#undef stats_MetricNew
+/**
+ * Create a metric, listed by stats_Export()
  * \param p_this a VLC object
- * \param p_counter the counter to update
- * \param val the vlc_value union containing the new value to aggregate. For
- * more information on how data is aggregated, \see stats_Create
- * \param val_new a pointer that will be filled with new data
+ * \param i_type STATS_METRIC_COUNTER, STATS_METRIC_GAUGE or
+ * STATS_METRIC_HISTOGRAM
+ * \param psz_name the name of the metric
+ * \param ... the names and values of the labels telling metrics of the
+ * same name apart, in pairs, terminated by NULL
+ * \return the metric, or NULL if statistics are disabled (all the
+ * metric functions accept NULL)
  */
-int stats_Update( vlc_object_t *p_this, counter_t *p_counter,
-                  vlc_value_t val, vlc_value_t *val_new )
+stats_metric_t *stats_MetricNew( vlc_object_t *p_this, int i_type,
+                                 const char *psz_name, ... )
 {
-    if( !libvlc_stats (p_this) || !p_counter ) return VLC_EGENERIC;
-    return CounterUpdate( p_this, p_counter, val, val_new );
+    libvlc_priv_t *priv = libvlc_priv( p_this->p_libvlc );
+
+    if( !priv->b_stats )
+        return NULL;
+
+    vlc_mutex_lock( &shard_lock );
+    if( !shard_key_ok )
+        shard_key_ok = !vlc_threadvar_create( &shard_key, NULL );
+    vlc_mutex_unlock( &shard_lock );
+
+    stats_metric_t *p_metric = malloc( sizeof( *p_metric ) );
+    if( unlikely(p_metric == NULL) )
+        return NULL;
+
+    size_t i_size = SHARD_BUCKET;
+    if( i_type == STATS_METRIC_HISTOGRAM )
+        i_size += STATS_BUCKETS;
+    p_metric->i_stride = (i_size + 7) & ~7;
+    p_metric->p_shards = vlc_memalign( 64, STATS_SHARDS * p_metric->i_stride
+                                           * sizeof( int64_t ) );
+    p_metric->psz_name = strdup( psz_name );
+    p_metric->psz_label = NULL;
+
+    va_list ap;
+    bool b_label_error = false;
+    va_start( ap, psz_name );
+    for( const char *psz_label; !b_label_error
+         && (psz_label = va_arg( ap, const char * )) != NULL; )
+    {
+        const char *psz_value = va_arg( ap, const char * );
+
+        p_metric->psz_label = LabelAppend( p_metric->psz_label, psz_label,
+                                           psz_value );
+        b_label_error = p_metric->psz_label == NULL;
+    }
+    va_end( ap );
+
+    if( unlikely(p_metric->p_shards == NULL || p_metric->psz_name == NULL
+              || b_label_error) )
+    {
+        free( p_metric->psz_label );
+        free( p_metric->psz_name );
+        vlc_free( p_metric->p_shards );
+        free( p_metric );
+        return NULL;
+    }
+    memset( p_metric->p_shards, 0,
+            STATS_SHARDS * p_metric->i_stride * sizeof( int64_t ) );
+    p_metric->i_type = i_type;
+    p_metric->priv = priv;
+
+    vlc_mutex_lock( &priv->metrics_lock );
+    p_metric->p_prev = NULL;
+    p_metric->p_next = priv->p_metrics;
+    if( priv->p_metrics != NULL )
+        priv->p_metrics->p_prev = p_metric;
+    priv->p_metrics = p_metric;
+    vlc_mutex_unlock( &priv->metrics_lock );
+
+    return p_metric;
+}
+
+void stats_MetricDelete( stats_metric_t *p_metric )
+{
+    if( p_metric == NULL )
+        return;
+
+    libvlc_priv_t *priv = p_metric->priv;
+
+    vlc_mutex_lock( &priv->metrics_lock );
+    if( p_metric->p_prev != NULL )
+        p_metric->p_prev->p_next = p_metric->p_next;
+    else
+        priv->p_metrics = p_metric->p_next;
+    if( p_metric->p_next != NULL )
+        p_metric->p_next->p_prev = p_metric->p_prev;
+    vlc_mutex_unlock( &priv->metrics_lock );
+
+    vlc_free( p_metric->p_shards );
+    free( p_metric->psz_label );
+    free( p_metric->psz_name );
+    free( p_metric );
+}
+
+/**
+ * Add to a counter or a gauge. This never blocks.
+ */
+void stats_MetricAdd( stats_metric_t *p_metric, int64_t i_value )
+{
+    if( p_metric == NULL )
+        return;
+
+    assert( p_metric->i_type != STATS_METRIC_HISTOGRAM );
+    ShardAdd( Shard( p_metric ) + SHARD_VALUE, i_value );
 }
 
-#undef stats_Get
-/** Get the aggregated value for a counter
- * \param p_this an object
- * \param p_counter the counter
- * \param val a pointer to an initialized vlc_value union. It will contain the
- * retrieved value
- * \return an error code
+/**
+ * Record a value in a histogram. This never blocks.
  */
-int stats_Get( vlc_object_t *p_this, counter_t *p_counter, vlc_value_t *val )
+void stats_MetricRecord( stats_metric_t *p_metric, int64_t i_value )
 {
-    if( !libvlc_stats (p_this) || !p_counter || p_counter->i_samples == 0 )
+    if( p_metric == NULL )
+        return;
+
+    assert( p_metric->i_type == STATS_METRIC_HISTOGRAM );
+    int64_t *p_shard = Shard( p_metric );
+    ShardAdd( p_shard + SHARD_VALUE, i_value );
+    ShardAdd( p_shard + SHARD_COUNT, 1 );
+    ShardAdd( p_shard + SHARD_BUCKET + Bucket( i_value ), 1 );
+}
+
+/**
+ * Get the value of a counter or a gauge, or the number of values recorded
+ * in a histogram
+ */
+int64_t stats_MetricGet( const stats_metric_t *p_metric )
+{
+    if( p_metric == NULL )
+        return 0;
+
+    return ShardSum( p_metric, p_metric->i_type == STATS_METRIC_HISTOGRAM
+                                   ? SHARD_COUNT : SHARD_VALUE );
+}
+
+static int MetricCmp( const void *a, const void *b )
+{
+    const stats_metric_t *p_a = *(const stats_metric_t **)a;
+    const stats_metric_t *p_b = *(const stats_metric_t **)b;
+    int i_ret = strcmp( p_a->psz_name, p_b->psz_name );
+
+    if( i_ret == 0 )
+        i_ret = strcmp( p_a->psz_label ? p_a->psz_label : "",
+                        p_b->psz_label ? p_b->psz_label : "" );
+    return i_ret;
+}
+
+/* Appends to a growing string, which is freed (and NULL) on error */
+typedef struct
+{
+    char  *psz;
+    size_t i_len;
+    size_t i_size;
+} buffer_t;
+
+VLC_FORMAT( 2, 3 )
+static void Append( buffer_t *p_buf, const char *psz_fmt, ... )
+{
+    va_list ap;
+
+    if( p_buf->psz == NULL )
+        return;
+
+    for( ;; )
     {
-        val->i_int = 0;
-        return VLC_EGENERIC;
+        va_start( ap, psz_fmt );
+        int i_ret = vsnprintf( p_buf->psz + p_buf->i_len,
+                               p_buf->i_size - p_buf->i_len, psz_fmt, ap );
+        va_end( ap );
+        if( i_ret < 0 )
+            break;
+        if( (size_t)i_ret < p_buf->i_size - p_buf->i_len )
+        {
+            p_buf->i_len += i_ret;
+            return;
+        }
+
+        char *psz = realloc( p_buf->psz, 2 * p_buf->i_size + i_ret );
+        if( psz == NULL )
+            break;
+        p_buf->psz = psz;
+        p_buf->i_size = 2 * p_buf->i_size + i_ret;
     }
+    free( p_buf->psz );
+    p_buf->psz = NULL;
+}
 
-    switch( p_counter->i_compute_type )
+#undef stats_Export
+/**
+ * Export all the metrics of a LibVLC instance, in the Prometheus text
+ * format. The values are summed over the shards here, so that the threads
+ * updating them are never disturbed.
+ * \return a heap-allocated string, or NULL on error
+ */
+char *stats_Export( vlc_object_t *p_this )
+{
+    libvlc_priv_t *priv = libvlc_priv( p_this->p_libvlc );
+    stats_metric_t **pp_metrics = NULL;
+    unsigned i_metrics = 0;
+    buffer_t buf;
+
+    buf.i_len = 0;
+    buf.i_size = 4096;
+    buf.psz = malloc( buf.i_size );
+    if( buf.psz == NULL )
+        return NULL;
+    buf.psz[0] = '\0';
+
+    vlc_mutex_lock( &priv->metrics_lock );
+    for( stats_metric_t *p = priv->p_metrics; p != NULL; p = p->p_next )
+        i_metrics++;
+    if( i_metrics > 0 )
+        pp_metrics = malloc( i_metrics * sizeof( *pp_metrics ) );
+    i_metrics = 0;
+    if( pp_metrics != NULL )
+        for( stats_metric_t *p = priv->p_metrics; p != NULL; p = p->p_next )
+            pp_metrics[i_metrics++] = p;
+    if( i_metrics > 1 )
+        qsort( pp_metrics, i_metrics, sizeof( *pp_metrics ), MetricCmp );
+
+    static const char *const types[] = { "counter", "gauge", "histogram" };
+
+    for( unsigned i = 0; i < i_metrics; i++ )
     {
-    case STATS_LAST:
-    case STATS_MIN:
-    case STATS_MAX:
-    case STATS_COUNTER:
-        *val = p_counter->pp_samples[0]->value;
-        break;
-    case STATS_DERIVATIVE:
-        /* Not ready yet */
-        if( p_counter->i_samples < 2 )
+        const stats_metric_t *p = pp_metrics[i];
+        const char *psz_label = p->psz_label ? p->psz_label : "";
+        const char *psz_sep = p->psz_label ? "," : "";
+
+        if( i == 0 || strcmp( pp_metrics[i - 1]->psz_name, p->psz_name ) )
+            Append( &buf, "# TYPE vlc_%s %s\n", p->psz_name,
+                    types[p->i_type] );
+
+        if( p->i_type != STATS_METRIC_HISTOGRAM )
         {
-            val->i_int = 0;
-            return VLC_EGENERIC;
+            Append( &buf, "vlc_%s%s%s%s %"PRId64"\n", p->psz_name,
+                    p->psz_label ? "{" : "", psz_label,
+                    p->psz_label ? "}" : "", ShardSum( p, SHARD_VALUE ) );
+            continue;
         }
-        if( p_counter->i_type == VLC_VAR_INTEGER )
+
+        /* Cumulative buckets, all of them so that every export has the
+         * same series */
+        int64_t buckets[STATS_BUCKETS], i_count = 0, i_total = 0;
+
+        for( unsigned j = 0; j < STATS_BUCKETS; j++ )
         {
-            float f = ( p_counter->pp_samples[0]->value.i_int -
-                        p_counter->pp_samples[1]->value.i_int ) /
-                    (float)(  p_counter->pp_samples[0]->date -
-                              p_counter->pp_samples[1]->date );
-            val->i_int = (int64_t)f;
+            buckets[j] = ShardSum( p, SHARD_BUCKET + j );
+            i_count += buckets[j];
         }
-        else
+        for( unsigned j = 0; j < STATS_BUCKETS - 1; j++ )
         {
-            float f = (float)( p_counter->pp_samples[0]->value.f_float -
-                               p_counter->pp_samples[1]->value.f_float ) /
-                      (float)( p_counter->pp_samples[0]->date -
-                               p_counter->pp_samples[1]->date );
-            val->f_float = f;
+            i_total += buckets[j];
+            Append( &buf, "vlc_%s_bucket{%s%sle=\"%"PRId64"\"} %"PRId64"\n",
+                    p->psz_name, psz_label, psz_sep,
+                    (INT64_C(1) << j) - 1, i_total );
         }
-        break;
+        Append( &buf, "vlc_%s_bucket{%s%sle=\"+Inf\"} %"PRId64"\n",
+                p->psz_name, psz_label, psz_sep, i_count );
+        Append( &buf, "vlc_%s_sum%s%s%s %"PRId64"\n", p->psz_name,
+                p->psz_label ? "{" : "", psz_label,
+                p->psz_label ? "}" : "", ShardSum( p, SHARD_VALUE ) );
+        Append( &buf, "vlc_%s_count%s%s%s %"PRId64"\n", p->psz_name,
+                p->psz_label ? "{" : "", psz_label,
+                p->psz_label ? "}" : "", i_count );
     }
-    return VLC_SUCCESS;;
+    vlc_mutex_unlock( &priv->metrics_lock );
+
+    free( pp_metrics );
+    return buf.psz;
 }
 
 input_stats_t *stats_NewInputStats( input_thread_t *p_input )
@@ -155,60 +492,74 @@ input_stats_t *stats_NewInputStats( input_thread_t *p_input )
     return p_stats;
 }
 
+/* Bytes per microsecond since the previous computation, if long enough */
+static float Bitrate( stats_rate_t *p_rate, int64_t i_bytes, mtime_t i_now,
+                      float f_bitrate )
+{
+    if( p_rate->i_date == 0 )
+        f_bitrate = 0.;
+    else if( i_now - p_rate->i_date >= CLOCK_FREQ / 2 )
+        f_bitrate = (i_bytes - p_rate->i_bytes)
+                  / (float)(i_now - p_rate->i_date);
+    else
+        return f_bitrate;
+
+    p_rate->i_bytes = i_bytes;
+    p_rate->i_date = i_now;
+    return f_bitrate;
+}
+
+/**
+ * Aggregates the input counters into the input item statistics.
+ * This is called from the input thread only.
+ */
 void stats_ComputeInputStats( input_thread_t *p_input, input_stats_t *p_stats )
 {
     if( !libvlc_stats (p_input) ) return;
 
-    vlc_mutex_lock( &p_input->p->counters.counters_lock );
+    mtime_t i_now = mdate();
+
     vlc_mutex_lock( &p_stats->lock );
 
+#define GET( field, c ) \
+    p_stats->field = stats_MetricGet( p_input->p->counters.p_##c )
     /* Input */
-    stats_GetInteger( p_input, p_input->p->counters.p_read_packets,
-                      &p_stats->i_read_packets );
-    stats_GetInteger( p_input, p_input->p->counters.p_read_bytes,
-                      &p_stats->i_read_bytes );
-    stats_GetFloat( p_input, p_input->p->counters.p_input_bitrate,
-                    &p_stats->f_input_bitrate );
-    stats_GetInteger( p_input, p_input->p->counters.p_demux_read,
-                      &p_stats->i_demux_read_bytes );
-    stats_GetFloat( p_input, p_input->p->counters.p_demux_bitrate,
-                    &p_stats->f_demux_bitrate );
-    stats_GetInteger( p_input, p_input->p->counters.p_demux_corrupted,
-                      &p_stats->i_demux_corrupted );
-    stats_GetInteger( p_input, p_input->p->counters.p_demux_discontinuity,
-                      &p_stats->i_demux_discontinuity );
+    GET( i_read_packets, read_packets );
+    GET( i_read_bytes, read_bytes );
+    p_stats->f_input_bitrate = Bitrate( &p_input->p->counters.input_rate,
+                                        p_stats->i_read_bytes, i_now,
+                                        p_stats->f_input_bitrate );
+    GET( i_demux_read_bytes, demux_read );
+    p_stats->f_demux_bitrate = Bitrate( &p_input->p->counters.demux_rate,
+                                        p_stats->i_demux_read_bytes, i_now,
+                                        p_stats->f_demux_bitrate );
+    GET( i_demux_corrupted, demux_corrupted );
+    GET( i_demux_discontinuity, demux_discontinuity );
 
     /* Decoders */
-    stats_GetInteger( p_input, p_input->p->counters.p_decoded_video,
-                      &p_stats->i_decoded_video );
-    stats_GetInteger( p_input, p_input->p->counters.p_decoded_audio,
-                      &p_stats->i_decoded_audio );
+    GET( i_decoded_video, decoded_video );
+    GET( i_decoded_audio, decoded_audio );
 
     /* Sout */
-    if( p_input->p->counters.p_sout_send_bitrate )
+    if( p_input->p->counters.p_sout_sent_bytes )
     {
-        stats_GetInteger( p_input, p_input->p->counters.p_sout_sent_packets,
-                          &p_stats->i_sent_packets );
-        stats_GetInteger( p_input, p_input->p->counters.p_sout_sent_bytes,
-                          &p_stats->i_sent_bytes );
-        stats_GetFloat  ( p_input, p_input->p->counters.p_sout_send_bitrate,
-                          &p_stats->f_send_bitrate );
+        GET( i_sent_packets, sout_sent_packets );
+        GET( i_sent_bytes, sout_sent_bytes );
+        p_stats->f_send_bitrate = Bitrate( &p_input->p->counters.send_rate,
+                                           p_stats->i_sent_bytes, i_now,
+                                           p_stats->f_send_bitrate );
     }
 
     /* Aout */
-    stats_GetInteger( p_input, p_input->p->counters.p_played_abuffers,
-                      &p_stats->i_played_abuffers );
-    stats_GetInteger( p_input, p_input->p->counters.p_lost_abuffers,
-                      &p_stats->i_lost_abuffers );
+    GET( i_played_abuffers, played_abuffers );
+    GET( i_lost_abuffers, lost_abuffers );
 
     /* Vouts */
-    stats_GetInteger( p_input, p_input->p->counters.p_displayed_pictures,
-                      &p_stats->i_displayed_pictures );
-    stats_GetInteger( p_input, p_input->p->counters.p_lost_pictures,
-                      &p_stats->i_lost_pictures );
+    GET( i_displayed_pictures, displayed_pictures );
+    GET( i_lost_pictures, lost_pictures );
+#undef GET
 
     vlc_mutex_unlock( &p_stats->lock );
-    vlc_mutex_unlock( &p_input->p->counters.counters_lock );
 }
 
 void stats_ReinitInputStats( input_stats_t *p_stats )
@@ -418,141 +769,6 @@ void stats_CounterClean( counter_t *p_c )
  * Following functions are local
  ********************************************************************/
 
-/**
- * Update a statistics counter, according to its type
- * If needed, perform a bit of computation (derivative, mostly)
- * This function must be entered with stats handler lock
- * \param p_counter the counter to update
- * \param val the "new" value
- * \return an error code
- */
-static int CounterUpdate( vlc_object_t *p_handler,
-                          counter_t *p_counter,
-                          vlc_value_t val, vlc_value_t *new_val )
-{
-    switch( p_counter->i_compute_type )
-    {
-    case STATS_LAST:
-    case STATS_MIN:
-    case STATS_MAX:
-        if( p_counter->i_samples > 1)
-        {
-            msg_Err( p_handler, "LAST counter has several samples !" );
-            return VLC_EGENERIC;
-        }
-        if( p_counter->i_type != VLC_VAR_FLOAT &&
-            p_counter->i_type != VLC_VAR_INTEGER &&
-            p_counter->i_compute_type != STATS_LAST )
-        {
-            msg_Err( p_handler, "unable to compute MIN or MAX for this type");
-            return VLC_EGENERIC;
-        }
-
-        if( p_counter->i_samples == 0 )
-        {
-            counter_sample_t *p_new = (counter_sample_t*)malloc(
-                                               sizeof( counter_sample_t ) );
-            p_new->value.i_int = 0;
-
-            INSERT_ELEM( p_counter->pp_samples, p_counter->i_samples,
-                         p_counter->i_samples, p_new );
-        }
-        if( p_counter->i_samples == 1 )
-        {
-            /* Update if : LAST or (MAX and bigger) or (MIN and bigger) */
-            if( p_counter->i_compute_type == STATS_LAST ||
-                ( p_counter->i_compute_type == STATS_MAX &&
-                   ( ( p_counter->i_type == VLC_VAR_INTEGER &&
-                       p_counter->pp_samples[0]->value.i_int > val.i_int ) ||
-                     ( p_counter->i_type == VLC_VAR_FLOAT &&
-                       p_counter->pp_samples[0]->value.f_float > val.f_float )
-                   ) ) ||
-                ( p_counter->i_compute_type == STATS_MIN &&
-                   ( ( p_counter->i_type == VLC_VAR_INTEGER &&
-                       p_counter->pp_samples[0]->value.i_int < val.i_int ) ||
-                     ( p_counter->i_type == VLC_VAR_FLOAT &&
-                       p_counter->pp_samples[0]->value.f_float < val.f_float )
-                   ) ) )
-            {
-                if( p_counter->i_type == VLC_VAR_STRING &&
-                    p_counter->pp_samples[0]->value.psz_string )
-                {
-                    free( p_counter->pp_samples[0]->value.psz_string );
-                }
-                p_counter->pp_samples[0]->value = val;
-                *new_val = p_counter->pp_samples[0]->value;
-            }
-        }
-        break;
-    case STATS_DERIVATIVE:
-    {
-        counter_sample_t *p_new, *p_old;
-        mtime_t now = mdate();
-        if( now - p_counter->last_update < p_counter->update_interval )
-        {
-            return VLC_EGENERIC;
-        }
-        p_counter->last_update = now;
-        if( p_counter->i_type != VLC_VAR_FLOAT &&
-            p_counter->i_type != VLC_VAR_INTEGER )
-        {
-            msg_Err( p_handler, "Unable to compute DERIVATIVE for this type");
-            return VLC_EGENERIC;
-        }
-        /* Insert the new one at the beginning */
-        p_new = (counter_sample_t*)malloc( sizeof( counter_sample_t ) );
-        p_new->value = val;
-        p_new->date = p_counter->last_update;
-        INSERT_ELEM( p_counter->pp_samples, p_counter->i_samples,
-                     0, p_new );
-
-        if( p_counter->i_samples == 3 )
-        {
-            p_old = p_counter->pp_samples[2];
-            REMOVE_ELEM( p_counter->pp_samples, p_counter->i_samples, 2 );
-            free( p_old );
-        }
-        break;
-    }
-    case STATS_COUNTER:
-        if( p_counter->i_samples > 1)
-        {
-            msg_Err( p_handler, "LAST counter has several samples !" );
-            return VLC_EGENERIC;
-        }
-        if( p_counter->i_samples == 0 )
-        {
-            counter_sample_t *p_new = (counter_sample_t*)malloc(
-                                               sizeof( counter_sample_t ) );
-            p_new->value.i_int = 0;
-
-            INSERT_ELEM( p_counter->pp_samples, p_counter->i_samples,
-                         p_counter->i_samples, p_new );
-        }
-        if( p_counter->i_samples == 1 )
-        {
-            switch( p_counter->i_type )
-            {
-            case VLC_VAR_INTEGER:
-                p_counter->pp_samples[0]->value.i_int += val.i_int;
-                if( new_val )
-                    new_val->i_int = p_counter->pp_samples[0]->value.i_int;
-                break;
-            case VLC_VAR_FLOAT:
-                p_counter->pp_samples[0]->value.f_float += val.f_float;
-                if( new_val )
-                    new_val->f_float = p_counter->pp_samples[0]->value.f_float;
-            default:
-                msg_Err( p_handler, "Trying to increment invalid variable %s",
-                         p_counter->psz_name );
-                return VLC_EGENERIC;
-            }
-        }
-        break;
-    }
-    return VLC_SUCCESS;
-}
-
 static void TimerDump( vlc_object_t *p_obj, counter_t *p_counter,
                        bool b_total )
 {
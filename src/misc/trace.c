@@ -0,0 +1,250 @@
+/*****************************************************************************
+ * trace.c: playback pipeline tracing
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_fs.h>
+#include <assert.h>
+
+#include "libvlc.h"
+
+/* The timeline keeps the last events only */
+#define TRACE_EVENTS (1 << 16)
+
+static const struct
+{
+    const char *psz_name;
+    bool        b_async; /* begins and ends in different threads */
+} stages[VLC_TRACE_STAGES] =
+{
+    [VLC_TRACE_DEMUX]         = { "demux",          false },
+    [VLC_TRACE_DECODER_QUEUE] = { "decoder_queue",  true  },
+    [VLC_TRACE_DECODE]        = { "decode",         false },
+    [VLC_TRACE_AUDIO_PLAY]    = { "audio_play",     false },
+    [VLC_TRACE_AUDIO_LATENCY] = { "audio_latency",  true  },
+    [VLC_TRACE_VIDEO_RENDER]  = { "video_render",   false },
+    [VLC_TRACE_VIDEO_DISPLAY] = { "video_display",  false },
+    [VLC_TRACE_VIDEO_LATENCY] = { "video_latency",  true  },
+    [VLC_TRACE_SOUT_MUX]      = { "sout_mux",       false },
+    [VLC_TRACE_SOUT_WRITE]    = { "sout_write",     false },
+};
+
+typedef struct
+{
+    mtime_t     i_start;
+    mtime_t     i_end;
+    const char *psz_type;  /* object type, static */
+    unsigned    i_thread;
+    int         i_stage;
+} trace_event_t;
+
+struct vlc_trace_t
+{
+    mtime_t          i_origin;
+    stats_metric_t  *pp_stages[VLC_TRACE_STAGES];
+
+    /* Timeline, only with a trace file */
+    char            *psz_file;
+    trace_event_t   *p_events;
+    vlc_atomic_t     next;
+    vlc_atomic_t     threads;
+    vlc_threadvar_t  thread_key;
+};
+
+/**
+ * Enables the tracing if requested. The tracer is only destroyed with
+ * LibVLC, once no other thread is left.
+ */
+void vlc_trace_Init( libvlc_int_t *p_libvlc )
+{
+    libvlc_priv_t *priv = libvlc_priv( p_libvlc );
+    char *psz_file = var_InheritString( p_libvlc, "trace-file" );
+
+    assert( priv->p_trace == NULL );
+    if( psz_file == NULL && !var_InheritBool( p_libvlc, "trace" ) )
+        return;
+
+    vlc_trace_t *p_trace = malloc( sizeof( *p_trace ) );
+    if( unlikely(p_trace == NULL) )
+    {
+        free( psz_file );
+        return;
+    }
+
+    p_trace->i_origin = mdate();
+    for( int i = 0; i < VLC_TRACE_STAGES; i++ )
+        p_trace->pp_stages[i] =
+            stats_MetricNew( p_libvlc, STATS_METRIC_HISTOGRAM,
+                             "trace_stage_microseconds", "stage",
+                             stages[i].psz_name, NULL );
+
+    p_trace->psz_file = psz_file;
+    p_trace->p_events = NULL;
+    vlc_atomic_set( &p_trace->next, 0 );
+    vlc_atomic_set( &p_trace->threads, 0 );
+    if( psz_file != NULL )
+    {
+        if( vlc_threadvar_create( &p_trace->thread_key, NULL ) == 0 )
+        {
+            p_trace->p_events = malloc( TRACE_EVENTS
+                                        * sizeof( *p_trace->p_events ) );
+            if( p_trace->p_events == NULL )
+                vlc_threadvar_delete( &p_trace->thread_key );
+        }
+        if( p_trace->p_events == NULL )
+            msg_Err( p_libvlc, "cannot record the trace timeline" );
+    }
+
+    msg_Dbg( p_libvlc, "tracing the pipeline%s%s",
+             psz_file ? " to " : "", psz_file ? psz_file : "" );
+    priv->p_trace = p_trace;
+}
+
+/* Writes the timeline in the Chrome trace event format */
+static void Dump( vlc_object_t *p_obj, vlc_trace_t *p_trace )
+{
+    uintptr_t i_total = vlc_atomic_get( &p_trace->next );
+    uintptr_t i_first = i_total > TRACE_EVENTS ? i_total - TRACE_EVENTS : 0;
+    unsigned i_threads = vlc_atomic_get( &p_trace->threads );
+
+    FILE *stream = vlc_fopen( p_trace->psz_file, "wt" );
+    if( stream == NULL )
+    {
+        msg_Err( p_obj, "cannot write trace file %s: %m", p_trace->psz_file );
+        return;
+    }
+
+    fputs( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", stream );
+
+    /* Threads are named after the first object they traced */
+    const char **ppsz_threads = calloc( i_threads + 1, sizeof( char * ) );
+    const char *psz_sep = "";
+
+    for( uintptr_t i = i_first; i < i_total; i++ )
+    {
+        const trace_event_t *p = &p_trace->p_events[i % TRACE_EVENTS];
+
+        if( ppsz_threads == NULL || ppsz_threads[p->i_thread] != NULL )
+            continue;
+        ppsz_threads[p->i_thread] = p->psz_type;
+        fprintf( stream, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+                 "\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                 psz_sep, p->i_thread, p->psz_type, p->i_thread );
+        psz_sep = ",\n";
+    }
+    free( ppsz_threads );
+
+    for( uintptr_t i = i_first; i < i_total; i++ )
+    {
+        const trace_event_t *p = &p_trace->p_events[i % TRACE_EVENTS];
+        const char *psz_name = stages[p->i_stage].psz_name;
+
+        if( stages[p->i_stage].b_async )
+            /* Overlapping spans: a begin and end pair each */
+            fprintf( stream, "%s{\"name\":\"%s\",\"cat\":\"%s\","
+                     "\"ph\":\"b\",\"id\":%"PRIuPTR",\"pid\":1,\"tid\":%u,"
+                     "\"ts\":%"PRId64"},\n"
+                     "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"e\","
+                     "\"id\":%"PRIuPTR",\"pid\":1,\"tid\":%u,"
+                     "\"ts\":%"PRId64"}",
+                     psz_sep, psz_name, p->psz_type, i, p->i_thread,
+                     p->i_start - p_trace->i_origin,
+                     psz_name, p->psz_type, i, p->i_thread,
+                     p->i_end - p_trace->i_origin );
+        else
+            fprintf( stream, "%s{\"name\":\"%s\",\"cat\":\"%s\","
+                     "\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%"PRId64","
+                     "\"dur\":%"PRId64"}",
+                     psz_sep, psz_name, p->psz_type, p->i_thread,
+                     p->i_start - p_trace->i_origin, p->i_end - p->i_start );
+        psz_sep = ",\n";
+    }
+    fputs( "\n]}\n", stream );
+
+    if( fclose( stream ) )
+        msg_Err( p_obj, "cannot write trace file %s: %m", p_trace->psz_file );
+    else
+        msg_Dbg( p_obj, "wrote %"PRIuPTR" trace events to %s",
+                 i_total - i_first, p_trace->psz_file );
+}
+
+void vlc_trace_Deinit( libvlc_int_t *p_libvlc )
+{
+    libvlc_priv_t *priv = libvlc_priv( p_libvlc );
+    vlc_trace_t *p_trace = priv->p_trace;
+
+    if( p_trace == NULL )
+        return;
+    priv->p_trace = NULL;
+
+    if( p_trace->p_events != NULL )
+    {
+        Dump( VLC_OBJECT(p_libvlc), p_trace );
+        free( p_trace->p_events );
+        vlc_threadvar_delete( &p_trace->thread_key );
+    }
+    for( int i = 0; i < VLC_TRACE_STAGES; i++ )
+        stats_MetricDelete( p_trace->pp_stages[i] );
+    free( p_trace->psz_file );
+    free( p_trace );
+}
+
+#undef vlc_trace_Span
+/**
+ * Records one stage of the pipeline, in the thread that completed it.
+ * \param i_stage VLC_TRACE_* stage
+ * \param i_start date the stage started at
+ * \param i_end date the stage ended at
+ */
+void vlc_trace_Span( vlc_object_t *p_obj, int i_stage, mtime_t i_start,
+                     mtime_t i_end )
+{
+    vlc_trace_t *p_trace = libvlc_priv( p_obj->p_libvlc )->p_trace;
+
+    assert( i_stage >= 0 && i_stage < VLC_TRACE_STAGES );
+    if( p_trace == NULL || i_start <= VLC_TS_INVALID )
+        return;
+
+    stats_MetricRecord( p_trace->pp_stages[i_stage], i_end - i_start );
+    if( p_trace->p_events == NULL )
+        return;
+
+    void *p_thread = vlc_threadvar_get( p_trace->thread_key );
+    unsigned i_thread = (uintptr_t)p_thread;
+    if( i_thread == 0 )
+    {
+        i_thread = vlc_atomic_inc( &p_trace->threads );
+        vlc_threadvar_set( p_trace->thread_key, (void *)(uintptr_t)i_thread );
+    }
+
+    /* Lock-free: the slots are only read once all threads are gone */
+    uintptr_t i = vlc_atomic_inc( &p_trace->next ) - 1;
+    trace_event_t *p = &p_trace->p_events[i % TRACE_EVENTS];
+
+    p->i_start = i_start;
+    p->i_end = i_end;
+    p->psz_type = p_obj->psz_object_type;
+    p->i_thread = i_thread;
+    p->i_stage = i_stage;
+}
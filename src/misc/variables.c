@@ -134,6 +134,7 @@ coords_ops = { NULL,       DupDummy,  FreeDummy,  };
 static void     WaitUnused  ( vlc_object_t *, variable_t * );
 
 static void     CheckValue  ( variable_t *, vlc_value_t * );
+static void     CheckVar    ( variable_t * );
 
 static int      TriggerCallback( vlc_object_t *, variable_t *, const char *,
                                  vlc_value_t );
@@ -157,6 +158,41 @@ static variable_t *Lookup( vlc_object_t *obj, const char *psz_name )
     return (pp_var != NULL) ? *pp_var : NULL;
 }
 
+/* Values are read without the lock through handles: the sequence number is
+ * odd while the value is changed (with the lock held). */
+static void WriteBegin( variable_t *p_var )
+{
+    vlc_atomic_inc( &p_var->seq );
+}
+
+static void WriteEnd( variable_t *p_var )
+{
+    vlc_atomic_inc( &p_var->seq );
+}
+
+/* Reads the sequence number, ordered before the following reads */
+static uintptr_t ReadBegin( const variable_t *p_var )
+{
+#ifdef __ATOMIC_ACQUIRE
+    return __atomic_load_n( &p_var->seq.u, __ATOMIC_ACQUIRE );
+#else
+    uintptr_t seq = vlc_atomic_get( &p_var->seq );
+    barrier();
+    return seq;
+#endif
+}
+
+/* Reads the sequence number again, ordered after the previous reads */
+static uintptr_t ReadEnd( const variable_t *p_var )
+{
+#ifdef __ATOMIC_ACQUIRE
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    return __atomic_load_n( &p_var->seq.u, __ATOMIC_RELAXED );
+#else
+    return vlc_atomic_get( &p_var->seq );
+#endif
+}
+
 static void Destroy( variable_t *p_var )
 {
     p_var->ops->pf_free( &p_var->val );
@@ -218,6 +254,7 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
 
     p_var->psz_name = strdup( psz_name );
     p_var->psz_text = NULL;
+    p_var->p_obj = p_this;
 
     p_var->i_type = i_type & ~VLC_VAR_DOINHERIT;
 
@@ -324,6 +361,22 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
     return ret;
 }
 
+/**
+ * Drops a reference to a variable, with the lock held.
+ * \return the variable to destroy (after unlocking), or NULL
+ */
+static variable_t *Release( vlc_object_t *p_this, variable_t *p_var )
+{
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    WaitUnused( p_this, p_var );
+
+    if( --p_var->i_usage > 0 )
+        return NULL;
+    tdelete( p_var, &p_priv->var_root, varcmp );
+    return p_var;
+}
+
 #undef var_Destroy
 /**
  * Destroy a vlc variable
@@ -351,12 +404,7 @@ int var_Destroy( vlc_object_t *p_this, const char *psz_name )
         return VLC_ENOVAR;
     }
 
-    WaitUnused( p_this, p_var );
-
-    if( --p_var->i_usage == 0 )
-        tdelete( p_var, &p_priv->var_root, varcmp );
-    else
-        p_var = NULL;
+    p_var = Release( p_this, p_var );
     vlc_mutex_unlock( &p_priv->var_lock );
 
     if( p_var != NULL )
@@ -419,7 +467,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             p_var->i_type |= VLC_VAR_HASMIN;
             p_var->min = *p_val;
             p_var->ops->pf_dup( &p_var->min );
-            CheckValue( p_var, &p_var->val );
+            CheckVar( p_var );
             break;
         case VLC_VAR_GETMIN:
             if( p_var->i_type & VLC_VAR_HASMIN )
@@ -435,7 +483,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             p_var->i_type |= VLC_VAR_HASMAX;
             p_var->max = *p_val;
             p_var->ops->pf_dup( &p_var->max );
-            CheckValue( p_var, &p_var->val );
+            CheckVar( p_var );
             break;
         case VLC_VAR_GETMAX:
             if( p_var->i_type & VLC_VAR_HASMAX )
@@ -451,7 +499,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             p_var->i_type |= VLC_VAR_HASSTEP;
             p_var->step = *p_val;
             p_var->ops->pf_dup( &p_var->step );
-            CheckValue( p_var, &p_var->val );
+            CheckVar( p_var );
             break;
         case VLC_VAR_GETSTEP:
             if( p_var->i_type & VLC_VAR_HASSTEP )
@@ -471,7 +519,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
                 ( p_val2 && p_val2->psz_string ) ?
                 strdup( p_val2->psz_string ) : NULL;
 
-            CheckValue( p_var, &p_var->val );
+            CheckVar( p_var );
             break;
         case VLC_VAR_DELCHOICE:
             for( i = 0 ; i < p_var->choices.i_count ; i++ )
@@ -504,7 +552,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             REMOVE_ELEM( p_var->choices_text.p_values,
                          p_var->choices_text.i_count, i );
 
-            CheckValue( p_var, &p_var->val );
+            CheckVar( p_var );
             break;
         case VLC_VAR_CHOICESCOUNT:
             p_val->i_int = p_var->choices.i_count;
@@ -543,7 +591,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             }
 
             p_var->i_default = i;
-            CheckValue( p_var, &p_var->val );
+            CheckVar( p_var );
             break;
         case VLC_VAR_SETVALUE:
             /* Duplicate data if needed */
@@ -554,7 +602,9 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             /* Check boundaries and list */
             CheckValue( p_var, &newval );
             /* Set the variable */
+            WriteBegin( p_var );
             p_var->val = newval;
+            WriteEnd( p_var );
             /* Free data if needed */
             p_var->ops->pf_free( &oldval );
             break;
@@ -655,6 +705,7 @@ int var_GetAndSet( vlc_object_t *p_this, const char *psz_name, int i_action,
     oldval = p_var->val;
 
     /* depending of the action requiered */
+    WriteBegin( p_var );
     switch( i_action )
     {
     case VLC_VAR_BOOL_TOGGLE:
@@ -674,12 +725,14 @@ int var_GetAndSet( vlc_object_t *p_this, const char *psz_name, int i_action,
         p_var->val.i_int &= ~p_val->i_int;
         break;
     default:
+        WriteEnd( p_var );
         vlc_mutex_unlock( &p_priv->var_lock );
         return VLC_EGENERIC;
     }
 
     /*  Check boundaries */
     CheckValue( p_var, &p_var->val );
+    WriteEnd( p_var );
     *p_val = p_var->val;
 
     /* Deal with callbacks.*/
@@ -718,33 +771,23 @@ int var_Type( vlc_object_t *p_this, const char *psz_name )
     return i_type;
 }
 
-#undef var_SetChecked
-int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
-                    int expected_type, vlc_value_t val )
+/**
+ * Sets the value of a variable, with the lock held.
+ */
+static int Set( vlc_object_t *p_this, variable_t *p_var, int expected_type,
+                vlc_value_t val )
 {
-    int i_ret = VLC_SUCCESS;
-    variable_t *p_var;
-    vlc_value_t oldval;
-
-    assert( p_this );
-
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
+    vlc_value_t oldval;
+    int i_ret;
 
-    vlc_mutex_lock( &p_priv->var_lock );
-
-    p_var = Lookup( p_this, psz_name );
-    if( p_var == NULL )
-    {
-        vlc_mutex_unlock( &p_priv->var_lock );
-        return VLC_ENOVAR;
-    }
-
+    vlc_assert_locked( &p_priv->var_lock );
     assert( expected_type == 0 ||
             (p_var->i_type & VLC_VAR_CLASS) == expected_type );
 #ifndef NDEBUG
         /* Alert if the type is VLC_VAR_VOID */
         if( ( p_var->i_type & VLC_VAR_TYPE ) == VLC_VAR_VOID )
-            msg_Warn( p_this, "Calling var_Set on the void variable '%s' (0x%04x)", psz_name, p_var->i_type );
+            msg_Warn( p_this, "Calling var_Set on the void variable '%s' (0x%04x)", p_var->psz_name, p_var->i_type );
 #endif
 
 
@@ -760,14 +803,40 @@ int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
     CheckValue( p_var, &val );
 
     /* Set the variable */
+    WriteBegin( p_var );
     p_var->val = val;
+    WriteEnd( p_var );
 
     /* Deal with callbacks */
-    i_ret = TriggerCallback( p_this, p_var, psz_name, oldval );
+    i_ret = TriggerCallback( p_this, p_var, p_var->psz_name, oldval );
 
     /* Free data if needed */
     p_var->ops->pf_free( &oldval );
 
+    return i_ret;
+}
+
+#undef var_SetChecked
+int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
+                    int expected_type, vlc_value_t val )
+{
+    int i_ret;
+    variable_t *p_var;
+
+    assert( p_this );
+
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    vlc_mutex_lock( &p_priv->var_lock );
+
+    p_var = Lookup( p_this, psz_name );
+    if( p_var == NULL )
+    {
+        vlc_mutex_unlock( &p_priv->var_lock );
+        return VLC_ENOVAR;
+    }
+
+    i_ret = Set( p_this, p_var, expected_type, val );
     vlc_mutex_unlock( &p_priv->var_lock );
 
     return i_ret;
@@ -837,6 +906,124 @@ int var_Get( vlc_object_t *p_this, const char *psz_name, vlc_value_t *p_val )
     return var_GetChecked( p_this, psz_name, 0, p_val );
 }
 
+/* A handle is the variable itself, with a reference */
+static variable_t *HandleVar( vlc_var_handle_t *p_handle )
+{
+    return (variable_t *)p_handle;
+}
+
+#undef var_Resolve
+/**
+ * Resolve a variable once, for frequent accesses
+ *
+ * The handle holds a reference to the variable, as var_Create() does, and
+ * must be released with var_HandleRelease() before the object is destroyed.
+ *
+ * \param p_this The object that holds the variable
+ * \param psz_name The name of the variable
+ * \param expected_type The expected type of the variable, or 0 for any
+ * \return the handle, or NULL if the variable does not exist or has another
+ * type
+ */
+vlc_var_handle_t *var_Resolve( vlc_object_t *p_this, const char *psz_name,
+                               int expected_type )
+{
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+    variable_t *p_var;
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    p_var = Lookup( p_this, psz_name );
+    if( p_var != NULL && expected_type != 0
+     && (p_var->i_type & VLC_VAR_CLASS) != expected_type )
+        p_var = NULL;
+    if( p_var != NULL )
+        p_var->i_usage++;
+    vlc_mutex_unlock( &p_priv->var_lock );
+
+    return (vlc_var_handle_t *)p_var;
+}
+
+/**
+ * Release a variable handle
+ */
+void var_HandleRelease( vlc_var_handle_t *p_handle )
+{
+    variable_t *p_var = HandleVar( p_handle );
+    vlc_object_t *p_this = p_var->p_obj;
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    p_var = Release( p_this, p_var );
+    vlc_mutex_unlock( &p_priv->var_lock );
+
+    if( p_var != NULL )
+        Destroy( p_var );
+}
+
+/**
+ * Get a variable's value through its handle
+ *
+ * Scalar values (booleans, integers, floats, times, coordinates and
+ * addresses) are read without locking. Strings are duplicated.
+ */
+void var_HandleGetChecked( vlc_var_handle_t *p_handle, int expected_type,
+                           vlc_value_t *p_val )
+{
+    variable_t *p_var = HandleVar( p_handle );
+
+    assert( expected_type == 0 ||
+            (p_var->i_type & VLC_VAR_CLASS) == expected_type );
+    VLC_UNUSED(expected_type);
+
+    switch( p_var->i_type & VLC_VAR_CLASS )
+    {
+        case VLC_VAR_BOOL:
+        case VLC_VAR_INTEGER:
+        case VLC_VAR_FLOAT:
+        case VLC_VAR_TIME:
+        case VLC_VAR_ADDRESS:
+        case VLC_VAR_COORDS:
+            /* Retry while the value is changed, up to a point */
+            for( unsigned i = 0; i < 16; i++ )
+            {
+                uintptr_t seq = ReadBegin( p_var );
+                if( seq & 1 )
+                    continue;
+
+                *p_val = p_var->val;
+                if( ReadEnd( p_var ) == seq )
+                    return;
+            }
+            break;
+    }
+
+    vlc_object_internals_t *p_priv = vlc_internals( p_var->p_obj );
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    *p_val = p_var->val;
+    p_var->ops->pf_dup( p_val );
+    vlc_mutex_unlock( &p_priv->var_lock );
+}
+
+/**
+ * Set a variable's value through its handle
+ *
+ * This triggers the callbacks as var_Set() does.
+ */
+int var_HandleSetChecked( vlc_var_handle_t *p_handle, int expected_type,
+                          vlc_value_t val )
+{
+    variable_t *p_var = HandleVar( p_handle );
+    vlc_object_internals_t *p_priv = vlc_internals( p_var->p_obj );
+    int i_ret;
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    i_ret = Set( p_var->p_obj, p_var, expected_type, val );
+    vlc_mutex_unlock( &p_priv->var_lock );
+
+    return i_ret;
+}
+
 #undef var_AddCallback
 /**
  * Register a callback in a variable
@@ -1230,6 +1417,14 @@ static void CheckValue ( variable_t *p_var, vlc_value_t *p_val )
     }
 }
 
+/* Checks the current value of a variable, after its constraints changed */
+static void CheckVar( variable_t *p_var )
+{
+    WriteBegin( p_var );
+    CheckValue( p_var, &p_var->val );
+    WriteEnd( p_var );
+}
+
 /**
  * Finds the value of a variable. If the specified object does not hold a
  * variable with the specified name, try the parent object, and iterate until
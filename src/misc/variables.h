@@ -24,6 +24,8 @@
 #ifndef LIBVLC_VARIABLES_H
 # define LIBVLC_VARIABLES_H 1
 
+# include <vlc_atomic.h>
+
 typedef struct callback_entry_t callback_entry_t;
 
 typedef struct variable_ops_t
@@ -43,6 +45,11 @@ struct variable_t
 
     /** The variable's exported value */
     vlc_value_t  val;
+    /** Odd while the value is changed, for the reads without the lock */
+    vlc_atomic_t seq;
+
+    /** The object holding the variable */
+    vlc_object_t *p_obj;
 
     /** The variable display name, mainly for use by the interfaces */
     char *       psz_text;
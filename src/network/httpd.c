@@ -39,6 +39,8 @@
 #include <vlc_rand.h>
 #include <vlc_charset.h>
 #include <vlc_url.h>
+#include <vlc_atomic.h>
+#include <vlc_fs.h>
 #include "../libvlc.h"
 
 #include <string.h>
@@ -51,6 +53,9 @@
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 
 #if defined( UNDER_CE )
 #   include <winsock.h>
@@ -67,7 +72,32 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* Client timeouts: a wheel of one second slots, the longer timeouts going
+ * around more than once */
+#define HTTPD_WHEEL_SLOTS 16
+#define HTTPD_WHEEL_TICK  CLOCK_FREQ
+
+/* Events handled per wake up of the host thread */
+#define HTTPD_EVENTS 64
+
+/* What an event of the host thread refers to */
+enum
+{
+    HTTPD_EVENT_LISTEN, /* a listening socket */
+    HTTPD_EVENT_DIE,    /* the object wait pipe */
+    HTTPD_EVENT_WAKE,   /* the host wake up pipe */
+    HTTPD_EVENT_CLIENT, /* a client socket */
+};
+
+typedef struct
+{
+    uint8_t i_type;
+    int     fd; /* the listening socket, unused otherwise */
+} httpd_event_t;
+
 static void httpd_ClientClean( httpd_client_t *cl );
+static void httpd_ClientRemove( httpd_host_t *, httpd_client_t * );
+static void httpd_WaitStart( httpd_host_t *, httpd_client_t * );
 
 /* each host run in his own thread */
 struct httpd_host_t
@@ -81,6 +111,7 @@ struct httpd_host_t
     int         *fds;
     unsigned     nfd;
     unsigned     port;
+    httpd_event_t *listen; /* event tags of the listening sockets */
 
     vlc_thread_t thread;
     vlc_mutex_t lock;
@@ -95,6 +126,25 @@ struct httpd_host_t
 
     int            i_client;
     httpd_client_t **client;
+    unsigned       i_client_max; /* 0 if unlimited */
+
+    /* events: the stream outputs have data, or clients have been closed */
+    int          wakefd[2];
+    vlc_atomic_t woken;
+    httpd_event_t die, wake;
+    httpd_client_t *waiting; /* clients to run on the next wake up */
+#ifdef HAVE_SYS_EPOLL_H
+    int          epfd;
+#endif
+
+    /* clients by activity timeout */
+    httpd_client_t *wheel[HTTPD_WHEEL_SLOTS];
+    unsigned        i_wheel;
+    mtime_t         i_wheel_date;
+
+    stats_metric_t *p_total_counter;
+    stats_metric_t *p_active_counter;
+    stats_metric_t *p_rejected_counter;
 
     /* TLS data */
     vlc_tls_creds_t *p_tls;
@@ -145,17 +195,24 @@ enum
 
 struct httpd_client_t
 {
+    httpd_event_t event; /* must be first */
     httpd_url_t *url;
 
     int     i_ref;
 
     int     fd;
+    int     i_events; /* polled events, -1 if not polled yet */
+    int     i_index;  /* in the host clients table */
 
     bool    b_stream_mode;
     uint8_t i_state;
 
     mtime_t i_activity_date;
     mtime_t i_activity_timeout;
+    httpd_client_t *p_timer_next;
+    httpd_client_t **pp_timer_prev; /* NULL if not in the timer wheel */
+    httpd_client_t *p_wait_next;
+    httpd_client_t **pp_wait_prev; /* NULL if not in the waiting list */
 
     /* buffer for reading header */
     int     i_buffer_size;
@@ -170,6 +227,13 @@ struct httpd_client_t
     vlc_tls_t *p_tls;
 };
 
+/* Wakes the host thread up, once until it is awake */
+static void httpd_HostWake( httpd_host_t *host )
+{
+    if( vlc_atomic_swap( &host->woken, 1 ) == 0 )
+        while( write( host->wakefd[1], "", 1 ) == -1 && errno == EINTR );
+}
+
 
 /*****************************************************************************
  * Various functions
@@ -935,6 +999,9 @@ int httpd_StreamSend( httpd_stream_t *stream, uint8_t *p_data, int i_data )
     stream->i_buffer_pos += i_data;
 
     vlc_mutex_unlock( &stream->lock );
+
+    /* for the clients waiting for data */
+    httpd_HostWake( stream->url->host );
     return VLC_SUCCESS;
 }
 
@@ -1086,6 +1153,11 @@ static httpd_host_t *httpd_HostCreate( vlc_object_t *p_this,
     vlc_mutex_init( &host->lock );
     vlc_cond_init( &host->wait );
     host->i_ref = 1;
+    host->wakefd[0] = host->wakefd[1] = -1;
+    host->listen = NULL;
+#ifdef HAVE_SYS_EPOLL_H
+    host->epfd = -1;
+#endif
 
     host->fds = net_ListenTCP( p_this, url.psz_host, port );
     if( host->fds == NULL )
@@ -1095,17 +1167,69 @@ static httpd_host_t *httpd_HostCreate( vlc_object_t *p_this,
     }
     for (host->nfd = 0; host->fds[host->nfd] != -1; host->nfd++);
 
-    if( vlc_object_waitpipe( VLC_OBJECT( host ) ) == -1 )
+    host->listen = malloc( host->nfd * sizeof( *host->listen ) );
+    if( host->listen == NULL )
+        goto error;
+    for( unsigned i = 0; i < host->nfd; i++ )
+    {
+        host->listen[i].i_type = HTTPD_EVENT_LISTEN;
+        host->listen[i].fd = host->fds[i];
+    }
+    host->die.i_type = HTTPD_EVENT_DIE;
+    host->wake.i_type = HTTPD_EVENT_WAKE;
+    host->waiting = NULL;
+
+    int evfd = vlc_object_waitpipe( VLC_OBJECT( host ) );
+    if( evfd == -1 || vlc_pipe( host->wakefd ) )
     {
         msg_Err( host, "signaling pipe error: %m" );
         goto error;
     }
+    vlc_atomic_set( &host->woken, 0 );
+
+#ifdef HAVE_SYS_EPOLL_H
+    host->epfd = epoll_create1( EPOLL_CLOEXEC );
+    if( host->epfd == -1 )
+    {
+        msg_Err( host, "cannot create event queue: %m" );
+        goto error;
+    }
+    for( unsigned i = 0; i <= host->nfd + 1; i++ )
+    {
+        struct epoll_event ev = { .events = EPOLLIN };
+        int fd;
+
+        if( i < host->nfd )
+        {
+            fd = host->fds[i];
+            ev.data.ptr = &host->listen[i];
+        }
+        else if( i == host->nfd )
+        {
+            fd = evfd;
+            ev.data.ptr = &host->die;
+        }
+        else
+        {
+            fd = host->wakefd[0];
+            ev.data.ptr = &host->wake;
+        }
+        if( epoll_ctl( host->epfd, EPOLL_CTL_ADD, fd, &ev ) )
+        {
+            msg_Err( host, "cannot poll socket: %m" );
+            goto error;
+        }
+    }
+#endif
 
     host->port     = port;
     host->i_url    = 0;
     host->url      = NULL;
     host->i_client = 0;
     host->client   = NULL;
+    host->i_client_max = var_InheritInteger( p_this, "http-max-clients" );
+    memset( host->wheel, 0, sizeof( host->wheel ) );
+    host->i_wheel  = 0;
     host->p_tls    = p_tls;
 
     /* create the thread */
@@ -1129,6 +1253,16 @@ error:
 
     if( host != NULL )
     {
+#ifdef HAVE_SYS_EPOLL_H
+        if( host->epfd != -1 )
+            close( host->epfd );
+#endif
+        if( host->wakefd[0] != -1 )
+        {
+            close( host->wakefd[1] );
+            close( host->wakefd[0] );
+        }
+        free( host->listen );
         net_ListenClose( host->fds );
         vlc_cond_destroy( &host->wait );
         vlc_mutex_destroy( &host->lock );
@@ -1177,20 +1311,23 @@ void httpd_HostDelete( httpd_host_t *host )
     {
         msg_Err( host, "url still registered: %s", host->url[i]->psz_url );
     }
-    for( i = 0; i < host->i_client; i++ )
+    while( host->i_client > 0 )
     {
-        httpd_client_t *cl = host->client[i];
         msg_Warn( host, "client still connected" );
-        httpd_ClientClean( cl );
-        TAB_REMOVE( host->i_client, host->client, cl );
-        free( cl );
-        i--;
+        httpd_ClientRemove( host, host->client[0] );
         /* TODO */
     }
+    free( host->client );
 
     if( host->p_tls != NULL)
         vlc_tls_ServerDelete( host->p_tls );
 
+#ifdef HAVE_SYS_EPOLL_H
+    close( host->epfd );
+#endif
+    close( host->wakefd[1] );
+    close( host->wakefd[0] );
+    free( host->listen );
     net_ListenClose( host->fds );
     vlc_cond_destroy( &host->wait );
     vlc_mutex_destroy( &host->lock );
@@ -1295,10 +1432,11 @@ void httpd_UrlDelete( httpd_url_t *url )
         {
             /* TODO complete it */
             msg_Warn( host, "force closing connections" );
-            httpd_ClientClean( client );
-            TAB_REMOVE( host->i_client, host->client, client );
-            free( client );
-            i--;
+            /* the host thread may be handling an event of this client */
+            client->url = NULL;
+            client->i_state = HTTPD_CLIENT_DEAD;
+            httpd_WaitStart( host, client );
+            httpd_HostWake( host );
         }
     }
     free( url );
@@ -1429,10 +1567,14 @@ static httpd_client_t *httpd_ClientNew( int fd, vlc_tls_t *p_tls, mtime_t now )
 
     if( !cl ) return NULL;
 
+    cl->event.i_type = HTTPD_EVENT_CLIENT;
     cl->i_ref   = 0;
     cl->fd      = fd;
+    cl->i_events = -1;
     cl->url     = NULL;
     cl->p_tls = p_tls;
+    cl->pp_timer_prev = NULL;
+    cl->pp_wait_prev = NULL;
 
     httpd_ClientInit( cl, now );
 
@@ -2030,479 +2172,725 @@ static void httpd_ClientTlsHsOut( httpd_client_t *cl )
     }
 }
 
-static void* httpd_HostThread( void *data )
+/* Answers a received request */
+static void httpd_ClientAnswer( httpd_host_t *host, httpd_client_t *cl )
 {
-    httpd_host_t *host = data;
-    counter_t *p_total_counter = stats_CounterCreate( host, VLC_VAR_INTEGER, STATS_COUNTER );
-    counter_t *p_active_counter = stats_CounterCreate( host, VLC_VAR_INTEGER, STATS_COUNTER );
-    int evfd = vlc_object_waitpipe( VLC_OBJECT( host ) );
+    httpd_message_t *answer = &cl->answer;
+    httpd_message_t *query  = &cl->query;
+    int i_msg = query->i_type;
 
-    for( ;; )
+    httpd_MsgInit( answer );
+
+    /* Handle what we received */
+    if( i_msg == HTTPD_MSG_ANSWER )
+    {
+        cl->url     = NULL;
+        cl->i_state = HTTPD_CLIENT_DEAD;
+    }
+    else if( i_msg == HTTPD_MSG_OPTIONS )
     {
-        struct pollfd ufd[host->nfd + host->i_client + 1];
-        unsigned nfd;
-        for( nfd = 0; nfd < host->nfd; nfd++ )
-        {
-            ufd[nfd].fd = host->fds[nfd];
-            ufd[nfd].events = POLLIN;
-            ufd[nfd].revents = 0;
-        }
 
-        /* add all socket that should be read/write and close dead connection */
-        vlc_mutex_lock( &host->lock );
-        while( host->i_url <= 0 && host->i_ref > 0 )
-            vlc_cond_wait( &host->wait, &host->lock );
+        answer->i_type   = HTTPD_MSG_ANSWER;
+        answer->i_proto  = query->i_proto;
+        answer->i_status = 200;
+        answer->i_body = 0;
+        answer->p_body = NULL;
 
-        mtime_t now = mdate();
-        bool b_low_delay = false;
+        httpd_MsgAdd( answer, "Server", "VLC/%s", VERSION );
+        httpd_MsgAdd( answer, "Content-Length", "0" );
 
-        for(int i_client = 0; i_client < host->i_client; i_client++ )
+        switch( query->i_proto )
         {
-            httpd_client_t *cl = host->client[i_client];
-            if( cl->i_ref < 0 || ( cl->i_ref == 0 &&
-                ( cl->i_state == HTTPD_CLIENT_DEAD ||
-                  ( cl->i_activity_timeout > 0 &&
-                    cl->i_activity_date+cl->i_activity_timeout < now) ) ) )
-            {
-                httpd_ClientClean( cl );
-                stats_UpdateInteger( host, p_active_counter, -1, NULL );
-                TAB_REMOVE( host->i_client, host->client, cl );
-                free( cl );
-                i_client--;
-                continue;
-            }
-
-            struct pollfd *pufd = ufd + nfd;
-            assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
-
-            pufd->fd = cl->fd;
-            pufd->events = pufd->revents = 0;
+            case HTTPD_PROTO_HTTP:
+                answer->i_version = 1;
+                httpd_MsgAdd( answer, "Allow",
+                              "GET,HEAD,POST,OPTIONS" );
+                break;
 
-            if( ( cl->i_state == HTTPD_CLIENT_RECEIVING )
-                  || ( cl->i_state == HTTPD_CLIENT_TLS_HS_IN ) )
-            {
-                pufd->events = POLLIN;
-            }
-            else if( ( cl->i_state == HTTPD_CLIENT_SENDING )
-                  || ( cl->i_state == HTTPD_CLIENT_TLS_HS_OUT ) )
+            case HTTPD_PROTO_RTSP:
             {
-                pufd->events = POLLOUT;
-            }
-            else if( cl->i_state == HTTPD_CLIENT_RECEIVE_DONE )
-            {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
-                int i_msg = query->i_type;
-
-                httpd_MsgInit( answer );
-
-                /* Handle what we received */
-                if( i_msg == HTTPD_MSG_ANSWER )
+                const char *p;
+                answer->i_version = 0;
+
+                p = httpd_MsgGet( query, "Cseq" );
+                if( p != NULL )
+                    httpd_MsgAdd( answer, "Cseq", "%s", p );
+                p = httpd_MsgGet( query, "Timestamp" );
+                if( p != NULL )
+                    httpd_MsgAdd( answer, "Timestamp", "%s", p );
+
+                p = httpd_MsgGet( query, "Require" );
+                if( p != NULL )
                 {
-                    cl->url     = NULL;
-                    cl->i_state = HTTPD_CLIENT_DEAD;
+                    answer->i_status = 551;
+                    httpd_MsgAdd( query, "Unsupported", "%s", p );
                 }
-                else if( i_msg == HTTPD_MSG_OPTIONS )
-                {
 
-                    answer->i_type   = HTTPD_MSG_ANSWER;
-                    answer->i_proto  = query->i_proto;
-                    answer->i_status = 200;
-                    answer->i_body = 0;
-                    answer->p_body = NULL;
+                httpd_MsgAdd( answer, "Public", "DESCRIBE,SETUP,"
+                              "TEARDOWN,PLAY,PAUSE,GET_PARAMETER" );
+                break;
+            }
+        }
 
-                    httpd_MsgAdd( answer, "Server", "VLC/%s", VERSION );
-                    httpd_MsgAdd( answer, "Content-Length", "0" );
+        cl->i_buffer = -1;  /* Force the creation of the answer in
+                             * httpd_ClientSend */
+        cl->i_state = HTTPD_CLIENT_SENDING;
+    }
+    else if( i_msg == HTTPD_MSG_NONE )
+    {
+        if( query->i_proto == HTTPD_PROTO_NONE )
+        {
+            cl->url = NULL;
+            cl->i_state = HTTPD_CLIENT_DEAD;
+        }
+        else
+        {
+            char *p;
 
-                    switch( query->i_proto )
-                    {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd( answer, "Allow",
-                                          "GET,HEAD,POST,OPTIONS" );
-                            break;
+            /* unimplemented */
+            answer->i_proto  = query->i_proto ;
+            answer->i_type   = HTTPD_MSG_ANSWER;
+            answer->i_version= 0;
+            answer->i_status = 501;
 
-                        case HTTPD_PROTO_RTSP:
-                        {
-                            const char *p;
-                            answer->i_version = 0;
-
-                            p = httpd_MsgGet( query, "Cseq" );
-                            if( p != NULL )
-                                httpd_MsgAdd( answer, "Cseq", "%s", p );
-                            p = httpd_MsgGet( query, "Timestamp" );
-                            if( p != NULL )
-                                httpd_MsgAdd( answer, "Timestamp", "%s", p );
-
-                            p = httpd_MsgGet( query, "Require" );
-                            if( p != NULL )
-                            {
-                                answer->i_status = 551;
-                                httpd_MsgAdd( query, "Unsupported", "%s", p );
-                            }
+            answer->i_body = httpd_HtmlError (&p, 501, NULL);
+            answer->p_body = (uint8_t *)p;
+            httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
 
-                            httpd_MsgAdd( answer, "Public", "DESCRIBE,SETUP,"
-                                          "TEARDOWN,PLAY,PAUSE,GET_PARAMETER" );
-                            break;
-                        }
-                    }
+            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+            cl->i_state = HTTPD_CLIENT_SENDING;
+        }
+    }
+    else
+    {
+        bool b_auth_failed = false;
+        bool b_hosts_failed = false;
 
-                    cl->i_buffer = -1;  /* Force the creation of the answer in
-                                         * httpd_ClientSend */
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
-                else if( i_msg == HTTPD_MSG_NONE )
+        /* Search the url and trigger callbacks */
+        for(int i = 0; i < host->i_url; i++ )
+        {
+            httpd_url_t *url = host->url[i];
+
+            if( !strcmp( url->psz_url, query->psz_url ) )
+            {
+                if( url->catch[i_msg].cb )
                 {
-                    if( query->i_proto == HTTPD_PROTO_NONE )
-                    {
-                        cl->url = NULL;
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    }
-                    else
+                    if( answer && ( url->p_acl != NULL ) )
                     {
-                        char *p;
-
-                        /* unimplemented */
-                        answer->i_proto  = query->i_proto ;
-                        answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_version= 0;
-                        answer->i_status = 501;
+                        char ip[NI_MAXNUMERICHOST];
 
-                        answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                        answer->p_body = (uint8_t *)p;
-                        httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
-
-                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
+                        if( ( httpd_ClientIP( cl, ip, NULL ) == NULL )
+                         || ACL_Check( url->p_acl, ip ) )
+                        {
+                            b_hosts_failed = true;
+                            break;
+                        }
                     }
-                }
-                else
-                {
-                    bool b_auth_failed = false;
-                    bool b_hosts_failed = false;
 
-                    /* Search the url and trigger callbacks */
-                    for(int i = 0; i < host->i_url; i++ )
+                    if( answer && ( *url->psz_user || *url->psz_password ) )
                     {
-                        httpd_url_t *url = host->url[i];
+                        /* create the headers */
+                        const char *b64 = httpd_MsgGet( query, "Authorization" ); /* BASIC id */
+                        char *user = NULL, *pass = NULL;
 
-                        if( !strcmp( url->psz_url, query->psz_url ) )
+                        if( b64 != NULL
+                         && !strncasecmp( b64, "BASIC", 5 ) )
                         {
-                            if( url->catch[i_msg].cb )
+                            b64 += 5;
+                            while( *b64 == ' ' )
+                                b64++;
+
+                            user = vlc_b64_decode( b64 );
+                            if (user != NULL)
                             {
-                                if( answer && ( url->p_acl != NULL ) )
-                                {
-                                    char ip[NI_MAXNUMERICHOST];
-
-                                    if( ( httpd_ClientIP( cl, ip, NULL ) == NULL )
-                                     || ACL_Check( url->p_acl, ip ) )
-                                    {
-                                        b_hosts_failed = true;
-                                        break;
-                                    }
-                                }
-
-                                if( answer && ( *url->psz_user || *url->psz_password ) )
-                                {
-                                    /* create the headers */
-                                    const char *b64 = httpd_MsgGet( query, "Authorization" ); /* BASIC id */
-                                    char *user = NULL, *pass = NULL;
-
-                                    if( b64 != NULL
-                                     && !strncasecmp( b64, "BASIC", 5 ) )
-                                    {
-                                        b64 += 5;
-                                        while( *b64 == ' ' )
-                                            b64++;
-
-                                        user = vlc_b64_decode( b64 );
-                                        if (user != NULL)
-                                        {
-                                            pass = strchr (user, ':');
-                                            if (pass != NULL)
-                                                *pass++ = '\0';
-                                        }
-                                    }
-
-                                    if ((user == NULL) || (pass == NULL)
-                                     || strcmp (user, url->psz_user)
-                                     || strcmp (pass, url->psz_password))
-                                    {
-                                        httpd_MsgAdd( answer,
-                                                      "WWW-Authenticate",
-                                                      "Basic realm=\"VLC stream\"" );
-                                        /* We fail for all url */
-                                        b_auth_failed = true;
-                                        free( user );
-                                        break;
-                                    }
-
-                                    free( user );
-                                }
-
-                                if( !url->catch[i_msg].cb( url->catch[i_msg].p_sys, cl, answer, query ) )
-                                {
-                                    if( answer->i_proto == HTTPD_PROTO_NONE )
-                                    {
-                                        /* Raw answer from a CGI */
-                                        cl->i_buffer = cl->i_buffer_size;
-                                    }
-                                    else
-                                        cl->i_buffer = -1;
-
-                                    /* only one url can answer */
-                                    answer = NULL;
-                                    if( cl->url == NULL )
-                                    {
-                                        cl->url = url;
-                                    }
-                                }
+                                pass = strchr (user, ':');
+                                if (pass != NULL)
+                                    *pass++ = '\0';
                             }
                         }
-                    }
-
-                    if( answer )
-                    {
-                        char *p;
 
-                        answer->i_proto  = query->i_proto;
-                        answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_version= 0;
-
-                        if( b_hosts_failed )
+                        if ((user == NULL) || (pass == NULL)
+                         || strcmp (user, url->psz_user)
+                         || strcmp (pass, url->psz_password))
                         {
-                            answer->i_status = 403;
+                            httpd_MsgAdd( answer,
+                                          "WWW-Authenticate",
+                                          "Basic realm=\"VLC stream\"" );
+                            /* We fail for all url */
+                            b_auth_failed = true;
+                            free( user );
+                            break;
                         }
-                        else if( b_auth_failed )
+
+                        free( user );
+                    }
+
+                    if( !url->catch[i_msg].cb( url->catch[i_msg].p_sys, cl, answer, query ) )
+                    {
+                        if( answer->i_proto == HTTPD_PROTO_NONE )
                         {
-                            answer->i_status = 401;
+                            /* Raw answer from a CGI */
+                            cl->i_buffer = cl->i_buffer_size;
                         }
                         else
+                            cl->i_buffer = -1;
+
+                        /* only one url can answer */
+                        answer = NULL;
+                        if( cl->url == NULL )
                         {
-                            /* no url registered */
-                            answer->i_status = 404;
+                            cl->url = url;
                         }
+                    }
+                }
+            }
+        }
 
-                        answer->i_body = httpd_HtmlError (&p,
-                                                          answer->i_status,
-                                                          query->psz_url);
-                        answer->p_body = (uint8_t *)p;
+        if( answer )
+        {
+            char *p;
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                        httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
-                        httpd_MsgAdd( answer, "Content-Type", "%s", "text/html" );
-                    }
+            answer->i_proto  = query->i_proto;
+            answer->i_type   = HTTPD_MSG_ANSWER;
+            answer->i_version= 0;
 
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
+            if( b_hosts_failed )
+            {
+                answer->i_status = 403;
             }
-            else if( cl->i_state == HTTPD_CLIENT_SEND_DONE )
+            else if( b_auth_failed )
             {
-                if( !cl->b_stream_mode || cl->answer.i_body_offset == 0 )
-                {
-                    const char *psz_connection = httpd_MsgGet( &cl->answer, "Connection" );
-                    const char *psz_query = httpd_MsgGet( &cl->query, "Connection" );
-                    bool b_connection = false;
-                    bool b_keepalive = false;
-                    bool b_query = false;
-
-                    cl->url = NULL;
-                    if( psz_connection )
-                    {
-                        b_connection = ( strcasecmp( psz_connection, "Close" ) == 0 );
-                        b_keepalive = ( strcasecmp( psz_connection, "Keep-Alive" ) == 0 );
-                    }
+                answer->i_status = 401;
+            }
+            else
+            {
+                /* no url registered */
+                answer->i_status = 404;
+            }
 
-                    if( psz_query )
-                    {
-                        b_query = ( strcasecmp( psz_query, "Close" ) == 0 );
-                    }
+            answer->i_body = httpd_HtmlError (&p,
+                                              answer->i_status,
+                                              query->psz_url);
+            answer->p_body = (uint8_t *)p;
 
-                    if( ( ( cl->query.i_proto == HTTPD_PROTO_HTTP ) &&
-                          ( ( cl->query.i_version == 0 && b_keepalive ) ||
-                            ( cl->query.i_version == 1 && !b_connection ) ) ) ||
-                        ( ( cl->query.i_proto == HTTPD_PROTO_RTSP ) &&
-                          !b_query && !b_connection ) )
-                    {
-                        httpd_MsgClean( &cl->query );
-                        httpd_MsgInit( &cl->query );
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free( cl->p_buffer );
-                        cl->p_buffer = xmalloc( cl->i_buffer_size );
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    }
-                    else
-                    {
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    }
-                    httpd_MsgClean( &cl->answer );
-                }
-                else
-                {
-                    int64_t i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean( &cl->answer );
+            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+            httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
+            httpd_MsgAdd( answer, "Content-Type", "%s", "text/html" );
+        }
 
-                    cl->answer.i_body_offset = i_offset;
-                    free( cl->p_buffer );
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
+        cl->i_state = HTTPD_CLIENT_SENDING;
+    }
+}
 
-                    cl->i_state = HTTPD_CLIENT_WAITING;
-                }
-            }
-            else if( cl->i_state == HTTPD_CLIENT_WAITING )
-            {
-                int64_t i_offset = cl->answer.i_body_offset;
-                int     i_msg = cl->query.i_type;
+/* Ends an answer: waits for the next request, or for more stream data */
+static void httpd_ClientDone( httpd_client_t *cl )
+{
+    if( !cl->b_stream_mode || cl->answer.i_body_offset == 0 )
+    {
+        const char *psz_connection = httpd_MsgGet( &cl->answer, "Connection" );
+        const char *psz_query = httpd_MsgGet( &cl->query, "Connection" );
+        bool b_connection = false;
+        bool b_keepalive = false;
+        bool b_query = false;
+
+        cl->url = NULL;
+        if( psz_connection )
+        {
+            b_connection = ( strcasecmp( psz_connection, "Close" ) == 0 );
+            b_keepalive = ( strcasecmp( psz_connection, "Keep-Alive" ) == 0 );
+        }
 
-                httpd_MsgInit( &cl->answer );
-                cl->answer.i_body_offset = i_offset;
+        if( psz_query )
+        {
+            b_query = ( strcasecmp( psz_query, "Close" ) == 0 );
+        }
 
-                cl->url->catch[i_msg].cb( cl->url->catch[i_msg].p_sys, cl,
-                                          &cl->answer, &cl->query );
-                if( cl->answer.i_type != HTTPD_MSG_NONE )
-                {
-                    /* we have new data, so re-enter send mode */
-                    cl->i_buffer      = 0;
-                    cl->p_buffer      = cl->answer.p_body;
-                    cl->i_buffer_size = cl->answer.i_body;
-                    cl->answer.p_body = NULL;
-                    cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
-            }
+        if( ( ( cl->query.i_proto == HTTPD_PROTO_HTTP ) &&
+              ( ( cl->query.i_version == 0 && b_keepalive ) ||
+                ( cl->query.i_version == 1 && !b_connection ) ) ) ||
+            ( ( cl->query.i_proto == HTTPD_PROTO_RTSP ) &&
+              !b_query && !b_connection ) )
+        {
+            httpd_MsgClean( &cl->query );
+            httpd_MsgInit( &cl->query );
 
-            if (pufd->events != 0)
-                nfd++;
-            else
-                b_low_delay = true;
+            cl->i_buffer = 0;
+            cl->i_buffer_size = 1000;
+            free( cl->p_buffer );
+            cl->p_buffer = xmalloc( cl->i_buffer_size );
+            cl->i_state = HTTPD_CLIENT_RECEIVING;
         }
-        vlc_mutex_unlock( &host->lock );
+        else
+        {
+            cl->i_state = HTTPD_CLIENT_DEAD;
+        }
+        httpd_MsgClean( &cl->answer );
+    }
+    else
+    {
+        int64_t i_offset = cl->answer.i_body_offset;
+        httpd_MsgClean( &cl->answer );
+
+        cl->answer.i_body_offset = i_offset;
+        free( cl->p_buffer );
+        cl->p_buffer = NULL;
+        cl->i_buffer = 0;
+        cl->i_buffer_size = 0;
+
+        cl->i_state = HTTPD_CLIENT_WAITING;
+    }
+}
+
+/* Asks a streaming client's URL for more data */
+static void httpd_ClientWait( httpd_client_t *cl )
+{
+    int64_t i_offset = cl->answer.i_body_offset;
+    int     i_msg = cl->query.i_type;
 
-        ufd[nfd].fd = evfd;
-        ufd[nfd].events = POLLIN;
-        ufd[nfd].revents = 0;
-        nfd++;
+    httpd_MsgInit( &cl->answer );
+    cl->answer.i_body_offset = i_offset;
 
-        /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
-        switch( poll( ufd, nfd, b_low_delay ? 20 : -1) )
+    cl->url->catch[i_msg].cb( cl->url->catch[i_msg].p_sys, cl,
+                              &cl->answer, &cl->query );
+    if( cl->answer.i_type != HTTPD_MSG_NONE )
+    {
+        /* we have new data, so re-enter send mode */
+        cl->i_buffer      = 0;
+        cl->p_buffer      = cl->answer.p_body;
+        cl->i_buffer_size = cl->answer.i_body;
+        cl->answer.p_body = NULL;
+        cl->answer.i_body = 0;
+        cl->i_state = HTTPD_CLIENT_SENDING;
+    }
+}
+
+/* Runs a client through the states that need no I/O */
+static void httpd_ClientProcess( httpd_host_t *host, httpd_client_t *cl )
+{
+    for( ;; )
+    {
+        switch( cl->i_state )
         {
-            case -1:
-                if (errno != EINTR)
-                {
-                    /* Kernel on low memory or a bug: pace */
-                    msg_Err( host, "polling error: %m" );
-                    msleep( 100000 );
+            case HTTPD_CLIENT_RECEIVE_DONE:
+                httpd_ClientAnswer( host, cl );
+                break;
+
+            case HTTPD_CLIENT_SEND_DONE:
+                httpd_ClientDone( cl );
+                break;
+
+            case HTTPD_CLIENT_WAITING: /* there may be data already */
+                httpd_ClientWait( cl );
+                if( cl->i_state == HTTPD_CLIENT_WAITING )
+                {   /* until the stream output wakes us up */
+                    httpd_WaitStart( host, cl );
+                    return;
                 }
-            case 0:
-                continue;
+                break;
+
+            default:
+                return;
         }
+    }
+}
 
-        if( ufd[nfd - 1].revents )
+/* Polls the socket of a client for its current state.
+ * The poll() and epoll event flags have the same values. */
+static int httpd_ClientPoll( httpd_host_t *host, httpd_client_t *cl )
+{
+    int events = 0;
+
+    switch( cl->i_state )
+    {
+        case HTTPD_CLIENT_RECEIVING:
+        case HTTPD_CLIENT_TLS_HS_IN:
+            events = POLLIN;
             break;
+        case HTTPD_CLIENT_SENDING:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            events = POLLOUT;
+            break;
+    }
 
-        /* Handle client sockets */
-        vlc_mutex_lock( &host->lock );
-        now = mdate();
-        nfd = host->nfd;
-        for( int i_client = 0; i_client < host->i_client; i_client++ )
+    if( events == cl->i_events )
+        return 0;
+#ifdef HAVE_SYS_EPOLL_H
+    /* Without events, errors and hang ups are still reported */
+    struct epoll_event ev = { .events = events, .data.ptr = &cl->event };
+    if( epoll_ctl( host->epfd, (cl->i_events == -1) ? EPOLL_CTL_ADD
+                                                    : EPOLL_CTL_MOD,
+                   cl->fd, &ev ) )
+    {
+        msg_Err( host, "cannot poll client: %m" );
+        return -1;
+    }
+#else
+    VLC_UNUSED(host);
+#endif
+    cl->i_events = events;
+    return 0;
+}
+
+/* Schedules the activity timeout of a client */
+static void httpd_TimerStop( httpd_client_t *cl )
+{
+    if( cl->pp_timer_prev == NULL )
+        return;
+    *cl->pp_timer_prev = cl->p_timer_next;
+    if( cl->p_timer_next != NULL )
+        cl->p_timer_next->pp_timer_prev = cl->pp_timer_prev;
+    cl->pp_timer_prev = NULL;
+}
+
+static void httpd_TimerStart( httpd_host_t *host, httpd_client_t *cl )
+{
+    httpd_TimerStop( cl );
+    if( cl->i_activity_timeout <= 0 )
+        return;
+
+    /* The slot of the deadline, or the last one if it is too far */
+    mtime_t ticks = (cl->i_activity_date + cl->i_activity_timeout
+                     - host->i_wheel_date) / HTTPD_WHEEL_TICK + 1;
+    if( ticks < 1 )
+        ticks = 1;
+    if( ticks > HTTPD_WHEEL_SLOTS - 1 )
+        ticks = HTTPD_WHEEL_SLOTS - 1;
+
+    httpd_client_t **pp = &host->wheel[(host->i_wheel + ticks)
+                                       % HTTPD_WHEEL_SLOTS];
+    cl->p_timer_next = *pp;
+    if( *pp != NULL )
+        (*pp)->pp_timer_prev = &cl->p_timer_next;
+    cl->pp_timer_prev = pp;
+    *pp = cl;
+}
+
+/* Lists a client to be run on the next wake up of the host thread */
+static void httpd_WaitStop( httpd_client_t *cl )
+{
+    if( cl->pp_wait_prev == NULL )
+        return;
+    *cl->pp_wait_prev = cl->p_wait_next;
+    if( cl->p_wait_next != NULL )
+        cl->p_wait_next->pp_wait_prev = cl->pp_wait_prev;
+    cl->pp_wait_prev = NULL;
+}
+
+static void httpd_WaitStart( httpd_host_t *host, httpd_client_t *cl )
+{
+    if( cl->pp_wait_prev != NULL )
+        return; /* already listed */
+
+    cl->p_wait_next = host->waiting;
+    if( host->waiting != NULL )
+        host->waiting->pp_wait_prev = &cl->p_wait_next;
+    cl->pp_wait_prev = &host->waiting;
+    host->waiting = cl;
+}
+
+static void httpd_ClientAdd( httpd_host_t *host, httpd_client_t *cl )
+{
+    cl->i_index = host->i_client;
+    TAB_APPEND( host->i_client, host->client, cl );
+    httpd_TimerStart( host, cl );
+}
+
+static void httpd_ClientRemove( httpd_host_t *host, httpd_client_t *cl )
+{
+    httpd_client_t *last = host->client[--host->i_client];
+
+    /* The socket leaves the epoll set as it is closed */
+    httpd_TimerStop( cl );
+    httpd_WaitStop( cl );
+    httpd_ClientClean( cl );
+    stats_MetricAdd( host->p_active_counter, -1 );
+    host->client[cl->i_index] = last;
+    last->i_index = cl->i_index;
+    free( cl );
+}
+
+/* Runs the clients whose activity timeout expired off the wheel */
+static void httpd_HostExpire( httpd_host_t *host, mtime_t now )
+{
+    if( now - host->i_wheel_date > HTTPD_WHEEL_SLOTS * HTTPD_WHEEL_TICK )
+        host->i_wheel_date = now - HTTPD_WHEEL_SLOTS * HTTPD_WHEEL_TICK;
+
+    while( host->i_wheel_date + HTTPD_WHEEL_TICK <= now )
+    {
+        host->i_wheel_date += HTTPD_WHEEL_TICK;
+        host->i_wheel = (host->i_wheel + 1) % HTTPD_WHEEL_SLOTS;
+
+        httpd_client_t *cl = host->wheel[host->i_wheel];
+        host->wheel[host->i_wheel] = NULL;
+        while( cl != NULL )
         {
-            httpd_client_t *cl = host->client[i_client];
-            const struct pollfd *pufd = &ufd[nfd];
+            httpd_client_t *next = cl->p_timer_next;
+
+            cl->pp_timer_prev = NULL;
+            if( cl->i_ref == 0 && cl->i_activity_timeout > 0
+             && cl->i_activity_date + cl->i_activity_timeout < now )
+                httpd_ClientRemove( host, cl );
+            else /* active since it was scheduled */
+                httpd_TimerStart( host, cl );
+            cl = next;
+        }
+    }
+}
 
-            assert( pufd < &ufd[sizeof(ufd) / sizeof(ufd[0])] );
+/* Handles the events on the socket of a client */
+static void httpd_ClientEvent( httpd_host_t *host, httpd_client_t *cl,
+                               int revents, mtime_t now )
+{
+    cl->i_activity_date = now;
 
-            if( cl->fd != pufd->fd )
-                continue; // we were not waiting for this client
-            ++nfd;
-            if( pufd->revents == 0 )
-                continue; // no event received
+    switch( cl->i_state )
+    {
+        case HTTPD_CLIENT_RECEIVING:
+            httpd_ClientRecv( cl );
+            break;
+        case HTTPD_CLIENT_SENDING:
+            httpd_ClientSend( cl );
+            break;
+        case HTTPD_CLIENT_TLS_HS_IN:
+            httpd_ClientTlsHsIn( cl );
+            break;
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            httpd_ClientTlsHsOut( cl );
+            break;
+        default: /* not polled, only errors are reported */
+            if( revents & (POLLERR|POLLHUP) )
+                cl->i_state = HTTPD_CLIENT_DEAD;
+    }
 
-            cl->i_activity_date = now;
+    httpd_ClientProcess( host, cl );
+    if( cl->i_state == HTTPD_CLIENT_DEAD || httpd_ClientPoll( host, cl ) )
+        httpd_ClientRemove( host, cl );
+}
 
-            if( cl->i_state == HTTPD_CLIENT_RECEIVING )
-            {
-                httpd_ClientRecv( cl );
-            }
-            else if( cl->i_state == HTTPD_CLIENT_SENDING )
-            {
-                httpd_ClientSend( cl );
-            }
-            else if( cl->i_state == HTTPD_CLIENT_TLS_HS_IN )
-            {
-                httpd_ClientTlsHsIn( cl );
-            }
-            else if( cl->i_state == HTTPD_CLIENT_TLS_HS_OUT )
-            {
-                httpd_ClientTlsHsOut( cl );
-            }
+/* Serves the clients that waited for stream data, and removes the clients
+ * closed by httpd_UrlDelete(). Only those are in the waiting list. */
+static void httpd_HostWakeUp( httpd_host_t *host )
+{
+    char dummy[16];
+
+    while( read( host->wakefd[0], dummy, sizeof( dummy ) ) == -1
+        && errno == EINTR );
+    vlc_atomic_set( &host->woken, 0 );
+
+    /* The clients still waiting afterwards are listed again */
+    httpd_client_t *cl = host->waiting;
+    host->waiting = NULL;
+    while( cl != NULL )
+    {
+        httpd_client_t *next = cl->p_wait_next;
+
+        cl->pp_wait_prev = NULL;
+        if( cl->i_state == HTTPD_CLIENT_WAITING )
+            httpd_ClientProcess( host, cl );
+        if( cl->i_state == HTTPD_CLIENT_DEAD || httpd_ClientPoll( host, cl ) )
+            httpd_ClientRemove( host, cl );
+        cl = next;
+    }
+}
+
+/* Accepts a new connection */
+static void httpd_HostAccept( httpd_host_t *host, int fd, mtime_t now )
+{
+    httpd_client_t *cl;
+    int i_state = -1;
+
+    fd = vlc_accept (fd, NULL, NULL, true);
+    if (fd == -1)
+        return;
+
+    vlc_mutex_lock( &host->lock );
+    bool full = host->i_client_max > 0
+             && (unsigned)host->i_client >= host->i_client_max;
+    vlc_mutex_unlock( &host->lock );
+    if( full )
+    {
+        msg_Dbg( host, "too many clients, rejecting connection" );
+        stats_MetricAdd( host->p_rejected_counter, 1 );
+        net_Close( fd );
+        return;
+    }
+
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+                &(int){ 1 }, sizeof(int));
+
+    vlc_tls_t *p_tls;
+
+    if( host->p_tls != NULL )
+    {
+        p_tls = vlc_tls_ServerSessionCreate( host->p_tls, fd );
+        switch( vlc_tls_ServerSessionHandshake( p_tls ) )
+        {
+            case -1:
+                msg_Err( host, "Rejecting TLS connection" );
+                /* p_tls is destroyed implicitly */
+                net_Close( fd );
+                return;
+
+            case 1: /* missing input - most likely */
+                i_state = HTTPD_CLIENT_TLS_HS_IN;
+                break;
+
+            case 2: /* missing output */
+                i_state = HTTPD_CLIENT_TLS_HS_OUT;
+                break;
         }
+    }
+    else
+        p_tls = NULL;
+
+    stats_MetricAdd( host->p_total_counter, 1 );
+    stats_MetricAdd( host->p_active_counter, 1 );
+    cl = httpd_ClientNew( fd, p_tls, now );
+    if( i_state != -1 )
+        cl->i_state = i_state; // override state for TLS
+    vlc_mutex_lock( &host->lock );
+    httpd_ClientAdd( host, cl );
+    if( httpd_ClientPoll( host, cl ) )
+        httpd_ClientRemove( host, cl );
+    vlc_mutex_unlock( &host->lock );
+}
+
+static void* httpd_HostThread( void *data )
+{
+    httpd_host_t *host = data;
+    char psz_port[6];
+    snprintf( psz_port, sizeof( psz_port ), "%u", host->port );
+    host->p_total_counter =
+        stats_MetricNew( host, STATS_METRIC_COUNTER, "httpd_connections",
+                         "port", psz_port, NULL );
+    host->p_active_counter =
+        stats_MetricNew( host, STATS_METRIC_GAUGE, "httpd_active_connections",
+                         "port", psz_port, NULL );
+    host->p_rejected_counter =
+        stats_MetricNew( host, STATS_METRIC_COUNTER,
+                         "httpd_rejected_connections", "port", psz_port,
+                         NULL );
+#ifndef HAVE_SYS_EPOLL_H
+    int evfd = vlc_object_waitpipe( VLC_OBJECT( host ) );
+#endif
+    host->i_wheel_date = mdate();
+
+    for( ;; )
+    {
+        vlc_mutex_lock( &host->lock );
+        while( host->i_url <= 0 && host->i_ref > 0 )
+            vlc_cond_wait( &host->wait, &host->lock );
+
+        /* Only the clients with events are looked at, but for the timeouts
+         * which are checked once per tick */
+        mtime_t now = mdate();
+        httpd_HostExpire( host, now );
+
+        int timeout = -1;
+        if( host->i_client > 0 )
+            timeout = (host->i_wheel_date + HTTPD_WHEEL_TICK - now + 999)
+                      / 1000;
+
+#ifdef HAVE_SYS_EPOLL_H
         vlc_mutex_unlock( &host->lock );
 
-        /* Handle server sockets (accept new connections) */
-        for( nfd = 0; nfd < host->nfd; nfd++ )
-        {
-            httpd_client_t *cl;
-            int i_state = -1;
-            int fd = ufd[nfd].fd;
+        struct epoll_event ev[HTTPD_EVENTS];
+        int n = epoll_wait( host->epfd, ev, HTTPD_EVENTS, timeout );
+#else
+        /* Without epoll, the polled sockets are listed each time */
+        struct pollfd ev[host->nfd + host->i_client + 2];
+        httpd_event_t *tags[host->nfd + host->i_client + 2];
+        unsigned nfd = 0;
 
-            assert (fd == host->fds[nfd]);
+        for( unsigned i = 0; i < host->nfd; i++ )
+        {
+            tags[nfd] = &host->listen[i];
+            ev[nfd].fd = host->fds[i];
+            ev[nfd++].events = POLLIN;
+        }
+        tags[nfd] = &host->die;
+        ev[nfd].fd = evfd;
+        ev[nfd++].events = POLLIN;
+        tags[nfd] = &host->wake;
+        ev[nfd].fd = host->wakefd[0];
+        ev[nfd++].events = POLLIN;
+        for( int i = 0; i < host->i_client; i++ )
+        {
+            httpd_client_t *cl = host->client[i];
 
-            if( ufd[nfd].revents == 0 )
+            if( cl->i_events == 0 )
                 continue;
+            tags[nfd] = &cl->event;
+            ev[nfd].fd = cl->fd;
+            ev[nfd++].events = cl->i_events;
+        }
+        vlc_mutex_unlock( &host->lock );
 
-            /* */
-            fd = vlc_accept (fd, NULL, NULL, true);
-            if (fd == -1)
-                continue;
-            setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                        &(int){ 1 }, sizeof(int));
+        int n = poll( ev, nfd, timeout );
+#endif
+        if( n == -1 )
+        {
+            if (errno != EINTR)
+            {
+                /* Kernel on low memory or a bug: pace */
+                msg_Err( host, "polling error: %m" );
+                msleep( 100000 );
+            }
+            continue;
+        }
 
-            vlc_tls_t *p_tls;
+        /* Handle the events. The clients are removed only by this thread,
+         * and only once their own event is handled. */
+        bool b_die = false, b_woken = false;
 
-            if( host->p_tls != NULL )
+        vlc_mutex_lock( &host->lock );
+        now = mdate();
+#ifdef HAVE_SYS_EPOLL_H
+        for( int i = 0; i < n; i++ )
+        {
+            httpd_event_t *tag = ev[i].data.ptr;
+            int revents = ev[i].events;
+#else
+        for( unsigned i = 0; i < nfd; i++ )
+        {
+            httpd_event_t *tag = tags[i];
+            int revents = ev[i].revents;
+
+            if( revents == 0 )
+                continue;
+#endif
+            switch( tag->i_type )
             {
-                p_tls = vlc_tls_ServerSessionCreate( host->p_tls, fd );
-                switch( vlc_tls_ServerSessionHandshake( p_tls ) )
-                {
-                    case -1:
-                        msg_Err( host, "Rejecting TLS connection" );
-                        /* p_tls is destroyed implicitly */
-                        net_Close( fd );
-                        fd = -1;
-                        p_tls = NULL;
-                        continue;
-
-                    case 1: /* missing input - most likely */
-                        i_state = HTTPD_CLIENT_TLS_HS_IN;
-                        break;
-
-                    case 2: /* missing output */
-                        i_state = HTTPD_CLIENT_TLS_HS_OUT;
-                        break;
-                }
+                case HTTPD_EVENT_DIE:
+                    b_die = true;
+                    break;
+                case HTTPD_EVENT_WAKE:
+                    b_woken = true;
+                    break;
+                case HTTPD_EVENT_LISTEN:
+                    /* Handle server sockets (accept new connections) */
+                    vlc_mutex_unlock( &host->lock );
+                    httpd_HostAccept( host, tag->fd, now );
+                    vlc_mutex_lock( &host->lock );
+                    break;
+                case HTTPD_EVENT_CLIENT:
+                    httpd_ClientEvent( host, (httpd_client_t *)tag, revents,
+                                       now );
+                    break;
             }
-            else
-                p_tls = NULL;
-
-            stats_UpdateInteger( host, p_total_counter, 1, NULL );
-            stats_UpdateInteger( host, p_active_counter, 1, NULL );
-            cl = httpd_ClientNew( fd, p_tls, now );
-            vlc_mutex_lock( &host->lock );
-            TAB_APPEND( host->i_client, host->client, cl );
-            vlc_mutex_unlock( &host->lock );
-            if( i_state != -1 )
-                cl->i_state = i_state; // override state for TLS
         }
+        if( b_woken )
+            httpd_HostWakeUp( host );
+        vlc_mutex_unlock( &host->lock );
 
+        if( b_die )
+            break;
     }
 
-    if( p_total_counter )
-        stats_CounterClean( p_total_counter );
-    if( p_active_counter )
-        stats_CounterClean( p_active_counter );
+    stats_MetricDelete( host->p_total_counter );
+    stats_MetricDelete( host->p_active_counter );
+    stats_MetricDelete( host->p_rejected_counter );
+    host->p_total_counter = host->p_active_counter = NULL;
+    host->p_rejected_counter = NULL;
     return NULL;
 }
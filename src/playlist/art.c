@@ -27,6 +27,8 @@
 #endif
 
 #include <assert.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <vlc_common.h>
 #include <vlc_playlist.h>
 #include <vlc_fs.h>
@@ -34,14 +36,56 @@
 #include <vlc_stream.h>
 #include <vlc_url.h>
 #include <vlc_md5.h>
-
-#ifdef HAVE_SYS_STAT_H
-#   include <sys/stat.h>
-#endif
+#include <vlc_image.h>
+#include <vlc_block.h>
 
 #include "../libvlc.h"
 #include "playlist_internal.h"
 
+/*
+ * The art cache is content-addressed:
+ *   art/data/<md5 of the picture><extension>  each picture, stored once
+ *   art/data/<md5>-<size>.png                 its thumbnails
+ *   art/index                                 the picture of each album or
+ *                                             art URL, and the order of
+ *                                             their last uses
+ * Each playlist keeps the index in memory, so that looking art up does not
+ * touch the file system. The index on disk is merged before being written,
+ * as other instances may share it. The least recently used pictures are
+ * evicted once the cache exceeds its size limit.
+ */
+#define ART_INDEX_MAGIC "VLC art index 1"
+#define ART_MISSING_TTL (7 * 24 * 3600) /* art searched for in vain */
+#define ART_FLUSH_DELAY 60 /* between saves of the last uses */
+
+typedef struct
+{
+    char     *psz_name;   /* in the data directory */
+    char     *psz_thumbs; /* sizes of the thumbnails, comma separated */
+    uint64_t i_size;      /* with the thumbnails */
+    uint64_t i_used;      /* use count at the last use */
+    unsigned i_refs;      /* keys */
+    bool     b_evicted;
+} art_picture_t;
+
+typedef struct
+{
+    art_picture_t *p_picture; /* NULL if the art is missing */
+    time_t        i_date;     /* when the art was found missing */
+} art_key_t;
+
+struct playlist_art_t
+{
+    vlc_mutex_t      lock;
+    char             *psz_dir;  /* of the loaded index */
+    vlc_dictionary_t keys;      /* art_key_t */
+    vlc_dictionary_t pictures;  /* art_picture_t */
+    uint64_t         i_size;
+    uint64_t         i_uses;    /* orders the uses of the pictures */
+    time_t           i_flushed;
+    bool             b_dirty;
+};
+
 static void ArtCacheCreateDir( const char *psz_dir )
 {
     char newdir[strlen( psz_dir ) + 1];
@@ -62,22 +106,31 @@ static void ArtCacheCreateDir( const char *psz_dir )
     vlc_mkdir( psz_dir, 0700 );
 }
 
-static char* ArtCacheGetDirPath( const char *psz_arturl, const char *psz_artist,
-                                 const char *psz_album,  const char *psz_title )
+static char *ArtCacheDir( void )
 {
     char *psz_dir;
     char *psz_cachedir = config_GetUserDir(VLC_CACHE_DIR);
 
+    if( asprintf( &psz_dir, "%s" DIR_SEP "art", psz_cachedir ) == -1 )
+        psz_dir = NULL;
+    free( psz_cachedir );
+    return psz_dir;
+}
+
+static char *ArtCacheGetKey( const char *psz_arturl, const char *psz_artist,
+                             const char *psz_album,  const char *psz_title )
+{
+    char *psz_key;
+
     if( !EMPTY_STR(psz_artist) && !EMPTY_STR(psz_album) )
     {
         char *psz_album_sanitized = strdup( psz_album );
         filename_sanitize( psz_album_sanitized );
         char *psz_artist_sanitized = strdup( psz_artist );
         filename_sanitize( psz_artist_sanitized );
-        if( asprintf( &psz_dir, "%s" DIR_SEP "art" DIR_SEP "artistalbum"
-                      DIR_SEP "%s" DIR_SEP "%s", psz_cachedir,
-                      psz_artist_sanitized, psz_album_sanitized ) == -1 )
-            psz_dir = NULL;
+        if( asprintf( &psz_key, "artistalbum/%s/%s", psz_artist_sanitized,
+                      psz_album_sanitized ) == -1 )
+            psz_key = NULL;
         free( psz_album_sanitized );
         free( psz_artist_sanitized );
     }
@@ -85,7 +138,7 @@ static char* ArtCacheGetDirPath( const char *psz_arturl, const char *psz_artist,
     {
         /* If artist or album are missing, cache by art download URL.
          * If the URL is an attachment://, add the title to the cache name.
-         * It will be md5 hashed to form a valid cache filename.
+         * It will be md5 hashed to form a valid cache key.
          * We assume that psz_arturl is always the download URL and not the
          * already hashed filename.
          * (We should never need to call this function if art has already been
@@ -98,18 +151,16 @@ static char* ArtCacheGetDirPath( const char *psz_arturl, const char *psz_artist,
             AddMD5( &md5, psz_title, strlen( psz_title ) );
         EndMD5( &md5 );
         char * psz_arturl_sanitized = psz_md5_hash( &md5 );
-        if( asprintf( &psz_dir, "%s" DIR_SEP "art" DIR_SEP "arturl" DIR_SEP
-                      "%s", psz_cachedir, psz_arturl_sanitized ) == -1 )
-            psz_dir = NULL;
+        if( asprintf( &psz_key, "arturl/%s", psz_arturl_sanitized ) == -1 )
+            psz_key = NULL;
         free( psz_arturl_sanitized );
     }
-    free( psz_cachedir );
-    return psz_dir;
+    return psz_key;
 }
 
-static char *ArtCachePath( input_item_t *p_item )
+static char *ArtCacheKey( input_item_t *p_item )
 {
-    char* psz_path = NULL;
+    char* psz_key = NULL;
     const char *psz_artist;
     const char *psz_album;
     const char *psz_arturl;
@@ -133,123 +184,715 @@ static char *ArtCachePath( input_item_t *p_item )
     if( (EMPTY_STR(psz_artist) || EMPTY_STR(psz_album) ) && !psz_arturl )
         goto end;
 
-    psz_path = ArtCacheGetDirPath( psz_arturl, psz_artist, psz_album, psz_title );
+    psz_key = ArtCacheGetKey( psz_arturl, psz_artist, psz_album, psz_title );
 
 end:
     vlc_mutex_unlock( &p_item->lock );
-    return psz_path;
+    return psz_key;
+}
+
+/*** In-memory index, the lock must be held ***/
+static void ArtPictureFree( void *p_data, void *p_obj )
+{
+    VLC_UNUSED(p_obj);
+    art_picture_t *p_picture = p_data;
+
+    free( p_picture->psz_thumbs );
+    free( p_picture->psz_name );
+    free( p_picture );
+}
+
+static void ArtKeyFree( void *p_data, void *p_obj )
+{
+    VLC_UNUSED(p_obj);
+    free( p_data );
+}
+
+static void ArtIndexClear( playlist_art_t *art )
+{
+    vlc_dictionary_clear( &art->keys, ArtKeyFree, NULL );
+    vlc_dictionary_clear( &art->pictures, ArtPictureFree, NULL );
+    art->i_size = 0;
+    art->i_uses = 0;
+    free( art->psz_dir );
+    art->psz_dir = NULL;
 }
 
-static char *ArtCacheName( input_item_t *p_item, const char *psz_type )
+static art_picture_t *ArtIndexAddPicture( playlist_art_t *art,
+                                          const char *psz_name,
+                                          const char *psz_thumbs,
+                                          uint64_t i_size, uint64_t i_used )
 {
-    char *psz_path = ArtCachePath( p_item );
-    if( !psz_path )
+    art_picture_t *p_picture = malloc( sizeof(*p_picture) );
+    if( !p_picture )
         return NULL;
+    p_picture->psz_name = strdup( psz_name );
+    p_picture->psz_thumbs = psz_thumbs ? strdup( psz_thumbs ) : NULL;
+    if( !p_picture->psz_name || ( psz_thumbs && !p_picture->psz_thumbs ) )
+    {
+        free( p_picture->psz_thumbs );
+        free( p_picture->psz_name );
+        free( p_picture );
+        return NULL;
+    }
+    p_picture->i_size = i_size;
+    p_picture->i_used = i_used;
+    if( art->i_uses < i_used )
+        art->i_uses = i_used;
+    p_picture->i_refs = 0;
+    p_picture->b_evicted = false;
+    vlc_dictionary_insert( &art->pictures, psz_name, p_picture );
+    art->i_size += i_size;
+    return p_picture;
+}
 
-    ArtCacheCreateDir( psz_path );
+/* Sets the picture of a key, NULL if the art is missing */
+static void ArtIndexSetKey( playlist_art_t *art, const char *psz_key,
+                            art_picture_t *p_picture, time_t i_date )
+{
+    art_key_t *p_key = vlc_dictionary_value_for_key( &art->keys, psz_key );
+    if( !p_key )
+    {
+        p_key = malloc( sizeof(*p_key) );
+        if( !p_key )
+            return;
+        p_key->p_picture = NULL;
+        vlc_dictionary_insert( &art->keys, psz_key, p_key );
+    }
+    if( p_key->p_picture )
+        p_key->p_picture->i_refs--; /* evicted if unused */
+    if( p_picture )
+        p_picture->i_refs++;
+    p_key->p_picture = p_picture;
+    p_key->i_date = i_date;
+    art->b_dirty = true;
+}
 
-    char *psz_ext = strdup( psz_type ? psz_type : "" );
-    filename_sanitize( psz_ext );
-    char *psz_filename;
-    if( asprintf( &psz_filename, "%s" DIR_SEP "art%s", psz_path, psz_ext ) < 0 )
-        psz_filename = NULL;
+static bool ArtCacheExists( const playlist_art_t *art, const char *psz_name )
+{
+    char *psz_path;
+    struct stat st;
 
-    free( psz_ext );
+    if( asprintf( &psz_path, "%s" DIR_SEP "data" DIR_SEP "%s",
+                  art->psz_dir, psz_name ) == -1 )
+        return false;
+    bool b_exists = !vlc_stat( psz_path, &st );
     free( psz_path );
+    return b_exists;
+}
 
-    return psz_filename;
+/**
+ * Reads the index file into the memory. When merging, the entries already
+ * in memory are kept, and the pictures evicted meanwhile are skipped.
+ */
+static void ArtIndexRead( playlist_art_t *art, bool b_merge )
+{
+    char *psz_index;
+    if( asprintf( &psz_index, "%s" DIR_SEP "index", art->psz_dir ) == -1 )
+        return;
+    FILE *f = vlc_fopen( psz_index, "rt" );
+    free( psz_index );
+    if( !f )
+        return;
+
+    char *psz_line = NULL;
+    size_t i_line = 0;
+    ssize_t i_read;
+    bool b_valid = false;
+    while( (i_read = getline( &psz_line, &i_line, f )) > 0 )
+    {
+        if( psz_line[i_read - 1] == '\n' )
+            psz_line[--i_read] = '\0';
+
+        if( !b_valid )
+        {
+            if( strcmp( psz_line, ART_INDEX_MAGIC ) )
+                break;
+            b_valid = true;
+            continue;
+        }
+
+        /* P <use count> <size> <name> [<thumbnail sizes>]
+         * K <date> <picture name or -> <key> */
+        unsigned long long i_date, i_size;
+        int i_name, i_end;
+        if( sscanf( psz_line, "P %llu %llu %n%*s%n",
+                    &i_date, &i_size, &i_name, &i_end ) == 2 &&
+            ( psz_line[i_end] == '\0' || psz_line[i_end] == ' ' ) )
+        {
+            const char *psz_thumbs = NULL;
+            if( psz_line[i_end] == ' ' )
+            {
+                psz_line[i_end] = '\0';
+                psz_thumbs = psz_line + i_end + 1;
+            }
+
+            art_picture_t *p_picture =
+                vlc_dictionary_value_for_key( &art->pictures,
+                                              psz_line + i_name );
+            if( p_picture )
+            {   /* possibly used by another instance since */
+                if( p_picture->i_used < i_date )
+                    p_picture->i_used = i_date;
+                if( art->i_uses < i_date )
+                    art->i_uses = i_date;
+            }
+            else if( !b_merge || ArtCacheExists( art, psz_line + i_name ) )
+                ArtIndexAddPicture( art, psz_line + i_name, psz_thumbs,
+                                    i_size, i_date );
+        }
+        else if( sscanf( psz_line, "K %llu %n%*s%n ",
+                         &i_date, &i_name, &i_end ) == 1 &&
+                 psz_line[i_end] == ' ' )
+        {
+            art_picture_t *p_picture = NULL;
+
+            psz_line[i_end] = '\0';
+            if( b_merge && vlc_dictionary_value_for_key( &art->keys,
+                                                psz_line + i_end + 1 ) )
+                continue;
+            if( strcmp( psz_line + i_name, "-" ) )
+            {
+                p_picture = vlc_dictionary_value_for_key( &art->pictures,
+                                                          psz_line + i_name );
+                if( !p_picture )
+                    continue;
+            }
+            ArtIndexSetKey( art, psz_line + i_end + 1, p_picture, i_date );
+        }
+    }
+    free( psz_line );
+    fclose( f );
 }
 
-/* */
-int playlist_FindArtInCache( input_item_t *p_item )
+static void ArtIndexLoad( playlist_art_t *art, const char *psz_dir )
 {
-    char *psz_path = ArtCachePath( p_item );
+    if( art->psz_dir && !strcmp( art->psz_dir, psz_dir ) )
+        return;
+
+    ArtIndexClear( art );
+    art->psz_dir = strdup( psz_dir );
+    art->i_flushed = time( NULL );
+    if( art->psz_dir )
+        ArtIndexRead( art, false );
+    art->b_dirty = false;
+}
 
-    if( !psz_path )
-        return VLC_EGENERIC;
+static void ArtIndexSave( playlist_art_t *art )
+{
+    char *psz_index, *psz_tmp;
 
-    /* Check if file exists */
-    DIR *p_dir = vlc_opendir( psz_path );
-    if( !p_dir )
+    if( !art->psz_dir )
+        return;
+    if( asprintf( &psz_index, "%s" DIR_SEP "index", art->psz_dir ) == -1 )
+        return;
+    if( asprintf( &psz_tmp, "%s.tmp", psz_index ) == -1 )
     {
+        free( psz_index );
+        return;
+    }
+
+    /* Keep what other instances added since the index was loaded */
+    ArtIndexRead( art, true );
+
+    ArtCacheCreateDir( art->psz_dir );
+    FILE *f = vlc_fopen( psz_tmp, "wt" );
+    if( f )
+    {
+        bool b_error = fprintf( f, "%s\n", ART_INDEX_MAGIC ) < 0;
+
+        for( int i = 0; i < art->pictures.i_size; i++ )
+            for( vlc_dictionary_entry_t *p_entry = art->pictures.p_entries[i];
+                 p_entry; p_entry = p_entry->p_next )
+            {
+                const art_picture_t *p_picture = p_entry->p_value;
+
+                b_error |= fprintf( f, "P %llu %llu %s%s%s\n",
+                                    (unsigned long long)p_picture->i_used,
+                                    (unsigned long long)p_picture->i_size,
+                                    p_picture->psz_name,
+                                    p_picture->psz_thumbs ? " " : "",
+                                    p_picture->psz_thumbs ?
+                                        p_picture->psz_thumbs : "" ) < 0;
+            }
+        for( int i = 0; i < art->keys.i_size; i++ )
+            for( vlc_dictionary_entry_t *p_entry = art->keys.p_entries[i];
+                 p_entry; p_entry = p_entry->p_next )
+            {
+                const art_key_t *p_key = p_entry->p_value;
+
+                b_error |= fprintf( f, "K %llu %s %s\n",
+                                    (unsigned long long)p_key->i_date,
+                                    p_key->p_picture ?
+                                        p_key->p_picture->psz_name : "-",
+                                    p_entry->psz_key ) < 0;
+            }
+        b_error |= fclose( f ) != 0;
+        if( b_error || vlc_rename( psz_tmp, psz_index ) )
+            vlc_unlink( psz_tmp );
+    }
+    free( psz_tmp );
+    free( psz_index );
+
+    art->i_flushed = time( NULL );
+    art->b_dirty = false;
+}
+
+static int ArtCacheComparePictures( const void *a, const void *b )
+{
+    const art_picture_t *p_a = *(const art_picture_t **)a;
+    const art_picture_t *p_b = *(const art_picture_t **)b;
+
+    /* Unused first, then least recently used */
+    if( (p_a->i_refs == 0) != (p_b->i_refs == 0) )
+        return p_a->i_refs == 0 ? -1 : 1;
+    return (p_a->i_used > p_b->i_used) - (p_a->i_used < p_b->i_used);
+}
+
+/* Removes a picture and its thumbnails from the data directory */
+static void ArtCacheRemove( const playlist_art_t *art,
+                            const art_picture_t *p_picture )
+{
+    const char *psz_name = p_picture->psz_name;
+    char *psz_path;
+
+    if( asprintf( &psz_path, "%s" DIR_SEP "data" DIR_SEP "%s",
+                  art->psz_dir, psz_name ) != -1 )
+    {
+        vlc_unlink( psz_path );
         free( psz_path );
-        return VLC_EGENERIC;
     }
 
-    bool b_found = false;
-    char *psz_filename;
-    while( !b_found && (psz_filename = vlc_readdir( p_dir )) )
+    const char *psz_ext = strchr( psz_name, '.' );
+    int i_hash = psz_ext ? psz_ext - psz_name : (int)strlen( psz_name );
+
+    for( const char *psz = p_picture->psz_thumbs; psz && *psz; )
     {
-        if( !strncmp( psz_filename, "art", 3 ) )
+        char *psz_end;
+        unsigned long i_size = strtoul( psz, &psz_end, 10 );
+        if( psz_end == psz )
+            break;
+        if( asprintf( &psz_path, "%s" DIR_SEP "data" DIR_SEP "%.*s-%lu.png",
+                      art->psz_dir, i_hash, psz_name, i_size ) != -1 )
         {
-            char *psz_file;
-            if( asprintf( &psz_file, "%s" DIR_SEP "%s",
-                          psz_path, psz_filename ) != -1 )
+            vlc_unlink( psz_path );
+            free( psz_path );
+        }
+        psz = psz_end + (*psz_end == ',');
+    }
+}
+
+/* Evicts pictures until the cache fits, but the given one */
+static void ArtCacheEvict( playlist_t *p_playlist, playlist_art_t *art,
+                           uint64_t i_max, const art_picture_t *p_keep )
+{
+    if( i_max == 0 || art->i_size <= i_max )
+        return;
+
+    int i_count = vlc_dictionary_keys_count( &art->pictures );
+    art_picture_t **pp_pictures = malloc( i_count * sizeof(*pp_pictures) );
+    if( !pp_pictures )
+        return;
+
+    i_count = 0;
+    for( int i = 0; i < art->pictures.i_size; i++ )
+        for( vlc_dictionary_entry_t *p_entry = art->pictures.p_entries[i];
+             p_entry; p_entry = p_entry->p_next )
+            pp_pictures[i_count++] = p_entry->p_value;
+    qsort( pp_pictures, i_count, sizeof(*pp_pictures),
+           ArtCacheComparePictures );
+
+    int i_evicted = 0;
+    for( int i = 0; i < i_count && art->i_size > i_max; i++ )
+    {
+        art_picture_t *p_picture = pp_pictures[i];
+        if( p_picture == p_keep )
+            continue;
+
+        ArtCacheRemove( art, p_picture );
+        art->i_size -= p_picture->i_size;
+        p_picture->b_evicted = true;
+        i_evicted++;
+    }
+
+    /* Forget the keys of the evicted pictures */
+    char **ppsz_keys = vlc_dictionary_all_keys( &art->keys );
+    for( int i = 0; ppsz_keys && ppsz_keys[i]; i++ )
+    {
+        art_key_t *p_key = vlc_dictionary_value_for_key( &art->keys,
+                                                         ppsz_keys[i] );
+        if( p_key->p_picture && p_key->p_picture->b_evicted )
+            vlc_dictionary_remove_value_for_key( &art->keys, ppsz_keys[i],
+                                                 ArtKeyFree, NULL );
+        free( ppsz_keys[i] );
+    }
+    free( ppsz_keys );
+
+    for( int i = 0; i < i_count; i++ )
+        if( pp_pictures[i]->b_evicted )
+            vlc_dictionary_remove_value_for_key( &art->pictures,
+                            pp_pictures[i]->psz_name, ArtPictureFree, NULL );
+    free( pp_pictures );
+    msg_Dbg( p_playlist, "%d album art pictures evicted from the cache",
+             i_evicted );
+    art->b_dirty = true;
+}
+
+/* Writes a file of the data directory, atomically */
+static int ArtCacheWrite( const char *psz_path, const void *p_buffer,
+                          size_t i_buffer )
+{
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.tmp", psz_path ) == -1 )
+        return VLC_ENOMEM;
+
+    int i_ret = VLC_EGENERIC;
+    FILE *f = vlc_fopen( psz_tmp, "wb" );
+    if( f )
+    {
+        bool b_error = fwrite( p_buffer, i_buffer, 1, f ) != 1;
+        b_error |= fclose( f ) != 0;
+        if( !b_error && !vlc_rename( psz_tmp, psz_path ) )
+            i_ret = VLC_SUCCESS;
+        else
+            vlc_unlink( psz_tmp );
+    }
+    free( psz_tmp );
+    return i_ret;
+}
+
+/**
+ * Generates the thumbnails of a picture, in the configured sizes.
+ * Returns their total size, and their sizes in *ppsz_thumbs, comma
+ * separated, or NULL if there is none.
+ */
+static uint64_t ArtCacheThumbnails( playlist_t *p_playlist,
+                                    const char *psz_data, const char *psz_hash,
+                                    const uint8_t *p_buffer, int i_buffer,
+                                    const char *psz_type, char **ppsz_thumbs )
+{
+    *ppsz_thumbs = NULL;
+
+    char *psz_sizes = var_InheritString( p_playlist, "album-art-thumbnails" );
+    if( EMPTY_STR(psz_sizes) || !psz_type )
+    {
+        free( psz_sizes );
+        return 0;
+    }
+
+    video_format_t fmt_in, fmt_out;
+    memset( &fmt_in, 0, sizeof(fmt_in) );
+    memset( &fmt_out, 0, sizeof(fmt_out) );
+    fmt_in.i_chroma = image_Ext2Fourcc( psz_type );
+
+    picture_t *p_pic = NULL;
+    block_t *p_block = block_Alloc( i_buffer );
+    image_handler_t *p_image = image_HandlerCreate( p_playlist );
+    if( p_block && p_image && fmt_in.i_chroma )
+    {
+        memcpy( p_block->p_buffer, p_buffer, i_buffer );
+        p_pic = image_Read( p_image, p_block, &fmt_in, &fmt_out );
+    }
+    else if( p_block )
+        block_Release( p_block );
+    image_HandlerDelete( p_image );
+    if( !p_pic )
+    {
+        msg_Dbg( p_playlist, "cannot decode album art for thumbnails" );
+        free( psz_sizes );
+        return 0;
+    }
+
+    /* Each size is printed back in at most as many characters */
+    const size_t i_thumbs = strlen( psz_sizes ) + 1;
+    char *psz_thumbs = malloc( i_thumbs );
+    size_t i_len = 0;
+
+    uint64_t i_total = 0;
+    char *psz_state;
+    for( char *psz = strtok_r( psz_sizes, ",", &psz_state ); psz;
+         psz = strtok_r( NULL, ",", &psz_state ) )
+    {
+        int i_size = atoi( psz );
+        if( i_size <= 0 )
+            continue;
+
+        /* Fit in a square, never scale up */
+        int i_width = -1, i_height = -1;
+        if( p_pic->format.i_width >= p_pic->format.i_height )
+        {
+            if( p_pic->format.i_width > (unsigned)i_size )
             {
-                char *psz_uri = make_URI( psz_file, "file" );
-                if( psz_uri )
-                {
-                    input_item_SetArtURL( p_item, psz_uri );
-                    free( psz_uri );
-                }
-                free( psz_file );
+                i_width = i_size;
+                i_height = 0;
             }
+        }
+        else if( p_pic->format.i_height > (unsigned)i_size )
+        {
+            i_width = 0;
+            i_height = i_size;
+        }
+
+        block_t *p_thumb;
+        if( picture_Export( VLC_OBJECT(p_playlist), &p_thumb, NULL, p_pic,
+                            VLC_CODEC_PNG, i_width, i_height ) )
+            continue;
 
-            b_found = true;
+        char *psz_path;
+        if( asprintf( &psz_path, "%s" DIR_SEP "%s-%d.png",
+                      psz_data, psz_hash, i_size ) != -1 )
+        {
+            if( !ArtCacheWrite( psz_path, p_thumb->p_buffer,
+                                p_thumb->i_buffer ) )
+            {
+                i_total += p_thumb->i_buffer;
+                if( psz_thumbs )
+                    i_len += snprintf( psz_thumbs + i_len, i_thumbs - i_len,
+                                       i_len ? ",%d" : "%d", i_size );
+            }
+            free( psz_path );
         }
-        free( psz_filename );
+        block_Release( p_thumb );
     }
+    picture_Release( p_pic );
+    free( psz_sizes );
+    if( psz_thumbs && i_len > 0 )
+        *ppsz_thumbs = psz_thumbs;
+    else
+        free( psz_thumbs );
+    return i_total;
+}
 
-    /* */
-    closedir( p_dir );
-    free( psz_path );
-    return b_found ? VLC_SUCCESS : VLC_EGENERIC;
+/* */
+playlist_art_t *playlist_art_New( void )
+{
+    playlist_art_t *art = calloc( 1, sizeof(*art) );
+    if( unlikely(art == NULL) )
+        return NULL;
+
+    vlc_mutex_init( &art->lock );
+    vlc_dictionary_init( &art->keys, 0 );
+    vlc_dictionary_init( &art->pictures, 0 );
+    return art;
 }
 
+void playlist_art_Delete( playlist_art_t *art )
+{
+    /* The last uses are not lost */
+    if( art->b_dirty )
+        ArtIndexSave( art );
+    ArtIndexClear( art );
+    vlc_mutex_destroy( &art->lock );
+    free( art );
+}
 
 /* */
-int playlist_SaveArt( playlist_t *p_playlist, input_item_t *p_item,
-                      const uint8_t *p_buffer, int i_buffer, const char *psz_type )
+int playlist_FindArtInCache( playlist_t *p_playlist, input_item_t *p_item )
 {
-    char *psz_filename = ArtCacheName( p_item, psz_type );
+    playlist_art_t *art = pl_priv(p_playlist)->p_art;
+    if( !art )
+        return VLC_EGENERIC;
 
-    if( !psz_filename )
+    char *psz_key = ArtCacheKey( p_item );
+    if( !psz_key )
         return VLC_EGENERIC;
 
-    char *psz_uri = make_URI( psz_filename, "file" );
-    if( !psz_uri )
+    char *psz_dir = ArtCacheDir();
+    if( !psz_dir )
     {
-        free( psz_filename );
+        free( psz_key );
         return VLC_EGENERIC;
     }
 
-    /* Check if we already dumped it */
-    struct stat s;
-    if( !vlc_stat( psz_filename, &s ) )
+    char *psz_file = NULL;
+    vlc_mutex_lock( &art->lock );
+    ArtIndexLoad( art, psz_dir );
+
+    art_key_t *p_key = vlc_dictionary_value_for_key( &art->keys, psz_key );
+    if( p_key && p_key->p_picture )
+    {
+        art_picture_t *p_picture = p_key->p_picture;
+        if( asprintf( &psz_file, "%s" DIR_SEP "data" DIR_SEP "%s",
+                      psz_dir, p_picture->psz_name ) == -1 )
+            psz_file = NULL;
+        p_picture->i_used = ++art->i_uses;
+        art->b_dirty = true;
+        if( time( NULL ) - art->i_flushed >= ART_FLUSH_DELAY )
+            ArtIndexSave( art );
+    }
+    vlc_mutex_unlock( &art->lock );
+    free( psz_dir );
+    free( psz_key );
+
+    if( !psz_file )
+        return VLC_EGENERIC;
+
+    char *psz_uri = make_URI( psz_file, "file" );
+    if( psz_uri )
     {
         input_item_SetArtURL( p_item, psz_uri );
-        free( psz_filename );
         free( psz_uri );
-        return VLC_SUCCESS;
     }
+    free( psz_file );
+    return VLC_SUCCESS;
+}
 
-    /* Dump it otherwise */
-    FILE *f = vlc_fopen( psz_filename, "wb" );
-    if( f )
+/* */
+bool playlist_IsArtMissing( playlist_t *p_playlist, input_item_t *p_item )
+{
+    playlist_art_t *art = pl_priv(p_playlist)->p_art;
+    if( !art )
+        return false;
+
+    char *psz_key = ArtCacheKey( p_item );
+    char *psz_dir = ArtCacheDir();
+    bool b_missing = false;
+
+    if( psz_key && psz_dir )
+    {
+        vlc_mutex_lock( &art->lock );
+        ArtIndexLoad( art, psz_dir );
+
+        art_key_t *p_key = vlc_dictionary_value_for_key( &art->keys, psz_key );
+        b_missing = p_key && !p_key->p_picture &&
+                    p_key->i_date + ART_MISSING_TTL > time( NULL );
+        vlc_mutex_unlock( &art->lock );
+    }
+    free( psz_dir );
+    free( psz_key );
+    return b_missing;
+}
+
+/* */
+void playlist_SetArtMissing( playlist_t *p_playlist, input_item_t *p_item )
+{
+    playlist_art_t *art = pl_priv(p_playlist)->p_art;
+    if( !art )
+        return;
+
+    char *psz_key = ArtCacheKey( p_item );
+    char *psz_dir = ArtCacheDir();
+
+    if( psz_key && psz_dir )
     {
-        if( fwrite( p_buffer, i_buffer, 1, f ) != 1 )
+        vlc_mutex_lock( &art->lock );
+        ArtIndexLoad( art, psz_dir );
+
+        art_key_t *p_key = vlc_dictionary_value_for_key( &art->keys, psz_key );
+        if( !p_key || !p_key->p_picture )
+        {
+            msg_Dbg( p_playlist, "album art recorded as missing for %s",
+                     psz_key );
+            ArtIndexSetKey( art, psz_key, NULL, time( NULL ) );
+            ArtIndexSave( art );
+        }
+        vlc_mutex_unlock( &art->lock );
+    }
+    free( psz_dir );
+    free( psz_key );
+}
+
+/* */
+int playlist_SaveArt( playlist_t *p_playlist, input_item_t *p_item,
+                      const uint8_t *p_buffer, int i_buffer, const char *psz_type )
+{
+    playlist_art_t *art = pl_priv(p_playlist)->p_art;
+    if( !art )
+        return VLC_EGENERIC;
+
+    char *psz_key = ArtCacheKey( p_item );
+    if( !psz_key )
+        return VLC_EGENERIC;
+
+    char *psz_dir = ArtCacheDir();
+    if( !psz_dir )
+    {
+        free( psz_key );
+        return VLC_EGENERIC;
+    }
+
+    /* The picture is named after its content */
+    struct md5_s md5;
+    InitMD5( &md5 );
+    AddMD5( &md5, p_buffer, i_buffer );
+    EndMD5( &md5 );
+    char *psz_hash = psz_md5_hash( &md5 );
+
+    char *psz_ext = strdup( psz_type ? psz_type : "" );
+    if( psz_ext )
+        filename_sanitize( psz_ext );
+
+    char *psz_data, *psz_name, *psz_filename;
+    if( asprintf( &psz_data, "%s" DIR_SEP "data", psz_dir ) == -1 )
+        psz_data = NULL;
+    if( !psz_hash || !psz_ext ||
+        asprintf( &psz_name, "%s%s", psz_hash, psz_ext ) == -1 )
+        psz_name = NULL;
+    if( !psz_data || !psz_name ||
+        asprintf( &psz_filename, "%s" DIR_SEP "%s", psz_data, psz_name ) == -1 )
+        psz_filename = NULL;
+    free( psz_ext );
+
+    int i_ret = VLC_EGENERIC;
+    char *psz_thumbs = NULL;
+    if( !psz_filename )
+        goto out;
+
+    vlc_mutex_lock( &art->lock );
+    ArtIndexLoad( art, psz_dir );
+    bool b_stored = vlc_dictionary_value_for_key( &art->pictures,
+                                                  psz_name ) != NULL;
+    vlc_mutex_unlock( &art->lock );
+
+    /* Dump it unless the same picture is already there */
+    uint64_t i_size = i_buffer;
+    if( !b_stored )
+    {
+        ArtCacheCreateDir( psz_data );
+        if( ArtCacheWrite( psz_filename, p_buffer, i_buffer ) )
         {
             msg_Err( p_playlist, "%s: %m", psz_filename );
+            goto out;
         }
-        else
+        msg_Dbg( p_playlist, "album art saved to %s", psz_filename );
+        i_size += ArtCacheThumbnails( p_playlist, psz_data, psz_hash,
+                                      p_buffer, i_buffer, psz_type,
+                                      &psz_thumbs );
+    }
+
+    vlc_mutex_lock( &art->lock );
+    ArtIndexLoad( art, psz_dir );
+    art_picture_t *p_picture = vlc_dictionary_value_for_key( &art->pictures,
+                                                             psz_name );
+    if( !p_picture )
+        p_picture = ArtIndexAddPicture( art, psz_name, psz_thumbs, i_size, 0 );
+    if( p_picture )
+    {
+        p_picture->i_used = ++art->i_uses;
+        ArtIndexSetKey( art, psz_key, p_picture, time( NULL ) );
+        ArtCacheEvict( p_playlist, art, (uint64_t)var_InheritInteger(
+                       p_playlist, "album-art-cache-size" ) << 20, p_picture );
+        ArtIndexSave( art );
+        i_ret = VLC_SUCCESS;
+    }
+    vlc_mutex_unlock( &art->lock );
+
+    if( i_ret == VLC_SUCCESS )
+    {
+        char *psz_uri = make_URI( psz_filename, "file" );
+        if( psz_uri )
         {
-            msg_Dbg( p_playlist, "album art saved to %s", psz_filename );
             input_item_SetArtURL( p_item, psz_uri );
+            free( psz_uri );
         }
-        fclose( f );
     }
+out:
+    free( psz_thumbs );
     free( psz_filename );
-    free( psz_uri );
-    return VLC_SUCCESS;
+    free( psz_name );
+    free( psz_data );
+    free( psz_hash );
+    free( psz_dir );
+    free( psz_key );
+    return i_ret;
 }
-
@@ -32,9 +32,23 @@ typedef struct
     char *psz_arturl;
     bool b_found;
 
+    /* Still being searched: the items of the same album wait for it */
+    bool b_pending;
+    int i_waiting;
+    input_item_t **pp_waiting;
+
 } playlist_album_t;
 
-int playlist_FindArtInCache( input_item_t * );
+/* Album art cache index, one per playlist */
+typedef struct playlist_art_t playlist_art_t;
+
+playlist_art_t *playlist_art_New( void );
+void playlist_art_Delete( playlist_art_t * );
+
+int playlist_FindArtInCache( playlist_t *, input_item_t * );
+
+bool playlist_IsArtMissing( playlist_t *, input_item_t * );
+void playlist_SetArtMissing( playlist_t *, input_item_t * );
 
 int playlist_SaveArt( playlist_t *, input_item_t *, const uint8_t *p_buffer, int i_buffer, const char *psz_type );
 
@@ -203,6 +203,11 @@ playlist_t * playlist_Create( vlc_object_t *p_parent )
     pl_priv(p_playlist)->b_auto_preparse =
         var_InheritBool( p_parent, "auto-preparse" );
 
+    /* Album art cache */
+    p->p_art = playlist_art_New();
+    if( unlikely(p->p_art == NULL) )
+        msg_Err( p_playlist, "cannot create album art cache" );
+
     /* Fetcher */
     p->p_fetcher = playlist_fetcher_New( p_playlist );
     if( unlikely(p->p_fetcher == NULL) )
@@ -291,6 +296,8 @@ void playlist_Destroy( playlist_t *p_playlist )
         playlist_preparser_Delete( p_sys->p_preparser );
     if( p_sys->p_fetcher )
         playlist_fetcher_Delete( p_sys->p_fetcher );
+    if( p_sys->p_art )
+        playlist_art_Delete( p_sys->p_art );
 
     /* Already cleared when deactivating (if activated anyway) */
     assert( !p_sys->p_input );
@@ -35,6 +35,7 @@
 #include <vlc_memory.h>
 #include <vlc_demux.h>
 #include <vlc_modules.h>
+#include <vlc_url.h>
 
 #include "art.h"
 #include "fetcher.h"
@@ -43,18 +44,38 @@
 /*****************************************************************************
  * Structures/definitions
  *****************************************************************************/
+#define FETCHER_WORKERS    4 /* items processed in parallel */
+#define FETCHER_SOURCE_MAX 2 /* requests in parallel to a given source */
+#define FETCHER_RETRY      (CLOCK_FREQ/20) /* while the item is preparsed */
+#define FETCHER_PREPARSE   (CLOCK_FREQ/2)
+
+typedef struct
+{
+    input_item_t    *p_item;
+    mtime_t         i_date;     /* not to be processed before */
+    mtime_t         i_deadline; /* to stop waiting for the preparser */
+} fetcher_entry_t;
+
+typedef struct
+{
+    char            *psz_name;
+    int             i_active;
+} fetcher_source_t;
+
 struct playlist_fetcher_t
 {
     playlist_t      *p_playlist;
 
     vlc_mutex_t     lock;
     vlc_cond_t      wait;
-    bool            b_live;
+    int             i_live;
+    bool            b_exit;
     int             i_art_policy;
     int             i_waiting;
-    input_item_t    **pp_waiting;
+    fetcher_entry_t *p_waiting;
 
-    DECL_ARRAY(playlist_album_t) albums;
+    DECL_ARRAY(fetcher_source_t *) sources;
+    DECL_ARRAY(playlist_album_t *) albums;
 };
 
 static void *Thread( void * );
@@ -72,10 +93,12 @@ playlist_fetcher_t *playlist_fetcher_New( playlist_t *p_playlist )
     p_fetcher->p_playlist = p_playlist;
     vlc_mutex_init( &p_fetcher->lock );
     vlc_cond_init( &p_fetcher->wait );
-    p_fetcher->b_live = false;
+    p_fetcher->i_live = 0;
+    p_fetcher->b_exit = false;
     p_fetcher->i_waiting = 0;
-    p_fetcher->pp_waiting = NULL;
+    p_fetcher->p_waiting = NULL;
     p_fetcher->i_art_policy = var_GetInteger( p_playlist, "album-art" );
+    ARRAY_INIT( p_fetcher->sources );
     ARRAY_INIT( p_fetcher->albums );
 
     return p_fetcher;
@@ -84,37 +107,59 @@ playlist_fetcher_t *playlist_fetcher_New( playlist_t *p_playlist )
 void playlist_fetcher_Push( playlist_fetcher_t *p_fetcher,
                             input_item_t *p_item )
 {
+    fetcher_entry_t entry = { .p_item = p_item, .i_date = 0,
+                              .i_deadline = 0 };
+
     vlc_gc_incref( p_item );
 
     vlc_mutex_lock( &p_fetcher->lock );
-    INSERT_ELEM( p_fetcher->pp_waiting, p_fetcher->i_waiting,
-                 p_fetcher->i_waiting, p_item );
-    if( !p_fetcher->b_live )
+    INSERT_ELEM( p_fetcher->p_waiting, p_fetcher->i_waiting,
+                 p_fetcher->i_waiting, entry );
+    if( p_fetcher->i_live < FETCHER_WORKERS &&
+        p_fetcher->i_live < p_fetcher->i_waiting )
     {
         if( vlc_clone_detach( NULL, Thread, p_fetcher,
                               VLC_THREAD_PRIORITY_LOW ) )
             msg_Err( p_fetcher->p_playlist,
                      "cannot spawn secondary preparse thread" );
         else
-            p_fetcher->b_live = true;
+            p_fetcher->i_live++;
     }
+    vlc_cond_broadcast( &p_fetcher->wait );
     vlc_mutex_unlock( &p_fetcher->lock );
 }
 
 void playlist_fetcher_Delete( playlist_fetcher_t *p_fetcher )
 {
     vlc_mutex_lock( &p_fetcher->lock );
+    p_fetcher->b_exit = true;
     /* Remove any left-over item, the fetcher will exit */
     while( p_fetcher->i_waiting > 0 )
     {
-        vlc_gc_decref( p_fetcher->pp_waiting[0] );
-        REMOVE_ELEM( p_fetcher->pp_waiting, p_fetcher->i_waiting, 0 );
+        vlc_gc_decref( p_fetcher->p_waiting[0].p_item );
+        REMOVE_ELEM( p_fetcher->p_waiting, p_fetcher->i_waiting, 0 );
     }
+    vlc_cond_broadcast( &p_fetcher->wait );
 
-    while( p_fetcher->b_live )
+    while( p_fetcher->i_live > 0 )
         vlc_cond_wait( &p_fetcher->wait, &p_fetcher->lock );
     vlc_mutex_unlock( &p_fetcher->lock );
 
+    FOREACH_ARRAY( fetcher_source_t *p_source, p_fetcher->sources )
+        free( p_source->psz_name );
+        free( p_source );
+    FOREACH_END();
+    ARRAY_RESET( p_fetcher->sources );
+
+    FOREACH_ARRAY( playlist_album_t *p_album, p_fetcher->albums )
+        assert( !p_album->b_pending );
+        free( p_album->psz_artist );
+        free( p_album->psz_album );
+        free( p_album->psz_arturl );
+        free( p_album );
+    FOREACH_END();
+    ARRAY_RESET( p_fetcher->albums );
+
     vlc_cond_destroy( &p_fetcher->wait );
     vlc_mutex_destroy( &p_fetcher->lock );
     free( p_fetcher );
@@ -124,17 +169,147 @@ void playlist_fetcher_Delete( playlist_fetcher_t *p_fetcher )
 /*****************************************************************************
  * Privates functions
  *****************************************************************************/
+/**
+ * Waits for a free slot to send a request to the given source (a module
+ * capability or a server), so that a slow source does not take up all the
+ * workers. Returns NULL if the source cannot be accounted.
+ */
+static fetcher_source_t *SourceAcquire( playlist_fetcher_t *p_fetcher,
+                                        const char *psz_name )
+{
+    fetcher_source_t *p_source = NULL;
+
+    vlc_mutex_lock( &p_fetcher->lock );
+    FOREACH_ARRAY( fetcher_source_t *p, p_fetcher->sources )
+        if( !strcmp( p->psz_name, psz_name ) )
+        {
+            p_source = p;
+            break;
+        }
+    FOREACH_END();
+
+    if( !p_source )
+    {
+        p_source = malloc( sizeof(*p_source) );
+        if( p_source )
+            p_source->psz_name = strdup( psz_name );
+        if( !p_source || !p_source->psz_name )
+        {
+            free( p_source );
+            vlc_mutex_unlock( &p_fetcher->lock );
+            return NULL;
+        }
+        p_source->i_active = 0;
+        ARRAY_APPEND( p_fetcher->sources, p_source );
+    }
+
+    while( p_source->i_active >= FETCHER_SOURCE_MAX )
+        vlc_cond_wait( &p_fetcher->wait, &p_fetcher->lock );
+    p_source->i_active++;
+    vlc_mutex_unlock( &p_fetcher->lock );
+    return p_source;
+}
+
+static void SourceRelease( playlist_fetcher_t *p_fetcher,
+                           fetcher_source_t *p_source )
+{
+    if( !p_source )
+        return;
+
+    vlc_mutex_lock( &p_fetcher->lock );
+    p_source->i_active--;
+    vlc_cond_broadcast( &p_fetcher->wait );
+    vlc_mutex_unlock( &p_fetcher->lock );
+}
+
+/**
+ * Applies the result of the search for an album to one of its items.
+ * The album must not be pending anymore.
+ */
+static int AlbumApply( playlist_t *p_playlist, const playlist_album_t *p_album,
+                       input_item_t *p_item )
+{
+    if( !p_album->b_found )
+        return VLC_EGENERIC;
+
+    /* TODO-fenrir if we cache art filename too, we can go faster */
+    if( p_album->psz_arturl && !strncmp( p_album->psz_arturl, "file://", 7 ) )
+        input_item_SetArtURL( p_item, p_album->psz_arturl );
+    else /* Actually get URL from cache */
+        playlist_FindArtInCache( p_playlist, p_item );
+    return 0;
+}
+
+/**
+ * Tells the interested parties that the art fetching of an item is over.
+ */
+static void Notify( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
+                    int i_ret )
+{
+    playlist_t *p_playlist = p_fetcher->p_playlist;
+    char *psz_name = input_item_GetName( p_item );
+
+    if( !i_ret ) /* Art is now in cache */
+    {
+        PL_DEBUG( "found art for %s in cache", psz_name );
+        input_item_SetArtFetched( p_item, true );
+        var_SetAddress( p_playlist, "item-change", p_item );
+    }
+    else
+    {
+        PL_DEBUG( "art not found for %s", psz_name );
+        input_item_SetArtNotFound( p_item, true );
+    }
+    free( psz_name );
+}
+
+/**
+ * Records the result of the search for an album, and completes the items
+ * of the same album which were pushed in the meantime.
+ */
+static void AlbumDone( playlist_fetcher_t *p_fetcher,
+                       playlist_album_t *p_album, input_item_t *p_item,
+                       int i_ret )
+{
+    char *psz_arturl = input_item_GetArtURL( p_item );
+
+    vlc_mutex_lock( &p_fetcher->lock );
+    p_album->psz_arturl = psz_arturl;
+    p_album->b_found = i_ret == 0;
+    p_album->b_pending = false;
+
+    int i_waiting = p_album->i_waiting;
+    input_item_t **pp_waiting = p_album->pp_waiting;
+    p_album->i_waiting = 0;
+    p_album->pp_waiting = NULL;
+    vlc_mutex_unlock( &p_fetcher->lock );
+
+    for( int i = 0; i < i_waiting; i++ )
+    {
+        Notify( p_fetcher, pp_waiting[i],
+                AlbumApply( p_fetcher->p_playlist, p_album, pp_waiting[i] ) );
+        vlc_gc_decref( pp_waiting[i] );
+    }
+    free( pp_waiting );
+}
+
 /**
  * This function locates the art associated to an input item.
  * Return codes:
  *   0 : Art is in cache or is a local file
  *   1 : Art found, need to download
+ *   2 : Album is being searched by another worker, which owns the item now
  *  -X : Error/not found
+ * If the album is searched for by the caller, *pp_album is set and must be
+ * completed with AlbumDone().
  */
-static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
+static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item,
+                    playlist_album_t **pp_album )
 {
     int i_ret;
 
+    *pp_album = NULL;
+
     char *psz_artist = input_item_GetArtist( p_item );
     char *psz_album = input_item_GetAlbum( p_item );
     char *psz_title = input_item_GetTitle( p_item );
@@ -146,38 +321,73 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
 
     free( psz_title );
 
-    /* If we already checked this album in this session, skip */
+    /* If we already checked this album in this session, skip.
+     * If it is being checked, wait for the result. */
     if( psz_artist && psz_album )
     {
-        FOREACH_ARRAY( playlist_album_t album, p_fetcher->albums )
-            if( !strcmp( album.psz_artist, psz_artist ) &&
-                !strcmp( album.psz_album, psz_album ) )
+        playlist_album_t *p_album = NULL;
+
+        vlc_mutex_lock( &p_fetcher->lock );
+        FOREACH_ARRAY( playlist_album_t *p, p_fetcher->albums )
+            if( !strcmp( p->psz_artist, psz_artist ) &&
+                !strcmp( p->psz_album, psz_album ) )
             {
-                msg_Dbg( p_fetcher->p_playlist,
-                         " %s - %s has already been searched",
-                         psz_artist, psz_album );
-                /* TODO-fenrir if we cache art filename too, we can go faster */
-                free( psz_artist );
-                free( psz_album );
-                if( album.b_found )
-                {
-                    if( !strncmp( album.psz_arturl, "file://", 7 ) )
-                        input_item_SetArtURL( p_item, album.psz_arturl );
-                    else /* Actually get URL from cache */
-                        playlist_FindArtInCache( p_item );
-                    return 0;
-                }
-                else
-                {
-                    return VLC_EGENERIC;
-                }
+                p_album = p;
+                break;
             }
         FOREACH_END();
+
+        if( p_album && p_album->b_pending )
+        {
+            vlc_gc_incref( p_item );
+            INSERT_ELEM( p_album->pp_waiting, p_album->i_waiting,
+                         p_album->i_waiting, p_item );
+            vlc_mutex_unlock( &p_fetcher->lock );
+            msg_Dbg( p_fetcher->p_playlist, " %s - %s is being searched",
+                     psz_artist, psz_album );
+            free( psz_artist );
+            free( psz_album );
+            return 2;
+        }
+        if( p_album )
+        {
+            vlc_mutex_unlock( &p_fetcher->lock );
+            msg_Dbg( p_fetcher->p_playlist,
+                     " %s - %s has already been searched",
+                     psz_artist, psz_album );
+            free( psz_artist );
+            free( psz_album );
+            return AlbumApply( p_fetcher->p_playlist, p_album, p_item );
+        }
+
+        /* Record this album */
+        p_album = malloc( sizeof(*p_album) );
+        if( p_album )
+        {
+            p_album->psz_artist = psz_artist;
+            p_album->psz_album = psz_album;
+            p_album->psz_arturl = NULL;
+            p_album->b_found = false;
+            p_album->b_pending = true;
+            p_album->i_waiting = 0;
+            p_album->pp_waiting = NULL;
+            ARRAY_APPEND( p_fetcher->albums, p_album );
+            *pp_album = p_album;
+        }
+        vlc_mutex_unlock( &p_fetcher->lock );
+        if( !p_album )
+        {
+            free( psz_artist );
+            free( psz_album );
+        }
+    }
+    else
+    {
+        free( psz_artist );
+        free( psz_album );
     }
-    free( psz_artist );
-    free( psz_album );
 
-    playlist_FindArtInCache( p_item );
+    playlist_FindArtInCache( p_fetcher->p_playlist, p_item );
 
     char *psz_arturl = input_item_GetArtURL( p_item );
     if( psz_arturl )
@@ -200,11 +410,21 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
     psz_artist = input_item_GetArtist( p_item );
     if( psz_album && psz_artist )
     {
-        msg_Dbg( p_fetcher->p_playlist, "searching art for %s - %s",
-             psz_artist, psz_album );
+        bool b_missing = playlist_IsArtMissing( p_fetcher->p_playlist,
+                                                p_item );
+
+        msg_Dbg( p_fetcher->p_playlist, "%s art for %s - %s",
+                 b_missing ? "no recent" : "searching",
+                 psz_artist, psz_album );
+        free( psz_artist );
+        free( psz_album );
+        if( b_missing )
+            return VLC_EGENERIC;
     }
     else
     {
+        free( psz_artist );
+        free( psz_album );
         psz_title = input_item_GetTitle( p_item );
         if( !psz_title )
             psz_title = input_item_GetName( p_item );
@@ -225,35 +445,23 @@ static int FindArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
 
         p_finder->p_item = p_item;
 
+        fetcher_source_t *p_source = SourceAcquire( p_fetcher, "art finder" );
         p_module = module_need( p_finder, "art finder", NULL, false );
+        SourceRelease( p_fetcher, p_source );
         if( p_module )
         {
             module_unneed( p_finder, p_module );
             /* Try immediately if found in cache by download URL */
-            if( !playlist_FindArtInCache( p_item ) )
+            if( !playlist_FindArtInCache( p_fetcher->p_playlist, p_item ) )
                 i_ret = 0;
             else
                 i_ret = 1;
         }
+        else if( *pp_album != NULL )
+            playlist_SetArtMissing( p_fetcher->p_playlist, p_item );
         vlc_object_release( p_finder );
     }
 
-    /* Record this album */
-    if( psz_artist && psz_album )
-    {
-        playlist_album_t a;
-        a.psz_artist = psz_artist;
-        a.psz_album = psz_album;
-        a.psz_arturl = input_item_GetArtURL( p_item );
-        a.b_found = (i_ret == VLC_EGENERIC ? false : true );
-        ARRAY_APPEND( p_fetcher->albums, a );
-    }
-    else
-    {
-        free( psz_artist );
-        free( psz_album );
-    }
-
     return i_ret;
 }
 
@@ -280,9 +488,19 @@ static int DownloadArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
         goto error;
     }
 
+    /* One source per server */
+    vlc_url_t url;
+    vlc_UrlParse( &url, psz_arturl, 0 );
+    fetcher_source_t *p_source =
+        SourceAcquire( p_fetcher, url.psz_host ? url.psz_host : "" );
+    vlc_UrlClean( &url );
+
     stream_t *p_stream = stream_UrlNew( p_fetcher->p_playlist, psz_arturl );
     if( !p_stream )
+    {
+        SourceRelease( p_fetcher, p_source );
         goto error;
+    }
 
     uint8_t *p_data = NULL;
     int i_data = 0;
@@ -304,6 +522,7 @@ static int DownloadArt( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
         i_data += i_read;
     }
     stream_Delete( p_stream );
+    SourceRelease( p_fetcher, p_source );
 
     if( p_data && i_data > 0 )
     {
@@ -339,124 +558,116 @@ static void FetchMeta( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
     p_demux_meta->p_demux = NULL;
     p_demux_meta->p_item = p_item;
 
+    fetcher_source_t *p_source = SourceAcquire( p_fetcher, "meta fetcher" );
     module_t *p_meta_fetcher = module_need( p_demux_meta, "meta fetcher", NULL, false );
+    SourceRelease( p_fetcher, p_source );
     if( p_meta_fetcher )
         module_unneed( p_demux_meta, p_meta_fetcher );
     vlc_object_release( p_demux_meta );
 }
 
-static int InputEvent( vlc_object_t *p_this, char const *psz_cmd,
-                       vlc_value_t oldval, vlc_value_t newval, void *p_data )
-{
-    VLC_UNUSED(p_this); VLC_UNUSED(psz_cmd); VLC_UNUSED(oldval);
-    vlc_cond_t *p_cond = p_data;
-
-    if( newval.i_int == INPUT_EVENT_ITEM_META ||
-        newval.i_int == INPUT_EVENT_DEAD )
-        vlc_cond_signal( p_cond );
-
-    return VLC_SUCCESS;
-}
-
-
-/* Check if it is not yet preparsed and if so wait for it
- * (at most 0.5s)
+/* Check if the item is being played and not yet preparsed
  * (This can happen if we fetch art on play)
  * FIXME this doesn't work if we need to fetch meta before art...
  */
-static void WaitPreparsed( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
+static bool IsPreparsing( playlist_fetcher_t *p_fetcher, input_item_t *p_item )
 {
     if( input_item_IsPreparsed( p_item ) )
-        return;
+        return false;
 
     input_thread_t *p_input = playlist_CurrentInput( p_fetcher->p_playlist );
     if( !p_input )
-        return;
+        return false;
 
-    if( input_GetItem( p_input ) != p_item )
-        goto exit;
-
-    vlc_cond_t cond;
-    vlc_cond_init( &cond );
-    var_AddCallback( p_input, "intf-event", InputEvent, &cond );
+    bool b_preparsing = input_GetItem( p_input ) == p_item &&
+                        !p_input->b_eof && !p_input->b_error;
+    vlc_object_release( p_input );
+    return b_preparsing;
+}
 
-    const mtime_t i_deadline = mdate() + 500*1000;
-    bool b_timeout = false;
+static void Fetch( playlist_fetcher_t *p_fetcher, fetcher_entry_t *p_entry )
+{
+    input_item_t *p_item = p_entry->p_item;
 
-    while( !p_input->b_eof && !p_input->b_error
-        && !input_item_IsPreparsed( p_item ) && !b_timeout )
+    /* Wait that the input item is preparsed if it is being played
+     * (at most 0.5s), but do not hold up the other items meanwhile */
+    if( p_entry->i_deadline == 0 )
+        p_entry->i_deadline = mdate() + FETCHER_PREPARSE;
+    if( IsPreparsing( p_fetcher, p_item ) && mdate() < p_entry->i_deadline )
     {
-        /* A bit weird, but input_item_IsPreparsed holds the protected value */
-        /* FIXME: locking looks wrong here */
+        p_entry->i_date = mdate() + FETCHER_RETRY;
+
         vlc_mutex_lock( &p_fetcher->lock );
-        if( vlc_cond_timedwait( &cond, &p_fetcher->lock, i_deadline ) )
-            b_timeout = true;
+        bool b_exit = p_fetcher->b_exit;
+        if( !b_exit )
+            INSERT_ELEM( p_fetcher->p_waiting, p_fetcher->i_waiting,
+                         p_fetcher->i_waiting, *p_entry );
         vlc_mutex_unlock( &p_fetcher->lock );
+        if( b_exit )
+            vlc_gc_decref( p_item );
+        return;
     }
 
-    var_DelCallback( p_input, "intf-event", InputEvent, &cond );
-    vlc_cond_destroy( &cond );
+    /* Triggers "meta fetcher", eventually fetch meta on the network.
+     * They are identical to "meta reader" expect that may actually
+     * takes time. That's why they are running here.
+     * The result of this fetch is not cached. */
+    FetchMeta( p_fetcher, p_item );
 
-exit:
-    vlc_object_release( p_input );
+    /* Find art, and download it if needed */
+    playlist_album_t *p_album;
+    int i_ret = FindArt( p_fetcher, p_item, &p_album );
+    if( i_ret == 2 )
+    {
+        /* Completed along with the album */
+        vlc_gc_decref( p_item );
+        return;
+    }
+    if( i_ret == 1 )
+        i_ret = DownloadArt( p_fetcher, p_item );
+    if( p_album )
+        AlbumDone( p_fetcher, p_album, p_item, i_ret );
+
+    Notify( p_fetcher, p_item, i_ret );
+    vlc_gc_decref( p_item );
 }
 
 static void *Thread( void *p_data )
 {
     playlist_fetcher_t *p_fetcher = p_data;
-    playlist_t *p_playlist = p_fetcher->p_playlist;
 
+    vlc_mutex_lock( &p_fetcher->lock );
     for( ;; )
     {
-        input_item_t *p_item = NULL;
+        /* Take the first item which is due */
+        mtime_t i_now = mdate(), i_next = INT64_MAX;
+        int i;
 
-        vlc_mutex_lock( &p_fetcher->lock );
-        if( p_fetcher->i_waiting != 0 )
+        for( i = 0; i < p_fetcher->i_waiting; i++ )
         {
-            p_item = p_fetcher->pp_waiting[0];
-            REMOVE_ELEM( p_fetcher->pp_waiting, p_fetcher->i_waiting, 0 );
+            if( p_fetcher->p_waiting[i].i_date <= i_now )
+                break;
+            i_next = __MIN( i_next, p_fetcher->p_waiting[i].i_date );
         }
-        else
-        {
-            p_fetcher->b_live = false;
-            vlc_cond_signal( &p_fetcher->wait );
-        }
-        vlc_mutex_unlock( &p_fetcher->lock );
-
-        if( !p_item )
-            break;
 
-        /* */
-
-        /* Wait that the input item is preparsed if it is being played */
-        WaitPreparsed( p_fetcher, p_item );
+        if( i < p_fetcher->i_waiting )
+        {
+            fetcher_entry_t entry = p_fetcher->p_waiting[i];
 
-        /* Triggers "meta fetcher", eventually fetch meta on the network.
-         * They are identical to "meta reader" expect that may actually
-         * takes time. That's why they are running here.
-         * The result of this fetch is not cached. */
-        FetchMeta( p_fetcher, p_item );
+            REMOVE_ELEM( p_fetcher->p_waiting, p_fetcher->i_waiting, i );
+            vlc_mutex_unlock( &p_fetcher->lock );
 
-        /* Find art, and download it if needed */
-        int i_ret = FindArt( p_fetcher, p_item );
-        if( i_ret == 1 )
-            i_ret = DownloadArt( p_fetcher, p_item );
+            Fetch( p_fetcher, &entry );
 
-        /* */
-        char *psz_name = input_item_GetName( p_item );
-        if( !i_ret ) /* Art is now in cache */
-        {
-            PL_DEBUG( "found art for %s in cache", psz_name );
-            input_item_SetArtFetched( p_item, true );
-            var_SetAddress( p_playlist, "item-change", p_item );
+            vlc_mutex_lock( &p_fetcher->lock );
         }
+        else if( p_fetcher->i_waiting > 0 )
+            vlc_cond_timedwait( &p_fetcher->wait, &p_fetcher->lock, i_next );
         else
-        {
-            PL_DEBUG( "art not found for %s", psz_name );
-            input_item_SetArtNotFound( p_item, true );
-        }
-        free( psz_name );
-        vlc_gc_decref( p_item );
+            break;
     }
+    p_fetcher->i_live--;
+    vlc_cond_broadcast( &p_fetcher->wait );
+    vlc_mutex_unlock( &p_fetcher->lock );
     return NULL;
 }
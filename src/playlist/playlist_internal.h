@@ -48,6 +48,7 @@ typedef struct playlist_private_t
     playlist_t           public_data;
     playlist_preparser_t *p_preparser;  /**< Preparser data */
     playlist_fetcher_t   *p_fetcher;    /**< Meta and art fetcher data */
+    playlist_art_t       *p_art;        /**< Album art cache index */
 
     playlist_item_array_t items_to_delete; /**< Array of items and nodes to
             delete... At the very end. This sucks. */
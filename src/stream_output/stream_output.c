@@ -42,6 +42,7 @@
 #include <vlc_sout.h>
 
 #include "stream_output.h"
+#include "libvlc.h"
 
 #include <vlc_meta.h>
 #include <vlc_block.h>
@@ -134,6 +135,36 @@ sout_instance_t *sout_NewInstance( vlc_object_t *p_parent, const char *psz_dest
     return NULL;
 }
 
+/*****************************************************************************
+ * sout_IsRemux: tells whether the chain only copies the streams
+ *****************************************************************************
+ * Such a chain neither decodes, nor waits for the dates of the blocks, so
+ * the input can send them itself. The nested chains (of duplicate for
+ * instance) are only known by their description: any mention of a stream
+ * output that decodes or waits is enough to rule it out.
+ *****************************************************************************/
+bool sout_IsRemux( sout_instance_t *p_sout )
+{
+    static const char ppsz_slow[][14] = {
+        "transcode", "display", "smem", "mosaic-bridge", "switcher",
+        "bridge-in",
+    };
+
+    if( var_InheritBool( p_sout, "sout-display" ) )
+        return false;
+
+    for( size_t i = 0; i < sizeof( ppsz_slow ) / sizeof( ppsz_slow[0] ); i++ )
+    {
+        if( strstr( p_sout->psz_sout, ppsz_slow[i] ) != NULL )
+            return false;
+        for( sout_stream_t *p_stream = p_sout->p_stream; p_stream != NULL;
+             p_stream = p_stream->p_next )
+            if( !strcmp( p_stream->psz_name, ppsz_slow[i] ) )
+                return false;
+    }
+    return true;
+}
+
 /*****************************************************************************
  * sout_DeleteInstance: delete a previously allocated instance
  *****************************************************************************/
@@ -325,7 +356,14 @@ ssize_t sout_AccessOutRead( sout_access_out_t *p_access, block_t *p_buffer )
  *****************************************************************************/
 ssize_t sout_AccessOutWrite( sout_access_out_t *p_access, block_t *p_buffer )
 {
-    return p_access->pf_write( p_access, p_buffer );
+    if( !vlc_trace_Enabled( p_access ) )
+        return p_access->pf_write( p_access, p_buffer );
+
+    mtime_t i_start = mdate();
+    ssize_t i_ret = p_access->pf_write( p_access, p_buffer );
+
+    vlc_trace_Span( p_access, VLC_TRACE_SOUT_WRITE, i_start, mdate() );
+    return i_ret;
 }
 
 /**
@@ -549,7 +587,16 @@ void sout_MuxSendBuffer( sout_mux_t *p_mux, sout_input_t *p_input,
             return;
         p_mux->b_waiting_stream = false;
     }
-    p_mux->pf_mux( p_mux );
+
+    if( vlc_trace_Enabled( p_mux ) )
+    {
+        mtime_t i_start = mdate();
+
+        p_mux->pf_mux( p_mux );
+        vlc_trace_Span( p_mux, VLC_TRACE_SOUT_MUX, i_start, mdate() );
+    }
+    else
+        p_mux->pf_mux( p_mux );
 }
 
 
@@ -45,6 +45,7 @@
 #include <vlc_filter.h>
 #include <vlc_vout_osd.h>
 #include <vlc_image.h>
+#include <vlc_atomic.h>
 
 #include <libvlc.h>
 #include "vout_internal.h"
@@ -71,6 +72,15 @@ static void VoutDestructor(vlc_object_t *);
 /* Better be in advance when awakening than late... */
 #define VOUT_MWAIT_TOLERANCE (INT64_C(4000))
 
+/* The decoder pool grows once the decoder has waited that long for a
+ * picture, up to twice its initial size. A display pool used directly by
+ * the decoder belongs to the display, and does not grow. */
+#define VOUT_POOL_GROW_DELAY (INT64_C(40000))
+
+/* Pictures added to the decoder pool and left unused for that long are
+ * given back */
+#define VOUT_POOL_SHRINK_WINDOW (INT64_C(10000000))
+
 /* */
 static int VoutValidateFormat(video_format_t *dst,
                               const video_format_t *src)
@@ -333,6 +343,25 @@ void vout_FixLeaks( vout_thread_t *vout )
         return;
     }
 
+    /* The pictures may all be held by the decoder and the display: let the
+     * pool grow, if it can, once the starvation lasts */
+    vout_thread_sys_t *sys = vout->p;
+    if (sys->pool.grown < sys->pool.grown_max) {
+        if (sys->pool.wait_start > VLC_TS_INVALID &&
+            mdate() - sys->pool.wait_start < VOUT_POOL_GROW_DELAY) {
+            vlc_mutex_unlock(&vout->p->picture_lock);
+            return;
+        }
+        if (picture_pool_Grow(sys->decoder_pool, 1) > 0) {
+            sys->pool.grown++;
+            stats_MetricAdd(sys->pool.m_pictures, 1);
+            msg_Dbg(vout, "decoder pool starved, grown to %d pictures",
+                    picture_pool_GetSize(sys->decoder_pool));
+            vlc_mutex_unlock(&vout->p->picture_lock);
+            return;
+        }
+    }
+
     /* There is no reason that no pictures are available, force one
      * from the pool, becarefull with it though */
     msg_Err(vout, "pictures leaked, trying to workaround");
@@ -383,6 +412,60 @@ void vout_FlushSubpictureChannel( vout_thread_t *vout, int channel )
                              channel);
 }
 
+/* Accounts for a decoder pool request, with picture_lock held */
+static void PoolAccount(vout_thread_t *vout, bool hit)
+{
+    vout_thread_sys_t *sys = vout->p;
+    const mtime_t now = mdate();
+
+    sys->pool.requests++;
+    stats_MetricAdd(sys->pool.m_requests, 1);
+    if (!hit) {
+        sys->pool.misses++;
+        stats_MetricAdd(sys->pool.m_misses, 1);
+        if (sys->pool.wait_start <= VLC_TS_INVALID)
+            sys->pool.wait_start = now;
+        return;
+    }
+
+    if (sys->pool.wait_start > VLC_TS_INVALID) {
+        const mtime_t waited = now - sys->pool.wait_start;
+
+        sys->pool.waited += waited;
+        stats_MetricRecord(sys->pool.m_wait, waited);
+        sys->pool.wait_start = VLC_TS_INVALID;
+    }
+
+    const int used = picture_pool_GetUsed(sys->decoder_pool);
+    if (used > sys->pool.high_water) {
+        stats_MetricAdd(sys->pool.m_high_water, used - sys->pool.high_water);
+        sys->pool.high_water = used;
+        if (used > sys->pool.peak)
+            sys->pool.peak = used;
+    }
+
+    if (now - sys->pool.window_start < VOUT_POOL_SHRINK_WINDOW)
+        return;
+
+    /* Give back the added pictures that the window did not need */
+    const int usable = picture_pool_GetSize(sys->decoder_pool) -
+                       picture_pool_GetSize(sys->private_pool);
+    const int unused = __MIN(sys->pool.grown,
+                             usable - sys->pool.high_water - 1);
+    if (unused > 0) {
+        const int removed = picture_pool_Shrink(sys->decoder_pool, unused);
+
+        sys->pool.grown -= removed;
+        stats_MetricAdd(sys->pool.m_pictures, -removed);
+        if (removed > 0)
+            msg_Dbg(vout, "decoder pool shrunk to %d pictures",
+                    picture_pool_GetSize(sys->decoder_pool));
+    }
+    stats_MetricAdd(sys->pool.m_high_water, used - sys->pool.high_water);
+    sys->pool.high_water = used;
+    sys->pool.window_start = now;
+}
+
 /**
  * It retreives a picture from the vout or NULL if no pictures are
  * available yet.
@@ -401,6 +484,7 @@ picture_t *vout_GetPicture(vout_thread_t *vout)
         picture_Reset(picture);
         VideoFormatCopyCropAr(&picture->format, &vout->p->original);
     }
+    PoolAccount(vout, picture != NULL);
     vlc_mutex_unlock(&vout->p->picture_lock);
 
     return picture;
@@ -881,6 +965,11 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
 
     picture_t *torender = picture_Hold(vout->p->displayed.current);
 
+    /* Only the decoded pictures are dated, when tracing */
+    const mtime_t trace_date = torender->trace_date;
+    const mtime_t render_start = trace_date > VLC_TS_INVALID ? mdate()
+                                                             : VLC_TS_INVALID;
+
     vout_chrono_Start(&vout->p->render);
 
     vlc_mutex_lock(&vout->p->filter.lock);
@@ -1030,6 +1119,8 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
     }
 
     vout_chrono_Stop(&vout->p->render);
+    if (render_start != VLC_TS_INVALID)
+        vlc_trace_Span(vout, VLC_TRACE_VIDEO_RENDER, render_start, mdate());
 #if 0
         {
         static int i = 0;
@@ -1056,6 +1147,15 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
                          subpic);
     sys->display.filtered = NULL;
 
+    if (trace_date > VLC_TS_INVALID) {
+        const mtime_t display_end = mdate();
+
+        vlc_trace_Span(vout, VLC_TRACE_VIDEO_DISPLAY, vout->p->displayed.date,
+                       display_end);
+        vlc_trace_Span(vout, VLC_TRACE_VIDEO_LATENCY, trace_date,
+                       display_end);
+    }
+
     vout_statistic_Update(&vout->p->statistic, 1, 0);
 
     return VLC_SUCCESS;
@@ -1327,6 +1427,59 @@ static void ThreadExecuteCropRatio(vout_thread_t *vout,
                         0, 0, 0, 0);
 }
 
+static void PoolStart(vout_thread_t *vout)
+{
+    static vlc_atomic_t count = VLC_ATOMIC_INIT(0);
+    vout_thread_sys_t *sys = vout->p;
+    char id[12];
+
+    snprintf(id, sizeof(id), "%u", (unsigned)vlc_atomic_inc(&count));
+    sys->pool.initial      = picture_pool_GetSize(sys->decoder_pool);
+    sys->pool.grown        = 0;
+    sys->pool.grown_max    = sys->decoder_pool != sys->display_pool
+                             ? sys->pool.initial : 0;
+    sys->pool.wait_start   = VLC_TS_INVALID;
+    sys->pool.high_water   = 0;
+    sys->pool.peak         = 0;
+    sys->pool.window_start = mdate();
+    sys->pool.requests     = 0;
+    sys->pool.misses       = 0;
+    sys->pool.waited       = 0;
+    sys->pool.m_requests   = stats_MetricNew(vout, STATS_METRIC_COUNTER,
+                                             "vout_pool_requests",
+                                             "vout", id, NULL);
+    sys->pool.m_misses     = stats_MetricNew(vout, STATS_METRIC_COUNTER,
+                                             "vout_pool_misses",
+                                             "vout", id, NULL);
+    sys->pool.m_wait       = stats_MetricNew(vout, STATS_METRIC_HISTOGRAM,
+                                             "vout_pool_wait_microseconds",
+                                             "vout", id, NULL);
+    sys->pool.m_pictures   = stats_MetricNew(vout, STATS_METRIC_GAUGE,
+                                             "vout_pool_pictures",
+                                             "vout", id, NULL);
+    sys->pool.m_high_water = stats_MetricNew(vout, STATS_METRIC_GAUGE,
+                                             "vout_pool_high_water",
+                                             "vout", id, NULL);
+    stats_MetricAdd(sys->pool.m_pictures, sys->pool.initial);
+}
+
+static void PoolStop(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    if (sys->pool.requests > 0)
+        msg_Dbg(vout, "decoder pool: %"PRIu64" requests, %"PRIu64"%% hits, "
+                "%d pictures used at most, waited %"PRId64" ms, grown by %d",
+                sys->pool.requests,
+                100 * (sys->pool.requests - sys->pool.misses) / sys->pool.requests,
+                sys->pool.peak, sys->pool.waited / 1000, sys->pool.grown);
+    stats_MetricDelete(sys->pool.m_requests);
+    stats_MetricDelete(sys->pool.m_misses);
+    stats_MetricDelete(sys->pool.m_wait);
+    stats_MetricDelete(sys->pool.m_pictures);
+    stats_MetricDelete(sys->pool.m_high_water);
+}
+
 static int ThreadStart(vout_thread_t *vout, const vout_display_state_t *state)
 {
     vlc_mouse_Init(&vout->p->mouse);
@@ -1360,6 +1513,7 @@ static int ThreadStart(vout_thread_t *vout, const vout_display_state_t *state)
     if (vout_InitWrapper(vout))
         return VLC_EGENERIC;
     assert(vout->p->decoder_pool);
+    PoolStart(vout);
 
     vout->p->displayed.current       = NULL;
     vout->p->displayed.next          = NULL;
@@ -1388,6 +1542,7 @@ static void ThreadStop(vout_thread_t *vout, vout_display_state_t *state)
     if (vout->p->display.vd) {
         if (vout->p->decoder_pool) {
             ThreadFlush(vout, true, INT64_MAX);
+            PoolStop(vout);
             vout_EndWrapper(vout);
         }
         vout_CloseWrapper(vout, state);
@@ -137,6 +137,25 @@ struct vout_thread_sys_t
     picture_pool_t  *decoder_pool;
     picture_fifo_t  *decoder_fifo;
     vout_chrono_t   render;           /**< picture render time estimator */
+
+    /* Decoder pool usage, protected by picture_lock */
+    struct {
+        int             initial;      /**< size before any growth */
+        int             grown;        /**< pictures added on starvation */
+        int             grown_max;    /**< 0 if it is the display pool */
+        mtime_t         wait_start;   /**< first miss of the current wait */
+        int             high_water;   /**< most pictures used in the window */
+        int             peak;         /**< most pictures ever used */
+        mtime_t         window_start;
+        uint64_t        requests;
+        uint64_t        misses;
+        mtime_t         waited;
+        struct stats_metric_t *m_requests;
+        struct stats_metric_t *m_misses;
+        struct stats_metric_t *m_wait;
+        struct stats_metric_t *m_pictures;
+        struct stats_metric_t *m_high_water;
+    } pool;
 };
 
 /* TODO to move them to vlc_vout.h */
@@ -0,0 +1,771 @@
+/*****************************************************************************
+ * pipeline.c: headless throughput benchmark of the mux/demux/decode pipelines
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Each pipeline runs in its own process, as fast as possible: the streams
+ * go to files or to the dummy stream output, and the decoders are fed
+ * directly, without clock nor output. The fixtures are generated from a
+ * fixed seed, and muxed by the in-tree muxers. The best of the runs is
+ * kept. Note that the input polls its decoders every tenth of a second
+ * when draining, which dominates the shortest pipelines: raise --frames
+ * to measure those. MPEG video is decoded serially, then with slice
+ * threads, when libmpeg2 is available.
+ *
+ *  bench_pipeline [--frames=N] [--runs=N] [--save=FILE]
+ *                 [--baseline=FILE] [--tolerance=PERCENT]
+ *
+ * With a baseline, the exit status is 1 if a pipeline is slower, or uses
+ * more memory or allocations, than the tolerance allows.
+ */
+
+#define MODULE_STRING "bench"
+
+#include "../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_input.h>
+#include <vlc_codec.h>
+#include <vlc_aout.h>
+#include <vlc_modules.h>
+#include "../modules/codec/mpgv.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#define WIDTH      320
+#define HEIGHT     240
+#define FRAME      (WIDTH * HEIGHT * 3 / 2)
+#define FRAME_RATE 25
+#define RATE       48000
+#define CHANNELS   2
+#define ADPCM      1024 /* IMA ADPCM block size */
+#define MPGA       384  /* MPEG-1 layer III, 128 kb/s: 24 ms frames */
+
+/*** Allocations ***/
+#ifdef __GLIBC__
+/* The allocations of the whole process, plug-ins included, are counted by
+ * overriding the allocator entry points, exported to the plug-ins. */
+extern void *__libc_malloc (size_t);
+extern void *__libc_calloc (size_t, size_t);
+extern void *__libc_realloc (void *, size_t);
+extern void *__libc_memalign (size_t, size_t);
+
+static unsigned long allocations;
+
+VLC_EXPORT void *malloc (size_t size)
+{
+    __sync_fetch_and_add (&allocations, 1);
+    return __libc_malloc (size);
+}
+
+VLC_EXPORT void *calloc (size_t n, size_t size)
+{
+    __sync_fetch_and_add (&allocations, 1);
+    return __libc_calloc (n, size);
+}
+
+VLC_EXPORT void *realloc (void *ptr, size_t size)
+{
+    __sync_fetch_and_add (&allocations, 1);
+    return __libc_realloc (ptr, size);
+}
+
+VLC_EXPORT int posix_memalign (void **pp, size_t align, size_t size)
+{
+    __sync_fetch_and_add (&allocations, 1);
+    *pp = __libc_memalign (align, size);
+    return (*pp != NULL) ? 0 : ENOMEM;
+}
+
+static unsigned long get_allocations (void)
+{
+    return __sync_fetch_and_add (&allocations, 0);
+}
+#else
+static unsigned long get_allocations (void)
+{
+    return 0;
+}
+#endif
+
+/*** Fixtures ***/
+static uint32_t seed = 0x2545F491;
+
+/* Deterministic, whatever the C library */
+static uint32_t prng (void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static void fill (uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        buf[i] = prng () >> 24;
+}
+
+static char dir[] = "/tmp/vlc-bench-XXXXXX";
+static unsigned frames = 250;
+
+static char *path (const char *name)
+{
+    char *p;
+
+    assert (asprintf (&p, "%s/%s", dir, name) != -1);
+    return p;
+}
+
+static off_t file_size (const char *name)
+{
+    char *p = path (name);
+    struct stat st;
+
+    int val = stat (p, &st);
+    free (p);
+    return val ? 0 : st.st_size;
+}
+
+/* Raw I420 video */
+static void write_y4m (const char *name)
+{
+    char *p = path (name);
+    FILE *stream = fopen (p, "wb");
+    uint8_t *frame = malloc (FRAME);
+
+    assert (stream != NULL && frame != NULL);
+    fprintf (stream, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n",
+             WIDTH, HEIGHT, FRAME_RATE);
+    for (unsigned i = 0; i < frames; i++)
+    {
+        fill (frame, FRAME);
+        fputs ("FRAME\n", stream);
+        assert (fwrite (frame, FRAME, 1, stream) == 1);
+    }
+    assert (!fclose (stream));
+    free (frame);
+    free (p);
+}
+
+/* 16-bits PCM, as long as the video */
+static void write_wav (const char *name)
+{
+    uint32_t len = frames * (RATE / FRAME_RATE) * CHANNELS * 2;
+    uint8_t head[44], *data = malloc (len);
+    char *p = path (name);
+
+    assert (data != NULL);
+    memcpy (head, "RIFF", 4);
+    SetDWLE (head + 4, sizeof (head) - 8 + len);
+    memcpy (head + 8, "WAVEfmt ", 8);
+    SetDWLE (head + 16, 16);
+    SetWLE (head + 20, 1); /* PCM */
+    SetWLE (head + 22, CHANNELS);
+    SetDWLE (head + 24, RATE);
+    SetDWLE (head + 28, RATE * CHANNELS * 2);
+    SetWLE (head + 32, CHANNELS * 2);
+    SetWLE (head + 34, 16);
+    memcpy (head + 36, "data", 4);
+    SetDWLE (head + 40, len);
+    fill (data, len);
+
+    int fd = open (p, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert (fd != -1);
+    assert (write (fd, head, sizeof (head)) == sizeof (head));
+    assert (write (fd, data, len) == (ssize_t)len);
+    close (fd);
+    free (data);
+    free (p);
+}
+
+/* MPEG audio frames, as long as the video, with random payloads */
+static void write_mp3 (const char *name)
+{
+    size_t len = frames * (1000 / FRAME_RATE) / 24 * MPGA;
+    uint8_t *data = malloc (len);
+    char *p = path (name);
+
+    assert (data != NULL);
+    fill (data, len);
+    for (size_t i = 0; i < len; i += MPGA)
+        memcpy (data + i, "\xFF\xFB\x94\x00", 4);
+
+    int fd = open (p, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert (fd != -1);
+    assert (write (fd, data, len) == (ssize_t)len);
+    close (fd);
+    free (data);
+    free (p);
+}
+
+/* MPEG-1 intra video. It only gets decoded, from memory. */
+static uint8_t *write_mpgv (size_t *offsets)
+{
+    return mpgv_generate (WIDTH, HEIGHT, frames, prng (), offsets);
+}
+
+/*** Pipelines ***/
+typedef struct
+{
+    bool          missing; /* module not available */
+    mtime_t       duration;
+    uint64_t      bytes;
+    uint64_t      frames;
+    unsigned long allocations;
+    long          rss; /* peak, in kiB */
+} result_t;
+
+typedef struct bench_t bench_t;
+struct bench_t
+{
+    const char *name;
+    void (*run) (vlc_object_t *, const bench_t *, result_t *);
+    const char *arg;   /* muxer, fixture or codec */
+    const char *src;   /* for the muxers */
+    const char *slave;
+    bool        ok;    /* for the pipelines that depend on it */
+    int         threads; /* for the decoders, 0 meaning auto; for the
+                          * remuxers, 0 meaning from the input thread */
+};
+
+/* Plays an input with a stream output, as fast as the output goes */
+static void stream (vlc_object_t *obj, const char *src, const char *slave,
+                    const char *sout)
+{
+    char *url, *option;
+
+    assert (asprintf (&url, "file://%s/%s", dir, src) != -1);
+    input_item_t *item = input_item_New (url, "bench");
+    assert (item != NULL);
+    free (url);
+    if (slave != NULL)
+    {
+        assert (asprintf (&option, ":input-slave=file://%s/%s", dir,
+                          slave) != -1);
+        input_item_AddOption (item, option, VLC_INPUT_OPTION_TRUSTED);
+        free (option);
+    }
+    assert (asprintf (&option, ":sout=%s", sout) != -1);
+    input_item_AddOption (item, option, VLC_INPUT_OPTION_TRUSTED);
+    free (option);
+    assert (input_Read (obj, item) == VLC_SUCCESS);
+    vlc_gc_decref (item);
+}
+
+/* Muxes the generated streams into a fixture */
+static void run_mux (vlc_object_t *obj, const bench_t *b, result_t *res)
+{
+    char *dst, *sout, name[16];
+
+    snprintf (name, sizeof (name), "fixture.%s", b->arg);
+    dst = path (name);
+    assert (asprintf (&sout, "#std{access=file,mux=%s,dst=%s}", b->arg,
+                      dst) != -1);
+
+    res->allocations = get_allocations ();
+    res->duration = mdate ();
+    stream (obj, b->src, b->slave, sout);
+    res->duration = mdate () - res->duration;
+    res->allocations = get_allocations () - res->allocations;
+
+    res->bytes = file_size (b->src);
+    if (b->slave != NULL)
+        res->bytes += file_size (b->slave);
+    res->frames = strstr (b->src, ".y4m") ? frames : 0;
+    free (sout);
+    free (dst);
+}
+
+/* Demuxes a fixture, to the dummy stream output */
+static void run_demux (vlc_object_t *obj, const bench_t *b, result_t *res)
+{
+    res->allocations = get_allocations ();
+    res->duration = mdate ();
+    stream (obj, b->arg, NULL, "#dummy");
+    res->duration = mdate () - res->duration;
+    res->allocations = get_allocations () - res->allocations;
+
+    res->bytes = file_size (b->arg);
+    res->frames = (strstr (b->arg, ".avi") || strstr (b->arg, ".asf"))
+                  ? frames : 0;
+}
+
+/* Remuxes a fixture into its own format, from the input thread or not */
+static void run_remux (vlc_object_t *obj, const bench_t *b, result_t *res)
+{
+    char *dst, *sout, name[16];
+    const char *mux = strrchr (b->arg, '.') + 1;
+
+    snprintf (name, sizeof (name), "remux.%s", mux);
+    dst = path (name);
+    assert (asprintf (&sout, "#std{access=file,mux=%s,dst=%s}", mux,
+                      dst) != -1);
+    var_Create (obj, "sout-remux-direct", VLC_VAR_BOOL);
+    var_SetBool (obj, "sout-remux-direct", b->threads == 0);
+
+    res->allocations = get_allocations ();
+    res->duration = mdate ();
+    stream (obj, b->arg, NULL, sout);
+    res->duration = mdate () - res->duration;
+    res->allocations = get_allocations () - res->allocations;
+
+    res->bytes = file_size (b->arg);
+    res->frames = frames;
+    unlink (dst);
+    free (sout);
+    free (dst);
+}
+
+static picture_t *new_picture (decoder_t *dec)
+{
+    dec->fmt_out.video.i_chroma = dec->fmt_out.i_codec;
+    return picture_NewFromFormat (&dec->fmt_out.video);
+}
+
+static void del_picture (decoder_t *dec, picture_t *pic)
+{
+    (void) dec;
+    picture_Release (pic);
+}
+
+static void link_picture (decoder_t *dec, picture_t *pic)
+{
+    (void) dec;
+    picture_Hold (pic);
+}
+
+static block_t *new_audio (decoder_t *dec, int samples)
+{
+    unsigned channels = aout_FormatNbChannels (&dec->fmt_out.audio);
+    if (channels == 0)
+        channels = dec->fmt_out.audio.i_channels;
+
+    block_t *block = block_Alloc (samples * channels
+                                  * aout_BitsPerSample (dec->fmt_out.i_codec)
+                                  / 8);
+    if (block != NULL)
+        block->i_nb_samples = samples;
+    return block;
+}
+
+/* Decodes generated frames, without any output */
+static void run_decode (vlc_object_t *obj, const bench_t *b, result_t *res)
+{
+    decoder_t *dec = vlc_object_create (obj, sizeof (*dec));
+    const char *module = "$codec";
+    size_t size, count;
+
+    assert (dec != NULL);
+    if (!strcmp (b->arg, "mpgv"))
+    {
+        es_format_Init (&dec->fmt_in, VIDEO_ES, VLC_CODEC_MPGV);
+        module = "libmpeg2";
+        var_Create (dec, "libmpeg2-threads", VLC_VAR_INTEGER);
+        var_SetInteger (dec, "libmpeg2-threads", b->threads);
+        size = 0;
+        count = frames;
+    }
+    else if (!strcmp (b->arg, "rawvideo"))
+    {
+        es_format_Init (&dec->fmt_in, VIDEO_ES, VLC_CODEC_I420);
+        dec->fmt_in.video.i_width = dec->fmt_in.video.i_visible_width = WIDTH;
+        dec->fmt_in.video.i_height =
+        dec->fmt_in.video.i_visible_height = HEIGHT;
+        dec->fmt_in.video.i_frame_rate = FRAME_RATE;
+        dec->fmt_in.video.i_frame_rate_base = 1;
+        size = FRAME;
+        count = frames;
+    }
+    else
+    {
+        bool adpcm = !strcmp (b->arg, "adpcm");
+
+        es_format_Init (&dec->fmt_in, AUDIO_ES,
+                        adpcm ? VLC_CODEC_ADPCM_IMA_WAV : VLC_CODEC_S16L);
+        dec->fmt_in.audio.i_rate = RATE;
+        dec->fmt_in.audio.i_channels = CHANNELS;
+        dec->fmt_in.audio.i_bitspersample = adpcm ? 4 : 16;
+        dec->fmt_in.audio.i_blockalign = adpcm ? ADPCM : CHANNELS * 2;
+        /* As much audio as in the other pipelines, 4 samples per byte */
+        size = adpcm ? ADPCM : RATE / FRAME_RATE * CHANNELS * 2;
+        count = frames * (RATE / FRAME_RATE) * CHANNELS * 2 / size;
+        if (adpcm)
+            count /= 4;
+    }
+    es_format_Init (&dec->fmt_out, UNKNOWN_ES, 0);
+    dec->pf_vout_buffer_new = new_picture;
+    dec->pf_vout_buffer_del = del_picture;
+    dec->pf_picture_link = link_picture;
+    dec->pf_picture_unlink = del_picture;
+    dec->pf_aout_buffer_new = new_audio;
+    dec->b_pace_control = true; /* no frame dropping */
+    dec->p_module = module_need (dec, "decoder", module,
+                                 strcmp (module, "$codec") != 0);
+    if (dec->p_module == NULL)
+    {
+        res->missing = true;
+        goto out;
+    }
+
+    /* The input is generated beforehand */
+    size_t *offsets = malloc ((count + 1) * sizeof (*offsets));
+    uint8_t *data;
+
+    assert (offsets != NULL);
+    if (size == 0)
+        data = write_mpgv (offsets);
+    else
+    {
+        data = malloc (size * count);
+        assert (data != NULL);
+        fill (data, size * count);
+        for (size_t i = 0; i <= count; i++)
+            offsets[i] = i * size;
+    }
+    if (dec->fmt_in.i_codec == VLC_CODEC_ADPCM_IMA_WAV)
+        for (size_t i = 0; i < count; i++)
+            for (unsigned c = 0; c < CHANNELS; c++)
+            {   /* valid step index in each block header */
+                uint8_t *head = data + i * size + 4 * c;
+                head[2] %= 89;
+                head[3] = 0;
+            }
+
+    res->allocations = get_allocations ();
+    res->duration = mdate ();
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t len = offsets[i + 1] - offsets[i];
+        block_t *block = block_Alloc (len);
+        assert (block != NULL);
+        memcpy (block->p_buffer, data + offsets[i], len);
+        block->i_pts = block->i_dts = VLC_TS_0 + i * CLOCK_FREQ / FRAME_RATE;
+
+        if (dec->fmt_in.i_cat == VIDEO_ES)
+        {
+            picture_t *pic;
+
+            while ((pic = dec->pf_decode_video (dec, &block)) != NULL)
+            {
+                picture_Release (pic);
+                res->frames++;
+            }
+        }
+        else
+        {
+            block_t *out;
+
+            while ((out = dec->pf_decode_audio (dec, &block)) != NULL)
+                block_Release (out);
+        }
+    }
+    res->duration = mdate () - res->duration;
+    res->allocations = get_allocations () - res->allocations;
+    res->bytes = offsets[count];
+
+    module_unneed (dec, dec->p_module);
+    free (offsets);
+    free (data);
+out:
+    es_format_Clean (&dec->fmt_in);
+    es_format_Clean (&dec->fmt_out);
+    vlc_object_release (dec);
+}
+
+/* The demuxers read what the muxers wrote */
+static bench_t benches[] = {
+    { "mux/avi",   run_mux, "avi", "source.y4m", "source.wav", false, 0 },
+    { "mux/asf",   run_mux, "asf", "source.y4m", "source.wav", false, 0 },
+    { "mux/mp4",   run_mux, "mp4", "source.mp3", NULL,         false, 0 },
+    { "mux/wav",   run_mux, "wav", "source.wav", NULL,         false, 0 },
+    { "demux/avi", run_demux, "fixture.avi", NULL, NULL, false, 0 },
+    { "demux/asf", run_demux, "fixture.asf", NULL, NULL, false, 0 },
+    { "demux/mp4", run_demux, "fixture.mp4", NULL, NULL, false, 0 },
+    { "demux/wav", run_demux, "fixture.wav", NULL, NULL, false, 0 },
+    { "decode/rawvideo", run_decode, "rawvideo", NULL, NULL, false, 0 },
+    { "decode/araw",     run_decode, "araw",     NULL, NULL, false, 0 },
+    { "decode/adpcm",    run_decode, "adpcm",    NULL, NULL, false, 0 },
+    /* Serial, then with as many slice threads as useful */
+    { "decode/mpgv",     run_decode, "mpgv",     NULL, NULL, false, 1 },
+    { "decode/mpgv-mt",  run_decode, "mpgv",     NULL, NULL, false, 0 },
+    /* With a thread per elementary stream, then from the input thread */
+    { "remux/avi",        run_remux, "fixture.avi", NULL, NULL, false, 1 },
+    { "remux/avi-direct", run_remux, "fixture.avi", NULL, NULL, false, 0 },
+    { "remux/asf",        run_remux, "fixture.asf", NULL, NULL, false, 1 },
+    { "remux/asf-direct", run_remux, "fixture.asf", NULL, NULL, false, 0 },
+};
+#define BENCHES (sizeof (benches) / sizeof (benches[0]))
+
+/* Runs a pipeline in a child process, with its own LibVLC instance */
+static bool run (const bench_t *b, result_t *res)
+{
+    int fds[2];
+
+    memset (res, 0, sizeof (*res));
+    assert (!pipe (fds));
+    fflush (stdout);
+
+    pid_t pid = fork ();
+    assert (pid != -1);
+    if (pid == 0)
+    {
+        close (fds[0]);
+        libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                             test_defaults_args);
+        assert (vlc != NULL);
+        b->run (VLC_OBJECT(vlc->p_libvlc_int), b, res);
+        libvlc_release (vlc);
+        assert (write (fds[1], res, sizeof (*res)) == sizeof (*res));
+        _exit (0);
+    }
+
+    struct rusage ru;
+    int status;
+
+    close (fds[1]);
+    ssize_t len = read (fds[0], res, sizeof (*res));
+    close (fds[0]);
+    assert (wait4 (pid, &status, 0, &ru) == pid);
+    if (len != sizeof (*res) || !WIFEXITED (status) || WEXITSTATUS (status))
+        return false;
+    res->rss = ru.ru_maxrss;
+    return true;
+}
+
+static double mbps (const result_t *res)
+{
+    return res->duration ? res->bytes / (double)res->duration : 0.;
+}
+
+static double fps (const result_t *res)
+{
+    return res->duration ? res->frames * (double)CLOCK_FREQ / res->duration
+                         : 0.;
+}
+
+/*** Baseline ***/
+typedef struct
+{
+    char   name[32];
+    double mbps;
+    double fps;
+    unsigned long allocations;
+    long   rss;
+} baseline_t;
+
+static baseline_t *load_baseline (const char *file, unsigned *count)
+{
+    baseline_t *tab = NULL, entry;
+    char *line = NULL;
+    size_t size = 0;
+
+    *count = 0;
+    FILE *stream = fopen (file, "rt");
+    if (stream == NULL)
+    {
+        perror (file);
+        exit (2);
+    }
+    while (getline (&line, &size, stream) != -1)
+    {
+        if (line[0] == '#'
+         || sscanf (line, "%31s %lf %lf %lu %ld", entry.name, &entry.mbps,
+                    &entry.fps, &entry.allocations, &entry.rss) != 5)
+            continue;
+        tab = realloc (tab, (*count + 1) * sizeof (*tab));
+        assert (tab != NULL);
+        tab[(*count)++] = entry;
+    }
+    free (line);
+    fclose (stream);
+    return tab;
+}
+
+/* Returns whether a pipeline regressed */
+static bool compare (const char *name, const result_t *res,
+                     const baseline_t *tab, unsigned count, double tolerance)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        const baseline_t *base = &tab[i];
+        bool bad = false;
+
+        if (strcmp (base->name, name))
+            continue;
+        if (mbps (res) < base->mbps * (1. - tolerance))
+        {
+            printf ("  %s: %.2f MB/s, was %.2f MB/s\n", name, mbps (res),
+                    base->mbps);
+            bad = true;
+        }
+        if (res->allocations > base->allocations * (1. + tolerance))
+        {
+            printf ("  %s: %lu allocations, was %lu\n", name,
+                    res->allocations, base->allocations);
+            bad = true;
+        }
+        if (res->rss > base->rss * (1. + tolerance))
+        {
+            printf ("  %s: %ld kiB peak RSS, was %ld kiB\n", name, res->rss,
+                    base->rss);
+            bad = true;
+        }
+        return bad;
+    }
+    printf ("  %s: not in the baseline\n", name);
+    return false;
+}
+
+int main (int argc, char *argv[])
+{
+    static const struct option opts[] = {
+        { "frames",    required_argument, NULL, 'f' },
+        { "runs",      required_argument, NULL, 'r' },
+        { "save",      required_argument, NULL, 's' },
+        { "baseline",  required_argument, NULL, 'b' },
+        { "tolerance", required_argument, NULL, 't' },
+        { NULL,        0,                 NULL, 0   },
+    };
+    const char *save = NULL, *baseline = NULL;
+    double tolerance = .10;
+    unsigned runs = 3;
+    int c;
+
+    while ((c = getopt_long (argc, argv, "", opts, NULL)) != -1)
+        switch (c)
+        {
+            case 'f': frames = strtoul (optarg, NULL, 10); break;
+            case 'r': runs = strtoul (optarg, NULL, 10); break;
+            case 's': save = optarg; break;
+            case 'b': baseline = optarg; break;
+            case 't': tolerance = strtod (optarg, NULL) / 100.; break;
+            default:
+                fprintf (stderr, "Usage: %s [--frames=N] [--runs=N] "
+                         "[--save=FILE] [--baseline=FILE] "
+                         "[--tolerance=PERCENT]\n", argv[0]);
+                return 2;
+        }
+    if (frames == 0 || runs == 0)
+        return 2;
+
+    setenv ("VLC_PLUGIN_PATH", "../modules", 0);
+    assert (mkdtemp (dir) != NULL);
+    write_y4m ("source.y4m");
+    write_wav ("source.wav");
+    write_mp3 ("source.mp3");
+
+    result_t results[BENCHES];
+    unsigned base_count = 0;
+    baseline_t *base = baseline ? load_baseline (baseline, &base_count)
+                                : NULL;
+    bool regressed = false;
+
+    printf ("%-16s %10s %10s %12s %10s\n", "pipeline", "MB/s", "frames/s",
+            "allocations", "RSS (kiB)");
+    for (unsigned i = 0; i < BENCHES; i++)
+    {
+        bench_t *b = &benches[i];
+        result_t *best = &results[i];
+
+        if ((b->run == run_demux || b->run == run_remux)
+         && file_size (b->arg) == 0)
+        {
+            printf ("%-16s %10s\n", b->name, "skipped");
+            continue;
+        }
+
+        /* The fastest run, and the least memory */
+        result_t res = { .missing = false };
+        for (unsigned j = 0; j < runs; j++)
+        {
+            if (!run (b, &res) || res.missing)
+                break;
+            if (!b->ok || res.duration < best->duration)
+            {
+                long rss = b->ok && best->rss < res.rss ? best->rss : res.rss;
+
+                *best = res;
+                best->rss = rss;
+            }
+            b->ok = true;
+        }
+        if (!b->ok)
+        {
+            printf ("%-16s %10s\n", b->name, res.missing ? "skipped"
+                                                          : "failed");
+            continue;
+        }
+        printf ("%-16s %10.2f %10.1f %12lu %10ld\n", b->name, mbps (best),
+                fps (best), best->allocations, best->rss);
+        if (base != NULL)
+            regressed |= compare (b->name, best, base, base_count, tolerance);
+    }
+
+    const result_t *serial = NULL;
+    for (unsigned i = 0; i < BENCHES; i++)
+        if (benches[i].ok && benches[i].threads == 1)
+            serial = &results[i];
+        else if (benches[i].ok && serial != NULL && fps (serial) > 0.)
+        {
+            printf ("%s: %.2fx the frame rate of %s\n", benches[i].name,
+                    fps (&results[i]) / fps (serial),
+                    benches[serial - results].name);
+            serial = NULL;
+        }
+
+    if (save != NULL)
+    {
+        FILE *stream = fopen (save, "wt");
+        if (stream == NULL)
+        {
+            perror (save);
+            return 2;
+        }
+        fprintf (stream, "# pipeline MB/s frames/s allocations RSS(kiB), "
+                 "%u frames\n", frames);
+        for (unsigned i = 0; i < BENCHES; i++)
+            if (benches[i].ok)
+                fprintf (stream, "%s %.2f %.1f %lu %ld\n", benches[i].name,
+                         mbps (&results[i]), fps (&results[i]),
+                         results[i].allocations, results[i].rss);
+        fclose (stream);
+    }
+
+    char *cmd;
+    assert (asprintf (&cmd, "rm -rf -- %s", dir) != -1);
+    assert (!system (cmd));
+    free (cmd);
+    free (base);
+
+    if (regressed)
+    {
+        printf ("regression beyond %.0f%%\n", tolerance * 100.);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*
+ * frames.c - libvlc zero-copy frames test
+ *
+ * $Id$
+ */
+
+/**********************************************************************
+ *  Copyright (C) 2012 VLC authors and VideoLAN                       *
+ *  This program is free software; you can redistribute and/or modify *
+ *  it under the terms of the GNU General Public License as published *
+ *  by the Free Software Foundation; version 2 of the license, or (at *
+ *  your option) any later version.                                   *
+ *                                                                    *
+ *  This program is distributed in the hope that it will be useful,   *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of    *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *  See the GNU General Public License for more details.              *
+ *                                                                    *
+ *  You should have received a copy of the GNU General Public License *
+ *  along with this program; if not, you can get it from:             *
+ *  http://www.gnu.org/copyleft/gpl.html                              *
+ **********************************************************************/
+
+#include "test.h"
+#include "player.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Two seconds of tiny video, each frame with its own luma */
+#define WIDTH   64
+#define HEIGHT  48
+#define FRAMES  50
+
+/* A quarter of a second of 8 kHz 16-bits mono PCM */
+#define RATE    8000
+#define SAMPLES (RATE / 4)
+
+static void write_y4m (const char *path)
+{
+    FILE *stream = fopen (path, "wb");
+    uint8_t frame[WIDTH * HEIGHT * 3 / 2];
+
+    assert (stream != NULL);
+    fprintf (stream, "YUV4MPEG2 W%d H%d F25:1 Ip A1:1 C420jpeg\n",
+             WIDTH, HEIGHT);
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        memset (frame, 4 * i, WIDTH * HEIGHT);
+        memset (frame + WIDTH * HEIGHT, 128, WIDTH * HEIGHT / 2);
+        fputs ("FRAME\n", stream);
+        assert (fwrite (frame, sizeof (frame), 1, stream) == 1);
+    }
+    assert (fclose (stream) == 0);
+}
+
+/*** Video frames ***/
+static libvlc_video_frame_t *frames[FRAMES];
+static unsigned frame_count;
+static int last_luma = -1;
+
+static unsigned setup (void **opaque, char *chroma, unsigned *width,
+                       unsigned *height, unsigned *pitches, unsigned *lines)
+{
+    (void) opaque; (void) pitches; (void) lines;
+
+    /* As decoded */
+    assert (!memcmp (chroma, "I420", 4));
+    assert (*width == WIDTH && *height == HEIGHT);
+    return 0;
+}
+
+static void on_frame (void *opaque, libvlc_video_frame_t *frame,
+                      void *const *planes, const unsigned *pitches,
+                      const unsigned *lines, int64_t date)
+{
+    assert (opaque == frames);
+    assert (planes[0] != NULL && planes[1] != NULL && planes[2] != NULL);
+    assert (planes[3] == NULL);
+    assert (pitches[0] >= WIDTH && lines[0] >= HEIGHT);
+    assert (pitches[1] >= WIDTH / 2 && lines[1] >= HEIGHT / 2);
+    /* The first frame is shown early, ahead of its date */
+    assert (llabs (date - libvlc_clock ()) < 5000000);
+
+    /* The frames are in order, and each one is handed once */
+    int luma = *(const uint8_t *)planes[0];
+    assert (luma > last_luma && luma % 4 == 0);
+    assert (*(const uint8_t *)planes[1] == 128);
+    last_luma = luma;
+
+    unsigned n = __sync_fetch_and_add (&frame_count, 0);
+    assert (n < FRAMES);
+    frames[n] = frame;
+    __sync_fetch_and_add (&frame_count, 1);
+}
+
+/* Waits until no frame comes in for half a second */
+static unsigned wait_stalled (void)
+{
+    unsigned n = __sync_fetch_and_add (&frame_count, 0);
+
+    for (;;)
+    {
+        usleep (500000);
+
+        unsigned m = __sync_fetch_and_add (&frame_count, 0);
+        if (m == n)
+            return n;
+        n = m;
+    }
+}
+
+static void test_video_frames (const char *path)
+{
+    log ("Testing video frames\n");
+
+    libvlc_instance_t *vlc = player_instance (NULL, 0);
+    libvlc_media_player_t *mp = player_new (vlc, path, NULL);
+
+    libvlc_video_set_frame_callback (mp, on_frame, frames);
+    libvlc_video_set_format_callbacks (mp, setup, NULL);
+    assert (!libvlc_media_player_play (mp));
+
+    /* Held frames are not reused: the decoding waits for them */
+    unsigned held = wait_stalled ();
+    log ("%u frames held, out of %u\n", held, FRAMES);
+    assert (held > 0 && held < FRAMES);
+
+    /* and resumes once they are released */
+    for (unsigned i = 0; i < held; i++)
+        libvlc_video_frame_release (frames[i]);
+    while (__sync_fetch_and_add (&frame_count, 0) == held)
+        usleep (10000);
+
+    /* Frames can also outlive the video output */
+    libvlc_media_player_stop (mp);
+    unsigned count = __sync_fetch_and_add (&frame_count, 0);
+    log ("%u frames in all\n", count);
+    for (unsigned i = held; i < count; i++)
+        libvlc_video_frame_release (frames[i]);
+
+    libvlc_media_player_release (mp);
+    libvlc_release (vlc);
+}
+
+/*** Stream output frames ***/
+static size_t audio_bytes, audio_block;
+static unsigned audio_frames;
+static void *audio_held[64];
+static void (*audio_release) (void *);
+
+static void on_audio (void *data, void *frame, uint8_t *buffer,
+                      unsigned channels, unsigned rate, unsigned samples,
+                      unsigned bits, unsigned size, int64_t pts,
+                      void (*release) (void *))
+{
+    assert (data == audio_held);
+    assert (buffer != NULL && frame != NULL);
+    assert (channels == 1 && rate == RATE && bits == 16);
+    assert (samples * 2 == size);
+    (void) pts;
+
+    audio_bytes += size;
+    if (size > audio_block)
+        audio_block = size;
+    if (audio_frames < sizeof (audio_held) / sizeof (audio_held[0]))
+    {
+        audio_held[audio_frames++] = frame;
+        audio_release = release;
+    }
+    else
+        release (frame);
+}
+
+static void test_sout_frames (const char *path)
+{
+    char option[256];
+
+    log ("Testing stream output frames\n");
+
+    libvlc_instance_t *vlc = player_instance (NULL, 0);
+    snprintf (option, sizeof (option),
+              ":sout=#smem{audio-frame-callback=%lld,audio-data=%lld,"
+              "time-sync=no}", (long long)(intptr_t)on_audio,
+              (long long)(intptr_t)audio_held);
+    libvlc_media_player_t *mp = player_new (vlc, path, option);
+
+    assert (!libvlc_media_player_play (mp));
+    player_wait_state (mp, libvlc_Ended);
+    libvlc_media_player_stop (mp);
+    libvlc_media_player_release (mp);
+
+    /* The samples, in the buffers that are still held, but for the last
+     * block that the packetizer keeps */
+    log ("%zu bytes in %u frames\n", audio_bytes, audio_frames);
+    assert (audio_bytes <= 2 * SAMPLES);
+    assert (audio_bytes + audio_block >= 2 * SAMPLES);
+    assert (audio_frames > 0);
+    for (unsigned i = 0; i < audio_frames; i++)
+        audio_release (audio_held[i]);
+
+    libvlc_release (vlc);
+}
+
+static unsigned sout_video_frames;
+
+static void on_video (void *data, void *frame, uint8_t *const *planes,
+                      const unsigned *pitches, const unsigned *lines,
+                      int width, int height, int64_t pts,
+                      void (*release) (void *))
+{
+    assert (data == &sout_video_frames);
+    assert (width == WIDTH && height == HEIGHT);
+    (void) pts;
+
+    /* The I420 planes, one after the other */
+    assert (planes[0] != NULL && planes[1] != NULL && planes[2] != NULL);
+    assert (planes[3] == NULL);
+    assert (pitches[0] == WIDTH && lines[0] == HEIGHT);
+    for (unsigned i = 1; i < 3; i++)
+    {
+        assert (pitches[i] == WIDTH / 2 && lines[i] == HEIGHT / 2);
+        assert (planes[i] == planes[i - 1] + pitches[i - 1] * lines[i - 1]);
+    }
+    assert (planes[0][0] == 4 * sout_video_frames);
+    assert (planes[0][WIDTH * HEIGHT - 1] == 4 * sout_video_frames);
+    assert (planes[2][WIDTH * HEIGHT / 4 - 1] == 128);
+
+    sout_video_frames++;
+    release (frame);
+}
+
+static void test_sout_video_frames (const char *path)
+{
+    char option[256];
+
+    log ("Testing stream output video frames\n");
+
+    libvlc_instance_t *vlc = player_instance (NULL, 0);
+    snprintf (option, sizeof (option),
+              ":sout=#smem{video-frame-callback=%lld,video-data=%lld,"
+              "time-sync=no}", (long long)(intptr_t)on_video,
+              (long long)(intptr_t)&sout_video_frames);
+    libvlc_media_player_t *mp = player_new (vlc, path, option);
+
+    assert (!libvlc_media_player_play (mp));
+    player_wait_state (mp, libvlc_Ended);
+    libvlc_media_player_stop (mp);
+    libvlc_media_player_release (mp);
+
+    log ("%u frames\n", sout_video_frames);
+    assert (sout_video_frames == FRAMES);
+    libvlc_release (vlc);
+}
+
+int main (void)
+{
+    char base[] = "/tmp/vlc-test-frames-XXXXXX";
+    char video[sizeof (base) + 8], audio[sizeof (base) + 8];
+
+    test_init ();
+
+    assert (mkdtemp (base) != NULL);
+    snprintf (video, sizeof (video), "%s/in.y4m", base);
+    snprintf (audio, sizeof (audio), "%s/in.wav", base);
+    write_y4m (video);
+    wav_write (audio, RATE, SAMPLES);
+
+    test_video_frames (video);
+    test_sout_frames (audio);
+    test_sout_video_frames (video);
+
+    unlink (video);
+    unlink (audio);
+    rmdir (base);
+    return 0;
+}
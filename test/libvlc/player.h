@@ -0,0 +1,196 @@
+/*****************************************************************************
+ * player.h: media fixtures and media player helpers for the tests
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#define PLAYER_TIMEOUT 5 /* seconds */
+
+static inline void wav_put (uint8_t *p, uint32_t value, unsigned bytes)
+{
+    for (unsigned i = 0; i < bytes; i++)
+        p[i] = value >> (8 * i); /* little endian */
+}
+
+/* Writes random 16-bits mono PCM samples at the given rate to a WAV file */
+static inline void wav_write (const char *path, unsigned rate,
+                              unsigned samples)
+{
+    uint8_t head[44];
+
+    memcpy (head, "RIFF", 4);
+    wav_put (head + 4, sizeof (head) - 8 + 2 * samples, 4);
+    memcpy (head + 8, "WAVEfmt ", 8);
+    wav_put (head + 16, 16, 4);
+    wav_put (head + 20, 1, 2); /* PCM */
+    wav_put (head + 22, 1, 2);
+    wav_put (head + 24, rate, 4);
+    wav_put (head + 28, 2 * rate, 4);
+    wav_put (head + 32, 2, 2);
+    wav_put (head + 34, 16, 2);
+    memcpy (head + 36, "data", 4);
+    wav_put (head + 40, 2 * samples, 4);
+
+    FILE *stream = fopen (path, "wb");
+    assert (stream != NULL);
+    assert (fwrite (head, sizeof (head), 1, stream) == 1);
+    for (unsigned i = 0; i < samples; i++)
+    {
+        fputc (rand (), stream);
+        fputc (rand (), stream);
+    }
+    assert (fclose (stream) == 0);
+}
+
+/* Creates an instance with the test defaults and the given options */
+static inline libvlc_instance_t *player_instance (const char *const *options,
+                                                  unsigned count)
+{
+    const char *argv[test_defaults_nargs + count];
+
+    for (int i = 0; i < test_defaults_nargs; i++)
+        argv[i] = test_defaults_args[i];
+    for (unsigned i = 0; i < count; i++)
+        argv[test_defaults_nargs + i] = options[i];
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs + count, argv);
+    assert (vlc != NULL);
+    return vlc;
+}
+
+/* Creates a player for a file, with an optional media option */
+static inline libvlc_media_player_t *player_new (libvlc_instance_t *vlc,
+                                                 const char *path,
+                                                 const char *option)
+{
+    libvlc_media_t *md = libvlc_media_new_path (vlc, path);
+    assert (md != NULL);
+    if (option != NULL)
+        libvlc_media_add_option (md, option);
+
+    libvlc_media_player_t *mp = libvlc_media_player_new_from_media (md);
+    assert (mp != NULL);
+    libvlc_media_release (md);
+    return mp;
+}
+
+/**
+ * Counter of events of a player. The waits fail after PLAYER_TIMEOUT
+ * seconds, rather than let the alarm of test_init() kill the test.
+ */
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t wait;
+    unsigned count;
+    struct timespec deadline;
+} player_events_t;
+
+static inline void player_events_cb (const libvlc_event_t *ev, void *data)
+{
+    player_events_t *events = data;
+
+    (void) ev;
+    pthread_mutex_lock (&events->lock);
+    events->count++;
+    pthread_cond_broadcast (&events->wait);
+    pthread_mutex_unlock (&events->lock);
+}
+
+static inline void player_events_init (player_events_t *events,
+                                       libvlc_media_player_t *mp,
+                                       const libvlc_event_type_t *types,
+                                       unsigned n)
+{
+    libvlc_event_manager_t *em = libvlc_media_player_event_manager (mp);
+
+    pthread_mutex_init (&events->lock, NULL);
+    pthread_cond_init (&events->wait, NULL);
+    events->count = 0;
+    clock_gettime (CLOCK_REALTIME, &events->deadline);
+    events->deadline.tv_sec += PLAYER_TIMEOUT;
+    for (unsigned i = 0; i < n; i++)
+        assert (!libvlc_event_attach (em, types[i], player_events_cb,
+                                      events));
+}
+
+static inline void player_events_clean (player_events_t *events,
+                                        libvlc_media_player_t *mp,
+                                        const libvlc_event_type_t *types,
+                                        unsigned n)
+{
+    libvlc_event_manager_t *em = libvlc_media_player_event_manager (mp);
+
+    for (unsigned i = 0; i < n; i++)
+        libvlc_event_detach (em, types[i], player_events_cb, events);
+    pthread_cond_destroy (&events->wait);
+    pthread_mutex_destroy (&events->lock);
+}
+
+/* Returns how many events came so far */
+static inline unsigned player_events_count (player_events_t *events)
+{
+    pthread_mutex_lock (&events->lock);
+    unsigned count = events->count;
+    pthread_mutex_unlock (&events->lock);
+    return count;
+}
+
+/* Waits for an event after the given count of them */
+static inline void player_events_wait (player_events_t *events,
+                                       unsigned count)
+{
+    pthread_mutex_lock (&events->lock);
+    while (events->count == count)
+        assert (pthread_cond_timedwait (&events->wait, &events->lock,
+                                        &events->deadline) != ETIMEDOUT);
+    pthread_mutex_unlock (&events->lock);
+}
+
+/* Waits until the player is in the wanted state, failing on errors */
+static inline void player_wait_state (libvlc_media_player_t *mp,
+                                      libvlc_state_t wanted)
+{
+    static const libvlc_event_type_t types[] = {
+        libvlc_MediaPlayerOpening, libvlc_MediaPlayerBuffering,
+        libvlc_MediaPlayerPlaying, libvlc_MediaPlayerPaused,
+        libvlc_MediaPlayerStopped, libvlc_MediaPlayerEndReached,
+        libvlc_MediaPlayerEncounteredError,
+    };
+    const unsigned n = sizeof (types) / sizeof (types[0]);
+    player_events_t events;
+
+    /* The state is set before its event is sent */
+    player_events_init (&events, mp, types, n);
+    for (;;)
+    {
+        unsigned count = player_events_count (&events);
+        libvlc_state_t state = libvlc_media_player_get_state (mp);
+
+        if (state == wanted)
+            break;
+        assert (state != libvlc_Error);
+        player_events_wait (&events, count);
+    }
+    player_events_clean (&events, mp, types, n);
+}
@@ -0,0 +1,429 @@
+/*****************************************************************************
+ * http.c: test for the HTTP access persistent connections
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_variables.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "../../src/input/stream_check.h"
+
+#define SIZE (4 << 20)
+#define MAX_CONNECTIONS 64
+#define TAIL (64 << 10)
+
+static uint8_t *data;
+
+/*** A minimal HTTP/1.1 server, with ranges and persistent connections ***/
+static struct
+{
+    int fd;
+    vlc_thread_t thread;
+    vlc_mutex_t lock;
+    vlc_cond_t closed;
+    int clients[MAX_CONNECTIONS];
+    vlc_thread_t threads[MAX_CONNECTIONS];
+    unsigned connections;
+    unsigned requests;
+    unsigned pipelined;
+    bool hold;
+} server;
+
+static int send_all (int fd, const void *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t val = send (fd, buf, len, MSG_NOSIGNAL);
+        if (val <= 0)
+            return -1;
+        buf = (const uint8_t *)buf + val;
+        len -= val;
+    }
+    return 0;
+}
+
+static int respond (int fd, const char *req)
+{
+    uint64_t start = 0, end = SIZE - 1;
+    char head[256];
+    int len;
+
+    const char *range = strstr (req, "\r\nRange: bytes=");
+    if (range != NULL)
+    {
+        int n = sscanf (range, "\r\nRange: bytes=%"SCNu64"-%"SCNu64,
+                        &start, &end);
+        assert (n >= 1);
+        if (end >= SIZE)
+            end = SIZE - 1;
+        if (start >= SIZE)
+        {
+            len = sprintf (head, "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                           "Content-Length: 0\r\n\r\n");
+            return send_all (fd, head, len);
+        }
+        len = sprintf (head, "HTTP/1.1 206 Partial Content\r\n"
+                       "Content-Range: bytes %"PRIu64"-%"PRIu64"/%u\r\n"
+                       "Content-Length: %"PRIu64"\r\n"
+                       "Accept-Ranges: bytes\r\n\r\n",
+                       start, end, SIZE, end + 1 - start);
+    }
+    else
+        len = sprintf (head, "HTTP/1.1 200 OK\r\n"
+                       "Content-Length: %u\r\n\r\n", SIZE);
+
+    if (send_all (fd, head, len))
+        return -1;
+
+    uint64_t body = end + 1 - start;
+    vlc_mutex_lock (&server.lock);
+    bool hold = server.hold && body > 4 * TAIL;
+    vlc_mutex_unlock (&server.lock);
+    if (hold)
+    {   /* Wait for the next request before the end of the response */
+        struct pollfd ufd = { .fd = fd, .events = POLLIN };
+
+        if (send_all (fd, data + start, body - TAIL))
+            return -1;
+        if (poll (&ufd, 1, 1000) > 0)
+        {
+            vlc_mutex_lock (&server.lock);
+            server.pipelined++;
+            vlc_mutex_unlock (&server.lock);
+        }
+        start += body - TAIL;
+        body = TAIL;
+    }
+    return send_all (fd, data + start, body);
+}
+
+static void *client_thread (void *opaque)
+{
+    unsigned slot = (uintptr_t)opaque;
+    int fd = server.clients[slot];
+    char buf[4096];
+    size_t len = 0;
+
+    for (;;)
+    {
+        char *eoh;
+
+        buf[len] = '\0';
+        while ((eoh = strstr (buf, "\r\n\r\n")) == NULL)
+        {
+            ssize_t val = recv (fd, buf + len, sizeof (buf) - 1 - len, 0);
+            if (val <= 0)
+                goto out;
+            len += val;
+            buf[len] = '\0';
+        }
+        eoh += 4;
+
+        vlc_mutex_lock (&server.lock);
+        server.requests++;
+        vlc_mutex_unlock (&server.lock);
+
+        *(eoh - 2) = '\0';
+        if (respond (fd, buf))
+            break;
+        len -= eoh - buf;
+        memmove (buf, eoh, len);
+    }
+out:
+    vlc_mutex_lock (&server.lock);
+    close (fd);
+    server.clients[slot] = -1;
+    vlc_cond_signal (&server.closed);
+    vlc_mutex_unlock (&server.lock);
+    return NULL;
+}
+
+static void *server_thread (void *opaque)
+{
+    (void) opaque;
+
+    for (;;)
+    {
+        int fd = accept (server.fd, NULL, NULL);
+        if (fd == -1)
+            break;
+
+        vlc_mutex_lock (&server.lock);
+        unsigned slot = server.connections++;
+        assert (slot < MAX_CONNECTIONS);
+        server.clients[slot] = fd;
+        vlc_mutex_unlock (&server.lock);
+        assert (!vlc_clone (&server.threads[slot], client_thread,
+                            (void *)(uintptr_t)slot,
+                            VLC_THREAD_PRIORITY_LOW));
+    }
+    return NULL;
+}
+
+static unsigned server_start (void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+    };
+    socklen_t addrlen = sizeof (addr);
+
+    server.fd = socket (AF_INET, SOCK_STREAM, 0);
+    assert (server.fd != -1);
+    assert (!bind (server.fd, (struct sockaddr *)&addr, sizeof (addr)));
+    assert (!listen (server.fd, 8));
+    assert (!getsockname (server.fd, (struct sockaddr *)&addr, &addrlen));
+    vlc_mutex_init (&server.lock);
+    vlc_cond_init (&server.closed);
+    assert (!vlc_clone (&server.thread, server_thread, NULL,
+                        VLC_THREAD_PRIORITY_LOW));
+    return ntohs (addr.sin_port);
+}
+
+/* Closes all connections on the server side, as an idle timeout would */
+static void server_drop (void)
+{
+    vlc_mutex_lock (&server.lock);
+    for (unsigned i = 0; i < server.connections; i++)
+        if (server.clients[i] != -1)
+            shutdown (server.clients[i], SHUT_RDWR);
+    vlc_mutex_unlock (&server.lock);
+}
+
+static void server_stop (void)
+{
+    shutdown (server.fd, SHUT_RDWR);
+    vlc_join (server.thread, NULL);
+    server_drop ();
+    for (unsigned i = 0; i < server.connections; i++)
+        vlc_join (server.threads[i], NULL);
+    close (server.fd);
+    vlc_cond_destroy (&server.closed);
+    vlc_mutex_destroy (&server.lock);
+}
+
+/* Waits until the server side of all connections is closed */
+static void wait_closed (void)
+{
+    mtime_t deadline = mdate () + 5 * CLOCK_FREQ;
+    bool open;
+
+    vlc_mutex_lock (&server.lock);
+    do
+    {
+        open = false;
+        for (unsigned i = 0; i < server.connections; i++)
+            if (server.clients[i] != -1)
+                open = true;
+    }
+    while (open
+        && vlc_cond_timedwait (&server.closed, &server.lock, deadline) == 0);
+    vlc_mutex_unlock (&server.lock);
+    assert (!open);
+}
+
+static unsigned connections (void)
+{
+    vlc_mutex_lock (&server.lock);
+    unsigned n = server.connections;
+    vlc_mutex_unlock (&server.lock);
+    return n;
+}
+
+static unsigned requests (bool pipelined)
+{
+    vlc_mutex_lock (&server.lock);
+    unsigned n = pipelined ? server.pipelined : server.requests;
+    vlc_mutex_unlock (&server.lock);
+    return n;
+}
+
+/*** Client side ***/
+static void read_all (stream_t *s)
+{
+    for (uint64_t pos = 0; pos < SIZE; pos += 10000)
+        check_read (s, data, SIZE, pos, 10000);
+    assert (stream_Read (s, &(uint8_t){ 0 }, 1) == 0);
+}
+
+/* Leaves an idle connection in the pool */
+static void pool_connection (vlc_object_t *obj, const char *url)
+{
+    stream_t *s = stream_UrlNew (obj, url);
+    assert (s != NULL);
+    assert (stream_Seek (s, SIZE - 10) == VLC_SUCCESS);
+    check_read (s, data, SIZE, SIZE - 10, 10);
+    assert (stream_Read (s, &(uint8_t){ 0 }, 1) == 0);
+    stream_Delete (s);
+}
+
+static void test_sequential (vlc_object_t *obj, const char *url)
+{
+    /* Idle connections are kept only while an HTTP input is open */
+    stream_t *hold = stream_UrlNew (obj, url);
+    assert (hold != NULL);
+    check_read (hold, data, SIZE, 0, 1000);
+
+    unsigned n = connections ();
+    stream_t *s = stream_UrlNew (obj, url);
+    assert (s != NULL);
+    assert (stream_Size (s) == SIZE);
+    read_all (s);
+    stream_Delete (s);
+
+    /* The whole file came in an open-ended range over a single connection */
+    assert (connections () == n + 1);
+
+    /* The next input reuses the idle connection, with bounded ranges */
+    unsigned r = requests (false);
+    s = stream_UrlNew (obj, url);
+    assert (s != NULL);
+    read_all (s);
+    stream_Delete (s);
+    assert (connections () == n + 1);
+    assert (requests (false) > r + 1);
+    log ("sequential: %u requests\n", requests (false));
+
+    /* The pool is emptied with the last input */
+    stream_Delete (hold);
+    wait_closed ();
+}
+
+static void test_seek (vlc_object_t *obj, const char *url)
+{
+    stream_t *s = stream_UrlNew (obj, url);
+    assert (s != NULL);
+
+    for (unsigned i = 0; i < 200; i++)
+    {
+        uint64_t pos = rand () % SIZE;
+
+        assert (stream_Seek (s, pos) == VLC_SUCCESS);
+        check_read (s, data, SIZE, pos, 1 + rand () % 16384);
+    }
+
+    /* Short forward seeks stay on the same connection */
+    assert (stream_Seek (s, 0) == VLC_SUCCESS);
+    check_read (s, data, SIZE, 0, 1000);
+    unsigned n = connections ();
+    for (uint64_t pos = 0; pos + 30000 < SIZE / 4; pos += 30000)
+    {
+        assert (stream_Seek (s, pos) == VLC_SUCCESS);
+        check_read (s, data, SIZE, pos, 1000);
+    }
+    assert (connections () == n);
+
+    /* End of file, and back */
+    assert (stream_Seek (s, SIZE - 10) == VLC_SUCCESS);
+    check_read (s, data, SIZE, SIZE - 10, 10);
+    assert (stream_Read (s, &(uint8_t){ 0 }, 1) == 0);
+    assert (stream_Seek (s, 1000) == VLC_SUCCESS);
+    check_read (s, data, SIZE, 1000, 1000);
+    stream_Delete (s);
+    log ("seek: %u connections\n", connections ());
+}
+
+static void test_stale (vlc_object_t *obj, const char *url)
+{
+    stream_t *hold = stream_UrlNew (obj, url);
+    assert (hold != NULL);
+    pool_connection (obj, url);
+
+    /* The pooled connection was closed by the server */
+    server_drop ();
+    wait_closed ();
+
+    unsigned n = connections ();
+    stream_t *s = stream_UrlNew (obj, url);
+    assert (s != NULL);
+    check_read (s, data, SIZE, 0, 1000);
+    assert (connections () == n + 1);
+    stream_Delete (s);
+    stream_Delete (hold);
+}
+
+static void test_pipeline (vlc_object_t *obj, const char *url)
+{
+    unsigned n = requests (true);
+
+    var_Create (obj, "http-pipeline", VLC_VAR_BOOL);
+    var_SetBool (obj, "http-pipeline", true);
+    vlc_mutex_lock (&server.lock);
+    server.hold = true;
+    vlc_mutex_unlock (&server.lock);
+
+    /* Ranges are only requested on a connection known to be persistent */
+    stream_t *hold = stream_UrlNew (obj, url);
+    assert (hold != NULL);
+    pool_connection (obj, url);
+
+    stream_t *s = stream_UrlNew (obj, url);
+    assert (s != NULL);
+    read_all (s);
+    stream_Delete (s);
+    stream_Delete (hold);
+    n = requests (true) - n;
+    log ("pipeline: %u pipelined requests\n", n);
+    assert (n > 0);
+
+    var_Destroy (obj, "http-pipeline");
+}
+
+int main (void)
+{
+    char *url;
+
+    test_init ();
+
+    data = malloc (SIZE);
+    assert (data != NULL);
+    for (size_t i = 0; i < SIZE; i++)
+        data[i] = rand ();
+
+    unsigned port = server_start ();
+    assert (asprintf (&url, "http://127.0.0.1:%u/file", port) != -1);
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    test_sequential (obj, url);
+    test_seek (obj, url);
+    test_stale (obj, url);
+    test_pipeline (obj, url);
+
+    libvlc_release (vlc);
+    server_stop ();
+    free (url);
+    free (data);
+    return 0;
+}
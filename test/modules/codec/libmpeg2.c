@@ -0,0 +1,167 @@
+/*****************************************************************************
+ * libmpeg2.c: test for the slice threads of the libmpeg2 decoder
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_codec.h>
+#include <vlc_modules.h>
+#include "mpgv.h"
+
+/* Many slice rows, so that each thread gets a few */
+#define WIDTH   176
+#define HEIGHT  576
+#define FRAMES  20
+
+static picture_t *new_picture (decoder_t *dec)
+{
+    dec->fmt_out.video.i_chroma = dec->fmt_out.i_codec;
+    return picture_NewFromFormat (&dec->fmt_out.video);
+}
+
+static void del_picture (decoder_t *dec, picture_t *pic)
+{
+    (void) dec;
+    picture_Release (pic);
+}
+
+static void link_picture (decoder_t *dec, picture_t *pic)
+{
+    (void) dec;
+    picture_Hold (pic);
+}
+
+/* Appends the visible lines of all the planes of a picture */
+static void append (uint8_t **out, size_t *len, const picture_t *pic)
+{
+    for (int i = 0; i < pic->i_planes; i++)
+    {
+        const plane_t *p = &pic->p[i];
+
+        *out = realloc (*out, *len + p->i_visible_lines * p->i_visible_pitch);
+        assert (*out != NULL);
+        for (int y = 0; y < p->i_visible_lines; y++)
+        {
+            memcpy (*out + *len, p->p_pixels + y * p->i_pitch,
+                    p->i_visible_pitch);
+            *len += p->i_visible_pitch;
+        }
+    }
+}
+
+/**
+ * Decodes the stream with the given number of threads. Returns the decoded
+ * pictures one after the other, or NULL if libmpeg2 is not available.
+ */
+static uint8_t *decode (vlc_object_t *obj, const uint8_t *data,
+                        const size_t *offsets, int threads, size_t *len,
+                        unsigned *count)
+{
+    decoder_t *dec = vlc_object_create (obj, sizeof (*dec));
+    uint8_t *out = NULL;
+
+    assert (dec != NULL);
+    es_format_Init (&dec->fmt_in, VIDEO_ES, VLC_CODEC_MPGV);
+    es_format_Init (&dec->fmt_out, UNKNOWN_ES, 0);
+    var_Create (dec, "libmpeg2-threads", VLC_VAR_INTEGER);
+    var_SetInteger (dec, "libmpeg2-threads", threads);
+    dec->pf_vout_buffer_new = new_picture;
+    dec->pf_vout_buffer_del = del_picture;
+    dec->pf_picture_link = link_picture;
+    dec->pf_picture_unlink = del_picture;
+    dec->b_pace_control = true; /* no frame dropping */
+    dec->p_module = module_need (dec, "decoder", "libmpeg2", true);
+    if (dec->p_module == NULL)
+        goto out;
+
+    *len = 0;
+    *count = 0;
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        size_t size = offsets[i + 1] - offsets[i];
+        block_t *block = block_Alloc (size);
+        picture_t *pic;
+
+        assert (block != NULL);
+        memcpy (block->p_buffer, data + offsets[i], size);
+        block->i_pts = block->i_dts = VLC_TS_0 + i * CLOCK_FREQ / 25;
+        while ((pic = dec->pf_decode_video (dec, &block)) != NULL)
+        {
+            append (&out, len, pic);
+            picture_Release (pic);
+            (*count)++;
+        }
+    }
+    module_unneed (dec, dec->p_module);
+    assert (out != NULL);
+out:
+    es_format_Clean (&dec->fmt_in);
+    es_format_Clean (&dec->fmt_out);
+    vlc_object_release (dec);
+    return out;
+}
+
+int main (void)
+{
+    size_t offsets[FRAMES + 1];
+
+    test_init ();
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    uint8_t *data = mpgv_generate (WIDTH, HEIGHT, FRAMES, 0x2545F491,
+                                   offsets);
+
+    size_t len, ref_len;
+    unsigned count, ref_count;
+    uint8_t *ref = decode (obj, data, offsets, 1, &ref_len, &ref_count);
+    if (ref == NULL)
+    {
+        log ("libmpeg2 not available, skipping\n");
+        free (data);
+        libvlc_release (vlc);
+        return 77;
+    }
+    log ("%u pictures decoded serially\n", ref_count);
+    assert (ref_count > 0);
+
+    /* The slice threads decode the same pictures, to the same pixels */
+    for (int threads = 2; threads <= 4; threads++)
+    {
+        uint8_t *out = decode (obj, data, offsets, threads, &len, &count);
+
+        log ("%u pictures decoded with %d threads\n", count, threads);
+        assert (out != NULL);
+        assert (count == ref_count && len == ref_len);
+        assert (!memcmp (out, ref, len));
+        free (out);
+    }
+
+    free (ref);
+    free (data);
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*****************************************************************************
+ * mpgv.h: generator of MPEG-1 intra video streams
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t   len, size;
+    uint32_t acc;
+    unsigned bits;
+} mpgv_bitstream_t;
+
+static inline void mpgv_put_bits (mpgv_bitstream_t *bs, uint32_t value,
+                                  unsigned n)
+{
+    while (n-- > 0)
+    {
+        bs->acc = (bs->acc << 1) | ((value >> n) & 1);
+        if (++bs->bits < 8)
+            continue;
+        if (bs->len == bs->size)
+        {
+            bs->size = bs->size ? 2 * bs->size : 65536;
+            bs->buf = realloc (bs->buf, bs->size);
+            assert (bs->buf != NULL);
+        }
+        bs->buf[bs->len++] = bs->acc;
+        bs->acc = bs->bits = 0;
+    }
+}
+
+static inline void mpgv_put_start_code (mpgv_bitstream_t *bs, uint8_t code)
+{
+    if (bs->bits > 0)
+        mpgv_put_bits (bs, 0, 8 - bs->bits);
+    mpgv_put_bits (bs, 0x000001, 24);
+    mpgv_put_bits (bs, code, 8);
+}
+
+/**
+ * Generates 25 Hz MPEG-1 intra pictures, with 8 AC coefficients of random
+ * signs per block, from a non-zero seed. Returns the stream, with the
+ * offset of each picture and of the end in offsets[0..frames].
+ */
+static inline uint8_t *mpgv_generate (unsigned width, unsigned height,
+                                      unsigned frames, uint32_t seed,
+                                      size_t *offsets)
+{
+    mpgv_bitstream_t bs = { NULL, 0, 0, 0, 0 };
+
+    mpgv_put_start_code (&bs, 0xB3); /* sequence header */
+    mpgv_put_bits (&bs, width, 12);
+    mpgv_put_bits (&bs, height, 12);
+    mpgv_put_bits (&bs, 1, 4); /* square pixels */
+    mpgv_put_bits (&bs, 3, 4); /* 25 Hz */
+    mpgv_put_bits (&bs, 0x3FFFF, 18); /* variable bit rate */
+    mpgv_put_bits (&bs, 1, 1);
+    mpgv_put_bits (&bs, 20, 10); /* VBV buffer size */
+    mpgv_put_bits (&bs, 0, 3); /* no constraints nor matrices */
+    mpgv_put_start_code (&bs, 0xB8); /* closed GOP */
+    mpgv_put_bits (&bs, 1 << 12, 25);
+    mpgv_put_bits (&bs, 1 << 6, 7);
+
+    for (unsigned i = 0; i < frames; i++)
+    {
+        offsets[i] = i ? bs.len : 0;
+        mpgv_put_start_code (&bs, 0x00); /* I picture */
+        mpgv_put_bits (&bs, i % 1024, 10);
+        mpgv_put_bits (&bs, 1, 3);
+        mpgv_put_bits (&bs, 0xFFFF, 16);
+        mpgv_put_bits (&bs, 0, 1);
+
+        for (unsigned row = 0; row < (height + 15) / 16; row++)
+        {
+            mpgv_put_start_code (&bs, 1 + row);
+            mpgv_put_bits (&bs, 8 << 1, 6); /* quantizer scale 8 */
+            for (unsigned col = 0; col < (width + 15) / 16; col++)
+            {
+                mpgv_put_bits (&bs, 3, 2); /* next macroblock, intra */
+                for (unsigned b = 0; b < 6; b++)
+                {
+                    /* DC difference 0, then run 0 level +/-1 codes */
+                    mpgv_put_bits (&bs, b < 4 ? 4 : 0, b < 4 ? 3 : 2);
+                    for (unsigned c = 0; c < 8; c++)
+                    {
+                        seed ^= seed << 13;
+                        seed ^= seed >> 17;
+                        seed ^= seed << 5;
+                        mpgv_put_bits (&bs, 6 | (seed >> 31), 3);
+                    }
+                    mpgv_put_bits (&bs, 2, 2); /* end of block */
+                }
+            }
+        }
+    }
+    mpgv_put_start_code (&bs, 0xB7); /* sequence end */
+    offsets[frames] = bs.len;
+    return bs.buf;
+}
@@ -0,0 +1,287 @@
+/*****************************************************************************
+ * avi.c: test for the AVI index created in the background
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_input.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Motion JPEG at 25 frames per second, without idx1 */
+#define FRAME      4000
+#define FRAMES     1500
+#define FRAME_RATE 25
+#define SIZE       (FRAME * FRAMES)
+
+static uint8_t *data;
+
+static uint8_t *put32 (uint8_t *p, uint32_t v)
+{
+    SetDWLE (p, v);
+    return p + 4;
+}
+
+static uint8_t *put16 (uint8_t *p, uint16_t v)
+{
+    SetWLE (p, v);
+    return p + 2;
+}
+
+static uint8_t *putfcc (uint8_t *p, const char *fcc)
+{
+    memcpy (p, fcc, 4);
+    return p + 4;
+}
+
+static void write_avi (const char *path)
+{
+    uint8_t head[12 + 12 + 8 + 56 + 12 + 8 + 56 + 8 + 40 + 12];
+    uint8_t *p = head;
+
+    p = putfcc (p, "RIFF");
+    p = put32 (p, sizeof (head) - 8 + FRAMES * (8 + FRAME));
+    p = putfcc (p, "AVI ");
+
+    p = putfcc (p, "LIST");
+    p = put32 (p, 4 + 8 + 56 + 12 + 8 + 56 + 8 + 40);
+    p = putfcc (p, "hdrl");
+    p = putfcc (p, "avih");
+    p = put32 (p, 56);
+    p = put32 (p, CLOCK_FREQ / FRAME_RATE);
+    p = put32 (p, FRAME * FRAME_RATE);
+    p = put32 (p, 0);
+    p = put32 (p, 0); /* no index */
+    p = put32 (p, FRAMES);
+    p = put32 (p, 0);
+    p = put32 (p, 1);
+    p = put32 (p, FRAME);
+    p = put32 (p, 320);
+    p = put32 (p, 240);
+    memset (p, 0, 16);
+    p += 16;
+
+    p = putfcc (p, "LIST");
+    p = put32 (p, 4 + 8 + 56 + 8 + 40);
+    p = putfcc (p, "strl");
+    p = putfcc (p, "strh");
+    p = put32 (p, 56);
+    p = putfcc (p, "vids");
+    p = putfcc (p, "MJPG");
+    p = put32 (p, 0);
+    p = put16 (p, 0);
+    p = put16 (p, 0);
+    p = put32 (p, 0);
+    p = put32 (p, 1);
+    p = put32 (p, FRAME_RATE);
+    p = put32 (p, 0);
+    p = put32 (p, FRAMES);
+    p = put32 (p, FRAME);
+    p = put32 (p, 0);
+    p = put32 (p, 0);
+    memset (p, 0, 8);
+    p += 8;
+    p = putfcc (p, "strf");
+    p = put32 (p, 40);
+    p = put32 (p, 40);
+    p = put32 (p, 320);
+    p = put32 (p, 240);
+    p = put16 (p, 1);
+    p = put16 (p, 24);
+    p = putfcc (p, "MJPG");
+    p = put32 (p, FRAME);
+    memset (p, 0, 16);
+    p += 16;
+
+    p = putfcc (p, "LIST");
+    p = put32 (p, 4 + FRAMES * (8 + FRAME));
+    p = putfcc (p, "movi");
+    assert (p == head + sizeof (head));
+
+    int fd = open (path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    assert (fd != -1);
+    assert (write (fd, head, sizeof (head)) == sizeof (head));
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        uint8_t chunk[8];
+
+        put32 (putfcc (chunk, "00dc"), FRAME);
+        assert (write (fd, chunk, 8) == 8);
+        assert (write (fd, data + i * FRAME, FRAME) == FRAME);
+    }
+    close (fd);
+}
+
+/* Converts a file to its elementary stream */
+static uint8_t *play (vlc_object_t *obj, const char *src, const char *dst,
+                      const char *option, size_t *len)
+{
+    char *url, *sout;
+    struct stat st;
+
+    assert (asprintf (&url, "file://%s", src) != -1);
+    assert (asprintf (&sout, ":sout=#std{access=file,mux=raw,dst=%s}",
+                      dst) != -1);
+    input_item_t *item = input_item_New (url, "test");
+    assert (item != NULL);
+    input_item_AddOption (item, sout, VLC_INPUT_OPTION_TRUSTED);
+    input_item_AddOption (item, ":no-sout-all", VLC_INPUT_OPTION_TRUSTED);
+    if (option != NULL)
+        input_item_AddOption (item, option, VLC_INPUT_OPTION_TRUSTED);
+    assert (input_Read (obj, item) == VLC_SUCCESS);
+    vlc_gc_decref (item);
+    free (sout);
+    free (url);
+
+    int fd = open (dst, O_RDONLY);
+    assert (fd != -1);
+    assert (!fstat (fd, &st));
+    uint8_t *buf = malloc (st.st_size + 1);
+    assert (buf != NULL);
+    assert (read (fd, buf, st.st_size) == st.st_size);
+    close (fd);
+    unlink (dst);
+    *len = st.st_size;
+    return buf;
+}
+
+/* Returns the path of the only cached index */
+static char *cached_index (const char *cache)
+{
+    char *dir, *path = NULL;
+    struct dirent *ent;
+
+    assert (asprintf (&dir, "%s/vlc/avi-index", cache) != -1);
+    DIR *dh = opendir (dir);
+    assert (dh != NULL);
+    while ((ent = readdir (dh)) != NULL)
+    {
+        if (ent->d_name[0] == '.')
+            continue;
+        assert (path == NULL);
+        assert (asprintf (&path, "%s/%s", dir, ent->d_name) != -1);
+    }
+    closedir (dh);
+    free (dir);
+    assert (path != NULL);
+    return path;
+}
+
+int main (void)
+{
+    char base[] = "/tmp/vlc-test-avi-XXXXXX";
+    char src[sizeof (base) + 8], dst[sizeof (base) + 8];
+    struct stat st;
+
+    test_init ();
+
+    assert (mkdtemp (base) != NULL);
+    snprintf (src, sizeof (src), "%s/in.avi", base);
+    snprintf (dst, sizeof (dst), "%s/out.es", base);
+    setenv ("XDG_CACHE_HOME", base, 1);
+
+    data = malloc (SIZE);
+    assert (data != NULL);
+    for (size_t i = 0; i < SIZE; i++)
+        data[i] = rand ();
+    write_avi (src);
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    size_t full, len;
+    uint8_t *buf;
+
+    /* Plays while the index is created: nothing is lost at the switch */
+    buf = play (obj, src, dst, NULL, &full);
+    log ("play: %zu bytes\n", full);
+    assert (full % FRAME == 0);
+    assert (full >= SIZE - 2 * FRAME);
+    assert (!memcmp (buf, data, full));
+    free (buf);
+
+    /* The index was saved */
+    char *index = cached_index (base);
+    assert (!stat (index, &st));
+    log ("index: %s, %lld bytes\n", index, (long long)st.st_size);
+    assert (st.st_size == 8 + 8 + 4 + 4 + FRAMES * 20);
+    struct timespec mtime = st.st_mtim;
+
+    /* And seeks right away with the cached index. The output may begin
+     * with what was read before the start time was applied. */
+    buf = play (obj, src, dst, ":start-time=30", &len);
+    assert (len < full);
+
+    size_t head = 0, skipped;
+    for (;; head += FRAME)
+    {
+        assert (head < len);
+        skipped = full - (len - head);
+        if (!memcmp (buf, data, head)
+         && !memcmp (buf + head, data + skipped, len - head))
+            break;
+    }
+    log ("seek: from byte %zu, after %zu bytes\n", skipped, head);
+    assert (skipped == 30 * FRAME_RATE * FRAME);
+    free (buf);
+
+    assert (!stat (index, &st));
+    assert (st.st_mtim.tv_sec == mtime.tv_sec);
+    assert (st.st_mtim.tv_nsec == mtime.tv_nsec);
+
+    /* Without the cache, the seek does not wait for the index: it fails
+     * while the index is created, and the playback goes on from the start */
+    unlink (index);
+    buf = play (obj, src, dst, ":start-time=30", &len);
+    log ("seek without index: %zu bytes\n", len);
+    if (len == full)
+        assert (!memcmp (buf, data, full));
+    else
+    {   /* the index was already complete */
+        assert (len >= full - 30 * FRAME_RATE * FRAME);
+        assert (!memcmp (buf + len - (full - 30 * FRAME_RATE * FRAME),
+                         data + 30 * FRAME_RATE * FRAME,
+                         full - 30 * FRAME_RATE * FRAME));
+    }
+    free (buf);
+
+    libvlc_release (vlc);
+    unlink (index);
+    free (index);
+    assert (asprintf (&index, "%s/vlc/avi-index", base) != -1);
+    rmdir (index);
+    free (index);
+    assert (asprintf (&index, "%s/vlc", base) != -1);
+    rmdir (index);
+    free (index);
+    unlink (src);
+    rmdir (base);
+    free (data);
+    return 0;
+}
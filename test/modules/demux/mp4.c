@@ -0,0 +1,523 @@
+/*****************************************************************************
+ * mp4.c: test for the MP4 demuxer with fragmented files
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_input.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define RATE      48000
+#define FRAMES    1024                  /* audio frames per sample */
+#define SAMPLE    (FRAMES * 4)          /* stereo, 16-bits */
+#define SAMPLES   12                    /* samples per fragment */
+#define FRAGMENTS 40
+#define SIZE      (SAMPLE * SAMPLES * FRAGMENTS)
+
+static uint8_t *data;
+
+/*** A minimal MP4 writer, fragmented or not ***/
+static struct
+{
+    uint8_t *buf;
+    size_t   len;
+    size_t   stack[8];
+    unsigned depth;
+} file;
+
+static void put (const void *p, size_t len)
+{
+    memcpy (file.buf + file.len, p, len);
+    file.len += len;
+}
+
+static void put8 (uint8_t v)
+{
+    put (&v, 1);
+}
+
+static void put16 (uint16_t v)
+{
+    put8 (v >> 8);
+    put8 (v);
+}
+
+static void put32 (uint32_t v)
+{
+    put16 (v >> 16);
+    put16 (v);
+}
+
+static void put64 (uint64_t v)
+{
+    put32 (v >> 32);
+    put32 (v);
+}
+
+static void zero (size_t len)
+{
+    memset (file.buf + file.len, 0, len);
+    file.len += len;
+}
+
+static void box (const char *type)
+{
+    file.stack[file.depth++] = file.len;
+    put32 (0);
+    put (type, 4);
+}
+
+static void fullbox (const char *type, uint8_t version, uint32_t flags)
+{
+    box (type);
+    put32 ((version << 24) | flags);
+}
+
+static void end (void)
+{
+    size_t start = file.stack[--file.depth];
+    uint32_t size = file.len - start;
+
+    file.buf[start] = size >> 24;
+    file.buf[start + 1] = size >> 16;
+    file.buf[start + 2] = size >> 8;
+    file.buf[start + 3] = size;
+}
+
+static void matrix (void)
+{
+    static const uint32_t unity[9] = {
+        0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000 };
+    for (unsigned i = 0; i < 9; i++)
+        put32 (unity[i]);
+}
+
+/* Writes the movie header, with the sample tables of data stored from
+ * the given offset, or for a fragmented file if the offset is zero */
+static void write_moov (uint64_t offset)
+{
+    box ("moov");
+    fullbox ("mvhd", 0, 0);
+    zero (8);
+    put32 (1000); /* timescale */
+    put32 (0); /* duration */
+    put32 (0x10000);
+    put16 (0x100);
+    zero (10);
+    matrix ();
+    zero (24);
+    put32 (2);
+    end ();
+
+    box ("trak");
+    fullbox ("tkhd", 0, 7);
+    zero (8);
+    put32 (1); /* track ID */
+    zero (4 + 4 + 8 + 4);
+    put16 (0x100);
+    zero (2);
+    matrix ();
+    zero (8);
+    end ();
+    box ("mdia");
+    fullbox ("mdhd", 0, 0);
+    zero (8);
+    put32 (RATE);
+    put32 (0);
+    put16 (0x55c4); /* und */
+    zero (2);
+    end ();
+    fullbox ("hdlr", 0, 0);
+    zero (4);
+    put ("soun", 4);
+    zero (12 + 1);
+    end ();
+    box ("minf");
+    fullbox ("smhd", 0, 0);
+    zero (4);
+    end ();
+    box ("stbl");
+    fullbox ("stsd", 0, 0);
+    put32 (1);
+    box ("sowt");
+    zero (6);
+    put16 (1); /* data reference index */
+    zero (8);
+    put16 (2); /* channels */
+    put16 (16);
+    zero (4);
+    put32 (RATE << 16);
+    end ();
+    end ();
+    if (offset == 0)
+    {
+        fullbox ("stts", 0, 0); put32 (0); end ();
+        fullbox ("stsc", 0, 0); put32 (0); end ();
+        fullbox ("stsz", 0, 0); put32 (0); put32 (0); end ();
+        fullbox ("stco", 0, 0); put32 (0); end ();
+    }
+    else
+    {   /* Timing tables in several runs, one chunk per fragment */
+        const unsigned samples = SAMPLES * FRAGMENTS;
+
+        fullbox ("stts", 0, 0);
+        put32 (3);
+        put32 (7); put32 (FRAMES);
+        put32 (100); put32 (FRAMES);
+        put32 (samples - 107); put32 (FRAMES);
+        end ();
+        fullbox ("ctts", 0, 0);
+        put32 (samples / 5);
+        for (unsigned i = 0; i < samples / 5; i++)
+        {
+            put32 (5);
+            put32 (0);
+        }
+        end ();
+        fullbox ("stsc", 0, 0);
+        put32 (1);
+        put32 (1); put32 (SAMPLES); put32 (1);
+        end ();
+        fullbox ("stsz", 0, 0);
+        put32 (0);
+        put32 (samples);
+        for (unsigned i = 0; i < samples; i++)
+            put32 (SAMPLE);
+        end ();
+        fullbox ("stco", 0, 0);
+        put32 (FRAGMENTS);
+        for (unsigned i = 0; i < FRAGMENTS; i++)
+            put32 (offset + i * SAMPLES * SAMPLE);
+        end ();
+    }
+    end (); /* stbl */
+    end (); /* minf */
+    end (); /* mdia */
+    end (); /* trak */
+
+    if (offset == 0)
+    {
+        box ("mvex");
+        fullbox ("trex", 0, 0);
+        put32 (1);
+        put32 (1);
+        zero (12);
+        end ();
+        end ();
+    }
+    end (); /* moov */
+}
+
+enum { INDEX_NONE, INDEX_MFRA, INDEX_SIDX, INDEX_MOOV };
+
+/* Writes the whole file, returns its size */
+static size_t write_file (int index)
+{
+    const size_t fragment = 8 + 16 + 8 + 20 + 20 + 20 + 4 * SAMPLES;
+    uint64_t moofs[FRAGMENTS];
+
+    file.buf = malloc (SIZE + FRAGMENTS * (fragment + 8) + 65536);
+    assert (file.buf != NULL);
+    file.len = 0;
+
+    box ("ftyp");
+    put ("iso6", 4);
+    put32 (0);
+    put ("iso6isom", 8);
+    end ();
+
+    if (index == INDEX_MOOV)
+    {   /* Not fragmented, the movie header after the data */
+        box ("mdat");
+        size_t offset = file.len;
+        put (data, SIZE);
+        end ();
+        write_moov (offset);
+        return file.len;
+    }
+    write_moov (0);
+
+    if (index == INDEX_SIDX)
+    {
+        fullbox ("sidx", 1, 0);
+        put32 (1);
+        put32 (RATE);
+        put64 (0);
+        put64 (0);
+        put16 (0);
+        put16 (FRAGMENTS);
+        for (unsigned i = 0; i < FRAGMENTS; i++)
+        {
+            put32 (fragment + 8 + SAMPLE * SAMPLES);
+            put32 (FRAMES * SAMPLES);
+            put32 (0x90000000);
+        }
+        end ();
+    }
+
+    for (unsigned i = 0; i < FRAGMENTS; i++)
+    {
+        moofs[i] = file.len;
+        box ("moof");
+        fullbox ("mfhd", 0, 0);
+        put32 (i + 1);
+        end ();
+        box ("traf");
+        /* default-base-is-moof, default duration */
+        fullbox ("tfhd", 0, 0x20008);
+        put32 (1);
+        put32 (FRAMES);
+        end ();
+        fullbox ("tfdt", 1, 0);
+        put64 ((uint64_t)i * SAMPLES * FRAMES);
+        end ();
+        /* data offset, sample sizes */
+        fullbox ("trun", 0, 0x201);
+        put32 (SAMPLES);
+        put32 (fragment + 8);
+        for (unsigned j = 0; j < SAMPLES; j++)
+            put32 (SAMPLE);
+        end ();
+        end (); /* traf */
+        end (); /* moof */
+        assert (file.len - moofs[i] == fragment);
+
+        box ("mdat");
+        put (data + i * SAMPLES * SAMPLE, SAMPLES * SAMPLE);
+        end ();
+    }
+
+    if (index == INDEX_MFRA)
+    {
+        size_t start = file.len;
+
+        box ("mfra");
+        fullbox ("tfra", 1, 0);
+        put32 (1);
+        put32 (0); /* 1 byte traf, trun and sample numbers */
+        put32 (FRAGMENTS);
+        for (unsigned i = 0; i < FRAGMENTS; i++)
+        {
+            put64 ((uint64_t)i * SAMPLES * FRAMES);
+            put64 (moofs[i]);
+            put8 (1);
+            put8 (1);
+            put8 (1);
+        }
+        end ();
+        fullbox ("mfro", 0, 0);
+        put32 (file.len - start + 4);
+        end ();
+        end ();
+    }
+    return file.len;
+}
+
+/*** Output, through the memory stream output ***/
+static struct
+{
+    uint8_t *buf;
+    size_t   len;
+    mtime_t  first_pts;
+    unsigned blocks;
+    bool     seeking;
+} out;
+
+static void prerender (void *opaque, uint8_t **pp_buf, unsigned size)
+{
+    (void) opaque;
+    assert (out.len + size <= SIZE);
+    *pp_buf = out.buf + out.len;
+}
+
+static void postrender (void *opaque, uint8_t *buf, unsigned channels,
+                        unsigned rate, unsigned samples, unsigned bits,
+                        unsigned size, mtime_t pts)
+{
+    (void) opaque; (void) buf; (void) samples;
+    assert (channels == 2 && rate == RATE && bits == 16);
+
+    /* Timestamps follow the data */
+    if (out.blocks++ > 0
+     && llabs (pts - out.first_pts -
+               (mtime_t)(out.len / 4) * CLOCK_FREQ / RATE) >= 1000)
+    {   /* The start time is reached once the input has begun, so the
+         * output restarts from the seek target (maybe after a stale block
+         * flushed out of the buffering). */
+        assert (out.seeking);
+        memmove (out.buf, buf, size);
+        out.len = 0;
+        out.blocks = 1;
+    }
+    if (out.blocks == 1)
+        out.first_pts = pts;
+    out.len += size;
+}
+
+static void play (vlc_object_t *obj, const char *url, const char *option)
+{
+    char *sout;
+
+    input_item_t *item = input_item_New (url, "test");
+    assert (item != NULL);
+    assert (asprintf (&sout, ":sout=#smem{no-time-sync,"
+                      "audio-prerender-callback=%"PRIdPTR","
+                      "audio-postrender-callback=%"PRIdPTR"}",
+                      (intptr_t)prerender, (intptr_t)postrender) != -1);
+    input_item_AddOption (item, sout, VLC_INPUT_OPTION_TRUSTED);
+    input_item_AddOption (item, ":no-sout-all", VLC_INPUT_OPTION_TRUSTED);
+    if (option != NULL)
+        input_item_AddOption (item, option, VLC_INPUT_OPTION_TRUSTED);
+    free (sout);
+
+    out.len = 0;
+    out.blocks = 0;
+    out.seeking = option != NULL;
+    assert (input_Read (obj, item) == VLC_SUCCESS);
+    vlc_gc_decref (item);
+}
+
+/* All the samples came out, but maybe the last one held by the packetizer */
+static void check_all (const char *name)
+{
+    log ("%s: %zu bytes in %u blocks\n", name, out.len, out.blocks);
+    assert (out.len >= SIZE - SAMPLE);
+    assert (!memcmp (out.buf, data, out.len));
+}
+
+static void test_file (vlc_object_t *obj, const char *path, int index,
+                       const char *name)
+{
+    char *url;
+    size_t size = write_file (index);
+
+    int fd = open (path, O_WRONLY | O_TRUNC);
+    assert (fd != -1);
+    assert (write (fd, file.buf, size) == (ssize_t)size);
+    close (fd);
+    free (file.buf);
+    assert (asprintf (&url, "file://%s", path) != -1);
+
+    play (obj, url, NULL);
+    check_all (name);
+
+    if (index != INDEX_NONE)
+    {
+        /* Starts from the fragment including the start time */
+        const mtime_t start = 5 * CLOCK_FREQ;
+        const size_t fragment = SAMPLES * SAMPLE;
+        const size_t pos = (start * RATE / CLOCK_FREQ) * 4;
+
+        play (obj, url, ":start-time=5");
+        log ("%s seek: %zu bytes\n", name, out.len);
+        assert (out.len > 0 && out.len < SIZE - SAMPLE);
+
+        size_t skipped = SIZE - out.len;
+        if (memcmp (out.buf, data + skipped, out.len))
+            skipped -= SAMPLE;
+        assert (!memcmp (out.buf, data + skipped, out.len));
+        assert (skipped >= pos / fragment * fragment && skipped <= pos);
+    }
+    free (url);
+}
+
+static void *writer (void *path)
+{
+    int fd = open (path, O_WRONLY);
+    assert (fd != -1);
+
+    for (size_t pos = 0; pos < file.len;)
+    {
+        ssize_t val = write (fd, file.buf + pos, file.len - pos);
+        assert (val > 0);
+        pos += val;
+    }
+    close (fd);
+    return NULL;
+}
+
+/* Non-seekable input, as from a live source */
+static void test_fifo (vlc_object_t *obj, const char *path)
+{
+    char *url;
+    vlc_thread_t th;
+
+    if (mkfifo (path, 0600))
+    {
+        log ("cannot create FIFO\n");
+        return;
+    }
+    write_file (INDEX_NONE);
+    assert (asprintf (&url, "file://%s", path) != -1);
+    assert (!vlc_clone (&th, writer, (void *)path, VLC_THREAD_PRIORITY_LOW));
+
+    play (obj, url, NULL);
+    check_all ("fifo");
+
+    vlc_join (th, NULL);
+    unlink (path);
+    free (file.buf);
+    free (url);
+}
+
+int main (void)
+{
+    char path[] = "/tmp/vlc-test-mp4-XXXXXX";
+    char fifo[sizeof (path) + 5];
+
+    test_init ();
+
+    data = malloc (SIZE);
+    out.buf = malloc (SIZE);
+    assert (data != NULL && out.buf != NULL);
+    for (size_t i = 0; i < SIZE; i++)
+        data[i] = rand ();
+
+    int fd = mkstemp (path);
+    assert (fd != -1);
+    close (fd);
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    test_file (obj, path, INDEX_NONE, "plain");
+    test_file (obj, path, INDEX_MFRA, "mfra");
+    test_file (obj, path, INDEX_SIDX, "sidx");
+    test_file (obj, path, INDEX_MOOV, "moov");
+    unlink (path);
+
+    snprintf (fifo, sizeof (fifo), "%s.fifo", path);
+    test_fifo (obj, fifo);
+
+    libvlc_release (vlc);
+    free (out.buf);
+    free (data);
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*****************************************************************************
+ * mp4.c: test for the fragmented MP4 muxer
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_input.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* MPEG-1 layer III, 128 kb/s, 48 kHz, stereo: 384 bytes and 24 ms frames */
+#define FRAME      384
+#define FRAME_TIME 24000
+#define FRAMES     600
+#define SIZE       (FRAME * FRAMES)
+
+static uint8_t *data;
+
+static uint32_t get32 (const uint8_t *p)
+{
+    return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/* Converts a file with the given muxer */
+static void remux (vlc_object_t *obj, const char *src, const char *mux,
+                   const char *dst, const char *option)
+{
+    char *url, *sout;
+
+    assert (asprintf (&url, "file://%s", src) != -1);
+    assert (asprintf (&sout, ":sout=#std{access=file,mux=%s,dst=%s}",
+                      mux, dst) != -1);
+    input_item_t *item = input_item_New (url, "test");
+    assert (item != NULL);
+    input_item_AddOption (item, sout, VLC_INPUT_OPTION_TRUSTED);
+    input_item_AddOption (item, ":no-sout-all", VLC_INPUT_OPTION_TRUSTED);
+    if (option != NULL)
+        input_item_AddOption (item, option, VLC_INPUT_OPTION_TRUSTED);
+    assert (input_Read (obj, item) == VLC_SUCCESS);
+    vlc_gc_decref (item);
+    free (sout);
+    free (url);
+}
+
+static uint8_t *load (const char *path, size_t *len)
+{
+    struct stat st;
+
+    int fd = open (path, O_RDONLY);
+    assert (fd != -1);
+    assert (!fstat (fd, &st));
+    uint8_t *buf = malloc (st.st_size);
+    assert (buf != NULL);
+    assert (read (fd, buf, st.st_size) == st.st_size);
+    close (fd);
+    *len = st.st_size;
+    return buf;
+}
+
+/* The movie header comes first, then a moof and mdat per fragment, then
+ * the index. The samples are stored in order. */
+static void check_file (const char *path)
+{
+    unsigned fragments = 0;
+    size_t size, len = 0;
+    uint8_t *buf = load (path, &size);
+
+    const uint8_t *end = buf + size;
+    const uint8_t *p = buf;
+
+    assert (!memcmp (p + 4, "ftyp", 4));
+    p += get32 (p);
+    assert (!memcmp (p + 4, "moov", 4));
+    assert (memmem (p, get32 (p), "mvex", 4) != NULL);
+    p += get32 (p);
+
+    while (p < end && !memcmp (p + 4, "moof", 4))
+    {
+        p += get32 (p);
+        assert (!memcmp (p + 4, "mdat", 4));
+        assert (!memcmp (p + 8, data + len, get32 (p) - 8));
+        len += get32 (p) - 8;
+        p += get32 (p);
+        fragments++;
+    }
+    log ("%u fragments, %zu bytes\n", fragments, len);
+    assert (fragments > 5);
+    /* The last frames stay in the packetizer and in the mux input */
+    assert (len >= SIZE - 4 * FRAME);
+
+    assert (!memcmp (p + 4, "mfra", 4));
+    assert (p + get32 (p) == end);
+    assert (!memcmp (end - 16 + 4, "mfro", 4));
+    assert (get32 (end - 4) == get32 (p));
+    free (buf);
+}
+
+int main (void)
+{
+    char es[] = "/tmp/vlc-test-mux-XXXXXX";
+    char src[sizeof (es) + 4], dst[sizeof (es) + 4], raw[sizeof (es) + 4];
+
+    test_init ();
+
+    data = malloc (SIZE);
+    assert (data != NULL);
+    for (size_t i = 0; i < SIZE; i++)
+        data[i] = rand ();
+    for (size_t i = 0; i < SIZE; i += FRAME)
+        memcpy (data + i, "\xFF\xFB\x94\x00", 4);
+
+    int fd = mkstemp (es);
+    assert (fd != -1);
+    close (fd);
+    unlink (es);
+    snprintf (src, sizeof (src), "%s.mp3", es);
+    snprintf (dst, sizeof (dst), "%s.mp4", es);
+    snprintf (raw, sizeof (raw), "%s.mpa", es);
+
+    fd = open (src, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    assert (fd != -1);
+    assert (write (fd, data, SIZE) == SIZE);
+    close (fd);
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    /* Remux in fragments of 2 seconds */
+    remux (obj, src, "mp4{frag-duration=2000}", dst, NULL);
+    check_file (dst);
+
+    /* The fragments play back (to the elementary stream) */
+    size_t len, full;
+    uint8_t *buf;
+
+    remux (obj, dst, "raw", raw, NULL);
+    buf = load (raw, &full);
+    log ("play: %zu bytes\n", full);
+    assert (full >= SIZE - 5 * FRAME);
+    assert (!memcmp (buf, data, full));
+    free (buf);
+
+    /* And seek from the index, to the start of a fragment: the output
+     * may begin with what was read before the start time was applied */
+    remux (obj, dst, "raw", raw, ":start-time=6");
+    buf = load (raw, &len);
+    assert (len < full);
+
+    size_t head = 0, skipped;
+    for (;; head += FRAME)
+    {
+        assert (head < len);
+        skipped = full - (len - head);
+        if (!memcmp (buf, data, head)
+         && !memcmp (buf + head, data + skipped, len - head))
+            break;
+    }
+    log ("seek: from byte %zu, after %zu bytes\n", skipped, head);
+    assert (skipped % FRAME == 0);
+    assert (skipped > 0 && skipped <= 6 * CLOCK_FREQ / FRAME_TIME * FRAME);
+    free (buf);
+
+    /* Not fragmented, for comparison */
+    remux (obj, src, "mp4", dst, NULL);
+    remux (obj, dst, "raw", raw, NULL);
+    buf = load (raw, &len);
+    assert (len == full);
+    assert (!memcmp (buf, data, len));
+    free (buf);
+    unlink (raw);
+
+    unlink (src);
+    unlink (dst);
+    libvlc_release (vlc);
+    free (data);
+    return 0;
+}
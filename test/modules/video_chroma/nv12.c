@@ -0,0 +1,185 @@
+/*****************************************************************************
+ * nv12.c: bit-exactness and throughput test for the NV12 conversions
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+
+#define RUNS 200
+
+static picture_t *NewPicture (filter_t *filter)
+{
+    return picture_NewFromFormat (&filter->fmt_out.video);
+}
+
+static filter_t *chroma_create (vlc_object_t *obj, vlc_fourcc_t src,
+                                vlc_fourcc_t dst, unsigned w, unsigned h)
+{
+    filter_t *filter = vlc_object_create (obj, sizeof (*filter));
+    assert (filter != NULL);
+
+    es_format_Init (&filter->fmt_in, VIDEO_ES, src);
+    video_format_Setup (&filter->fmt_in.video, src, w, h, 1, 1);
+    es_format_Init (&filter->fmt_out, VIDEO_ES, dst);
+    video_format_Setup (&filter->fmt_out.video, dst, w, h, 1, 1);
+    filter->pf_video_buffer_new = NewPicture;
+
+    filter->p_module = module_need (filter, "video filter2", "i420_nv12",
+                                    true);
+    assert (filter->p_module != NULL);
+    return filter;
+}
+
+static void chroma_delete (filter_t *filter)
+{
+    module_unneed (filter, filter->p_module);
+    es_format_Clean (&filter->fmt_in);
+    es_format_Clean (&filter->fmt_out);
+    vlc_object_release (filter);
+}
+
+static picture_t *convert (filter_t *filter, picture_t *pic)
+{
+    picture_Hold (pic);
+    pic = filter->pf_video_filter (filter, pic);
+    assert (pic != NULL);
+    return pic;
+}
+
+static picture_t *random_picture (vlc_fourcc_t chroma, unsigned w, unsigned h)
+{
+    video_format_t fmt;
+
+    video_format_Setup (&fmt, chroma, w, h, 1, 1);
+    picture_t *pic = picture_NewFromFormat (&fmt);
+    assert (pic != NULL);
+    for (int i = 0; i < pic->i_planes; i++)
+        for (int j = 0; j < pic->p[i].i_lines * pic->p[i].i_pitch; j++)
+            pic->p[i].p_pixels[j] = rand ();
+    return pic;
+}
+
+/* Returns the pixel (x, y) of the U (c = 0) or V (c = 1) component */
+static uint8_t chroma_pixel (const picture_t *pic, vlc_fourcc_t chroma,
+                             unsigned c, unsigned x, unsigned y)
+{
+    switch (chroma)
+    {
+        case VLC_CODEC_NV12:
+            return pic->p[1].p_pixels[y * pic->p[1].i_pitch + 2 * x + c];
+        case VLC_CODEC_YV12:
+            c = 1 - c;
+            /* fall through */
+        default:
+            return pic->p[1 + c].p_pixels[y * pic->p[1 + c].i_pitch + x];
+    }
+}
+
+static void compare (const picture_t *a, vlc_fourcc_t chroma_a,
+                     const picture_t *b, vlc_fourcc_t chroma_b,
+                     unsigned w, unsigned h)
+{
+    for (unsigned y = 0; y < h; y++)
+        assert (!memcmp (a->p[0].p_pixels + y * a->p[0].i_pitch,
+                         b->p[0].p_pixels + y * b->p[0].i_pitch, w));
+    for (unsigned c = 0; c < 2; c++)
+        for (unsigned y = 0; y < h / 2; y++)
+            for (unsigned x = 0; x < w / 2; x++)
+                assert (chroma_pixel (a, chroma_a, c, x, y)
+                     == chroma_pixel (b, chroma_b, c, x, y));
+}
+
+/**
+ * Converts a random NV12 picture to a planar format and back, checking both
+ * results against the original pixel for pixel.
+ */
+static void test_exact (vlc_object_t *obj, vlc_fourcc_t planar,
+                        unsigned w, unsigned h)
+{
+    filter_t *to = chroma_create (obj, VLC_CODEC_NV12, planar, w, h);
+    filter_t *from = chroma_create (obj, planar, VLC_CODEC_NV12, w, h);
+    picture_t *src = random_picture (VLC_CODEC_NV12, w, h);
+
+    picture_t *tmp = convert (to, src);
+    compare (src, VLC_CODEC_NV12, tmp, planar, w, h);
+    picture_t *dst = convert (from, tmp);
+    compare (src, VLC_CODEC_NV12, dst, VLC_CODEC_NV12, w, h);
+
+    picture_Release (dst);
+    picture_Release (tmp);
+    picture_Release (src);
+    chroma_delete (from);
+    chroma_delete (to);
+}
+
+static void bench (vlc_object_t *obj, vlc_fourcc_t src_chroma,
+                   vlc_fourcc_t dst_chroma, unsigned w, unsigned h)
+{
+    filter_t *filter = chroma_create (obj, src_chroma, dst_chroma, w, h);
+    picture_t *src = random_picture (src_chroma, w, h);
+
+    mtime_t start = mdate ();
+    for (unsigned i = 0; i < RUNS; i++)
+        picture_Release (convert (filter, src));
+    mtime_t elapsed = mdate () - start;
+    if (elapsed <= 0)
+        elapsed = 1;
+
+    log ("%4.4s -> %4.4s, %ux%u: %.1f frames/s, %.1f MB/s\n",
+         (const char *)&src_chroma, (const char *)&dst_chroma, w, h,
+         RUNS * 1e6 / elapsed, RUNS * 1.5 * w * h / elapsed);
+    picture_Release (src);
+    chroma_delete (filter);
+}
+
+int main (void)
+{
+    static const unsigned sizes[][2] = {
+        { 1920, 1080 }, { 1280, 720 }, { 720, 576 }, { 130, 66 }, { 34, 18 },
+        { 2, 2 },
+    };
+
+    test_init ();
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    for (unsigned i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+        log ("Checking %ux%u\n", sizes[i][0], sizes[i][1]);
+        test_exact (obj, VLC_CODEC_I420, sizes[i][0], sizes[i][1]);
+        test_exact (obj, VLC_CODEC_YV12, sizes[i][0], sizes[i][1]);
+    }
+
+    bench (obj, VLC_CODEC_NV12, VLC_CODEC_I420, 1920, 1080);
+    bench (obj, VLC_CODEC_I420, VLC_CODEC_NV12, 1920, 1080);
+
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*****************************************************************************
+ * packed.c: test for the packed 4:2:2 to planar YUV converters
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+
+#define RUNS 200
+
+static picture_t *NewPicture (filter_t *filter)
+{
+    return picture_NewFromFormat (&filter->fmt_out.video);
+}
+
+static filter_t *chroma_create (vlc_object_t *obj, const char *name,
+                                vlc_fourcc_t src, vlc_fourcc_t dst,
+                                unsigned w, unsigned h)
+{
+    filter_t *filter = vlc_object_create (obj, sizeof (*filter));
+    assert (filter != NULL);
+
+    es_format_Init (&filter->fmt_in, VIDEO_ES, src);
+    video_format_Setup (&filter->fmt_in.video, src, w, h, 1, 1);
+    es_format_Init (&filter->fmt_out, VIDEO_ES, dst);
+    video_format_Setup (&filter->fmt_out.video, dst, w, h, 1, 1);
+    filter->pf_video_buffer_new = NewPicture;
+
+    filter->p_module = module_need (filter, "video filter2", name, true);
+    assert (filter->p_module != NULL);
+    return filter;
+}
+
+static void chroma_delete (filter_t *filter)
+{
+    module_unneed (filter, filter->p_module);
+    es_format_Clean (&filter->fmt_in);
+    es_format_Clean (&filter->fmt_out);
+    vlc_object_release (filter);
+}
+
+static picture_t *convert (filter_t *filter, picture_t *pic)
+{
+    picture_Hold (pic);
+    pic = filter->pf_video_filter (filter, pic);
+    assert (pic != NULL);
+    return pic;
+}
+
+static picture_t *random_picture (vlc_fourcc_t chroma, unsigned w, unsigned h)
+{
+    video_format_t fmt;
+
+    video_format_Setup (&fmt, chroma, w, h, 1, 1);
+    picture_t *pic = picture_NewFromFormat (&fmt);
+    assert (pic != NULL);
+    for (int i = 0; i < pic->i_planes; i++)
+        for (int j = 0; j < pic->p[i].i_lines * pic->p[i].i_pitch; j++)
+            pic->p[i].p_pixels[j] = rand ();
+    return pic;
+}
+
+/* Offsets of Y0, U and V in each 4 bytes group of a packed format */
+static void packed_offsets (vlc_fourcc_t chroma, unsigned *y, unsigned *u,
+                            unsigned *v)
+{
+    switch (chroma)
+    {
+        case VLC_CODEC_YUYV: *y = 0; *u = 1; *v = 3; break;
+        case VLC_CODEC_YVYU: *y = 0; *u = 3; *v = 1; break;
+        case VLC_CODEC_UYVY: *y = 1; *u = 0; *v = 2; break;
+        default: abort ();
+    }
+}
+
+/**
+ * Converts a random packed picture to planar 4:2:2 or 4:2:0, the chroma of
+ * the latter coming from the even lines, and checks every pixel.
+ */
+static void test_exact (vlc_object_t *obj, const char *name,
+                        vlc_fourcc_t packed, vlc_fourcc_t planar,
+                        unsigned w, unsigned h)
+{
+    const unsigned vsub = (planar == VLC_CODEC_I420) ? 2 : 1;
+    filter_t *filter = chroma_create (obj, name, packed, planar, w, h);
+    picture_t *src = random_picture (packed, w, h);
+    picture_t *dst = convert (filter, src);
+    unsigned oy, ou, ov;
+
+    packed_offsets (packed, &oy, &ou, &ov);
+    for (unsigned y = 0; y < h; y++)
+    {
+        const uint8_t *line = src->p[0].p_pixels + y * src->p[0].i_pitch;
+        const uint8_t *dy = dst->p[0].p_pixels + y * dst->p[0].i_pitch;
+        const uint8_t *du = dst->p[1].p_pixels + y / vsub * dst->p[1].i_pitch;
+        const uint8_t *dv = dst->p[2].p_pixels + y / vsub * dst->p[2].i_pitch;
+
+        for (unsigned x = 0; x < w; x++)
+            assert (dy[x] == line[4 * (x / 2) + 2 * (x & 1) + oy]);
+        for (unsigned x = 0; x < w / 2 && y % vsub == 0; x++)
+        {
+            assert (du[x] == line[4 * x + ou]);
+            assert (dv[x] == line[4 * x + ov]);
+        }
+    }
+
+    picture_Release (dst);
+    picture_Release (src);
+    chroma_delete (filter);
+}
+
+static void bench (vlc_object_t *obj, const char *name, vlc_fourcc_t src_chroma,
+                   vlc_fourcc_t dst_chroma, unsigned w, unsigned h)
+{
+    filter_t *filter = chroma_create (obj, name, src_chroma, dst_chroma, w, h);
+    picture_t *src = random_picture (src_chroma, w, h);
+
+    mtime_t start = mdate ();
+    for (unsigned i = 0; i < RUNS; i++)
+        picture_Release (convert (filter, src));
+    mtime_t elapsed = mdate () - start;
+    if (elapsed <= 0)
+        elapsed = 1;
+
+    log ("%4.4s -> %4.4s, %ux%u: %.1f frames/s, %.1f MB/s\n",
+         (const char *)&src_chroma, (const char *)&dst_chroma, w, h,
+         RUNS * 1e6 / elapsed, RUNS * 2. * w * h / elapsed);
+    picture_Release (src);
+    chroma_delete (filter);
+}
+
+int main (void)
+{
+    static const unsigned sizes[][2] = {
+        { 1920, 1080 }, { 720, 576 }, { 1030, 66 }, { 130, 66 }, { 34, 18 },
+        { 2, 2 },
+    };
+    static const vlc_fourcc_t packed[] = {
+        VLC_CODEC_YUYV, VLC_CODEC_YVYU, VLC_CODEC_UYVY,
+    };
+
+    test_init ();
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    for (unsigned i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+        log ("Checking %ux%u\n", sizes[i][0], sizes[i][1]);
+        for (unsigned j = 0; j < sizeof (packed) / sizeof (packed[0]); j++)
+        {
+            test_exact (obj, "yuy2_i420", packed[j], VLC_CODEC_I420,
+                        sizes[i][0], sizes[i][1]);
+            test_exact (obj, "yuy2_i422", packed[j], VLC_CODEC_I422,
+                        sizes[i][0], sizes[i][1]);
+        }
+    }
+
+    bench (obj, "yuy2_i420", VLC_CODEC_YUYV, VLC_CODEC_I420, 1920, 1080);
+    bench (obj, "yuy2_i422", VLC_CODEC_UYVY, VLC_CODEC_I422, 1920, 1080);
+
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*****************************************************************************
+ * converter.c: test for the float to 16-bits integer sample conversion
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+#include <math.h>
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+#include <vlc_cpu.h>
+
+#define SAMPLES 4096
+
+static filter_t *converter_create (vlc_object_t *obj)
+{
+    filter_t *filter = vlc_object_create (obj, sizeof (*filter));
+    assert (filter != NULL);
+
+    es_format_Init (&filter->fmt_in, AUDIO_ES, VLC_CODEC_FL32);
+    filter->fmt_in.audio.i_format = VLC_CODEC_FL32;
+    filter->fmt_in.audio.i_rate = 48000;
+    filter->fmt_in.audio.i_physical_channels =
+    filter->fmt_in.audio.i_original_channels = AOUT_CHANS_STEREO;
+    aout_FormatPrepare (&filter->fmt_in.audio);
+    es_format_Copy (&filter->fmt_out, &filter->fmt_in);
+    filter->fmt_out.i_codec = VLC_CODEC_S16N;
+    filter->fmt_out.audio.i_format = VLC_CODEC_S16N;
+    aout_FormatPrepare (&filter->fmt_out.audio);
+
+    filter->p_module = module_need (filter, "audio filter", "audio_format",
+                                    true);
+    assert (filter->p_module != NULL);
+    return filter;
+}
+
+static void converter_delete (filter_t *filter)
+{
+    module_unneed (filter, filter->p_module);
+    es_format_Clean (&filter->fmt_in);
+    es_format_Clean (&filter->fmt_out);
+    vlc_object_release (filter);
+}
+
+/* Reference conversion: scale, round to nearest even, then clip */
+static int16_t reference (float v)
+{
+    long r = lrintf (v * 32768.f);
+
+    if (r > 32767)
+        return 32767;
+    if (r < -32768)
+        return -32768;
+    return r;
+}
+
+/**
+ * Converts count samples starting offset samples into a block, so that the
+ * vector loop sees both misaligned buffers and a scalar tail.
+ */
+static void test_convert (filter_t *filter, const float *in,
+                          unsigned offset, unsigned count)
+{
+    block_t *block = block_Alloc ((offset + count) * sizeof (float));
+    assert (block != NULL);
+
+    block->p_buffer += offset * sizeof (float);
+    block->i_buffer = count * sizeof (float);
+    block->i_nb_samples = count / 2;
+    memcpy (block->p_buffer, in, count * sizeof (float));
+
+    block = filter->pf_audio_filter (filter, block);
+    assert (block != NULL);
+    assert (block->i_buffer == count * sizeof (int16_t));
+
+    const int16_t *out = (const int16_t *)block->p_buffer;
+    for (unsigned i = 0; i < count; i++)
+        if (out[i] != reference (in[i]))
+        {
+            log ("sample %u: %f -> %d, expected %d\n", i, in[i], out[i],
+                 reference (in[i]));
+            abort ();
+        }
+    block_Release (block);
+}
+
+int main (void)
+{
+    static float in[SAMPLES];
+
+    test_init ();
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    filter_t *filter = converter_create (obj);
+
+    log ("Testing the FL32 to S16N conversion (SSE2 %s)\n",
+         (vlc_CPU () & CPU_CAPABILITY_SSE2) ? "on" : "off");
+
+    /* Rounding halfway values, the clipping bounds and beyond */
+    static const float edges[] = {
+        0.f, -0.f, .5f / 32768, 1.5f / 32768, -.5f / 32768, -1.5f / 32768,
+        32767.f / 32768, 32767.4f / 32768, 32767.5f / 32768, 1.f, 2.f,
+        -1.f, -32768.4f / 32768, -32768.6f / 32768, -2.f, 1e6f, -1e6f,
+    };
+    for (unsigned i = 0; i < SAMPLES; i++)
+        in[i] = edges[i % ARRAY_SIZE(edges)];
+    test_convert (filter, in, 0, SAMPLES);
+
+    /* Noise over a range wider than the output */
+    srand (0);
+    for (unsigned i = 0; i < SAMPLES; i++)
+    {
+        int r = rand ();
+        in[i] = 2.5f * r / RAND_MAX - 1.25f;
+    }
+    for (unsigned offset = 0; offset < 4; offset++)
+        for (unsigned count = 0; count < 40; count++)
+            test_convert (filter, in + offset, offset, count);
+    test_convert (filter, in, 1, SAMPLES - 1);
+
+    converter_delete (filter);
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*****************************************************************************
+ * equalizer.c: response, stability and throughput test for the equalizer
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+#include <math.h>
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+
+#define RATE   48000
+#define FRAMES 1024     /* frames per input block */
+#define BLOCKS 32
+
+static filter_t *equalizer_create (vlc_object_t *obj, uint32_t layout)
+{
+    filter_t *filter = vlc_object_create (obj, sizeof (*filter));
+    assert (filter != NULL);
+
+    es_format_Init (&filter->fmt_in, AUDIO_ES, VLC_CODEC_FL32);
+    filter->fmt_in.audio.i_format = VLC_CODEC_FL32;
+    filter->fmt_in.audio.i_rate = RATE;
+    filter->fmt_in.audio.i_physical_channels =
+    filter->fmt_in.audio.i_original_channels = layout;
+    aout_FormatPrepare (&filter->fmt_in.audio);
+    es_format_Copy (&filter->fmt_out, &filter->fmt_in);
+
+    filter->p_module = module_need (filter, "audio filter", "equalizer",
+                                    true);
+    assert (filter->p_module != NULL);
+    return filter;
+}
+
+static void equalizer_delete (filter_t *filter)
+{
+    module_unneed (filter, filter->p_module);
+    es_format_Clean (&filter->fmt_in);
+    es_format_Clean (&filter->fmt_out);
+    vlc_object_release (filter);
+}
+
+/**
+ * Filters a sine wave on every channel, and returns the gain of the first
+ * channel in dB once the filters have settled.
+ */
+static double gain (filter_t *filter, double freq, unsigned blocks)
+{
+    const unsigned channels = aout_FormatNbChannels (&filter->fmt_in.audio);
+    double in = 0., out = 0.;
+
+    for (unsigned i = 0; i < blocks; i++)
+    {
+        block_t *block = block_Alloc (FRAMES * channels * sizeof (float));
+        assert (block != NULL);
+
+        float *p = (float *)block->p_buffer;
+        for (unsigned j = 0; j < FRAMES; j++)
+        {
+            float v = .1 * sin (2. * M_PI * freq * (i * FRAMES + j) / RATE);
+
+            for (unsigned c = 0; c < channels; c++)
+                p[j * channels + c] = v;
+            if (i >= blocks / 2)
+                in += v * v;
+        }
+        block->i_nb_samples = FRAMES;
+        block->i_pts = VLC_TS_0;
+
+        block = filter->pf_audio_filter (filter, block);
+        assert (block != NULL);
+        p = (float *)block->p_buffer;
+        for (unsigned j = 0; j < FRAMES * channels; j++)
+            assert (isfinite (p[j]));
+        if (i >= blocks / 2)
+            for (unsigned j = 0; j < FRAMES; j++)
+                out += p[j * channels] * p[j * channels];
+        block_Release (block);
+    }
+    return 10. * log10 (out / in);
+}
+
+static void test_response (vlc_object_t *obj)
+{
+    filter_t *filter = equalizer_create (obj, AOUT_CHANS_STEREO);
+
+    /* +12 dB at 1 kHz only */
+    var_SetString (obj, "equalizer-bands", "0 0 0 0 12 0 0 0 0 0");
+    double g1k = gain (filter, 1000., BLOCKS);
+    double g16k = gain (filter, 16000., BLOCKS);
+    log ("1 kHz band at +12 dB: %.2f dB at 1 kHz, %.2f dB at 16 kHz\n",
+         g1k, g16k);
+    assert (fabs (g1k - 12.) < 1.);
+    assert (fabs (g16k) < 1.);
+
+    /* Settings changes apply to the running filter */
+    var_SetString (obj, "equalizer-bands", "0 0 0 0 0 0 0 0 0 -12");
+    g1k = gain (filter, 1000., BLOCKS);
+    g16k = gain (filter, 16000., BLOCKS);
+    log ("16 kHz band at -12 dB: %.2f dB at 1 kHz, %.2f dB at 16 kHz\n",
+         g1k, g16k);
+    assert (fabs (g1k) < 1.);
+    assert (g16k < -9.);
+
+    equalizer_delete (filter);
+}
+
+/**
+ * Checks that a heavily boosted low band stays stable over a long run.
+ */
+static void test_stability (vlc_object_t *obj)
+{
+    filter_t *filter = equalizer_create (obj, AOUT_CHANS_5_1);
+
+    var_SetString (obj, "equalizer-bands", "20 0 0 0 0 0 0 0 0 0");
+    var_SetBool (obj, "equalizer-2pass", true);
+    double g = gain (filter, 60., 60 * RATE / FRAMES);
+    var_SetBool (obj, "equalizer-2pass", false);
+    log ("60 Hz band at +20 dB, two passes, one minute: %.2f dB\n", g);
+    assert (g > 20. && g < 60.);
+
+    equalizer_delete (filter);
+}
+
+static void bench (vlc_object_t *obj, uint32_t layout, const char *name)
+{
+    filter_t *filter = equalizer_create (obj, layout);
+    const unsigned channels = aout_FormatNbChannels (&filter->fmt_in.audio);
+    block_t *block = block_Alloc (FRAMES * channels * sizeof (float));
+    assert (block != NULL);
+
+    float *p = (float *)block->p_buffer;
+    for (unsigned j = 0; j < FRAMES * channels; j++)
+    {
+        int r = rand ();
+        p[j] = (float)r / RAND_MAX - .5f;
+    }
+    block->i_nb_samples = FRAMES;
+
+    mtime_t start = mdate ();
+    for (unsigned i = 0; i < 1024; i++)
+        block = filter->pf_audio_filter (filter, block);
+    mtime_t elapsed = mdate () - start;
+    if (elapsed <= 0)
+        elapsed = 1;
+    log ("%s: %.1f Mframes/s\n", name, 1024. * FRAMES / elapsed);
+
+    block_Release (block);
+    equalizer_delete (filter);
+}
+
+int main (void)
+{
+    test_init ();
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    /* The equalizer settings are on the parent object of the filter.
+     * Make the preamplification exactly compensate the input scaling. */
+    var_Create (obj, "equalizer-bands", VLC_VAR_STRING);
+    var_Create (obj, "equalizer-2pass", VLC_VAR_BOOL);
+    var_Create (obj, "equalizer-preamp", VLC_VAR_FLOAT);
+    var_SetString (obj, "equalizer-bands", "0 0 0 0 0 0 0 0 0 0");
+    var_SetFloat (obj, "equalizer-preamp", 20. * log10 (4.));
+
+    test_response (obj);
+    test_stability (obj);
+
+    var_SetString (obj, "equalizer-bands", "0 2 4 2 0 -2 -4 -2 0 2");
+    bench (obj, AOUT_CHANS_STEREO, "stereo");
+    bench (obj, AOUT_CHANS_7_1, "7.1");
+
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*****************************************************************************
+ * mixer.c: test and micro-benchmark for the software audio mixers
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_aout.h>
+#include <vlc_aout_mixer.h>
+
+/* Number of samples per buffer: 1024 stereo frames */
+#define SAMPLES 2048
+/* Number of buffers mixed for the throughput measurement */
+#define RUNS    20000
+
+static audio_mixer_t *mixer_create (vlc_object_t *obj, vlc_fourcc_t format)
+{
+    audio_mixer_t *mixer = vlc_object_create (obj, sizeof (*mixer));
+    assert (mixer != NULL);
+
+    mixer->format = format;
+    mixer->mix = NULL;
+    mixer->module = module_need (mixer, "audio mixer", NULL, false);
+    if (mixer->module == NULL)
+    {
+        vlc_object_release (mixer);
+        return NULL;
+    }
+    return mixer;
+}
+
+static void mixer_delete (audio_mixer_t *mixer)
+{
+    module_unneed (mixer, mixer->module);
+    vlc_object_release (mixer);
+}
+
+static void bench (audio_mixer_t *mixer, block_t *block, const char *name)
+{
+    mtime_t start = mdate ();
+
+    for (unsigned i = 0; i < RUNS; i++)
+        mixer->mix (mixer, block, (i & 1) ? 2.f : .5f);
+
+    mtime_t elapsed = mdate () - start;
+    if (elapsed <= 0)
+        elapsed = 1;
+    log ("%s: %"PRId64" us, %.1f MB/s\n", name, elapsed,
+         (double)block->i_buffer * RUNS / elapsed);
+}
+
+static void test_float32 (vlc_object_t *obj)
+{
+    audio_mixer_t *mixer = mixer_create (obj, VLC_CODEC_FL32);
+    assert (mixer != NULL);
+
+    block_t *block = block_Alloc (SAMPLES * sizeof (float));
+    assert (block != NULL);
+
+    float *p = (float *)block->p_buffer;
+    for (unsigned i = 0; i < SAMPLES; i++)
+        p[i] = (float)((int)i - SAMPLES / 2) / SAMPLES;
+
+    /* Unity gain is a no-op */
+    mixer->mix (mixer, block, 1.f);
+    for (unsigned i = 0; i < SAMPLES; i++)
+        assert (p[i] == (float)((int)i - SAMPLES / 2) / SAMPLES);
+
+    /* Powers of two are exact, including in the vectorized kernels */
+    mixer->mix (mixer, block, .25f);
+    for (unsigned i = 0; i < SAMPLES; i++)
+        assert (p[i] == (float)((int)i - SAMPLES / 2) / SAMPLES / 4.f);
+
+    /* Odd sizes exercise the scalar tail */
+    block->i_buffer = 13 * sizeof (float);
+    mixer->mix (mixer, block, 4.f);
+    block->i_buffer = SAMPLES * sizeof (float);
+    for (unsigned i = 0; i < SAMPLES; i++)
+        assert (p[i] == (float)((int)i - SAMPLES / 2) / SAMPLES
+                        / (i < 13 ? 1.f : 4.f));
+
+    bench (mixer, block, "float32");
+
+    block_Release (block);
+    mixer_delete (mixer);
+}
+
+static void test_s16n (vlc_object_t *obj)
+{
+    audio_mixer_t *mixer = mixer_create (obj, VLC_CODEC_S16N);
+    assert (mixer != NULL);
+
+    block_t *block = block_Alloc (SAMPLES * sizeof (int16_t));
+    assert (block != NULL);
+
+    int16_t *p = (int16_t *)block->p_buffer;
+    for (unsigned i = 0; i < SAMPLES; i++)
+        p[i] = (i - SAMPLES / 2) * 16;
+
+    mixer->mix (mixer, block, .5f);
+    for (unsigned i = 0; i < SAMPLES; i++)
+        assert (p[i] == (int)(i - SAMPLES / 2) * 8);
+
+    bench (mixer, block, "s16n");
+
+    block_Release (block);
+    mixer_delete (mixer);
+}
+
+int main (void)
+{
+    test_init ();
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    log ("Testing the float32 mixer\n");
+    test_float32 (obj);
+    log ("Testing the fixed-point mixer\n");
+    test_s16n (obj);
+
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,254 @@
+/*****************************************************************************
+ * resampler.c: quality and throughput test for the audio resamplers
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+#include <math.h>
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+
+#define CHANNELS  2
+#define FRAMES    1024  /* frames per input block */
+#define BLOCKS    64
+#define TONE      1000. /* Hz */
+#define AMPLITUDE .5
+
+static filter_t *resampler_create (vlc_object_t *obj, const char *name,
+                                   unsigned irate, unsigned orate)
+{
+    filter_t *filter = vlc_object_create (obj, sizeof (*filter));
+    assert (filter != NULL);
+
+    es_format_Init (&filter->fmt_in, AUDIO_ES, VLC_CODEC_FL32);
+    filter->fmt_in.audio.i_format = VLC_CODEC_FL32;
+    filter->fmt_in.audio.i_rate = irate;
+    filter->fmt_in.audio.i_physical_channels =
+    filter->fmt_in.audio.i_original_channels = AOUT_CHANS_STEREO;
+    aout_FormatPrepare (&filter->fmt_in.audio);
+    es_format_Copy (&filter->fmt_out, &filter->fmt_in);
+    filter->fmt_out.audio.i_rate = orate;
+
+    filter->p_module = module_need (filter, "audio filter", name, true);
+    if (filter->p_module == NULL)
+    {
+        vlc_object_release (filter);
+        return NULL;
+    }
+    return filter;
+}
+
+static void resampler_delete (filter_t *filter)
+{
+    module_unneed (filter, filter->p_module);
+    es_format_Clean (&filter->fmt_in);
+    es_format_Clean (&filter->fmt_out);
+    vlc_object_release (filter);
+}
+
+/**
+ * Generates the next block of a continuous stereo sine wave.
+ */
+static block_t *tone_block (unsigned rate, double *phase)
+{
+    block_t *block = block_Alloc (FRAMES * CHANNELS * sizeof (float));
+    assert (block != NULL);
+
+    float *p = (float *)block->p_buffer;
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        float v = AMPLITUDE * sin (*phase);
+
+        for (unsigned c = 0; c < CHANNELS; c++)
+            *(p++) = v;
+        *phase += 2. * M_PI * TONE / rate;
+    }
+    block->i_nb_samples = FRAMES;
+    block->i_pts = VLC_TS_0;
+    return block;
+}
+
+/**
+ * Resamples a 1 kHz tone and returns the signal-to-noise ratio of the
+ * (left channel) output, in dB.
+ */
+static double measure (filter_t *filter, mtime_t *elapsed)
+{
+    const unsigned irate = filter->fmt_in.audio.i_rate;
+    const unsigned orate = filter->fmt_out.audio.i_rate;
+    size_t max = (size_t)BLOCKS * FRAMES * orate / irate + FRAMES;
+    float *out = malloc (max * sizeof (*out));
+    size_t len = 0;
+    double phase = 0.;
+
+    assert (out != NULL);
+    *elapsed = 0;
+    for (unsigned i = 0; i < BLOCKS; i++)
+    {
+        block_t *block = tone_block (irate, &phase);
+        mtime_t start = mdate ();
+
+        block = filter->pf_audio_filter (filter, block);
+        *elapsed += mdate () - start;
+        if (block == NULL)
+            continue;
+
+        const float *p = (const float *)block->p_buffer;
+        for (unsigned j = 0; j < block->i_nb_samples && len < max; j++)
+            out[len++] = p[j * CHANNELS];
+        block_Release (block);
+    }
+
+    /* Skip the start-up transient, then fit a sine at the expected
+     * output frequency over a whole number of periods. */
+    const size_t skip = 4 * FRAMES;
+    const double w = 2. * M_PI * TONE / orate;
+    size_t n = len - skip;
+    n -= n % (size_t)(orate / TONE);
+    assert (len > skip && n > 0);
+
+    double a = 0., b = 0.;
+    for (size_t i = 0; i < n; i++)
+    {
+        a += out[skip + i] * sin (w * i);
+        b += out[skip + i] * cos (w * i);
+    }
+    a *= 2. / n;
+    b *= 2. / n;
+
+    double signal = 0., noise = 0.;
+    for (size_t i = 0; i < n; i++)
+    {
+        double fit = a * sin (w * i) + b * cos (w * i);
+        double err = out[skip + i] - fit;
+
+        signal += fit * fit;
+        noise += err * err;
+    }
+    free (out);
+    return 10. * log10 (signal / (noise + 1e-30));
+}
+
+static void bench (vlc_object_t *obj, const char *name, double min_snr)
+{
+    static const unsigned rates[][2] = {
+        { 44100, 48000 }, { 48000, 44100 }, { 32000, 48000 },
+    };
+
+    for (unsigned i = 0; i < sizeof (rates) / sizeof (rates[0]); i++)
+    {
+        filter_t *filter = resampler_create (obj, name, rates[i][0],
+                                             rates[i][1]);
+        if (filter == NULL)
+        {
+            log ("%s: not available\n", name);
+            return;
+        }
+
+        mtime_t elapsed;
+        double snr = measure (filter, &elapsed);
+        if (elapsed <= 0)
+            elapsed = 1;
+
+        log ("%s: %u -> %u Hz, SNR %.1f dB, %.1f Mframes/s\n", name,
+             rates[i][0], rates[i][1], snr,
+             (double)BLOCKS * FRAMES / elapsed);
+        assert (snr >= min_snr);
+        resampler_delete (filter);
+    }
+}
+
+/**
+ * Checks that drift compensation-style rate changes do not cause clicks,
+ * i.e. that no output step is larger than the slope of the tone allows.
+ */
+static void test_rate_changes (vlc_object_t *obj, const char *name)
+{
+    filter_t *filter = resampler_create (obj, name, 48000 * 11 / 10, 48000);
+    if (filter == NULL)
+        return;
+
+    /* The audio output opens the resampler with a higher input rate,
+     * then sets the actual one. */
+    filter->fmt_in.audio.i_rate = 48000;
+
+    const double max_step = AMPLITUDE * 2. * M_PI * TONE / 48000 * 1.1;
+    double phase = 0.;
+    float last = 0.f;
+    unsigned total = 0;
+
+    for (unsigned i = 0; i < BLOCKS; i++)
+    {
+        /* 1:1, then compensate for drift both ways, then back to 1:1 */
+        if (i == 8)
+            filter->fmt_in.audio.i_rate = 47998;
+        else if (i == 24)
+            filter->fmt_in.audio.i_rate = 48002;
+        else if (i == 40)
+            filter->fmt_in.audio.i_rate = 48000;
+
+        block_t *block = tone_block (48000, &phase);
+        block = filter->pf_audio_filter (filter, block);
+        if (block == NULL)
+            continue;
+
+        const float *p = (const float *)block->p_buffer;
+        for (unsigned j = 0; j < block->i_nb_samples; j++)
+        {
+            float v = p[j * CHANNELS];
+
+            if (total > 0)
+                assert (fabs (v - last) <= max_step);
+            last = v;
+            total++;
+        }
+        block_Release (block);
+    }
+    /* No frame is lost nor duplicated beyond the filter delay */
+    assert (abs ((int)total - BLOCKS * FRAMES) < FRAMES);
+    log ("%s: %u frames out of %u without clicks\n", name, total,
+         BLOCKS * FRAMES);
+    resampler_delete (filter);
+}
+
+int main (void)
+{
+    test_init ();
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    test_rate_changes (obj, "polyphase_resampler");
+
+    bench (obj, "polyphase_resampler", 70.);
+    bench (obj, "bandlimited_resampler", -HUGE_VAL);
+    bench (obj, "speex_resampler", -HUGE_VAL);
+    bench (obj, "ugly_resampler", -HUGE_VAL);
+
+    libvlc_release (vlc);
+    return 0;
+}
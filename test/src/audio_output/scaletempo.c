@@ -0,0 +1,129 @@
+/*****************************************************************************
+ * scaletempo.c: throughput benchmark for the tempo scaler
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+#include <math.h>
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+
+#define RATE    48000
+#define FRAMES  1024    /* frames per input block */
+#define SECONDS 4       /* of input audio per run */
+
+static const struct
+{
+    const char *name;
+    uint32_t    layout;
+} layouts[] = {
+    { "mono",   AOUT_CHAN_CENTER },
+    { "stereo", AOUT_CHANS_STEREO },
+    { "5.1",    AOUT_CHANS_5_1 },
+    { "7.1",    AOUT_CHANS_7_1 },
+};
+
+static const double scales[] = { 1.5, 2. };
+
+static void bench (vlc_object_t *obj, uint32_t layout, const char *name,
+                   double scale)
+{
+    filter_t *filter = vlc_object_create (obj, sizeof (*filter));
+    assert (filter != NULL);
+
+    es_format_Init (&filter->fmt_in, AUDIO_ES, VLC_CODEC_FL32);
+    filter->fmt_in.audio.i_format = VLC_CODEC_FL32;
+    filter->fmt_in.audio.i_rate = RATE;
+    filter->fmt_in.audio.i_physical_channels =
+    filter->fmt_in.audio.i_original_channels = layout;
+    aout_FormatPrepare (&filter->fmt_in.audio);
+    es_format_Copy (&filter->fmt_out, &filter->fmt_in);
+
+    filter->p_module = module_need (filter, "audio filter", "scaletempo",
+                                    true);
+    assert (filter->p_module != NULL);
+
+    /* The playback rate is applied by changing the input rate */
+    filter->fmt_in.audio.i_rate = RATE * scale;
+
+    const unsigned channels = aout_FormatNbChannels (&filter->fmt_in.audio);
+    const unsigned blocks = SECONDS * RATE / FRAMES;
+    unsigned frames_out = 0;
+    mtime_t elapsed = 0;
+
+    for (unsigned i = 0; i < blocks; i++)
+    {
+        block_t *block = block_Alloc (FRAMES * channels * sizeof (float));
+        assert (block != NULL);
+
+        /* Uncorrelated noise is the worst case for the overlap search */
+        float *p = (float *)block->p_buffer;
+        for (unsigned j = 0; j < FRAMES * channels; j++)
+        {
+            int r = rand ();
+            p[j] = (float)r / RAND_MAX - .5f;
+        }
+        block->i_nb_samples = FRAMES;
+        block->i_pts = VLC_TS_0;
+
+        mtime_t start = mdate ();
+        block = filter->pf_audio_filter (filter, block);
+        elapsed += mdate () - start;
+        if (block != NULL)
+        {
+            frames_out += block->i_nb_samples;
+            block_Release (block);
+        }
+    }
+
+    /* The output lasts about 1/scale of the input */
+    assert (fabs (frames_out * scale - blocks * FRAMES) < 2 * RATE / 10);
+    if (elapsed <= 0)
+        elapsed = 1;
+    log ("%s at %.1fx: %.1f times faster than real time\n", name, scale,
+         (double)SECONDS * CLOCK_FREQ / elapsed);
+
+    module_unneed (filter, filter->p_module);
+    es_format_Clean (&filter->fmt_in);
+    es_format_Clean (&filter->fmt_out);
+    vlc_object_release (filter);
+}
+
+int main (void)
+{
+    test_init ();
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    for (unsigned i = 0; i < sizeof (layouts) / sizeof (layouts[0]); i++)
+        for (unsigned j = 0; j < sizeof (scales) / sizeof (scales[0]); j++)
+            bench (obj, layouts[i].layout, layouts[i].name, scales[j]);
+
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*****************************************************************************
+ * remux.c: test for the stream copy from the input thread
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_input.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Ten seconds of tiny video, each frame of a single value */
+#define WIDTH   32
+#define HEIGHT  16
+#define FRAME   (WIDTH * HEIGHT * 3 / 2)
+#define FRAMES  250
+
+static void write_y4m (const char *path)
+{
+    uint8_t frame[FRAME];
+    char head[64];
+
+    int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert (fd != -1);
+    int len = snprintf (head, sizeof (head),
+                        "YUV4MPEG2 W%d H%d F25:1 Ip A1:1 C420jpeg\n",
+                        WIDTH, HEIGHT);
+    assert (write (fd, head, len) == len);
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        memset (frame, i, sizeof (frame));
+        assert (write (fd, "FRAME\n", 6) == 6);
+        assert (write (fd, frame, sizeof (frame)) == sizeof (frame));
+    }
+    close (fd);
+}
+
+/* Copies a file to its elementary stream, and returns the frame values */
+static uint8_t *remux (vlc_object_t *obj, const char *src, const char *dst,
+                       const char *chain, const char *option, size_t *count)
+{
+    char *url, *sout;
+    struct stat st;
+    uint8_t frame[FRAME];
+
+    assert (asprintf (&url, "file://%s", src) != -1);
+    assert (asprintf (&sout, ":sout=%s", chain) != -1);
+    input_item_t *item = input_item_New (url, "test");
+    assert (item != NULL);
+    input_item_AddOption (item, sout, VLC_INPUT_OPTION_TRUSTED);
+    if (option != NULL)
+        input_item_AddOption (item, option, VLC_INPUT_OPTION_TRUSTED);
+    assert (input_Read (obj, item) == VLC_SUCCESS);
+    vlc_gc_decref (item);
+    free (sout);
+    free (url);
+
+    /* Only whole frames */
+    int fd = open (dst, O_RDONLY);
+    assert (fd != -1);
+    assert (!fstat (fd, &st));
+    assert (st.st_size > 0 && st.st_size % FRAME == 0);
+    *count = st.st_size / FRAME;
+    uint8_t *values = malloc (*count);
+    assert (values != NULL);
+    for (size_t i = 0; i < *count; i++)
+    {
+        assert (read (fd, frame, FRAME) == FRAME);
+        assert (!memcmp (frame, frame + 1, FRAME - 1));
+        values[i] = frame[0];
+    }
+    close (fd);
+    unlink (dst);
+    return values;
+}
+
+/* Checks that the frames from the first one are all there, in order */
+static void check (const uint8_t *values, size_t count, unsigned first)
+{
+    assert (count == FRAMES - first);
+    for (size_t i = 0; i < count; i++)
+        assert (values[i] == (uint8_t)(first + i));
+}
+
+static void test_remux (vlc_object_t *obj, const char *src, const char *dst,
+                        bool direct)
+{
+    char *chain;
+    uint8_t *values;
+    size_t count, head;
+
+    log ("Testing remux %s the input thread\n", direct ? "from" : "without");
+    var_SetBool (obj, "sout-remux-direct", direct);
+
+    assert (asprintf (&chain, "#std{access=file,mux=raw,dst=%s}",
+                      dst) != -1);
+    values = remux (obj, src, dst, chain, NULL, &count);
+    check (values, count, 0);
+    free (values);
+
+    /* The output may begin with what was read before the start time was
+     * applied, and then goes on from the start time without any loss */
+    values = remux (obj, src, dst, chain, ":start-time=4", &count);
+    for (head = 0; head < count && values[head] == head; head++);
+    log ("seek: after %zu frames\n", head);
+    check (values + head, count - head, 4 * 25);
+    free (values);
+    free (chain);
+
+    /* Nested chains too */
+    assert (asprintf (&chain, "#duplicate{dst=\"std{access=file,mux=raw,"
+                      "dst=%s}\"}", dst) != -1);
+    values = remux (obj, src, dst, chain, NULL, &count);
+    check (values, count, 0);
+    free (values);
+    free (chain);
+}
+
+int main (void)
+{
+    char base[] = "/tmp/vlc-test-remux-XXXXXX";
+    char src[sizeof (base) + 8], dst[sizeof (base) + 8];
+
+    test_init ();
+
+    assert (mkdtemp (base) != NULL);
+    snprintf (src, sizeof (src), "%s/in.y4m", base);
+    snprintf (dst, sizeof (dst), "%s/out.es", base);
+    write_y4m (src);
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    var_Create (obj, "sout-remux-direct", VLC_VAR_BOOL);
+    test_remux (obj, src, dst, true);
+    test_remux (obj, src, dst, false);
+
+    libvlc_release (vlc);
+    unlink (src);
+    rmdir (base);
+    return 0;
+}
@@ -0,0 +1,290 @@
+/*****************************************************************************
+ * stream.c: test for the access stream and its read-ahead
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_variables.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "stream_check.h"
+
+#define SIZE (20 << 20) /* more than one cache track */
+
+static uint8_t *data;
+
+static void stats (stream_t *s, const char *name, mtime_t elapsed)
+{
+    stream_cache_stats_t st;
+
+    assert (stream_Control (s, STREAM_GET_CACHE_STATS, &st) == VLC_SUCCESS);
+    assert (st.i_hit + st.i_miss > 0);
+    assert (st.i_depth > 0);
+    log ("%s: %"PRIu64" hits, %"PRIu64" misses, %"PRId64" ms stalled, "
+         "%"PRIu64" reads of %u bytes ahead %u, %u seeks, %"PRId64" ms\n",
+         name, st.i_hit, st.i_miss, st.i_stall / 1000, st.i_read_count,
+         st.i_read_size, st.i_depth, st.i_seek_count, elapsed / 1000);
+}
+
+/* Reads the whole file in small pieces, as a demuxer would */
+static void test_sequential (vlc_object_t *obj, const char *url)
+{
+    stream_t *s = stream_UrlNew (obj, url);
+    assert (s != NULL);
+    assert (stream_Size (s) == SIZE);
+
+    mtime_t start = mdate ();
+    for (uint64_t pos = 0; pos < SIZE;)
+    {
+        unsigned len = 188 + (rand () % 4096);
+
+        check_peek (s, data, SIZE, pos, len / 2);
+        check_read (s, data, SIZE, pos, len);
+        pos += len;
+        if (pos > SIZE)
+            pos = SIZE;
+    }
+    assert (stream_Read (s, &(uint8_t){ 0 }, 1) == 0);
+    stats (s, "sequential", mdate () - start);
+    stream_Delete (s);
+}
+
+/* Seeks back and forth, skips, and interleaves two positions */
+static void test_seek (vlc_object_t *obj, const char *url)
+{
+    stream_t *s = stream_UrlNew (obj, url);
+    assert (s != NULL);
+
+    mtime_t start = mdate ();
+    for (unsigned i = 0; i < 2000; i++)
+    {
+        uint64_t pos = rand () % SIZE;
+
+        assert (stream_Seek (s, pos) == VLC_SUCCESS);
+        check_peek (s, data, SIZE, pos, 1 + rand () % 65536);
+        check_read (s, data, SIZE, pos, 1 + rand () % 16384);
+    }
+
+    /* Skipping */
+    assert (stream_Seek (s, 0) == VLC_SUCCESS);
+    for (uint64_t pos = 0; pos + 200000 < SIZE; pos += 200000)
+    {
+        check_read (s, data, SIZE, pos, 100000);
+        assert (stream_Read (s, NULL, 100000) == 100000);
+    }
+
+    /* Two interleaved tracks, as with badly muxed files */
+    uint64_t a = 0, b = SIZE / 2;
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        assert (stream_Seek (s, a) == VLC_SUCCESS);
+        check_read (s, data, SIZE, a, 4096);
+        a += 4096;
+        assert (stream_Seek (s, b) == VLC_SUCCESS);
+        check_read (s, data, SIZE, b, 4096);
+        b += 4096;
+    }
+
+    /* Back into the oldest data, while the prefetcher fills the track */
+    assert (stream_Seek (s, 0) == VLC_SUCCESS);
+    for (uint64_t pos = 0; pos + 65536 < SIZE; pos += 65536)
+    {
+        check_read (s, data, SIZE, pos, 65536);
+        uint64_t back = rand () % (pos + 65536);
+        assert (stream_Seek (s, back) == VLC_SUCCESS);
+        check_read (s, data, SIZE, back, 1024);
+        assert (stream_Seek (s, pos + 65536) == VLC_SUCCESS);
+    }
+
+    /* End of stream */
+    assert (stream_Seek (s, SIZE - 10) == VLC_SUCCESS);
+    check_read (s, data, SIZE, SIZE - 10, 10);
+    assert (stream_Read (s, &(uint8_t){ 0 }, 1) == 0);
+    assert (stream_Seek (s, SIZE + 1000) != VLC_SUCCESS);
+    assert (stream_Seek (s, 1000) == VLC_SUCCESS);
+    check_read (s, data, SIZE, 1000, 1000);
+
+    stats (s, "seek", mdate () - start);
+    stream_Delete (s);
+}
+
+static void *writer (void *path)
+{
+    int fd = open (path, O_WRONLY);
+    assert (fd != -1);
+
+    /* A slow source, so that the reader catches up with the read-ahead */
+    mtime_t deadline = mdate ();
+    for (size_t pos = 0; pos < SIZE / 16;)
+    {
+        ssize_t val = write (fd, data + pos, 65536);
+        assert (val > 0);
+        pos += val;
+        deadline += CLOCK_FREQ / 100;
+        mwait (deadline);
+    }
+    close (fd);
+    return NULL;
+}
+
+/* Non-seekable source, data trickling in */
+static void test_fifo (vlc_object_t *obj, const char *path)
+{
+    char *url;
+    vlc_thread_t th;
+
+    if (mkfifo (path, 0600))
+    {
+        log ("cannot create FIFO\n");
+        return;
+    }
+    assert (asprintf (&url, "file://%s", path) != -1);
+    assert (!vlc_clone (&th, writer, (void *)path, VLC_THREAD_PRIORITY_LOW));
+
+    stream_t *s = stream_UrlNew (obj, url);
+    assert (s != NULL);
+
+    bool b_seek;
+    stream_Control (s, STREAM_CAN_SEEK, &b_seek);
+    assert (!b_seek);
+
+    mtime_t start = mdate ();
+    for (uint64_t pos = 0; pos < SIZE / 16; pos += 1000)
+    {
+        check_peek (s, data, SIZE, pos, __MIN (5000, SIZE / 16 - pos));
+        check_read (s, data, SIZE, pos, __MIN (1000, SIZE / 16 - pos));
+    }
+    assert (stream_Read (s, &(uint8_t){ 0 }, 1) == 0);
+    stats (s, "fifo", mdate () - start);
+    stream_Delete (s);
+
+    vlc_join (th, NULL);
+    unlink (path);
+    free (url);
+}
+
+static vlc_mutex_t stop_lock = VLC_STATIC_MUTEX;
+static vlc_cond_t stop_wait = VLC_STATIC_COND;
+static bool stopped;
+
+static void *stalled_writer (void *path)
+{
+    int fd = open (path, O_WRONLY);
+    assert (fd != -1);
+
+    assert (write (fd, data, 65536) == 65536);
+    /* and nothing more until the reader is gone */
+    vlc_mutex_lock (&stop_lock);
+    while (!stopped)
+        vlc_cond_wait (&stop_wait, &stop_lock);
+    vlc_mutex_unlock (&stop_lock);
+    close (fd);
+    return NULL;
+}
+
+/* Deleting the stream interrupts a blocked access read */
+static void test_stop (vlc_object_t *obj, const char *path)
+{
+    char *url;
+    vlc_thread_t th;
+
+    if (mkfifo (path, 0600))
+    {
+        log ("cannot create FIFO\n");
+        return;
+    }
+    assert (asprintf (&url, "file://%s", path) != -1);
+    assert (!vlc_clone (&th, stalled_writer, (void *)path,
+                        VLC_THREAD_PRIORITY_LOW));
+
+    stream_t *s = stream_UrlNew (obj, url);
+    assert (s != NULL);
+    check_read (s, data, SIZE, 0, 65536);
+
+    mtime_t start = mdate ();
+    stream_Delete (s);
+    log ("stop: %"PRId64" ms\n", (mdate () - start) / 1000);
+    vlc_mutex_lock (&stop_lock);
+    stopped = true;
+    vlc_cond_signal (&stop_wait);
+    vlc_mutex_unlock (&stop_lock);
+
+    unlink (path);
+    vlc_join (th, NULL);
+    free (url);
+}
+
+int main (void)
+{
+    char path[] = "/tmp/vlc-test-stream-XXXXXX";
+    char fifo[sizeof (path) + 5];
+    char *url;
+
+    test_init ();
+
+    data = malloc (SIZE);
+    assert (data != NULL);
+    for (size_t i = 0; i < SIZE; i++)
+        data[i] = rand ();
+
+    int fd = mkstemp (path);
+    assert (fd != -1);
+    for (size_t pos = 0; pos < SIZE;)
+    {
+        ssize_t val = write (fd, data + pos, SIZE - pos);
+        assert (val > 0);
+        pos += val;
+    }
+    close (fd);
+    assert (asprintf (&url, "file://%s", path) != -1);
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    test_sequential (obj, url);
+    test_seek (obj, url);
+
+    /* Same through memory mapping */
+    var_Create (obj, "file-mmap", VLC_VAR_BOOL);
+    var_SetBool (obj, "file-mmap", true);
+    test_sequential (obj, url);
+    test_seek (obj, url);
+    var_Destroy (obj, "file-mmap");
+    unlink (path);
+    free (url);
+
+    snprintf (fifo, sizeof (fifo), "%s.fifo", path);
+    test_fifo (obj, fifo);
+    test_stop (obj, fifo);
+
+    libvlc_release (vlc);
+    free (data);
+    return 0;
+}
@@ -0,0 +1,47 @@
+/*****************************************************************************
+ * stream_check.h: checks of the stream data against a reference
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <vlc_stream.h>
+
+/* Reads len bytes at pos, or up to the end of the reference data */
+static inline void check_read (stream_t *s, const uint8_t *ref, uint64_t size,
+                               uint64_t pos, unsigned len)
+{
+    uint8_t buf[len];
+
+    assert (stream_Tell (s) == (int64_t)pos);
+    if (pos + len > size)
+        len = size - pos;
+    assert (stream_Read (s, buf, len) == (int)len);
+    assert (!memcmp (buf, ref + pos, len));
+}
+
+/* Peeks len bytes at pos, or up to the end of the reference data */
+static inline void check_peek (stream_t *s, const uint8_t *ref, uint64_t size,
+                               uint64_t pos, unsigned len)
+{
+    const uint8_t *peek;
+
+    if (pos + len > size)
+        len = size - pos;
+    assert (stream_Peek (s, &peek, len) == (int)len);
+    assert (!memcmp (peek, ref + pos, len));
+    assert (stream_Tell (s) == (int64_t)pos);
+}
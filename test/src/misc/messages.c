@@ -0,0 +1,327 @@
+/*****************************************************************************
+ * messages.c: test for the asynchronous log messages
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define THREADS  4
+#define MESSAGES 50
+#define FLOOD    1000
+#define SITES    3
+#define BURST    90 /* per call site, below the rate limit */
+
+static struct
+{
+    msg_subscription_t *sub;
+    char *lines[2 * FLOOD];
+    unsigned count;
+    unsigned dropped;
+    unsigned sent; /* by the burst thread */
+    bool blocked, released;
+} received;
+
+/* For the overflow test, between the logger and the other threads */
+static vlc_mutex_t received_lock = VLC_STATIC_MUTEX;
+static vlc_cond_t received_wait = VLC_STATIC_COND;
+
+/* Callbacks are serialized: no need for a lock */
+static void callback (void *opaque, int type, const msg_item_t *item,
+                      const char *format, va_list ap)
+{
+    (void) opaque; (void) type;
+
+    if (!strcmp (format, "%u log messages dropped"))
+    {
+        received.dropped += va_arg (ap, unsigned);
+        return;
+    }
+    if (strcmp (item->psz_module, MODULE_STRING))
+        return; /* from LibVLC itself */
+
+    assert (received.count < sizeof (received.lines) / sizeof (char *));
+    assert (vasprintf (&received.lines[received.count], format, ap) != -1);
+    if (!strcmp (received.lines[received.count], "block"))
+    {   /* Holds the logger thread */
+        vlc_mutex_lock (&received_lock);
+        received.blocked = true;
+        vlc_cond_broadcast (&received_wait);
+        while (!received.released)
+            vlc_cond_wait (&received_wait, &received_lock);
+        vlc_mutex_unlock (&received_lock);
+    }
+    received.count++;
+}
+
+static void subscribe (void)
+{
+    received.sub = vlc_Subscribe (callback, NULL);
+    assert (received.sub != NULL);
+}
+
+/* Delivers the pending messages */
+static void unsubscribe (void)
+{
+    vlc_Unsubscribe (received.sub);
+}
+
+static void clear (void)
+{
+    for (unsigned i = 0; i < received.count; i++)
+        free (received.lines[i]);
+    received.count = 0;
+    received.dropped = 0;
+}
+
+/* The arguments are formatted later, as they were at the time of the call */
+static void test_format (vlc_object_t *obj)
+{
+    char str[1000], expected[2048];
+
+    subscribe ();
+
+    memset (str, 'x', sizeof (str) - 1);
+    str[sizeof (str) - 1] = '\0';
+    char *tmp = strdup ("temporary");
+    assert (tmp != NULL);
+
+#define FORMAT "%d|%5.2f|%s|%-*s|%x|%lld|%zu|%c|%%|%.3s|%p|%hhd|%s|%m"
+#define ARGS   -42, 3.14159, tmp, 6, "pad", 0xbeefu, -1234567890123LL, \
+               (size_t)77, 'z', "abcdef", (void *)obj, 300, str
+    errno = ENOENT;
+    snprintf (expected, sizeof (expected), FORMAT, ARGS);
+    errno = ENOENT;
+    msg_Dbg (obj, FORMAT, ARGS);
+    assert (errno == ENOENT);
+    memset (tmp, '-', strlen (tmp));
+    free (tmp);
+
+    /* Not recorded as such, but formatted right away */
+    msg_Dbg (obj, "%2$s %1$s", "world", "hello");
+
+    /* With a precision, only that much of a string is read, like the
+     * four character codes right before an unmapped page */
+    long pagesize = sysconf (_SC_PAGESIZE);
+    char *page = mmap (NULL, 2 * pagesize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert (page != MAP_FAILED);
+    assert (!mprotect (page + pagesize, pagesize, PROT_NONE));
+    char *fourcc = page + pagesize - 4;
+    memcpy (fourcc, "abcd", 4);
+    msg_Dbg (obj, "%4.4s|%.*s|%.2s|%-6.3s|", fourcc, 4, fourcc, fourcc, fourcc);
+    unsubscribe ();
+    munmap (page, 2 * pagesize);
+
+    assert (received.count == 3);
+    log ("format: %.60s...\n", received.lines[0]);
+    assert (!strcmp (received.lines[0], expected));
+    assert (!strcmp (received.lines[1], "hello world"));
+    assert (!strcmp (received.lines[2], "abcd|abcd|ab|abc   |"));
+    assert (received.dropped == 0);
+    clear ();
+}
+
+static void *emit (void *data)
+{
+    vlc_object_t *obj = data;
+    static unsigned next = 0;
+    unsigned id = __sync_fetch_and_add (&next, 1);
+
+    for (unsigned i = 0; i < MESSAGES; i++)
+        msg_Dbg (obj, "thread %u message %u", id, i);
+    return NULL;
+}
+
+/* Messages from several threads, all delivered in order */
+static void test_threads (vlc_object_t *obj)
+{
+    vlc_thread_t threads[THREADS];
+    unsigned seen[THREADS] = { 0 };
+
+    subscribe ();
+    for (unsigned i = 0; i < THREADS; i++)
+        assert (!vlc_clone (&threads[i], emit, obj, VLC_THREAD_PRIORITY_LOW));
+    for (unsigned i = 0; i < THREADS; i++)
+        vlc_join (threads[i], NULL);
+    unsubscribe ();
+
+    log ("threads: %u messages\n", received.count);
+    assert (received.count == THREADS * MESSAGES);
+    for (unsigned i = 0; i < received.count; i++)
+    {
+        unsigned id, n;
+
+        assert (sscanf (received.lines[i], "thread %u message %u",
+                        &id, &n) == 2);
+        assert (id < THREADS);
+        assert (n == seen[id]++);
+    }
+    assert (received.dropped == 0);
+    clear ();
+}
+
+/* Flooding from one call site is limited, and the drops are counted */
+static void test_flood (vlc_object_t *obj)
+{
+    unsigned last = 0;
+
+    subscribe ();
+    for (unsigned i = 0; i < FLOOD; i++)
+        msg_Dbg (obj, "flood %u", i);
+    unsubscribe ();
+
+    /* The drops are reported before the next message */
+    subscribe ();
+    msg_Dbg (obj, "done");
+    unsubscribe ();
+
+    log ("flood: %u messages, %u dropped\n", received.count - 1,
+         received.dropped);
+    assert (received.count > 1);
+    assert (received.count - 1 < FLOOD / 2);
+    assert (received.count - 1 + received.dropped == FLOOD);
+    for (unsigned i = 0; i < received.count - 1; i++)
+    {
+        unsigned n;
+
+        assert (sscanf (received.lines[i], "flood %u", &n) == 1);
+        assert (i == 0 || n > last);
+        last = n;
+    }
+    assert (!strcmp (received.lines[received.count - 1], "done"));
+    clear ();
+}
+
+/* Even when delivered in time, one call site cannot flood the log */
+static void test_rate (vlc_object_t *obj)
+{
+    subscribe ();
+    for (unsigned i = 0; i < FLOOD / 4; i++)
+    {
+        msg_Dbg (obj, "rate %u", i);
+        unsubscribe ();
+        subscribe ();
+    }
+    msg_Dbg (obj, "done");
+    unsubscribe ();
+
+    log ("rate: %u messages, %u dropped\n", received.count - 1,
+         received.dropped);
+    assert (received.count - 1 < FLOOD / 4);
+    assert (received.count - 1 + received.dropped == FLOOD / 4);
+    assert (!strcmp (received.lines[received.count - 1], "done"));
+    clear ();
+}
+
+static void sent (void)
+{
+    vlc_mutex_lock (&received_lock);
+    received.sent++;
+    vlc_cond_broadcast (&received_wait);
+    vlc_mutex_unlock (&received_lock);
+}
+
+static void *burst (void *data)
+{
+    vlc_object_t *obj = data;
+
+    for (unsigned i = 0; i < BURST; i++)
+    {
+        msg_Dbg (obj, "site 0 message %u", i);
+        sent ();
+        msg_Dbg (obj, "site 1 message %u", i);
+        sent ();
+        msg_Dbg (obj, "site 2 message %u", i);
+        sent ();
+    }
+    return NULL;
+}
+
+/* A thread logging more than its queue holds loses nothing */
+static void test_overflow (vlc_object_t *obj)
+{
+    vlc_thread_t thread;
+    unsigned seen[SITES][BURST] = { { 0 } };
+    unsigned queue = var_InheritInteger (obj, "log-queue");
+
+    assert (queue < SITES * BURST);
+    subscribe ();
+    received.blocked = received.released = false;
+    received.sent = 0;
+    msg_Dbg (obj, "block");
+    vlc_mutex_lock (&received_lock);
+    while (!received.blocked)
+        vlc_cond_wait (&received_wait, &received_lock);
+    vlc_mutex_unlock (&received_lock);
+
+    /* Once the ring of the thread is full, it formats the next message
+     * itself, and waits for the logger thread */
+    assert (!vlc_clone (&thread, burst, obj, VLC_THREAD_PRIORITY_LOW));
+    vlc_mutex_lock (&received_lock);
+    while (received.sent < queue)
+        vlc_cond_wait (&received_wait, &received_lock);
+    received.released = true;
+    vlc_cond_broadcast (&received_wait);
+    vlc_mutex_unlock (&received_lock);
+    vlc_join (thread, NULL);
+    unsubscribe ();
+
+    log ("overflow: %u messages, %u dropped\n", received.count - 1,
+         received.dropped);
+    assert (received.count == 1 + SITES * BURST);
+    assert (received.dropped == 0);
+    for (unsigned i = 1; i < received.count; i++)
+    {
+        unsigned site, n;
+
+        assert (sscanf (received.lines[i], "site %u message %u",
+                        &site, &n) == 2);
+        assert (site < SITES && n < BURST);
+        assert (seen[site][n]++ == 0);
+    }
+    clear ();
+}
+
+int main (void)
+{
+    test_init ();
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    test_format (obj);
+    test_threads (obj);
+    test_flood (obj);
+    test_rate (obj);
+    test_overflow (obj);
+
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*****************************************************************************
+ * picture_pool.c: test for the picture pools and their statistics
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_picture_pool.h>
+#include "../../libvlc/player.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Two seconds of tiny video */
+#define WIDTH   64
+#define HEIGHT  48
+#define FRAMES  50
+
+static void test_grow (void)
+{
+    video_format_t fmt;
+    picture_t *pics[8];
+
+    log ("Testing pool growth\n");
+
+    video_format_Setup (&fmt, VLC_CODEC_I420, WIDTH, HEIGHT, 1, 1);
+    picture_pool_t *pool = picture_pool_NewFromFormat (&fmt, 4);
+    assert (pool != NULL);
+    picture_pool_t *reserve = picture_pool_Reserve (pool, 1);
+    assert (reserve != NULL);
+
+    /* The reserved picture is neither available nor counted */
+    for (int i = 0; i < 3; i++)
+        assert ((pics[i] = picture_pool_Get (pool)) != NULL);
+    assert (picture_pool_Get (pool) == NULL);
+    assert (picture_pool_GetUsed (pool) == 3);
+
+    /* Only the pools from a format can grow */
+    assert (picture_pool_Grow (reserve, 1) == 0);
+    assert (picture_pool_Grow (pool, 2) == 2);
+    assert (picture_pool_GetSize (pool) == 6);
+    for (int i = 3; i < 5; i++)
+    {
+        assert ((pics[i] = picture_pool_Get (pool)) != NULL);
+        assert (pics[i]->format.i_chroma == VLC_CODEC_I420);
+        assert (pics[i]->p[0].p_pixels != NULL);
+    }
+    assert (picture_pool_Get (pool) == NULL);
+    assert (picture_pool_GetUsed (pool) == 5);
+
+    /* Only the added pictures that are not used are removed */
+    assert (picture_pool_Shrink (pool, 5) == 0);
+    picture_Release (pics[0]);
+    picture_Release (pics[4]);
+    assert (picture_pool_Shrink (pool, 5) == 1);
+    assert (picture_pool_GetSize (pool) == 5);
+    assert (picture_pool_GetUsed (pool) == 3);
+
+    /* The pool still works afterwards, reserve included */
+    assert ((pics[0] = picture_pool_Get (pool)) != NULL);
+    assert (picture_pool_Get (pool) == NULL);
+    picture_t *reserved = picture_pool_Get (reserve);
+    assert (reserved != NULL);
+    picture_Release (reserved);
+
+    for (int i = 0; i < 4; i++)
+        picture_Release (pics[i]);
+    assert (picture_pool_GetUsed (pool) == 0);
+    assert (picture_pool_Shrink (pool, 5) == 1);
+    assert (picture_pool_GetSize (pool) == 4);
+
+    picture_pool_Delete (reserve);
+    picture_pool_Delete (pool);
+
+    /* The other pools do not */
+    picture_t *picture = picture_NewFromFormat (&fmt);
+    assert (picture != NULL);
+    pool = picture_pool_New (1, &picture);
+    assert (pool != NULL);
+    assert (picture_pool_Grow (pool, 1) == 0);
+    assert (picture_pool_Shrink (pool, 1) == 0);
+    picture_pool_Delete (pool);
+}
+
+static void write_y4m (const char *path)
+{
+    uint8_t frame[WIDTH * HEIGHT * 3 / 2];
+    char head[64];
+
+    int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert (fd != -1);
+    int len = snprintf (head, sizeof (head),
+                        "YUV4MPEG2 W%d H%d F25:1 Ip A1:1 C420jpeg\n",
+                        WIDTH, HEIGHT);
+    assert (write (fd, head, len) == len);
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        memset (frame, 4 * i, sizeof (frame));
+        assert (write (fd, "FRAME\n", 6) == 6);
+        assert (write (fd, frame, sizeof (frame)) == sizeof (frame));
+    }
+    close (fd);
+}
+
+/* Returns the value of the first sample of a metric, or -1 */
+static long long value (const char *page, const char *name)
+{
+    char *sample;
+    long long n = -1;
+
+    assert (asprintf (&sample, "\n%s{vout=\"", name) != -1);
+    const char *line = strstr (page, sample);
+    if (line != NULL)
+        n = strtoll (strchr (line, ' ') + 1, NULL, 10);
+    free (sample);
+    return n;
+}
+
+static void test_stats (const char *path)
+{
+    static const char *const stats[] = { "--stats" };
+    static const libvlc_event_type_t progress[] = {
+        libvlc_MediaPlayerTimeChanged,
+    };
+    player_events_t events;
+
+    log ("Testing pool statistics\n");
+
+    libvlc_instance_t *vlc = player_instance (stats, 1);
+    libvlc_media_player_t *mp = player_new (vlc, path, ":input-repeat=-1");
+    player_events_init (&events, mp, progress, 1);
+    assert (!libvlc_media_player_play (mp));
+
+    /* Each video output has its pool metrics, while it exists. They are
+     * checked again after each step of the playback. */
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    long long requests, pictures, used;
+    char *page;
+    for (;;)
+    {
+        unsigned n = player_events_count (&events);
+
+        page = stats_Export (obj);
+        assert (page != NULL);
+        requests = value (page, "vlc_vout_pool_requests");
+        if (requests > 0)
+            break;
+        free (page);
+        player_events_wait (&events, n);
+    }
+    player_events_clean (&events, mp, progress, 1);
+    pictures = value (page, "vlc_vout_pool_pictures");
+    used = value (page, "vlc_vout_pool_high_water");
+    log ("%lld requests, %lld pictures, %lld used\n", requests, pictures,
+         used);
+    assert (value (page, "vlc_vout_pool_misses") >= 0);
+    assert (pictures > 0);
+    assert (used > 0 && used <= pictures);
+    assert (strstr (page, "# TYPE vlc_vout_pool_wait_microseconds histogram\n")
+            != NULL);
+    free (page);
+
+    libvlc_media_player_stop (mp);
+    libvlc_media_player_release (mp);
+    page = stats_Export (obj);
+    assert (page != NULL);
+    assert (value (page, "vlc_vout_pool_requests") == -1);
+    free (page);
+
+    libvlc_release (vlc);
+}
+
+int main (void)
+{
+    char base[] = "/tmp/vlc-test-pool-XXXXXX";
+    char path[sizeof (base) + 8];
+
+    test_init ();
+
+    test_grow ();
+
+    assert (mkdtemp (base) != NULL);
+    snprintf (path, sizeof (path), "%s/in.y4m", base);
+    write_y4m (path);
+    test_stats (path);
+
+    unlink (path);
+    rmdir (base);
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*****************************************************************************
+ * stats.c: test for the metrics and their exporter
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+#include "../../libvlc/player.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+/* One second of 8 kHz 16-bits mono PCM */
+#define RATE    8000
+#define SAMPLES RATE
+
+/* Returns a free TCP port on the loopback interface */
+static unsigned free_port (void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+    };
+    socklen_t addrlen = sizeof (addr);
+
+    int fd = socket (AF_INET, SOCK_STREAM, 0);
+    assert (fd != -1);
+    assert (!bind (fd, (struct sockaddr *)&addr, sizeof (addr)));
+    assert (!getsockname (fd, (struct sockaddr *)&addr, &addrlen));
+    close (fd);
+    return ntohs (addr.sin_port);
+}
+
+/* Fetches a page, returns its body */
+static char *fetch (unsigned port, const char *path)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons (port),
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+    };
+    char *req, *buf = NULL;
+    size_t len = 0;
+    ssize_t val;
+
+    int fd = socket (AF_INET, SOCK_STREAM, 0);
+    assert (fd != -1);
+    /* The interface listens as soon as libvlc is created */
+    assert (!connect (fd, (struct sockaddr *)&addr, sizeof (addr)));
+
+    int reqlen = asprintf (&req, "GET %s HTTP/1.0\r\n\r\n", path);
+    assert (reqlen != -1);
+    assert (send (fd, req, reqlen, MSG_NOSIGNAL) == reqlen);
+    free (req);
+
+    do
+    {
+        buf = realloc (buf, len + 4097);
+        assert (buf != NULL);
+        val = recv (fd, buf + len, 4096, 0);
+        assert (val >= 0);
+        len += val;
+    }
+    while (val > 0);
+    close (fd);
+    buf[len] = '\0';
+
+    assert (!strncmp (buf, "HTTP/1.", 7));
+    char *body = strstr (buf, "\r\n\r\n");
+    assert (body != NULL);
+    body = strdup (body + 4);
+    assert (body != NULL);
+    free (buf);
+    return body;
+}
+
+/* Returns the id label of the metrics of an input, or NULL */
+static char *input_id (const char *page, const char *name)
+{
+    char prefix[128];
+    unsigned id;
+
+    snprintf (prefix, sizeof (prefix),
+              "vlc_input_read_bytes{input=\"%s\",id=\"", name);
+    const char *p = strstr (page, prefix);
+    if (p == NULL || sscanf (p + strlen (prefix), "%u", &id) != 1)
+        return NULL;
+
+    char *label;
+    assert (asprintf (&label, "input=\"%s\",id=\"%u\"", name, id) != -1);
+    return label;
+}
+
+/* Returns the value of a sample, or -1 if it is missing */
+static long long value (const char *page, const char *sample)
+{
+    size_t len = strlen (sample);
+
+    for (const char *line = page; line != NULL; line = strchr (line, '\n'))
+    {
+        if (*line == '\n')
+            line++;
+        if (!strncmp (line, sample, len) && line[len] == ' ')
+            return strtoll (line + len + 1, NULL, 10);
+    }
+    return -1;
+}
+
+int main (void)
+{
+    char base[] = "/tmp/vlc-test-stats-XXXXXX";
+    char path[sizeof (base) + 8], port_arg[32];
+
+    test_init ();
+
+    assert (mkdtemp (base) != NULL);
+    snprintf (path, sizeof (path), "%s/in.wav", base);
+    wav_write (path, RATE, SAMPLES);
+
+    unsigned port = free_port ();
+    snprintf (port_arg, sizeof (port_arg), "--http-port=%u", port);
+    const char *const options[] = {
+        "--extraintf=metrics", "--http-host=127.0.0.1", port_arg, "--stats",
+    };
+    libvlc_instance_t *vlc = player_instance (options, 4);
+
+    /* Each request is a connection, counted before the page is made */
+    char *page, sample[128];
+
+    snprintf (sample, sizeof (sample), "vlc_httpd_connections{port=\"%u\"}",
+              port);
+    page = fetch (port, "/metrics");
+    long long connections = value (page, sample);
+    log ("connections: %lld\n", connections);
+    assert (connections >= 1);
+    assert (strstr (page, "# TYPE vlc_httpd_connections counter\n") != NULL);
+    free (page);
+    page = fetch (port, "/metrics");
+    assert (value (page, sample) == connections + 1);
+    free (page);
+
+    /* The input metrics are labelled, and exist while it plays */
+    libvlc_media_player_t *mp = player_new (vlc, path, ":input-repeat=-1");
+    static const libvlc_event_type_t progress[] = {
+        libvlc_MediaPlayerTimeChanged,
+    };
+    player_events_t events;
+
+    player_events_init (&events, mp, progress, 1);
+    assert (!libvlc_media_player_play (mp));
+
+    /* Checked again after each step of the playback */
+    long long bytes = -1, count = -1, inf = -1;
+    char *label = NULL;
+    for (;;)
+    {
+        unsigned n = player_events_count (&events);
+
+        page = fetch (port, "/metrics");
+        if (label == NULL)
+            label = input_id (page, "in.wav");
+        if (label != NULL)
+        {
+            snprintf (sample, sizeof (sample), "vlc_input_read_bytes{%s}",
+                      label);
+            bytes = value (page, sample);
+            snprintf (sample, sizeof (sample),
+                      "vlc_decoder_block_microseconds_count{%s}", label);
+            count = value (page, sample);
+            snprintf (sample, sizeof (sample),
+                      "vlc_decoder_block_microseconds_bucket{%s,le=\"+Inf\"}",
+                      label);
+            inf = value (page, sample);
+            if (bytes > 0 && count > 0)
+                break;
+        }
+        free (page);
+        player_events_wait (&events, n);
+    }
+    player_events_clean (&events, mp, progress, 1);
+    log ("read: %lld bytes, decoded %lld blocks, %s\n", bytes, count, label);
+    assert (inf == count);
+    assert (strstr (page, "# TYPE vlc_decoder_block_microseconds histogram\n")
+            != NULL);
+
+    /* Buckets are cumulative, and all listed up to 2^30 microseconds */
+    long long last = 0;
+    unsigned buckets = 0;
+    for (const char *p = strstr (page, "vlc_decoder_block_microseconds_bucket");
+         p != NULL;
+         p = strstr (p + 1, "vlc_decoder_block_microseconds_bucket"))
+    {
+        long long n = strtoll (strchr (p, ' ') + 1, NULL, 10);
+        assert (n >= last);
+        last = n;
+        buckets++;
+    }
+    assert (last == count);
+    assert (buckets == 32);
+    snprintf (sample, sizeof (sample),
+              "vlc_decoder_block_microseconds_bucket{%s,le=\"1073741823\"}",
+              label);
+    assert (value (page, sample) == count);
+    free (page);
+    free (label);
+
+    /* and are gone afterwards */
+    libvlc_media_player_stop (mp);
+    libvlc_media_player_release (mp);
+    page = fetch (port, "/metrics");
+    assert (strstr (page, "in.wav") == NULL);
+    free (page);
+
+    libvlc_release (vlc);
+    unlink (path);
+    rmdir (base);
+    return 0;
+}
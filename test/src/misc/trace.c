@@ -0,0 +1,152 @@
+/*****************************************************************************
+ * trace.c: test for the playback pipeline tracer
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_input.h>
+#include "../../libvlc/player.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* A quarter of a second of 8 kHz 16-bits mono PCM */
+#define RATE    8000
+#define SAMPLES (RATE / 4)
+
+static const char *const stages[] = {
+    "demux", "decoder_queue", "decode", "audio_play", "audio_latency",
+};
+
+static void play (libvlc_instance_t *vlc, const char *path)
+{
+    char *url;
+
+    assert (asprintf (&url, "file://%s", path) != -1);
+    input_item_t *item = input_item_New (url, "test");
+    assert (item != NULL);
+    assert (input_Read (vlc->p_libvlc_int, item) == VLC_SUCCESS);
+    vlc_gc_decref (item);
+    free (url);
+}
+
+/* Returns how many samples a stage histogram holds, or -1 */
+static long long count (vlc_object_t *obj, const char *stage)
+{
+    char *page = stats_Export (obj), *sample;
+    long long n = -1;
+
+    assert (page != NULL);
+    assert (asprintf (&sample, "vlc_trace_stage_microseconds_count"
+                      "{stage=\"%s\"} ", stage) != -1);
+    const char *line = strstr (page, sample);
+    if (line != NULL)
+        n = strtoll (line + strlen (sample), NULL, 10);
+    free (sample);
+    free (page);
+    return n;
+}
+
+static char *read_file (const char *path)
+{
+    struct stat st;
+
+    int fd = open (path, O_RDONLY);
+    assert (fd != -1);
+    assert (!fstat (fd, &st));
+    char *buf = malloc (st.st_size + 1);
+    assert (buf != NULL);
+    assert (read (fd, buf, st.st_size) == st.st_size);
+    buf[st.st_size] = '\0';
+    close (fd);
+    return buf;
+}
+
+int main (void)
+{
+    char base[] = "/tmp/vlc-test-trace-XXXXXX";
+    char path[sizeof (base) + 8], trace[sizeof (base) + 12], *option;
+    libvlc_instance_t *vlc;
+
+    test_init ();
+
+    assert (mkdtemp (base) != NULL);
+    snprintf (path, sizeof (path), "%s/in.wav", base);
+    snprintf (trace, sizeof (trace), "%s/trace.json", base);
+    wav_write (path, RATE, SAMPLES);
+
+    /* Not traced by default */
+    static const char *const stats[] = { "--stats" };
+    vlc = player_instance (stats, 1);
+    play (vlc, path);
+    assert (count (VLC_OBJECT(vlc->p_libvlc_int), "decode") == -1);
+    libvlc_release (vlc);
+
+    /* Each stage has its latency histogram */
+    assert (asprintf (&option, "--trace-file=%s", trace) != -1);
+    const char *const traced[] = { option };
+    vlc = player_instance (traced, 1);
+    play (vlc, path);
+    for (size_t i = 0; i < sizeof (stages) / sizeof (stages[0]); i++)
+    {
+        long long n = count (VLC_OBJECT(vlc->p_libvlc_int), stages[i]);
+
+        log ("%s: %lld\n", stages[i], n);
+        assert (n > 0);
+    }
+    libvlc_release (vlc);
+    free (option);
+
+    /* and its events in the timeline, written at exit */
+    char *json = read_file (trace);
+    size_t len = strlen (json);
+    assert (!strncmp (json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[",
+                      39));
+    assert (len > 4 && !strcmp (json + len - 4, "\n]}\n"));
+    assert (strstr (json, "\"name\":\"thread_name\",\"ph\":\"M\"") != NULL);
+    assert (strstr (json, "{\"name\":\"decode\",\"cat\":\"decoder\","
+                          "\"ph\":\"X\"") != NULL);
+    assert (strstr (json, "{\"name\":\"demux\",\"cat\":\"input\","
+                          "\"ph\":\"X\"") != NULL);
+
+    /* Overlapping stages begin and end */
+    unsigned begins = 0, ends = 0;
+    for (const char *p = json; (p = strstr (p, "\"ph\":\"b\"")) != NULL; p++)
+        begins++;
+    for (const char *p = json; (p = strstr (p, "\"ph\":\"e\"")) != NULL; p++)
+        ends++;
+    log ("trace: %zu bytes, %u overlapping stages\n", len, begins);
+    assert (begins > 0 && begins == ends);
+
+    /* No negative duration */
+    for (const char *p = json; (p = strstr (p, "\"dur\":")) != NULL; p++)
+        assert (p[6] != '-');
+    free (json);
+
+    unlink (trace);
+    unlink (path);
+    rmdir (base);
+    return 0;
+}
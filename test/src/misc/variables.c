@@ -401,6 +401,121 @@ static void test_creation_and_type( libvlc_int_t *p_libvlc )
     assert( var_Get( p_libvlc, "bla", &val ) == VLC_ENOVAR );
 }
 
+static void test_handles( libvlc_int_t *p_libvlc )
+{
+    vlc_var_handle_t *h;
+
+    var_Create( p_libvlc, "bla", VLC_VAR_INTEGER );
+    assert( var_Resolve( p_libvlc, "bla", VLC_VAR_FLOAT ) == NULL );
+    assert( var_Resolve( p_libvlc, "blo", VLC_VAR_INTEGER ) == NULL );
+
+    h = var_Resolve( p_libvlc, "bla", VLC_VAR_INTEGER );
+    assert( h != NULL );
+    var_SetInteger( p_libvlc, "bla", 42 );
+    assert( var_HandleGetInteger( h ) == 42 );
+    var_HandleSetInteger( h, 4212 );
+    assert( var_GetInteger( p_libvlc, "bla" ) == 4212 );
+
+    /* The limits apply to the values read through the handle */
+    vlc_value_t val;
+    val.i_int = 100;
+    var_Change( p_libvlc, "bla", VLC_VAR_SETMAX, &val, NULL );
+    assert( var_HandleGetInteger( h ) == 100 );
+
+    /* The handle holds the variable */
+    var_Destroy( p_libvlc, "bla" );
+    assert( var_Type( p_libvlc, "bla" ) != 0 );
+    assert( var_HandleGetInteger( h ) == 100 );
+    var_HandleRelease( h );
+    assert( var_Type( p_libvlc, "bla" ) == 0 );
+
+    var_Create( p_libvlc, "bla", VLC_VAR_STRING );
+    h = var_Resolve( p_libvlc, "bla", 0 );
+    assert( h != NULL );
+    var_SetString( p_libvlc, "bla", "foo" );
+    var_HandleGetChecked( h, VLC_VAR_STRING, &val );
+    assert( !strcmp( val.psz_string, "foo" ) );
+    free( val.psz_string );
+    var_HandleRelease( h );
+    var_Destroy( p_libvlc, "bla" );
+}
+
+static void *writer( void *data )
+{
+    libvlc_int_t *p_libvlc = data;
+
+    for( int i = 0; i < 20000; i++ )
+        var_SetCoords( p_libvlc, "bla", i, i );
+    var_SetCoords( p_libvlc, "bla", -1, -1 );
+    return NULL;
+}
+
+/* Values read without the lock are never torn */
+static void test_handles_concurrent( libvlc_int_t *p_libvlc )
+{
+    vlc_thread_t thread;
+    vlc_value_t val;
+    unsigned reads = 0;
+
+    var_Create( p_libvlc, "bla", VLC_VAR_COORDS );
+    vlc_var_handle_t *h = var_Resolve( p_libvlc, "bla", VLC_VAR_COORDS );
+    assert( h != NULL );
+
+    assert( !vlc_clone( &thread, writer, p_libvlc, VLC_THREAD_PRIORITY_LOW ) );
+    do
+    {
+        var_HandleGetChecked( h, VLC_VAR_COORDS, &val );
+        assert( val.coords.x == val.coords.y );
+        reads++;
+    }
+    while( val.coords.x != -1 );
+    vlc_join( thread, NULL );
+    log( "%u reads\n", reads );
+
+    var_HandleRelease( h );
+    var_Destroy( p_libvlc, "bla" );
+}
+
+/* Compares the reads through a handle with the reads by name */
+static void test_handles_speed( libvlc_int_t *p_libvlc )
+{
+    const unsigned count = 200000;
+    volatile int64_t sum = 0;
+    char name[16];
+
+    /* Some other variables, for a realistic lookup */
+    for( unsigned i = 0; i < 64; i++ )
+    {
+        snprintf( name, sizeof( name ), "dummy%u", i );
+        var_Create( p_libvlc, name, VLC_VAR_INTEGER );
+    }
+    var_Create( p_libvlc, "bla", VLC_VAR_INTEGER );
+    var_SetInteger( p_libvlc, "bla", 1 );
+    vlc_var_handle_t *h = var_Resolve( p_libvlc, "bla", VLC_VAR_INTEGER );
+
+    mtime_t start = mdate();
+    for( unsigned i = 0; i < count; i++ )
+        sum += var_GetInteger( p_libvlc, "bla" );
+    mtime_t by_name = mdate() - start;
+
+    start = mdate();
+    for( unsigned i = 0; i < count; i++ )
+        sum += var_HandleGetInteger( h );
+    mtime_t by_handle = mdate() - start;
+
+    assert( sum == 2 * count );
+    log( "%u reads: %"PRId64" us by name, %"PRId64" us by handle\n",
+         count, by_name, by_handle );
+
+    var_HandleRelease( h );
+    var_Destroy( p_libvlc, "bla" );
+    for( unsigned i = 0; i < 64; i++ )
+    {
+        snprintf( name, sizeof( name ), "dummy%u", i );
+        var_Destroy( p_libvlc, name );
+    }
+}
+
 static void test_variables( libvlc_instance_t *p_vlc )
 {
     libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
@@ -438,6 +553,11 @@ static void test_variables( libvlc_instance_t *p_vlc )
 
     log( "Testing type at creation\n" );
     test_creation_and_type( p_libvlc );
+
+    log( "Testing handles\n" );
+    test_handles( p_libvlc );
+    test_handles_concurrent( p_libvlc );
+    test_handles_speed( p_libvlc );
 }
 
 
@@ -0,0 +1,298 @@
+/*****************************************************************************
+ * httpd.c: test for the HTTP server event loop
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_httpd.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define CLIENTS 500
+#define STREAMS 50
+#define CHUNK   1000
+#define CHUNKS  20
+#define LIMIT   4
+#define TIMEOUT (5 * CLOCK_FREQ)
+
+static const char page[] = "<html>hello</html>";
+
+static int fill (httpd_file_sys_t *sys, httpd_file_t *file, uint8_t *request,
+                 uint8_t **data, int *len)
+{
+    (void) sys; (void) file; (void) request;
+    *data = malloc (sizeof (page) - 1);
+    assert (*data != NULL);
+    memcpy (*data, page, sizeof (page) - 1);
+    *len = sizeof (page) - 1;
+    return VLC_SUCCESS;
+}
+
+/* Returns a free TCP port on the loopback interface */
+static unsigned free_port (void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+    };
+    socklen_t addrlen = sizeof (addr);
+
+    int fd = socket (AF_INET, SOCK_STREAM, 0);
+    assert (fd != -1);
+    assert (!bind (fd, (struct sockaddr *)&addr, sizeof (addr)));
+    assert (!getsockname (fd, (struct sockaddr *)&addr, &addrlen));
+    close (fd);
+    return ntohs (addr.sin_port);
+}
+
+static int dial (unsigned port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons (port),
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+    };
+
+    int fd = socket (AF_INET, SOCK_STREAM, 0);
+    assert (fd != -1);
+    assert (!connect (fd, (struct sockaddr *)&addr, sizeof (addr)));
+    return fd;
+}
+
+static void request (int fd, const char *path, const char *version)
+{
+    char *req;
+    int len = asprintf (&req, "GET %s HTTP/%s\r\nHost: localhost\r\n\r\n",
+                        path, version);
+
+    assert (len != -1);
+    assert (send (fd, req, len, MSG_NOSIGNAL) == len);
+    free (req);
+}
+
+/* Reads exactly len bytes, or returns how many came before the end */
+static size_t receive (int fd, void *buf, size_t len)
+{
+    size_t got = 0;
+
+    while (got < len)
+    {
+        struct pollfd ufd = { .fd = fd, .events = POLLIN };
+
+        assert (poll (&ufd, 1, TIMEOUT / 1000) == 1);
+        ssize_t val = recv (fd, (char *)buf + got, len - got, 0);
+        assert (val >= 0);
+        if (val == 0)
+            break;
+        got += val;
+    }
+    return got;
+}
+
+/* Reads the head of an answer, returns its status */
+static int receive_head (int fd, char *head, size_t size)
+{
+    size_t len = 0;
+
+    do
+    {
+        assert (len < size - 1);
+        if (receive (fd, head + len, 1) == 0)
+            return -1;
+        head[++len] = '\0';
+    }
+    while (len < 4 || strcmp (head + len - 4, "\r\n\r\n"));
+    assert (!strncmp (head, "HTTP/1.", 7));
+    return atoi (head + 9);
+}
+
+/* Many clients at once, each with a request and a keep-alive connection */
+static void test_clients (unsigned port)
+{
+    int fds[CLIENTS];
+    char head[1024], body[sizeof (page)];
+
+    log ("Testing %d concurrent clients\n", CLIENTS);
+    for (unsigned i = 0; i < CLIENTS; i++)
+    {
+        fds[i] = dial (port);
+        request (fds[i], "/file", "1.1");
+    }
+    for (unsigned round = 0; round < 2; round++)
+        for (unsigned i = 0; i < CLIENTS; i++)
+        {
+            assert (receive_head (fds[i], head, sizeof (head)) == 200);
+            assert (strstr (head, "Content-Length: 18\r\n") != NULL);
+            assert (receive (fds[i], body, 18) == 18);
+            assert (!memcmp (body, page, 18));
+            if (round == 0) /* again on the same connection */
+                request (fds[i], "/file", "1.1");
+        }
+
+    /* 404 on unknown URLs */
+    request (fds[0], "/nowhere", "1.1");
+    assert (receive_head (fds[0], head, sizeof (head)) == 404);
+    for (unsigned i = 0; i < CLIENTS; i++)
+        close (fds[i]);
+}
+
+/* The stream clients get the data as soon as it is sent */
+static void test_stream (httpd_stream_t *stream, unsigned port)
+{
+    int fds[STREAMS];
+    char head[1024];
+    uint8_t chunk[CHUNK], buf[CHUNK];
+
+    log ("Testing %d stream clients\n", STREAMS);
+    for (unsigned i = 0; i < STREAMS; i++)
+    {
+        fds[i] = dial (port);
+        request (fds[i], "/stream", "1.0");
+        assert (receive_head (fds[i], head, sizeof (head)) == 200);
+    }
+
+    mtime_t worst = 0;
+    for (unsigned n = 0; n < CHUNKS; n++)
+    {
+        memset (chunk, n, sizeof (chunk));
+        mtime_t start = mdate ();
+        assert (httpd_StreamSend (stream, chunk, CHUNK) == VLC_SUCCESS);
+        for (unsigned i = 0; i < STREAMS; i++)
+        {
+            assert (receive (fds[i], buf, CHUNK) == CHUNK);
+            assert (!memcmp (buf, chunk, CHUNK));
+        }
+        if (mdate () - start > worst)
+            worst = mdate () - start;
+    }
+    log ("worst delivery: %"PRId64" us\n", worst);
+    for (unsigned i = 0; i < STREAMS; i++)
+        close (fds[i]);
+}
+
+/* The clients beyond the limit are turned away */
+static void test_limit (vlc_object_t *obj)
+{
+    unsigned port = free_port ();
+    int fds[LIMIT + 1];
+    char head[1024], body[sizeof (page)];
+
+    log ("Testing the limit of %d clients\n", LIMIT);
+    var_SetInteger (obj, "http-port", port);
+    var_SetInteger (obj, "http-max-clients", LIMIT);
+    httpd_host_t *host = vlc_http_HostNew (obj);
+    assert (host != NULL);
+    httpd_file_t *file = httpd_FileNew (host, "/file", "text/html", NULL,
+                                        NULL, NULL, fill, NULL);
+    assert (file != NULL);
+
+    /* Once answered, a client is known to the server */
+    for (unsigned i = 0; i < LIMIT; i++)
+    {
+        fds[i] = dial (port);
+        request (fds[i], "/file", "1.1");
+        assert (receive_head (fds[i], head, sizeof (head)) == 200);
+        assert (receive (fds[i], body, 18) == 18);
+    }
+    fds[LIMIT] = dial (port);
+    request (fds[LIMIT], "/file", "1.1");
+    assert (receive_head (fds[LIMIT], head, sizeof (head)) == -1);
+    close (fds[LIMIT]);
+
+    /* and one leaving makes room, once the server has seen it leave. Each
+     * attempt waits for the server to handle it, after the hangup or along
+     * with it, so no more than a few are needed */
+    close (fds[0]);
+    for (mtime_t deadline = mdate () + TIMEOUT;;)
+    {
+        assert (mdate () < deadline);
+        fds[0] = dial (port);
+        request (fds[0], "/file", "1.1");
+        if (receive_head (fds[0], head, sizeof (head)) == 200)
+            break;
+        close (fds[0]);
+    }
+    for (unsigned i = 0; i < LIMIT; i++)
+        close (fds[i]);
+
+    var_SetInteger (obj, "http-max-clients", 0);
+    httpd_FileDelete (file);
+    httpd_HostDelete (host);
+}
+
+int main (void)
+{
+    test_init ();
+    alarm (20); /* the idle client timeout alone takes 10 seconds */
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    unsigned port = free_port ();
+    var_Create (obj, "http-host", VLC_VAR_STRING);
+    var_SetString (obj, "http-host", "127.0.0.1");
+    var_Create (obj, "http-port", VLC_VAR_INTEGER);
+    var_SetInteger (obj, "http-port", port);
+    var_Create (obj, "http-max-clients", VLC_VAR_INTEGER);
+
+    httpd_host_t *host = vlc_http_HostNew (obj);
+    assert (host != NULL);
+    httpd_file_t *file = httpd_FileNew (host, "/file", "text/html", NULL, NULL,
+                                        NULL, fill, NULL);
+    assert (file != NULL);
+    httpd_stream_t *stream = httpd_StreamNew (host, "/stream",
+                                              "application/octet-stream",
+                                              NULL, NULL, NULL);
+    assert (stream != NULL);
+
+    /* An idle client is timed out after 10 seconds */
+    int idle = dial (port);
+    mtime_t idle_start = mdate ();
+
+    test_clients (port);
+    test_stream (stream, port);
+
+    test_limit (obj);
+
+    log ("Testing the idle client timeout\n");
+    char c;
+    struct pollfd ufd = { .fd = idle, .events = POLLIN };
+    assert (poll (&ufd, 1, 15000) == 1);
+    assert (recv (idle, &c, 1, 0) == 0);
+    mtime_t idle_time = mdate () - idle_start;
+    log ("idle for %"PRId64" ms\n", idle_time / 1000);
+    assert (idle_time >= 10 * CLOCK_FREQ && idle_time < 12 * CLOCK_FREQ);
+    close (idle);
+
+    httpd_StreamDelete (stream);
+    httpd_FileDelete (file);
+    httpd_HostDelete (host);
+    libvlc_release (vlc);
+    return 0;
+}
@@ -0,0 +1,380 @@
+/*****************************************************************************
+ * art.c: test for the content-addressed album art cache
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+#include <vlc_md5.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define PICTURES 4
+#define SIZE     (400 << 10) /* a third of the cache */
+#define TIMEOUT  (3 * CLOCK_FREQ)
+
+static char base[] = "/tmp/vlc-test-art-XXXXXX";
+static uint8_t *pictures[PICTURES];
+
+/*** A minimal HTTP server, for the pictures ***/
+static struct
+{
+    int fd;
+    vlc_thread_t thread;
+    vlc_mutex_t lock;
+    unsigned requests;
+} server;
+
+static void *server_thread (void *opaque)
+{
+    (void) opaque;
+
+    for (;;)
+    {
+        char req[1024], head[128];
+        unsigned n;
+
+        int fd = accept (server.fd, NULL, NULL);
+        if (fd == -1)
+            break;
+
+        /* The whole request header, before answering */
+        ssize_t len = 0, val;
+        req[0] = '\0';
+        while (strstr (req, "\r\n\r\n") == NULL
+            && (val = recv (fd, req + len, sizeof (req) - 1 - len, 0)) > 0)
+        {
+            len += val;
+            req[len] = '\0';
+        }
+        if (strstr (req, "\r\n\r\n") != NULL)
+        {
+            vlc_mutex_lock (&server.lock);
+            server.requests++;
+            vlc_mutex_unlock (&server.lock);
+
+            if (sscanf (req, "GET /%u.jpg ", &n) == 1 && n < PICTURES)
+            {
+                len = sprintf (head, "HTTP/1.1 200 OK\r\n"
+                               "Content-Length: %u\r\n"
+                               "Connection: close\r\n\r\n", SIZE);
+                send (fd, head, len, MSG_NOSIGNAL);
+                for (size_t pos = 0; pos < SIZE;)
+                {
+                    val = send (fd, pictures[n] + pos, SIZE - pos,
+                                MSG_NOSIGNAL);
+                    if (val <= 0)
+                        break;
+                    pos += val;
+                }
+            }
+            else
+            {
+                len = sprintf (head, "HTTP/1.1 404 Not Found\r\n"
+                               "Content-Length: 0\r\n"
+                               "Connection: close\r\n\r\n");
+                send (fd, head, len, MSG_NOSIGNAL);
+            }
+        }
+        close (fd);
+    }
+    return NULL;
+}
+
+static unsigned server_start (void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+    };
+    socklen_t addrlen = sizeof (addr);
+
+    server.fd = socket (AF_INET, SOCK_STREAM, 0);
+    assert (server.fd != -1);
+    assert (!bind (server.fd, (struct sockaddr *)&addr, sizeof (addr)));
+    assert (!listen (server.fd, 8));
+    assert (!getsockname (server.fd, (struct sockaddr *)&addr, &addrlen));
+    vlc_mutex_init (&server.lock);
+    assert (!vlc_clone (&server.thread, server_thread, NULL,
+                        VLC_THREAD_PRIORITY_LOW));
+    return ntohs (addr.sin_port);
+}
+
+static void server_stop (void)
+{
+    shutdown (server.fd, SHUT_RDWR);
+    vlc_join (server.thread, NULL);
+    close (server.fd);
+    vlc_mutex_destroy (&server.lock);
+}
+
+static unsigned requests (void)
+{
+    vlc_mutex_lock (&server.lock);
+    unsigned n = server.requests;
+    vlc_mutex_unlock (&server.lock);
+    return n;
+}
+
+/*** Client side ***/
+static libvlc_instance_t *start (void)
+{
+    const char *argv[test_defaults_nargs + 2];
+
+    for (int i = 0; i < test_defaults_nargs; i++)
+        argv[i] = test_defaults_args[i];
+    argv[test_defaults_nargs] = "--album-art-cache-size=1";
+    argv[test_defaults_nargs + 1] = "--album-art-thumbnails=64";
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs + 2, argv);
+    assert (vlc != NULL);
+    return vlc;
+}
+
+struct meta_wait
+{
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    unsigned changes;
+};
+
+static void meta_changed (const libvlc_event_t *ev, void *data)
+{
+    struct meta_wait *w = data;
+
+    (void) ev;
+    vlc_mutex_lock (&w->lock);
+    w->changes++;
+    vlc_cond_signal (&w->wait);
+    vlc_mutex_unlock (&w->lock);
+}
+
+/* Fetches the art of an album, returns the cached file */
+static char *fetch (libvlc_instance_t *vlc, unsigned port, const char *album,
+                    unsigned picture)
+{
+    struct meta_wait w = { .changes = 0 };
+    char *path, *url;
+
+    assert (asprintf (&path, "%s/%s.dat", base, album) != -1);
+    int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert (fd != -1);
+    close (fd);
+    libvlc_media_t *md = libvlc_media_new_path (vlc, path);
+    assert (md != NULL);
+    free (path);
+
+    assert (asprintf (&url, "http://127.0.0.1:%u/%u.jpg", port,
+                      picture) != -1);
+    libvlc_media_set_meta (md, libvlc_meta_Artist, "Artist");
+    libvlc_media_set_meta (md, libvlc_meta_Album, album);
+    libvlc_media_set_meta (md, libvlc_meta_ArtworkURL, url);
+
+    /* The art URL changes to the cached file */
+    libvlc_event_manager_t *em = libvlc_media_event_manager (md);
+    vlc_mutex_init (&w.lock);
+    vlc_cond_init (&w.wait);
+    assert (!libvlc_event_attach (em, libvlc_MediaMetaChanged, meta_changed,
+                                  &w));
+    libvlc_media_parse_async (md);
+
+    mtime_t deadline = mdate () + TIMEOUT;
+    vlc_mutex_lock (&w.lock);
+    for (;;)
+    {
+        unsigned changes = w.changes;
+
+        vlc_mutex_unlock (&w.lock);
+        free (url);
+        url = libvlc_media_get_meta (md, libvlc_meta_ArtworkURL);
+        if (url != NULL && !strncmp (url, "file://", 7))
+            break;
+        vlc_mutex_lock (&w.lock);
+        while (w.changes == changes)
+            assert (!vlc_cond_timedwait (&w.wait, &w.lock, deadline));
+    }
+    libvlc_event_detach (em, libvlc_MediaMetaChanged, meta_changed, &w);
+    libvlc_media_release (md);
+    vlc_cond_destroy (&w.wait);
+    vlc_mutex_destroy (&w.lock);
+
+    path = strdup (url + 7);
+    assert (path != NULL);
+    free (url);
+    return path;
+}
+
+/* The file is named after the content of the picture */
+static void check_file (const char *path, unsigned picture)
+{
+    struct md5_s md5;
+    struct stat st;
+
+    InitMD5 (&md5);
+    AddMD5 (&md5, pictures[picture], SIZE);
+    EndMD5 (&md5);
+    char *hash = psz_md5_hash (&md5);
+
+    const char *name = strrchr (path, '/');
+    assert (name != NULL);
+    assert (!strncmp (name + 1, hash, 32));
+    assert (!strcmp (name + 1 + 32, ".jpg"));
+    assert (strstr (path, "/vlc/art/data/") != NULL);
+    free (hash);
+
+    assert (!stat (path, &st));
+    assert (st.st_size == SIZE);
+}
+
+static bool exists (const char *path)
+{
+    struct stat st;
+
+    return !stat (path, &st);
+}
+
+static unsigned count_files (const char *dir)
+{
+    struct dirent *ent;
+    unsigned n = 0;
+
+    DIR *dh = opendir (dir);
+    assert (dh != NULL);
+    while ((ent = readdir (dh)) != NULL)
+        if (ent->d_name[0] != '.')
+            n++;
+    closedir (dh);
+    return n;
+}
+
+int main (void)
+{
+    char *a, *b, *c, *d, *e, *data;
+
+    test_init ();
+
+    assert (mkdtemp (base) != NULL);
+    setenv ("XDG_CACHE_HOME", base, 1);
+    assert (asprintf (&data, "%s/vlc/art/data", base) != -1);
+    for (unsigned i = 0; i < PICTURES; i++)
+    {
+        pictures[i] = malloc (SIZE);
+        assert (pictures[i] != NULL);
+        for (size_t j = 0; j < SIZE; j++)
+            pictures[i][j] = rand ();
+    }
+
+    unsigned port = server_start ();
+    libvlc_instance_t *vlc = start ();
+
+    /* Stored after its content */
+    a = fetch (vlc, port, "A", 0);
+    check_file (a, 0);
+    assert (requests () == 1);
+
+    /* Albums with the same picture share it */
+    b = fetch (vlc, port, "B", 0);
+    assert (!strcmp (a, b));
+    assert (requests () == 2);
+    log ("stored: %s\n", a);
+
+    /* The least recently used picture is evicted beyond 1 MiB */
+    c = fetch (vlc, port, "C", 1);
+    check_file (c, 1);
+    d = fetch (vlc, port, "D", 2);
+    check_file (d, 2);
+    log ("evicted: %s\n", a);
+    assert (!exists (a));
+    assert (exists (c));
+    libvlc_release (vlc);
+
+    /* The index is reloaded at the next start: no more requests */
+    unsigned n = requests ();
+    vlc = start ();
+    free (c);
+    c = fetch (vlc, port, "C", 1);
+    check_file (c, 1);
+    assert (requests () == n);
+
+    /* and that counts as a use */
+    e = fetch (vlc, port, "E", 3);
+    check_file (e, 3);
+    assert (!exists (d));
+    assert (exists (c));
+    log ("%u files left\n", count_files (data));
+    assert (count_files (data) <= 2 * 2); /* with any thumbnails */
+
+    /* Evicted albums are downloaded again */
+    free (a);
+    a = fetch (vlc, port, "A", 0);
+    check_file (a, 0);
+    assert (requests () == n + 2);
+    libvlc_release (vlc);
+
+    /* Two instances sharing the cache keep the albums of each other */
+    char *f, *g;
+    libvlc_instance_t *vlc2 = start ();
+    vlc = start ();
+    free (a);
+    a = fetch (vlc, port, "A", 0);
+    free (e);
+    e = fetch (vlc2, port, "E", 3);
+    n = requests ();
+    f = fetch (vlc, port, "F", 0);
+    g = fetch (vlc2, port, "G", 3);
+    assert (!strcmp (f, a) && !strcmp (g, e));
+    assert (requests () == n + 2);
+    libvlc_release (vlc2);
+    libvlc_release (vlc);
+
+    vlc = start ();
+    free (f);
+    f = fetch (vlc, port, "F", 0);
+    free (g);
+    g = fetch (vlc, port, "G", 3);
+    assert (!strcmp (f, a) && !strcmp (g, e));
+    assert (requests () == n + 2);
+    libvlc_release (vlc);
+    server_stop ();
+
+    char *cmd;
+    assert (asprintf (&cmd, "rm -rf -- %s", base) != -1);
+    assert (!system (cmd));
+    free (cmd);
+    for (unsigned i = 0; i < PICTURES; i++)
+        free (pictures[i]);
+    free (data);
+    free (g);
+    free (f);
+    free (e);
+    free (d);
+    free (c);
+    free (b);
+    free (a);
+    return 0;
+}
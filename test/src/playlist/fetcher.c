@@ -0,0 +1,217 @@
+/*****************************************************************************
+ * fetcher.c: test for the parallel art fetcher
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define MODULE_STRING "test"
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define TRACKS 8
+#define TIMEOUT (3 * CLOCK_FREQ)
+
+static char base[] = "/tmp/vlc-test-fetcher-XXXXXX";
+
+static char *make_file (const char *dir, const char *name)
+{
+    char *path;
+
+    assert (asprintf (&path, "%s/%s/%s", base, dir, name) != -1);
+    int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert (fd != -1);
+    assert (write (fd, "test", 4) == 4);
+    close (fd);
+    return path;
+}
+
+struct track
+{
+    libvlc_media_t *md;
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    unsigned changes;
+};
+
+static void meta_changed (const libvlc_event_t *ev, void *data)
+{
+    struct track *t = data;
+
+    (void) ev;
+    vlc_mutex_lock (&t->lock);
+    t->changes++;
+    vlc_cond_signal (&t->wait);
+    vlc_mutex_unlock (&t->lock);
+}
+
+static void track_open (struct track *t, libvlc_instance_t *vlc,
+                        const char *dir, unsigned n, const char *album)
+{
+    char name[16];
+
+    snprintf (name, sizeof (name), "%02u.dat", n);
+    char *path = make_file (dir, name);
+    t->md = libvlc_media_new_path (vlc, path);
+    assert (t->md != NULL);
+    free (path);
+
+    libvlc_media_set_meta (t->md, libvlc_meta_Artist, "Artist");
+    libvlc_media_set_meta (t->md, libvlc_meta_Album, album);
+    vlc_mutex_init (&t->lock);
+    vlc_cond_init (&t->wait);
+    t->changes = 0;
+    assert (!libvlc_event_attach (libvlc_media_event_manager (t->md),
+                                  libvlc_MediaMetaChanged, meta_changed, t));
+    libvlc_media_parse_async (t->md);
+}
+
+static void track_close (struct track *t)
+{
+    libvlc_event_detach (libvlc_media_event_manager (t->md),
+                         libvlc_MediaMetaChanged, meta_changed, t);
+    libvlc_media_release (t->md);
+    vlc_cond_destroy (&t->wait);
+    vlc_mutex_destroy (&t->lock);
+}
+
+/* Waits for the art of a media, returns false on timeout */
+static bool wait_art (struct track *t, mtime_t timeout)
+{
+    mtime_t deadline = mdate () + timeout;
+
+    vlc_mutex_lock (&t->lock);
+    for (;;)
+    {
+        unsigned changes = t->changes;
+
+        vlc_mutex_unlock (&t->lock);
+        char *url = libvlc_media_get_meta (t->md, libvlc_meta_ArtworkURL);
+        if (url != NULL)
+        {
+            assert (!strncmp (url, "file://", 7));
+            assert (strstr (url, "cover.jpg") != NULL);
+            free (url);
+            return true;
+        }
+
+        vlc_mutex_lock (&t->lock);
+        while (t->changes == changes)
+            if (vlc_cond_timedwait (&t->wait, &t->lock, deadline))
+            {
+                vlc_mutex_unlock (&t->lock);
+                return false;
+            }
+    }
+}
+
+/* Checks whether the art cache index records the album as missing */
+static bool missing_in_index (const char *path, const char *album)
+{
+    char *line = NULL, *key;
+    size_t size = 0;
+    bool found = false;
+
+    FILE *f = fopen (path, "rt");
+    if (f == NULL)
+        return false;
+    assert (asprintf (&key, " - artistalbum/Artist/%s\n", album) != -1);
+    while (!found && getline (&line, &size, f) != -1)
+        found = !strncmp (line, "K ", 2) && strstr (line, key) != NULL;
+    free (key);
+    free (line);
+    fclose (f);
+    return found;
+}
+
+int main (void)
+{
+    char *dir, *cover, *art_index;
+
+    test_init ();
+
+    assert (mkdtemp (base) != NULL);
+    setenv ("XDG_CACHE_HOME", base, 1);
+    assert (asprintf (&dir, "%s/found", base) != -1);
+    assert (!mkdir (dir, 0700));
+    free (dir);
+    assert (asprintf (&dir, "%s/missing", base) != -1);
+    assert (!mkdir (dir, 0700));
+    free (dir);
+    cover = make_file ("found", "cover.jpg");
+    assert (asprintf (&art_index, "%s/vlc/art/index", base) != -1);
+
+    libvlc_instance_t *vlc = libvlc_new (test_defaults_nargs,
+                                         test_defaults_args);
+    assert (vlc != NULL);
+
+    /* The tracks of an album are all completed, from a single search */
+    struct track tracks[TRACKS];
+    for (unsigned i = 0; i < TRACKS; i++)
+        track_open (&tracks[i], vlc, "found", i, "Found");
+    for (unsigned i = 0; i < TRACKS; i++)
+    {
+        assert (wait_art (&tracks[i], TIMEOUT));
+        track_close (&tracks[i]);
+    }
+    log ("album: %u tracks\n", TRACKS);
+
+    /* Missing art is recorded. Only the index tells when, so it is polled,
+     * at a fixed rate up to the deadline */
+    struct track m;
+    track_open (&m, vlc, "missing", 0, "Missing");
+    mtime_t deadline = mdate () + TIMEOUT, next = mdate ();
+    while (!missing_in_index (art_index, "Missing"))
+    {
+        assert (next < deadline);
+        next += CLOCK_FREQ / 100;
+        mwait (next);
+    }
+    assert (!wait_art (&m, CLOCK_FREQ / 10));
+    track_close (&m);
+    libvlc_release (vlc);
+    log ("missing: %s\n", art_index);
+
+    /* and not searched again at the next start */
+    char *late = make_file ("missing", "cover.jpg");
+    vlc = libvlc_new (test_defaults_nargs, test_defaults_args);
+    assert (vlc != NULL);
+
+    struct track other;
+    track_open (&other, vlc, "missing", 1, "Other");
+    track_open (&m, vlc, "missing", 2, "Missing");
+    assert (wait_art (&other, TIMEOUT));
+    assert (!wait_art (&m, CLOCK_FREQ / 2));
+    track_close (&other);
+    track_close (&m);
+    libvlc_release (vlc);
+
+    char *cmd;
+    assert (asprintf (&cmd, "rm -rf -- %s", base) != -1);
+    assert (!system (cmd));
+    free (cmd);
+    free (late);
+    free (art_index);
+    free (cover);
+    return 0;
+}